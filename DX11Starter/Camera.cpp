@@ -50,32 +50,32 @@ void Camera::Move(float deltaTime)
 	XMFLOAT3 velocity = XMFLOAT3(0, 0, 0);
 
 	// Check for player input
-	if (GetAsyncKeyState('W') & 0x8000)
+	if (IsKeyDown('W'))
 	{
 		velocity.z += speed * deltaTime;
 	}
 
-	if (GetAsyncKeyState('S') & 0x8000)
+	if (IsKeyDown('S'))
 	{
 		velocity.z -= speed * deltaTime;
 	}
 
-	if (GetAsyncKeyState('D') & 0x8000)
+	if (IsKeyDown('D'))
 	{
 		velocity.x += speed * deltaTime;
 	}
 
-	if (GetAsyncKeyState('A') & 0x8000)
+	if (IsKeyDown('A'))
 	{
 		velocity.x -= speed * deltaTime;
 	}
 
-	if (GetAsyncKeyState('Q') & 0x8000)
+	if (IsKeyDown('Q'))
 	{
 		velocity.y += speed * deltaTime;
 	}
 
-	if (GetAsyncKeyState('E') & 0x8000)
+	if (IsKeyDown('E'))
 	{
 		velocity.y -= speed * deltaTime;
 	}
@@ -1,7 +1,7 @@
 #pragma once
 
 #include <DirectXMath.h>
-#include <Windows.h>
+#include "Platform.h"
 
 class Camera
 {
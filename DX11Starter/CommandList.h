@@ -0,0 +1,35 @@
+#pragma once
+
+#include "RenderContext.h"
+
+// --------------------------------------------------------
+// A list of rendering commands that can be recorded on one
+// thread and played back later on the thread that owns the
+// real render context.
+//
+// Each list starts recording with nothing bound, so anything
+// the commands depend on (render targets, viewport, topology)
+// has to be recorded into the list itself.
+// --------------------------------------------------------
+class ICommandList
+{
+public:
+	virtual ~ICommandList() { }
+
+	// The context commands are recorded into.  Only use it
+	// between Begin() and End(), and from one thread at a time.
+	virtual IRenderContext* GetContext() = 0;
+
+	// Starts recording, throwing away anything recorded before
+	virtual void Begin() = 0;
+
+	// Finishes recording so the list can be executed
+	virtual void End() = 0;
+
+	// Plays the recorded commands into another context, in order
+	virtual void Execute(IRenderContext* target) = 0;
+
+	// Whether Execute() makes every recorded call on the target
+	// again, rather than handing it the whole list in one call
+	virtual bool ReplaysIntoTarget() = 0;
+};
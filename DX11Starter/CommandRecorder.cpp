@@ -0,0 +1,174 @@
+#include "CommandRecorder.h"
+
+#include <chrono>
+
+CommandRecorder::CommandRecorder(CommandListFactory createCommandList)
+{
+	this->createCommandList = createCommandList;
+	threadCount = std::thread::hardware_concurrency();
+	if (threadCount == 0) threadCount = 1;
+	minItemsPerThread = 64;
+
+	job = 0;
+	jobWorkers = 0;
+	jobItemCount = 0;
+	jobRecord = 0;
+	workersRecording = 0;
+	stopping = false;
+
+	threadsUsed = 0;
+	recordMilliseconds = 0;
+	executeMilliseconds = 0;
+	renderStats.Reset();
+}
+
+// --------------------------------------------------------
+// Stops the pool before the lists it records into go away.
+// Record() never returns with a job still running, so the
+// threads are all waiting.
+// --------------------------------------------------------
+CommandRecorder::~CommandRecorder()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (size_t i = 0; i < pool.size(); i++)
+		pool[i].join();
+
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		delete workers[i].Cache;
+		delete workers[i].List;
+	}
+}
+
+void CommandRecorder::SetThreadCount(unsigned int threadCount)
+{
+	this->threadCount = threadCount > 0 ? threadCount : 1;
+}
+
+void CommandRecorder::SetMinItemsPerThread(unsigned int minItemsPerThread)
+{
+	this->minItemsPerThread = minItemsPerThread > 0 ? minItemsPerThread : 1;
+}
+
+// --------------------------------------------------------
+// Records the items across as many threads as are worth it.
+// Each worker records one contiguous range, and the lists are
+// executed in range order so the draw order never changes.
+// --------------------------------------------------------
+void CommandRecorder::Record(IRenderContext* target, unsigned int itemCount, RecordFunction record)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	// Don't split the work into pieces too small to be worth a thread
+	unsigned int threads = itemCount / minItemsPerThread;
+	if (threads > threadCount) threads = threadCount;
+	if (threads < 1) threads = 1;
+	threadsUsed = threads;
+	renderStats.Reset();
+
+	if (threads == 1)
+	{
+		record(target, 0, itemCount);
+		std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+		recordMilliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+		executeMilliseconds = 0;
+		return;
+	}
+
+	// Make sure every worker has a list to record into, and every worker
+	// but the first has a thread.  Nothing is recording yet, so the
+	// workers can be added to without locking.
+	while (workers.size() < threads)
+	{
+		Worker worker;
+		worker.List = createCommandList();
+		worker.Cache = new StateCache(worker.List->GetContext());
+		workers.push_back(worker);
+	}
+	while (pool.size() < threads - 1)
+	{
+		unsigned int worker = (unsigned int)pool.size() + 1;
+		pool.push_back(std::thread(&CommandRecorder::WorkerThread, this, worker));
+	}
+
+	// Hand the other ranges to the pool, and take the first one here
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobWorkers = threads;
+		jobItemCount = itemCount;
+		jobRecord = &record;
+		workersRecording = threads - 1;
+		job++;
+	}
+	wake.notify_all();
+	RecordRange(0);
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		finished.wait(lock, [this] { return workersRecording == 0; });
+		jobRecord = 0;
+	}
+
+	std::chrono::high_resolution_clock::time_point recorded = std::chrono::high_resolution_clock::now();
+	recordMilliseconds = std::chrono::duration<double, std::milli>(recorded - start).count();
+
+	// Play everything back in order
+	for (unsigned int t = 0; t < threads; t++)
+	{
+		workers[t].List->Execute(target);
+		if (!workers[t].List->ReplaysIntoTarget())
+			renderStats.Add(workers[t].Cache->GetRenderStats());
+	}
+
+	std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+	executeMilliseconds = std::chrono::duration<double, std::milli>(end - recorded).count();
+}
+
+// --------------------------------------------------------
+// Records one worker's share of the current job.  Lists start
+// out with nothing bound, so their caches start empty too.
+// --------------------------------------------------------
+void CommandRecorder::RecordRange(unsigned int worker)
+{
+	unsigned int first = (unsigned int)((unsigned long long)jobItemCount * worker / jobWorkers);
+	unsigned int last = (unsigned int)((unsigned long long)jobItemCount * (worker + 1) / jobWorkers);
+	workers[worker].List->Begin();
+	workers[worker].Cache->Invalidate();
+	workers[worker].Cache->ResetRenderStats();
+	(*jobRecord)(workers[worker].Cache, first, last - first);
+	workers[worker].List->End();
+}
+
+// --------------------------------------------------------
+// Waits for each new job, records its range if the job has
+// enough workers to include this one, and sleeps again until
+// the recorder is destroyed.  A new thread may see the job
+// before the one it was started for, but no earlier job had
+// enough workers to include it, so it only skips that one.
+// --------------------------------------------------------
+void CommandRecorder::WorkerThread(unsigned int worker)
+{
+	unsigned long long lastJob = 0;
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		wake.wait(lock, [this, lastJob] { return stopping || job != lastJob; });
+		if (stopping)
+			return;
+
+		lastJob = job;
+		if (worker >= jobWorkers)
+			continue;
+
+		lock.unlock();
+		RecordRange(worker);
+		lock.lock();
+
+		if (--workersRecording == 0)
+			finished.notify_one();
+	}
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "CommandList.h"
+#include "StateCache.h"
+
+// --------------------------------------------------------
+// Splits a list of work items into contiguous ranges, has
+// worker threads record each range into its own command
+// list, then plays the lists back in order on the calling
+// thread.  The result is the same as recording every item
+// in order on one context.
+//
+// Worker threads are started the first time they're needed
+// and then kept, waiting for the next Record(), until the
+// recorder is destroyed.
+// --------------------------------------------------------
+class CommandRecorder
+{
+public:
+	// Called on a worker with the context to record into and
+	// the range of items [first, first + count) to record
+	typedef std::function<void(IRenderContext* context, unsigned int first, unsigned int count)> RecordFunction;
+
+	// Makes a new command list whenever another worker needs one
+	typedef std::function<ICommandList*()> CommandListFactory;
+
+	CommandRecorder(CommandListFactory createCommandList); // Constructor
+	~CommandRecorder(); // Destructor
+
+	// Maximum number of worker threads to record with
+	void SetThreadCount(unsigned int threadCount);
+
+	// Fewest items worth giving a thread of its own
+	void SetMinItemsPerThread(unsigned int minItemsPerThread);
+
+	// Records itemCount items and executes them on the target.  With
+	// only one thread's worth of work the items are recorded straight
+	// into the target and no command lists are used.
+	void Record(IRenderContext* target, unsigned int itemCount, RecordFunction record);
+
+	// Stats for the last call to Record()
+	unsigned int GetThreadsUsed() { return threadsUsed; }
+	double GetRecordMilliseconds() { return recordMilliseconds; }
+	double GetExecuteMilliseconds() { return executeMilliseconds; }
+
+	// What the workers' caches sent into lists the target never
+	// sees call by call (software lists replay through the target,
+	// so they're counted there instead)
+	const RenderStatCounters& GetRenderStats() { return renderStats; }
+
+private:
+	// A command list and the state cache filtering what's recorded into it
+	struct Worker
+	{
+		ICommandList* List;
+		StateCache* Cache;
+	};
+
+	// Helper methods
+	void RecordRange(unsigned int worker);
+	void WorkerThread(unsigned int worker);
+
+	CommandListFactory createCommandList;
+	std::vector<Worker> workers;
+	unsigned int threadCount;
+	unsigned int minItemsPerThread;
+
+	// The pool, where thread i records for worker i + 1 (the calling
+	// thread always takes worker 0).  The job is only touched while
+	// no worker is recording.
+	std::vector<std::thread> pool;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable finished;
+	unsigned long long job;			// Bumped for every Record() that uses the pool
+	unsigned int jobWorkers;
+	unsigned int jobItemCount;
+	const RecordFunction* jobRecord;
+	unsigned int workersRecording;
+	bool stopping;
+
+	unsigned int threadsUsed;
+	double recordMilliseconds;
+	double executeMilliseconds;
+	RenderStatCounters renderStats;
+};
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cstddef>
+#include <DirectXMath.h>
+#include "ShaderReflectionCache.h"
+
+// --------------------------------------------------------
+// Checks that a C++ struct lays out exactly like an HLSL
+// constant buffer (or a struct inside one), so the whole
+// thing can be copied in with one memcpy.
+//
+// HLSL packs constant buffers into 16 byte registers:
+//  - A value that would cross into the next register starts
+//    at the next register instead
+//  - Arrays and structs always start at a new register, and
+//    every array element but the last is padded to 16 bytes
+//  - The buffer itself is a whole number of registers
+//
+// A mirrored struct lists its members, in order, with a
+// specialization of HlslLayout:
+//
+//   template<> struct HlslLayout<LightConstants>
+//   {
+//       static constexpr HlslMemberList<1> Members()
+//       {
+//           return {{ HLSL_MEMBER(LightConstants, Lights) }};
+//       }
+//   };
+//   static_assert(HlslLayoutMatches<LightConstants>(), "...");
+//
+// The struct has to be padded out to a whole register, like
+// the buffer.  Structs used inside others need a layout too.
+// --------------------------------------------------------
+
+// One member as C++ laid it out, with the size HLSL gives it
+struct HlslMember
+{
+	unsigned int Offset;	// Where C++ put it
+	unsigned int Size;		// HLSL size, without any trailing padding
+	bool StartsRegister;	// Arrays and structs
+
+	template<typename T>
+	static constexpr HlslMember Of(size_t offset);
+};
+
+template<unsigned int N>
+struct HlslMemberList
+{
+	HlslMember Members[N];
+};
+
+// Specialized for each mirrored struct, see above
+template<typename T>
+struct HlslLayout;
+
+// Byte size and placement of the types a constant buffer can hold.
+// Anything without an entry (like bool, which is 4 bytes in HLSL)
+// is a build error.  Other structs use their own HlslLayout.
+template<typename T>
+struct HlslTraits;
+
+template<unsigned int N>
+constexpr unsigned int HlslPackedSize(const HlslMemberList<N>& list);
+
+constexpr unsigned int HlslRoundToRegister(unsigned int offset)
+{
+	return (offset + 15) & ~15u;
+}
+
+template<typename T, unsigned int Size>
+struct HlslValueTraits
+{
+	static_assert(sizeof(T) == Size, "C++ type is a different size than its HLSL type");
+	static constexpr unsigned int HlslSize = Size;
+	static constexpr bool StartsRegister = false;
+};
+
+template<> struct HlslTraits<float> : HlslValueTraits<float, 4> { };
+template<> struct HlslTraits<int> : HlslValueTraits<int, 4> { };
+template<> struct HlslTraits<unsigned int> : HlslValueTraits<unsigned int, 4> { };
+template<> struct HlslTraits<DirectX::XMFLOAT2> : HlslValueTraits<DirectX::XMFLOAT2, 8> { };
+template<> struct HlslTraits<DirectX::XMFLOAT3> : HlslValueTraits<DirectX::XMFLOAT3, 12> { };
+template<> struct HlslTraits<DirectX::XMFLOAT4> : HlslValueTraits<DirectX::XMFLOAT4, 16> { };
+template<> struct HlslTraits<DirectX::XMFLOAT4X4> : HlslValueTraits<DirectX::XMFLOAT4X4, 64> { };
+
+// Arrays: C++ has to space the elements a register apart too
+template<typename T, size_t N>
+struct HlslTraits<T[N]>
+{
+	static_assert(N > 0, "Empty arrays aren't allowed in constant buffers");
+	static_assert(sizeof(T) == HlslRoundToRegister(HlslTraits<T>::HlslSize), "Array elements must be padded to a multiple of 16 bytes");
+	static constexpr unsigned int HlslSize = HlslRoundToRegister(HlslTraits<T>::HlslSize) * (unsigned int)(N - 1) + HlslTraits<T>::HlslSize;
+	static constexpr bool StartsRegister = true;
+};
+
+// Structs, through their own layout
+template<typename T>
+struct HlslTraits
+{
+	static constexpr unsigned int HlslSize = HlslPackedSize(HlslLayout<T>::Members());
+	static constexpr bool StartsRegister = true;
+};
+
+template<typename T>
+constexpr HlslMember HlslMember::Of(size_t offset)
+{
+	return { (unsigned int)offset, HlslTraits<T>::HlslSize, HlslTraits<T>::StartsRegister };
+}
+
+// A member of a mirrored struct, for its HlslLayout
+#define HLSL_MEMBER(Type, Member) HlslMember::Of<decltype(Type::Member)>(offsetof(Type, Member))
+
+// --------------------------------------------------------
+// Walks the members, placing each where HLSL would.  Returns
+// the packed size (without trailing padding), or 0 if any
+// member isn't where HLSL would put it.
+// --------------------------------------------------------
+template<unsigned int N>
+constexpr unsigned int HlslPackedSize(const HlslMemberList<N>& list)
+{
+	unsigned int offset = 0;
+	for (unsigned int i = 0; i < N; i++)
+	{
+		const HlslMember& member = list.Members[i];
+		if (member.Size == 0)
+			return 0;
+
+		unsigned int used = offset % 16;
+		if (member.StartsRegister || (used != 0 && used + member.Size > 16))
+			offset = HlslRoundToRegister(offset);
+
+		if (member.Offset != offset)
+			return 0;
+		offset += member.Size;
+	}
+	return offset;
+}
+
+// True if every member is where HLSL puts it and the struct
+// is padded out to a whole register
+template<typename T>
+constexpr bool HlslLayoutMatches()
+{
+	return
+		HlslPackedSize(HlslLayout<T>::Members()) != 0 &&
+		sizeof(T) == HlslRoundToRegister(HlslPackedSize(HlslLayout<T>::Members()));
+}
+
+// --------------------------------------------------------
+// Checks a mirrored struct against a constant buffer as the
+// compiled shader describes it: same size, same number of
+// variables, each at the same offset with the same size.
+// Catches the HLSL side changing after the C++ side was written.
+// --------------------------------------------------------
+template<typename T>
+bool HlslLayoutMatchesReflection(const ReflectedConstantBuffer& buffer)
+{
+	if (!HlslLayoutMatches<T>() || buffer.Size != sizeof(T))
+		return false;
+
+	const auto list = HlslLayout<T>::Members();
+	const size_t count = sizeof(list.Members) / sizeof(list.Members[0]);
+	if (buffer.Variables.size() != count)
+		return false;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		if (buffer.Variables[i].ByteOffset != list.Members[i].Offset ||
+			buffer.Variables[i].Size != list.Members[i].Size)
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,98 @@
+#include "ConstantUploadRing.h"
+
+#include <cstring>
+
+// --------------------------------------------------------
+// The buffer is only created if the context can bind parts
+// of it, otherwise the ring stays disabled and every upload
+// falls back
+// --------------------------------------------------------
+ConstantUploadRing::ConstantUploadRing(IRenderDevice* device, IRenderContext* context, unsigned int byteSize)
+	: allocator(byteSize)
+{
+	this->device = device;
+	this->context = context;
+	buffer = 0;
+	mappedBefore = false;
+	frameIndex = 0;
+
+	bytes = 0;
+	uploads = 0;
+	fallbacks = 0;
+	bytesLastFrame = 0;
+	uploadsLastFrame = 0;
+	fallbacksLastFrame = 0;
+
+	if (context->SupportsConstantBufferOffsets())
+	{
+		BufferDesc desc = {};
+		desc.ByteWidth = byteSize;
+		desc.Usage = BUFFER_USAGE_DYNAMIC;
+		desc.BindFlags = BUFFER_BIND_CONSTANT;
+		buffer = device->CreateBuffer(desc, 0);
+	}
+}
+
+ConstantUploadRing::~ConstantUploadRing()
+{
+	device->Release(buffer);
+}
+
+// --------------------------------------------------------
+// Once a frame starts, at most MaxFrameLatency earlier frames
+// can still be queued on the GPU, so slices from anything
+// older than that can be reused
+// --------------------------------------------------------
+void ConstantUploadRing::BeginFrame()
+{
+	if (frameIndex > MaxFrameLatency)
+		allocator.Retire(frameIndex - MaxFrameLatency - 1);
+
+	bytes = 0;
+	uploads = 0;
+	fallbacks = 0;
+}
+
+void ConstantUploadRing::EndFrame()
+{
+	allocator.Fence(frameIndex);
+	frameIndex++;
+
+	bytesLastFrame = bytes;
+	uploadsLastFrame = uploads;
+	fallbacksLastFrame = fallbacks;
+}
+
+bool ConstantUploadRing::Upload(const void* data, unsigned int byteSize, ConstantBufferSlice& slice)
+{
+	// Slices are bound in whole 256 byte steps, so round up
+	unsigned int sliceSize = (byteSize + SliceAlignment - 1) & ~(SliceAlignment - 1);
+
+	unsigned int offset;
+	if (!buffer || !allocator.Allocate(sliceSize, SliceAlignment, offset))
+	{
+		fallbacks++;
+		return false;
+	}
+
+	unsigned char* mapped = (unsigned char*)(mappedBefore
+		? context->MapNoOverwrite(buffer)
+		: context->MapDiscard(buffer));
+	if (!mapped)
+	{
+		fallbacks++;
+		return false;
+	}
+	mappedBefore = true;
+
+	memcpy(mapped + offset, data, byteSize);
+	context->Unmap(buffer);
+
+	slice.Buffer = buffer;
+	slice.FirstConstant = offset / 16;
+	slice.NumConstants = sliceSize / 16;
+
+	bytes += sliceSize;
+	uploads++;
+	return true;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "RenderDevice.h"
+#include "RingAllocator.h"
+
+// --------------------------------------------------------
+// A piece of a constant buffer, ready to be bound with
+// VSSetConstantBuffers1() and friends.  A null buffer means
+// the data went into the shader's own buffer instead.
+// --------------------------------------------------------
+struct ConstantBufferSlice
+{
+	ID3D11Buffer* Buffer;
+	unsigned int FirstConstant;	// In 16 byte constants
+	unsigned int NumConstants;
+};
+
+// --------------------------------------------------------
+// One large dynamic constant buffer that per-draw constants
+// are appended into, instead of every shader updating its own
+// small buffers over and over.  Each upload is a NO_OVERWRITE
+// map of a fresh slice, and each draw binds just its slice.
+//
+// The GPU may still be reading a slice for a few frames after
+// it's written, so space is only handed back once enough
+// frames have been presented.  When the ring is full (or the
+// context can't bind ranges of constant buffers) Upload()
+// returns false, and the caller should fall back to updating
+// its own buffer the old way.
+// --------------------------------------------------------
+class ConstantUploadRing
+{
+public:
+	ConstantUploadRing(IRenderDevice* device, IRenderContext* context, unsigned int byteSize); // Constructor
+	~ConstantUploadRing(); // Destructor
+
+	// False if the context doesn't support constant buffer offsets
+	bool IsEnabled() { return buffer != 0; }
+
+	// Call once at the start and end of every frame
+	void BeginFrame();
+	void EndFrame();
+
+	// Copies the data into the ring and fills in the slice to bind.
+	// Returns false (and leaves the slice alone) if it didn't fit.
+	bool Upload(const void* data, unsigned int byteSize, ConstantBufferSlice& slice);
+
+	// Stats for the last finished frame
+	unsigned int GetBytesLastFrame() { return bytesLastFrame; }
+	unsigned int GetUploadsLastFrame() { return uploadsLastFrame; }
+	unsigned int GetFallbacksLastFrame() { return fallbacksLastFrame; }
+	unsigned int GetSize() { return allocator.GetSize(); }
+
+	// Counts up by one every EndFrame(), so slices uploaded with the
+	// same frame index were all written in the same frame
+	unsigned long long GetFrameIndex() { return frameIndex; }
+
+	// Frames the GPU can be behind the CPU (DXGI's default
+	// maximum frame latency), so how long slices stay in use
+	static const unsigned int MaxFrameLatency = 3;
+
+	// Offsets must be multiples of 16 constants
+	static const unsigned int SliceAlignment = 256;
+
+private:
+	IRenderDevice* device;
+	IRenderContext* context;
+	ID3D11Buffer* buffer;
+	RingAllocator allocator;
+
+	// The very first map has to discard, every later one can overwrite
+	bool mappedBefore;
+
+	unsigned long long frameIndex;
+
+	// Stats
+	unsigned int bytes;
+	unsigned int uploads;
+	unsigned int fallbacks;
+	unsigned int bytesLastFrame;
+	unsigned int uploadsLastFrame;
+	unsigned int fallbacksLastFrame;
+};
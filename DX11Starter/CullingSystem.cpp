@@ -0,0 +1,241 @@
+#include "CullingSystem.h"
+
+// For the DirectX Math library
+using namespace DirectX;
+
+CullingSystem::CullingSystem()
+{
+	// Nothing has been culled yet, so the first frame is a full pass
+	hasLastCamera = false;
+	fullPassRequested = true;
+	accumulatedTranslation = 0;
+	accumulatedRotation = 0;
+	cameraPosition = XMFLOAT3(0, 0, 0);
+	XMStoreFloat4x4(&lastViewMatrix, XMMatrixIdentity());
+	XMStoreFloat4x4(&lastProjectionMatrix, XMMatrixIdentity());
+
+	// Default tuning values
+	retestFrames = 16;
+	retestCursor = 0;
+	jumpDistance = 5.0f;
+	jumpAngle = 0.5f;
+
+	testsLastFrame = 0;
+	skippedLastFrame = 0;
+	fullPassLastFrame = false;
+}
+
+CullingSystem::~CullingSystem()
+{
+}
+
+void CullingSystem::Cull(std::vector<Entity>& entities, XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectionMatrix, std::vector<unsigned int>& visibleEntities)
+{
+	bool fullPass = fullPassRequested;
+
+	// A different entity count means our per-entity state no longer lines up
+	if (visibility.size() != entities.size())
+	{
+		visibility.resize(entities.size());
+		fullPass = true;
+	}
+
+	// A new projection (resize, fov change) invalidates every stored margin
+	if (!hasLastCamera || memcmp(&projectionMatrix, &lastProjectionMatrix, sizeof(XMFLOAT4X4)) != 0)
+		fullPass = true;
+
+	// Find the camera position from the inverse of the view matrix
+	// - The camera stores its matrices transposed for HLSL, so undo that first
+	XMMATRIX view = XMMatrixTranspose(XMLoadFloat4x4(&viewMatrix));
+	XMVECTOR determinant;
+	XMMATRIX inverseView = XMMatrixInverse(&determinant, view);
+	XMFLOAT3 newCameraPosition;
+	XMStoreFloat3(&newCameraPosition, inverseView.r[3]);
+
+	// Measure how far the camera moved and turned since last frame
+	// - Rotation is measured as the largest distance any unit vector moved, which is
+	//   2*sin(angle/2) and can be found from the trace of the relative rotation
+	if (hasLastCamera)
+	{
+		XMMATRIX lastView = XMMatrixTranspose(XMLoadFloat4x4(&lastViewMatrix));
+		float trace =
+			XMVectorGetX(XMVector3Dot(view.r[0], lastView.r[0])) +
+			XMVectorGetX(XMVector3Dot(view.r[1], lastView.r[1])) +
+			XMVectorGetX(XMVector3Dot(view.r[2], lastView.r[2]));
+		float rotationChord = sqrtf(trace < 3.0f ? 3.0f - trace : 0.0f);
+		float translation = XMVectorGetX(XMVector3Length(
+			XMLoadFloat3(&newCameraPosition) - XMLoadFloat3(&cameraPosition)));
+
+		accumulatedTranslation += translation;
+		accumulatedRotation += rotationChord;
+
+		// Large jumps would force most entities to be re-tested anyway
+		if (translation > jumpDistance || rotationChord > 2.0f * sinf(jumpAngle * 0.5f))
+			fullPass = true;
+	}
+
+	// Rebase the accumulators before they get large enough to lose precision
+	if (accumulatedTranslation > 10000.0f || accumulatedRotation > 10000.0f)
+	{
+		accumulatedTranslation = 0;
+		accumulatedRotation = 0;
+		fullPass = true;
+	}
+
+	// Save the camera state for the next frame
+	cameraPosition = newCameraPosition;
+	lastViewMatrix = viewMatrix;
+	lastProjectionMatrix = projectionMatrix;
+	hasLastCamera = true;
+	fullPassRequested = false;
+
+	ExtractFrustumPlanes(viewMatrix, projectionMatrix);
+
+	// Work out which slice of entities gets a routine re-test this frame
+	unsigned int entityCount = (unsigned int)entities.size();
+	unsigned int rotatingCount = (entityCount + retestFrames - 1) / retestFrames;
+
+	testsLastFrame = 0;
+	skippedLastFrame = 0;
+	fullPassLastFrame = fullPass;
+	visibleEntities.clear();
+
+	for (unsigned int i = 0; i < entityCount; i++)
+	{
+		bool inRotatingSlice = ((i + entityCount - retestCursor) % entityCount) < rotatingCount;
+
+		if (fullPass || inRotatingSlice || NeedsRetest(entities[i], visibility[i]))
+		{
+			TestEntity(entities[i], visibility[i]);
+			testsLastFrame++;
+		}
+		else
+		{
+			skippedLastFrame++;
+		}
+
+		if (visibility[i].Visible)
+			visibleEntities.push_back(i);
+	}
+
+	// Move the rotating slice forward for next frame
+	if (entityCount > 0)
+		retestCursor = (retestCursor + rotatingCount) % entityCount;
+}
+
+void CullingSystem::ForceFullPass()
+{
+	fullPassRequested = true;
+}
+
+void CullingSystem::SetRetestFrames(unsigned int frames)
+{
+	retestFrames = frames > 1 ? frames : 1;
+}
+
+void CullingSystem::SetJumpThresholds(float distance, float angle)
+{
+	jumpDistance = distance;
+	jumpAngle = angle;
+}
+
+unsigned int CullingSystem::GetTestsLastFrame()
+{
+	return testsLastFrame;
+}
+
+unsigned int CullingSystem::GetSkippedLastFrame()
+{
+	return skippedLastFrame;
+}
+
+bool CullingSystem::GetFullPassLastFrame()
+{
+	return fullPassLastFrame;
+}
+
+bool CullingSystem::IsSphereVisible(XMFLOAT3 center, float radius)
+{
+	XMVECTOR centerVec = XMLoadFloat3(&center);
+	for (int i = 0; i < 6; i++)
+	{
+		if (XMVectorGetX(XMPlaneDotCoord(XMLoadFloat4(&planes[i]), centerVec)) < -radius)
+			return false;
+	}
+	return true;
+}
+
+void CullingSystem::ExtractFrustumPlanes(XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectionMatrix)
+{
+	// The camera's matrices are already transposed, so multiplying them in reverse
+	// order gives the transpose of view * projection.  The rows of that are the
+	// columns of view * projection, which is what plane extraction needs.
+	XMMATRIX viewProjT = XMMatrixMultiply(XMLoadFloat4x4(&projectionMatrix), XMLoadFloat4x4(&viewMatrix));
+	XMVECTOR c0 = viewProjT.r[0];
+	XMVECTOR c1 = viewProjT.r[1];
+	XMVECTOR c2 = viewProjT.r[2];
+	XMVECTOR c3 = viewProjT.r[3];
+
+	XMVECTOR extracted[6] =
+	{
+		c3 + c0, // Left
+		c3 - c0, // Right
+		c3 + c1, // Bottom
+		c3 - c1, // Top
+		c2,      // Near (DirectX clip space depth starts at 0)
+		c3 - c2  // Far
+	};
+
+	// Normalize so plane distances are in world units
+	for (int i = 0; i < 6; i++)
+		XMStoreFloat4(&planes[i], XMPlaneNormalize(extracted[i]));
+}
+
+void CullingSystem::TestEntity(Entity& entity, EntityVisibility& visibility)
+{
+	XMFLOAT3 center = entity.GetBoundsCenter();
+	float radius = entity.GetBoundsRadius();
+	XMVECTOR centerVec = XMLoadFloat3(&center);
+
+	// Find the plane the sphere is farthest outside of (if any)
+	float margin = 0;
+	bool visible = true;
+	for (int i = 0; i < 6; i++)
+	{
+		float distance = XMVectorGetX(XMPlaneDotCoord(XMLoadFloat4(&planes[i]), centerVec));
+		if (distance < -radius)
+		{
+			visible = false;
+			if (-radius - distance > margin)
+				margin = -radius - distance;
+		}
+	}
+
+	// Remember everything needed to decide when this result could become stale
+	visibility.Visible = visible;
+	visibility.Margin = margin;
+	visibility.TransformVersion = entity.GetTransformVersion();
+	visibility.CameraDistance = XMVectorGetX(XMVector3Length(centerVec - XMLoadFloat3(&cameraPosition)));
+	visibility.TranslationAtTest = accumulatedTranslation;
+	visibility.RotationAtTest = accumulatedRotation;
+}
+
+bool CullingSystem::NeedsRetest(Entity& entity, EntityVisibility& visibility)
+{
+	// Moved entities always need a fresh answer
+	if (entity.GetTransformVersion() != visibility.TransformVersion)
+		return true;
+
+	// Visible entities can safely stay visible until their rotating re-test
+	if (visibility.Visible)
+		return false;
+
+	// A culled entity can only become visible if the frustum planes moved past it.
+	// Camera translation moves a plane by at most the distance travelled, and a
+	// rotation moves it by at most the rotation chord times the distance from the camera.
+	float translation = accumulatedTranslation - visibility.TranslationAtTest;
+	float rotation = accumulatedRotation - visibility.RotationAtTest;
+	float planeMovement = translation + rotation * (visibility.CameraDistance + translation);
+
+	return planeMovement >= visibility.Margin;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "Entity.h"
+
+// --------------------------------------------------------
+// Visibility information remembered for a single entity
+// between frames
+// --------------------------------------------------------
+struct EntityVisibility
+{
+	bool Visible;					// Result of the last frustum test
+	unsigned int TransformVersion;	// Entity transform version at the last test
+	float Margin;					// How far the bounds were outside the frustum (0 if visible)
+	float CameraDistance;			// Distance from the camera to the bounds center at the last test
+	float TranslationAtTest;		// Accumulated camera translation at the last test
+	float RotationAtTest;			// Accumulated camera rotation at the last test
+};
+
+// --------------------------------------------------------
+// A culling system that keeps per-entity visibility between
+// frames and only re-tests the entities that might have
+// changed visibility:
+//  - Entities whose transform changed
+//  - Culled entities the camera might have moved in front of
+//  - A rotating subset of everything else
+// A full pass is done after large camera jumps or whenever
+// the projection changes.
+//
+// Entities may be reported as visible for a few frames after
+// they leave the frustum, but an entity inside the frustum
+// is never dropped.
+// --------------------------------------------------------
+class CullingSystem
+{
+public:
+	CullingSystem(); // Constructor
+	~CullingSystem(); // Destructor
+
+	// Fills visibleEntities with the indices of every entity that should be drawn
+	void Cull(
+		std::vector<Entity>& entities,
+		DirectX::XMFLOAT4X4 viewMatrix,
+		DirectX::XMFLOAT4X4 projectionMatrix,
+		std::vector<unsigned int>& visibleEntities);
+
+	// Forces the next Cull() to test every entity
+	void ForceFullPass();
+
+	// Tests a world space sphere against the frustum from the last Cull()
+	bool IsSphereVisible(DirectX::XMFLOAT3 center, float radius);
+
+	// SET methods
+	void SetRetestFrames(unsigned int frames);
+	void SetJumpThresholds(float distance, float angle);
+
+	// GET methods for profiling
+	unsigned int GetTestsLastFrame();
+	unsigned int GetSkippedLastFrame();
+	bool GetFullPassLastFrame();
+
+private:
+	// Helper methods
+	void ExtractFrustumPlanes(DirectX::XMFLOAT4X4 viewMatrix, DirectX::XMFLOAT4X4 projectionMatrix);
+	void TestEntity(Entity& entity, EntityVisibility& visibility);
+	bool NeedsRetest(Entity& entity, EntityVisibility& visibility);
+
+	// Per-entity visibility, indexed the same as the entity vector
+	std::vector<EntityVisibility> visibility;
+
+	// World space frustum planes (xyz = normal pointing inwards, w = distance)
+	DirectX::XMFLOAT4 planes[6];
+
+	// Camera state from the previous frame
+	DirectX::XMFLOAT4X4 lastViewMatrix;
+	DirectX::XMFLOAT4X4 lastProjectionMatrix;
+	DirectX::XMFLOAT3 cameraPosition;
+	bool hasLastCamera;
+	bool fullPassRequested;
+
+	// Total camera translation and rotation (as a chord length on the unit sphere) since startup
+	float accumulatedTranslation;
+	float accumulatedRotation;
+
+	// Every entity is re-tested at least once every this many frames
+	unsigned int retestFrames;
+	unsigned int retestCursor;
+
+	// Camera movement in a single frame beyond these limits triggers a full pass
+	float jumpDistance;
+	float jumpAngle;
+
+	// Stats from the most recent Cull()
+	unsigned int testsLastFrame;
+	unsigned int skippedLastFrame;
+	bool fullPassLastFrame;
+};
+
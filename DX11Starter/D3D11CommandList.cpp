@@ -0,0 +1,43 @@
+// The DirectX backend only exists on Windows
+#ifdef _WIN32
+#include "D3D11CommandList.h"
+
+D3D11CommandList::D3D11CommandList(ID3D11Device* device)
+{
+	deferredContext = 0;
+	commandList = 0;
+	device->CreateDeferredContext(0, &deferredContext);
+	renderContext = new D3D11RenderContext(deferredContext);
+}
+
+D3D11CommandList::~D3D11CommandList()
+{
+	delete renderContext;
+	if (commandList) { commandList->Release(); }
+	if (deferredContext) { deferredContext->Release(); }
+}
+
+IRenderContext* D3D11CommandList::GetContext()
+{
+	return renderContext;
+}
+
+void D3D11CommandList::Begin()
+{
+	if (commandList) { commandList->Release(); commandList = 0; }
+}
+
+void D3D11CommandList::End()
+{
+	// Don't bother restoring the deferred context's state,
+	// the next recording sets up everything it needs
+	if (deferredContext)
+		deferredContext->FinishCommandList(FALSE, &commandList);
+}
+
+void D3D11CommandList::Execute(IRenderContext* target)
+{
+	if (commandList)
+		target->ExecuteCommandList(commandList);
+}
+#endif
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <d3d11.h>
+#include "CommandList.h"
+#include "D3D11RenderContext.h"
+
+// --------------------------------------------------------
+// Command list recorded on a DirectX 11 deferred context
+// --------------------------------------------------------
+class D3D11CommandList : public ICommandList
+{
+public:
+	D3D11CommandList(ID3D11Device* device); // Constructor
+	~D3D11CommandList(); // Destructor
+
+	// False if the deferred context couldn't be created
+	bool IsValid() { return deferredContext != 0; }
+
+	// ICommandList
+	IRenderContext* GetContext();
+	void Begin();
+	void End();
+	void Execute(IRenderContext* target);
+	bool ReplaysIntoTarget() { return false; }
+
+private:
+	ID3D11DeviceContext* deferredContext;
+	D3D11RenderContext* renderContext;
+
+	// The finished list, kept until the next recording starts
+	ID3D11CommandList* commandList;
+};
@@ -0,0 +1,258 @@
+// The DirectX backend only exists on Windows
+#ifdef _WIN32
+#include "D3D11RenderContext.h"
+
+D3D11RenderContext::D3D11RenderContext(ID3D11DeviceContext* context)
+{
+	// We don't own the context, so no AddRef/Release
+	this->context = context;
+
+	// Constant buffer offsets and NO_OVERWRITE maps of constant buffers
+	// need the 11.1 interface, and the driver has to say it handles them
+	context1 = 0;
+	constantBufferOffsets = false;
+	if (context && SUCCEEDED(context->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)&context1)))
+	{
+		ID3D11Device* device = 0;
+		context->GetDevice(&device);
+
+		D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+		if (device && SUCCEEDED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))))
+			constantBufferOffsets = options.ConstantBufferOffsetting && options.MapNoOverwriteOnDynamicConstantBuffer;
+		if (device) { device->Release(); }
+	}
+}
+
+D3D11RenderContext::~D3D11RenderContext()
+{
+	if (context1) { context1->Release(); }
+}
+
+void D3D11RenderContext::IASetInputLayout(ID3D11InputLayout* inputLayout)
+{
+	context->IASetInputLayout(inputLayout);
+}
+
+void D3D11RenderContext::IASetPrimitiveTopology(unsigned int topology)
+{
+	context->IASetPrimitiveTopology((D3D11_PRIMITIVE_TOPOLOGY)topology);
+}
+
+void D3D11RenderContext::IASetVertexBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* strides, const unsigned int* offsets)
+{
+	context->IASetVertexBuffers(startSlot, numBuffers, buffers, strides, offsets);
+}
+
+void D3D11RenderContext::IASetIndexBuffer(ID3D11Buffer* indexBuffer, unsigned int format, unsigned int offset)
+{
+	context->IASetIndexBuffer(indexBuffer, (DXGI_FORMAT)format, offset);
+}
+
+void D3D11RenderContext::VSSetShader(ID3D11VertexShader* shader)
+{
+	context->VSSetShader(shader, 0, 0);
+}
+
+void D3D11RenderContext::VSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers)
+{
+	context->VSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void D3D11RenderContext::VSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views)
+{
+	context->VSSetShaderResources(startSlot, numViews, views);
+}
+
+void D3D11RenderContext::VSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers)
+{
+	context->VSSetSamplers(startSlot, numSamplers, samplers);
+}
+
+void D3D11RenderContext::PSSetShader(ID3D11PixelShader* shader)
+{
+	context->PSSetShader(shader, 0, 0);
+}
+
+void D3D11RenderContext::PSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers)
+{
+	context->PSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void D3D11RenderContext::PSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views)
+{
+	context->PSSetShaderResources(startSlot, numViews, views);
+}
+
+void D3D11RenderContext::PSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers)
+{
+	context->PSSetSamplers(startSlot, numSamplers, samplers);
+}
+
+void D3D11RenderContext::OMSetRenderTargets(unsigned int numViews, ID3D11RenderTargetView* const* renderTargetViews, ID3D11DepthStencilView* depthStencilView)
+{
+	context->OMSetRenderTargets(numViews, renderTargetViews, depthStencilView);
+}
+
+void D3D11RenderContext::RSSetViewport(float topLeftX, float topLeftY, float width, float height, float minDepth, float maxDepth)
+{
+	D3D11_VIEWPORT viewport = {};
+	viewport.TopLeftX = topLeftX;
+	viewport.TopLeftY = topLeftY;
+	viewport.Width = width;
+	viewport.Height = height;
+	viewport.MinDepth = minDepth;
+	viewport.MaxDepth = maxDepth;
+	context->RSSetViewports(1, &viewport);
+}
+
+void D3D11RenderContext::RSSetState(ID3D11RasterizerState* rasterizerState)
+{
+	context->RSSetState(rasterizerState);
+}
+
+void D3D11RenderContext::OMSetBlendState(ID3D11BlendState* blendState)
+{
+	const float blendFactor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	context->OMSetBlendState(blendState, blendFactor, 0xFFFFFFFF);
+}
+
+void D3D11RenderContext::OMSetDepthStencilState(ID3D11DepthStencilState* depthStencilState, unsigned int stencilRef)
+{
+	context->OMSetDepthStencilState(depthStencilState, stencilRef);
+}
+
+void D3D11RenderContext::ClearRenderTargetView(ID3D11RenderTargetView* renderTargetView, const float color[4])
+{
+	context->ClearRenderTargetView(renderTargetView, color);
+}
+
+void D3D11RenderContext::ClearDepthStencilView(ID3D11DepthStencilView* depthStencilView, float depth, unsigned char stencil)
+{
+	context->ClearDepthStencilView(depthStencilView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, depth, stencil);
+}
+
+void D3D11RenderContext::UpdateSubresource(ID3D11Buffer* buffer, const void* data, unsigned int byteSize)
+{
+	// DirectX copies the whole resource, so the size is only needed by other contexts
+	context->UpdateSubresource(buffer, 0, 0, data, 0, 0);
+}
+
+void D3D11RenderContext::UpdateSubresourceRange(ID3D11Buffer* buffer, unsigned int byteOffset, const void* data, unsigned int byteSize)
+{
+	D3D11_BOX box = {};
+	box.left = byteOffset;
+	box.right = byteOffset + byteSize;
+	box.bottom = 1;
+	box.back = 1;
+	context->UpdateSubresource(buffer, 0, &box, data, 0, 0);
+}
+
+// --------------------------------------------------------
+// The view only gives the texture back as a plain resource,
+// and a texture without array slices has one subresource per
+// mip, numbered from the top
+// --------------------------------------------------------
+void D3D11RenderContext::UpdateTextureRegion(ID3D11ShaderResourceView* texture, unsigned int mipLevel, unsigned int left, unsigned int top, unsigned int width, unsigned int height, const void* data, unsigned int rowPitch)
+{
+	ID3D11Resource* resource = 0;
+	texture->GetResource(&resource);
+
+	D3D11_BOX box = {};
+	box.left = left;
+	box.top = top;
+	box.right = left + width;
+	box.bottom = top + height;
+	box.back = 1;
+	context->UpdateSubresource(resource, mipLevel, &box, data, rowPitch, 0);
+
+	resource->Release();
+}
+
+void D3D11RenderContext::SetResourceMinLOD(ID3D11ShaderResourceView* texture, float minLOD)
+{
+	ID3D11Resource* resource = 0;
+	texture->GetResource(&resource);
+	context->SetResourceMinLOD(resource, minLOD);
+	resource->Release();
+}
+
+void D3D11RenderContext::CopyBufferRegion(ID3D11Buffer* destination, unsigned int destinationOffset, ID3D11Buffer* source, unsigned int sourceOffset, unsigned int byteSize)
+{
+	D3D11_BOX box = {};
+	box.left = sourceOffset;
+	box.right = sourceOffset + byteSize;
+	box.bottom = 1;
+	box.back = 1;
+	context->CopySubresourceRegion(destination, 0, destinationOffset, 0, 0, source, 0, &box);
+}
+
+void* D3D11RenderContext::MapDiscard(ID3D11Buffer* buffer)
+{
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(context->Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return 0;
+	return mapped.pData;
+}
+
+void* D3D11RenderContext::MapNoOverwrite(ID3D11Buffer* buffer)
+{
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(context->Map(buffer, 0, D3D11_MAP_WRITE_NO_OVERWRITE, 0, &mapped)))
+		return 0;
+	return mapped.pData;
+}
+
+void* D3D11RenderContext::MapStaging(ID3D11Buffer* buffer)
+{
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(context->Map(buffer, 0, D3D11_MAP_WRITE, 0, &mapped)))
+		return 0;
+	return mapped.pData;
+}
+
+void D3D11RenderContext::Unmap(ID3D11Buffer* buffer)
+{
+	context->Unmap(buffer, 0);
+}
+
+bool D3D11RenderContext::SupportsConstantBufferOffsets()
+{
+	return constantBufferOffsets;
+}
+
+// --------------------------------------------------------
+// Without an 11.1 context these bind whole buffers, which is
+// only right if every range starts at the beginning
+// --------------------------------------------------------
+void D3D11RenderContext::VSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants)
+{
+	if (context1)
+		context1->VSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstants, numConstants);
+	else
+		context->VSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void D3D11RenderContext::PSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants)
+{
+	if (context1)
+		context1->PSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstants, numConstants);
+	else
+		context->PSSetConstantBuffers(startSlot, numBuffers, buffers);
+}
+
+void D3D11RenderContext::DrawIndexed(unsigned int indexCount, unsigned int startIndexLocation, int baseVertexLocation)
+{
+	context->DrawIndexed(indexCount, startIndexLocation, baseVertexLocation);
+}
+
+void D3D11RenderContext::DrawIndexedInstanced(unsigned int indexCountPerInstance, unsigned int instanceCount, unsigned int startIndexLocation, int baseVertexLocation, unsigned int startInstanceLocation)
+{
+	context->DrawIndexedInstanced(indexCountPerInstance, instanceCount, startIndexLocation, baseVertexLocation, startInstanceLocation);
+}
+
+void D3D11RenderContext::ExecuteCommandList(ID3D11CommandList* commandList)
+{
+	// Not restoring our own state is the fast path - callers rebind what they need
+	context->ExecuteCommandList(commandList, FALSE);
+}
+#endif
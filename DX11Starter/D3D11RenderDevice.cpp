@@ -0,0 +1,472 @@
+// The DirectX backend only exists on Windows
+#ifdef _WIN32
+#include "D3D11RenderDevice.h"
+#include "D3D11CommandList.h"
+#include "RecordingCommandList.h"
+
+#include <vector>
+
+D3D11RenderDevice::D3D11RenderDevice(ID3D11Device* device, ID3D11DeviceContext* context)
+	: immediateContext(context)
+{
+	this->device = device;
+	this->context = context;
+	renderStats.Reset();
+}
+
+D3D11RenderDevice::~D3D11RenderDevice()
+{
+}
+
+IRenderContext* D3D11RenderDevice::GetImmediateContext()
+{
+	return &immediateContext;
+}
+
+// --------------------------------------------------------
+// Command lists record on deferred contexts, or in software
+// if the driver can't make them
+// --------------------------------------------------------
+ICommandList* D3D11RenderDevice::CreateCommandList()
+{
+	D3D11CommandList* commandList = new D3D11CommandList(device);
+	if (commandList->IsValid())
+		return commandList;
+	delete commandList;
+	return new RecordingCommandList();
+}
+
+ID3D11Buffer* D3D11RenderDevice::CreateBuffer(const BufferDesc& desc, const void* initialData)
+{
+	D3D11_BUFFER_DESC bd = {};
+	bd.ByteWidth = desc.ByteWidth;
+	bd.StructureByteStride = desc.StructureByteStride;
+	if (desc.BindFlags & BUFFER_BIND_VERTEX) bd.BindFlags |= D3D11_BIND_VERTEX_BUFFER;
+	if (desc.BindFlags & BUFFER_BIND_INDEX) bd.BindFlags |= D3D11_BIND_INDEX_BUFFER;
+	if (desc.BindFlags & BUFFER_BIND_CONSTANT) bd.BindFlags |= D3D11_BIND_CONSTANT_BUFFER;
+	if (desc.BindFlags & BUFFER_BIND_SHADER_RESOURCE) bd.BindFlags |= D3D11_BIND_SHADER_RESOURCE;
+	if (desc.StructureByteStride > 0) bd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+
+	switch (desc.Usage)
+	{
+	case BUFFER_USAGE_DEFAULT: bd.Usage = D3D11_USAGE_DEFAULT; break;
+	case BUFFER_USAGE_IMMUTABLE: bd.Usage = D3D11_USAGE_IMMUTABLE; break;
+	case BUFFER_USAGE_DYNAMIC:
+		bd.Usage = D3D11_USAGE_DYNAMIC;
+		bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		break;
+	case BUFFER_USAGE_STAGING:
+		bd.Usage = D3D11_USAGE_STAGING;
+		bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		break;
+	}
+
+	D3D11_SUBRESOURCE_DATA data = {};
+	data.pSysMem = initialData;
+
+	ID3D11Buffer* buffer = 0;
+	if (FAILED(device->CreateBuffer(&bd, initialData ? &data : 0, &buffer)))
+		return 0;
+
+	RENDER_STATS(renderStats.BuffersCreated++);
+	RENDER_STATS(if (initialData) renderStats.BytesUploaded += desc.ByteWidth);
+	return buffer;
+}
+
+// --------------------------------------------------------
+// Creates the texture and a view of it.  With more than one
+// mip the top level is uploaded and the rest are generated.
+// --------------------------------------------------------
+ID3D11ShaderResourceView* D3D11RenderDevice::CreateTexture2D(const TextureDesc& desc, const void* initialData, unsigned int rowPitch)
+{
+	bool generateMips = desc.MipLevels != 1 && initialData;
+
+	D3D11_TEXTURE2D_DESC td = {};
+	td.Width = desc.Width;
+	td.Height = desc.Height;
+	td.MipLevels = desc.MipLevels;
+	td.ArraySize = 1;
+	td.Format = (DXGI_FORMAT)desc.Format;
+	td.SampleDesc.Count = 1;
+	td.Usage = D3D11_USAGE_DEFAULT;
+	td.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	if (generateMips)
+	{
+		td.BindFlags |= D3D11_BIND_RENDER_TARGET;
+		td.MiscFlags = D3D11_RESOURCE_MISC_GENERATE_MIPS;
+	}
+
+	D3D11_SUBRESOURCE_DATA data = {};
+	data.pSysMem = initialData;
+	data.SysMemPitch = rowPitch;
+
+	ID3D11Texture2D* texture = 0;
+	if (FAILED(device->CreateTexture2D(&td, (initialData && !generateMips) ? &data : 0, &texture)))
+		return 0;
+
+	ID3D11ShaderResourceView* srv = 0;
+	HRESULT hr = device->CreateShaderResourceView(texture, 0, &srv);
+	if (SUCCEEDED(hr) && generateMips)
+	{
+		context->UpdateSubresource(texture, 0, 0, initialData, rowPitch, 0);
+		context->GenerateMips(srv);
+	}
+
+	// The view holds its own reference to the texture
+	texture->Release();
+	if (FAILED(hr))
+		return 0;
+
+	RENDER_STATS(renderStats.TexturesCreated++);
+	RENDER_STATS(if (initialData) renderStats.BytesUploaded += (unsigned long long)rowPitch * desc.Height);
+	return srv;
+}
+
+ID3D11ShaderResourceView* D3D11RenderDevice::CreateBufferShaderResourceView(ID3D11Buffer* structuredBuffer, unsigned int elementCount)
+{
+	// Structured buffers have no format, the stride comes from the buffer
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	srvDesc.Buffer.FirstElement = 0;
+	srvDesc.Buffer.NumElements = elementCount;
+
+	ID3D11ShaderResourceView* srv = 0;
+	if (FAILED(device->CreateShaderResourceView(structuredBuffer, &srvDesc, &srv)))
+		return 0;
+	return srv;
+}
+
+ID3D11SamplerState* D3D11RenderDevice::CreateSamplerState(const SamplerDesc& desc)
+{
+	D3D11_TEXTURE_ADDRESS_MODE address =
+		desc.AddressMode == SAMPLER_ADDRESS_CLAMP ? D3D11_TEXTURE_ADDRESS_CLAMP : D3D11_TEXTURE_ADDRESS_WRAP;
+
+	D3D11_SAMPLER_DESC sd = {};
+	sd.AddressU = address;
+	sd.AddressV = address;
+	sd.AddressW = address;
+	sd.MaxAnisotropy = desc.MaxAnisotropy;
+	sd.ComparisonFunc = D3D11_COMPARISON_NEVER;
+	sd.MaxLOD = D3D11_FLOAT32_MAX; // This value needs to be higher than 0 for mipmapping to work
+
+	switch (desc.Filter)
+	{
+	case SAMPLER_FILTER_POINT: sd.Filter = D3D11_FILTER_MIN_MAG_MIP_POINT; break;
+	case SAMPLER_FILTER_LINEAR: sd.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR; break;
+	case SAMPLER_FILTER_ANISOTROPIC: sd.Filter = D3D11_FILTER_ANISOTROPIC; break;
+	}
+
+	ID3D11SamplerState* samplerState = 0;
+	if (FAILED(device->CreateSamplerState(&sd, &samplerState)))
+		return 0;
+	return samplerState;
+}
+
+ID3D11RasterizerState* D3D11RenderDevice::CreateRasterizerState(const RasterizerDesc& desc)
+{
+	D3D11_RASTERIZER_DESC rd = {};
+	rd.FillMode = desc.FillMode == RASTERIZER_FILL_WIREFRAME ? D3D11_FILL_WIREFRAME : D3D11_FILL_SOLID;
+	rd.FrontCounterClockwise = desc.FrontCounterClockwise;
+	rd.DepthBias = desc.DepthBias;
+	rd.DepthClipEnable = !desc.DepthClipDisable;
+	rd.ScissorEnable = desc.ScissorEnable;
+
+	switch (desc.CullMode)
+	{
+	case RASTERIZER_CULL_BACK: rd.CullMode = D3D11_CULL_BACK; break;
+	case RASTERIZER_CULL_FRONT: rd.CullMode = D3D11_CULL_FRONT; break;
+	case RASTERIZER_CULL_NONE: rd.CullMode = D3D11_CULL_NONE; break;
+	}
+
+	ID3D11RasterizerState* rasterizerState = 0;
+	if (FAILED(device->CreateRasterizerState(&rd, &rasterizerState)))
+		return 0;
+	return rasterizerState;
+}
+
+ID3D11BlendState* D3D11RenderDevice::CreateBlendState(const BlendDesc& desc)
+{
+	D3D11_BLEND_DESC bd = {};
+	bd.AlphaToCoverageEnable = desc.AlphaToCoverage;
+
+	D3D11_RENDER_TARGET_BLEND_DESC& target = bd.RenderTarget[0];
+	target.RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+	target.BlendOp = D3D11_BLEND_OP_ADD;
+	target.BlendOpAlpha = D3D11_BLEND_OP_ADD;
+	target.SrcBlendAlpha = D3D11_BLEND_ONE;
+	target.DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+
+	switch (desc.Mode)
+	{
+	case BLEND_OPAQUE:
+		target.BlendEnable = FALSE;
+		target.SrcBlend = D3D11_BLEND_ONE;
+		target.DestBlend = D3D11_BLEND_ZERO;
+		target.DestBlendAlpha = D3D11_BLEND_ZERO;
+		break;
+	case BLEND_ALPHA:
+		target.BlendEnable = TRUE;
+		target.SrcBlend = D3D11_BLEND_SRC_ALPHA;
+		target.DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+		break;
+	case BLEND_PREMULTIPLIED:
+		target.BlendEnable = TRUE;
+		target.SrcBlend = D3D11_BLEND_ONE;
+		target.DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+		break;
+	case BLEND_ADDITIVE:
+		target.BlendEnable = TRUE;
+		target.SrcBlend = D3D11_BLEND_SRC_ALPHA;
+		target.DestBlend = D3D11_BLEND_ONE;
+		target.DestBlendAlpha = D3D11_BLEND_ONE;
+		break;
+	}
+
+	ID3D11BlendState* blendState = 0;
+	if (FAILED(device->CreateBlendState(&bd, &blendState)))
+		return 0;
+	return blendState;
+}
+
+ID3D11DepthStencilState* D3D11RenderDevice::CreateDepthStencilState(const DepthStencilDesc& desc)
+{
+	D3D11_DEPTH_STENCIL_DESC dd = {};
+	dd.DepthEnable = !desc.DepthDisable;
+	dd.DepthWriteMask = desc.DepthWriteDisable ? D3D11_DEPTH_WRITE_MASK_ZERO : D3D11_DEPTH_WRITE_MASK_ALL;
+	dd.StencilEnable = FALSE;
+
+	switch (desc.Func)
+	{
+	case DEPTH_FUNC_LESS: dd.DepthFunc = D3D11_COMPARISON_LESS; break;
+	case DEPTH_FUNC_LESS_EQUAL: dd.DepthFunc = D3D11_COMPARISON_LESS_EQUAL; break;
+	case DEPTH_FUNC_EQUAL: dd.DepthFunc = D3D11_COMPARISON_EQUAL; break;
+	case DEPTH_FUNC_GREATER: dd.DepthFunc = D3D11_COMPARISON_GREATER; break;
+	case DEPTH_FUNC_GREATER_EQUAL: dd.DepthFunc = D3D11_COMPARISON_GREATER_EQUAL; break;
+	case DEPTH_FUNC_ALWAYS: dd.DepthFunc = D3D11_COMPARISON_ALWAYS; break;
+	}
+
+	ID3D11DepthStencilState* depthStencilState = 0;
+	if (FAILED(device->CreateDepthStencilState(&dd, &depthStencilState)))
+		return 0;
+	return depthStencilState;
+}
+
+ID3D11VertexShader* D3D11RenderDevice::CreateVertexShader(const void* byteCode, size_t byteCodeSize)
+{
+	ID3D11VertexShader* shader = 0;
+	if (FAILED(device->CreateVertexShader(byteCode, byteCodeSize, 0, &shader)))
+		return 0;
+	return shader;
+}
+
+ID3D11PixelShader* D3D11RenderDevice::CreatePixelShader(const void* byteCode, size_t byteCodeSize)
+{
+	ID3D11PixelShader* shader = 0;
+	if (FAILED(device->CreatePixelShader(byteCode, byteCodeSize, 0, &shader)))
+		return 0;
+	return shader;
+}
+
+ID3D11InputLayout* D3D11RenderDevice::CreateInputLayout(const InputElementDesc* elements, unsigned int elementCount, const void* byteCode, size_t byteCodeSize)
+{
+	std::vector<D3D11_INPUT_ELEMENT_DESC> d3dElements(elementCount);
+	for (unsigned int i = 0; i < elementCount; i++)
+	{
+		d3dElements[i].SemanticName = elements[i].SemanticName;
+		d3dElements[i].SemanticIndex = elements[i].SemanticIndex;
+		d3dElements[i].Format = (DXGI_FORMAT)elements[i].Format;
+		d3dElements[i].InputSlot = elements[i].InputSlot;
+		d3dElements[i].AlignedByteOffset = elements[i].AlignedByteOffset;
+		d3dElements[i].InputSlotClass = elements[i].PerInstance ? D3D11_INPUT_PER_INSTANCE_DATA : D3D11_INPUT_PER_VERTEX_DATA;
+		d3dElements[i].InstanceDataStepRate = elements[i].InstanceDataStepRate;
+	}
+
+	ID3D11InputLayout* inputLayout = 0;
+	if (elementCount == 0 || FAILED(device->CreateInputLayout(&d3dElements[0], elementCount, byteCode, byteCodeSize, &inputLayout)))
+		return 0;
+	return inputLayout;
+}
+
+// --------------------------------------------------------
+// Every mip of each texture is copied on the GPU into its
+// slice, so the textures can be released straight after
+// --------------------------------------------------------
+ID3D11ShaderResourceView* D3D11RenderDevice::CreateTexture2DArray(ID3D11ShaderResourceView* const* textures, unsigned int textureCount)
+{
+	TextureDesc shape;
+	if (textureCount == 0 || !GetTextureDesc(textures[0], shape))
+		return 0;
+
+	for (unsigned int i = 1; i < textureCount; i++)
+	{
+		TextureDesc desc;
+		if (!GetTextureDesc(textures[i], desc) ||
+			desc.Width != shape.Width || desc.Height != shape.Height ||
+			desc.MipLevels != shape.MipLevels || desc.Format != shape.Format)
+			return 0;
+	}
+
+	D3D11_TEXTURE2D_DESC td = {};
+	td.Width = shape.Width;
+	td.Height = shape.Height;
+	td.MipLevels = shape.MipLevels;
+	td.ArraySize = textureCount;
+	td.Format = (DXGI_FORMAT)shape.Format;
+	td.SampleDesc.Count = 1;
+	td.Usage = D3D11_USAGE_DEFAULT;
+	td.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	ID3D11Texture2D* array = 0;
+	if (FAILED(device->CreateTexture2D(&td, 0, &array)))
+		return 0;
+
+	for (unsigned int i = 0; i < textureCount; i++)
+	{
+		ID3D11Resource* source = 0;
+		textures[i]->GetResource(&source);
+		for (unsigned int mip = 0; mip < shape.MipLevels; mip++)
+			context->CopySubresourceRegion(array, D3D11CalcSubresource(mip, i, shape.MipLevels), 0, 0, 0, source, mip, 0);
+		source->Release();
+	}
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = td.Format;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+	srvDesc.Texture2DArray.MostDetailedMip = 0;
+	srvDesc.Texture2DArray.MipLevels = shape.MipLevels;
+	srvDesc.Texture2DArray.FirstArraySlice = 0;
+	srvDesc.Texture2DArray.ArraySize = textureCount;
+
+	// The view holds its own reference to the texture
+	ID3D11ShaderResourceView* srv = 0;
+	HRESULT hr = device->CreateShaderResourceView(array, &srvDesc, &srv);
+	array->Release();
+	if (FAILED(hr))
+		return 0;
+
+	RENDER_STATS(renderStats.TexturesCreated++);
+	return srv;
+}
+
+bool D3D11RenderDevice::GetTextureDesc(ID3D11ShaderResourceView* texture, TextureDesc& desc)
+{
+	if (!texture)
+		return false;
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+	texture->GetDesc(&srvDesc);
+	if (srvDesc.ViewDimension != D3D11_SRV_DIMENSION_TEXTURE2D && srvDesc.ViewDimension != D3D11_SRV_DIMENSION_TEXTURE2DARRAY)
+		return false;
+
+	ID3D11Resource* resource = 0;
+	ID3D11Texture2D* texture2D = 0;
+	texture->GetResource(&resource);
+	HRESULT hr = resource->QueryInterface(__uuidof(ID3D11Texture2D), (void**)&texture2D);
+	resource->Release();
+	if (FAILED(hr))
+		return false;
+
+	D3D11_TEXTURE2D_DESC td;
+	texture2D->GetDesc(&td);
+	texture2D->Release();
+
+	desc.Width = td.Width;
+	desc.Height = td.Height;
+	desc.MipLevels = td.MipLevels;
+	desc.Format = td.Format;
+	return true;
+}
+
+// --------------------------------------------------------
+// Depth textures that are also read by shaders need a typeless
+// format, with the depth and shader views each picking their
+// own interpretation of it
+// --------------------------------------------------------
+bool D3D11RenderDevice::CreateRenderTexture(const RenderTextureDesc& desc, RenderTexture& texture)
+{
+	texture = {};
+
+	DXGI_FORMAT format = (DXGI_FORMAT)desc.Format;
+	DXGI_FORMAT textureFormat = format;
+	DXGI_FORMAT shaderFormat = format;
+	bool depthRead = (desc.BindFlags & TEXTURE_BIND_DEPTH_STENCIL) && (desc.BindFlags & TEXTURE_BIND_SHADER_RESOURCE);
+	if (depthRead && format == DXGI_FORMAT_D24_UNORM_S8_UINT)
+	{
+		textureFormat = DXGI_FORMAT_R24G8_TYPELESS;
+		shaderFormat = DXGI_FORMAT_R24_UNORM_X8_TYPELESS;
+	}
+	else if (depthRead && format == DXGI_FORMAT_D32_FLOAT)
+	{
+		textureFormat = DXGI_FORMAT_R32_TYPELESS;
+		shaderFormat = DXGI_FORMAT_R32_FLOAT;
+	}
+
+	D3D11_TEXTURE2D_DESC td = {};
+	td.Width = desc.Width;
+	td.Height = desc.Height;
+	td.MipLevels = 1;
+	td.ArraySize = 1;
+	td.Format = textureFormat;
+	td.SampleDesc.Count = 1;
+	td.Usage = D3D11_USAGE_DEFAULT;
+	if (desc.BindFlags & TEXTURE_BIND_SHADER_RESOURCE) td.BindFlags |= D3D11_BIND_SHADER_RESOURCE;
+	if (desc.BindFlags & TEXTURE_BIND_RENDER_TARGET) td.BindFlags |= D3D11_BIND_RENDER_TARGET;
+	if (desc.BindFlags & TEXTURE_BIND_DEPTH_STENCIL) td.BindFlags |= D3D11_BIND_DEPTH_STENCIL;
+
+	ID3D11Texture2D* texture2D = 0;
+	if (FAILED(device->CreateTexture2D(&td, 0, &texture2D)))
+		return false;
+	RENDER_STATS(renderStats.TexturesCreated++);
+
+	bool succeeded = true;
+	if (desc.BindFlags & TEXTURE_BIND_RENDER_TARGET)
+		succeeded &= SUCCEEDED(device->CreateRenderTargetView(texture2D, 0, &texture.RenderTargetView));
+
+	if (desc.BindFlags & TEXTURE_BIND_DEPTH_STENCIL)
+	{
+		D3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+		dsvDesc.Format = format;
+		dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+		succeeded &= SUCCEEDED(device->CreateDepthStencilView(texture2D, &dsvDesc, &texture.DepthStencilView));
+	}
+
+	if (desc.BindFlags & TEXTURE_BIND_SHADER_RESOURCE)
+	{
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = shaderFormat;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Texture2D.MipLevels = 1;
+		succeeded &= SUCCEEDED(device->CreateShaderResourceView(texture2D, &srvDesc, &texture.ShaderResourceView));
+	}
+
+	// The views hold their own references to the texture
+	texture2D->Release();
+
+	if (!succeeded)
+	{
+		Release(texture.RenderTargetView);
+		Release(texture.DepthStencilView);
+		Release(texture.ShaderResourceView);
+		texture = {};
+	}
+	return succeeded;
+}
+
+void D3D11RenderDevice::AddRef(ID3D11Buffer* buffer)
+{
+	if (buffer) { buffer->AddRef(); }
+}
+
+void D3D11RenderDevice::Release(ID3D11Buffer* buffer) { if (buffer) { buffer->Release(); } }
+void D3D11RenderDevice::Release(ID3D11ShaderResourceView* shaderResourceView) { if (shaderResourceView) { shaderResourceView->Release(); } }
+void D3D11RenderDevice::Release(ID3D11SamplerState* samplerState) { if (samplerState) { samplerState->Release(); } }
+void D3D11RenderDevice::Release(ID3D11RasterizerState* rasterizerState) { if (rasterizerState) { rasterizerState->Release(); } }
+void D3D11RenderDevice::Release(ID3D11BlendState* blendState) { if (blendState) { blendState->Release(); } }
+void D3D11RenderDevice::Release(ID3D11DepthStencilState* depthStencilState) { if (depthStencilState) { depthStencilState->Release(); } }
+void D3D11RenderDevice::Release(ID3D11VertexShader* shader) { if (shader) { shader->Release(); } }
+void D3D11RenderDevice::Release(ID3D11PixelShader* shader) { if (shader) { shader->Release(); } }
+void D3D11RenderDevice::Release(ID3D11InputLayout* inputLayout) { if (inputLayout) { inputLayout->Release(); } }
+void D3D11RenderDevice::Release(ID3D11RenderTargetView* renderTargetView) { if (renderTargetView) { renderTargetView->Release(); } }
+void D3D11RenderDevice::Release(ID3D11DepthStencilView* depthStencilView) { if (depthStencilView) { depthStencilView->Release(); } }
+#endif
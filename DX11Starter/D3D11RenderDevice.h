@@ -0,0 +1,59 @@
+#pragma once
+
+#include <d3d11.h>
+#include "RenderDevice.h"
+#include "D3D11RenderContext.h"
+
+// --------------------------------------------------------
+// Render device that creates real DirectX 11 objects.  The
+// device and context are borrowed - whoever passed them in
+// is still responsible for releasing them.
+// --------------------------------------------------------
+class D3D11RenderDevice : public IRenderDevice
+{
+public:
+	D3D11RenderDevice(ID3D11Device* device, ID3D11DeviceContext* context); // Constructor
+	~D3D11RenderDevice(); // Destructor
+
+	// GET methods
+	ID3D11Device* GetDevice() { return device; }
+
+	IRenderContext* GetImmediateContext();
+	ICommandList* CreateCommandList();
+
+	ID3D11Buffer* CreateBuffer(const BufferDesc& desc, const void* initialData);
+	ID3D11ShaderResourceView* CreateTexture2D(const TextureDesc& desc, const void* initialData, unsigned int rowPitch);
+	ID3D11ShaderResourceView* CreateBufferShaderResourceView(ID3D11Buffer* structuredBuffer, unsigned int elementCount);
+	ID3D11SamplerState* CreateSamplerState(const SamplerDesc& desc);
+	ID3D11RasterizerState* CreateRasterizerState(const RasterizerDesc& desc);
+	ID3D11BlendState* CreateBlendState(const BlendDesc& desc);
+	ID3D11DepthStencilState* CreateDepthStencilState(const DepthStencilDesc& desc);
+	ID3D11VertexShader* CreateVertexShader(const void* byteCode, size_t byteCodeSize);
+	ID3D11PixelShader* CreatePixelShader(const void* byteCode, size_t byteCodeSize);
+	ID3D11InputLayout* CreateInputLayout(const InputElementDesc* elements, unsigned int elementCount, const void* byteCode, size_t byteCodeSize);
+	ID3D11ShaderResourceView* CreateTexture2DArray(ID3D11ShaderResourceView* const* textures, unsigned int textureCount);
+	bool GetTextureDesc(ID3D11ShaderResourceView* texture, TextureDesc& desc);
+	bool CreateRenderTexture(const RenderTextureDesc& desc, RenderTexture& texture);
+
+	void AddRef(ID3D11Buffer* buffer);
+
+	void Release(ID3D11Buffer* buffer);
+	void Release(ID3D11ShaderResourceView* shaderResourceView);
+	void Release(ID3D11SamplerState* samplerState);
+	void Release(ID3D11RasterizerState* rasterizerState);
+	void Release(ID3D11BlendState* blendState);
+	void Release(ID3D11DepthStencilState* depthStencilState);
+	void Release(ID3D11VertexShader* shader);
+	void Release(ID3D11PixelShader* shader);
+	void Release(ID3D11InputLayout* inputLayout);
+	void Release(ID3D11RenderTargetView* renderTargetView);
+	void Release(ID3D11DepthStencilView* depthStencilView);
+
+	const RenderStatCounters& GetRenderStats() { return renderStats; }
+
+private:
+	ID3D11Device* device;
+	ID3D11DeviceContext* context;
+	D3D11RenderContext immediateContext;
+	RenderStatCounters renderStats;
+};
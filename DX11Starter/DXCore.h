@@ -1,12 +1,18 @@
 #pragma once
 
-#include <Windows.h>
-#include <d3d11.h>
+#include "Platform.h"
 #include <string>
+#include "RenderDevice.h"
+
+// The window and DirectX itself only exist on Windows.  Elsewhere
+// DXCore can only run headless, on the null render device.
+#ifdef _WIN32
+#include <d3d11.h>
 
 // We can include the correct library files here
 // instead of in Visual Studio settings if we want
 #pragma comment(lib, "d3d11.lib")
+#endif
 
 class DXCore
 {
@@ -21,6 +27,7 @@ public:
 
 	// Static requirements for OS-level message processing
 	static DXCore* DXCoreInstance;
+#ifdef _WIN32
 	static LRESULT CALLBACK WindowProc(
 		HWND hWnd,		// Window handle
 		UINT uMsg,		// Message
@@ -35,6 +42,13 @@ public:
 	HRESULT InitWindow();
 	HRESULT InitDirectX();
 	HRESULT Run();				
+#endif
+
+	// Running without a window or GPU, for profiling the CPU side of
+	// a frame.  Everything is created on a null render device and a
+	// fixed number of frames are run as fast as possible.
+	HRESULT InitHeadless();
+	HRESULT RunHeadless(unsigned int frameCount);
 	void Quit();
 	virtual void OnResize();
 	
@@ -49,10 +63,15 @@ public:
 	virtual void OnMouseUp	 (WPARAM buttonState, int x, int y) { }
 	virtual void OnMouseMove (WPARAM buttonState, int x, int y) { }
 	virtual void OnMouseWheel(float wheelDelta,   int x, int y) { }
+
+	// Extra text for the title bar stats, for things only the game knows about
+	virtual std::string GetExtraTitleBarStats() { return ""; }
 	
 protected:
 	HINSTANCE	hInstance;		// The handle to the application
+#ifdef _WIN32
 	HWND		hWnd;			// The handle to the window itself
+#endif
 	std::string titleBarText;	// Custom text in window's title bar
 	bool		titleBarStats;	// Show extra stats in title bar?
 	
@@ -61,25 +80,34 @@ protected:
 	unsigned int height;
 	
 	// DirectX related objects and variables
+#ifdef _WIN32
 	D3D_FEATURE_LEVEL		dxFeatureLevel;
 	IDXGISwapChain*			swapChain;
 	ID3D11Device*			device;
 	ID3D11DeviceContext*	context;
+#endif
 
 	ID3D11RenderTargetView* backBufferRTV;
-	ID3D11DepthStencilView* depthStencilView;
 
+	// Creates everything the game draws with.  Wraps the device and
+	// context above, or stands in for them when running headless,
+	// in which case they (and the swap chain and views) are all null.
+	IRenderDevice*			renderDevice;
+	bool					headless;
+
+#ifdef _WIN32
 	// Helper function for allocating a console window
 	void CreateConsoleWindow(int bufferLines, int bufferColumns, int windowLines, int windowColumns);
+#endif
 
 private:
 	// Timing related data
 	double perfCounterSeconds;
 	float totalTime;
 	float deltaTime;
-	__int64 startTime;
-	__int64 currentTime;
-	__int64 previousTime;
+	long long startTime;
+	long long currentTime;
+	long long previousTime;
 
 	// FPS calculation
 	int fpsFrameCount;
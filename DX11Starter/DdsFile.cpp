@@ -0,0 +1,227 @@
+#include "DdsFile.h"
+#include "MipGenerator.h"
+
+#include <fstream>
+#include <iterator>
+
+// The DXGI_FORMAT values written, kept here so nothing needs
+// the DirectX headers
+static const unsigned int FormatR8 = 61;			// DXGI_FORMAT_R8_UNORM
+static const unsigned int FormatR8G8 = 49;			// DXGI_FORMAT_R8G8_UNORM
+static const unsigned int FormatR8G8B8A8 = 28;		// DXGI_FORMAT_R8G8B8A8_UNORM
+static const unsigned int FormatR8G8B8A8SRGB = 29;	// DXGI_FORMAT_R8G8B8A8_UNORM_SRGB
+static const unsigned int FormatR16 = 56;			// DXGI_FORMAT_R16_UNORM
+static const unsigned int FormatR16G16 = 35;		// DXGI_FORMAT_R16G16_UNORM
+static const unsigned int FormatR16G16B16A16 = 11;	// DXGI_FORMAT_R16G16B16A16_UNORM
+
+// Sizes and flags from the DDS header
+static const unsigned int DdsMagic = 0x20534444;	// "DDS "
+static const unsigned int DdsHeaderSize = 124;
+static const unsigned int DdsPixelFormatSize = 32;
+static const unsigned int DdsFileSize = 4 + DdsHeaderSize + 20;
+static const unsigned int DdsFlags = 0x1 | 0x2 | 0x4 | 0x8 | 0x1000;	// Caps, height, width, pitch and pixel format
+static const unsigned int DdsFlagsMipCount = 0x20000;
+static const unsigned int DdsPixelFormatFourCC = 0x4;
+static const unsigned int DdsFourCCDX10 = 0x30315844;	// "DX10"
+static const unsigned int DdsCapsTexture = 0x1000;
+static const unsigned int DdsCapsMipmaps = 0x8 | 0x400000;	// Complex and mipmap
+static const unsigned int DdsDimensionTexture2D = 3;
+
+unsigned int DdsFile::GetFormat(unsigned int channels, unsigned int bitDepth, bool srgb)
+{
+	if (srgb)
+		return bitDepth == 8 && (channels == 3 || channels == 4) ? FormatR8G8B8A8SRGB : 0;
+
+	if (bitDepth == 8)
+	{
+		switch (channels)
+		{
+		case 1: return FormatR8;
+		case 2: return FormatR8G8;
+		case 3:
+		case 4: return FormatR8G8B8A8;
+		}
+	}
+	else if (bitDepth == 16)
+	{
+		switch (channels)
+		{
+		case 1: return FormatR16;
+		case 2: return FormatR16G16;
+		case 3:
+		case 4: return FormatR16G16B16A16;
+		}
+	}
+	return 0;
+}
+
+void DdsFile::GetTexels(const TextureImage& image, std::vector<unsigned char>& texels, unsigned int& rowPitch)
+{
+	unsigned int texelChannels = image.Channels == 3 ? 4 : image.Channels;
+	unsigned int bytesPerValue = image.BitDepth / 8;
+	rowPitch = image.Width * texelChannels * bytesPerValue;
+	texels.resize((size_t)rowPitch * image.Height);
+
+	// Little endian, like every platform DirectX runs on
+	size_t t = 0;
+	size_t texelCount = (size_t)image.Width * image.Height;
+	for (size_t i = 0; i < texelCount; i++)
+	{
+		for (unsigned int c = 0; c < texelChannels; c++)
+		{
+			unsigned short value = c < image.Channels ? image.Values[i * image.Channels + c] : image.MaxValue();
+			texels[t++] = (unsigned char)(value & 0xFF);
+			if (bytesPerValue == 2)
+				texels[t++] = (unsigned char)(value >> 8);
+		}
+	}
+}
+
+bool DdsFile::Write(const std::vector<TextureImage>& mips, bool srgb, std::vector<unsigned char>& bytes)
+{
+	if (mips.empty())
+		return false;
+
+	const TextureImage& top = mips[0];
+	unsigned int format = GetFormat(top.Channels, top.BitDepth, srgb);
+	if (format == 0 || top.Width == 0 || top.Height == 0 || mips.size() > MipGenerator::GetMipCount(top.Width, top.Height))
+		return false;
+
+	// Every mip has to be the size it'd be in a texture
+	for (size_t m = 0; m < mips.size(); m++)
+	{
+		const TextureImage& mip = mips[m];
+		unsigned int width = top.Width >> m;
+		unsigned int height = top.Height >> m;
+		if (mip.Width != (width > 0 ? width : 1) || mip.Height != (height > 0 ? height : 1) ||
+			mip.Channels != top.Channels || mip.BitDepth != top.BitDepth ||
+			mip.Values.size() != (size_t)mip.Width * mip.Height * mip.Channels)
+			return false;
+	}
+
+	std::vector<unsigned char> texels;
+	unsigned int rowPitch;
+	GetTexels(top, texels, rowPitch);
+
+	// Every header field is 4 bytes, little endian
+	unsigned int header[DdsFileSize / 4] = {};
+	header[0] = DdsMagic;
+	header[1] = DdsHeaderSize;
+	header[2] = DdsFlags | (mips.size() > 1 ? DdsFlagsMipCount : 0);
+	header[3] = top.Height;
+	header[4] = top.Width;
+	header[5] = rowPitch;
+	header[7] = (unsigned int)mips.size();
+	header[19] = DdsPixelFormatSize;
+	header[20] = DdsPixelFormatFourCC;
+	header[21] = DdsFourCCDX10;
+	header[27] = DdsCapsTexture | (mips.size() > 1 ? DdsCapsMipmaps : 0);
+	header[32] = format;
+	header[33] = DdsDimensionTexture2D;
+	header[35] = 1;	// Array size
+
+	bytes.clear();
+	for (unsigned int h = 0; h < DdsFileSize / 4; h++)
+	{
+		for (int i = 0; i < 4; i++)
+			bytes.push_back((unsigned char)((header[h] >> (i * 8)) & 0xFF));
+	}
+	bytes.insert(bytes.end(), texels.begin(), texels.end());
+	for (size_t m = 1; m < mips.size(); m++)
+	{
+		GetTexels(mips[m], texels, rowPitch);
+		bytes.insert(bytes.end(), texels.begin(), texels.end());
+	}
+	return true;
+}
+
+bool DdsFile::Read(const unsigned char* bytes, size_t byteCount, std::vector<TextureImage>& mips)
+{
+	if (!bytes || byteCount < DdsFileSize)
+		return false;
+
+	unsigned int header[DdsFileSize / 4];
+	for (unsigned int h = 0; h < DdsFileSize / 4; h++)
+	{
+		const unsigned char* p = bytes + h * 4;
+		header[h] = p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+	}
+	if (header[0] != DdsMagic || header[1] != DdsHeaderSize || header[19] != DdsPixelFormatSize ||
+		!(header[20] & DdsPixelFormatFourCC) || header[21] != DdsFourCCDX10 ||
+		header[33] != DdsDimensionTexture2D || header[35] != 1)
+		return false;
+
+	unsigned int width = header[4];
+	unsigned int height = header[3];
+	unsigned int format = header[32];
+	unsigned int channels = 0;
+	unsigned int bitDepth = 0;
+	for (unsigned int c = 1; c <= 4 && channels == 0; c++)
+	{
+		if (c == 3)
+			continue;
+		if (GetFormat(c, 8) == format || GetFormat(c, 8, true) == format) { channels = c; bitDepth = 8; }
+		if (GetFormat(c, 16) == format) { channels = c; bitDepth = 16; }
+	}
+	if (channels == 0 || width == 0 || height == 0 || width > 16384 || height > 16384)
+		return false;
+
+	// No mip count means just the top one
+	unsigned int mipCount = (header[2] & DdsFlagsMipCount) && header[7] > 0 ? header[7] : 1;
+	if (mipCount > MipGenerator::GetMipCount(width, height))
+		return false;
+
+	// Every mip has to all be there
+	std::vector<TextureImage> result(mipCount);
+	size_t bytesPerValue = bitDepth / 8;
+	const unsigned char* texels = bytes + DdsFileSize;
+	size_t bytesLeft = byteCount - DdsFileSize;
+	for (unsigned int m = 0; m < mipCount; m++)
+	{
+		TextureImage& image = result[m];
+		image.Width = width >> m > 0 ? width >> m : 1;
+		image.Height = height >> m > 0 ? height >> m : 1;
+		image.Channels = channels;
+		image.BitDepth = bitDepth;
+
+		size_t valueCount = (size_t)image.Width * image.Height * channels;
+		if (bytesLeft / bytesPerValue < valueCount)
+			return false;
+
+		image.Values.resize(valueCount);
+		for (size_t i = 0; i < valueCount; i++)
+		{
+			const unsigned char* p = texels + i * bytesPerValue;
+			image.Values[i] = (unsigned short)(bytesPerValue == 2 ? p[0] | (p[1] << 8) : p[0]);
+		}
+		texels += valueCount * bytesPerValue;
+		bytesLeft -= valueCount * bytesPerValue;
+	}
+
+	mips.swap(result);
+	return true;
+}
+
+bool DdsFile::Save(const std::string& path, const std::vector<TextureImage>& mips, bool srgb)
+{
+	std::vector<unsigned char> bytes;
+	if (!Write(mips, srgb, bytes))
+		return false;
+
+	std::ofstream file(path.c_str(), std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	file.write((const char*)&bytes[0], bytes.size());
+	return file.good();
+}
+
+bool DdsFile::Load(const std::string& path, std::vector<TextureImage>& mips)
+{
+	std::ifstream file(path.c_str(), std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	return Read(bytes.empty() ? 0 : &bytes[0], bytes.size(), mips);
+}
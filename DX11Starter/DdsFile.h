@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "TiffReader.h"
+
+// --------------------------------------------------------
+// Reads and writes uncompressed DDS files with the DX10
+// header, holding one 2D image of 8 or 16 bit unsigned
+// normalized channels and any mips below it.  Images with 3
+// channels are written with a 4th at full, since DXGI has no
+// 3 channel formats.  8 bit images with 3 or 4 channels can
+// be marked as sRGB.
+//
+// Reading only accepts the same kind of file, which is all
+// the texture cooker writes.  Only needs the standard library.
+// --------------------------------------------------------
+class DdsFile
+{
+public:
+	// The DXGI_FORMAT an image is written as, or 0 if it can't be
+	static unsigned int GetFormat(unsigned int channels, unsigned int bitDepth, bool srgb = false);
+
+	// The image's values as the texture would hold them, rows packed
+	// tightly.  rowPitch is the bytes in each row.
+	static void GetTexels(const TextureImage& image, std::vector<unsigned char>& texels, unsigned int& rowPitch);
+
+	// Converting to and from the file format in memory.  Mips go from
+	// the top down, each half the size of the one before (down to 1),
+	// and can stop before 1x1.
+	static bool Write(const std::vector<TextureImage>& mips, bool srgb, std::vector<unsigned char>& bytes);
+	static bool Read(const unsigned char* bytes, size_t byteCount, std::vector<TextureImage>& mips);
+
+	// Saving and loading files.  Both return false on failure.
+	static bool Save(const std::string& path, const std::vector<TextureImage>& mips, bool srgb);
+	static bool Load(const std::string& path, std::vector<TextureImage>& mips);
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <DirectXMath.h>
+#include "ConstantBufferLayout.h"
 
 // --------------------------------------------------------
 // A struct defining the properties of a directional light
@@ -10,5 +11,20 @@ struct DirectionalLight
 	DirectX::XMFLOAT4 AmbientColor;	// The ambient color of the light
 	DirectX::XMFLOAT4 DiffuseColor;	// The diffuse color of the light
 	DirectX::XMFLOAT3 Direction;	// The direction the light is pointing
-	float Padding;					// Manual Padding to ensure members don't cross 16-byte boundaries in memory
-};
\ No newline at end of file
+	float Padding;					// Pads the light out to a whole register, so arrays of them match HLSL
+};
+
+// Mirrors DirectionalLight in PixelShader.hlsl
+template<> struct HlslLayout<DirectionalLight>
+{
+	static constexpr HlslMemberList<4> Members()
+	{
+		return {{
+			HLSL_MEMBER(DirectionalLight, AmbientColor),
+			HLSL_MEMBER(DirectionalLight, DiffuseColor),
+			HLSL_MEMBER(DirectionalLight, Direction),
+			HLSL_MEMBER(DirectionalLight, Padding)
+		}};
+	}
+};
+static_assert(HlslLayoutMatches<DirectionalLight>(), "DirectionalLight doesn't match its HLSL struct");
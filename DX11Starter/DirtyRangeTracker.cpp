@@ -0,0 +1,145 @@
+#include "DirtyRangeTracker.h"
+
+#include <algorithm>
+
+DirtyRangeTracker::DirtyRangeTracker()
+{
+	elementCount = 0;
+	dirtyCount = 0;
+	maxGap = 8;
+	maxRanges = 16;
+	fullUploadFraction = 0.5f;
+}
+
+void DirtyRangeTracker::Resize(unsigned int elementCount)
+{
+	this->elementCount = elementCount;
+	words.assign((elementCount + 63) / 64, 0);
+	MarkAllDirty();
+}
+
+void DirtyRangeTracker::MarkDirty(unsigned int index)
+{
+	if (index >= elementCount)
+		return;
+
+	unsigned long long bit = 1ull << (index % 64);
+	unsigned long long& word = words[index / 64];
+	if (!(word & bit))
+	{
+		word |= bit;
+		dirtyCount++;
+	}
+}
+
+void DirtyRangeTracker::MarkDirty(unsigned int first, unsigned int count)
+{
+	for (unsigned int i = first; i < first + count && i < elementCount; i++)
+		MarkDirty(i);
+}
+
+void DirtyRangeTracker::MarkAllDirty()
+{
+	for (std::vector<unsigned long long>::size_type i = 0; i != words.size(); i++)
+		words[i] = ~0ull;
+
+	// Keep the bits past the end clear, so they're never counted
+	if (elementCount % 64 != 0)
+		words.back() = (1ull << (elementCount % 64)) - 1;
+	dirtyCount = elementCount;
+}
+
+// --------------------------------------------------------
+// Walks the dirty bits in order, growing the last range when
+// the next dirty element is close enough to it, then fills in
+// the smallest gaps if that left too many ranges
+// --------------------------------------------------------
+bool DirtyRangeTracker::BuildRanges(std::vector<DirtyRange>& ranges)
+{
+	ranges.clear();
+	if (dirtyCount == 0)
+		return false;
+
+	bool full = dirtyCount >= fullUploadFraction * elementCount;
+	if (!full)
+	{
+		for (unsigned int w = 0; w < (unsigned int)words.size(); w++)
+		{
+			unsigned long long word = words[w];
+			if (word == 0)
+				continue;
+
+			for (unsigned int b = 0; b < 64; b++)
+			{
+				if (!(word & (1ull << b)))
+					continue;
+
+				unsigned int index = w * 64 + b;
+				if (!ranges.empty() && index - (ranges.back().First + ranges.back().Count) <= maxGap)
+				{
+					ranges.back().Count = index + 1 - ranges.back().First;
+					continue;
+				}
+
+				DirtyRange range = { index, 1 };
+				ranges.push_back(range);
+			}
+		}
+
+		if (maxRanges > 0 && ranges.size() > maxRanges)
+		{
+			// Find the gap size below which every gap gets filled in
+			unsigned int merges = (unsigned int)ranges.size() - maxRanges;
+			gaps.resize(ranges.size() - 1);
+			for (std::vector<DirtyRange>::size_type i = 0; i != gaps.size(); i++)
+				gaps[i] = ranges[i + 1].First - (ranges[i].First + ranges[i].Count);
+			std::nth_element(gaps.begin(), gaps.begin() + (merges - 1), gaps.end());
+			unsigned int cutoff = gaps[merges - 1];
+
+			// Gaps equal to the cutoff are only filled in while merges are still needed
+			unsigned int smaller = 0;
+			for (std::vector<unsigned int>::size_type i = 0; i != gaps.size(); i++)
+			{
+				if (gaps[i] < cutoff)
+					smaller++;
+			}
+			unsigned int ties = merges - smaller;
+
+			std::vector<DirtyRange>::size_type kept = 0;
+			for (std::vector<DirtyRange>::size_type i = 1; i != ranges.size(); i++)
+			{
+				DirtyRange& last = ranges[kept];
+				unsigned int gap = ranges[i].First - (last.First + last.Count);
+				bool merge = gap < cutoff || (gap == cutoff && ties > 0);
+				if (merge)
+				{
+					if (gap == cutoff)
+						ties--;
+					last.Count = ranges[i].First + ranges[i].Count - last.First;
+				}
+				else
+				{
+					ranges[++kept] = ranges[i];
+				}
+			}
+			ranges.resize(kept + 1);
+		}
+
+		// The gaps count too, since they're uploaded along with everything else
+		unsigned int covered = 0;
+		for (std::vector<DirtyRange>::size_type i = 0; i != ranges.size(); i++)
+			covered += ranges[i].Count;
+		full = covered >= fullUploadFraction * elementCount;
+	}
+
+	if (full)
+	{
+		ranges.clear();
+		DirtyRange range = { 0, elementCount };
+		ranges.push_back(range);
+	}
+
+	std::fill(words.begin(), words.end(), 0ull);
+	dirtyCount = 0;
+	return full;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+
+// A run of elements to upload
+struct DirtyRange
+{
+	unsigned int First;
+	unsigned int Count;
+};
+
+// --------------------------------------------------------
+// Remembers which elements of an array changed since the
+// last upload, and turns them into a few contiguous ranges.
+//
+// Every separate copy has a fixed cost, so dirty runs with
+// only a few clean elements between them are merged, and if
+// there would still be too many ranges the smallest gaps are
+// filled in until there aren't.  Once most of the array would
+// be uploaded anyway, it's cheaper to just upload all of it.
+//
+// Doesn't know anything about the GPU, so it works the same
+// everywhere.
+// --------------------------------------------------------
+class DirtyRangeTracker
+{
+public:
+	DirtyRangeTracker(); // Constructor
+
+	// Changes how many elements are tracked.  Everything starts out dirty.
+	void Resize(unsigned int elementCount);
+
+	// Marking elements as changed
+	void MarkDirty(unsigned int index);
+	void MarkDirty(unsigned int first, unsigned int count);
+	void MarkAllDirty();
+
+	// Fills in the ranges to upload and clears every dirty element.
+	// Returns true if the whole array should be uploaded, in which
+	// case there's just the one range.
+	bool BuildRanges(std::vector<DirtyRange>& ranges);
+
+	// SET methods for the coalescing heuristics
+	void SetMaxGap(unsigned int maxGap) { this->maxGap = maxGap; }
+	void SetMaxRanges(unsigned int maxRanges) { this->maxRanges = maxRanges; }
+	void SetFullUploadFraction(float fraction) { fullUploadFraction = fraction; }
+
+	// GET methods
+	unsigned int GetElementCount() { return elementCount; }
+	unsigned int GetDirtyCount() { return dirtyCount; }
+
+private:
+	// One bit per element, so clean stretches can be skipped 64 at a time
+	std::vector<unsigned long long> words;
+	unsigned int elementCount;
+	unsigned int dirtyCount;
+
+	unsigned int maxGap;
+	unsigned int maxRanges;
+	float fullUploadFraction;
+
+	// Reused while building
+	std::vector<unsigned int> gaps;
+};
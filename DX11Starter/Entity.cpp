@@ -14,6 +14,14 @@ Entity::Entity(Mesh* mesh, Material* material)
 	rotation = XMFLOAT3(0, 0, 0);
 	scale = XMFLOAT3(1, 1, 1);
 	worldMatrix = GetIdentityMatrix();
+
+	// Make sure the first Update() builds the world matrix and bounds
+	transformDirty = true;
+	transformVersion = 0;
+	UpdateBounds();
+
+	// Entities can move until they're told otherwise
+	isStatic = false;
 }
 
 Entity::Entity(Entity const & other)
@@ -24,6 +32,11 @@ Entity::Entity(Entity const & other)
 	rotation = other.rotation;
 	scale = other.scale;
 	worldMatrix = other.worldMatrix;
+	transformDirty = other.transformDirty;
+	transformVersion = other.transformVersion;
+	boundsCenter = other.boundsCenter;
+	boundsRadius = other.boundsRadius;
+	isStatic = other.isStatic;
 }
 
 Entity & Entity::operator=(Entity const & other)
@@ -37,6 +50,11 @@ Entity & Entity::operator=(Entity const & other)
 		rotation = other.rotation;
 		scale = other.scale;
 		worldMatrix = other.worldMatrix;
+		transformDirty = other.transformDirty;
+		transformVersion = other.transformVersion;
+		boundsCenter = other.boundsCenter;
+		boundsRadius = other.boundsRadius;
+		isStatic = other.isStatic;
 	}
 	return *this;
 }
@@ -47,11 +65,46 @@ Entity::~Entity()
 
 void Entity::Update(float deltaTime, float totalTime)
 {
+	// Nothing to do if the entity hasn't moved since the last update
+	if (!transformDirty)
+		return;
+
 	// Update the world matrix based on the position, rotation, and scale
 	XMStoreFloat4x4(&worldMatrix,
 		XMMatrixTranslation(position.x, position.y, position.z) *
 		XMMatrixRotationRollPitchYaw(rotation.x, rotation.y, rotation.z) *
 		XMMatrixScaling(scale.x, scale.y, scale.z));
+
+	// Keep the world space bounds in sync with the new matrix
+	UpdateBounds();
+	transformDirty = false;
+	transformVersion++;
+}
+
+void Entity::UpdateBounds()
+{
+	// Without a mesh there is nothing to bound
+	if (mesh == nullptr)
+	{
+		boundsCenter = position;
+		boundsRadius = 0;
+		return;
+	}
+
+	// Move the mesh's bounding sphere center into world space
+	XMMATRIX world = XMLoadFloat4x4(&worldMatrix);
+	XMFLOAT3 localCenter = mesh->GetBoundsCenter();
+	XMStoreFloat3(&boundsCenter, XMVector3TransformCoord(XMLoadFloat3(&localCenter), world));
+
+	// Scale the radius by the longest column of the world matrix's 3x3 so the
+	// sphere stays conservative.  Points are multiplied on the left and the scale
+	// is applied last, so each column is one rotated axis times its scale, and
+	// the longest is exactly the most any direction gets stretched.  The rows mix
+	// the scales together, and can come out shorter under a rotation.
+	XMMATRIX columns = XMMatrixTranspose(world);
+	float maxScaleSq = XMVectorGetX(XMVectorMax(XMVector3LengthSq(columns.r[0]),
+		XMVectorMax(XMVector3LengthSq(columns.r[1]), XMVector3LengthSq(columns.r[2]))));
+	boundsRadius = mesh->GetBoundsRadius() * sqrtf(maxScaleSq);
 }
 
 XMFLOAT4X4 Entity::GetWorldMatrix()
@@ -79,29 +132,67 @@ Mesh* Entity::GetMesh()
 	return mesh;
 }
 
+Material* Entity::GetMaterial()
+{
+	return material;
+}
+
+XMFLOAT3 Entity::GetBoundsCenter()
+{
+	return boundsCenter;
+}
+
+float Entity::GetBoundsRadius()
+{
+	return boundsRadius;
+}
+
+unsigned int Entity::GetTransformVersion()
+{
+	return transformVersion;
+}
+
+bool Entity::IsStatic()
+{
+	return isStatic;
+}
+
 void Entity::SetWorldMatrix(XMFLOAT4X4 worldMatrix)
 {
 	this->worldMatrix = worldMatrix;
+
+	// The matrix was set directly, so the bounds change right away
+	UpdateBounds();
+	transformVersion++;
 }
 
 void Entity::SetPosition(XMFLOAT3 position)
 {
 	this->position = position;
+	transformDirty = true;
 }
 
 void Entity::SetRotation(XMFLOAT3 rotation)
 {
 	this->rotation = rotation;
+	transformDirty = true;
 }
 
 void Entity::SetScale(XMFLOAT3 scale)
 {
 	this->scale = scale;
+	transformDirty = true;
 }
 
 void Entity::SetMesh(Mesh* mesh)
 {
 	this->mesh = mesh;
+	transformDirty = true;
+}
+
+void Entity::SetStatic(bool isStatic)
+{
+	this->isStatic = isStatic;
 }
 
 void Entity::Move(XMFLOAT3 direction, XMFLOAT3 velocity)
@@ -109,6 +200,7 @@ void Entity::Move(XMFLOAT3 direction, XMFLOAT3 velocity)
 	XMVECTOR initialPos = XMLoadFloat3(&position);
 	XMVECTOR movement = XMVector3Rotate(XMLoadFloat3(&velocity), XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&direction)));
 	XMStoreFloat3(&position, initialPos + movement);
+	transformDirty = true;
 }
 
 void Entity::MoveForward(XMFLOAT3 velocity)
@@ -116,6 +208,7 @@ void Entity::MoveForward(XMFLOAT3 velocity)
 	XMVECTOR initialPos = XMLoadFloat3(&position);
 	XMVECTOR movement = XMVector3Rotate(XMLoadFloat3(&velocity), XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&rotation)));
 	XMStoreFloat3(&position, initialPos + movement);
+	transformDirty = true;
 }
 
 XMFLOAT4X4 Entity::GetIdentityMatrix()
@@ -125,7 +218,7 @@ XMFLOAT4X4 Entity::GetIdentityMatrix()
 	return identityMatrix;
 }
 
-void Entity::Draw(ID3D11DeviceContext* context, XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectionMatrix)
+void Entity::Draw(IRenderContext* context, XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectionMatrix)
 {
 	// Prepare the entity's material
 	PrepareMaterial(viewMatrix, projectionMatrix);
@@ -133,8 +226,8 @@ void Entity::Draw(ID3D11DeviceContext* context, XMFLOAT4X4 viewMatrix, XMFLOAT4X
 	// Set buffers in the input assembler
 	//  - Do this ONCE PER OBJECT you're drawing, since each object might
 	//    have different geometry.
-	UINT stride = sizeof(Vertex);
-	UINT offset = 0;
+	unsigned int stride = sizeof(Vertex);
+	unsigned int offset = 0;
 	ID3D11Buffer* vBuffer = GetMesh()->GetVertexBuffer();
 	context->IASetVertexBuffers(0, 1, &vBuffer, &stride, &offset);
 	context->IASetIndexBuffer(GetMesh()->GetIndexBuffer(), DXGI_FORMAT_R32_UINT, 0);
@@ -159,15 +252,18 @@ void Entity::PrepareMaterial(XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectionMatrix)
 	//  - The "SimpleShader" class handles all of that for you.
 
 	// Send the world, view, and projection matrices to the vertex shader
-	material->GetVertexShader()->SetMatrix4x4("view", viewMatrix);
-	material->GetVertexShader()->SetMatrix4x4("projection", projectionMatrix);
-	XMFLOAT4X4 worldMatrixTranspose;
-	XMStoreFloat4x4(&worldMatrixTranspose, XMMatrixTranspose(XMLoadFloat4x4(&GetWorldMatrix())));
-	material->GetVertexShader()->SetMatrix4x4("world", worldMatrixTranspose);
+	//  - They fill its whole constant buffer, so they go in with one copy
+	const MaterialHandles& handles = material->GetHandles();
+	VertexShaderConstants constants = {};
+	XMFLOAT4X4 worldMatrix = GetWorldMatrix();
+	XMStoreFloat4x4(&constants.World, XMMatrixTranspose(XMLoadFloat4x4(&worldMatrix)));
+	constants.View = viewMatrix;
+	constants.Projection = projectionMatrix;
+	constants.TextureSlice = material->GetTextureSlice();
+	material->GetVertexShader()->SetConstantBufferData(handles.Constants, constants);
 
-	// Send the texture information to the pixel shader
-	material->GetPixelShader()->SetSamplerState("samplerState", material->GetSamplerState());
-	material->GetPixelShader()->SetShaderResourceView("textureBaseColor", material->GetShaderResourceView());
+	// The material's texture, sampler and parameters are bound by the
+	// registry that made it, before drawing
 
 	// Once you've set all of the data you care to change for
 	// the next draw call, you need to actually send it to the GPU
@@ -182,3 +278,52 @@ void Entity::PrepareMaterial(XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectionMatrix)
 	material->GetVertexShader()->SetShader();
 	material->GetPixelShader()->SetShader();
 }
+
+void Entity::DrawInstanced(IRenderContext* context, ID3D11Buffer* instanceBuffer, ID3D11ShaderResourceView* transforms, unsigned int instanceCount, unsigned int startInstance)
+{
+	// Bind the material's instanced shaders
+	BindInstancedMaterial(context, transforms);
+
+	// Slot 0 holds the mesh's vertices, slot 1 holds each instance's
+	// transform index and texture slice
+	unsigned int strides[2] = { sizeof(Vertex), sizeof(InstanceData) };
+	unsigned int offsets[2] = { 0, 0 };
+	ID3D11Buffer* vBuffers[2] = { GetMesh()->GetVertexBuffer(), instanceBuffer };
+	context->IASetVertexBuffers(0, 2, vBuffers, strides, offsets);
+	context->IASetIndexBuffer(GetMesh()->GetIndexBuffer(), DXGI_FORMAT_R32_UINT, 0);
+
+	// Draw every instance in one go, starting at this batch's indices
+	context->DrawIndexedInstanced(
+		GetMesh()->GetIndexCount(),
+		instanceCount,
+		0,
+		0,
+		startInstance);
+}
+
+void Entity::PrepareInstancedMaterial(XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectionMatrix)
+{
+	// Only the camera matrices go in the constant buffer, the world
+	// matrices are already in the transform buffer
+	SimpleVertexShader* instancedVertexShader = material->GetInstancedVertexShader();
+	const MaterialHandles& handles = material->GetHandles();
+	InstancedVertexShaderConstants constants;
+	constants.View = viewMatrix;
+	constants.Projection = projectionMatrix;
+	instancedVertexShader->SetConstantBufferData(handles.InstancedConstants, constants);
+
+	// Copy the data to the GPU
+	instancedVertexShader->CopyAllBufferData();
+	material->GetPixelShader()->CopyAllBufferData();
+}
+
+void Entity::BindInstancedMaterial(IRenderContext* context, ID3D11ShaderResourceView* transforms)
+{
+	// The vertex shader looks up each instance's world matrix
+	const MaterialHandles& handles = material->GetHandles();
+	material->GetInstancedVertexShader()->SetShaderResourceView(handles.InstancedTransforms, transforms, context);
+
+	// Set the shaders to use for the next draw
+	material->GetInstancedVertexShader()->SetShader(context);
+	material->GetPixelShader()->SetShader(context);
+}
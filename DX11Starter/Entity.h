@@ -3,6 +3,8 @@
 #include <DirectXMath.h>
 #include "Mesh.h"
 #include "Material.h"
+#include "RenderContext.h"
+#include "InstanceBatcher.h"
 
 // --------------------------------------------------------
 // A Entity class that represents a singular game object
@@ -24,6 +26,11 @@ public:
 	DirectX::XMFLOAT3 GetRotation();
 	DirectX::XMFLOAT3 GetScale();
 	Mesh* GetMesh();
+	Material* GetMaterial();
+	DirectX::XMFLOAT3 GetBoundsCenter();
+	float GetBoundsRadius();
+	unsigned int GetTransformVersion();
+	bool IsStatic();
 
 	// SET methods
 	void SetWorldMatrix(DirectX::XMFLOAT4X4 worldMatrix);
@@ -31,17 +38,32 @@ public:
 	void SetRotation(DirectX::XMFLOAT3 rotation);
 	void SetScale(DirectX::XMFLOAT3 scale);
 	void SetMesh(Mesh* mesh);
+	void SetStatic(bool isStatic);
 
 	// Entity Transform Methods
 	void Move(DirectX::XMFLOAT3 direction, DirectX::XMFLOAT3 velocity);
 	void MoveForward(DirectX::XMFLOAT3 velocity);
 
-	// Helper methods
+	// Helper methods.  Drawing sets the entity's matrices and the
+	// material's shaders - the material's own texture, sampler and
+	// parameters have to be bound through its registry first.
 	DirectX::XMFLOAT4X4 GetIdentityMatrix();
-	void Draw(ID3D11DeviceContext* context, DirectX::XMFLOAT4X4 viewMatrix, DirectX::XMFLOAT4X4 projectionMatrix);
+	void Draw(IRenderContext* context, DirectX::XMFLOAT4X4 viewMatrix, DirectX::XMFLOAT4X4 projectionMatrix);
 	void PrepareMaterial(DirectX::XMFLOAT4X4 viewMatrix, DirectX::XMFLOAT4X4 projectionMatrix);
 
+	// Draws this entity's mesh and material once per instance (the material needs an
+	// instanced vertex shader).  The instance buffer holds an index into the transforms
+	// for each instance.  PrepareInstancedMaterial() must have been called for the
+	// material first - after that drawing only reads shared data, so it's safe from
+	// several threads at once.
+	void DrawInstanced(IRenderContext* context, ID3D11Buffer* instanceBuffer, ID3D11ShaderResourceView* transforms, unsigned int instanceCount, unsigned int startInstance);
+	void PrepareInstancedMaterial(DirectX::XMFLOAT4X4 viewMatrix, DirectX::XMFLOAT4X4 projectionMatrix);
+	void BindInstancedMaterial(IRenderContext* context, ID3D11ShaderResourceView* transforms);
+
 private:
+	// Recalculates the world space bounding sphere from the mesh bounds and world matrix
+	void UpdateBounds();
+
 	// World Matrix representing the entitys current position, rotation, and scale
 	DirectX::XMFLOAT4X4 worldMatrix;
 
@@ -50,10 +72,23 @@ private:
 	DirectX::XMFLOAT3 rotation;
 	DirectX::XMFLOAT3 scale;
 
+	// Set whenever position, rotation or scale change so Update() knows to rebuild the world matrix
+	bool transformDirty;
+
+	// Incremented every time the world matrix changes, lets systems like culling detect movement
+	unsigned int transformVersion;
+
+	// World space bounding sphere
+	DirectX::XMFLOAT3 boundsCenter;
+	float boundsRadius;
+
 	// Entity Mesh
 	Mesh* mesh;
 
 	// Entity Material
 	Material* material;
+
+	// Static entities promise never to move, so they can be merged into static batches
+	bool isStatic;
 };
 
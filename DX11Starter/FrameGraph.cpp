@@ -0,0 +1,463 @@
+#include "FrameGraph.h"
+
+#include <algorithm>
+#include "D3D11Types.h"
+
+FrameGraph::FrameGraph(IRenderDevice* device)
+{
+	this->device = device;
+	transientBytes = 0;
+	unaliasedTransientBytes = 0;
+	peakLiveTransientBytes = 0;
+}
+
+FrameGraph::~FrameGraph()
+{
+	for (std::vector<PooledTexture>::size_type i = 0; i != pool.size(); i++)
+	{
+		device->Release(pool[i].Views.RenderTargetView);
+		device->Release(pool[i].Views.DepthStencilView);
+		device->Release(pool[i].Views.ShaderResourceView);
+	}
+}
+
+void FrameGraph::Reset()
+{
+	resources.clear();
+	passes.clear();
+	allocations.clear();
+}
+
+FrameGraphResource FrameGraph::ImportTexture(const std::string& name, const RenderTextureDesc& desc, const RenderTexture& views)
+{
+	ResourceNode node = {};
+	node.Name = name;
+	node.Desc = desc;
+	node.Imported = true;
+	node.Views = views;
+	node.Allocation = NoAllocation;
+	resources.push_back(node);
+	return (FrameGraphResource)resources.size() - 1;
+}
+
+FrameGraphResource FrameGraph::CreateTexture(const std::string& name, const RenderTextureDesc& desc)
+{
+	ResourceNode node = {};
+	node.Name = name;
+	node.Desc = desc;
+	node.Imported = false;
+	node.Allocation = NoAllocation;
+	resources.push_back(node);
+	return (FrameGraphResource)resources.size() - 1;
+}
+
+unsigned int FrameGraph::AddPass(const std::string& name, FrameGraphExecuteFunction execute)
+{
+	PassNode node = {};
+	node.Name = name;
+	node.Execute = execute;
+	passes.push_back(node);
+	return (unsigned int)passes.size() - 1;
+}
+
+void FrameGraph::Read(unsigned int pass, FrameGraphResource resource)
+{
+	passes[pass].Reads.push_back(resource);
+}
+
+void FrameGraph::Write(unsigned int pass, FrameGraphResource resource)
+{
+	passes[pass].Writes.push_back(resource);
+	resources[resource].Writers.push_back(pass);
+}
+
+bool FrameGraph::Compile()
+{
+	// Every transient texture read has to have been written first
+	for (unsigned int p = 0; p < (unsigned int)passes.size(); p++)
+	{
+		const std::vector<FrameGraphResource>& reads = passes[p].Reads;
+		for (std::vector<FrameGraphResource>::size_type r = 0; r != reads.size(); r++)
+		{
+			const ResourceNode& resource = resources[reads[r]];
+			if (resource.Imported)
+				continue;
+
+			bool written = false;
+			for (std::vector<unsigned int>::size_type w = 0; w != resource.Writers.size(); w++)
+				written = written || resource.Writers[w] < p;
+			if (!written)
+				return false;
+		}
+	}
+
+	CullPasses();
+	ComputeLifetimes();
+	BuildBarriers();
+	AliasResources();
+	return true;
+}
+
+// --------------------------------------------------------
+// Gets real textures for this frame's allocations, then runs
+// the passes in order
+// --------------------------------------------------------
+void FrameGraph::Execute(IRenderContext* context)
+{
+	for (std::vector<PooledTexture>::size_type i = 0; i != pool.size(); i++)
+		pool[i].InUse = false;
+
+	for (std::vector<Allocation>::size_type i = 0; i != allocations.size(); i++)
+		allocations[i].PoolIndex = AcquireTexture(allocations[i].Desc);
+
+	for (std::vector<ResourceNode>::size_type i = 0; i != resources.size(); i++)
+	{
+		ResourceNode& resource = resources[i];
+		if (resource.Imported)
+			continue;
+
+		if (resource.Allocation != NoAllocation && allocations[resource.Allocation].PoolIndex != NoAllocation)
+			resource.Views = pool[allocations[resource.Allocation].PoolIndex].Views;
+		else
+			resource.Views = {};
+	}
+
+	ReleaseIdleTextures();
+
+	for (std::vector<PassNode>::size_type i = 0; i != passes.size(); i++)
+	{
+		if (!passes[i].Culled && passes[i].Execute)
+			passes[i].Execute(context, *this);
+	}
+}
+
+ID3D11RenderTargetView* FrameGraph::GetRenderTargetView(FrameGraphResource resource) const
+{
+	return resources[resource].Views.RenderTargetView;
+}
+
+ID3D11DepthStencilView* FrameGraph::GetDepthStencilView(FrameGraphResource resource) const
+{
+	return resources[resource].Views.DepthStencilView;
+}
+
+ID3D11ShaderResourceView* FrameGraph::GetShaderResourceView(FrameGraphResource resource) const
+{
+	return resources[resource].Views.ShaderResourceView;
+}
+
+bool FrameGraph::GetLifetime(FrameGraphResource resource, unsigned int& firstPass, unsigned int& lastPass)
+{
+	const ResourceNode& node = resources[resource];
+	if (node.FirstPass == NoAllocation)
+		return false;
+
+	firstPass = node.FirstPass;
+	lastPass = node.LastPass;
+	return true;
+}
+
+unsigned long long FrameGraph::GetTextureBytes(const RenderTextureDesc& desc)
+{
+	unsigned int bytesPerPixel;
+	switch (desc.Format)
+	{
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:
+	case DXGI_FORMAT_R32G32B32A32_TYPELESS:
+		bytesPerPixel = 16;
+		break;
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+	case DXGI_FORMAT_R16G16B16A16_UNORM:
+	case DXGI_FORMAT_R32G32_FLOAT:
+		bytesPerPixel = 8;
+		break;
+	case DXGI_FORMAT_R16_FLOAT:
+	case DXGI_FORMAT_R16_UNORM:
+	case DXGI_FORMAT_R8G8_UNORM:
+		bytesPerPixel = 2;
+		break;
+	case DXGI_FORMAT_R8_UNORM:
+		bytesPerPixel = 1;
+		break;
+	default:
+		// Most color and depth formats
+		bytesPerPixel = 4;
+		break;
+	}
+	return (unsigned long long)desc.Width * desc.Height * bytesPerPixel;
+}
+
+// --------------------------------------------------------
+// Works back from the outputs that matter.  Every pass starts
+// with one reference per texture it writes, and a texture
+// nobody reads takes its reference away again.  Imported
+// textures count as read, since something outside the graph
+// uses them.  Passes left with no references are culled, and
+// what they read loses a reader in turn.
+// --------------------------------------------------------
+void FrameGraph::CullPasses()
+{
+	std::vector<unsigned int> readers(resources.size(), 0);
+	for (std::vector<PassNode>::size_type p = 0; p != passes.size(); p++)
+	{
+		PassNode& pass = passes[p];
+		pass.Culled = false;
+		pass.RefCount = (unsigned int)pass.Writes.size();
+		for (std::vector<FrameGraphResource>::size_type r = 0; r != pass.Reads.size(); r++)
+			readers[pass.Reads[r]]++;
+	}
+
+	std::vector<FrameGraphResource> unused;
+	for (unsigned int i = 0; i < (unsigned int)resources.size(); i++)
+	{
+		if (resources[i].Imported)
+			readers[i]++;
+		if (readers[i] == 0)
+			unused.push_back(i);
+	}
+
+	// Passes that write nothing at all can't be needed either
+	std::vector<unsigned int> culled;
+	for (unsigned int p = 0; p < (unsigned int)passes.size(); p++)
+	{
+		if (passes[p].RefCount == 0)
+			culled.push_back(p);
+	}
+
+	while (!unused.empty() || !culled.empty())
+	{
+		if (!unused.empty())
+		{
+			FrameGraphResource resource = unused.back();
+			unused.pop_back();
+
+			const std::vector<unsigned int>& writers = resources[resource].Writers;
+			for (std::vector<unsigned int>::size_type w = 0; w != writers.size(); w++)
+			{
+				PassNode& writer = passes[writers[w]];
+				if (writer.RefCount > 0 && --writer.RefCount == 0)
+					culled.push_back(writers[w]);
+			}
+			continue;
+		}
+
+		unsigned int p = culled.back();
+		culled.pop_back();
+		passes[p].Culled = true;
+
+		const std::vector<FrameGraphResource>& reads = passes[p].Reads;
+		for (std::vector<FrameGraphResource>::size_type r = 0; r != reads.size(); r++)
+		{
+			if (readers[reads[r]] > 0 && --readers[reads[r]] == 0)
+				unused.push_back(reads[r]);
+		}
+	}
+
+	for (std::vector<ResourceNode>::size_type i = 0; i != resources.size(); i++)
+		resources[i].ReadCount = readers[i];
+}
+
+// --------------------------------------------------------
+// The first and last pass (that's still running) touching
+// each texture
+// --------------------------------------------------------
+void FrameGraph::ComputeLifetimes()
+{
+	for (std::vector<ResourceNode>::size_type i = 0; i != resources.size(); i++)
+	{
+		resources[i].FirstPass = NoAllocation;
+		resources[i].LastPass = 0;
+	}
+
+	for (unsigned int p = 0; p < (unsigned int)passes.size(); p++)
+	{
+		const PassNode& pass = passes[p];
+		if (pass.Culled)
+			continue;
+
+		for (int list = 0; list < 2; list++)
+		{
+			const std::vector<FrameGraphResource>& used = list == 0 ? pass.Reads : pass.Writes;
+			for (std::vector<FrameGraphResource>::size_type r = 0; r != used.size(); r++)
+			{
+				ResourceNode& resource = resources[used[r]];
+				if (resource.FirstPass == NoAllocation)
+					resource.FirstPass = p;
+				resource.LastPass = p;
+			}
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Walks the running passes in order, keeping track of how
+// each texture was last used
+// --------------------------------------------------------
+void FrameGraph::BuildBarriers()
+{
+	std::vector<FrameGraphAccess> state(resources.size(), FRAME_GRAPH_ACCESS_NONE);
+	for (std::vector<PassNode>::size_type p = 0; p != passes.size(); p++)
+	{
+		PassNode& pass = passes[p];
+		pass.Barriers.clear();
+		if (pass.Culled)
+			continue;
+
+		for (std::vector<FrameGraphResource>::size_type r = 0; r != pass.Reads.size(); r++)
+		{
+			FrameGraphResource resource = pass.Reads[r];
+			if (state[resource] != FRAME_GRAPH_ACCESS_SHADER_READ)
+			{
+				FrameGraphBarrier barrier = { resource, state[resource], FRAME_GRAPH_ACCESS_SHADER_READ };
+				pass.Barriers.push_back(barrier);
+				state[resource] = FRAME_GRAPH_ACCESS_SHADER_READ;
+			}
+		}
+
+		for (std::vector<FrameGraphResource>::size_type w = 0; w != pass.Writes.size(); w++)
+		{
+			FrameGraphResource resource = pass.Writes[w];
+			FrameGraphAccess access = (resources[resource].Desc.BindFlags & TEXTURE_BIND_DEPTH_STENCIL)
+				? FRAME_GRAPH_ACCESS_DEPTH_WRITE
+				: FRAME_GRAPH_ACCESS_RENDER_TARGET;
+			if (state[resource] != access)
+			{
+				FrameGraphBarrier barrier = { resource, state[resource], access };
+				pass.Barriers.push_back(barrier);
+				state[resource] = access;
+			}
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Hands out allocations in the order textures first get used.
+// A texture moves into an existing allocation with the same
+// description if everything in there is finished with by the
+// time it's needed.
+// --------------------------------------------------------
+void FrameGraph::AliasResources()
+{
+	allocations.clear();
+	transientBytes = 0;
+	unaliasedTransientBytes = 0;
+	peakLiveTransientBytes = 0;
+
+	std::vector<FrameGraphResource> order;
+	for (unsigned int i = 0; i < (unsigned int)resources.size(); i++)
+	{
+		resources[i].Allocation = NoAllocation;
+		if (!resources[i].Imported && resources[i].FirstPass != NoAllocation)
+			order.push_back(i);
+	}
+
+	std::stable_sort(order.begin(), order.end(), [this](FrameGraphResource a, FrameGraphResource b)
+	{
+		return resources[a].FirstPass < resources[b].FirstPass;
+	});
+
+	for (std::vector<FrameGraphResource>::size_type i = 0; i != order.size(); i++)
+	{
+		ResourceNode& resource = resources[order[i]];
+		unaliasedTransientBytes += GetTextureBytes(resource.Desc);
+
+		for (unsigned int a = 0; a < (unsigned int)allocations.size(); a++)
+		{
+			if (allocations[a].LastPass < resource.FirstPass && SameDesc(allocations[a].Desc, resource.Desc))
+			{
+				resource.Allocation = a;
+				allocations[a].LastPass = resource.LastPass;
+				break;
+			}
+		}
+
+		if (resource.Allocation == NoAllocation)
+		{
+			Allocation allocation;
+			allocation.Desc = resource.Desc;
+			allocation.LastPass = resource.LastPass;
+			allocation.PoolIndex = NoAllocation;
+			resource.Allocation = (unsigned int)allocations.size();
+			allocations.push_back(allocation);
+			transientBytes += GetTextureBytes(resource.Desc);
+		}
+	}
+
+	// The most transient memory alive during any one pass
+	for (unsigned int p = 0; p < (unsigned int)passes.size(); p++)
+	{
+		unsigned long long live = 0;
+		for (std::vector<FrameGraphResource>::size_type i = 0; i != order.size(); i++)
+		{
+			const ResourceNode& resource = resources[order[i]];
+			if (resource.FirstPass <= p && p <= resource.LastPass)
+				live += GetTextureBytes(resource.Desc);
+		}
+		if (live > peakLiveTransientBytes)
+			peakLiveTransientBytes = live;
+	}
+}
+
+// --------------------------------------------------------
+// Finds a free pooled texture with this description, or makes
+// a new one.  Returns NoAllocation if creating it failed.
+// --------------------------------------------------------
+unsigned int FrameGraph::AcquireTexture(const RenderTextureDesc& desc)
+{
+	for (unsigned int i = 0; i < (unsigned int)pool.size(); i++)
+	{
+		if (!pool[i].InUse && SameDesc(pool[i].Desc, desc))
+		{
+			pool[i].InUse = true;
+			pool[i].IdleFrames = 0;
+			return i;
+		}
+	}
+
+	PooledTexture texture;
+	texture.Desc = desc;
+	texture.InUse = true;
+	texture.IdleFrames = 0;
+	if (!device->CreateRenderTexture(desc, texture.Views))
+		return NoAllocation;
+
+	pool.push_back(texture);
+	return (unsigned int)pool.size() - 1;
+}
+
+// --------------------------------------------------------
+// Textures that haven't been used for a while (after a resize,
+// say) are given back.  Ones in use this frame never are, so
+// the pool indices in the allocations stay valid.
+// --------------------------------------------------------
+void FrameGraph::ReleaseIdleTextures()
+{
+	std::vector<unsigned int> remap(pool.size(), (unsigned int)NoAllocation);
+	std::vector<PooledTexture>::size_type kept = 0;
+	for (std::vector<PooledTexture>::size_type i = 0; i != pool.size(); i++)
+	{
+		PooledTexture& texture = pool[i];
+		if (!texture.InUse && ++texture.IdleFrames > MaxIdleFrames)
+		{
+			device->Release(texture.Views.RenderTargetView);
+			device->Release(texture.Views.DepthStencilView);
+			device->Release(texture.Views.ShaderResourceView);
+			continue;
+		}
+
+		remap[i] = (unsigned int)kept;
+		pool[kept++] = texture;
+	}
+	pool.resize(kept);
+
+	for (std::vector<Allocation>::size_type i = 0; i != allocations.size(); i++)
+	{
+		if (allocations[i].PoolIndex != NoAllocation)
+			allocations[i].PoolIndex = remap[allocations[i].PoolIndex];
+	}
+}
+
+bool FrameGraph::SameDesc(const RenderTextureDesc& a, const RenderTextureDesc& b)
+{
+	return a.Width == b.Width && a.Height == b.Height && a.Format == b.Format && a.BindFlags == b.BindFlags;
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "RenderDevice.h"
+
+// Handle to a texture declared in a frame graph
+typedef unsigned int FrameGraphResource;
+static const FrameGraphResource FrameGraphInvalidResource = 0xFFFFFFFF;
+
+// --------------------------------------------------------
+// How a pass uses a resource.  A barrier is needed whenever
+// a resource's use changes from one pass to the next.
+// --------------------------------------------------------
+enum FrameGraphAccess
+{
+	FRAME_GRAPH_ACCESS_NONE,			// Not used yet (contents undefined)
+	FRAME_GRAPH_ACCESS_RENDER_TARGET,
+	FRAME_GRAPH_ACCESS_DEPTH_WRITE,
+	FRAME_GRAPH_ACCESS_SHADER_READ
+};
+
+struct FrameGraphBarrier
+{
+	FrameGraphResource Resource;
+	FrameGraphAccess Before;
+	FrameGraphAccess After;
+};
+
+class FrameGraph;
+
+// Called with the context to draw into while the graph executes
+typedef std::function<void(IRenderContext* context, const FrameGraph& graph)> FrameGraphExecuteFunction;
+
+// --------------------------------------------------------
+// Declarative description of a frame's rendering, rebuilt
+// every frame:
+//  - Textures are either imported (the back buffer, owned by
+//    someone else) or transient (made by the graph, and only
+//    alive for the frame)
+//  - Passes declare which textures they read and write, in
+//    the order they should run
+//
+// Compile() then:
+//  - Culls passes whose output nothing uses.  Passes writing
+//    imported textures are always kept.
+//  - Works out each transient texture's lifetime, and the
+//    barriers between passes that use a texture differently
+//  - Aliases transient textures: any two with the same
+//    description whose lifetimes don't overlap share one
+//    texture
+//
+// Compile() needs no render device, so the decisions it makes
+// can be checked without a GPU.  Execute() creates (or reuses
+// from earlier frames) the textures and runs the passes.
+//
+// DirectX 11 tracks hazards between passes itself, so the
+// barriers are only recorded here, not issued.
+// --------------------------------------------------------
+class FrameGraph
+{
+public:
+	FrameGraph(IRenderDevice* device); // Constructor
+	~FrameGraph(); // Destructor
+
+	// Forgets every pass and resource, ready for the next frame.
+	// Pooled textures are kept for reuse.
+	void Reset();
+
+	// Declaring resources
+	FrameGraphResource ImportTexture(const std::string& name, const RenderTextureDesc& desc, const RenderTexture& views);
+	FrameGraphResource CreateTexture(const std::string& name, const RenderTextureDesc& desc);
+
+	// Declaring passes, in the order they should run.  Writes to depth
+	// textures are depth writes, to anything else render target writes.
+	unsigned int AddPass(const std::string& name, FrameGraphExecuteFunction execute);
+	void Read(unsigned int pass, FrameGraphResource resource);
+	void Write(unsigned int pass, FrameGraphResource resource);
+
+	// Culls, orders barriers and aliases.  Returns false if a pass
+	// reads something no earlier pass wrote (and isn't imported).
+	bool Compile();
+
+	// Runs every pass that survived culling
+	void Execute(IRenderContext* context);
+
+	// Views of a resource, only valid while the graph executes
+	ID3D11RenderTargetView* GetRenderTargetView(FrameGraphResource resource) const;
+	ID3D11DepthStencilView* GetDepthStencilView(FrameGraphResource resource) const;
+	ID3D11ShaderResourceView* GetShaderResourceView(FrameGraphResource resource) const;
+
+	// Results of the last Compile()
+	unsigned int GetPassCount() { return (unsigned int)passes.size(); }
+	const std::string& GetPassName(unsigned int pass) { return passes[pass].Name; }
+	bool IsPassCulled(unsigned int pass) { return passes[pass].Culled; }
+	const std::vector<FrameGraphBarrier>& GetBarriers(unsigned int pass) { return passes[pass].Barriers; }
+	bool GetLifetime(FrameGraphResource resource, unsigned int& firstPass, unsigned int& lastPass);
+	unsigned int GetAllocation(FrameGraphResource resource) { return resources[resource].Allocation; }
+	unsigned int GetAllocationCount() { return (unsigned int)allocations.size(); }
+
+	// Transient memory for the frame - after aliasing, without it, and the
+	// most that's ever alive at once (what perfect aliasing would need)
+	unsigned long long GetTransientBytes() { return transientBytes; }
+	unsigned long long GetUnaliasedTransientBytes() { return unaliasedTransientBytes; }
+	unsigned long long GetPeakLiveTransientBytes() { return peakLiveTransientBytes; }
+
+	// Textures held for reuse across frames
+	unsigned int GetPooledTextureCount() { return (unsigned int)pool.size(); }
+
+	// Estimated size of a texture with this description
+	static unsigned long long GetTextureBytes(const RenderTextureDesc& desc);
+
+	// Frames a pooled texture can go unused before it's released
+	static const unsigned int MaxIdleFrames = 4;
+
+	static const unsigned int NoAllocation = 0xFFFFFFFF;
+
+private:
+	struct ResourceNode
+	{
+		std::string Name;
+		RenderTextureDesc Desc;
+		bool Imported;
+		RenderTexture Views;			// Imported views, or the pooled texture's
+		std::vector<unsigned int> Writers;
+		unsigned int ReadCount;			// Passes (not culled) reading it
+		unsigned int FirstPass;
+		unsigned int LastPass;
+		unsigned int Allocation;		// Which aliased texture it lives in
+	};
+
+	struct PassNode
+	{
+		std::string Name;
+		FrameGraphExecuteFunction Execute;
+		std::vector<FrameGraphResource> Reads;
+		std::vector<FrameGraphResource> Writes;
+		bool Culled;
+		unsigned int RefCount;			// Outputs still needed by someone
+		std::vector<FrameGraphBarrier> Barriers;
+	};
+
+	// One real texture that one or more transient resources share
+	struct Allocation
+	{
+		RenderTextureDesc Desc;
+		unsigned int LastPass;
+		unsigned int PoolIndex;
+	};
+
+	// A texture kept between frames
+	struct PooledTexture
+	{
+		RenderTextureDesc Desc;
+		RenderTexture Views;
+		bool InUse;
+		unsigned int IdleFrames;
+	};
+
+	// Helper methods
+	void CullPasses();
+	void ComputeLifetimes();
+	void BuildBarriers();
+	void AliasResources();
+	unsigned int AcquireTexture(const RenderTextureDesc& desc);
+	void ReleaseIdleTextures();
+	static bool SameDesc(const RenderTextureDesc& a, const RenderTextureDesc& b);
+
+	IRenderDevice* device;
+	std::vector<ResourceNode> resources;
+	std::vector<PassNode> passes;
+	std::vector<Allocation> allocations;
+	std::vector<PooledTexture> pool;
+
+	unsigned long long transientBytes;
+	unsigned long long unaliasedTransientBytes;
+	unsigned long long peakLiveTransientBytes;
+};
@@ -1,9 +1,31 @@
 #include "Game.h"
 #include "Vertex.h"
+#include "PackedTextureSource.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <thread>
 
 // For the DirectX Math library
 using namespace DirectX;
 
+// Size of the ring that shader constants are uploaded through.  It holds
+// a few frames' worth at once, since the GPU reads behind the CPU.
+static const unsigned int ConstantUploadRingSize = 4 * 1024 * 1024;
+
+// Most mesh and texture data sent to the GPU each frame.  Each staging
+// buffer holds one frame's worth, with one per frame that can be in flight.
+static const unsigned int UploadBudgetPerFrame = 1024 * 1024;
+
+// Frames of render stats kept for saving, and where they're saved to
+// when the game closes (only in builds with ENGINE_RENDER_STATS defined)
+static const unsigned int RenderStatsHistoryFrames = 3600;
+#ifdef ENGINE_RENDER_STATS
+static const char* RenderStatsCSVFile = "RenderStats.csv";
+static const char* RenderStatsJSONFile = "RenderStats.json";
+#endif
+
 // --------------------------------------------------------
 // Constructor
 //
@@ -24,12 +46,50 @@ Game::Game(HINSTANCE hInstance)
 	mouseDown = false;
 	meshes = std::vector<Mesh*>();
 	entities = std::vector<Entity>();
+	stressTestEntityCount = 0;
+	stressTestStatic = false;
 	camera = new Camera(width, height);
+	cullingSystem = new CullingSystem();
+	renderQueue = new RenderQueue();
+	stateCache = nullptr;
+	constantUploadRing = nullptr;
+	uploadManager = nullptr;
+	textureStreamer = nullptr;
+	transformBuffer = nullptr;
+	instanceBatcher = new InstanceBatcher();
+	instanceBuffer = nullptr;
+	instanceBufferCapacity = 0;
+	staticBatcher = nullptr;
+	staticDrawsLastFrame = 0;
+	staticEntitiesLastFrame = 0;
+	frameGraph = nullptr;
+	sceneRenderTarget = nullptr;
+	sceneDepthStencil = nullptr;
+	commandRecorder = nullptr;
+	drawCallsLastFrame = 0;
+	instancesLastFrame = 0;
+	constantUploadsLastFrame = 0;
+	constantUploadsSkippedLastFrame = 0;
+	resourceBindingsStagedLastFrame = 0;
+	resourceBindCallsLastFrame = 0;
+	renderStats = new RenderStats(RenderStatsHistoryFrames);
+	deviceRenderStats.Reset();
 	vertexShader = nullptr;
+	instancedVertexShader = nullptr;
 	pixelShader = nullptr;
+	pixelShaderVariants = nullptr;
+	inputLayoutCache = nullptr;
+	pipelineStates = nullptr;
+	boundPipelineState = nullptr;
+	materialRegistry = nullptr;
+	boundMaterialID = 0;
 	material = nullptr;
+	snowMaterial = nullptr;
+	cliffMaterial = nullptr;
+	textureArrays = nullptr;
+	cliffMaps = 0;
 
-#if defined(DEBUG) || defined(_DEBUG)
+#if defined(_WIN32) && (defined(DEBUG) || defined(_DEBUG))
 	// Do we want a console window?  Probably only in debug mode
 	CreateConsoleWindow(500, 120, 32, 120);
 	printf("Console window created successfully.  Feel free to printf() here.");
@@ -47,17 +107,54 @@ Game::~Game()
 	// Delete the camera
 	delete camera;
 
+	// Delete the culling system and render queue
+	delete cullingSystem;
+	delete renderQueue;
+
+	// Delete the state cache, the constant upload ring and the upload manager
+	delete stateCache;
+	delete constantUploadRing;
+	delete uploadManager;
+
+	// Delete the transform buffer
+	delete transformBuffer;
+
+	// Delete the instance batcher and its buffer
+	delete instanceBatcher;
+	renderDevice->Release(instanceBuffer);
+
+	// Delete the static batches
+	delete staticBatcher;
+
+	// Delete the frame graph and the textures it kept around
+	delete frameGraph;
+
+	// Delete the command recorder and its command lists
+	delete commandRecorder;
+
+	// Save the render stats of the last few frames, then delete them
+	RENDER_STATS(renderStats->WriteCSV(RenderStatsCSVFile));
+	RENDER_STATS(renderStats->WriteJSON(RenderStatsJSONFile));
+	delete renderStats;
+
 	// Delete our simple shader objects, which
 	// will clean up their own internal DirectX stuff
 	delete vertexShader;
-	delete pixelShader;
+	delete instancedVertexShader;
+	delete pixelShaderVariants;
 
-	// Release DXTK Texture resources
-	shaderResourceView->Release();
-	samplerState->Release();
+	// Every vertex shader has given its input layout back by now
+	SimpleVertexShader::SetInputLayoutCache(nullptr);
+	delete inputLayoutCache;
 
-	// Delete the basic material
-	delete material;
+	// Release texture resources, streamed ones included
+	delete textureArrays;
+	delete textureStreamer;
+
+	// Delete the materials, then the pipeline states and
+	// sampler they were using
+	delete materialRegistry;
+	delete pipelineStates;
 
 	// Delete all entrys in the Mesh Pointer Vector Collection
 	for (std::vector<Mesh>::size_type i = 0; i != meshes.size(); i++) {
@@ -72,18 +169,47 @@ Game::~Game()
 void Game::Init()
 {
 	// Set up the directional light source
-	lights[0].AmbientColor = XMFLOAT4(0.01f, 0.01f, 0.01f, 1.0f);
-	lights[0].DiffuseColor = XMFLOAT4(0, 0, 1, 1);
-	lights[0].Direction = XMFLOAT3(1, -1, 0);
-	lights[1].AmbientColor = XMFLOAT4(0.01f, 0.01f, 0.01f, 1.0f);
-	lights[1].DiffuseColor = XMFLOAT4(0, 1, 0, 1);
-	lights[1].Direction = XMFLOAT3(-1, 1, 0);
-	lights[2].AmbientColor = XMFLOAT4(0.01f, 0.01f, 0.01f, 1.0f);
-	lights[2].DiffuseColor = XMFLOAT4(1, 0, 0, 1);
-	lights[2].Direction = XMFLOAT3(-1, -1, 0);
-	lights[3].AmbientColor = XMFLOAT4(0.01f, 0.01f, 0.01f, 1.0f);
-	lights[3].DiffuseColor = XMFLOAT4(1, 1, 1, 1);
-	lights[3].Direction = XMFLOAT3(1, 1, 0);
+	lightData.Lights[0].AmbientColor = XMFLOAT4(0.01f, 0.01f, 0.01f, 1.0f);
+	lightData.Lights[0].DiffuseColor = XMFLOAT4(0, 0, 1, 1);
+	lightData.Lights[0].Direction = XMFLOAT3(1, -1, 0);
+	lightData.Lights[1].AmbientColor = XMFLOAT4(0.01f, 0.01f, 0.01f, 1.0f);
+	lightData.Lights[1].DiffuseColor = XMFLOAT4(0, 1, 0, 1);
+	lightData.Lights[1].Direction = XMFLOAT3(-1, 1, 0);
+	lightData.Lights[2].AmbientColor = XMFLOAT4(0.01f, 0.01f, 0.01f, 1.0f);
+	lightData.Lights[2].DiffuseColor = XMFLOAT4(1, 0, 0, 1);
+	lightData.Lights[2].Direction = XMFLOAT3(-1, -1, 0);
+	lightData.Lights[3].AmbientColor = XMFLOAT4(0.01f, 0.01f, 0.01f, 1.0f);
+	lightData.Lights[3].DiffuseColor = XMFLOAT4(1, 1, 1, 1);
+	lightData.Lights[3].Direction = XMFLOAT3(1, 1, 0);
+
+	// Wrap the immediate context so shaders and entities can go through the state cache
+	stateCache = new StateCache(renderDevice->GetImmediateContext());
+
+	// Shaders upload their constants through this when the device can bind
+	// parts of constant buffers, otherwise they keep using their own
+	constantUploadRing = new ConstantUploadRing(renderDevice, stateCache, ConstantUploadRingSize);
+
+	// Meshes and textures queue their data here instead of uploading it all at once
+	uploadManager = new UploadManager(renderDevice, stateCache, UploadBudgetPerFrame, UploadManager::MaxFrameLatency + 1);
+	uploadManager->SetFrameBudget(UploadBudgetPerFrame);
+
+	// Textures that stream their mips in the background, smallest first
+	textureStreamer = new TextureStreamer(renderDevice, stateCache, uploadManager);
+
+	// Worker threads record into whatever command lists the render device makes
+	commandRecorder = new CommandRecorder([this]() -> ICommandList*
+	{
+		return renderDevice->CreateCommandList();
+	});
+
+	// Instanced draws read world matrices from here
+	transformBuffer = new TransformBuffer(renderDevice);
+
+	// Static entities are merged once they've been placed
+	staticBatcher = new StaticBatcher(renderDevice);
+
+	// The frame's passes and the textures between them
+	frameGraph = new FrameGraph(renderDevice);
 
 	// Helper methods for loading materials, creating some basic
 	// geometry to draw, and some loading models
@@ -91,11 +217,7 @@ void Game::Init()
 	LoadMaterials();
 	CreateBasicGeometry();
 	LoadModels();
-
-	// Tell the input assembler stage of the pipeline what kind of
-	// geometric primitives (points, lines or triangles) we want to draw.  
-	// Essentially: "What kind of shape should the GPU draw with our data?"
-	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	CreateStressTestEntities(stressTestEntityCount);
 }
 
 // --------------------------------------------------------
@@ -110,33 +232,133 @@ void Game::Init()
 // --------------------------------------------------------
 void Game::LoadMaterials()
 {
-	vertexShader = new SimpleVertexShader(device, context);
+	// Vertex shaders taking the same vertex format share one input layout
+	inputLayoutCache = new InputLayoutCache(renderDevice);
+	SimpleVertexShader::SetInputLayoutCache(inputLayoutCache);
+
+	// Pipeline states, samplers and materials asked for twice are made once
+	pipelineStates = new PipelineStateCache(renderDevice);
+	materialRegistry = new MaterialRegistry(renderDevice, pipelineStates);
+
+	vertexShader = new SimpleVertexShader(renderDevice);
 	vertexShader->LoadShaderFile(L"VertexShader.cso");
+	vertexShader->SetRenderContext(stateCache);
+	vertexShader->SetConstantUploadRing(constantUploadRing);
+
+	instancedVertexShader = new SimpleVertexShader(renderDevice);
+	instancedVertexShader->LoadShaderFile(L"VertexShaderInstanced.cso");
+	instancedVertexShader->SetRenderContext(stateCache);
+	instancedVertexShader->SetConstantUploadRing(constantUploadRing);
+
+	// The pixel shader can leave out lights, its texture or ambient
+	// light, and can read ambient occlusion from packed maps.  The
+	// build compiles the variant with all but the packed maps, and
+	// any others are compiled from the copy of the source next to the
+	// executable the first time they're needed, then cached on disk.
+	const unsigned int LightCount = sizeof(lightData.Lights) / sizeof(lightData.Lights[0]);
+	ShaderPermutationSet pixelShaderFeatures;
+	pixelShaderFeatures.AddFeature("LIGHT_COUNT", LightCount, LightCount);
+	pixelShaderFeatures.AddFeature("USE_TEXTURE", 1, 1);
+	pixelShaderFeatures.AddFeature("USE_AMBIENT", 1, 1);
+	pixelShaderFeatures.AddFeature("AO_CHANNEL", 4, 0);
 
-	pixelShader = new SimplePixelShader(device, context);
-	pixelShader->LoadShaderFile(L"PixelShader.cso");
+	pixelShaderVariants = new ShaderVariantCache(renderDevice, pixelShaderFeatures, L"shaders/PixelShader.hlsl", "ps_5_0", L"shadercache/");
+	pixelShaderVariants->AddPrecompiled(pixelShaderFeatures.GetDefaultKey(), L"PixelShader.cso");
+	pixelShaderVariants->SetRenderContext(stateCache);
+	pixelShaderVariants->SetConstantUploadRing(constantUploadRing);
+	pixelShader = pixelShaderVariants->GetPixelShader(pixelShaderFeatures.GetDefaultKey());
 
-	// Use the DirectXTK to load a texture from an external file and place it into a shader resource view
-	CreateWICTextureFromFile(
-		device,										// Application Device
-		context,									// Application Device Context (necesary for auto generation of mipmaps)
-		L"resources/textures/GravelCobble_bc.jpg",	// File path to external texture
-		0,											// Reference to the texture which we don't need so we pass in 0
-		&shaderResourceView);						// Address to the Shader Resource View pointer which we pass to the shader later
+	ID3D11ShaderResourceView* gravelTexture = nullptr;
+	ID3D11ShaderResourceView* snowTexture = nullptr;
+#ifdef _WIN32
+	if (!headless)
+	{
+		// Use the DirectXTK to load a texture from an external file and place it into a shader resource view
+		CreateWICTextureFromFile(
+			device,										// Application Device
+			context,									// Application Device Context (necesary for auto generation of mipmaps)
+			L"resources/textures/GravelCobble_bc.jpg",	// File path to external texture
+			0,											// Reference to the texture which we don't need so we pass in 0
+			&gravelTexture);							// Address to the Shader Resource View pointer
+		CreateWICTextureFromFile(device, context, L"resources/textures/Snow_bc.jpg", 0, &snowTexture);
+	}
+	else
+#endif
+	{
+		// WIC needs a real device, so headless runs get plain white textures
+		// instead.  They're copied into an array straight away, so they're
+		// made with their data rather than uploaded later.
+		const unsigned int white = 0xFFFFFFFF;
+		TextureDesc textureDesc = {};
+		textureDesc.Width = 1;
+		textureDesc.Height = 1;
+		textureDesc.MipLevels = 1;
+		textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		gravelTexture = renderDevice->CreateTexture2D(textureDesc, &white, sizeof(white));
+		snowTexture = renderDevice->CreateTexture2D(textureDesc, &white, sizeof(white));
+	}
+
+	// Pack the textures into arrays, one per size and format, so materials
+	// whose textures share an array can be drawn in the same instanced call.
+	// The arrays hold copies, so the loaded textures can go.
+	textureArrays = new TextureArrayBuilder(renderDevice);
+	unsigned int gravelIndex = textureArrays->Add(gravelTexture);
+	unsigned int snowIndex = textureArrays->Add(snowTexture);
+	textureArrays->Build();
+	renderDevice->Release(gravelTexture);
+	renderDevice->Release(snowTexture);
 
 	// Define a sampler description
-	D3D11_SAMPLER_DESC samplerDesc = D3D11_SAMPLER_DESC();
-	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP; // Have UVW address wrap on the U axis
-	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP; // Have UVW address wrap on the V axis
-	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP; // Have UVW address wrap on the W axis
-	samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR; // Use trilinear filtering
-	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX; // This value needs to be higher than 0 for mipmapping to work
-
-	// Create the sampler state using the defined sampler description
-	device->CreateSamplerState(&samplerDesc, &samplerState);
-
-	// Set up a material to be shared by all the basic mesh entities
-	material = new Material(vertexShader, pixelShader, shaderResourceView, samplerState);
+	SamplerDesc samplerDesc = {};
+	samplerDesc.AddressMode = SAMPLER_ADDRESS_WRAP; // Have UVW address wrap on every axis
+	samplerDesc.Filter = SAMPLER_FILTER_LINEAR; // Use trilinear filtering
+
+	// Get the sampler state for the description, which the cache owns
+	samplerState = pipelineStates->GetSamplerState(samplerDesc);
+
+	// Set up materials to be shared by the basic mesh entities, drawing
+	// each texture as it is
+	MaterialDesc materialDesc = {};
+	materialDesc.VertexShader = vertexShader;
+	materialDesc.PixelShader = pixelShader;
+	materialDesc.InstancedVertexShader = instancedVertexShader;
+	materialDesc.Texture = textureArrays->GetArray(gravelIndex);
+	materialDesc.TextureSlice = textureArrays->GetSlice(gravelIndex);
+	materialDesc.Sampler = samplerState;
+	materialDesc.Parameters.Tint = XMFLOAT4(1, 1, 1, 1);
+	materialDesc.Parameters.UVScale = XMFLOAT2(1, 1);
+	material = materialRegistry->GetMaterial(materialRegistry->Register(materialDesc));
+	if (!material)
+		printf("Couldn't load the shaders, so nothing will be drawn\n");
+
+	materialDesc.Texture = textureArrays->GetArray(snowIndex);
+	materialDesc.TextureSlice = textureArrays->GetSlice(snowIndex);
+	snowMaterial = materialRegistry->GetMaterial(materialRegistry->Register(materialDesc));
+
+	// The cliff's single channel maps are packed into one texture, and
+	// its info says which channel holds which.  The cliff material uses
+	// the pixel shader variant that samples each from its channel, on
+	// top of the gravel texture.  It falls back to plain gravel if the
+	// maps or the variant can't be loaded.
+	//  - The texture streams in, so only its info is read here
+	PackedTextureSource* cliffMapsSource = new PackedTextureSource("resources/textures/CliffLayered.manifest");
+	cliffMaps = textureStreamer->Add(cliffMapsSource);
+	ShaderVariantKey cliffKey = pixelShaderFeatures.GetDefaultKey();
+	SimplePixelShader* cliffPixelShader = nullptr;
+	if (cliffMaps && MaterialRegistry::SelectPackedMapVariant(cliffMapsSource->GetInfo(), pixelShaderFeatures, cliffKey) > 0)
+		cliffPixelShader = pixelShaderVariants->GetPixelShader(cliffKey);
+
+	cliffMaterial = material;
+	if (cliffPixelShader)
+	{
+		materialDesc.PixelShader = cliffPixelShader;
+		materialDesc.Texture = textureArrays->GetArray(gravelIndex);
+		materialDesc.TextureSlice = textureArrays->GetSlice(gravelIndex);
+		materialDesc.MaterialMaps = textureStreamer->GetTexture(cliffMaps);
+		Material* registered = materialRegistry->GetMaterial(materialRegistry->Register(materialDesc));
+		if (registered)
+			cliffMaterial = registered;
+	}
 }
 
 // --------------------------------------------------------
@@ -167,7 +389,7 @@ void Game::CreateBasicGeometry()
 	int indexCount1 = sizeof(indices1) / sizeof(indices1[0]);
 
 	// Create the actual Mesh object for Mesh 1
-	meshes.push_back(new Mesh(device, vertices1, vertexCount1, indices1, indexCount1));
+	meshes.push_back(new Mesh(renderDevice, vertices1, vertexCount1, indices1, indexCount1, uploadManager));
 	
 	// Set up the vertices and indices for Mesh 2 ---------------------------------
 	Vertex vertices2[] =
@@ -184,7 +406,7 @@ void Game::CreateBasicGeometry()
 	int indexCount2 = sizeof(indices2) / sizeof(indices2[0]);
 
 	// Create the actual Mesh object for Mesh 1
-	meshes.push_back(new Mesh(device, vertices2, vertexCount2, indices2, indexCount2));
+	meshes.push_back(new Mesh(renderDevice, vertices2, vertexCount2, indices2, indexCount2, uploadManager));
 
 	// Set up the vertices and indices for Mesh 3 ---------------------------------
 	Vertex vertices3[] =
@@ -201,33 +423,33 @@ void Game::CreateBasicGeometry()
 	int indexCount3 = sizeof(indices3) / sizeof(indices3[0]);
 
 	// Create the actual Mesh object for Mesh 1
-	meshes.push_back(new Mesh(device, vertices3, vertexCount3, indices3, indexCount3));
+	meshes.push_back(new Mesh(renderDevice, vertices3, vertexCount3, indices3, indexCount3, uploadManager));
 
 	// Assign the created meshes and material to new entities
 	entities.push_back(Entity(meshes[0], material));
-	entities.push_back(Entity(meshes[0], material));
+	entities.push_back(Entity(meshes[0], snowMaterial));
 	entities.push_back(Entity(meshes[1], material));
-	entities.push_back(Entity(meshes[2], material));
+	entities.push_back(Entity(meshes[2], snowMaterial));
 	entities.push_back(Entity(meshes[1], material));
-	entities.push_back(Entity(meshes[2], material));
+	entities.push_back(Entity(meshes[2], snowMaterial));
 }
 
 void Game::LoadModels()
 {
 	// Load meshes for models from external OBJ files
-	meshes.push_back(new Mesh(device, "resources/models/helix.obj"));
+	meshes.push_back(new Mesh(renderDevice, "resources/models/helix.obj", uploadManager));
 
 	// Load meshes for models from external OBJ files
-	meshes.push_back(new Mesh(device, "resources/models/torus.obj"));
+	meshes.push_back(new Mesh(renderDevice, "resources/models/torus.obj", uploadManager));
 
 	// Load meshes for models from external OBJ files
-	meshes.push_back(new Mesh(device, "resources/models/cone.obj"));
+	meshes.push_back(new Mesh(renderDevice, "resources/models/cone.obj", uploadManager));
 
 	// Assign the created meshes and material to new entities
 	entities.push_back(Entity(meshes[3], material));
-	entities.push_back(Entity(meshes[3], material));
-	entities.push_back(Entity(meshes[4], material));
-	entities.push_back(Entity(meshes[5], material));
+	entities.push_back(Entity(meshes[3], snowMaterial));
+	entities.push_back(Entity(meshes[4], cliffMaterial));
+	entities.push_back(Entity(meshes[5], snowMaterial));
 
 	// Move the new entities off to the side of the screen
 	entities[6].MoveForward(XMFLOAT3(3, 0, 0));
@@ -236,6 +458,53 @@ void Game::LoadModels()
 	entities[9].MoveForward(XMFLOAT3(2, 2, 0));
 }
 
+// --------------------------------------------------------
+// Spawns a grid of entities behind the scene, cycling through
+// the loaded meshes and both materials, for measuring draw
+// call counts.  Movable ones are instanced, and static ones
+// are merged into static batches.
+// --------------------------------------------------------
+void Game::CreateStressTestEntities(unsigned int count)
+{
+	unsigned int rowLength = (unsigned int)ceil(sqrt((double)count));
+	for (unsigned int i = 0; i < count; i++)
+	{
+		Entity entity(meshes[i % meshes.size()], i % 2 ? snowMaterial : material);
+		entity.SetPosition(XMFLOAT3(
+			((float)(i % rowLength) - rowLength / 2.0f) * 2.0f,
+			((float)(i / rowLength) - rowLength / 2.0f) * 2.0f,
+			80.0f));
+		entity.SetStatic(stressTestStatic);
+		entities.push_back(entity);
+	}
+}
+
+// --------------------------------------------------------
+// Grows the instance buffer (to the next power of two) if it
+// can't hold the given number of instances
+// --------------------------------------------------------
+void Game::ReserveInstanceBuffer(unsigned int instanceCount)
+{
+	if (instanceCount <= instanceBufferCapacity)
+		return;
+
+	unsigned int capacity = instanceBufferCapacity > 0 ? instanceBufferCapacity : 64;
+	while (capacity < instanceCount)
+		capacity *= 2;
+
+	renderDevice->Release(instanceBuffer);
+	instanceBufferCapacity = 0;
+
+	// Dynamic so it can be rewritten every frame
+	BufferDesc ibd = {};
+	ibd.Usage = BUFFER_USAGE_DYNAMIC;
+	ibd.ByteWidth = sizeof(InstanceData) * capacity;
+	ibd.BindFlags = BUFFER_BIND_VERTEX;
+	instanceBuffer = renderDevice->CreateBuffer(ibd, 0);
+	if (instanceBuffer)
+		instanceBufferCapacity = capacity;
+}
+
 // --------------------------------------------------------
 // Handle resizing DirectX "stuff" to match the new window size.
 // For instance, updating our projection matrix's aspect ratio.
@@ -255,7 +524,7 @@ void Game::OnResize()
 void Game::Update(float deltaTime, float totalTime)
 {
 	// Quit if the escape key is pressed
-	if (GetAsyncKeyState(VK_ESCAPE))
+	if (IsKeyDown(VK_ESCAPE))
 		Quit();
 
 	// Movement for entity 0
@@ -264,32 +533,32 @@ void Game::Update(float deltaTime, float totalTime)
 		// Set movement rate
 		float speed = 5.0;
 
-		if (GetAsyncKeyState('I') & 0x8000)
+		if (IsKeyDown('I'))
 		{
 			entities[0].MoveForward(XMFLOAT3(0, speed * deltaTime, 0));
 		}
 
-		if (GetAsyncKeyState('K') & 0x8000)
+		if (IsKeyDown('K'))
 		{
 			entities[0].MoveForward(XMFLOAT3(0, -speed * deltaTime, 0));
 		}
 
-		if (GetAsyncKeyState('L') & 0x8000)
+		if (IsKeyDown('L'))
 		{
 			entities[0].MoveForward(XMFLOAT3(speed * deltaTime, 0, 0));
 		}
 
-		if (GetAsyncKeyState('J') & 0x8000)
+		if (IsKeyDown('J'))
 		{
 			entities[0].MoveForward(XMFLOAT3(-speed * deltaTime, 0, 0));
 		}
 
-		if (GetAsyncKeyState('O') & 0x8000)
+		if (IsKeyDown('O'))
 		{
 			entities[0].MoveForward(XMFLOAT3(0, 0, speed * deltaTime));
 		}
 
-		if (GetAsyncKeyState('U') & 0x8000)
+		if (IsKeyDown('U'))
 		{
 			entities[0].MoveForward(XMFLOAT3(0, 0, -speed * deltaTime));
 		}
@@ -335,35 +604,888 @@ void Game::Update(float deltaTime, float totalTime)
 // Clear the screen, redraw everything, present to the user
 // --------------------------------------------------------
 void Game::Draw(float deltaTime, float totalTime)
+{
+	// Everything sent to the GPU from here on counts towards this frame
+	RENDER_STATS(stateCache->ResetRenderStats());
+	vertexShader->ResetUploadStats();
+	vertexShader->ResetBindStats();
+	instancedVertexShader->ResetUploadStats();
+	instancedVertexShader->ResetBindStats();
+	for (size_t i = 0; i < pixelShaderVariants->GetLoadedVariantCount(); i++)
+	{
+		pixelShaderVariants->GetLoadedVariant(i)->ResetUploadStats();
+		pixelShaderVariants->GetLoadedVariant(i)->ResetBindStats();
+	}
+
+	// Frees up the space in the constant upload ring that the GPU is done with
+	constantUploadRing->BeginFrame();
+
+	// Queue any streamed mips that have been read, then send this frame's
+	// share of queued mesh and texture data
+	textureStreamer->Update();
+	uploadManager->ProcessFrame();
+
+	// Describe the frame as a graph of passes
+	//  - The back buffer belongs to the swap chain, so it's imported
+	//  - The depth buffer only lives for the frame, so the graph makes it,
+	//    and keeps it around for the next frame while the size matches
+	frameGraph->Reset();
+	RenderTextureDesc backBufferDesc = { width, height, DXGI_FORMAT_R8G8B8A8_UNORM, TEXTURE_BIND_RENDER_TARGET };
+	RenderTexture backBuffer = {};
+	backBuffer.RenderTargetView = backBufferRTV;
+	FrameGraphResource backBufferResource = frameGraph->ImportTexture("BackBuffer", backBufferDesc, backBuffer);
+
+	RenderTextureDesc depthDesc = { width, height, DXGI_FORMAT_D24_UNORM_S8_UINT, TEXTURE_BIND_DEPTH_STENCIL };
+	FrameGraphResource depthResource = frameGraph->CreateTexture("Depth", depthDesc);
+
+	unsigned int scenePass = frameGraph->AddPass("Scene",
+		[this, backBufferResource, depthResource](IRenderContext* context, const FrameGraph& graph)
+		{
+			sceneRenderTarget = graph.GetRenderTargetView(backBufferResource);
+			sceneDepthStencil = graph.GetDepthStencilView(depthResource);
+			DrawScene();
+		});
+	frameGraph->Write(scenePass, backBufferResource);
+	frameGraph->Write(scenePass, depthResource);
+
+	// Cull unused passes, place the transient textures, then draw.  A graph
+	// that doesn't compile would run passes with textures it never made.
+	if (frameGraph->Compile())
+		frameGraph->Execute(stateCache);
+	else
+		printf("The frame graph didn't compile, so nothing was drawn\n");
+
+	constantUploadRing->EndFrame();
+
+	constantUploadsLastFrame = vertexShader->GetUploads() + instancedVertexShader->GetUploads();
+	constantUploadsSkippedLastFrame = vertexShader->GetSkippedUploads() + instancedVertexShader->GetSkippedUploads();
+	resourceBindingsStagedLastFrame = vertexShader->GetBindingsStaged() + instancedVertexShader->GetBindingsStaged();
+	resourceBindCallsLastFrame = vertexShader->GetBindCalls() + instancedVertexShader->GetBindCalls();
+	for (size_t i = 0; i < pixelShaderVariants->GetLoadedVariantCount(); i++)
+	{
+		ISimpleShader* variant = pixelShaderVariants->GetLoadedVariant(i);
+		constantUploadsLastFrame += variant->GetUploads();
+		constantUploadsSkippedLastFrame += variant->GetSkippedUploads();
+		resourceBindingsStagedLastFrame += variant->GetBindingsStaged();
+		resourceBindCallsLastFrame += variant->GetBindCalls();
+	}
+
+	RENDER_STATS(RecordRenderStats(deltaTime));
+
+	// Present the back buffer to the user
+	//  - Puts the final frame we're drawing into the window so the user can see it
+	//  - Do this exactly ONCE PER FRAME (always at the very end of the frame)
+	//  - There's no swap chain when running headless
+#ifdef _WIN32
+	if (swapChain)
+		swapChain->Present(0, 0);
+#endif
+}
+
+// --------------------------------------------------------
+// The frame graph's scene pass - clears the scene views and
+// draws every visible entity into them
+// --------------------------------------------------------
+void Game::DrawScene()
 {
 	// Background color (Cornflower Blue in this case) for clearing
 	const float color[4] = { 0.4f, 0.6f, 0.75f, 0.0f };
 
 	// Clear the render target and depth buffer (erases what's on the screen)
 	//  - Do this ONCE PER FRAME
-	//  - At the beginning of Draw (before drawing *anything*)
-	context->ClearRenderTargetView(backBufferRTV, color);
-	context->ClearDepthStencilView(
-		depthStencilView,
-		D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL,
-		1.0f,
-		0);
+	//  - At the beginning of the pass (before drawing *anything*)
+	stateCache->ClearRenderTargetView(sceneRenderTarget, color);
+	if (sceneDepthStencil)
+		stateCache->ClearDepthStencilView(sceneDepthStencil, 1.0f, 0);
 
-	// Pass the enviromental lights to the pixel shader for all objects
-	pixelShader->SetData(
-		"lights", // The name of the (eventual) variable in the shader
-		&lights, // The address of the data to copy
-		sizeof(DirectionalLight) * _countof(lights)); // The size of the data to copy
+	// There's no material to draw anything with if the shaders didn't load
+	if (!material)
+		return;
 
-	// Draw each entity
-	for (std::vector<Entity>::size_type i = 0; i != entities.size(); i++) {
-		entities[i].Draw(context, camera->GetViewMatrix(), camera->GetProjectionMatrix());
+	// Pass the enviromental lights to every pixel shader variant
+	//  - Each variant's light buffer is looked up the first time it's seen
+	//  - Variants without lights don't have the buffer, which is fine
+	for (size_t i = 0; i < pixelShaderVariants->GetLoadedVariantCount(); i++)
+	{
+		ISimpleShader* variant = pixelShaderVariants->GetLoadedVariant(i);
+		if (i == lightDataHandles.size())
+			lightDataHandles.push_back(variant->GetConstantBufferHandle<LightConstants>("lightData"));
+		variant->SetConstantBufferData(lightDataHandles[i], lightData);
 	}
 
-	// Present the back buffer to the user
-	//  - Puts the final frame we're drawing into the window so the user can see it
-	//  - Do this exactly ONCE PER FRAME (always at the very end of the frame)
-	swapChain->Present(0, 0);
+	// Find the entities inside the camera's frustum
+	//  - Visibility is reused from last frame where it can't have changed
+	cullingSystem->Cull(entities, camera->GetViewMatrix(), camera->GetProjectionMatrix(), visibleEntities);
+
+	// Merge the static entities again if any were added, removed or changed
+	if (staticBatcher->IsOutOfDate(entities))
+		staticBatcher->Build(entities);
+
+	// Turn the visible entities into draw packets and sort them
+	//  - Opaque draws are grouped by shader, material and mesh, then front to back
+	//  - Transparent draws go back to front
+	XMFLOAT4X4 viewMatrix = camera->GetViewMatrix();
+	XMMATRIX view = XMMatrixTranspose(XMLoadFloat4x4(&viewMatrix));
+	renderQueue->Clear();
+
+	// How many pixels tall something one unit across is from one unit away
+	XMFLOAT4X4 projectionMatrix = camera->GetProjectionMatrix();
+	float pixelsPerUnit = projectionMatrix._22 * height * 0.5f;
+	instanceGroupKeys.resize(entities.size());
+	instanceTextureSlices.resize(entities.size());
+	for (std::vector<unsigned int>::size_type i = 0; i != visibleEntities.size(); i++) {
+		// Static batches draw these
+		if (staticBatcher->IsBatched(visibleEntities[i]))
+			continue;
+
+		Entity& entity = entities[visibleEntities[i]];
+		Material* entityMaterial = entity.GetMaterial();
+
+		// Entities can only share an instanced draw if both the mesh and material
+		// batch match - materials in a batch only differ by texture slice
+		instanceGroupKeys[visibleEntities[i]] = ((unsigned long long)entityMaterial->GetBatchID() << 32) | entity.GetMesh()->GetID();
+		instanceTextureSlices[visibleEntities[i]] = entityMaterial->GetTextureSlice();
+		XMFLOAT3 center = entity.GetBoundsCenter();
+		float depth = XMVectorGetZ(XMVector3TransformCoord(XMLoadFloat3(&center), view));
+
+		// The cliff's maps stream in as sharp as it is big on screen, times
+		// how many times they repeat across it
+		if (cliffMaps && entityMaterial == cliffMaterial)
+		{
+			const XMFLOAT2& uvScale = entityMaterial->GetParameters().UVScale;
+			float repeats = uvScale.x > uvScale.y ? uvScale.x : uvScale.y;
+			float distance = depth > 0.1f ? depth : 0.1f;
+			textureStreamer->ReportScreenSize(cliffMaps, entity.GetBoundsRadius() * 2 * pixelsPerUnit * repeats / distance);
+		}
+
+		renderQueue->Submit(
+			entityMaterial->IsTransparent() ? RENDER_PASS_TRANSPARENT : RENDER_PASS_OPAQUE,
+			entityMaterial->GetShaderID(),
+			entityMaterial->GetBatchID(),
+			entity.GetMesh()->GetID(),
+			depth,
+			visibleEntities[i]);
+	}
+	renderQueue->Sort();
+
+	// Draw each packet in sorted order
+	//  - The cache is invalidated first since resources can be released
+	//    and their addresses reused between frames
+	stateCache->Invalidate();
+	stateCache->ResetStats();
+	boundPipelineState = nullptr;
+	boundMaterialID = 0;
+	SetFrameState(stateCache);
+	DrawStaticBatches();
+	const std::vector<DrawPacket>& packets = renderQueue->GetPackets();
+
+	// Group neighbouring packets with the same mesh and material into batches
+	instanceBatcher->Build(packets, instanceGroupKeys);
+	const std::vector<InstanceBatch>& batches = instanceBatcher->GetBatches();
+
+	// Upload the world matrices of entities that moved since last frame
+	transformBuffer->Sync(entities);
+	transformBuffer->Upload(stateCache);
+
+	// Write every entity index and texture slice into the instance buffer in
+	// packet order, so a batch's instances start at the index of its first packet
+	ReserveInstanceBuffer((unsigned int)packets.size());
+	bool instancesWritten = false;
+	if (instanceBuffer && transformBuffer->GetShaderResourceView() && !packets.empty())
+	{
+		InstanceData* instanceData = (InstanceData*)stateCache->MapDiscard(instanceBuffer);
+		if (instanceData)
+		{
+			InstanceBatcher::WriteInstances(packets, instanceTextureSlices, instanceData);
+			stateCache->Unmap(instanceBuffer);
+			instancesWritten = true;
+		}
+	}
+
+	// Send the camera matrices to each instanced material once for the whole frame
+	bool allInstanced = instancesWritten;
+	preparedMaterials.clear();
+	for (std::vector<InstanceBatch>::size_type i = 0; i != batches.size(); i++) {
+		Entity& first = entities[packets[batches[i].FirstPacket].EntityIndex];
+		Material* batchMaterial = first.GetMaterial();
+		if (!batchMaterial->GetInstancedVertexShader())
+		{
+			allInstanced = false;
+			continue;
+		}
+
+		if (std::find(preparedMaterials.begin(), preparedMaterials.end(), batchMaterial) == preparedMaterials.end())
+		{
+			first.PrepareInstancedMaterial(camera->GetViewMatrix(), camera->GetProjectionMatrix());
+			preparedMaterials.push_back(batchMaterial);
+		}
+	}
+
+	drawCallsLastFrame = staticDrawsLastFrame;
+	instancesLastFrame = (unsigned int)packets.size();
+	if (allInstanced)
+	{
+		// Every batch only reads shared data now, so they can be recorded
+		// across worker threads and played back in order
+		commandRecorder->Record(stateCache, (unsigned int)batches.size(),
+			[this](IRenderContext* context, unsigned int first, unsigned int count)
+			{
+				const PipelineState* previousPipelineState = nullptr;
+				MaterialID previousMaterial = 0;
+				SetFrameState(context);
+				DrawInstanceBatches(context, previousPipelineState, previousMaterial, first, count);
+			});
+		drawCallsLastFrame += (unsigned int)batches.size();
+
+		// Playing the lists back reset whatever was bound
+		boundPipelineState = nullptr;
+		boundMaterialID = 0;
+	}
+	else
+	{
+		// Draw on this thread, falling back to one draw per entity
+		// if the material can't be instanced
+		for (std::vector<InstanceBatch>::size_type i = 0; i != batches.size(); i++) {
+			const InstanceBatch& batch = batches[i];
+			Entity& first = entities[packets[batch.FirstPacket].EntityIndex];
+
+			if (instancesWritten && first.GetMaterial()->GetInstancedVertexShader())
+			{
+				DrawInstanceBatches(stateCache, boundPipelineState, boundMaterialID, (unsigned int)i, 1);
+				drawCallsLastFrame++;
+				continue;
+			}
+
+			const PipelineState* pipelineState = first.GetMaterial()->GetPipelineState();
+			pipelineState->Bind(stateCache, boundPipelineState);
+			boundPipelineState = pipelineState;
+			materialRegistry->Bind(stateCache, first.GetMaterial()->GetID(), boundMaterialID);
+
+			for (unsigned int j = batch.FirstPacket; j < batch.FirstPacket + batch.Count; j++) {
+				entities[packets[j].EntityIndex].Draw(stateCache, camera->GetViewMatrix(), camera->GetProjectionMatrix());
+				drawCallsLastFrame++;
+			}
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Binds everything a frame's draws expect.  Command lists start
+// out with nothing bound, so each one needs this recorded too.
+// --------------------------------------------------------
+void Game::SetFrameState(IRenderContext* context)
+{
+	context->OMSetRenderTargets(1, &sceneRenderTarget, sceneDepthStencil);
+	context->RSSetViewport(0, 0, (float)width, (float)height, 0.0f, 1.0f);
+
+	// The primitive topology and the rasterizer, blend and depth
+	// states come from each material's pipeline state
+}
+
+// --------------------------------------------------------
+// Draws a range of this frame's instanced batches.  Only reads
+// entities, materials and the batch list, so worker threads
+// can each draw their own range into their own context.
+// --------------------------------------------------------
+void Game::DrawInstanceBatches(IRenderContext* context, const PipelineState*& previousPipelineState, MaterialID& previousMaterial, unsigned int firstBatch, unsigned int batchCount)
+{
+	const std::vector<DrawPacket>& packets = renderQueue->GetPackets();
+	const std::vector<InstanceBatch>& batches = instanceBatcher->GetBatches();
+	for (unsigned int i = firstBatch; i < firstBatch + batchCount; i++) {
+		const InstanceBatch& batch = batches[i];
+
+		// Only the parts that differ from the last batch's state are set,
+		// and nothing of the material's if it's the last batch's too
+		Material* batchMaterial = entities[packets[batch.FirstPacket].EntityIndex].GetMaterial();
+		const PipelineState* pipelineState = batchMaterial->GetInstancedPipelineState();
+		pipelineState->Bind(context, previousPipelineState);
+		previousPipelineState = pipelineState;
+		materialRegistry->Bind(context, batchMaterial->GetID(), previousMaterial);
+
+		entities[packets[batch.FirstPacket].EntityIndex].DrawInstanced(context, instanceBuffer, transformBuffer->GetShaderResourceView(), batch.Count, batch.FirstPacket);
+	}
+}
+
+// --------------------------------------------------------
+// Draws every static batch whose bounds are in the frustum.
+// The vertices are already in world space, so the material
+// gets an identity world matrix.
+// --------------------------------------------------------
+void Game::DrawStaticBatches()
+{
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+
+	staticDrawsLastFrame = 0;
+	staticEntitiesLastFrame = 0;
+	const std::vector<StaticBatch>& staticBatches = staticBatcher->GetBatches();
+	for (std::vector<StaticBatch>::size_type i = 0; i != staticBatches.size(); i++) {
+		const StaticBatch& batch = staticBatches[i];
+		if (!cullingSystem->IsSphereVisible(batch.BoundsCenter, batch.BoundsRadius))
+			continue;
+
+		Material* batchMaterial = batch.SourceMaterial;
+		const MaterialHandles& handles = batchMaterial->GetHandles();
+		VertexShaderConstants constants = {};
+		constants.World = identity;
+		constants.View = camera->GetViewMatrix();
+		constants.Projection = camera->GetProjectionMatrix();
+		constants.TextureSlice = batchMaterial->GetTextureSlice();
+		batchMaterial->GetVertexShader()->SetConstantBufferData(handles.Constants, constants);
+		batchMaterial->GetVertexShader()->CopyAllBufferData();
+		batchMaterial->GetPixelShader()->CopyAllBufferData();
+		batchMaterial->GetPipelineState()->Bind(stateCache, boundPipelineState);
+		boundPipelineState = batchMaterial->GetPipelineState();
+		materialRegistry->Bind(stateCache, batchMaterial->GetID(), boundMaterialID);
+		batchMaterial->GetVertexShader()->SetShader();
+		batchMaterial->GetPixelShader()->SetShader();
+
+		staticDrawsLastFrame += staticBatcher->DrawBatch(stateCache, (unsigned int)i);
+		staticEntitiesLastFrame += batch.RangeCount - batch.HiddenCount;
+	}
+}
+
+// --------------------------------------------------------
+// Adds up what every path to the GPU sent this frame: the main
+// state cache, the worker threads' command lists, and whatever
+// the device created since the last frame
+// --------------------------------------------------------
+void Game::RecordRenderStats(float deltaTime)
+{
+	RenderStatCounters deviceFrame = renderDevice->GetRenderStats();
+	deviceFrame.Subtract(deviceRenderStats);
+	deviceRenderStats = renderDevice->GetRenderStats();
+
+	renderStats->BeginFrame();
+	renderStats->AddToFrame(stateCache->GetRenderStats());
+	renderStats->AddToFrame(commandRecorder->GetRenderStats());
+	renderStats->AddToFrame(deviceFrame);
+	renderStats->EndFrame(deltaTime * 1000.0f);
+}
+
+// --------------------------------------------------------
+// Adds the last frame's draw call counts to the title bar
+// --------------------------------------------------------
+std::string Game::GetExtraTitleBarStats()
+{
+	return
+		"    Entities: " + std::to_string(entities.size()) +
+		"    Instances: " + std::to_string(instancesLastFrame) +
+		"    Draw Calls: " + std::to_string(drawCallsLastFrame) +
+		"    Static: " + std::to_string(staticEntitiesLastFrame) + " entities in " + std::to_string(staticDrawsLastFrame) + " draws" +
+		"    Constant Ring: " + std::to_string(constantUploadRing->GetBytesLastFrame() / 1024) + "KB" +
+		(constantUploadRing->GetFallbacksLastFrame() > 0 ? " (" + std::to_string(constantUploadRing->GetFallbacksLastFrame()) + " fallbacks)" : "") +
+		"    Constant Buffers: " + std::to_string(constantUploadsLastFrame) + " uploaded, " + std::to_string(constantUploadsSkippedLastFrame) + " unchanged" +
+		"    Resource Binds: " + std::to_string(resourceBindCallsLastFrame) + " calls for " + std::to_string(resourceBindingsStagedLastFrame) + " staged" +
+		"    Input Layouts: " + std::to_string(inputLayoutCache->GetLayoutCount()) + " (" + std::to_string(inputLayoutCache->GetHits()) + " of " + std::to_string(inputLayoutCache->GetLookups()) + " shared)" +
+		"    Materials: " + std::to_string(materialRegistry->GetMaterialCount()) + " (" + std::to_string(materialRegistry->GetBatchCount()) + " batches, " + std::to_string(textureArrays->GetArrayCount()) + " texture arrays)" +
+		"    Pipeline States: " + std::to_string(pipelineStates->GetPipelineStateCount()) + " (" + std::to_string(pipelineStates->GetStateObjectCount()) + " state objects)" +
+		"    Shader Variants: " + std::to_string(pixelShaderVariants->GetLoadedVariantCount()) + " (" + std::to_string((int)(pixelShaderVariants->GetStats().HitRate() * 100)) + "% cached)" +
+		"    Uploads: " + std::to_string(uploadManager->GetBytesLastFrame() / 1024) + "KB (" + std::to_string(uploadManager->GetPendingCount()) + " pending)" +
+		"    Transforms: " + std::to_string(transformBuffer->GetBytesUploadedLastFrame() / 1024) + "KB in " + std::to_string(transformBuffer->GetCopiesLastFrame()) + " copies" +
+		"    Transient Textures: " + std::to_string(frameGraph->GetTransientBytes() / 1024) + "KB" +
+		"    Record Threads: " + std::to_string(commandRecorder->GetThreadsUsed()) +
+		"    Record: " + std::to_string(commandRecorder->GetRecordMilliseconds()) + "ms" +
+		"    Execute: " + std::to_string(commandRecorder->GetExecuteMilliseconds()) + "ms" +
+		GetRenderStatsText();
+}
+
+// --------------------------------------------------------
+// The last frame's render stats, or nothing if they aren't
+// being counted in this build
+// --------------------------------------------------------
+std::string Game::GetRenderStatsText()
+{
+#ifdef ENGINE_RENDER_STATS
+	const RenderStatCounters& frame = renderStats->GetLastFrame();
+	return
+		"    GPU Draws: " + std::to_string(frame.Draws) +
+		"    Binds: " + std::to_string(frame.ShaderBinds) + " shader, " +
+			std::to_string(frame.ConstantBufferBinds) + " cbuffer, " +
+			std::to_string(frame.ShaderResourceBinds) + " SRV, " +
+			std::to_string(frame.SamplerBinds) + " sampler" +
+		"    Uploaded: " + std::to_string(frame.BytesUploaded / 1024) + "KB (not counting maps)";
+#else
+	return "";
+#endif
+}
+
+// --------------------------------------------------------
+// Sets what PrepareMaterial() sets for an entity (three
+// matrices, a sampler and a texture) over and over, first by
+// name and then through the material's handles, and prints
+// how long each took.  Both go through the same state cache,
+// so the difference is all in the lookups.
+// --------------------------------------------------------
+HRESULT Game::RunSetterBenchmark(unsigned int iterations)
+{
+	Init();
+
+	SimpleVertexShader* vs = material->GetVertexShader();
+	SimplePixelShader* ps = material->GetPixelShader();
+	const MaterialHandles& handles = material->GetHandles();
+	XMFLOAT4X4 matrix = camera->GetViewMatrix();
+	ID3D11SamplerState* sampler = material->GetSamplerState();
+	ID3D11ShaderResourceView* texture = material->GetShaderResourceView();
+	unsigned int failures = 0;
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < iterations; i++)
+	{
+		matrix._44 = (float)i;
+		failures += !vs->SetMatrix4x4("world", matrix);
+		failures += !vs->SetMatrix4x4("view", matrix);
+		failures += !vs->SetMatrix4x4("projection", matrix);
+		failures += !ps->SetSamplerState("samplerState", sampler);
+		failures += !ps->SetShaderResourceView("textureBaseColor", texture);
+	}
+	std::chrono::high_resolution_clock::time_point named = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < iterations; i++)
+	{
+		matrix._44 = (float)i;
+		failures += !vs->SetMatrix4x4(handles.World, matrix);
+		failures += !vs->SetMatrix4x4(handles.View, matrix);
+		failures += !vs->SetMatrix4x4(handles.Projection, matrix);
+		failures += !ps->SetSamplerState(handles.Sampler, sampler);
+		failures += !ps->SetShaderResourceView(handles.Texture, texture);
+	}
+	std::chrono::high_resolution_clock::time_point handled = std::chrono::high_resolution_clock::now();
+
+	double calls = iterations > 0 ? iterations * 5.0 : 1.0;
+	double namedNanoseconds = std::chrono::duration<double, std::nano>(named - start).count() / calls;
+	double handleNanoseconds = std::chrono::duration<double, std::nano>(handled - named).count() / calls;
+	printf("Shader setter benchmark (%u iterations of 5 setters)\n", iterations);
+	printf("  By name:         %.2fns per call\n", namedNanoseconds);
+	printf("  By handle:       %.2fns per call\n", handleNanoseconds);
+	printf("  Speedup:         %.2fx\n", handleNanoseconds > 0 ? namedNanoseconds / handleNanoseconds : 0.0);
+	if (failures > 0)
+		printf("  Failed calls:    %u\n", failures);
+	fflush(stdout);
+
+	return failures == 0 ? S_OK : E_FAIL;
+}
+
+// --------------------------------------------------------
+// Registers materials that differ only in their tint, then
+// registers them all again, which should only find them.  Then
+// binds them for a few draws each through the state cache, with
+// the draws sorted by material, in random order, and sorted but
+// without skipping the material that's already bound.
+// --------------------------------------------------------
+HRESULT Game::RunMaterialBenchmark(unsigned int materialCount)
+{
+	Init();
+
+	const unsigned int drawsPerMaterial = 8;
+	if (materialCount > MaterialRegistry::MaxMaterials)
+		materialCount = MaterialRegistry::MaxMaterials;
+	unsigned int failures = 0;
+
+	// A registry of its own, so the scene's materials aren't counted
+	MaterialRegistry registry(renderDevice, pipelineStates);
+	MaterialDesc desc = {};
+	desc.VertexShader = vertexShader;
+	desc.PixelShader = pixelShader;
+	desc.InstancedVertexShader = instancedVertexShader;
+	desc.Texture = material->GetShaderResourceView();
+	desc.Sampler = samplerState;
+	desc.Parameters.UVScale = XMFLOAT2(1, 1);
+	std::vector<MaterialID> ids(materialCount);
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < materialCount; i++)
+	{
+		desc.Parameters.Tint = XMFLOAT4((float)i / materialCount, 1, 1, 1);
+		ids[i] = registry.Register(desc);
+		failures += ids[i] == 0;
+	}
+	std::chrono::high_resolution_clock::time_point registered = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < materialCount; i++)
+	{
+		desc.Parameters.Tint = XMFLOAT4((float)i / materialCount, 1, 1, 1);
+		failures += registry.Register(desc) != ids[i];
+	}
+	std::chrono::high_resolution_clock::time_point found = std::chrono::high_resolution_clock::now();
+	failures += registry.GetMaterialCount() != materialCount;
+
+	// Each material drawn a few times in a row, then the same draws shuffled
+	std::vector<MaterialID> sortedDraws;
+	for (unsigned int i = 0; i < materialCount; i++)
+		sortedDraws.insert(sortedDraws.end(), drawsPerMaterial, ids[i]);
+	std::vector<MaterialID> shuffledDraws = sortedDraws;
+	std::shuffle(shuffledDraws.begin(), shuffledDraws.end(), std::mt19937(12345));
+
+	const std::vector<MaterialID>* drawOrders[3] = { &sortedDraws, &shuffledDraws, &sortedDraws };
+	double bindNanoseconds[3] = { 0, 0, 0 };
+	unsigned int skipped[3] = { 0, 0, 0 };
+	for (int pass = 0; pass < 3; pass++)
+	{
+		const std::vector<MaterialID>& draws = *drawOrders[pass];
+		bool forget = pass == 2;
+		stateCache->Invalidate();
+
+		MaterialID boundID = 0;
+		std::chrono::high_resolution_clock::time_point passStart = std::chrono::high_resolution_clock::now();
+		for (std::vector<MaterialID>::size_type i = 0; i != draws.size(); i++)
+		{
+			if (forget)
+				boundID = 0;
+			skipped[pass] += draws[i] == boundID;
+			failures += !registry.Bind(stateCache, draws[i], boundID);
+		}
+		std::chrono::high_resolution_clock::time_point passEnd = std::chrono::high_resolution_clock::now();
+		bindNanoseconds[pass] = std::chrono::duration<double, std::nano>(passEnd - passStart).count() / (draws.empty() ? 1.0 : (double)draws.size());
+	}
+	stateCache->Invalidate();
+
+	double materials = materialCount > 0 ? (double)materialCount : 1.0;
+	printf("Material benchmark (%u materials, %u draws each)\n", materialCount, drawsPerMaterial);
+	printf("  Register:        %.3fus per material\n", std::chrono::duration<double, std::micro>(registered - start).count() / materials);
+	printf("  Register again:  %.3fus per material (%u found)\n", std::chrono::duration<double, std::micro>(found - registered).count() / materials, registry.GetDuplicates());
+	printf("  Bind sorted:     %.2fns per draw (%u skipped)\n", bindNanoseconds[0], skipped[0]);
+	printf("  Bind shuffled:   %.2fns per draw (%u skipped)\n", bindNanoseconds[1], skipped[1]);
+	printf("  Bind every draw: %.2fns per draw\n", bindNanoseconds[2]);
+	if (failures > 0)
+		printf("  Failed calls:    %u\n", failures);
+	fflush(stdout);
+
+	return failures == 0 ? S_OK : E_FAIL;
+}
+
+// --------------------------------------------------------
+// Loads each shader the given number of times with and without
+// the reflection cache.  One cached load first makes sure the
+// sidecars exist, so every timed cached load reads one.
+// --------------------------------------------------------
+HRESULT Game::RunShaderLoadBenchmark(unsigned int loads)
+{
+	const wchar_t* vertexShaderFiles[] = { L"VertexShader.cso", L"VertexShaderInstanced.cso" };
+	const wchar_t* pixelShaderFiles[] = { L"PixelShader.cso" };
+	const unsigned int shaderCount = 3;
+	unsigned int failures = 0;
+	unsigned int cacheHits = 0;
+	double milliseconds[2] = { 0, 0 };
+
+	for (int pass = -1; pass < 2; pass++)
+	{
+		// The warm up pass and the last pass use the cache
+		bool useCache = pass != 0;
+		unsigned int passLoads = pass < 0 ? 1 : loads;
+		ISimpleShader::SetReflectionCacheEnabled(useCache);
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < passLoads; i++)
+		{
+			for (unsigned int s = 0; s < 2; s++)
+			{
+				SimpleVertexShader vs(renderDevice);
+				failures += !vs.LoadShaderFile(vertexShaderFiles[s]);
+				cacheHits += pass > 0 && vs.LoadedFromReflectionCache();
+			}
+
+			SimplePixelShader ps(renderDevice);
+			failures += !ps.LoadShaderFile(pixelShaderFiles[0]);
+			cacheHits += pass > 0 && ps.LoadedFromReflectionCache();
+		}
+		std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+
+		if (pass >= 0)
+			milliseconds[pass] = std::chrono::duration<double, std::milli>(end - start).count();
+	}
+	ISimpleShader::SetReflectionCacheEnabled(true);
+
+	double reflectedLoads = loads > 0 ? loads * (double)shaderCount : 1.0;
+	printf("Shader load benchmark (%u loads of %u shaders)\n", loads, shaderCount);
+	printf("  Reflected:       %.3fms per shader\n", milliseconds[0] / reflectedLoads);
+	printf("  From sidecar:    %.3fms per shader (%u of %u)\n", milliseconds[1] / reflectedLoads, cacheHits, loads * shaderCount);
+	printf("  Speedup:         %.2fx\n", milliseconds[1] > 0 ? milliseconds[0] / milliseconds[1] : 0.0);
+	if (failures > 0)
+		printf("  Failed loads:    %u\n", failures);
+	fflush(stdout);
+
+	return failures == 0 ? S_OK : E_FAIL;
+}
+
+// --------------------------------------------------------
+// Submits packets with random shaders, materials, meshes and
+// depths (about one in ten transparent) to a queue of its own,
+// and sorts them with more and more threads.  Each sort starts
+// from the same submission order, and is checked against
+// std::sort of the same keys.
+// --------------------------------------------------------
+HRESULT Game::RunSortBenchmark(unsigned int packetCount)
+{
+	const unsigned int shaderCount = 8;
+	const unsigned int materialCount = 512;
+	const unsigned int meshCount = 64;
+	const unsigned int sortsPerThreadCount = 5;
+	unsigned int failures = 0;
+
+	RenderQueue queue;
+	queue.SetDepthRange(0.1f, 100.0f);
+
+	struct Draw
+	{
+		RenderPass Pass;
+		unsigned int Shader;
+		unsigned int Material;
+		unsigned int Mesh;
+		float Depth;
+	};
+	std::mt19937 random(12345);
+	std::vector<Draw> draws(packetCount);
+	for (unsigned int i = 0; i < packetCount; i++)
+	{
+		draws[i].Pass = random() % 10 == 0 ? RENDER_PASS_TRANSPARENT : RENDER_PASS_OPAQUE;
+		draws[i].Shader = random() % shaderCount;
+		draws[i].Material = random() % materialCount;
+		draws[i].Mesh = random() % meshCount;
+		draws[i].Depth = 0.1f + (random() % 100000) * 0.001f;
+	}
+
+	// The order std::sort puts the keys in, to check against
+	queue.Clear();
+	for (unsigned int i = 0; i < packetCount; i++)
+		queue.Submit(draws[i].Pass, draws[i].Shader, draws[i].Material, draws[i].Mesh, draws[i].Depth, i);
+	std::vector<unsigned long long> expected(packetCount);
+	for (unsigned int i = 0; i < packetCount; i++)
+		expected[i] = queue.GetPackets()[i].Key;
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	std::sort(expected.begin(), expected.end());
+	std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+	double stdSortMilliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+
+	printf("Sort benchmark (%u packets, %u shaders, %u materials, %u meshes)\n", packetCount, shaderCount, materialCount, meshCount);
+	printf("  std::sort:       %.3fms\n", stdSortMilliseconds);
+
+	unsigned int maxThreads = std::thread::hardware_concurrency();
+	if (maxThreads == 0)
+		maxThreads = 1;
+	for (unsigned int threads = 1; ; threads *= 2)
+	{
+		if (threads > maxThreads)
+			threads = maxThreads;
+		queue.SetThreadCount(threads);
+
+		// Best of a few, since the first sort also grows the scratch space
+		double best = 0;
+		for (unsigned int s = 0; s < sortsPerThreadCount; s++)
+		{
+			queue.Clear();
+			for (unsigned int i = 0; i < packetCount; i++)
+				queue.Submit(draws[i].Pass, draws[i].Shader, draws[i].Material, draws[i].Mesh, draws[i].Depth, i);
+			queue.Sort();
+			if (s == 0 || queue.GetLastSortMilliseconds() < best)
+				best = queue.GetLastSortMilliseconds();
+		}
+
+		const std::vector<DrawPacket>& packets = queue.GetPackets();
+		for (unsigned int i = 0; i < packetCount; i++)
+			failures += packets[i].Key != expected[i];
+
+		printf("  Radix sort:      %.3fms on %u thread%s (%.1fM packets/s)\n", best, threads, threads == 1 ? "" : "s",
+			best > 0 ? packetCount / best / 1000.0 : 0.0);
+
+		if (threads == maxThreads)
+			break;
+	}
+
+	unsigned int unsorted = queue.GetStateChangesUnsorted();
+	unsigned int sorted = queue.GetStateChangesSorted();
+	printf("  State changes:   %u unsorted, %u sorted (%u saved, %.1f%%)\n", unsorted, sorted, unsorted - sorted,
+		unsorted > 0 ? 100.0 * (unsorted - sorted) / unsorted : 0.0);
+	if (failures > 0)
+		printf("  Misordered:      %u packets\n", failures);
+	fflush(stdout);
+
+	return failures == 0 ? S_OK : E_FAIL;
+}
+
+// --------------------------------------------------------
+// Records draws of the scene's meshes (each binding its mesh's
+// buffers) through a command recorder of its own, for each
+// draw count and thread count.  The first frame of each is
+// timed apart from the rest, since it's the one that makes the
+// command lists and starts any new worker threads.
+// --------------------------------------------------------
+HRESULT Game::RunRecordingBenchmark(unsigned int drawCount)
+{
+	Init();
+
+	const unsigned int framesPerRun = 20;
+	unsigned int failures = 0;
+
+	// A hundredth, a tenth and all of the draws
+	std::vector<unsigned int> drawCounts;
+	for (unsigned int divisor = 100; divisor > 0; divisor /= 10)
+	{
+		if (drawCount / divisor > 0 && (drawCounts.empty() || drawCounts.back() != drawCount / divisor))
+			drawCounts.push_back(drawCount / divisor);
+	}
+
+	// At least up to four threads, even with fewer cores, so the
+	// worker threads are always part of it
+	unsigned int maxThreads = std::thread::hardware_concurrency();
+	if (maxThreads < 4)
+		maxThreads = 4;
+
+	auto recordDraws = [this](IRenderContext* context, unsigned int first, unsigned int count)
+	{
+		unsigned int stride = sizeof(Vertex);
+		unsigned int offset = 0;
+		for (unsigned int i = first; i < first + count; i++)
+		{
+			Mesh* mesh = meshes[i % meshes.size()];
+			ID3D11Buffer* vertexBuffer = mesh->GetVertexBuffer();
+			context->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+			context->IASetIndexBuffer(mesh->GetIndexBuffer(), DXGI_FORMAT_R32_UINT, 0);
+			context->DrawIndexed(mesh->GetIndexCount(), 0, 0);
+		}
+	};
+
+	printf("Recording benchmark (%u frames each)\n", framesPerRun);
+	for (std::vector<unsigned int>::size_type d = 0; d != drawCounts.size(); d++)
+	{
+		for (unsigned int threads = 1; ; threads *= 2)
+		{
+			if (threads > maxThreads)
+				threads = maxThreads;
+
+			CommandRecorder recorder([this]() -> ICommandList* { return renderDevice->CreateCommandList(); });
+			recorder.SetThreadCount(threads);
+			recorder.SetMinItemsPerThread(1);
+
+			double firstFrame = 0;
+			double record = 0;
+			double execute = 0;
+			for (unsigned int frame = 0; frame < framesPerRun; frame++)
+			{
+				std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+				recorder.Record(stateCache, drawCounts[d], recordDraws);
+				std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+
+				failures += recorder.GetThreadsUsed() != (threads < drawCounts[d] ? threads : drawCounts[d]);
+				if (frame == 0)
+				{
+					firstFrame = std::chrono::duration<double, std::milli>(end - start).count();
+					continue;
+				}
+				record += recorder.GetRecordMilliseconds();
+				execute += recorder.GetExecuteMilliseconds();
+			}
+			stateCache->Invalidate();
+
+			double frames = framesPerRun > 1 ? framesPerRun - 1.0 : 1.0;
+			printf("  %7u draws, %2u thread%s: %.3fms record + %.3fms execute per frame (%.1fns per draw, first frame %.3fms)\n",
+				drawCounts[d], threads, threads == 1 ? " " : "s", record / frames, execute / frames,
+				(record + execute) / frames * 1000000.0 / drawCounts[d], firstFrame);
+
+			if (threads == maxThreads)
+				break;
+		}
+	}
+	if (failures > 0)
+		printf("  Wrong thread counts: %u\n", failures);
+	fflush(stdout);
+
+	return failures == 0 ? S_OK : E_FAIL;
+}
+
+// --------------------------------------------------------
+// Runs the scene with the stress test entities static, then
+// makes them movable (which the static batcher notices on its
+// own) and runs it again.  Both runs count the game's own draw
+// calls.  Halfway through the static run one entity is moved,
+// which has to rebuild the batches once more.
+// --------------------------------------------------------
+HRESULT Game::RunStaticBatchBenchmark(unsigned int entityCount, unsigned int frameCount)
+{
+	SetStressTest(entityCount, true);
+	Init();
+
+	unsigned int firstStressEntity = (unsigned int)(entities.size() - entityCount);
+	float deltaTime = 1.0f / 60.0f;
+	float totalTime = 0;
+	double frames = frameCount > 0 ? (double)frameCount : 1.0;
+	unsigned int failures = 0;
+
+	double draws[2] = { 0, 0 };
+	double drawMilliseconds[2] = { 0, 0 };
+	unsigned int timedFrames[2] = { 0, 0 };
+	double staticEntities = 0;
+	double staticDraws = 0;
+	unsigned int builds[2] = { 0, 0 };
+	for (int pass = 0; pass < 2; pass++)
+	{
+		unsigned int buildsBefore = staticBatcher->GetBuildCount();
+		for (unsigned int frame = 0; frame < frameCount; frame++)
+		{
+			if (pass == 0 && frame == frameCount / 2 && entityCount > 0)
+			{
+				XMFLOAT3 position = entities[firstStressEntity].GetPosition();
+				entities[firstStressEntity].SetPosition(XMFLOAT3(position.x, position.y + 0.5f, position.z));
+			}
+
+			Update(deltaTime, totalTime);
+			unsigned int buildsBeforeFrame = staticBatcher->GetBuildCount();
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			Draw(deltaTime, totalTime);
+			std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+			totalTime += deltaTime;
+
+			// Frames that rebuilt the batches aren't timed
+			draws[pass] += drawCallsLastFrame;
+			if (staticBatcher->GetBuildCount() == buildsBeforeFrame)
+			{
+				drawMilliseconds[pass] += std::chrono::duration<double, std::milli>(end - start).count();
+				timedFrames[pass]++;
+			}
+			if (pass == 0)
+			{
+				staticEntities += staticEntitiesLastFrame;
+				staticDraws += staticDrawsLastFrame;
+			}
+		}
+		builds[pass] = staticBatcher->GetBuildCount() - buildsBefore;
+
+		for (unsigned int i = firstStressEntity; i < (unsigned int)entities.size(); i++)
+			entities[i].SetStatic(false);
+	}
+
+	// The first frame builds, and so does the move.  Making them all
+	// movable builds once more, with nothing left to batch.
+	failures += frameCount > 1 && entityCount > 0 && builds[0] != 2;
+	failures += frameCount > 0 && entityCount > 0 && builds[1] != 1;
+	failures += staticBatcher->GetBatchedEntityCount() != 0;
+
+	printf("Static batch benchmark (%u static entities, %u frames)\n", entityCount, frameCount);
+	printf("  Static:          %.1f draws per frame, %.4fms to draw (%.1f entities in %.1f batch draws)\n",
+		draws[0] / frames, drawMilliseconds[0] / (timedFrames[0] > 0 ? timedFrames[0] : 1), staticEntities / frames, staticDraws / frames);
+	printf("  Movable:         %.1f draws per frame, %.4fms to draw\n", draws[1] / frames, drawMilliseconds[1] / (timedFrames[1] > 0 ? timedFrames[1] : 1));
+	printf("  Batching saved:  %.1f draws per frame over one each, %.1f over instancing\n",
+		(staticEntities - staticDraws) / frames, (draws[1] - draws[0]) / frames);
+	printf("  Rebuilds:        %u static, %u movable\n", builds[0], builds[1]);
+	if (failures > 0)
+		printf("  Failed checks:   %u\n", failures);
+	fflush(stdout);
+
+	return failures == 0 ? S_OK : E_FAIL;
+}
+
+// --------------------------------------------------------
+// Fills the shader cache with every pixel shader variant, so
+// nothing has to compile at run time
+// --------------------------------------------------------
+HRESULT Game::PrecompileShaderVariants()
+{
+	Init();
+
+	const ShaderPermutationSet& features = pixelShaderVariants->GetPermutations();
+	unsigned int failures = pixelShaderVariants->PrecompileAll();
+	printf("Precompiled pixel shader variants: %llu variants, %u failed\n", features.GetVariantCount(), failures);
+	fflush(stdout);
+
+	return failures == 0 ? S_OK : E_FAIL;
 }
 
 #pragma region Mouse Input
@@ -384,7 +1506,9 @@ void Game::OnMouseDown(WPARAM buttonState, int x, int y)
 	// Caputure the mouse so we keep getting mouse move
 	// events even if the mouse leaves the window.  we'll be
 	// releasing the capture once a mouse button is released
+#ifdef _WIN32
 	SetCapture(hWnd);
+#endif
 }
 
 // --------------------------------------------------------
@@ -396,7 +1520,9 @@ void Game::OnMouseUp(WPARAM buttonState, int x, int y)
 
 	// We don't care about the tracking the cursor outside
 	// the window anymore (we're not dragging if the mouse is up)
+#ifdef _WIN32
 	ReleaseCapture();
+#endif
 }
 
 // --------------------------------------------------------
@@ -2,10 +2,29 @@
 
 #include "DXCore.h"
 #include "SimpleShader.h"
+#include "ShaderVariantCache.h"
 #include "Entity.h"
 #include "Camera.h"
+#include "CullingSystem.h"
+#include "RenderQueue.h"
+#include "StateCache.h"
+#include "PipelineState.h"
+#include "MaterialRegistry.h"
+#include "TextureArrayBuilder.h"
+#include "ConstantUploadRing.h"
+#include "UploadManager.h"
+#include "TextureStreamer.h"
+#include "InstanceBatcher.h"
+#include "StaticBatcher.h"
+#include "TransformBuffer.h"
+#include "CommandRecorder.h"
+#include "FrameGraph.h"
+#include "RenderStats.h"
 #include "DirectionalLight.h"
+#include "ShaderConstants.h"
+#ifdef _WIN32
 #include "WICTextureLoader.h"
+#endif
 #include <DirectXMath.h>
 #include <vector>
 
@@ -30,14 +49,75 @@ public:
 	void OnMouseMove (WPARAM buttonState, int x, int y);
 	void OnMouseWheel(float wheelDelta,   int x, int y);
 
+	// Draw call stats for the title bar
+	std::string GetExtraTitleBarStats();
+
+	// Headless microbenchmark of the per-entity shader setters, by
+	// name and through handles.  Call after InitHeadless().
+	HRESULT RunSetterBenchmark(unsigned int iterations);
+
+	// Headless benchmark of loading every shader, reflecting each one
+	// against reading its reflection sidecar.  Call after InitHeadless().
+	HRESULT RunShaderLoadBenchmark(unsigned int loads);
+
+	// Headless benchmark of registering materials (and registering them
+	// again, which only finds them) and binding them for draws sorted by
+	// material and in random order.  Call after InitHeadless().
+	HRESULT RunMaterialBenchmark(unsigned int materialCount);
+
+	// Headless benchmark of sorting a frame's worth of draw packets on
+	// one thread and more, and of how many state changes sorting saves.
+	// Call after InitHeadless().
+	HRESULT RunSortBenchmark(unsigned int packetCount);
+
+	// Headless benchmark of recording draws into command lists across
+	// worker threads and playing them back, for a few draw counts up to
+	// the one given and a few thread counts.  Call after InitHeadless().
+	HRESULT RunRecordingBenchmark(unsigned int drawCount);
+
+	// Compiles every pixel shader variant into the shader cache, for
+	// running as an offline step.  Call after InitHeadless().
+	HRESULT PrecompileShaderVariants();
+
+	// Extra entities spawned in a grid behind the scene, for measuring
+	// how many draws instancing (or static batching, if they're made
+	// static) saves.  Call before Init().
+	void SetStressTest(unsigned int count, bool staticEntities) { stressTestEntityCount = count; stressTestStatic = staticEntities; }
+
+	// Headless benchmark of static batching: draws that many static
+	// stress test entities for a number of frames, then the same with
+	// them movable, and prints the draws each way.  Call after
+	// InitHeadless(), instead of SetStressTest().
+	HRESULT RunStaticBatchBenchmark(unsigned int entityCount, unsigned int frameCount);
+
 private:
 	// Initialization helper methods - feel free to customize, combine, etc.
 	void LoadMaterials();
 	void CreateBasicGeometry();
 	void LoadModels();
+	void CreateStressTestEntities(unsigned int count);
+
+	// Makes sure the instance buffer can hold at least this many transform indices
+	void ReserveInstanceBuffer(unsigned int instanceCount);
+
+	// Drawing helpers, safe to call from several threads with different contexts
+	void SetFrameState(IRenderContext* context);
+	void DrawInstanceBatches(IRenderContext* context, const PipelineState*& previousPipelineState, MaterialID& previousMaterial, unsigned int firstBatch, unsigned int batchCount);
+
+	// Draws the static batches inside the frustum on this thread
+	void DrawStaticBatches();
+
+	// Clears and draws every entity into the scene views below
+	void DrawScene();
+
+	// Adds this frame's render stats to the history
+	void RecordRenderStats(float deltaTime);
+	std::string GetRenderStatsText();
 
 	// Entity Vector Collection
 	std::vector<Entity> entities;
+	unsigned int stressTestEntityCount;
+	bool stressTestStatic;
 
 	// Mesh Pointer Vector Collection
 	std::vector<Mesh*> meshes;
@@ -45,16 +125,119 @@ private:
 	// FPS camera
 	Camera* camera;
 
+	// Frustum culling with visibility kept between frames
+	CullingSystem* cullingSystem;
+	std::vector<unsigned int> visibleEntities;
+
+	// Sorted list of draws built from the visible entities each frame
+	RenderQueue* renderQueue;
+
+	// Drawing goes through the state cache, which drops redundant
+	// calls before they reach the render device's immediate context
+	StateCache* stateCache;
+
+	// The pipeline state last bound through the state cache, so
+	// the next one only sets what's different.  Null when nothing's
+	// known, like after command lists have reset the context.
+	const PipelineState* boundPipelineState;
+
+	// The material last bound through the state cache, 0 when nothing's known
+	MaterialID boundMaterialID;
+
+	// Mesh and texture data is queued here and sent to the GPU a
+	// budgeted amount at a time
+	UploadManager* uploadManager;
+
+	// Textures that stream in a mip at a time through the upload
+	// manager, as fine as how big they are on screen needs
+	TextureStreamer* textureStreamer;
+
+	// Per-draw shader constants are appended into one big ring each
+	// frame, with each draw binding just its own slice of it
+	ConstantUploadRing* constantUploadRing;
+
+	// Every entity's world matrix on the GPU, where only the ones that
+	// moved are uploaded each frame
+	TransformBuffer* transformBuffer;
+
+	// Sorted draws that share a mesh and material are batched into
+	// instanced draws, with the instance buffer holding which of the
+	// transform buffer's world matrices each instance uses
+	InstanceBatcher* instanceBatcher;
+	std::vector<unsigned long long> instanceGroupKeys;
+	std::vector<unsigned int> instanceTextureSlices;
+	ID3D11Buffer* instanceBuffer;
+	unsigned int instanceBufferCapacity;
+
+	// Static entities are merged into pre-transformed batches and
+	// left out of the render queue
+	StaticBatcher* staticBatcher;
+	unsigned int staticDrawsLastFrame;
+	unsigned int staticEntitiesLastFrame;
+
+	// Describes the frame's passes and the textures they use, and makes
+	// the transient ones (like the depth buffer) as they're needed
+	FrameGraph* frameGraph;
+
+	// What the scene pass draws into this frame, from the frame graph
+	ID3D11RenderTargetView* sceneRenderTarget;
+	ID3D11DepthStencilView* sceneDepthStencil;
+
+	// Records instanced batches across worker threads into command lists
+	CommandRecorder* commandRecorder;
+	std::vector<Material*> preparedMaterials;
+
+	// Draw stats for the last frame
+	unsigned int drawCallsLastFrame;
+	unsigned int instancesLastFrame;
+
+	// Shader constant buffers uploaded last frame, and ones skipped
+	// because their data hadn't changed
+	unsigned int constantUploadsLastFrame;
+	unsigned int constantUploadsSkippedLastFrame;
+
+	// Shader resources and samplers staged by the shaders last frame,
+	// and the bind calls it took to send them
+	unsigned int resourceBindingsStagedLastFrame;
+	unsigned int resourceBindCallsLastFrame;
+
+	// What reached the GPU each frame, kept for the last few seconds.
+	// Device stats only ever go up, so the last frame's totals are
+	// kept to work out how much each frame added.
+	RenderStats* renderStats;
+	RenderStatCounters deviceRenderStats;
+
 	// Wrappers for DirectX shaders to provide simplified functionality
 	SimpleVertexShader* vertexShader;
+	SimpleVertexShader* instancedVertexShader;
 	SimplePixelShader* pixelShader;
 
-	// DXTK Texture resources
-	ID3D11ShaderResourceView* shaderResourceView;
+	// Every variant of the pixel shader that's been asked for, which
+	// owns them all - including the default one in pixelShader
+	ShaderVariantCache* pixelShaderVariants;
+
+	// Input layouts shared by every vertex shader
+	InputLayoutCache* inputLayoutCache;
+
+	// Pipeline states, samplers and the fixed function states
+	// inside them, each made once and shared
+	PipelineStateCache* pipelineStates;
+
+	// Every material, each made once, with the IDs draws are sorted by
+	MaterialRegistry* materialRegistry;
+
+	// Base color textures, packed into texture arrays by shape
+	TextureArrayBuilder* textureArrays;
 	ID3D11SamplerState* samplerState;
 
-	// Basic Material reference
+	// Ambient occlusion, roughness and height for the cliff material,
+	// packed into one streamed texture
+	StreamedTextureID cliffMaps;
+
+	// Basic Material references, owned by the registry
 	Material* material;
+	Material* snowMaterial;
+	Material* cliffMaterial;
 
 	// Keeps track of the old mouse position.  Useful for 
 	// determining how far the mouse moved in a single frame.
@@ -63,7 +246,10 @@ private:
 	// Indicates whether the left mouse button is pressed
 	bool mouseDown;
 
-	// Directional Lights
-	DirectionalLight lights[4];
+	// Directional Lights, laid out like the pixel shader's light buffer
+	LightConstants lightData;
+
+	// Each loaded pixel shader variant's light buffer, in load order
+	std::vector<ConstantBufferHandle<LightConstants>> lightDataHandles;
 };
 
@@ -0,0 +1,134 @@
+#include "InputLayoutCache.h"
+
+InputLayoutCache::InputLayoutCache(IRenderDevice* device)
+{
+	this->device = device;
+	lookups = 0;
+	hits = 0;
+}
+
+// --------------------------------------------------------
+// Anything still cached is released, whoever was using it
+// --------------------------------------------------------
+InputLayoutCache::~InputLayoutCache()
+{
+	for (std::unordered_multimap<unsigned long long, CachedLayout>::iterator it = layouts.begin(); it != layouts.end(); ++it)
+		device->Release(it->second.InputLayout);
+}
+
+ID3D11InputLayout* InputLayoutCache::Acquire(const InputElementDesc* elements, unsigned int elementCount, const void* byteCode, size_t byteCodeSize)
+{
+	lookups++;
+
+	// Same hash is only a candidate - the elements have to match too
+	unsigned long long hash = HashElements(elements, elementCount);
+	std::pair<std::unordered_multimap<unsigned long long, CachedLayout>::iterator, std::unordered_multimap<unsigned long long, CachedLayout>::iterator> range = layouts.equal_range(hash);
+	for (std::unordered_multimap<unsigned long long, CachedLayout>::iterator it = range.first; it != range.second; ++it)
+	{
+		if (Matches(it->second, elements, elementCount))
+		{
+			hits++;
+			it->second.References++;
+			return it->second.InputLayout;
+		}
+	}
+
+	ID3D11InputLayout* inputLayout = device->CreateInputLayout(elements, elementCount, byteCode, byteCodeSize);
+	if (!inputLayout)
+		return 0;
+
+	CachedLayout layout;
+	layout.InputLayout = inputLayout;
+	layout.References = 1;
+	layout.Elements.resize(elementCount);
+	for (unsigned int i = 0; i < elementCount; i++)
+	{
+		CachedElement& element = layout.Elements[i];
+		element.SemanticName = elements[i].SemanticName ? elements[i].SemanticName : "";
+		element.SemanticIndex = elements[i].SemanticIndex;
+		element.Format = elements[i].Format;
+		element.InputSlot = elements[i].InputSlot;
+		element.AlignedByteOffset = elements[i].AlignedByteOffset;
+		element.PerInstance = elements[i].PerInstance;
+		element.InstanceDataStepRate = elements[i].InstanceDataStepRate;
+	}
+	layouts.insert(std::make_pair(hash, layout));
+	return inputLayout;
+}
+
+bool InputLayoutCache::Release(ID3D11InputLayout* inputLayout)
+{
+	for (std::unordered_multimap<unsigned long long, CachedLayout>::iterator it = layouts.begin(); it != layouts.end(); ++it)
+	{
+		if (it->second.InputLayout != inputLayout)
+			continue;
+
+		if (--it->second.References == 0)
+		{
+			device->Release(inputLayout);
+			layouts.erase(it);
+		}
+		return true;
+	}
+	return false;
+}
+
+unsigned long long InputLayoutCache::GetHash(ID3D11InputLayout* inputLayout)
+{
+	for (std::unordered_multimap<unsigned long long, CachedLayout>::iterator it = layouts.begin(); it != layouts.end(); ++it)
+	{
+		if (it->second.InputLayout == inputLayout)
+			return it->first;
+	}
+	return 0;
+}
+
+unsigned long long InputLayoutCache::HashElements(const InputElementDesc* elements, unsigned int elementCount)
+{
+	unsigned long long hash = 14695981039346656037ull;
+	auto hashByte = [&hash](unsigned char value)
+	{
+		hash = (hash ^ value) * 1099511628211ull;
+	};
+	auto hashNumber = [&hashByte](unsigned int value)
+	{
+		for (int i = 0; i < 4; i++)
+			hashByte((unsigned char)((value >> (i * 8)) & 0xFF));
+	};
+
+	for (unsigned int i = 0; i < elementCount; i++)
+	{
+		// The name's terminator goes in too, so "AB","C" differs from "A","BC"
+		for (const char* c = elements[i].SemanticName; c && *c; c++)
+			hashByte((unsigned char)*c);
+		hashByte(0);
+
+		hashNumber(elements[i].SemanticIndex);
+		hashNumber(elements[i].Format);
+		hashNumber(elements[i].InputSlot);
+		hashNumber(elements[i].AlignedByteOffset);
+		hashByte(elements[i].PerInstance ? 1 : 0);
+		hashNumber(elements[i].InstanceDataStepRate);
+	}
+	return hash;
+}
+
+bool InputLayoutCache::Matches(const CachedLayout& layout, const InputElementDesc* elements, unsigned int elementCount)
+{
+	if (layout.Elements.size() != elementCount)
+		return false;
+
+	for (unsigned int i = 0; i < elementCount; i++)
+	{
+		const CachedElement& element = layout.Elements[i];
+		if (element.SemanticName != (elements[i].SemanticName ? elements[i].SemanticName : "") ||
+			element.SemanticIndex != elements[i].SemanticIndex ||
+			element.Format != elements[i].Format ||
+			element.InputSlot != elements[i].InputSlot ||
+			element.AlignedByteOffset != elements[i].AlignedByteOffset ||
+			element.PerInstance != elements[i].PerInstance ||
+			element.InstanceDataStepRate != elements[i].InstanceDataStepRate)
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "RenderDevice.h"
+
+// --------------------------------------------------------
+// Input layouts shared between vertex shaders that take the
+// same vertex format.  Layouts are found by a hash of their
+// element descriptions, then compared element by element, so
+// every shader asking for the same elements gets the same
+// layout - and switching between those shaders leaves the
+// bound layout alone, since the state cache only passes on
+// layouts that actually differ.
+//
+// Layouts are reference counted, and released through the
+// device when the last shader using one lets it go.
+// --------------------------------------------------------
+class InputLayoutCache
+{
+public:
+	InputLayoutCache(IRenderDevice* device); // Constructor
+	~InputLayoutCache(); // Destructor
+
+	// The layout for these elements, made with the given shader code if
+	// it's the first time they've been asked for.  Null if it couldn't be
+	// made.  Every layout returned has to be given back to Release().
+	ID3D11InputLayout* Acquire(const InputElementDesc* elements, unsigned int elementCount, const void* byteCode, size_t byteCodeSize);
+
+	// False if the layout didn't come from this cache
+	bool Release(ID3D11InputLayout* inputLayout);
+
+	// The hash a layout was stored under, or 0 if it isn't from this cache
+	unsigned long long GetHash(ID3D11InputLayout* inputLayout);
+
+	// FNV-1a 64 of every field of every element, semantic names included
+	static unsigned long long HashElements(const InputElementDesc* elements, unsigned int elementCount);
+
+	IRenderDevice* GetDevice() { return device; }
+
+	// Stats
+	size_t GetLayoutCount() { return layouts.size(); }
+	unsigned int GetLookups() { return lookups; }
+	unsigned int GetHits() { return hits; }
+	float GetHitRate() { return lookups > 0 ? (float)hits / lookups : 0.0f; }
+	void ResetStats() { lookups = 0; hits = 0; }
+
+private:
+	// A copy of an element, holding its own semantic name
+	struct CachedElement
+	{
+		std::string SemanticName;
+		unsigned int SemanticIndex;
+		unsigned int Format;
+		unsigned int InputSlot;
+		unsigned int AlignedByteOffset;
+		bool PerInstance;
+		unsigned int InstanceDataStepRate;
+	};
+
+	struct CachedLayout
+	{
+		std::vector<CachedElement> Elements;
+		ID3D11InputLayout* InputLayout;
+		unsigned int References;
+	};
+
+	IRenderDevice* device;
+	std::unordered_multimap<unsigned long long, CachedLayout> layouts;
+	unsigned int lookups;
+	unsigned int hits;
+
+	static bool Matches(const CachedLayout& layout, const InputElementDesc* elements, unsigned int elementCount);
+};
@@ -0,0 +1,70 @@
+#include "InstanceBatcher.h"
+
+InstanceBatcher::InstanceBatcher()
+{
+	maxInstances = 0;
+	largestBatch = 0;
+}
+
+InstanceBatcher::~InstanceBatcher()
+{
+}
+
+void InstanceBatcher::SetMaxInstances(unsigned int maxInstances)
+{
+	this->maxInstances = maxInstances;
+}
+
+// --------------------------------------------------------
+// Walks the packets in order, starting a new batch whenever
+// the group key changes or the current batch is full
+// --------------------------------------------------------
+void InstanceBatcher::Build(const std::vector<DrawPacket>& packets, const std::vector<unsigned long long>& groupKeys)
+{
+	batches.clear();
+	largestBatch = 0;
+
+	for (unsigned int i = 0; i < (unsigned int)packets.size(); i++)
+	{
+		unsigned long long key = groupKeys[packets[i].EntityIndex];
+
+		bool startBatch = batches.empty();
+		if (!startBatch)
+		{
+			InstanceBatch& current = batches.back();
+			unsigned long long currentKey = groupKeys[packets[current.FirstPacket].EntityIndex];
+			startBatch = key != currentKey || (maxInstances > 0 && current.Count >= maxInstances);
+		}
+
+		if (startBatch)
+		{
+			InstanceBatch batch;
+			batch.FirstPacket = i;
+			batch.Count = 0;
+			batches.push_back(batch);
+		}
+
+		batches.back().Count++;
+		if (batches.back().Count > largestBatch)
+			largestBatch = batches.back().Count;
+	}
+}
+
+void InstanceBatcher::WriteInstances(const std::vector<DrawPacket>& packets, const std::vector<unsigned int>& textureSlices, InstanceData* instances)
+{
+	for (std::vector<DrawPacket>::size_type i = 0; i != packets.size(); i++)
+	{
+		instances[i].TransformIndex = packets[i].EntityIndex;
+		instances[i].TextureSlice = textureSlices[packets[i].EntityIndex];
+	}
+}
+
+const std::vector<InstanceBatch>& InstanceBatcher::GetBatches()
+{
+	return batches;
+}
+
+unsigned int InstanceBatcher::GetLargestBatch()
+{
+	return largestBatch;
+}
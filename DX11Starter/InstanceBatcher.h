@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+#include "RadixSort.h"
+
+// --------------------------------------------------------
+// What the instance buffer holds for each instance, matching
+// the _PER_INSTANCE inputs of VertexShaderInstanced.hlsl
+// --------------------------------------------------------
+struct InstanceData
+{
+	unsigned int TransformIndex;	// Which world matrix in the transform buffer
+	unsigned int TextureSlice;		// Which slice of the material's texture array
+};
+
+// --------------------------------------------------------
+// A run of neighbouring packets that can be drawn with a
+// single instanced draw call
+// --------------------------------------------------------
+struct InstanceBatch
+{
+	unsigned int FirstPacket;	// Index of the first packet (and instance) in the batch
+	unsigned int Count;			// Number of packets in the batch
+};
+
+// --------------------------------------------------------
+// Groups sorted draw packets into instanced batches.
+//
+// Only neighbouring packets are merged, so the sorted draw
+// order (and with it transparency ordering) is kept intact.
+// The batcher knows nothing about DirectX, it just compares
+// a caller supplied group key for each entity.
+// --------------------------------------------------------
+class InstanceBatcher
+{
+public:
+	InstanceBatcher(); // Constructor
+	~InstanceBatcher(); // Destructor
+
+	// Largest batch allowed (0 for no limit)
+	void SetMaxInstances(unsigned int maxInstances);
+
+	// Splits the packets into batches.  groupKeys is indexed by
+	// entity index, and packets with equal keys can share a batch.
+	void Build(const std::vector<DrawPacket>& packets, const std::vector<unsigned long long>& groupKeys);
+
+	// Fills in one instance per packet, in packet order, so each batch's
+	// instances start at its first packet.  textureSlices is indexed by
+	// entity index, like the group keys.
+	static void WriteInstances(const std::vector<DrawPacket>& packets, const std::vector<unsigned int>& textureSlices, InstanceData* instances);
+
+	// GET methods
+	const std::vector<InstanceBatch>& GetBatches();
+	unsigned int GetLargestBatch();
+
+private:
+	std::vector<InstanceBatch> batches;
+	unsigned int maxInstances;
+	unsigned int largestBatch;
+};
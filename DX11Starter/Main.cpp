@@ -1,7 +1,150 @@
-
-#include <Windows.h>
+#include "Platform.h"
 #include "Game.h"
 
+#include <cstring>
+#include <string>
+
+// --------------------------------------------------------
+// Options that change the scene, whichever way it's run
+//  - "-stress 10000" adds that many entities behind the scene,
+//    to see what instancing makes of them.  With "-headless"
+//    the draws and instances per frame are printed at the end.
+//  - "-stress-static 10000" does the same with static entities,
+//    to see what static batching makes of them
+// --------------------------------------------------------
+static void ReadSceneOptions(Game& game, const char* commandLine)
+{
+	const char* staticStressArg = strstr(commandLine, "-stress-static");
+	if (staticStressArg)
+	{
+		unsigned int entityCount = 10000;
+		sscanf_s(staticStressArg, "-stress-static %u", &entityCount);
+		game.SetStressTest(entityCount, true);
+		return;
+	}
+
+	const char* stressArg = strstr(commandLine, "-stress");
+	if (stressArg)
+	{
+		unsigned int entityCount = 10000;
+		sscanf_s(stressArg, "-stress %u", &entityCount);
+		game.SetStressTest(entityCount, false);
+	}
+}
+
+// --------------------------------------------------------
+// Runs the game without a window or GPU if the command line
+// asks for it, for profiling.  Returns false when it doesn't,
+// otherwise puts how the run went in hr.
+//  - "-headless 1000" runs 1000 frames on the null render device
+//    and prints the timings to the console it was started from
+//  - "-benchmark-setters 100000" times setting a material's shader
+//    values by name against setting them through handles
+//  - "-benchmark-shader-loads 100" times loading every shader with
+//    and without the reflection sidecars next to them
+//  - "-benchmark-materials 10000" times registering that many
+//    materials and binding them in sorted and random order
+//  - "-benchmark-sort 1000000" times sorting that many draw
+//    packets on more and more threads, and prints the state
+//    changes sorting saved
+//  - "-benchmark-recording 10000" times recording up to that
+//    many draws across worker threads and playing them back
+//  - "-benchmark-static 10000" draws that many static entities
+//    for 100 frames, then the same movable, and prints the draw
+//    calls static batching saved
+//  - "-precompile-shader-variants" compiles every pixel shader
+//    variant into the shader cache and exits
+// --------------------------------------------------------
+static bool RunHeadlessMode(Game& game, const char* commandLine, HRESULT& hr)
+{
+	if (strstr(commandLine, "-precompile-shader-variants"))
+	{
+		hr = game.InitHeadless();
+		if(SUCCEEDED(hr)) hr = game.PrecompileShaderVariants();
+		return true;
+	}
+
+	const char* shaderLoadArg = strstr(commandLine, "-benchmark-shader-loads");
+	if (shaderLoadArg)
+	{
+		unsigned int loads = 100;
+		sscanf_s(shaderLoadArg, "-benchmark-shader-loads %u", &loads);
+
+		hr = game.InitHeadless();
+		if(SUCCEEDED(hr)) hr = game.RunShaderLoadBenchmark(loads);
+		return true;
+	}
+
+	const char* materialArg = strstr(commandLine, "-benchmark-materials");
+	if (materialArg)
+	{
+		unsigned int materialCount = 10000;
+		sscanf_s(materialArg, "-benchmark-materials %u", &materialCount);
+
+		hr = game.InitHeadless();
+		if(SUCCEEDED(hr)) hr = game.RunMaterialBenchmark(materialCount);
+		return true;
+	}
+
+	const char* sortArg = strstr(commandLine, "-benchmark-sort");
+	if (sortArg)
+	{
+		unsigned int packetCount = 1000000;
+		sscanf_s(sortArg, "-benchmark-sort %u", &packetCount);
+
+		hr = game.InitHeadless();
+		if(SUCCEEDED(hr)) hr = game.RunSortBenchmark(packetCount);
+		return true;
+	}
+
+	const char* recordingArg = strstr(commandLine, "-benchmark-recording");
+	if (recordingArg)
+	{
+		unsigned int drawCount = 10000;
+		sscanf_s(recordingArg, "-benchmark-recording %u", &drawCount);
+
+		hr = game.InitHeadless();
+		if(SUCCEEDED(hr)) hr = game.RunRecordingBenchmark(drawCount);
+		return true;
+	}
+
+	const char* staticArg = strstr(commandLine, "-benchmark-static");
+	if (staticArg)
+	{
+		unsigned int entityCount = 10000;
+		sscanf_s(staticArg, "-benchmark-static %u", &entityCount);
+
+		hr = game.InitHeadless();
+		if(SUCCEEDED(hr)) hr = game.RunStaticBatchBenchmark(entityCount, 100);
+		return true;
+	}
+
+	const char* benchmarkArg = strstr(commandLine, "-benchmark-setters");
+	if (benchmarkArg)
+	{
+		unsigned int iterations = 100000;
+		sscanf_s(benchmarkArg, "-benchmark-setters %u", &iterations);
+
+		hr = game.InitHeadless();
+		if(SUCCEEDED(hr)) hr = game.RunSetterBenchmark(iterations);
+		return true;
+	}
+
+	const char* headlessArg = strstr(commandLine, "-headless");
+	if (headlessArg)
+	{
+		unsigned int frameCount = 1000;
+		sscanf_s(headlessArg, "-headless %u", &frameCount);
+
+		hr = game.InitHeadless();
+		if(SUCCEEDED(hr)) hr = game.RunHeadless(frameCount);
+		return true;
+	}
+
+	return false;
+}
+
+#ifdef _WIN32
 // --------------------------------------------------------
 // Entry point for a graphical (non-console) Windows application
 // --------------------------------------------------------
@@ -48,8 +191,11 @@ int WINAPI WinMain(
 	// the app handle we got from WinMain
 	Game dxGame(hInstance);
 
-	// Result variable for function calls below
+	// Run without a window or GPU if asked to
+	ReadSceneOptions(dxGame, lpCmdLine);
 	HRESULT hr = S_OK;
+	if (RunHeadlessMode(dxGame, lpCmdLine, hr))
+		return hr;
 
 	// Attempt to create the window for our program, and
 	// exit early if something failed
@@ -65,3 +211,42 @@ int WINAPI WinMain(
 	// whatever we get back once the game loop is over
 	return dxGame.Run();
 }
+#else
+// --------------------------------------------------------
+// Entry point everywhere else, where there's no window and
+// the game can only run on the null render device.  Builds
+// with nothing but DirectXMath (and a sal.h, which it needs
+// off Windows) from the repository root:
+//
+//   g++ -std=c++14 -O2 -pthread -I DX11Starter -I <DirectXMath>/Inc
+//       -I <sal.h folder> -o Game DX11Starter/*.cpp
+//
+// Run it from a folder holding resources/ and the .cso and
+// .refl files from a Windows build.  Shaders can't be compiled
+// or reflected without Windows, so they're invalid without
+// those, but everything else still runs.
+//
+// Takes the same options as the Windows build, and runs
+// "-headless 1000" when given none.
+// --------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	std::string commandLine;
+	for (int i = 1; i < argc; i++)
+	{
+		commandLine += argv[i];
+		commandLine += " ";
+	}
+
+	Game game(0);
+	ReadSceneOptions(game, commandLine.c_str());
+	HRESULT hr = S_OK;
+	if (!RunHeadlessMode(game, commandLine.c_str(), hr))
+	{
+		hr = game.InitHeadless();
+		if (SUCCEEDED(hr)) hr = game.RunHeadless(1000);
+	}
+
+	return FAILED(hr) ? 1 : 0;
+}
+#endif
@@ -3,12 +3,41 @@
 // For the DirectX Math library
 using namespace DirectX;
 
+// Names of the shader variables and resources every material sets
+static constexpr ShaderNameHash WorldName = HashShaderName("world");
+static constexpr ShaderNameHash ViewName = HashShaderName("view");
+static constexpr ShaderNameHash ProjectionName = HashShaderName("projection");
+static constexpr ShaderNameHash SamplerName = HashShaderName("samplerState");
+static constexpr ShaderNameHash TextureName = HashShaderName("textureBaseColor");
+static constexpr ShaderNameHash MaterialMapsName = HashShaderName("textureMaterialMaps");
+static constexpr ShaderNameHash TransformsName = HashShaderName("transforms");
+
 Material::Material(SimpleVertexShader* vertexShader, SimplePixelShader* pixelShader, ID3D11ShaderResourceView* shaderResourceView, ID3D11SamplerState* samplerState)
 {
 	this->vertexShader = vertexShader;
 	this->pixelShader = pixelShader;
 	this->shaderResourceView = shaderResourceView;
 	this->samplerState = samplerState;
+	instancedVertexShader = nullptr;
+	transparent = false;
+	pipelineState = nullptr;
+	instancedPipelineState = nullptr;
+	parameters = {};
+
+	// Look up what gets set for every draw now, instead of each time
+	handles.Constants = vertexShader->GetConstantBufferHandle<VertexShaderConstants>("externalData");
+	handles.World = vertexShader->GetVariableHandle(WorldName);
+	handles.View = vertexShader->GetVariableHandle(ViewName);
+	handles.Projection = vertexShader->GetVariableHandle(ProjectionName);
+	handles.Sampler = pixelShader->GetSamplerHandle(SamplerName);
+	handles.Texture = pixelShader->GetShaderResourceViewHandle(TextureName);
+	handles.MaterialMaps = pixelShader->GetShaderResourceViewHandle(MaterialMapsName);
+
+	// Registering the material gives it its IDs
+	id = 0;
+	shaderID = 0;
+	batchID = 0;
+	textureSlice = 0;
 }
 
 Material::~Material()
@@ -25,6 +54,11 @@ SimplePixelShader * Material::GetPixelShader()
 	return pixelShader;
 }
 
+SimpleVertexShader * Material::GetInstancedVertexShader()
+{
+	return instancedVertexShader;
+}
+
 ID3D11ShaderResourceView * Material::GetShaderResourceView()
 {
 	return shaderResourceView;
@@ -34,3 +68,76 @@ ID3D11SamplerState * Material::GetSamplerState()
 {
 	return samplerState;
 }
+
+MaterialID Material::GetID()
+{
+	return id;
+}
+
+MaterialID Material::GetBatchID()
+{
+	return batchID;
+}
+
+unsigned int Material::GetTextureSlice()
+{
+	return textureSlice;
+}
+
+unsigned int Material::GetShaderID()
+{
+	return shaderID;
+}
+
+bool Material::IsTransparent()
+{
+	return transparent;
+}
+
+const MaterialHandles& Material::GetHandles()
+{
+	return handles;
+}
+
+const MaterialParameters& Material::GetParameters()
+{
+	return parameters;
+}
+
+const PipelineState* Material::GetPipelineState()
+{
+	return pipelineState;
+}
+
+const PipelineState* Material::GetInstancedPipelineState()
+{
+	return instancedPipelineState;
+}
+
+void Material::SetTransparent(bool transparent)
+{
+	this->transparent = transparent;
+}
+
+void Material::SetInstancedVertexShader(SimpleVertexShader* instancedVertexShader)
+{
+	this->instancedVertexShader = instancedVertexShader;
+
+	handles.InstancedConstants = {};
+	handles.InstancedView = {};
+	handles.InstancedProjection = {};
+	handles.InstancedTransforms = {};
+	if (instancedVertexShader)
+	{
+		handles.InstancedConstants = instancedVertexShader->GetConstantBufferHandle<InstancedVertexShaderConstants>("externalData");
+		handles.InstancedView = instancedVertexShader->GetVariableHandle(ViewName);
+		handles.InstancedProjection = instancedVertexShader->GetVariableHandle(ProjectionName);
+		handles.InstancedTransforms = instancedVertexShader->GetShaderResourceViewHandle(TransformsName);
+	}
+}
+
+void Material::SetPipelineStates(const PipelineState* pipelineState, const PipelineState* instancedPipelineState)
+{
+	this->pipelineState = pipelineState;
+	this->instancedPipelineState = instancedPipelineState;
+}
@@ -2,7 +2,38 @@
 
 #include <DirectXMath.h>
 #include "SimpleShader.h"
+#include "PipelineState.h"
+#include "ShaderConstants.h"
+#ifdef _WIN32
 #include "WICTextureLoader.h"
+#endif
+#include <vector>
+
+// Dense material ID from a MaterialRegistry, small enough for sort
+// keys.  0 means "no material".
+typedef unsigned short MaterialID;
+
+// --------------------------------------------------------
+// The shader variables and resources drawing with a material
+// sets, looked up once when the shaders are given to it
+// --------------------------------------------------------
+struct MaterialHandles
+{
+	// The vertex shader's whole constant buffer, and each variable in it
+	ConstantBufferHandle<VertexShaderConstants> Constants;
+	ShaderVariableHandle World;
+	ShaderVariableHandle View;
+	ShaderVariableHandle Projection;
+	ShaderSamplerHandle Sampler;
+	ShaderResourceHandle Texture;
+	ShaderResourceHandle MaterialMaps;	// Only in variants sampling packed maps
+
+	// In the instanced vertex shader, if there is one
+	ConstantBufferHandle<InstancedVertexShaderConstants> InstancedConstants;
+	ShaderVariableHandle InstancedView;
+	ShaderVariableHandle InstancedProjection;
+	ShaderResourceHandle InstancedTransforms;
+};
 
 class Material
 {
@@ -13,18 +44,66 @@ public:
 	// GET methods
 	SimpleVertexShader* GetVertexShader();
 	SimplePixelShader* GetPixelShader();
+	SimpleVertexShader* GetInstancedVertexShader();
 	ID3D11ShaderResourceView* GetShaderResourceView();
 	ID3D11SamplerState* GetSamplerState();
+	MaterialID GetID();
+	MaterialID GetBatchID();
+	unsigned int GetTextureSlice();
+	unsigned int GetShaderID();
+	bool IsTransparent();
+	const MaterialHandles& GetHandles();
+	const MaterialParameters& GetParameters();
+	const PipelineState* GetPipelineState();
+	const PipelineState* GetInstancedPipelineState();
+
+	// SET methods
+	void SetTransparent(bool transparent);
+	void SetInstancedVertexShader(SimpleVertexShader* instancedVertexShader);
+	void SetPipelineStates(const PipelineState* pipelineState, const PipelineState* instancedPipelineState);
 
 private:
+	// Gives registered materials their IDs and parameters
+	friend class MaterialRegistry;
+
 	// Wrappers for DirectX shaders to provide simplified shader functionality
 	SimpleVertexShader* vertexShader;
 	SimplePixelShader* pixelShader;
 
+	// Optional vertex shader reading world matrices per instance, so
+	// entities sharing this material can be drawn in one call
+	SimpleVertexShader* instancedVertexShader;
+
 	// The Shader Resource view for this material's texture
 	ID3D11ShaderResourceView* shaderResourceView;
 
 	// The Sampler State for this material's texture
 	ID3D11SamplerState* samplerState;
+
+	// ID from the registry that made this material (0 until then), and
+	// an ID shared by every material using the same shader pair
+	MaterialID id;
+	unsigned int shaderID;
+
+	// ID shared by every registered material differing from this one
+	// only by texture slice, so their draws can be instanced together
+	MaterialID batchID;
+
+	// Which slice of the texture (an array) this material samples
+	unsigned int textureSlice;
+
+	// Whether this material is drawn in the transparent pass
+	bool transparent;
+
+	// The values in the pixel shader's material buffer
+	MaterialParameters parameters;
+
+	// Everything drawing with this material binds besides its resources,
+	// with and without the instanced vertex shader.  Owned by the cache
+	// that made them.
+	const PipelineState* pipelineState;
+	const PipelineState* instancedPipelineState;
+
+	MaterialHandles handles;
 };
 
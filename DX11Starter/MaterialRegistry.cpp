@@ -0,0 +1,279 @@
+#include "MaterialRegistry.h"
+
+#include <cctype>
+#include <cstring>
+
+MaterialRegistry::MaterialRegistry(IRenderDevice* device, PipelineStateCache* pipelineStates)
+{
+	this->device = device;
+	this->pipelineStates = pipelineStates;
+	batchCount = 0;
+	registrations = 0;
+	duplicates = 0;
+
+	// ID 0 is "no material"
+	materials.push_back(nullptr);
+	descs.push_back(MaterialDesc());
+	bindBlocks.push_back(BindBlock());
+	batchIDs.push_back(0);
+}
+
+// --------------------------------------------------------
+// Every material and its batch's parameter buffer go with the
+// registry.  Each batch's buffer is released by its first material.
+// --------------------------------------------------------
+MaterialRegistry::~MaterialRegistry()
+{
+	for (std::vector<Material*>::size_type i = 1; i < materials.size(); i++)
+	{
+		delete materials[i];
+		if (batchIDs[i] == i)
+			device->Release(bindBlocks[i].Parameters);
+	}
+}
+
+MaterialID MaterialRegistry::Register(const MaterialDesc& desc)
+{
+	registrations++;
+
+	// Same hash is only a candidate - the descriptions have to match too
+	unsigned long long hash = Hash(desc);
+	std::pair<std::unordered_multimap<unsigned long long, MaterialID>::iterator, std::unordered_multimap<unsigned long long, MaterialID>::iterator> range = ids.equal_range(hash);
+	for (std::unordered_multimap<unsigned long long, MaterialID>::iterator it = range.first; it != range.second; ++it)
+	{
+		if (Equal(descs[it->second], desc))
+		{
+			duplicates++;
+			return it->second;
+		}
+	}
+
+	if (materials.size() > MaxMaterials || !desc.VertexShader || !desc.PixelShader)
+		return 0;
+
+	Material* material = new Material(desc.VertexShader, desc.PixelShader, desc.Texture, desc.Sampler);
+	material->SetInstancedVertexShader(desc.InstancedVertexShader);
+	material->SetTransparent(desc.Transparent);
+	material->parameters = desc.Parameters;
+	material->textureSlice = desc.TextureSlice;
+	CreatePipelineStates(material);
+	if (!material->GetPipelineState())
+	{
+		delete material;
+		return 0;
+	}
+
+	// Join the batch of the first material that only differs by slice,
+	// or start a new one.  Everything it binds is the same as this.
+	MaterialID id = (MaterialID)materials.size();
+	MaterialID batchID = id;
+	unsigned long long batchHash = BatchHash(desc);
+	range = batches.equal_range(batchHash);
+	for (std::unordered_multimap<unsigned long long, MaterialID>::iterator it = range.first; it != range.second; ++it)
+	{
+		if (SameBatch(descs[it->second], desc))
+		{
+			batchID = it->second;
+			break;
+		}
+	}
+
+	BindBlock block = {};
+	if (batchID != id)
+		block = bindBlocks[batchID];
+	else
+	{
+		// The registry binds the parameters itself, from a buffer packed
+		// once here, so the shader has to leave that slot alone
+		ConstantBufferHandle<MaterialParameters> parameterHandle = desc.PixelShader->GetConstantBufferHandle<MaterialParameters>("materialData");
+		if (parameterHandle.IsValid())
+		{
+			BufferDesc bufferDesc = {};
+			bufferDesc.ByteWidth = sizeof(MaterialParameters);
+			bufferDesc.Usage = BUFFER_USAGE_IMMUTABLE;
+			bufferDesc.BindFlags = BUFFER_BIND_CONSTANT;
+			block.Parameters = device->CreateBuffer(bufferDesc, &desc.Parameters);
+			if (!block.Parameters)
+			{
+				delete material;
+				return 0;
+			}
+
+			block.ParameterSlot = desc.PixelShader->GetBufferInfo(parameterHandle.Index)->BindIndex;
+			block.HasParameters = true;
+			desc.PixelShader->SetConstantBufferExternal("materialData", true);
+		}
+
+		const MaterialHandles& handles = material->GetHandles();
+		block.Texture = desc.Texture;
+		block.TextureSlot = handles.Texture.BindIndex;
+		block.HasTexture = handles.Texture.IsValid();
+		block.MaterialMaps = desc.MaterialMaps;
+		block.MaterialMapsSlot = handles.MaterialMaps.BindIndex;
+		block.HasMaterialMaps = handles.MaterialMaps.IsValid();
+		block.Sampler = desc.Sampler;
+		block.SamplerSlot = handles.Sampler.BindIndex;
+		block.HasSampler = handles.Sampler.IsValid();
+
+		batches.insert(std::make_pair(batchHash, id));
+		batchCount++;
+	}
+
+	// Materials sharing shaders share a shader ID so their draws can be grouped
+	std::pair<SimpleVertexShader*, SimplePixelShader*> shaderPair(desc.VertexShader, desc.PixelShader);
+	unsigned int shaderID = 0;
+	while (shaderID < shaderPairs.size() && shaderPairs[shaderID] != shaderPair)
+		shaderID++;
+	if (shaderID == shaderPairs.size())
+		shaderPairs.push_back(shaderPair);
+
+	material->id = id;
+	material->shaderID = shaderID;
+	material->batchID = batchID;
+	materials.push_back(material);
+	descs.push_back(desc);
+	bindBlocks.push_back(block);
+	batchIDs.push_back(batchID);
+	ids.insert(std::make_pair(hash, id));
+	return id;
+}
+
+Material* MaterialRegistry::GetMaterial(MaterialID id)
+{
+	return id < materials.size() ? materials[id] : nullptr;
+}
+
+bool MaterialRegistry::Bind(IRenderContext* context, MaterialID id, MaterialID& boundID) const
+{
+	// Draws are sorted by batch, so most of the time it's already there
+	if (id == boundID && id != 0)
+		return true;
+	if (id == 0 || id >= bindBlocks.size())
+		return false;
+	if (boundID != 0 && boundID < batchIDs.size() && batchIDs[boundID] == batchIDs[id])
+	{
+		boundID = id;
+		return true;
+	}
+
+	const BindBlock& block = bindBlocks[id];
+	if (block.HasTexture)
+		context->PSSetShaderResources(block.TextureSlot, 1, &block.Texture);
+	if (block.HasMaterialMaps)
+		context->PSSetShaderResources(block.MaterialMapsSlot, 1, &block.MaterialMaps);
+	if (block.HasSampler)
+		context->PSSetSamplers(block.SamplerSlot, 1, &block.Sampler);
+	if (block.HasParameters)
+		context->PSSetConstantBuffers(block.ParameterSlot, 1, &block.Parameters);
+
+	boundID = id;
+	return true;
+}
+
+// --------------------------------------------------------
+// Gives a material the pipeline states its draws bind.
+// Transparent materials blend over what's behind them without
+// writing depth.
+// --------------------------------------------------------
+void MaterialRegistry::CreatePipelineStates(Material* material)
+{
+	PipelineStateDesc desc = {};
+	desc.VertexShader = material->GetVertexShader()->GetDirectXShader();
+	desc.PixelShader = material->GetPixelShader()->GetDirectXShader();
+	desc.InputLayout = material->GetVertexShader()->GetInputLayout();
+	desc.Topology = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	if (material->IsTransparent())
+	{
+		desc.Blend.Mode = BLEND_ALPHA;
+		desc.DepthStencil.DepthWriteDisable = true;
+	}
+	const PipelineState* pipelineState = pipelineStates->GetPipelineState(desc);
+
+	const PipelineState* instancedPipelineState = nullptr;
+	if (material->GetInstancedVertexShader())
+	{
+		desc.VertexShader = material->GetInstancedVertexShader()->GetDirectXShader();
+		desc.InputLayout = material->GetInstancedVertexShader()->GetInputLayout();
+		instancedPipelineState = pipelineStates->GetPipelineState(desc);
+	}
+
+	material->SetPipelineStates(pipelineState, instancedPipelineState);
+}
+
+// --------------------------------------------------------
+// Hashing.  Every field goes in as 8 bytes, like the pipeline
+// state cache, and floats go in as their bits - so parameters
+// are compared by their bits too.
+// --------------------------------------------------------
+static void HashValue(unsigned long long& hash, unsigned long long value)
+{
+	for (int i = 0; i < 8; i++)
+		hash = (hash ^ ((value >> (i * 8)) & 0xFF)) * 1099511628211ull;
+}
+
+static void HashFloat(unsigned long long& hash, float value)
+{
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(bits));
+	HashValue(hash, bits);
+}
+
+unsigned long long MaterialRegistry::Hash(const MaterialDesc& desc)
+{
+	unsigned long long hash = BatchHash(desc);
+	HashValue(hash, desc.TextureSlice);
+	return hash;
+}
+
+unsigned long long MaterialRegistry::BatchHash(const MaterialDesc& desc)
+{
+	unsigned long long hash = 14695981039346656037ull;
+	HashValue(hash, (unsigned long long)(size_t)desc.VertexShader);
+	HashValue(hash, (unsigned long long)(size_t)desc.PixelShader);
+	HashValue(hash, (unsigned long long)(size_t)desc.InstancedVertexShader);
+	HashValue(hash, (unsigned long long)(size_t)desc.Texture);
+	HashValue(hash, (unsigned long long)(size_t)desc.MaterialMaps);
+	HashValue(hash, (unsigned long long)(size_t)desc.Sampler);
+	HashFloat(hash, desc.Parameters.Tint.x);
+	HashFloat(hash, desc.Parameters.Tint.y);
+	HashFloat(hash, desc.Parameters.Tint.z);
+	HashFloat(hash, desc.Parameters.Tint.w);
+	HashFloat(hash, desc.Parameters.UVScale.x);
+	HashFloat(hash, desc.Parameters.UVScale.y);
+	HashFloat(hash, desc.Parameters.UVOffset.x);
+	HashFloat(hash, desc.Parameters.UVOffset.y);
+	HashValue(hash, desc.Transparent);
+	return hash;
+}
+
+bool MaterialRegistry::Equal(const MaterialDesc& a, const MaterialDesc& b)
+{
+	return SameBatch(a, b) && a.TextureSlice == b.TextureSlice;
+}
+
+bool MaterialRegistry::SameBatch(const MaterialDesc& a, const MaterialDesc& b)
+{
+	return
+		a.VertexShader == b.VertexShader &&
+		a.PixelShader == b.PixelShader &&
+		a.InstancedVertexShader == b.InstancedVertexShader &&
+		a.Texture == b.Texture &&
+		a.MaterialMaps == b.MaterialMaps &&
+		a.Sampler == b.Sampler &&
+		memcmp(&a.Parameters, &b.Parameters, sizeof(MaterialParameters)) == 0 &&
+		a.Transparent == b.Transparent;
+}
+
+unsigned int MaterialRegistry::SelectPackedMapVariant(const PackedTextureInfo& info, const ShaderPermutationSet& permutations, ShaderVariantKey& key)
+{
+	unsigned int used = 0;
+	for (size_t i = 0; i < info.Channels.size(); i++)
+	{
+		std::string feature = info.Channels[i].Semantic + "_CHANNEL";
+		for (size_t c = 0; c < feature.size(); c++)
+			feature[c] = (char)toupper((unsigned char)feature[c]);
+		if (permutations.SetFeature(key, feature, info.Channels[i].Channel + 1))
+			used++;
+	}
+	return used;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include "Material.h"
+#include "PipelineState.h"
+#include "ShaderPermutations.h"
+#include "TextureCooker.h"
+
+// --------------------------------------------------------
+// Everything that makes two materials the same.  Shaders,
+// textures and the sampler are compared by pointer, the
+// parameters by value.
+// --------------------------------------------------------
+struct MaterialDesc
+{
+	SimpleVertexShader* VertexShader;
+	SimplePixelShader* PixelShader;
+	SimpleVertexShader* InstancedVertexShader;	// Optional
+	ID3D11ShaderResourceView* Texture;			// A texture array
+	unsigned int TextureSlice;					// Which slice of it to sample
+	ID3D11ShaderResourceView* MaterialMaps;		// Optional maps packed by the texture cooker
+	ID3D11SamplerState* Sampler;
+	MaterialParameters Parameters;
+	bool Transparent;
+};
+
+// --------------------------------------------------------
+// Makes every material, once.  Registering a description
+// that's already been registered hands back the same ID, found
+// by a hash of its contents and then compared field by field.
+//
+// IDs are dense, starting at 1, so they fit the render queue's
+// sort keys and index straight into the registry.  Each
+// material's parameters are packed into its own immutable
+// constant buffer when it's registered, so binding one is an
+// array lookup and a few binds - and nothing at all when it's
+// the material that's already bound.
+//
+// Materials sharing a vertex and pixel shader share a shader ID,
+// also dense and starting at 0, so their draws sort together.
+//
+// Materials that only differ by texture slice bind exactly the
+// same things, so they share a batch ID.  Draws sort and
+// instance by it, and each says which slice it wants itself.
+//
+// Materials live until the registry is destroyed.  Shaders,
+// textures and samplers are only referred to, and have to
+// outlive it.
+// --------------------------------------------------------
+class MaterialRegistry
+{
+public:
+	MaterialRegistry(IRenderDevice* device, PipelineStateCache* pipelineStates); // Constructor
+	~MaterialRegistry(); // Destructor
+
+	// IDs 1 to 65535 can be handed out
+	static const unsigned int MaxMaterials = 65535;
+
+	// The ID of the material with this description, made if it's new.
+	// 0 if it couldn't be made or every ID is taken.
+	MaterialID Register(const MaterialDesc& desc);
+
+	// Null for 0 and IDs this registry didn't hand out
+	Material* GetMaterial(MaterialID id);
+
+	// Binds a material's texture, sampler and parameters to the pixel
+	// shader stage, unless boundID - the material this context last
+	// bound, which is updated - is in the same batch.  Pass 0 when
+	// nothing's known.  Only
+	// reads the registry, so several threads can bind into their own
+	// contexts at once.  False for IDs this registry didn't hand out.
+	bool Bind(IRenderContext* context, MaterialID id, MaterialID& boundID) const;
+
+	// FNV-1a 64 of every field, and of every field but the texture slice
+	static unsigned long long Hash(const MaterialDesc& desc);
+	static unsigned long long BatchHash(const MaterialDesc& desc);
+
+	// Field by field comparison.  Parameters are compared bit for bit,
+	// since they're all floats with no padding between them.
+	static bool Equal(const MaterialDesc& a, const MaterialDesc& b);
+
+	// Whether two materials only differ, if at all, by texture slice
+	static bool SameBatch(const MaterialDesc& a, const MaterialDesc& b);
+
+	// Picks the pixel shader variant sampling each map a packed texture
+	// holds from the right channel.  Each semantic with a matching
+	// feature (like "ao" and AO_CHANNEL) is set to its channel plus 1.
+	// Returns how many of the maps the shader can use.
+	static unsigned int SelectPackedMapVariant(const PackedTextureInfo& info, const ShaderPermutationSet& permutations, ShaderVariantKey& key);
+
+	// Stats
+	size_t GetMaterialCount() { return materials.size() - 1; }
+	unsigned int GetBatchCount() { return batchCount; }
+	unsigned int GetRegistrations() { return registrations; }
+	unsigned int GetDuplicates() { return duplicates; }
+	void ResetStats() { registrations = 0; duplicates = 0; }
+
+private:
+	// What binding a material sets, kept together and indexed by ID
+	struct BindBlock
+	{
+		ID3D11ShaderResourceView* Texture;
+		ID3D11ShaderResourceView* MaterialMaps;
+		ID3D11SamplerState* Sampler;
+		ID3D11Buffer* Parameters;
+		unsigned int TextureSlot;
+		unsigned int MaterialMapsSlot;
+		unsigned int SamplerSlot;
+		unsigned int ParameterSlot;
+		bool HasTexture;
+		bool HasMaterialMaps;
+		bool HasSampler;
+		bool HasParameters;
+	};
+
+	// Pipeline states with and without the instanced vertex shader
+	void CreatePipelineStates(Material* material);
+
+	IRenderDevice* device;
+	PipelineStateCache* pipelineStates;
+
+	// Indexed by ID, with an empty entry 0
+	std::vector<Material*> materials;
+	std::vector<MaterialDesc> descs;
+	std::vector<BindBlock> bindBlocks;
+	std::vector<MaterialID> batchIDs;
+	std::unordered_multimap<unsigned long long, MaterialID> ids;
+	std::unordered_multimap<unsigned long long, MaterialID> batches;
+
+	// Every vertex/pixel shader pair registered - the index is the shader ID
+	std::vector<std::pair<SimpleVertexShader*, SimplePixelShader*>> shaderPairs;
+
+	unsigned int batchCount;
+	unsigned int registrations;
+	unsigned int duplicates;
+};
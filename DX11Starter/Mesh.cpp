@@ -1,14 +1,18 @@
 #include "Mesh.h"
+#include "Platform.h"
 
 using namespace DirectX;
 
-Mesh::Mesh(ID3D11Device* device, Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount)
+// Mesh IDs start at 1 so 0 can mean "no mesh"
+unsigned int Mesh::nextID = 1;
+
+Mesh::Mesh(IRenderDevice* device, Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount, UploadManager* uploadManager)
 {
 	// Using the mesh description passed in setup the actual mesh
-	Setup(device, vertices, vertexCount, indices, indexCount);
+	Setup(device, vertices, vertexCount, indices, indexCount, uploadManager);
 }
 
-Mesh::Mesh(ID3D11Device* device, char* objFile)
+Mesh::Mesh(IRenderDevice* device, char* objFile, UploadManager* uploadManager)
 {
 	// File input object
 	std::ifstream obj(objFile);
@@ -22,7 +26,7 @@ Mesh::Mesh(ID3D11Device* device, char* objFile)
 	std::vector<XMFLOAT3> normals;       // Normals from the file
 	std::vector<XMFLOAT2> uvs;           // UVs from the file
 	std::vector<Vertex> verts;           // Verts we're assembling
-	std::vector<UINT> indices;           // Indices of these verts
+	std::vector<unsigned int> indices;   // Indices of these verts
 	unsigned int vertCounter = 0;        // Count of vertices/indices
 	char chars[100];                     // String for line reading
 
@@ -178,16 +182,22 @@ Mesh::Mesh(ID3D11Device* device, char* objFile)
 	//    one, you'll need to write some extra code to handle cases when you don't.
 
 	// Using the mesh description gathered setup the actual mesh
-	Setup(device, &verts[0], vertCounter, &indices[0], vertCounter);
+	Setup(device, &verts[0], vertCounter, &indices[0], vertCounter, uploadManager);
 }
 
 Mesh::Mesh(Mesh const& other)
 {
+	device = other.device;
 	vertexBuffer = other.vertexBuffer;
-	vertexBuffer->AddRef(); // Tell DirectX there is a new reference to this object
+	device->AddRef(vertexBuffer); // Tell the device there is a new reference to this object
 	indexBuffer = other.indexBuffer;
-	indexBuffer->AddRef(); // Tell DirectX there is a new reference to this object
+	device->AddRef(indexBuffer); // Tell the device there is a new reference to this object
 	indexCount = other.indexCount;
+	vertices = other.vertices;
+	indices = other.indices;
+	id = other.id;
+	boundsCenter = other.boundsCenter;
+	boundsRadius = other.boundsRadius;
 }
 
 Mesh & Mesh::operator=(Mesh const& other)
@@ -195,11 +205,17 @@ Mesh & Mesh::operator=(Mesh const& other)
 	if (this != &other)
 	{
 		// Switch values
+		device = other.device;
 		vertexBuffer = other.vertexBuffer;
-		vertexBuffer->AddRef(); // Tell DirectX there is a new reference to this object
+		device->AddRef(vertexBuffer); // Tell the device there is a new reference to this object
 		indexBuffer = other.indexBuffer;
-		indexBuffer->AddRef(); // Tell DirectX there is a new reference to this object
+		device->AddRef(indexBuffer); // Tell the device there is a new reference to this object
 		indexCount = other.indexCount;
+		vertices = other.vertices;
+		indices = other.indices;
+		id = other.id;
+		boundsCenter = other.boundsCenter;
+		boundsRadius = other.boundsRadius;
 	}
 	return *this;
 }
@@ -207,8 +223,11 @@ Mesh & Mesh::operator=(Mesh const& other)
 Mesh::~Mesh()
 {
 	// Release the vertex and index buffers
-	if (vertexBuffer) { vertexBuffer->Release(); }
-	if (indexBuffer) { indexBuffer->Release(); }
+	if (device)
+	{
+		device->Release(vertexBuffer);
+		device->Release(indexBuffer);
+	}
 }
 
 ID3D11Buffer* Mesh::GetVertexBuffer()
@@ -226,49 +245,106 @@ int Mesh::GetIndexCount()
 	return indexCount;
 }
 
-void Mesh::Setup(ID3D11Device * device, Vertex * vertices, int vertexCount, unsigned int * indices, int indexCount)
+unsigned int Mesh::GetID()
+{
+	return id;
+}
+
+XMFLOAT3 Mesh::GetBoundsCenter()
+{
+	return boundsCenter;
+}
+
+float Mesh::GetBoundsRadius()
+{
+	return boundsRadius;
+}
+
+const std::vector<Vertex>& Mesh::GetVertices()
+{
+	return vertices;
+}
+
+const std::vector<unsigned int>& Mesh::GetIndices()
+{
+	return indices;
+}
+
+void Mesh::Setup(IRenderDevice* device, Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount, UploadManager* uploadManager)
 {
+	// Keep the device around, it has to release the buffers later
+	this->device = device;
+
+	// Buffers the upload manager fills in have to be written after creation,
+	// so they can't be immutable
+	BufferUsage usage = uploadManager ? BUFFER_USAGE_DEFAULT : BUFFER_USAGE_IMMUTABLE;
+
 	// Create the VERTEX BUFFER description -----------------------------------
 	// - The description is created on the stack because we only need
 	//    it to create the buffer.  The description is then useless.
-	D3D11_BUFFER_DESC vbd;
-	vbd.Usage = D3D11_USAGE_IMMUTABLE;
+	BufferDesc vbd = {};
+	vbd.Usage = usage;
 	vbd.ByteWidth = sizeof(Vertex) * vertexCount;
-	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER; // Tells DirectX this is a vertex buffer
-	vbd.CPUAccessFlags = 0;
-	vbd.MiscFlags = 0;
-	vbd.StructureByteStride = 0;
+	vbd.BindFlags = BUFFER_BIND_VERTEX; // Tells the device this is a vertex buffer
 
-	// Create the proper struct to hold the initial vertex data
-	// - This is how we put the initial data into the buffer
-	D3D11_SUBRESOURCE_DATA initialVertexData;
-	initialVertexData.pSysMem = vertices;
-
-	// Actually create the buffer with the initial data
-	// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
-	device->CreateBuffer(&vbd, &initialVertexData, &vertexBuffer);
+	// Actually create the buffer with the initial data (unless it's uploaded later)
+	// - Once the data is in, we'll NEVER CHANGE THE BUFFER AGAIN
+	vertexBuffer = device->CreateBuffer(vbd, uploadManager ? 0 : vertices);
 
 
 	// Create the INDEX BUFFER description ------------------------------------
 	// - The description is created on the stack because we only need
 	//    it to create the buffer.  The description is then useless.
-	D3D11_BUFFER_DESC ibd;
-	ibd.Usage = D3D11_USAGE_IMMUTABLE;
+	BufferDesc ibd = {};
+	ibd.Usage = usage;
 	ibd.ByteWidth = sizeof(unsigned int) * indexCount;
-	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER; // Tells DirectX this is an index buffer
-	ibd.CPUAccessFlags = 0;
-	ibd.MiscFlags = 0;
-	ibd.StructureByteStride = 0;
+	ibd.BindFlags = BUFFER_BIND_INDEX; // Tells the device this is an index buffer
 
-	// Create the proper struct to hold the initial index data
-	// - This is how we put the initial data into the buffer
-	D3D11_SUBRESOURCE_DATA initialIndexData;
-	initialIndexData.pSysMem = indices;
+	// Actually create the buffer with the initial data (unless it's uploaded later)
+	// - Once the data is in, we'll NEVER CHANGE THE BUFFER AGAIN
+	indexBuffer = device->CreateBuffer(ibd, uploadManager ? 0 : indices);
 
-	// Actually create the buffer with the initial data
-	// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
-	device->CreateBuffer(&ibd, &initialIndexData, &indexBuffer);
+	// Queue the geometry instead.  Until it's arrived the buffers are all
+	// zeroes, which only makes degenerate triangles.
+	if (uploadManager)
+	{
+		uploadManager->UploadBuffer(vertexBuffer, 0, vertices, vbd.ByteWidth, UPLOAD_PRIORITY_NORMAL);
+		uploadManager->UploadBuffer(indexBuffer, 0, indices, ibd.ByteWidth, UPLOAD_PRIORITY_NORMAL);
+	}
 
 	// Copy the passed in number of indices to the member count variable 
 	this->indexCount = indexCount;
+
+	// Keep the geometry on the CPU too, so it can be merged into static batches
+	this->vertices.assign(vertices, vertices + vertexCount);
+	this->indices.assign(indices, indices + indexCount);
+
+	// Give the mesh its ID
+	id = nextID++;
+
+	// Calculate a local space bounding sphere for culling
+	// - The center is the middle of the axis aligned box around the vertices
+	// - The radius is the distance to the farthest vertex from that center
+	if (vertexCount > 0)
+	{
+		XMVECTOR minCorner = XMLoadFloat3(&vertices[0].Position);
+		XMVECTOR maxCorner = minCorner;
+		for (int i = 1; i < vertexCount; i++)
+		{
+			XMVECTOR position = XMLoadFloat3(&vertices[i].Position);
+			minCorner = XMVectorMin(minCorner, position);
+			maxCorner = XMVectorMax(maxCorner, position);
+		}
+
+		XMVECTOR center = (minCorner + maxCorner) * 0.5f;
+		XMVECTOR maxDistanceSq = XMVectorZero();
+		for (int i = 0; i < vertexCount; i++)
+		{
+			XMVECTOR offset = XMLoadFloat3(&vertices[i].Position) - center;
+			maxDistanceSq = XMVectorMax(maxDistanceSq, XMVector3LengthSq(offset));
+		}
+
+		XMStoreFloat3(&boundsCenter, center);
+		boundsRadius = sqrtf(XMVectorGetX(maxDistanceSq));
+	}
 }
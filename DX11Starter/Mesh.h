@@ -1,10 +1,11 @@
 #pragma once
 
 #include <DirectXMath.h>
-#include <d3d11.h>
 #include <vector>
 #include <fstream>
 #include "Vertex.h"
+#include "RenderDevice.h"
+#include "UploadManager.h"
 
 // --------------------------------------------------------
 // A Mesh class that can take vertex and index data for a 
@@ -14,8 +15,10 @@
 class Mesh
 {
 public:
-	Mesh(ID3D11Device* device, Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount); // Constructor Overload
-	Mesh(ID3D11Device* device, char* objFile); // Constructor Overload
+	// With an upload manager the buffers are filled in over the next few
+	// frames, otherwise they're created with their data straight away
+	Mesh(IRenderDevice* device, Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount, UploadManager* uploadManager = nullptr); // Constructor Overload
+	Mesh(IRenderDevice* device, char* objFile, UploadManager* uploadManager = nullptr); // Constructor Overload
 	Mesh(Mesh const& other); // Copy Constructor
 	Mesh& operator=(Mesh const& other); // Copy Assignment Operator
 	~Mesh(); // Destructor
@@ -24,16 +27,38 @@ public:
 	ID3D11Buffer* GetVertexBuffer();
 	ID3D11Buffer* GetIndexBuffer();
 	int GetIndexCount();
+	unsigned int GetID();
+	DirectX::XMFLOAT3 GetBoundsCenter();
+	float GetBoundsRadius();
+
+	// CPU copies of the geometry, used to build static batches
+	const std::vector<Vertex>& GetVertices();
+	const std::vector<unsigned int>& GetIndices();
 
 private:
 	// Helper methods
-	void Setup(ID3D11Device* device, Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount);
+	void Setup(IRenderDevice* device, Vertex* vertices, int vertexCount, unsigned int* indices, int indexCount, UploadManager* uploadManager);
+
+	// The device that made the buffers, which has to release them too
+	IRenderDevice* device = nullptr;
 
 	// Buffers to hold actual geometry data
 	ID3D11Buffer* vertexBuffer = nullptr;
 	ID3D11Buffer* indexBuffer = nullptr;
 
+	// Unique ID used to group draws of the same mesh together
+	unsigned int id = 0;
+	static unsigned int nextID;
+
 	// Integer specifying how many indices are in the mesh's index buffer
 	int indexCount = 0;
+
+	// The same vertices and indices the buffers were made from
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+
+	// Local space bounding sphere enclosing every vertex of the mesh
+	DirectX::XMFLOAT3 boundsCenter = DirectX::XMFLOAT3(0, 0, 0);
+	float boundsRadius = 0;
 };
 
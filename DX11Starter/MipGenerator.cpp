@@ -0,0 +1,560 @@
+#include "MipGenerator.h"
+
+#include <cmath>
+#include <thread>
+
+// SSE2 is always there on x86 and x64, AVX2 is checked for when
+// it's used.  Other CPUs only get the scalar code.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MIP_GENERATOR_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define MIP_TARGET_AVX2
+#else
+#define MIP_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// Below this many floats a pass isn't worth splitting across threads
+static const size_t MinFloatsPerThread = 64 * 1024;
+
+// Kaiser and Lanczos reach 3 texels each way, and the Kaiser window's alpha
+static const double FilterRadius = 3.0;
+static const double KaiserAlpha = 4.0;
+static const double Pi = 3.14159265358979323846;
+
+// --------------------------------------------------------
+// A mip being filtered: 4 floats per texel whatever the
+// image's channel count, so every texel is one SSE register
+// --------------------------------------------------------
+struct FloatImage
+{
+	unsigned int Width;
+	unsigned int Height;
+	std::vector<float> Texels;
+};
+
+// --------------------------------------------------------
+// Which source texels (Indices) make up each destination
+// texel along one axis, and by how much (Weights).  Every
+// destination texel has TapCount of them, with zero weights
+// padding out the ones that need fewer.
+// --------------------------------------------------------
+struct FilterTaps
+{
+	unsigned int TapCount;
+	std::vector<unsigned int> Indices;
+	std::vector<float> Weights;
+};
+
+static double Sinc(double x)
+{
+	if (fabs(x) < 1e-6)
+		return 1.0;
+	x *= Pi;
+	return sin(x) / x;
+}
+
+// Modified Bessel function of the first kind, order 0
+static double BesselI0(double x)
+{
+	double sum = 1.0;
+	double term = 1.0;
+	for (int k = 1; k < 50 && term > sum * 1e-12; k++)
+	{
+		double half = x / (2.0 * k);
+		term *= half * half;
+		sum += term;
+	}
+	return sum;
+}
+
+static double FilterWeight(MipFilter filter, double x)
+{
+	if (fabs(x) >= FilterRadius)
+		return 0.0;
+	if (filter == MIP_FILTER_LANCZOS)
+		return Sinc(x) * Sinc(x / FilterRadius);
+
+	double t = x / FilterRadius;
+	return Sinc(x) * BesselI0(KaiserAlpha * sqrt(1.0 - t * t)) / BesselI0(KaiserAlpha);
+}
+
+// --------------------------------------------------------
+// Box weights are how much of each source texel the
+// destination texel covers.  The others are the filter,
+// stretched by how many source texels each destination one
+// covers, and read at each source texel's center.  Taps off
+// either end are folded onto the edge texel.
+// --------------------------------------------------------
+static void MakeTaps(MipFilter filter, unsigned int sourceSize, unsigned int size, FilterTaps& taps)
+{
+	double scale = (double)sourceSize / size;
+	double support = filter == MIP_FILTER_BOX ? scale * 0.5 : scale * FilterRadius;
+	std::vector<std::vector<unsigned int> > indices(size);
+	std::vector<std::vector<double> > weights(size);
+
+	taps.TapCount = 1;
+	for (unsigned int i = 0; i < size; i++)
+	{
+		double center = (i + 0.5) * scale;
+		int first = (int)floor(center - support);
+		int last = (int)ceil(center + support);
+		double total = 0.0;
+		for (int j = first; j <= last; j++)
+		{
+			double weight;
+			if (filter == MIP_FILTER_BOX)
+			{
+				double left = center - support > j ? center - support : j;
+				double right = center + support < j + 1 ? center + support : j + 1;
+				weight = right > left ? right - left : 0.0;
+			}
+			else
+			{
+				weight = FilterWeight(filter, (j + 0.5 - center) / scale);
+			}
+			if (weight == 0.0)
+				continue;
+
+			unsigned int index = j < 0 ? 0 : j >= (int)sourceSize ? sourceSize - 1 : (unsigned int)j;
+			if (!indices[i].empty() && indices[i].back() == index)
+				weights[i].back() += weight;
+			else
+			{
+				indices[i].push_back(index);
+				weights[i].push_back(weight);
+			}
+			total += weight;
+		}
+
+		for (size_t t = 0; t < weights[i].size(); t++)
+			weights[i][t] /= total;
+		if (indices[i].size() > taps.TapCount)
+			taps.TapCount = (unsigned int)indices[i].size();
+	}
+
+	taps.Indices.assign((size_t)size * taps.TapCount, 0);
+	taps.Weights.assign((size_t)size * taps.TapCount, 0.0f);
+	for (unsigned int i = 0; i < size; i++)
+	{
+		for (unsigned int t = 0; t < taps.TapCount; t++)
+		{
+			size_t tap = (size_t)i * taps.TapCount + t;
+			taps.Indices[tap] = t < indices[i].size() ? indices[i][t] : indices[i][0];
+			taps.Weights[tap] = t < weights[i].size() ? (float)weights[i][t] : 0.0f;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Filters along a row: each destination texel is a weighted
+// sum of whole source texels.  Every instruction set adds
+// the taps up in the same order, without fused multiply-adds,
+// so they all round the same way.
+// --------------------------------------------------------
+static void FilterRowScalar(const float* source, float* destination, unsigned int width, const FilterTaps& taps)
+{
+	for (unsigned int x = 0; x < width; x++)
+	{
+		const unsigned int* indices = &taps.Indices[(size_t)x * taps.TapCount];
+		const float* weights = &taps.Weights[(size_t)x * taps.TapCount];
+		float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		for (unsigned int t = 0; t < taps.TapCount; t++)
+		{
+			const float* texel = source + (size_t)indices[t] * 4;
+			for (int c = 0; c < 4; c++)
+				sum[c] += weights[t] * texel[c];
+		}
+		for (int c = 0; c < 4; c++)
+			destination[(size_t)x * 4 + c] = sum[c];
+	}
+}
+
+// Sums the same rows of every column: destination = sum of weights[t] * rows[t]
+static void FilterColumnsScalar(const float* const* rows, const float* weights, unsigned int tapCount, float* destination, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		float sum = 0.0f;
+		for (unsigned int t = 0; t < tapCount; t++)
+			sum += weights[t] * rows[t][i];
+		destination[i] = sum;
+	}
+}
+
+#ifdef MIP_GENERATOR_X86
+static void FilterRowSSE2(const float* source, float* destination, unsigned int width, const FilterTaps& taps)
+{
+	for (unsigned int x = 0; x < width; x++)
+	{
+		const unsigned int* indices = &taps.Indices[(size_t)x * taps.TapCount];
+		const float* weights = &taps.Weights[(size_t)x * taps.TapCount];
+		__m128 sum = _mm_setzero_ps();
+		for (unsigned int t = 0; t < taps.TapCount; t++)
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(source + (size_t)indices[t] * 4)));
+		_mm_storeu_ps(destination + (size_t)x * 4, sum);
+	}
+}
+
+// Rows are whole texels, so count is always a multiple of 4
+static void FilterColumnsSSE2(const float* const* rows, const float* weights, unsigned int tapCount, float* destination, size_t count)
+{
+	for (size_t i = 0; i < count; i += 4)
+	{
+		__m128 sum = _mm_setzero_ps();
+		for (unsigned int t = 0; t < tapCount; t++)
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(rows[t] + i)));
+		_mm_storeu_ps(destination + i, sum);
+	}
+}
+
+// Two destination texels at a time, one in each half of the register
+MIP_TARGET_AVX2 static void FilterRowAVX2(const float* source, float* destination, unsigned int width, const FilterTaps& taps)
+{
+	unsigned int x = 0;
+	for (; x + 2 <= width; x += 2)
+	{
+		const unsigned int* indices = &taps.Indices[(size_t)x * taps.TapCount];
+		const float* weights = &taps.Weights[(size_t)x * taps.TapCount];
+		const unsigned int* nextIndices = indices + taps.TapCount;
+		const float* nextWeights = weights + taps.TapCount;
+		__m256 sum = _mm256_setzero_ps();
+		for (unsigned int t = 0; t < taps.TapCount; t++)
+		{
+			__m256 weight = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(weights[t])), _mm_set1_ps(nextWeights[t]), 1);
+			__m256 texels = _mm256_insertf128_ps(
+				_mm256_castps128_ps256(_mm_loadu_ps(source + (size_t)indices[t] * 4)),
+				_mm_loadu_ps(source + (size_t)nextIndices[t] * 4), 1);
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(weight, texels));
+		}
+		_mm256_storeu_ps(destination + (size_t)x * 4, sum);
+	}
+
+	for (; x < width; x++)
+	{
+		const unsigned int* indices = &taps.Indices[(size_t)x * taps.TapCount];
+		const float* weights = &taps.Weights[(size_t)x * taps.TapCount];
+		__m128 sum = _mm_setzero_ps();
+		for (unsigned int t = 0; t < taps.TapCount; t++)
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(source + (size_t)indices[t] * 4)));
+		_mm_storeu_ps(destination + (size_t)x * 4, sum);
+	}
+}
+
+MIP_TARGET_AVX2 static void FilterColumnsAVX2(const float* const* rows, const float* weights, unsigned int tapCount, float* destination, size_t count)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 sum = _mm256_setzero_ps();
+		for (unsigned int t = 0; t < tapCount; t++)
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weights[t]), _mm256_loadu_ps(rows[t] + i)));
+		_mm256_storeu_ps(destination + i, sum);
+	}
+
+	// An odd texel at the end of the row
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 sum = _mm_setzero_ps();
+		for (unsigned int t = 0; t < tapCount; t++)
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(rows[t] + i)));
+		_mm_storeu_ps(destination + i, sum);
+	}
+}
+#endif
+
+// --------------------------------------------------------
+// Runs rowFunction over [first, last) ranges of rows on as
+// many threads as the work is worth, with the calling thread
+// taking the first range
+// --------------------------------------------------------
+template<typename RowFunction>
+static void ForEachRowRange(unsigned int rowCount, size_t floatsPerRow, unsigned int threadCount, RowFunction rowFunction)
+{
+	size_t worthIt = (size_t)rowCount * floatsPerRow / MinFloatsPerThread;
+	unsigned int threads = worthIt < threadCount ? (unsigned int)worthIt : threadCount;
+	if (threads > rowCount)
+		threads = rowCount;
+	if (threads <= 1)
+	{
+		rowFunction(0, rowCount);
+		return;
+	}
+
+	std::vector<std::thread> workers;
+	for (unsigned int t = 1; t < threads; t++)
+		workers.push_back(std::thread(rowFunction, rowCount * t / threads, rowCount * (t + 1) / threads));
+	rowFunction(0, rowCount / threads);
+	for (size_t t = 0; t < workers.size(); t++)
+		workers[t].join();
+}
+
+// --------------------------------------------------------
+// Filters across each source row into a temporary image
+// that's already the new width, then down its columns
+// --------------------------------------------------------
+static void Downsample(const FloatImage& source, FloatImage& mip, MipFilter filter, MipInstructionSet instructions, unsigned int threadCount)
+{
+	mip.Width = source.Width > 1 ? source.Width / 2 : 1;
+	mip.Height = source.Height > 1 ? source.Height / 2 : 1;
+	mip.Texels.resize((size_t)mip.Width * mip.Height * 4);
+
+	FilterTaps across;
+	FilterTaps down;
+	MakeTaps(filter, source.Width, mip.Width, across);
+	MakeTaps(filter, source.Height, mip.Height, down);
+
+	typedef void (*RowFunction)(const float*, float*, unsigned int, const FilterTaps&);
+	typedef void (*ColumnsFunction)(const float* const*, const float*, unsigned int, float*, size_t);
+	RowFunction filterRow = FilterRowScalar;
+	ColumnsFunction filterColumns = FilterColumnsScalar;
+#ifdef MIP_GENERATOR_X86
+	if (instructions == MIP_INSTRUCTIONS_SSE2)
+	{
+		filterRow = FilterRowSSE2;
+		filterColumns = FilterColumnsSSE2;
+	}
+	else if (instructions == MIP_INSTRUCTIONS_AVX2)
+	{
+		filterRow = FilterRowAVX2;
+		filterColumns = FilterColumnsAVX2;
+	}
+#endif
+
+	std::vector<float> wide((size_t)mip.Width * source.Height * 4);
+	ForEachRowRange(source.Height, (size_t)mip.Width * 4, threadCount, [&](unsigned int first, unsigned int last)
+	{
+		for (unsigned int y = first; y < last; y++)
+			filterRow(&source.Texels[(size_t)y * source.Width * 4], &wide[(size_t)y * mip.Width * 4], mip.Width, across);
+	});
+
+	ForEachRowRange(mip.Height, (size_t)mip.Width * 4 * down.TapCount, threadCount, [&](unsigned int first, unsigned int last)
+	{
+		std::vector<const float*> rows(down.TapCount);
+		for (unsigned int y = first; y < last; y++)
+		{
+			for (unsigned int t = 0; t < down.TapCount; t++)
+				rows[t] = &wide[(size_t)down.Indices[(size_t)y * down.TapCount + t] * mip.Width * 4];
+			filterColumns(&rows[0], &down.Weights[(size_t)y * down.TapCount], down.TapCount, &mip.Texels[(size_t)y * mip.Width * 4], (size_t)mip.Width * 4);
+		}
+	});
+}
+
+static double ToLinear(double value)
+{
+	return value <= 0.04045 ? value / 12.92 : pow((value + 0.055) / 1.055, 2.4);
+}
+
+// Whether a channel is stored sRGB encoded.  Alpha never is.
+static bool IsSRGBChannel(const MipChainDesc& desc, unsigned int channel)
+{
+	return desc.SRGB && channel < 3;
+}
+
+static void Decode(const TextureImage& image, const MipChainDesc& desc, unsigned int threadCount, FloatImage& decoded)
+{
+	unsigned int maxValue = image.MaxValue();
+	std::vector<float> linear(maxValue + 1);
+	std::vector<float> srgb(desc.SRGB ? maxValue + 1 : 0);
+	for (unsigned int v = 0; v <= maxValue; v++)
+	{
+		linear[v] = (float)((double)v / maxValue);
+		if (desc.SRGB)
+			srgb[v] = (float)ToLinear((double)v / maxValue);
+	}
+
+	decoded.Width = image.Width;
+	decoded.Height = image.Height;
+	decoded.Texels.assign((size_t)image.Width * image.Height * 4, 0.0f);
+	ForEachRowRange(image.Height, (size_t)image.Width * 4, threadCount, [&](unsigned int first, unsigned int last)
+	{
+		for (size_t i = (size_t)first * image.Width; i < (size_t)last * image.Width; i++)
+		{
+			for (unsigned int c = 0; c < image.Channels; c++)
+			{
+				unsigned short value = image.Values[i * image.Channels + c];
+				decoded.Texels[i * 4 + c] = IsSRGBChannel(desc, c) ? srgb[value] : linear[value];
+			}
+		}
+	});
+}
+
+// --------------------------------------------------------
+// Rounds back to the image's depth.  sRGB values are rounded
+// in sRGB space, by finding which encoded values' midpoints
+// (taken back to linear) the value falls between.
+// --------------------------------------------------------
+static void Encode(const FloatImage& decoded, const TextureImage& format, const MipChainDesc& desc, const std::vector<float>& srgbMidpoints, unsigned int threadCount, TextureImage& image)
+{
+	image.Width = decoded.Width;
+	image.Height = decoded.Height;
+	image.Channels = format.Channels;
+	image.BitDepth = format.BitDepth;
+	image.Values.resize((size_t)image.Width * image.Height * image.Channels);
+
+	unsigned int maxValue = image.MaxValue();
+	ForEachRowRange(image.Height, (size_t)image.Width * 4, threadCount, [&](unsigned int first, unsigned int last)
+	{
+		for (size_t i = (size_t)first * image.Width; i < (size_t)last * image.Width; i++)
+		{
+			for (unsigned int c = 0; c < image.Channels; c++)
+			{
+				float value = decoded.Texels[i * 4 + c];
+				if (!(value > 0.0f))
+					value = 0.0f;
+				if (value > 1.0f)
+					value = 1.0f;
+
+				unsigned int encoded;
+				if (IsSRGBChannel(desc, c))
+				{
+					unsigned int low = 0;
+					unsigned int high = maxValue;
+					while (low < high)
+					{
+						unsigned int middle = (low + high + 1) / 2;
+						if (srgbMidpoints[middle] <= value)
+							low = middle;
+						else
+							high = middle - 1;
+					}
+					encoded = low;
+				}
+				else
+				{
+					encoded = (unsigned int)(value * maxValue + 0.5f);
+				}
+				image.Values[i * image.Channels + c] = (unsigned short)encoded;
+			}
+		}
+	});
+}
+
+bool MipGenerator::Generate(const TextureImage& top, const MipChainDesc& desc, std::vector<TextureImage>& mips)
+{
+	if (top.Width == 0 || top.Height == 0 || top.Channels == 0 || top.Channels > 4 ||
+		(top.BitDepth != 8 && top.BitDepth != 16) ||
+		top.Values.size() != (size_t)top.Width * top.Height * top.Channels)
+		return false;
+
+	MipInstructionSet instructions = desc.InstructionSet;
+	if (instructions > GetSupportedInstructionSet())
+		instructions = GetSupportedInstructionSet();
+	unsigned int threadCount = desc.ThreadCount;
+	if (threadCount == 0)
+		threadCount = std::thread::hardware_concurrency();
+	if (threadCount == 0)
+		threadCount = 1;
+
+	// Entry v is where encoded value v starts, in linear space
+	std::vector<float> srgbMidpoints;
+	if (desc.SRGB)
+	{
+		unsigned int maxValue = top.MaxValue();
+		srgbMidpoints.resize(maxValue + 1);
+		srgbMidpoints[0] = 0.0f;
+		for (unsigned int v = 1; v <= maxValue; v++)
+			srgbMidpoints[v] = (float)ToLinear((v - 0.5) / maxValue);
+	}
+
+	unsigned int mipCount = GetMipCount(top.Width, top.Height);
+	mips.resize(mipCount);
+	mips[0] = top;
+
+	FloatImage above;
+	FloatImage mip;
+	Decode(top, desc, threadCount, above);
+	for (unsigned int m = 1; m < mipCount; m++)
+	{
+		Downsample(above, mip, desc.Filter, instructions, threadCount);
+		Encode(mip, top, desc, srgbMidpoints, threadCount, mips[m]);
+		above.Width = mip.Width;
+		above.Height = mip.Height;
+		above.Texels.swap(mip.Texels);
+	}
+	return true;
+}
+
+unsigned int MipGenerator::GetMipCount(unsigned int width, unsigned int height)
+{
+	unsigned int size = width > height ? width : height;
+	unsigned int count = 1;
+	while (size >>= 1)
+		count++;
+	return count;
+}
+
+// --------------------------------------------------------
+// AVX2 also needs the OS to save the wider registers, which
+// the compiler's check covers but cpuid alone doesn't
+// --------------------------------------------------------
+MipInstructionSet MipGenerator::GetSupportedInstructionSet()
+{
+#if defined(MIP_GENERATOR_X86) && defined(_MSC_VER)
+	int registers[4];
+	__cpuid(registers, 0);
+	int highest = registers[0];
+	__cpuid(registers, 1);
+	bool osSavesAVX = (registers[2] & (1 << 27)) && (registers[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+	if (highest >= 7 && osSavesAVX)
+	{
+		__cpuidex(registers, 7, 0);
+		if (registers[1] & (1 << 5))
+			return MIP_INSTRUCTIONS_AVX2;
+	}
+	return MIP_INSTRUCTIONS_SSE2;
+#elif defined(MIP_GENERATOR_X86)
+	return __builtin_cpu_supports("avx2") ? MIP_INSTRUCTIONS_AVX2 : MIP_INSTRUCTIONS_SSE2;
+#else
+	return MIP_INSTRUCTIONS_SCALAR;
+#endif
+}
+
+int MipGenerator::Compare(const std::vector<TextureImage>& a, const std::vector<TextureImage>& b)
+{
+	if (a.size() != b.size())
+		return -1;
+
+	int largest = 0;
+	for (size_t m = 0; m < a.size(); m++)
+	{
+		if (a[m].Width != b[m].Width || a[m].Height != b[m].Height || a[m].Channels != b[m].Channels ||
+			a[m].Values.size() != b[m].Values.size())
+			return -1;
+		for (size_t i = 0; i < a[m].Values.size(); i++)
+		{
+			int difference = (int)a[m].Values[i] - (int)b[m].Values[i];
+			if (difference < 0)
+				difference = -difference;
+			if (difference > largest)
+				largest = difference;
+		}
+	}
+	return largest;
+}
+
+const char* MipGenerator::GetFilterName(MipFilter filter)
+{
+	switch (filter)
+	{
+	case MIP_FILTER_BOX: return "box";
+	case MIP_FILTER_KAISER: return "kaiser";
+	case MIP_FILTER_LANCZOS: return "lanczos";
+	}
+	return "";
+}
+
+bool MipGenerator::ParseFilter(const std::string& name, MipFilter& filter)
+{
+	for (int f = MIP_FILTER_BOX; f <= MIP_FILTER_LANCZOS; f++)
+	{
+		if (name == GetFilterName((MipFilter)f))
+		{
+			filter = (MipFilter)f;
+			return true;
+		}
+	}
+	return false;
+}
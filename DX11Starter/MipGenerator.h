@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "TiffReader.h"
+
+// How each mip is filtered down from the one above it
+enum MipFilter
+{
+	MIP_FILTER_BOX,		// Averages the texels each one covers
+	MIP_FILTER_KAISER,	// Kaiser windowed sinc, 3 texels each way - sharper
+	MIP_FILTER_LANCZOS	// Lanczos 3 - sharper still, with a little ringing
+};
+
+// Which code the filters run on.  Every one gives the same results.
+enum MipInstructionSet
+{
+	MIP_INSTRUCTIONS_SCALAR,	// Plain C++, the reference the others are checked against
+	MIP_INSTRUCTIONS_SSE2,
+	MIP_INSTRUCTIONS_AVX2
+};
+
+struct MipChainDesc
+{
+	MipFilter Filter;
+	bool SRGB;							// Red, green and blue are sRGB encoded
+	unsigned int ThreadCount;			// 0 for one per core
+	MipInstructionSet InstructionSet;	// Lowered to what the CPU has
+};
+
+// --------------------------------------------------------
+// Makes a texture's mip chain on the CPU, so textures don't
+// need to be render targets to get mips, and get better ones
+// than the GPU's box filter.
+//
+// Each mip is filtered from the one above it, which is kept
+// as floats in between so rounding doesn't build up.  Filters
+// are separable, done across then down, and take in every
+// texel they cover - so sizes that aren't a power of two (a
+// 5 texel row halves to 2, each covering 2.5) come out right.
+// Edges are clamped.  sRGB channels are filtered in linear
+// space, then encoded again.
+//
+// Rows are split across threads, and the filters run on SSE2
+// or AVX2 where the CPU has them.  Only needs the standard
+// library, so it runs in the offline cook on any platform.
+// --------------------------------------------------------
+class MipGenerator
+{
+public:
+	// Fills mips with top and every mip below it, down to 1x1.
+	// False if top has no texels or bad channels or depth.
+	static bool Generate(const TextureImage& top, const MipChainDesc& desc, std::vector<TextureImage>& mips);
+
+	// How many mips a full chain down to 1x1 has
+	static unsigned int GetMipCount(unsigned int width, unsigned int height);
+
+	// The best the CPU this is running on can do
+	static MipInstructionSet GetSupportedInstructionSet();
+
+	// The largest difference between any two values of two chains, or
+	// -1 if the chains aren't the same shape
+	static int Compare(const std::vector<TextureImage>& a, const std::vector<TextureImage>& b);
+
+	// Names as manifests write them: "box", "kaiser" and "lanczos"
+	static const char* GetFilterName(MipFilter filter);
+	static bool ParseFilter(const std::string& name, MipFilter& filter);
+};
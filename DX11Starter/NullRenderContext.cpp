@@ -0,0 +1,176 @@
+#include "NullRenderContext.h"
+#include "NullRenderDevice.h"
+
+#include <cstring>
+
+NullRenderContext::NullRenderContext()
+{
+	ResetStats();
+}
+
+NullRenderContext::~NullRenderContext()
+{
+}
+
+void NullRenderContext::ResetStats()
+{
+	stateCalls = 0;
+	drawCalls = 0;
+	indices = 0;
+	instances = 0;
+	bytesUploaded = 0;
+	bytesMapped = 0;
+}
+
+void NullRenderContext::IASetInputLayout(ID3D11InputLayout* inputLayout) { stateCalls++; }
+void NullRenderContext::IASetPrimitiveTopology(unsigned int topology) { stateCalls++; }
+void NullRenderContext::IASetVertexBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* strides, const unsigned int* offsets) { stateCalls++; }
+void NullRenderContext::IASetIndexBuffer(ID3D11Buffer* indexBuffer, unsigned int format, unsigned int offset) { stateCalls++; }
+
+void NullRenderContext::VSSetShader(ID3D11VertexShader* shader) { stateCalls++; }
+void NullRenderContext::VSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers) { stateCalls++; }
+void NullRenderContext::VSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views) { stateCalls++; }
+void NullRenderContext::VSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers) { stateCalls++; }
+
+void NullRenderContext::PSSetShader(ID3D11PixelShader* shader) { stateCalls++; }
+void NullRenderContext::PSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers) { stateCalls++; }
+void NullRenderContext::PSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views) { stateCalls++; }
+void NullRenderContext::PSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers) { stateCalls++; }
+
+void NullRenderContext::OMSetRenderTargets(unsigned int numViews, ID3D11RenderTargetView* const* renderTargetViews, ID3D11DepthStencilView* depthStencilView) { stateCalls++; }
+void NullRenderContext::RSSetViewport(float topLeftX, float topLeftY, float width, float height, float minDepth, float maxDepth) { stateCalls++; }
+void NullRenderContext::RSSetState(ID3D11RasterizerState* rasterizerState) { stateCalls++; }
+void NullRenderContext::OMSetBlendState(ID3D11BlendState* blendState) { stateCalls++; }
+void NullRenderContext::OMSetDepthStencilState(ID3D11DepthStencilState* depthStencilState, unsigned int stencilRef) { stateCalls++; }
+
+void NullRenderContext::ClearRenderTargetView(ID3D11RenderTargetView* renderTargetView, const float color[4]) { }
+void NullRenderContext::ClearDepthStencilView(ID3D11DepthStencilView* depthStencilView, float depth, unsigned char stencil) { }
+
+// --------------------------------------------------------
+// Copies into the buffer's memory like a real upload would,
+// never writing past the end of the buffer
+// --------------------------------------------------------
+void NullRenderContext::UpdateSubresource(ID3D11Buffer* buffer, const void* data, unsigned int byteSize)
+{
+	if (!buffer || !data)
+		return;
+
+	unsigned int bufferSize = NullRenderDevice::GetBufferSize(buffer);
+	if (byteSize > bufferSize)
+		byteSize = bufferSize;
+
+	memcpy(buffer, data, byteSize);
+	bytesUploaded += byteSize;
+}
+
+void NullRenderContext::UpdateSubresourceRange(ID3D11Buffer* buffer, unsigned int byteOffset, const void* data, unsigned int byteSize)
+{
+	if (!buffer || !data)
+		return;
+
+	unsigned int bufferSize = NullRenderDevice::GetBufferSize(buffer);
+	if (byteOffset >= bufferSize)
+		return;
+	if (byteSize > bufferSize - byteOffset)
+		byteSize = bufferSize - byteOffset;
+
+	memcpy((unsigned char*)buffer + byteOffset, data, byteSize);
+	bytesUploaded += byteSize;
+}
+
+// Texel data is never kept, it only counts as uploaded
+void NullRenderContext::UpdateTextureRegion(ID3D11ShaderResourceView* texture, unsigned int mipLevel, unsigned int left, unsigned int top, unsigned int width, unsigned int height, const void* data, unsigned int rowPitch)
+{
+	if (!texture || !data)
+		return;
+
+	bytesUploaded += (unsigned long long)rowPitch * height;
+}
+
+void NullRenderContext::SetResourceMinLOD(ID3D11ShaderResourceView* texture, float minLOD)
+{
+	stateCalls++;
+}
+
+// --------------------------------------------------------
+// Copies between the buffers' memory, clipped to both ends.
+// Counted as uploaded, the same as RenderStats counts it.
+// --------------------------------------------------------
+void NullRenderContext::CopyBufferRegion(ID3D11Buffer* destination, unsigned int destinationOffset, ID3D11Buffer* source, unsigned int sourceOffset, unsigned int byteSize)
+{
+	if (!destination || !source)
+		return;
+
+	unsigned int destinationSize = NullRenderDevice::GetBufferSize(destination);
+	unsigned int sourceSize = NullRenderDevice::GetBufferSize(source);
+	if (destinationOffset >= destinationSize || sourceOffset >= sourceSize)
+		return;
+	if (byteSize > destinationSize - destinationOffset)
+		byteSize = destinationSize - destinationOffset;
+	if (byteSize > sourceSize - sourceOffset)
+		byteSize = sourceSize - sourceOffset;
+
+	memmove((unsigned char*)destination + destinationOffset, (unsigned char*)source + sourceOffset, byteSize);
+	bytesUploaded += byteSize;
+}
+
+// --------------------------------------------------------
+// The buffer's own memory is written directly.  The whole
+// buffer counts as mapped, since that's what DISCARD costs,
+// but not as uploaded: that's only UpdateSubresource() and
+// copies, so it matches RenderStats' BytesUploaded.
+// --------------------------------------------------------
+void* NullRenderContext::MapDiscard(ID3D11Buffer* buffer)
+{
+	if (!buffer)
+		return 0;
+
+	bytesMapped += NullRenderDevice::GetBufferSize(buffer);
+	return buffer;
+}
+
+// --------------------------------------------------------
+// Same as MapDiscard(), except nothing counts as mapped,
+// since only the caller knows how much it'll write
+// --------------------------------------------------------
+void* NullRenderContext::MapNoOverwrite(ID3D11Buffer* buffer)
+{
+	return buffer;
+}
+
+// Staging memory counts as uploaded once it's copied out
+void* NullRenderContext::MapStaging(ID3D11Buffer* buffer)
+{
+	return buffer;
+}
+
+void NullRenderContext::Unmap(ID3D11Buffer* buffer)
+{
+}
+
+// Nothing is really bound, so offsets cost nothing to support
+bool NullRenderContext::SupportsConstantBufferOffsets() { return true; }
+void NullRenderContext::VSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants) { stateCalls++; }
+void NullRenderContext::PSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants) { stateCalls++; }
+
+void NullRenderContext::DrawIndexed(unsigned int indexCount, unsigned int startIndexLocation, int baseVertexLocation)
+{
+	drawCalls++;
+	indices += indexCount;
+	instances++;
+}
+
+void NullRenderContext::DrawIndexedInstanced(unsigned int indexCountPerInstance, unsigned int instanceCount, unsigned int startIndexLocation, int baseVertexLocation, unsigned int startInstanceLocation)
+{
+	drawCalls++;
+	indices += (unsigned long long)indexCountPerInstance * instanceCount;
+	instances += instanceCount;
+}
+
+// --------------------------------------------------------
+// Null devices only make software command lists, which play
+// themselves back through this context instead
+// --------------------------------------------------------
+void NullRenderContext::ExecuteCommandList(ID3D11CommandList* commandList)
+{
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "RenderContext.h"
+
+// --------------------------------------------------------
+// Render context that does no GPU work at all, it only counts
+// what it's asked to do.  Data sent to buffers made by a
+// NullRenderDevice is still copied into them, so the CPU side
+// of a frame costs the same as it would with a real device.
+// --------------------------------------------------------
+class NullRenderContext : public IRenderContext
+{
+public:
+	NullRenderContext(); // Constructor
+	~NullRenderContext(); // Destructor
+
+	// Input assembler
+	void IASetInputLayout(ID3D11InputLayout* inputLayout);
+	void IASetPrimitiveTopology(unsigned int topology);
+	void IASetVertexBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* strides, const unsigned int* offsets);
+	void IASetIndexBuffer(ID3D11Buffer* indexBuffer, unsigned int format, unsigned int offset);
+
+	// Vertex shader stage
+	void VSSetShader(ID3D11VertexShader* shader);
+	void VSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers);
+	void VSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views);
+	void VSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers);
+
+	// Pixel shader stage
+	void PSSetShader(ID3D11PixelShader* shader);
+	void PSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers);
+	void PSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views);
+	void PSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers);
+
+	// Output merger and rasterizer
+	void OMSetRenderTargets(unsigned int numViews, ID3D11RenderTargetView* const* renderTargetViews, ID3D11DepthStencilView* depthStencilView);
+	void RSSetViewport(float topLeftX, float topLeftY, float width, float height, float minDepth, float maxDepth);
+	void RSSetState(ID3D11RasterizerState* rasterizerState);
+	void OMSetBlendState(ID3D11BlendState* blendState);
+	void OMSetDepthStencilState(ID3D11DepthStencilState* depthStencilState, unsigned int stencilRef);
+	void ClearRenderTargetView(ID3D11RenderTargetView* renderTargetView, const float color[4]);
+	void ClearDepthStencilView(ID3D11DepthStencilView* depthStencilView, float depth, unsigned char stencil);
+
+	void UpdateSubresource(ID3D11Buffer* buffer, const void* data, unsigned int byteSize);
+	void UpdateSubresourceRange(ID3D11Buffer* buffer, unsigned int byteOffset, const void* data, unsigned int byteSize);
+	void UpdateTextureRegion(ID3D11ShaderResourceView* texture, unsigned int mipLevel, unsigned int left, unsigned int top, unsigned int width, unsigned int height, const void* data, unsigned int rowPitch);
+	void SetResourceMinLOD(ID3D11ShaderResourceView* texture, float minLOD);
+	void CopyBufferRegion(ID3D11Buffer* destination, unsigned int destinationOffset, ID3D11Buffer* source, unsigned int sourceOffset, unsigned int byteSize);
+
+	void* MapDiscard(ID3D11Buffer* buffer);
+	void* MapNoOverwrite(ID3D11Buffer* buffer);
+	void* MapStaging(ID3D11Buffer* buffer);
+	void Unmap(ID3D11Buffer* buffer);
+
+	bool SupportsConstantBufferOffsets();
+	void VSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants);
+	void PSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants);
+
+	void DrawIndexed(unsigned int indexCount, unsigned int startIndexLocation, int baseVertexLocation);
+	void DrawIndexedInstanced(unsigned int indexCountPerInstance, unsigned int instanceCount, unsigned int startIndexLocation, int baseVertexLocation, unsigned int startInstanceLocation);
+
+	void ExecuteCommandList(ID3D11CommandList* commandList);
+
+	// Stats since the last call to ResetStats()
+	void ResetStats();
+	unsigned int GetStateCalls() { return stateCalls; }
+	unsigned int GetDrawCalls() { return drawCalls; }
+	unsigned long long GetIndices() { return indices; }
+	unsigned long long GetInstances() { return instances; }
+	unsigned long long GetBytesUploaded() { return bytesUploaded; }	// UpdateSubresource and copies
+	unsigned long long GetBytesMapped() { return bytesMapped; }		// Whole buffers, per MapDiscard
+
+private:
+	unsigned int stateCalls;
+	unsigned int drawCalls;
+	unsigned long long indices;
+	unsigned long long instances;
+	unsigned long long bytesUploaded;
+	unsigned long long bytesMapped;
+};
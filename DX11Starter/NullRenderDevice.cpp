@@ -0,0 +1,250 @@
+#include "NullRenderDevice.h"
+#include "RecordingCommandList.h"
+
+#include <cstring>
+
+NullRenderDevice::NullRenderDevice()
+{
+	for (int i = 0; i < OBJECT_TYPE_COUNT; i++)
+	{
+		objectsCreated[i] = 0;
+		objectsAlive[i] = 0;
+	}
+	bytesAlive = 0;
+	renderStats.Reset();
+}
+
+NullRenderDevice::~NullRenderDevice()
+{
+}
+
+IRenderContext* NullRenderDevice::GetImmediateContext()
+{
+	return &immediateContext;
+}
+
+// --------------------------------------------------------
+// Software lists replay into the null context, so recording
+// still costs what it would with a real device
+// --------------------------------------------------------
+ICommandList* NullRenderDevice::CreateCommandList()
+{
+	return new RecordingCommandList();
+}
+
+ID3D11Buffer* NullRenderDevice::CreateBuffer(const BufferDesc& desc, const void* initialData)
+{
+	void* buffer = CreateObject(OBJECT_BUFFER, desc.ByteWidth, desc.ByteWidth);
+	if (initialData)
+		memcpy(buffer, initialData, desc.ByteWidth);
+	else
+		memset(buffer, 0, desc.ByteWidth);
+
+	RENDER_STATS(renderStats.BuffersCreated++);
+	RENDER_STATS(if (initialData) renderStats.BytesUploaded += desc.ByteWidth);
+	return (ID3D11Buffer*)buffer;
+}
+
+// --------------------------------------------------------
+// Texel data is never kept, the size is only an estimate of
+// what the texture would take up at 32 bits per texel
+// --------------------------------------------------------
+ID3D11ShaderResourceView* NullRenderDevice::CreateTexture2D(const TextureDesc& desc, const void* initialData, unsigned int rowPitch)
+{
+	unsigned long long byteSize = 0;
+	unsigned int width = desc.Width;
+	unsigned int height = desc.Height;
+	unsigned int mip = 0;
+	while (desc.MipLevels == 0 || mip < desc.MipLevels)
+	{
+		byteSize += (unsigned long long)width * height * 4;
+		mip++;
+		if (width == 1 && height == 1)
+			break;
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+
+	// Keep the mip count it actually got
+	TextureDesc created = desc;
+	created.MipLevels = mip;
+
+	RENDER_STATS(renderStats.TexturesCreated++);
+	RENDER_STATS(if (initialData) renderStats.BytesUploaded += (unsigned long long)rowPitch * desc.Height);
+	return CreateTextureObject(byteSize, created);
+}
+
+// The view takes up no memory of its own
+ID3D11ShaderResourceView* NullRenderDevice::CreateBufferShaderResourceView(ID3D11Buffer* structuredBuffer, unsigned int elementCount)
+{
+	return CreateTextureObject(0, TextureDesc());
+}
+
+// --------------------------------------------------------
+// Nothing is copied, but the textures are checked the same
+// way a real device would need them to match
+// --------------------------------------------------------
+ID3D11ShaderResourceView* NullRenderDevice::CreateTexture2DArray(ID3D11ShaderResourceView* const* textures, unsigned int textureCount)
+{
+	TextureDesc shape;
+	if (textureCount == 0 || !GetTextureDesc(textures[0], shape))
+		return 0;
+
+	for (unsigned int i = 1; i < textureCount; i++)
+	{
+		TextureDesc desc;
+		if (!GetTextureDesc(textures[i], desc) ||
+			desc.Width != shape.Width || desc.Height != shape.Height ||
+			desc.MipLevels != shape.MipLevels || desc.Format != shape.Format)
+			return 0;
+	}
+
+	RENDER_STATS(renderStats.TexturesCreated++);
+	return CreateTextureObject(GetHeader(textures[0])->ByteSize * textureCount, shape);
+}
+
+bool NullRenderDevice::GetTextureDesc(ID3D11ShaderResourceView* texture, TextureDesc& desc)
+{
+	if (!texture || GetHeader(texture)->Type != OBJECT_TEXTURE)
+		return false;
+
+	desc = *(const TextureDesc*)texture;
+	return desc.Width > 0;
+}
+
+ID3D11SamplerState* NullRenderDevice::CreateSamplerState(const SamplerDesc& desc)
+{
+	return (ID3D11SamplerState*)CreateObject(OBJECT_SAMPLER_STATE, 0, 0);
+}
+
+ID3D11RasterizerState* NullRenderDevice::CreateRasterizerState(const RasterizerDesc& desc)
+{
+	return (ID3D11RasterizerState*)CreateObject(OBJECT_RASTERIZER_STATE, 0, 0);
+}
+
+ID3D11BlendState* NullRenderDevice::CreateBlendState(const BlendDesc& desc)
+{
+	return (ID3D11BlendState*)CreateObject(OBJECT_BLEND_STATE, 0, 0);
+}
+
+ID3D11DepthStencilState* NullRenderDevice::CreateDepthStencilState(const DepthStencilDesc& desc)
+{
+	return (ID3D11DepthStencilState*)CreateObject(OBJECT_DEPTH_STENCIL_STATE, 0, 0);
+}
+
+ID3D11VertexShader* NullRenderDevice::CreateVertexShader(const void* byteCode, size_t byteCodeSize)
+{
+	return (ID3D11VertexShader*)CreateObject(OBJECT_VERTEX_SHADER, 0, 0);
+}
+
+ID3D11PixelShader* NullRenderDevice::CreatePixelShader(const void* byteCode, size_t byteCodeSize)
+{
+	return (ID3D11PixelShader*)CreateObject(OBJECT_PIXEL_SHADER, 0, 0);
+}
+
+ID3D11InputLayout* NullRenderDevice::CreateInputLayout(const InputElementDesc* elements, unsigned int elementCount, const void* byteCode, size_t byteCodeSize)
+{
+	return (ID3D11InputLayout*)CreateObject(OBJECT_INPUT_LAYOUT, 0, 0);
+}
+
+// --------------------------------------------------------
+// The texture's estimated size goes on whichever view is made
+// first, so it's only counted once however many views there are
+// --------------------------------------------------------
+bool NullRenderDevice::CreateRenderTexture(const RenderTextureDesc& desc, RenderTexture& texture)
+{
+	unsigned long long byteSize = (unsigned long long)desc.Width * desc.Height * 4;
+	RENDER_STATS(renderStats.TexturesCreated++);
+
+	texture = {};
+	if (desc.BindFlags & TEXTURE_BIND_RENDER_TARGET)
+	{
+		texture.RenderTargetView = (ID3D11RenderTargetView*)CreateObject(OBJECT_RENDER_TARGET_VIEW, byteSize, 0);
+		byteSize = 0;
+	}
+	if (desc.BindFlags & TEXTURE_BIND_DEPTH_STENCIL)
+	{
+		texture.DepthStencilView = (ID3D11DepthStencilView*)CreateObject(OBJECT_DEPTH_STENCIL_VIEW, byteSize, 0);
+		byteSize = 0;
+	}
+	if (desc.BindFlags & TEXTURE_BIND_SHADER_RESOURCE)
+	{
+		TextureDesc textureDesc = {};
+		textureDesc.Width = desc.Width;
+		textureDesc.Height = desc.Height;
+		textureDesc.MipLevels = 1;
+		textureDesc.Format = desc.Format;
+		texture.ShaderResourceView = CreateTextureObject(byteSize, textureDesc);
+	}
+	return true;
+}
+
+void NullRenderDevice::AddRef(ID3D11Buffer* buffer) { AddRefObject(buffer); }
+
+void NullRenderDevice::Release(ID3D11Buffer* buffer) { ReleaseObject(buffer); }
+void NullRenderDevice::Release(ID3D11ShaderResourceView* shaderResourceView) { ReleaseObject(shaderResourceView); }
+void NullRenderDevice::Release(ID3D11SamplerState* samplerState) { ReleaseObject(samplerState); }
+void NullRenderDevice::Release(ID3D11RasterizerState* rasterizerState) { ReleaseObject(rasterizerState); }
+void NullRenderDevice::Release(ID3D11BlendState* blendState) { ReleaseObject(blendState); }
+void NullRenderDevice::Release(ID3D11DepthStencilState* depthStencilState) { ReleaseObject(depthStencilState); }
+void NullRenderDevice::Release(ID3D11VertexShader* shader) { ReleaseObject(shader); }
+void NullRenderDevice::Release(ID3D11PixelShader* shader) { ReleaseObject(shader); }
+void NullRenderDevice::Release(ID3D11InputLayout* inputLayout) { ReleaseObject(inputLayout); }
+void NullRenderDevice::Release(ID3D11RenderTargetView* renderTargetView) { ReleaseObject(renderTargetView); }
+void NullRenderDevice::Release(ID3D11DepthStencilView* depthStencilView) { ReleaseObject(depthStencilView); }
+
+unsigned int NullRenderDevice::GetBufferSize(const ID3D11Buffer* buffer)
+{
+	return buffer ? (unsigned int)GetHeader(buffer)->ByteSize : 0;
+}
+
+// --------------------------------------------------------
+// Allocates the header plus allocationSize bytes after it,
+// and returns a pointer just past the header
+// --------------------------------------------------------
+void* NullRenderDevice::CreateObject(ObjectType type, unsigned long long byteSize, unsigned long long allocationSize)
+{
+	unsigned char* memory = new unsigned char[sizeof(ObjectHeader) + (size_t)allocationSize];
+
+	ObjectHeader* header = (ObjectHeader*)memory;
+	header->RefCount = 1;
+	header->Type = type;
+	header->ByteSize = byteSize;
+
+	objectsCreated[type]++;
+	objectsAlive[type]++;
+	bytesAlive += byteSize;
+	return memory + sizeof(ObjectHeader);
+}
+
+ID3D11ShaderResourceView* NullRenderDevice::CreateTextureObject(unsigned long long byteSize, const TextureDesc& desc)
+{
+	void* texture = CreateObject(OBJECT_TEXTURE, byteSize, sizeof(TextureDesc));
+	*(TextureDesc*)texture = desc;
+	return (ID3D11ShaderResourceView*)texture;
+}
+
+void NullRenderDevice::AddRefObject(void* object)
+{
+	if (object)
+		GetHeader(object)->RefCount++;
+}
+
+void NullRenderDevice::ReleaseObject(void* object)
+{
+	if (!object)
+		return;
+
+	ObjectHeader* header = GetHeader(object);
+	if (--header->RefCount > 0)
+		return;
+
+	objectsAlive[header->Type]--;
+	bytesAlive -= header->ByteSize;
+	delete[] (unsigned char*)header;
+}
+
+NullRenderDevice::ObjectHeader* NullRenderDevice::GetHeader(const void* object)
+{
+	return (ObjectHeader*)((const unsigned char*)object - sizeof(ObjectHeader));
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "RenderDevice.h"
+#include "NullRenderContext.h"
+
+// --------------------------------------------------------
+// Render device that needs no GPU, no window and no DirectX
+// runtime.  Objects it hands out are small heap blocks that
+// only pretend to be DirectX objects, so they must never be
+// given to a real device or context.  Buffers get real memory
+// to hold their contents, everything else is just a header.
+// --------------------------------------------------------
+class NullRenderDevice : public IRenderDevice
+{
+public:
+	// Each kind of object the device can make
+	enum ObjectType
+	{
+		OBJECT_BUFFER,
+		OBJECT_TEXTURE,
+		OBJECT_SAMPLER_STATE,
+		OBJECT_RASTERIZER_STATE,
+		OBJECT_BLEND_STATE,
+		OBJECT_DEPTH_STENCIL_STATE,
+		OBJECT_VERTEX_SHADER,
+		OBJECT_PIXEL_SHADER,
+		OBJECT_INPUT_LAYOUT,
+		OBJECT_RENDER_TARGET_VIEW,
+		OBJECT_DEPTH_STENCIL_VIEW,
+		OBJECT_TYPE_COUNT
+	};
+
+	NullRenderDevice(); // Constructor
+	~NullRenderDevice(); // Destructor
+
+	IRenderContext* GetImmediateContext();
+	ICommandList* CreateCommandList();
+
+	ID3D11Buffer* CreateBuffer(const BufferDesc& desc, const void* initialData);
+	ID3D11ShaderResourceView* CreateTexture2D(const TextureDesc& desc, const void* initialData, unsigned int rowPitch);
+	ID3D11ShaderResourceView* CreateBufferShaderResourceView(ID3D11Buffer* structuredBuffer, unsigned int elementCount);
+	ID3D11SamplerState* CreateSamplerState(const SamplerDesc& desc);
+	ID3D11RasterizerState* CreateRasterizerState(const RasterizerDesc& desc);
+	ID3D11BlendState* CreateBlendState(const BlendDesc& desc);
+	ID3D11DepthStencilState* CreateDepthStencilState(const DepthStencilDesc& desc);
+	ID3D11VertexShader* CreateVertexShader(const void* byteCode, size_t byteCodeSize);
+	ID3D11PixelShader* CreatePixelShader(const void* byteCode, size_t byteCodeSize);
+	ID3D11InputLayout* CreateInputLayout(const InputElementDesc* elements, unsigned int elementCount, const void* byteCode, size_t byteCodeSize);
+	ID3D11ShaderResourceView* CreateTexture2DArray(ID3D11ShaderResourceView* const* textures, unsigned int textureCount);
+	bool GetTextureDesc(ID3D11ShaderResourceView* texture, TextureDesc& desc);
+	bool CreateRenderTexture(const RenderTextureDesc& desc, RenderTexture& texture);
+
+	void AddRef(ID3D11Buffer* buffer);
+
+	void Release(ID3D11Buffer* buffer);
+	void Release(ID3D11ShaderResourceView* shaderResourceView);
+	void Release(ID3D11SamplerState* samplerState);
+	void Release(ID3D11RasterizerState* rasterizerState);
+	void Release(ID3D11BlendState* blendState);
+	void Release(ID3D11DepthStencilState* depthStencilState);
+	void Release(ID3D11VertexShader* shader);
+	void Release(ID3D11PixelShader* shader);
+	void Release(ID3D11InputLayout* inputLayout);
+	void Release(ID3D11RenderTargetView* renderTargetView);
+	void Release(ID3D11DepthStencilView* depthStencilView);
+
+	const RenderStatCounters& GetRenderStats() { return renderStats; }
+
+	// Size of a buffer's contents, which start at the buffer pointer itself
+	static unsigned int GetBufferSize(const ID3D11Buffer* buffer);
+
+	// GET methods
+	NullRenderContext* GetNullContext() { return &immediateContext; }
+	unsigned int GetObjectsCreated(ObjectType type) { return objectsCreated[type]; }
+	unsigned int GetObjectsAlive(ObjectType type) { return objectsAlive[type]; }
+	unsigned long long GetBytesAlive() { return bytesAlive; }
+
+private:
+	// Sits in front of every object's memory.  16 bytes, so
+	// buffer contents right after it stay 16 byte aligned.
+	struct ObjectHeader
+	{
+		unsigned int RefCount;
+		unsigned int Type;
+		unsigned long long ByteSize;
+	};
+
+	void* CreateObject(ObjectType type, unsigned long long byteSize, unsigned long long allocationSize);
+
+	// Textures keep their description after the header, zeroed for
+	// views of things that aren't 2D textures
+	ID3D11ShaderResourceView* CreateTextureObject(unsigned long long byteSize, const TextureDesc& desc);
+	void AddRefObject(void* object);
+	void ReleaseObject(void* object);
+	static ObjectHeader* GetHeader(const void* object);
+
+	NullRenderContext immediateContext;
+
+	unsigned int objectsCreated[OBJECT_TYPE_COUNT];
+	unsigned int objectsAlive[OBJECT_TYPE_COUNT];
+	unsigned long long bytesAlive;
+	RenderStatCounters renderStats;
+};
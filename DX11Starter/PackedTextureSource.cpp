@@ -0,0 +1,104 @@
+#include "PackedTextureSource.h"
+#include "DdsFile.h"
+
+PackedTextureSource::PackedTextureSource(const std::string& manifestPath)
+{
+	this->manifestPath = manifestPath;
+	desc = PackedTextureDesc();
+	info = PackedTextureInfo();
+	cooked = TextureImage();
+}
+
+bool PackedTextureSource::Open(TextureDesc& textureDesc, std::vector<unsigned char>& placeholder)
+{
+	std::vector<PackedTextureDesc> textures;
+	unsigned int errorLine;
+	if (!TextureCooker::LoadManifest(manifestPath, textures, errorLine))
+		return false;
+	desc = textures[0];
+
+	if (!TextureCooker::LoadInfo(TextureCooker::GetInfoPath(desc.Output), info) &&
+		!TextureCooker::Cook(desc, cooked, info))
+		return false;
+	if (info.Format == 0)
+		return false;
+
+	textureDesc.Width = info.Width;
+	textureDesc.Height = info.Height;
+	textureDesc.Format = info.Format;
+
+	TextureImage texel = {};
+	texel.Width = 1;
+	texel.Height = 1;
+	texel.Channels = info.ChannelCount;
+	texel.BitDepth = info.BitDepth;
+	texel.Values.assign(info.ChannelCount, texel.MaxValue());
+	unsigned int rowPitch;
+	DdsFile::GetTexels(texel, placeholder, rowPitch);
+	return true;
+}
+
+// --------------------------------------------------------
+// Every mip is loaded or made the first time any is asked
+// for, and they're all let go once the top one has been read, since
+// mips are read smallest first
+// --------------------------------------------------------
+bool PackedTextureSource::ReadMip(unsigned int mip, std::vector<unsigned char>& texels, unsigned int& rowPitch)
+{
+	if (mips.empty() && !LoadMips())
+		return false;
+	if (mip >= mips.size())
+		return false;
+
+	DdsFile::GetTexels(mips[mip], texels, rowPitch);
+	if (mip == 0)
+		mips.clear();
+	return true;
+}
+
+// --------------------------------------------------------
+// Whatever's loaded or cooked here has to match the info
+// the texture was made from, or it won't fit the texture
+// --------------------------------------------------------
+bool PackedTextureSource::LoadMips()
+{
+	if (!cooked.Values.empty())
+	{
+		mips.resize(1);
+		mips[0] = std::move(cooked);
+		cooked = TextureImage();
+	}
+	else if (!DdsFile::Load(desc.Output, mips) || TextureCooker::HashImage(mips[0]) != info.DataHash)
+	{
+		PackedTextureInfo cookedInfo;
+		mips.resize(1);
+		if (!TextureCooker::Cook(desc, mips[0], cookedInfo))
+		{
+			mips.clear();
+			return false;
+		}
+	}
+
+	const TextureImage& top = mips[0];
+	if (top.Width != info.Width || top.Height != info.Height ||
+		DdsFile::GetFormat(top.Channels, top.BitDepth, desc.SRGB) != info.Format)
+	{
+		mips.clear();
+		return false;
+	}
+
+	// Streamed textures always have every mip.  Making them only takes
+	// one thread, leaving the rest to the frame.
+	if (mips.size() < MipGenerator::GetMipCount(top.Width, top.Height))
+	{
+		MipChainDesc mipChain = TextureCooker::GetMipChainDesc(desc);
+		mipChain.ThreadCount = 1;
+		TextureImage image = std::move(mips[0]);
+		if (!MipGenerator::Generate(image, mipChain, mips))
+		{
+			mips.clear();
+			return false;
+		}
+	}
+	return true;
+}
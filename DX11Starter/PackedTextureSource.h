@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "TextureCooker.h"
+#include "TextureStreamer.h"
+
+// --------------------------------------------------------
+// Streams a texture of packed maps, as a texture cooker
+// manifest describes.
+//
+// Opening only reads the manifest and the cooked texture's
+// info sidecar, which say how big the texture is.  The cooked
+// texture and its mips are loaded on the streaming thread when
+// the first mip is asked for.  Any mips it was cooked without
+// are made there, as the manifest says.  If it's missing or
+// doesn't match its info, the maps are cooked from their
+// sources instead - on the streaming thread, unless there's no
+// info to open with, in which case opening cooks them.
+//
+// The placeholder is every channel at full, which leaves
+// ambient occlusion off until the real maps arrive.
+// --------------------------------------------------------
+class PackedTextureSource : public ITextureStreamSource
+{
+public:
+	PackedTextureSource(const std::string& manifestPath); // Constructor
+
+	// ITextureStreamSource
+	bool Open(TextureDesc& desc, std::vector<unsigned char>& placeholder);
+	bool ReadMip(unsigned int mip, std::vector<unsigned char>& texels, unsigned int& rowPitch);
+
+	// What the texture holds.  Set by Open(), and never changed after,
+	// so it's safe to read while the texture streams.
+	const PackedTextureInfo& GetInfo() const { return info; }
+
+private:
+	// Loads or cooks the texture, and makes any mips it's missing
+	bool LoadMips();
+
+	std::string manifestPath;
+	PackedTextureDesc desc;
+	PackedTextureInfo info;
+	TextureImage cooked;			// Only set if Open() had to cook
+	std::vector<TextureImage> mips;	// Only used on the streaming thread
+};
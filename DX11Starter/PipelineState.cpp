@@ -0,0 +1,273 @@
+#include "PipelineState.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ PIPELINE STATE ------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+unsigned int PipelineState::Bind(IRenderContext* context, const PipelineState* previous) const
+{
+	unsigned int changed = Diff(previous);
+	if (changed & (1 << SUB_STATE_VERTEX_SHADER))
+		context->VSSetShader(desc.VertexShader);
+	if (changed & (1 << SUB_STATE_PIXEL_SHADER))
+		context->PSSetShader(desc.PixelShader);
+	if (changed & (1 << SUB_STATE_INPUT_LAYOUT))
+		context->IASetInputLayout(desc.InputLayout);
+	if (changed & (1 << SUB_STATE_TOPOLOGY))
+		context->IASetPrimitiveTopology(desc.Topology);
+	if (changed & (1 << SUB_STATE_RASTERIZER))
+		context->RSSetState(rasterizerState);
+	if (changed & (1 << SUB_STATE_BLEND))
+		context->OMSetBlendState(blendState);
+	if (changed & (1 << SUB_STATE_DEPTH_STENCIL))
+		context->OMSetDepthStencilState(depthStencilState, 0);
+	return changed;
+}
+
+// --------------------------------------------------------
+// The state objects are shared through the cache, so their
+// pointers stand in for comparing whole descriptions
+// --------------------------------------------------------
+unsigned int PipelineState::Diff(const PipelineState* previous) const
+{
+	if (!previous)
+		return (1 << SUB_STATE_COUNT) - 1;
+	if (previous == this)
+		return 0;
+
+	unsigned int changed = 0;
+	if (desc.VertexShader != previous->desc.VertexShader)
+		changed |= 1 << SUB_STATE_VERTEX_SHADER;
+	if (desc.PixelShader != previous->desc.PixelShader)
+		changed |= 1 << SUB_STATE_PIXEL_SHADER;
+	if (desc.InputLayout != previous->desc.InputLayout)
+		changed |= 1 << SUB_STATE_INPUT_LAYOUT;
+	if (desc.Topology != previous->desc.Topology)
+		changed |= 1 << SUB_STATE_TOPOLOGY;
+	if (rasterizerState != previous->rasterizerState)
+		changed |= 1 << SUB_STATE_RASTERIZER;
+	if (blendState != previous->blendState)
+		changed |= 1 << SUB_STATE_BLEND;
+	if (depthStencilState != previous->depthStencilState)
+		changed |= 1 << SUB_STATE_DEPTH_STENCIL;
+	return changed;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ PIPELINE STATE CACHE ------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+PipelineStateCache::PipelineStateCache(IRenderDevice* device)
+{
+	this->device = device;
+	lookups = 0;
+	hits = 0;
+}
+
+// --------------------------------------------------------
+// Anything still cached is released, whoever was using it
+// --------------------------------------------------------
+PipelineStateCache::~PipelineStateCache()
+{
+	for (std::unordered_multimap<unsigned long long, PipelineState*>::iterator it = pipelineStates.begin(); it != pipelineStates.end(); ++it)
+		delete it->second;
+
+	ReleaseAll(samplers);
+	ReleaseAll(rasterizerStates);
+	ReleaseAll(blendStates);
+	ReleaseAll(depthStencilStates);
+}
+
+const PipelineState* PipelineStateCache::GetPipelineState(const PipelineStateDesc& desc)
+{
+	lookups++;
+
+	// Same hash is only a candidate - the descriptions have to match too
+	unsigned long long hash = Hash(desc);
+	std::pair<std::unordered_multimap<unsigned long long, PipelineState*>::iterator, std::unordered_multimap<unsigned long long, PipelineState*>::iterator> range = pipelineStates.equal_range(hash);
+	for (std::unordered_multimap<unsigned long long, PipelineState*>::iterator it = range.first; it != range.second; ++it)
+	{
+		if (Equal(it->second->desc, desc))
+		{
+			hits++;
+			return it->second;
+		}
+	}
+
+	// Parts another pipeline state already made are shared
+	ID3D11RasterizerState* rasterizerState = GetRasterizerState(desc.Rasterizer);
+	ID3D11BlendState* blendState = GetBlendState(desc.Blend);
+	ID3D11DepthStencilState* depthStencilState = GetDepthStencilState(desc.DepthStencil);
+	if (!rasterizerState || !blendState || !depthStencilState)
+		return 0;
+
+	PipelineState* state = new PipelineState();
+	state->desc = desc;
+	state->hash = hash;
+	state->rasterizerState = rasterizerState;
+	state->blendState = blendState;
+	state->depthStencilState = depthStencilState;
+	pipelineStates.insert(std::make_pair(hash, state));
+	return state;
+}
+
+ID3D11SamplerState* PipelineStateCache::GetSamplerState(const SamplerDesc& desc)
+{
+	IRenderDevice* device = this->device;
+	return FindOrCreate(samplers, desc, [device](const SamplerDesc& d) { return device->CreateSamplerState(d); });
+}
+
+ID3D11RasterizerState* PipelineStateCache::GetRasterizerState(const RasterizerDesc& desc)
+{
+	IRenderDevice* device = this->device;
+	return FindOrCreate(rasterizerStates, desc, [device](const RasterizerDesc& d) { return device->CreateRasterizerState(d); });
+}
+
+ID3D11BlendState* PipelineStateCache::GetBlendState(const BlendDesc& desc)
+{
+	IRenderDevice* device = this->device;
+	return FindOrCreate(blendStates, desc, [device](const BlendDesc& d) { return device->CreateBlendState(d); });
+}
+
+ID3D11DepthStencilState* PipelineStateCache::GetDepthStencilState(const DepthStencilDesc& desc)
+{
+	IRenderDevice* device = this->device;
+	return FindOrCreate(depthStencilStates, desc, [device](const DepthStencilDesc& d) { return device->CreateDepthStencilState(d); });
+}
+
+// --------------------------------------------------------
+// Hashing.  Every field goes in as 8 bytes, so fields of
+// different types can't run into each other.
+// --------------------------------------------------------
+static void HashValue(unsigned long long& hash, unsigned long long value)
+{
+	for (int i = 0; i < 8; i++)
+		hash = (hash ^ ((value >> (i * 8)) & 0xFF)) * 1099511628211ull;
+}
+
+static const unsigned long long HashSeed = 14695981039346656037ull;
+
+unsigned long long PipelineStateCache::Hash(const PipelineStateDesc& desc)
+{
+	unsigned long long hash = HashSeed;
+	HashValue(hash, (unsigned long long)(size_t)desc.VertexShader);
+	HashValue(hash, (unsigned long long)(size_t)desc.PixelShader);
+	HashValue(hash, (unsigned long long)(size_t)desc.InputLayout);
+	HashValue(hash, Hash(desc.Rasterizer));
+	HashValue(hash, Hash(desc.Blend));
+	HashValue(hash, Hash(desc.DepthStencil));
+	HashValue(hash, desc.Topology);
+	return hash;
+}
+
+unsigned long long PipelineStateCache::Hash(const SamplerDesc& desc)
+{
+	unsigned long long hash = HashSeed;
+	HashValue(hash, desc.Filter);
+	HashValue(hash, desc.AddressMode);
+	HashValue(hash, desc.MaxAnisotropy);
+	return hash;
+}
+
+unsigned long long PipelineStateCache::Hash(const RasterizerDesc& desc)
+{
+	unsigned long long hash = HashSeed;
+	HashValue(hash, desc.FillMode);
+	HashValue(hash, desc.CullMode);
+	HashValue(hash, desc.FrontCounterClockwise);
+	HashValue(hash, (unsigned long long)(long long)desc.DepthBias);
+	HashValue(hash, desc.DepthClipDisable);
+	HashValue(hash, desc.ScissorEnable);
+	return hash;
+}
+
+unsigned long long PipelineStateCache::Hash(const BlendDesc& desc)
+{
+	unsigned long long hash = HashSeed;
+	HashValue(hash, desc.Mode);
+	HashValue(hash, desc.AlphaToCoverage);
+	return hash;
+}
+
+unsigned long long PipelineStateCache::Hash(const DepthStencilDesc& desc)
+{
+	unsigned long long hash = HashSeed;
+	HashValue(hash, desc.DepthDisable);
+	HashValue(hash, desc.DepthWriteDisable);
+	HashValue(hash, desc.Func);
+	return hash;
+}
+
+bool PipelineStateCache::Equal(const PipelineStateDesc& a, const PipelineStateDesc& b)
+{
+	return
+		a.VertexShader == b.VertexShader &&
+		a.PixelShader == b.PixelShader &&
+		a.InputLayout == b.InputLayout &&
+		Equal(a.Rasterizer, b.Rasterizer) &&
+		Equal(a.Blend, b.Blend) &&
+		Equal(a.DepthStencil, b.DepthStencil) &&
+		a.Topology == b.Topology;
+}
+
+bool PipelineStateCache::Equal(const SamplerDesc& a, const SamplerDesc& b)
+{
+	return a.Filter == b.Filter && a.AddressMode == b.AddressMode && a.MaxAnisotropy == b.MaxAnisotropy;
+}
+
+bool PipelineStateCache::Equal(const RasterizerDesc& a, const RasterizerDesc& b)
+{
+	return
+		a.FillMode == b.FillMode &&
+		a.CullMode == b.CullMode &&
+		a.FrontCounterClockwise == b.FrontCounterClockwise &&
+		a.DepthBias == b.DepthBias &&
+		a.DepthClipDisable == b.DepthClipDisable &&
+		a.ScissorEnable == b.ScissorEnable;
+}
+
+bool PipelineStateCache::Equal(const BlendDesc& a, const BlendDesc& b)
+{
+	return a.Mode == b.Mode && a.AlphaToCoverage == b.AlphaToCoverage;
+}
+
+bool PipelineStateCache::Equal(const DepthStencilDesc& a, const DepthStencilDesc& b)
+{
+	return a.DepthDisable == b.DepthDisable && a.DepthWriteDisable == b.DepthWriteDisable && a.Func == b.Func;
+}
+
+template<typename Desc, typename Object, typename Create>
+Object* PipelineStateCache::FindOrCreate(StateTable<Desc, Object>& table, const Desc& desc, Create create)
+{
+	lookups++;
+
+	unsigned long long hash = Hash(desc);
+	typedef typename StateTable<Desc, Object>::iterator Iterator;
+	std::pair<Iterator, Iterator> range = table.equal_range(hash);
+	for (Iterator it = range.first; it != range.second; ++it)
+	{
+		if (Equal(it->second.Description, desc))
+		{
+			hits++;
+			return it->second.State;
+		}
+	}
+
+	Object* state = create(desc);
+	if (!state)
+		return 0;
+
+	CachedState<Desc, Object> cached;
+	cached.Description = desc;
+	cached.State = state;
+	table.insert(std::make_pair(hash, cached));
+	return state;
+}
+
+template<typename Desc, typename Object>
+void PipelineStateCache::ReleaseAll(StateTable<Desc, Object>& table)
+{
+	for (typename StateTable<Desc, Object>::iterator it = table.begin(); it != table.end(); ++it)
+		device->Release(it->second.State);
+	table.clear();
+}
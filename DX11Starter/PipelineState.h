@@ -0,0 +1,150 @@
+#pragma once
+
+#include <unordered_map>
+#include "RenderDevice.h"
+
+// --------------------------------------------------------
+// Everything a draw needs bound besides its resources and
+// constants.  Shaders and the input layout are the objects
+// themselves, the fixed function states are descriptions the
+// cache turns into objects.
+// --------------------------------------------------------
+struct PipelineStateDesc
+{
+	ID3D11VertexShader* VertexShader;
+	ID3D11PixelShader* PixelShader;
+	ID3D11InputLayout* InputLayout;
+	RasterizerDesc Rasterizer;
+	BlendDesc Blend;
+	DepthStencilDesc DepthStencil;
+	unsigned int Topology;	// D3D11_PRIMITIVE_TOPOLOGY
+};
+
+// --------------------------------------------------------
+// One finished, unchangeable pipeline state, made by a
+// PipelineStateCache.  Every part is shared with any other
+// state made by the same cache that asked for the same thing,
+// so two states are equal exactly when their pointers are,
+// and their parts can be compared the same way.
+// --------------------------------------------------------
+class PipelineState
+{
+public:
+	// Sub-states in the order Bind() applies them
+	enum SubState
+	{
+		SUB_STATE_VERTEX_SHADER,
+		SUB_STATE_PIXEL_SHADER,
+		SUB_STATE_INPUT_LAYOUT,
+		SUB_STATE_TOPOLOGY,
+		SUB_STATE_RASTERIZER,
+		SUB_STATE_BLEND,
+		SUB_STATE_DEPTH_STENCIL,
+		SUB_STATE_COUNT
+	};
+
+	// Sets every sub-state that differs from the previous state,
+	// or all of them if there's no previous state (like at the
+	// start of a command list).  Returns a bit per sub-state set.
+	unsigned int Bind(IRenderContext* context, const PipelineState* previous) const;
+
+	// Which sub-states differ between two states, as Bind() would set them
+	unsigned int Diff(const PipelineState* previous) const;
+
+	// GET methods
+	const PipelineStateDesc& GetDesc() const { return desc; }
+	unsigned long long GetHash() const { return hash; }
+	ID3D11RasterizerState* GetRasterizerState() const { return rasterizerState; }
+	ID3D11BlendState* GetBlendState() const { return blendState; }
+	ID3D11DepthStencilState* GetDepthStencilState() const { return depthStencilState; }
+
+private:
+	friend class PipelineStateCache;
+	PipelineState() { }
+	PipelineState(const PipelineState&);
+	PipelineState& operator=(const PipelineState&);
+
+	PipelineStateDesc desc;
+	unsigned long long hash;
+	ID3D11RasterizerState* rasterizerState;
+	ID3D11BlendState* blendState;
+	ID3D11DepthStencilState* depthStencilState;
+};
+
+// --------------------------------------------------------
+// Makes pipeline states and the state objects inside them,
+// and never makes the same one twice.  Descriptions are found
+// by hash and then compared field by field, so asking again
+// for something already made hands back the same object.
+//
+// Samplers go through here too, since they're described and
+// shared the same way.  Everything the cache makes lives until
+// the cache is destroyed, and must not be released by anyone
+// else.  Shaders and input layouts are only referred to - they
+// have to outlive every pipeline state using them.
+// --------------------------------------------------------
+class PipelineStateCache
+{
+public:
+	PipelineStateCache(IRenderDevice* device); // Constructor
+	~PipelineStateCache(); // Destructor
+
+	// Null if any of its state objects couldn't be made
+	const PipelineState* GetPipelineState(const PipelineStateDesc& desc);
+
+	// The shared state object for a description, or null if it couldn't be made
+	ID3D11SamplerState* GetSamplerState(const SamplerDesc& desc);
+	ID3D11RasterizerState* GetRasterizerState(const RasterizerDesc& desc);
+	ID3D11BlendState* GetBlendState(const BlendDesc& desc);
+	ID3D11DepthStencilState* GetDepthStencilState(const DepthStencilDesc& desc);
+
+	// FNV-1a 64 of every field
+	static unsigned long long Hash(const PipelineStateDesc& desc);
+	static unsigned long long Hash(const SamplerDesc& desc);
+	static unsigned long long Hash(const RasterizerDesc& desc);
+	static unsigned long long Hash(const BlendDesc& desc);
+	static unsigned long long Hash(const DepthStencilDesc& desc);
+
+	// Field by field comparisons, so padding never matters
+	static bool Equal(const PipelineStateDesc& a, const PipelineStateDesc& b);
+	static bool Equal(const SamplerDesc& a, const SamplerDesc& b);
+	static bool Equal(const RasterizerDesc& a, const RasterizerDesc& b);
+	static bool Equal(const BlendDesc& a, const BlendDesc& b);
+	static bool Equal(const DepthStencilDesc& a, const DepthStencilDesc& b);
+
+	// Stats.  Lookups include the ones a new pipeline state makes for its parts.
+	size_t GetPipelineStateCount() { return pipelineStates.size(); }
+	size_t GetStateObjectCount() { return samplers.size() + rasterizerStates.size() + blendStates.size() + depthStencilStates.size(); }
+	unsigned int GetLookups() { return lookups; }
+	unsigned int GetHits() { return hits; }
+	float GetHitRate() { return lookups > 0 ? (float)hits / lookups : 0.0f; }
+	void ResetStats() { lookups = 0; hits = 0; }
+
+private:
+	// A description and the object made from it
+	template<typename Desc, typename Object>
+	struct CachedState
+	{
+		Desc Description;
+		Object* State;
+	};
+
+	template<typename Desc, typename Object>
+	using StateTable = std::unordered_multimap<unsigned long long, CachedState<Desc, Object>>;
+
+	// Finds a description in a table, or makes and adds it with create
+	template<typename Desc, typename Object, typename Create>
+	Object* FindOrCreate(StateTable<Desc, Object>& table, const Desc& desc, Create create);
+
+	template<typename Desc, typename Object>
+	void ReleaseAll(StateTable<Desc, Object>& table);
+
+	IRenderDevice* device;
+	std::unordered_multimap<unsigned long long, PipelineState*> pipelineStates;
+	StateTable<SamplerDesc, ID3D11SamplerState> samplers;
+	StateTable<RasterizerDesc, ID3D11RasterizerState> rasterizerStates;
+	StateTable<BlendDesc, ID3D11BlendState> blendStates;
+	StateTable<DepthStencilDesc, ID3D11DepthStencilState> depthStencilStates;
+	unsigned int lookups;
+	unsigned int hits;
+};
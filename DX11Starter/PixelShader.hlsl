@@ -1,4 +1,25 @@
 
+// Features this shader can be compiled without, to make cheaper variants.
+// The defaults are what the project builds PixelShader.cso with.
+//  - LIGHT_COUNT: how many of the lights to use, 0 to 4
+//  - USE_TEXTURE: sample the base color texture, or use plain white
+//  - USE_AMBIENT: add the lights' ambient colors
+//  - AO_CHANNEL: which channel of the material's packed maps holds
+//    ambient occlusion, 1 to 4 for red to alpha, or 0 for none.  The
+//    material picks it from the info the texture cooker saves.
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT 4
+#endif
+#ifndef USE_TEXTURE
+#define USE_TEXTURE 1
+#endif
+#ifndef USE_AMBIENT
+#define USE_AMBIENT 1
+#endif
+#ifndef AO_CHANNEL
+#define AO_CHANNEL 0
+#endif
+
 // Struct representing the data we expect to receive from earlier pipeline stages
 // - Should match the output of our corresponding vertex shader
 // - The name of the struct itself is unimportant
@@ -14,6 +35,7 @@ struct VertexToPixel
 	float4 position		: SV_POSITION;
 	float3 normal		: NORMAL;
 	float2 uv			: TEXCOORD;
+	nointerpolation uint textureSlice : TEXTURE_SLICE;
 };
 
 // Struct representing a directional light
@@ -31,9 +53,30 @@ cbuffer lightData : register(b0)
 	DirectionalLight lights[4]; // The size of this array should match the number of lights getting passed in
 };
 
+// Constant Buffer holding the material's parameters, which each
+// material keeps in its own buffer
+cbuffer materialData : register(b1)
+{
+	float4 tint;		// Multiplies the surface color
+	float2 uvScale;		// Texture coordinates are scaled, then offset
+	float2 uvOffset;
+};
+
 // Texture related global variables
-Texture2D textureBaseColor	: register(t0);
+#if USE_TEXTURE
+// - Base colors are packed into arrays of same sized textures,
+//    and each draw or instance says which slice is its own
+Texture2DArray textureBaseColor	: register(t0);
+#endif
+#if USE_TEXTURE || AO_CHANNEL
 SamplerState samplerState	: register(s0);
+#endif
+
+// Single channel maps packed offline into one texture, so they're
+// all sampled with one fetch
+#if AO_CHANNEL
+Texture2D textureMaterialMaps	: register(t1);
+#endif
 
 // --------------------------------------------------------
 // The entry point (main method) for our pixel shader
@@ -50,9 +93,17 @@ float4 main(VertexToPixel input) : SV_TARGET
 	// - Previous transformations may have made it a non-unit vector
 	input.normal = normalize(input.normal);
 
+	// Read every packed map at once
+#if AO_CHANNEL
+	float4 materialMaps = textureMaterialMaps.Sample(samplerState, input.uv * uvScale + uvOffset);
+	float ambientOcclusion = materialMaps[AO_CHANNEL - 1];
+#else
+	float ambientOcclusion = 1;
+#endif
+
 	// Calculate the lighting impact on final pixel color for each passed in light
 	float4 lightColor = float4(0, 0, 0, 1);
-	for (int i = 0; i < 4; i++)
+	for (int i = 0; i < LIGHT_COUNT; i++)
 	{
 		// Calculate the normalized direction to the light
 		float3 directionToTheLight = normalize(-lights[i].direction);
@@ -67,11 +118,19 @@ float4 main(VertexToPixel input) : SV_TARGET
 		// Add to the final surface color based on light amount, diffuse color and ambient color
 		// - Scale the lights diffuse color by the light amount
 		// - Add the lights ambient color
-		lightColor += (lightAmount * lights[i].diffuseColor) + lights[i].ambientColor;
+		lightColor += lightAmount * lights[i].diffuseColor;
+#if USE_AMBIENT
+		lightColor += lights[i].ambientColor * ambientOcclusion;
+#endif
 	}
 
 	// Sample the base final pixel color from the passed in texture and uv cordinates
-	float4 surfaceColor = textureBaseColor.Sample(samplerState, input.uv);
+#if USE_TEXTURE
+	float4 surfaceColor = textureBaseColor.Sample(samplerState, float3(input.uv * uvScale + uvOffset, input.textureSlice));
+#else
+	float4 surfaceColor = float4(1, 1, 1, 1);
+#endif
+	surfaceColor *= tint;
 
 	// Return the final pixel color
 	return surfaceColor * lightColor;
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <string>
+
+// --------------------------------------------------------
+// The little the engine needs from the operating system
+// outside of its window.  On Windows this is Windows.h, plus
+// a few helpers.  Everywhere else the handful of Windows types
+// the engine passes around are defined here, so the game can
+// be built and run headless (on the null render device) with
+// nothing but a C++ compiler and DirectXMath.
+//
+// The window, the swap chain and the DirectX backend are the
+// only parts that need the real Windows SDK, and they're only
+// built on Windows.
+// --------------------------------------------------------
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <cstdint>
+#include <cstdio>
+#include <sys/stat.h>
+
+typedef long HRESULT;
+typedef void* HINSTANCE;
+typedef uintptr_t WPARAM;
+typedef const wchar_t* LPCWSTR;
+
+#define S_OK			((HRESULT)0)
+#define E_FAIL			((HRESULT)0x80004005L)
+#define SUCCEEDED(hr)	(((HRESULT)(hr)) >= 0)
+#define FAILED(hr)		(((HRESULT)(hr)) < 0)
+
+struct POINT
+{
+	long x;
+	long y;
+};
+
+// Virtual key codes that aren't just the key's character
+#define VK_ESCAPE 0x1B
+
+// Only ever used to read numbers, where it's the same as sscanf
+#define sscanf_s sscanf
+#endif
+
+// --------------------------------------------------------
+// Whether a key (a virtual key code, or an upper case letter)
+// is held down right now.  Always false off Windows, where
+// there's no window to have the keyboard.
+// --------------------------------------------------------
+inline bool IsKeyDown(int virtualKey)
+{
+#ifdef _WIN32
+	return (GetAsyncKeyState(virtualKey) & 0x8000) != 0;
+#else
+	return false;
+#endif
+}
+
+// --------------------------------------------------------
+// Shader files are named with wide strings.  Windows' file
+// streams take those as they are, but everywhere else only
+// takes narrow paths, so they're passed through this first.
+// Paths are plain ASCII, so there's nothing to convert.
+// --------------------------------------------------------
+#ifdef _WIN32
+inline const std::wstring& GetFileStreamPath(const std::wstring& path) { return path; }
+#else
+inline std::string GetFileStreamPath(const std::wstring& path) { return std::string(path.begin(), path.end()); }
+#endif
+
+// Makes a directory (but not its parents), doing nothing if it's already there
+inline void MakeDirectory(const std::wstring& path)
+{
+#ifdef _WIN32
+	CreateDirectoryW(path.c_str(), 0);
+#else
+	mkdir(GetFileStreamPath(path).c_str(), 0755);
+#endif
+}
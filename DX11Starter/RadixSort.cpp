@@ -0,0 +1,201 @@
+#include "RadixSort.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstring>
+
+namespace
+{
+	// Below this many packets per thread the cost of starting threads outweighs the gain
+	const size_t MinPacketsPerThread = 16384;
+
+	// --------------------------------------------------------
+	// Reusable barrier so every thread finishes a phase of the
+	// sort before any thread starts the next one
+	// --------------------------------------------------------
+	class SortBarrier
+	{
+	public:
+		SortBarrier(unsigned int threadCount)
+		{
+			this->threadCount = threadCount;
+			waiting = 0;
+			generation = 0;
+		}
+
+		void Wait()
+		{
+			if (threadCount == 1)
+				return;
+
+			std::unique_lock<std::mutex> lock(mutex);
+			unsigned int myGeneration = generation;
+			if (++waiting == threadCount)
+			{
+				// Last one in releases everybody
+				waiting = 0;
+				generation++;
+				condition.notify_all();
+			}
+			else
+			{
+				condition.wait(lock, [&] { return generation != myGeneration; });
+			}
+		}
+
+	private:
+		std::mutex mutex;
+		std::condition_variable condition;
+		unsigned int threadCount;
+		unsigned int waiting;
+		unsigned int generation;
+	};
+
+	// Shared state for all threads taking part in one sort
+	struct SortJob
+	{
+		DrawPacket* Packets;
+		DrawPacket* Scratch;
+		size_t Count;
+		unsigned int ThreadCount;
+		std::vector<size_t> Histograms; // [thread][byte][bucket]
+		SortBarrier* Barrier;
+		int PassesRun;
+	};
+
+	inline size_t* Histogram(SortJob& job, unsigned int thread, unsigned int byte)
+	{
+		return &job.Histograms[(thread * 8 + byte) * 256];
+	}
+
+	// --------------------------------------------------------
+	// Work done by a single thread - it owns one contiguous
+	// chunk of the input for every pass, which keeps the sort stable
+	// --------------------------------------------------------
+	void SortWorker(SortJob& job, unsigned int thread)
+	{
+		size_t begin = job.Count * thread / job.ThreadCount;
+		size_t end = job.Count * (thread + 1) / job.ThreadCount;
+
+		// Count every byte of every key in our chunk in a single read
+		for (size_t i = begin; i < end; i++)
+		{
+			unsigned long long key = job.Packets[i].Key;
+			for (unsigned int byte = 0; byte < 8; byte++)
+				Histogram(job, thread, byte)[(key >> (byte * 8)) & 0xFF]++;
+		}
+		job.Barrier->Wait();
+
+		// A byte position where every key lands in the same bucket doesn't change the order
+		bool skip[8];
+		for (unsigned int byte = 0; byte < 8; byte++)
+		{
+			skip[byte] = false;
+			for (unsigned int bucket = 0; bucket < 256 && !skip[byte]; bucket++)
+			{
+				size_t total = 0;
+				for (unsigned int t = 0; t < job.ThreadCount; t++)
+					total += Histogram(job, t, byte)[bucket];
+				skip[byte] = (total == job.Count);
+			}
+		}
+
+		DrawPacket* source = job.Packets;
+		DrawPacket* destination = job.Scratch;
+		bool firstPass = true;
+		int passesRun = 0;
+
+		for (unsigned int byte = 0; byte < 8; byte++)
+		{
+			if (skip[byte])
+				continue;
+
+			unsigned int shift = byte * 8;
+
+			// After the first pass the chunks hold different packets, so recount this byte
+			if (!firstPass)
+			{
+				size_t* histogram = Histogram(job, thread, byte);
+				memset(histogram, 0, sizeof(size_t) * 256);
+				for (size_t i = begin; i < end; i++)
+					histogram[(source[i].Key >> shift) & 0xFF]++;
+				job.Barrier->Wait();
+			}
+			firstPass = false;
+
+			// Where each bucket starts for this thread: every packet in a smaller bucket,
+			// plus every packet in the same bucket owned by an earlier thread
+			size_t offsets[256];
+			size_t runningTotal = 0;
+			for (unsigned int bucket = 0; bucket < 256; bucket++)
+			{
+				size_t before = 0;
+				size_t total = 0;
+				for (unsigned int t = 0; t < job.ThreadCount; t++)
+				{
+					size_t amount = Histogram(job, t, byte)[bucket];
+					if (t < thread)
+						before += amount;
+					total += amount;
+				}
+				offsets[bucket] = runningTotal + before;
+				runningTotal += total;
+			}
+
+			// Scatter our chunk into place
+			for (size_t i = begin; i < end; i++)
+			{
+				unsigned int bucket = (source[i].Key >> shift) & 0xFF;
+				destination[offsets[bucket]++] = source[i];
+			}
+			job.Barrier->Wait();
+
+			// Ping-pong between the buffers
+			DrawPacket* temp = source;
+			source = destination;
+			destination = temp;
+			passesRun++;
+		}
+
+		if (thread == 0)
+			job.PassesRun = passesRun;
+	}
+}
+
+void RadixSortPackets(std::vector<DrawPacket>& packets, std::vector<DrawPacket>& scratch, unsigned int threadCount)
+{
+	size_t count = packets.size();
+	if (count < 2)
+		return;
+
+	scratch.resize(count);
+
+	// Don't split the work into pieces too small to be worth a thread
+	size_t maxThreads = count / MinPacketsPerThread;
+	if (maxThreads < 1) maxThreads = 1;
+	if (threadCount > maxThreads) threadCount = (unsigned int)maxThreads;
+	if (threadCount < 1) threadCount = 1;
+
+	SortBarrier barrier(threadCount);
+	SortJob job;
+	job.Packets = &packets[0];
+	job.Scratch = &scratch[0];
+	job.Count = count;
+	job.ThreadCount = threadCount;
+	job.Histograms.assign(threadCount * 8 * 256, 0);
+	job.Barrier = &barrier;
+	job.PassesRun = 0;
+
+	// The calling thread does its share of the work too
+	std::vector<std::thread> threads;
+	for (unsigned int t = 1; t < threadCount; t++)
+		threads.push_back(std::thread(SortWorker, std::ref(job), t));
+	SortWorker(job, 0);
+	for (size_t t = 0; t < threads.size(); t++)
+		threads[t].join();
+
+	// An odd number of passes leaves the sorted result in the scratch buffer
+	if (job.PassesRun % 2 == 1)
+		packets.swap(scratch);
+}
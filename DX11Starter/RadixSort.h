@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vector>
+
+// --------------------------------------------------------
+// A single entry in a render queue - the 64-bit key decides
+// the draw order and the index points back at the entity
+// --------------------------------------------------------
+struct DrawPacket
+{
+	unsigned long long Key;		// Sort key built from a SortKeyLayout
+	unsigned int EntityIndex;	// Index of the entity this packet draws
+};
+
+// --------------------------------------------------------
+// Stable LSD radix sort of draw packets by their 64-bit key
+//
+// packets     - The packets to sort (sorted in place)
+// scratch     - Temporary storage, resized as needed
+// threadCount - Number of threads to split each pass across
+//
+// Byte positions where every key is identical are skipped,
+// so keys that only use a few bits only pay for those passes
+// --------------------------------------------------------
+void RadixSortPackets(std::vector<DrawPacket>& packets, std::vector<DrawPacket>& scratch, unsigned int threadCount);
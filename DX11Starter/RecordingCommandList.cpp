@@ -0,0 +1,449 @@
+#include "RecordingCommandList.h"
+
+#include <cstring>
+
+RecordingCommandList::RecordingCommandList()
+{
+}
+
+RecordingCommandList::~RecordingCommandList()
+{
+}
+
+IRenderContext* RecordingCommandList::GetContext()
+{
+	return this;
+}
+
+void RecordingCommandList::Begin()
+{
+	// Keep the memory around, lists are usually re-recorded every frame
+	commands.clear();
+	pointers.clear();
+	values.clear();
+	bytes.clear();
+}
+
+void RecordingCommandList::End()
+{
+	// Nothing to close - commands are ready as soon as they're added
+}
+
+// --------------------------------------------------------
+// Replays every recorded call into the target, in the order
+// they were recorded.  The pools hold interface pointers as
+// void*, which have the same layout as the typed pointers.
+// --------------------------------------------------------
+void RecordingCommandList::Execute(IRenderContext* target)
+{
+	for (size_t i = 0; i < commands.size(); i++)
+	{
+		const Command& c = commands[i];
+		void* const* ptrs = pointers.empty() ? 0 : &pointers[0] + c.FirstPointer;
+		const unsigned int* vals = values.empty() ? 0 : &values[0] + c.FirstValue;
+
+		switch (c.Type)
+		{
+		case COMMAND_IA_SET_INPUT_LAYOUT:
+			target->IASetInputLayout((ID3D11InputLayout*)c.Object);
+			break;
+		case COMMAND_IA_SET_PRIMITIVE_TOPOLOGY:
+			target->IASetPrimitiveTopology(c.Args[0]);
+			break;
+		case COMMAND_IA_SET_VERTEX_BUFFERS:
+			target->IASetVertexBuffers(c.Args[0], c.Args[1], (ID3D11Buffer* const*)ptrs, vals, vals + c.Args[1]);
+			break;
+		case COMMAND_IA_SET_INDEX_BUFFER:
+			target->IASetIndexBuffer((ID3D11Buffer*)c.Object, c.Args[0], c.Args[1]);
+			break;
+		case COMMAND_VS_SET_SHADER:
+			target->VSSetShader((ID3D11VertexShader*)c.Object);
+			break;
+		case COMMAND_VS_SET_CONSTANT_BUFFERS:
+			target->VSSetConstantBuffers(c.Args[0], c.Args[1], (ID3D11Buffer* const*)ptrs);
+			break;
+		case COMMAND_VS_SET_CONSTANT_BUFFERS1:
+			target->VSSetConstantBuffers1(c.Args[0], c.Args[1], (ID3D11Buffer* const*)ptrs, vals, vals + c.Args[1]);
+			break;
+		case COMMAND_VS_SET_SHADER_RESOURCES:
+			target->VSSetShaderResources(c.Args[0], c.Args[1], (ID3D11ShaderResourceView* const*)ptrs);
+			break;
+		case COMMAND_VS_SET_SAMPLERS:
+			target->VSSetSamplers(c.Args[0], c.Args[1], (ID3D11SamplerState* const*)ptrs);
+			break;
+		case COMMAND_PS_SET_SHADER:
+			target->PSSetShader((ID3D11PixelShader*)c.Object);
+			break;
+		case COMMAND_PS_SET_CONSTANT_BUFFERS:
+			target->PSSetConstantBuffers(c.Args[0], c.Args[1], (ID3D11Buffer* const*)ptrs);
+			break;
+		case COMMAND_PS_SET_CONSTANT_BUFFERS1:
+			target->PSSetConstantBuffers1(c.Args[0], c.Args[1], (ID3D11Buffer* const*)ptrs, vals, vals + c.Args[1]);
+			break;
+		case COMMAND_PS_SET_SHADER_RESOURCES:
+			target->PSSetShaderResources(c.Args[0], c.Args[1], (ID3D11ShaderResourceView* const*)ptrs);
+			break;
+		case COMMAND_PS_SET_SAMPLERS:
+			target->PSSetSamplers(c.Args[0], c.Args[1], (ID3D11SamplerState* const*)ptrs);
+			break;
+		case COMMAND_OM_SET_RENDER_TARGETS:
+			target->OMSetRenderTargets(c.Args[0], (ID3D11RenderTargetView* const*)ptrs, (ID3D11DepthStencilView*)c.Object);
+			break;
+		case COMMAND_RS_SET_VIEWPORT:
+			target->RSSetViewport(c.Floats[0], c.Floats[1], c.Floats[2], c.Floats[3], c.Floats[4], c.Floats[5]);
+			break;
+		case COMMAND_RS_SET_STATE:
+			target->RSSetState((ID3D11RasterizerState*)c.Object);
+			break;
+		case COMMAND_OM_SET_BLEND_STATE:
+			target->OMSetBlendState((ID3D11BlendState*)c.Object);
+			break;
+		case COMMAND_OM_SET_DEPTH_STENCIL_STATE:
+			target->OMSetDepthStencilState((ID3D11DepthStencilState*)c.Object, c.Args[0]);
+			break;
+		case COMMAND_CLEAR_RENDER_TARGET_VIEW:
+			target->ClearRenderTargetView((ID3D11RenderTargetView*)c.Object, c.Floats);
+			break;
+		case COMMAND_CLEAR_DEPTH_STENCIL_VIEW:
+			target->ClearDepthStencilView((ID3D11DepthStencilView*)c.Object, c.Floats[0], (unsigned char)c.Args[0]);
+			break;
+		case COMMAND_UPDATE_SUBRESOURCE:
+			target->UpdateSubresource((ID3D11Buffer*)c.Object, bytes.empty() ? 0 : &bytes[0] + c.FirstByte, c.Args[0]);
+			break;
+		case COMMAND_UPDATE_SUBRESOURCE_RANGE:
+			target->UpdateSubresourceRange((ID3D11Buffer*)c.Object, c.Args[1], bytes.empty() ? 0 : &bytes[0] + c.FirstByte, c.Args[0]);
+			break;
+		case COMMAND_UPDATE_TEXTURE_REGION:
+			target->UpdateTextureRegion((ID3D11ShaderResourceView*)c.Object, c.Args[0], c.Args[1], c.Args[2], c.Args[3], c.Args[4], bytes.empty() ? 0 : &bytes[0] + c.FirstByte, vals[0]);
+			break;
+		case COMMAND_SET_RESOURCE_MIN_LOD:
+			target->SetResourceMinLOD((ID3D11ShaderResourceView*)c.Object, c.Floats[0]);
+			break;
+		case COMMAND_COPY_BUFFER_REGION:
+			target->CopyBufferRegion((ID3D11Buffer*)c.Object, c.Args[0], (ID3D11Buffer*)ptrs[0], c.Args[1], c.Args[2]);
+			break;
+		case COMMAND_DRAW_INDEXED:
+			target->DrawIndexed(c.Args[0], c.Args[1], c.SignedArg);
+			break;
+		case COMMAND_DRAW_INDEXED_INSTANCED:
+			target->DrawIndexedInstanced(c.Args[0], c.Args[1], c.Args[2], c.SignedArg, c.Args[3]);
+			break;
+		case COMMAND_EXECUTE_COMMAND_LIST:
+			target->ExecuteCommandList((ID3D11CommandList*)c.Object);
+			break;
+		}
+	}
+}
+
+unsigned int RecordingCommandList::GetCommandCount()
+{
+	return (unsigned int)commands.size();
+}
+
+RecordingCommandList::CommandType RecordingCommandList::GetCommandType(unsigned int index)
+{
+	return commands[index].Type;
+}
+
+void RecordingCommandList::IASetInputLayout(ID3D11InputLayout* inputLayout)
+{
+	Add(COMMAND_IA_SET_INPUT_LAYOUT, inputLayout);
+}
+
+void RecordingCommandList::IASetPrimitiveTopology(unsigned int topology)
+{
+	Command& c = Add(COMMAND_IA_SET_PRIMITIVE_TOPOLOGY, 0);
+	c.Args[0] = topology;
+}
+
+void RecordingCommandList::IASetVertexBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* strides, const unsigned int* offsets)
+{
+	Command& c = Add(COMMAND_IA_SET_VERTEX_BUFFERS, 0);
+	c.Args[0] = startSlot;
+	c.Args[1] = numBuffers;
+	AddPointers(c, (const void* const*)buffers, numBuffers);
+
+	// Strides then offsets, back to back
+	AddValues(c, strides, numBuffers);
+	unsigned int firstValue = c.FirstValue;
+	AddValues(c, offsets, numBuffers);
+	c.FirstValue = firstValue;
+}
+
+void RecordingCommandList::IASetIndexBuffer(ID3D11Buffer* indexBuffer, unsigned int format, unsigned int offset)
+{
+	Command& c = Add(COMMAND_IA_SET_INDEX_BUFFER, indexBuffer);
+	c.Args[0] = format;
+	c.Args[1] = offset;
+}
+
+void RecordingCommandList::VSSetShader(ID3D11VertexShader* shader)
+{
+	Add(COMMAND_VS_SET_SHADER, shader);
+}
+
+void RecordingCommandList::VSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers)
+{
+	Command& c = Add(COMMAND_VS_SET_CONSTANT_BUFFERS, 0);
+	c.Args[0] = startSlot;
+	c.Args[1] = numBuffers;
+	AddPointers(c, (const void* const*)buffers, numBuffers);
+}
+
+void RecordingCommandList::VSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants)
+{
+	Command& c = Add(COMMAND_VS_SET_CONSTANT_BUFFERS1, 0);
+	c.Args[0] = startSlot;
+	c.Args[1] = numBuffers;
+	AddPointers(c, (const void* const*)buffers, numBuffers);
+
+	// First constants then counts, back to back
+	AddValues(c, firstConstants, numBuffers);
+	AddValues(c, numConstants, numBuffers);
+}
+
+void RecordingCommandList::VSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views)
+{
+	Command& c = Add(COMMAND_VS_SET_SHADER_RESOURCES, 0);
+	c.Args[0] = startSlot;
+	c.Args[1] = numViews;
+	AddPointers(c, (const void* const*)views, numViews);
+}
+
+void RecordingCommandList::VSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers)
+{
+	Command& c = Add(COMMAND_VS_SET_SAMPLERS, 0);
+	c.Args[0] = startSlot;
+	c.Args[1] = numSamplers;
+	AddPointers(c, (const void* const*)samplers, numSamplers);
+}
+
+void RecordingCommandList::PSSetShader(ID3D11PixelShader* shader)
+{
+	Add(COMMAND_PS_SET_SHADER, shader);
+}
+
+void RecordingCommandList::PSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers)
+{
+	Command& c = Add(COMMAND_PS_SET_CONSTANT_BUFFERS, 0);
+	c.Args[0] = startSlot;
+	c.Args[1] = numBuffers;
+	AddPointers(c, (const void* const*)buffers, numBuffers);
+}
+
+void RecordingCommandList::PSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants)
+{
+	Command& c = Add(COMMAND_PS_SET_CONSTANT_BUFFERS1, 0);
+	c.Args[0] = startSlot;
+	c.Args[1] = numBuffers;
+	AddPointers(c, (const void* const*)buffers, numBuffers);
+
+	// First constants then counts, back to back
+	AddValues(c, firstConstants, numBuffers);
+	AddValues(c, numConstants, numBuffers);
+}
+
+void RecordingCommandList::PSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views)
+{
+	Command& c = Add(COMMAND_PS_SET_SHADER_RESOURCES, 0);
+	c.Args[0] = startSlot;
+	c.Args[1] = numViews;
+	AddPointers(c, (const void* const*)views, numViews);
+}
+
+void RecordingCommandList::PSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers)
+{
+	Command& c = Add(COMMAND_PS_SET_SAMPLERS, 0);
+	c.Args[0] = startSlot;
+	c.Args[1] = numSamplers;
+	AddPointers(c, (const void* const*)samplers, numSamplers);
+}
+
+void RecordingCommandList::OMSetRenderTargets(unsigned int numViews, ID3D11RenderTargetView* const* renderTargetViews, ID3D11DepthStencilView* depthStencilView)
+{
+	Command& c = Add(COMMAND_OM_SET_RENDER_TARGETS, depthStencilView);
+	c.Args[0] = numViews;
+	AddPointers(c, (const void* const*)renderTargetViews, numViews);
+}
+
+void RecordingCommandList::RSSetViewport(float topLeftX, float topLeftY, float width, float height, float minDepth, float maxDepth)
+{
+	Command& c = Add(COMMAND_RS_SET_VIEWPORT, 0);
+	c.Floats[0] = topLeftX;
+	c.Floats[1] = topLeftY;
+	c.Floats[2] = width;
+	c.Floats[3] = height;
+	c.Floats[4] = minDepth;
+	c.Floats[5] = maxDepth;
+}
+
+void RecordingCommandList::RSSetState(ID3D11RasterizerState* rasterizerState)
+{
+	Add(COMMAND_RS_SET_STATE, rasterizerState);
+}
+
+void RecordingCommandList::OMSetBlendState(ID3D11BlendState* blendState)
+{
+	Add(COMMAND_OM_SET_BLEND_STATE, blendState);
+}
+
+void RecordingCommandList::OMSetDepthStencilState(ID3D11DepthStencilState* depthStencilState, unsigned int stencilRef)
+{
+	Command& c = Add(COMMAND_OM_SET_DEPTH_STENCIL_STATE, depthStencilState);
+	c.Args[0] = stencilRef;
+}
+
+void RecordingCommandList::ClearRenderTargetView(ID3D11RenderTargetView* renderTargetView, const float color[4])
+{
+	Command& c = Add(COMMAND_CLEAR_RENDER_TARGET_VIEW, renderTargetView);
+	for (int i = 0; i < 4; i++)
+		c.Floats[i] = color[i];
+}
+
+void RecordingCommandList::ClearDepthStencilView(ID3D11DepthStencilView* depthStencilView, float depth, unsigned char stencil)
+{
+	Command& c = Add(COMMAND_CLEAR_DEPTH_STENCIL_VIEW, depthStencilView);
+	c.Floats[0] = depth;
+	c.Args[0] = stencil;
+}
+
+// --------------------------------------------------------
+// The data is copied now, since the caller is free to change
+// it before the list is played back
+// --------------------------------------------------------
+void RecordingCommandList::UpdateSubresource(ID3D11Buffer* buffer, const void* data, unsigned int byteSize)
+{
+	Command& c = Add(COMMAND_UPDATE_SUBRESOURCE, buffer);
+	c.Args[0] = byteSize;
+	c.FirstByte = (unsigned int)bytes.size();
+	bytes.resize(bytes.size() + byteSize);
+	if (byteSize > 0)
+		memcpy(&bytes[c.FirstByte], data, byteSize);
+}
+
+void RecordingCommandList::UpdateSubresourceRange(ID3D11Buffer* buffer, unsigned int byteOffset, const void* data, unsigned int byteSize)
+{
+	Command& c = Add(COMMAND_UPDATE_SUBRESOURCE_RANGE, buffer);
+	c.Args[0] = byteSize;
+	c.Args[1] = byteOffset;
+	c.FirstByte = (unsigned int)bytes.size();
+	bytes.resize(bytes.size() + byteSize);
+	if (byteSize > 0)
+		memcpy(&bytes[c.FirstByte], data, byteSize);
+}
+
+// The rows are copied now, packed at the same pitch
+void RecordingCommandList::UpdateTextureRegion(ID3D11ShaderResourceView* texture, unsigned int mipLevel, unsigned int left, unsigned int top, unsigned int width, unsigned int height, const void* data, unsigned int rowPitch)
+{
+	Command& c = Add(COMMAND_UPDATE_TEXTURE_REGION, texture);
+	c.Args[0] = mipLevel;
+	c.Args[1] = left;
+	c.Args[2] = top;
+	c.Args[3] = width;
+	c.Args[4] = height;
+	AddValues(c, &rowPitch, 1);
+
+	unsigned int byteSize = rowPitch * height;
+	c.FirstByte = (unsigned int)bytes.size();
+	bytes.resize(bytes.size() + byteSize);
+	if (byteSize > 0)
+		memcpy(&bytes[c.FirstByte], data, byteSize);
+}
+
+void RecordingCommandList::SetResourceMinLOD(ID3D11ShaderResourceView* texture, float minLOD)
+{
+	Command& c = Add(COMMAND_SET_RESOURCE_MIN_LOD, texture);
+	c.Floats[0] = minLOD;
+}
+
+void RecordingCommandList::CopyBufferRegion(ID3D11Buffer* destination, unsigned int destinationOffset, ID3D11Buffer* source, unsigned int sourceOffset, unsigned int byteSize)
+{
+	Command& c = Add(COMMAND_COPY_BUFFER_REGION, destination);
+	c.Args[0] = destinationOffset;
+	c.Args[1] = sourceOffset;
+	c.Args[2] = byteSize;
+	const void* sourcePointer = source;
+	AddPointers(c, &sourcePointer, 1);
+}
+
+// --------------------------------------------------------
+// A map can't be deferred (the caller writes through the
+// pointer right away), so buffers must be mapped on the
+// thread that owns the real context instead
+// --------------------------------------------------------
+void* RecordingCommandList::MapDiscard(ID3D11Buffer* buffer)
+{
+	return 0;
+}
+
+void* RecordingCommandList::MapNoOverwrite(ID3D11Buffer* buffer)
+{
+	return 0;
+}
+
+void* RecordingCommandList::MapStaging(ID3D11Buffer* buffer)
+{
+	return 0;
+}
+
+void RecordingCommandList::Unmap(ID3D11Buffer* buffer)
+{
+}
+
+// --------------------------------------------------------
+// Ranged binds are stored like any other call.  It's up to
+// whoever plays the list back to only do so into a context
+// that supports them.
+// --------------------------------------------------------
+bool RecordingCommandList::SupportsConstantBufferOffsets()
+{
+	return true;
+}
+
+void RecordingCommandList::DrawIndexed(unsigned int indexCount, unsigned int startIndexLocation, int baseVertexLocation)
+{
+	Command& c = Add(COMMAND_DRAW_INDEXED, 0);
+	c.Args[0] = indexCount;
+	c.Args[1] = startIndexLocation;
+	c.SignedArg = baseVertexLocation;
+}
+
+void RecordingCommandList::DrawIndexedInstanced(unsigned int indexCountPerInstance, unsigned int instanceCount, unsigned int startIndexLocation, int baseVertexLocation, unsigned int startInstanceLocation)
+{
+	Command& c = Add(COMMAND_DRAW_INDEXED_INSTANCED, 0);
+	c.Args[0] = indexCountPerInstance;
+	c.Args[1] = instanceCount;
+	c.Args[2] = startIndexLocation;
+	c.Args[3] = startInstanceLocation;
+	c.SignedArg = baseVertexLocation;
+}
+
+void RecordingCommandList::ExecuteCommandList(ID3D11CommandList* commandList)
+{
+	Add(COMMAND_EXECUTE_COMMAND_LIST, commandList);
+}
+
+RecordingCommandList::Command& RecordingCommandList::Add(CommandType type, void* object)
+{
+	Command c = {};
+	c.Type = type;
+	c.Object = object;
+	c.FirstPointer = (unsigned int)pointers.size();
+	c.FirstValue = (unsigned int)values.size();
+	c.FirstByte = (unsigned int)bytes.size();
+	commands.push_back(c);
+	return commands.back();
+}
+
+void RecordingCommandList::AddPointers(Command& command, const void* const* pointers, unsigned int count)
+{
+	command.FirstPointer = (unsigned int)this->pointers.size();
+	for (unsigned int i = 0; i < count; i++)
+		this->pointers.push_back((void*)pointers[i]);
+}
+
+void RecordingCommandList::AddValues(Command& command, const unsigned int* values, unsigned int count)
+{
+	command.FirstValue = (unsigned int)this->values.size();
+	this->values.insert(this->values.end(), values, values + count);
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <vector>
+#include "CommandList.h"
+
+// --------------------------------------------------------
+// Software command list that stores every call (and copies
+// of any arrays or data passed in) and replays them through
+// another render context.  It needs no GPU, so it works as a
+// fallback and for checking what was recorded.
+// --------------------------------------------------------
+class RecordingCommandList : public ICommandList, private IRenderContext
+{
+public:
+	// Every call that can be recorded
+	enum CommandType
+	{
+		COMMAND_IA_SET_INPUT_LAYOUT,
+		COMMAND_IA_SET_PRIMITIVE_TOPOLOGY,
+		COMMAND_IA_SET_VERTEX_BUFFERS,
+		COMMAND_IA_SET_INDEX_BUFFER,
+		COMMAND_VS_SET_SHADER,
+		COMMAND_VS_SET_CONSTANT_BUFFERS,
+		COMMAND_VS_SET_CONSTANT_BUFFERS1,
+		COMMAND_VS_SET_SHADER_RESOURCES,
+		COMMAND_VS_SET_SAMPLERS,
+		COMMAND_PS_SET_SHADER,
+		COMMAND_PS_SET_CONSTANT_BUFFERS,
+		COMMAND_PS_SET_CONSTANT_BUFFERS1,
+		COMMAND_PS_SET_SHADER_RESOURCES,
+		COMMAND_PS_SET_SAMPLERS,
+		COMMAND_OM_SET_RENDER_TARGETS,
+		COMMAND_RS_SET_VIEWPORT,
+		COMMAND_RS_SET_STATE,
+		COMMAND_OM_SET_BLEND_STATE,
+		COMMAND_OM_SET_DEPTH_STENCIL_STATE,
+		COMMAND_CLEAR_RENDER_TARGET_VIEW,
+		COMMAND_CLEAR_DEPTH_STENCIL_VIEW,
+		COMMAND_UPDATE_SUBRESOURCE,
+		COMMAND_UPDATE_SUBRESOURCE_RANGE,
+		COMMAND_UPDATE_TEXTURE_REGION,
+		COMMAND_SET_RESOURCE_MIN_LOD,
+		COMMAND_COPY_BUFFER_REGION,
+		COMMAND_DRAW_INDEXED,
+		COMMAND_DRAW_INDEXED_INSTANCED,
+		COMMAND_EXECUTE_COMMAND_LIST
+	};
+
+	RecordingCommandList(); // Constructor
+	~RecordingCommandList(); // Destructor
+
+	// ICommandList
+	IRenderContext* GetContext();
+	void Begin();
+	void End();
+	void Execute(IRenderContext* target);
+	bool ReplaysIntoTarget() { return true; }
+
+	// Inspecting what was recorded
+	unsigned int GetCommandCount();
+	CommandType GetCommandType(unsigned int index);
+
+private:
+	// One recorded call.  Fixed size arguments live here, while
+	// arrays and raw data are copied into the shared pools below.
+	struct Command
+	{
+		CommandType Type;
+		void* Object;				// The buffer, shader, layout, state or list being set
+		unsigned int Args[5];		// Slots, counts, formats, offsets...
+		int SignedArg;				// Base vertex location
+		float Floats[6];			// Viewport, clear color or depth
+		unsigned int FirstPointer;	// Start of this call's arrays in the pointer pool
+		unsigned int FirstValue;	// Start of this call's arrays in the value pool
+		unsigned int FirstByte;		// Start of this call's data in the byte pool
+	};
+
+	// IRenderContext - only reachable through GetContext()
+	void IASetInputLayout(ID3D11InputLayout* inputLayout);
+	void IASetPrimitiveTopology(unsigned int topology);
+	void IASetVertexBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* strides, const unsigned int* offsets);
+	void IASetIndexBuffer(ID3D11Buffer* indexBuffer, unsigned int format, unsigned int offset);
+	void VSSetShader(ID3D11VertexShader* shader);
+	void VSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers);
+	void VSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views);
+	void VSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers);
+	void PSSetShader(ID3D11PixelShader* shader);
+	void PSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers);
+	void PSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views);
+	void PSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers);
+	void OMSetRenderTargets(unsigned int numViews, ID3D11RenderTargetView* const* renderTargetViews, ID3D11DepthStencilView* depthStencilView);
+	void RSSetViewport(float topLeftX, float topLeftY, float width, float height, float minDepth, float maxDepth);
+	void RSSetState(ID3D11RasterizerState* rasterizerState);
+	void OMSetBlendState(ID3D11BlendState* blendState);
+	void OMSetDepthStencilState(ID3D11DepthStencilState* depthStencilState, unsigned int stencilRef);
+	void ClearRenderTargetView(ID3D11RenderTargetView* renderTargetView, const float color[4]);
+	void ClearDepthStencilView(ID3D11DepthStencilView* depthStencilView, float depth, unsigned char stencil);
+	void UpdateSubresource(ID3D11Buffer* buffer, const void* data, unsigned int byteSize);
+	void UpdateSubresourceRange(ID3D11Buffer* buffer, unsigned int byteOffset, const void* data, unsigned int byteSize);
+	void UpdateTextureRegion(ID3D11ShaderResourceView* texture, unsigned int mipLevel, unsigned int left, unsigned int top, unsigned int width, unsigned int height, const void* data, unsigned int rowPitch);
+	void SetResourceMinLOD(ID3D11ShaderResourceView* texture, float minLOD);
+	void CopyBufferRegion(ID3D11Buffer* destination, unsigned int destinationOffset, ID3D11Buffer* source, unsigned int sourceOffset, unsigned int byteSize);
+	void* MapDiscard(ID3D11Buffer* buffer);
+	void* MapNoOverwrite(ID3D11Buffer* buffer);
+	void* MapStaging(ID3D11Buffer* buffer);
+	void Unmap(ID3D11Buffer* buffer);
+	bool SupportsConstantBufferOffsets();
+	void VSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants);
+	void PSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants);
+	void DrawIndexed(unsigned int indexCount, unsigned int startIndexLocation, int baseVertexLocation);
+	void DrawIndexedInstanced(unsigned int indexCountPerInstance, unsigned int instanceCount, unsigned int startIndexLocation, int baseVertexLocation, unsigned int startInstanceLocation);
+	void ExecuteCommandList(ID3D11CommandList* commandList);
+
+	// Helper methods
+	Command& Add(CommandType type, void* object);
+	void AddPointers(Command& command, const void* const* pointers, unsigned int count);
+	void AddValues(Command& command, const unsigned int* values, unsigned int count);
+
+	std::vector<Command> commands;
+	std::vector<void*> pointers;
+	std::vector<unsigned int> values;
+	std::vector<unsigned char> bytes;
+};
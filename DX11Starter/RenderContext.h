@@ -0,0 +1,110 @@
+#pragma once
+
+// --------------------------------------------------------
+// Forward declarations of the DirectX objects a render
+// context passes around.  They're only ever used as pointers
+// here, so this header doesn't need d3d11.h and anything
+// built on top of it can be compiled and tested without it.
+// --------------------------------------------------------
+struct ID3D11Buffer;
+struct ID3D11InputLayout;
+struct ID3D11VertexShader;
+struct ID3D11PixelShader;
+struct ID3D11ShaderResourceView;
+struct ID3D11SamplerState;
+struct ID3D11RasterizerState;
+struct ID3D11BlendState;
+struct ID3D11DepthStencilState;
+struct ID3D11RenderTargetView;
+struct ID3D11DepthStencilView;
+struct ID3D11CommandList;
+
+// --------------------------------------------------------
+// Abstract interface for the pieces of ID3D11DeviceContext
+// the engine uses to draw.  Method names and parameters
+// mirror the DirectX ones so call sites read the same, with
+// enums (topology, formats) passed as plain unsigned ints.
+// --------------------------------------------------------
+class IRenderContext
+{
+public:
+	virtual ~IRenderContext() { }
+
+	// Input assembler
+	virtual void IASetInputLayout(ID3D11InputLayout* inputLayout) = 0;
+	virtual void IASetPrimitiveTopology(unsigned int topology) = 0;
+	virtual void IASetVertexBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* strides, const unsigned int* offsets) = 0;
+	virtual void IASetIndexBuffer(ID3D11Buffer* indexBuffer, unsigned int format, unsigned int offset) = 0;
+
+	// Vertex shader stage
+	virtual void VSSetShader(ID3D11VertexShader* shader) = 0;
+	virtual void VSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers) = 0;
+	virtual void VSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views) = 0;
+	virtual void VSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers) = 0;
+
+	// Pixel shader stage
+	virtual void PSSetShader(ID3D11PixelShader* shader) = 0;
+	virtual void PSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers) = 0;
+	virtual void PSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views) = 0;
+	virtual void PSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers) = 0;
+
+	// Output merger and rasterizer
+	virtual void OMSetRenderTargets(unsigned int numViews, ID3D11RenderTargetView* const* renderTargetViews, ID3D11DepthStencilView* depthStencilView) = 0;
+	virtual void RSSetViewport(float topLeftX, float topLeftY, float width, float height, float minDepth, float maxDepth) = 0;
+	virtual void RSSetState(ID3D11RasterizerState* rasterizerState) = 0;
+
+	// Blend states are set with a zero blend factor and every sample enabled
+	virtual void OMSetBlendState(ID3D11BlendState* blendState) = 0;
+	virtual void OMSetDepthStencilState(ID3D11DepthStencilState* depthStencilState, unsigned int stencilRef) = 0;
+
+	// Clearing.  The depth stencil clear resets both depth and stencil.
+	virtual void ClearRenderTargetView(ID3D11RenderTargetView* renderTargetView, const float color[4]) = 0;
+	virtual void ClearDepthStencilView(ID3D11DepthStencilView* depthStencilView, float depth, unsigned char stencil) = 0;
+
+	// Copies an entire buffer's worth of data from the CPU
+	virtual void UpdateSubresource(ID3D11Buffer* buffer, const void* data, unsigned int byteSize) = 0;
+
+	// Copies into part of a buffer, starting byteOffset bytes in.
+	// Not for constant buffers, which can only be copied whole.
+	virtual void UpdateSubresourceRange(ID3D11Buffer* buffer, unsigned int byteOffset, const void* data, unsigned int byteSize) = 0;
+
+	// Copies a rectangle of texels into one mip of a texture.  Rows
+	// of the data are rowPitch bytes apart.
+	virtual void UpdateTextureRegion(ID3D11ShaderResourceView* texture, unsigned int mipLevel, unsigned int left, unsigned int top, unsigned int width, unsigned int height, const void* data, unsigned int rowPitch) = 0;
+
+	// Stops a texture being sampled at any mip finer than minLOD, so
+	// mips that haven't been filled in yet are never read
+	virtual void SetResourceMinLOD(ID3D11ShaderResourceView* texture, float minLOD) = 0;
+
+	// GPU side copy between buffers (usually out of a staging buffer)
+	virtual void CopyBufferRegion(ID3D11Buffer* destination, unsigned int destinationOffset, ID3D11Buffer* source, unsigned int sourceOffset, unsigned int byteSize) = 0;
+
+	// Maps a dynamic buffer for writing, throwing away its old contents.
+	// Returns null if the buffer couldn't be mapped.
+	virtual void* MapDiscard(ID3D11Buffer* buffer) = 0;
+
+	// Maps a dynamic buffer for writing while the GPU may still be reading
+	// it.  The caller promises not to touch anything that's still in use.
+	virtual void* MapNoOverwrite(ID3D11Buffer* buffer) = 0;
+
+	// Maps a staging buffer for writing.  Waits for the GPU if it's still
+	// copying out of the buffer, so only map ones it's finished with.
+	virtual void* MapStaging(ID3D11Buffer* buffer) = 0;
+	virtual void Unmap(ID3D11Buffer* buffer) = 0;
+
+	// Binding part of a constant buffer (DirectX 11.1).  Offsets and sizes
+	// are counted in 16 byte constants and must be multiples of 16.  Only
+	// use these (and MapNoOverwrite on constant buffers) if the context
+	// says it supports them.
+	virtual bool SupportsConstantBufferOffsets() = 0;
+	virtual void VSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants) = 0;
+	virtual void PSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants) = 0;
+
+	// Drawing
+	virtual void DrawIndexed(unsigned int indexCount, unsigned int startIndexLocation, int baseVertexLocation) = 0;
+	virtual void DrawIndexedInstanced(unsigned int indexCountPerInstance, unsigned int instanceCount, unsigned int startIndexLocation, int baseVertexLocation, unsigned int startInstanceLocation) = 0;
+
+	// Plays back a DirectX command list recorded on a deferred context.
+	// Everything bound on this context is reset to defaults afterwards.
+	virtual void ExecuteCommandList(ID3D11CommandList* commandList) = 0;
+};
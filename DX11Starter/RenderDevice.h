@@ -0,0 +1,245 @@
+#pragma once
+
+#include <cstddef>
+#include "RenderContext.h"
+#include "RenderStats.h"
+
+class ICommandList;
+
+// --------------------------------------------------------
+// How a buffer will be used, which decides where it lives
+// and whether the CPU can write to it after creation
+// --------------------------------------------------------
+enum BufferUsage
+{
+	BUFFER_USAGE_DEFAULT,	// GPU memory, updated with UpdateSubresource
+	BUFFER_USAGE_IMMUTABLE,	// Written once at creation and never again
+	BUFFER_USAGE_DYNAMIC,	// Rewritten by the CPU through MapDiscard
+	BUFFER_USAGE_STAGING	// CPU memory written through MapStaging and copied into other buffers
+};
+
+// --------------------------------------------------------
+// What a buffer can be bound as.  These can be combined.
+// --------------------------------------------------------
+enum BufferBindFlags
+{
+	BUFFER_BIND_VERTEX = 1,
+	BUFFER_BIND_INDEX = 2,
+	BUFFER_BIND_CONSTANT = 4,
+	BUFFER_BIND_SHADER_RESOURCE = 8	// With a stride, a structured buffer
+};
+
+struct BufferDesc
+{
+	unsigned int ByteWidth;
+	BufferUsage Usage;
+	unsigned int BindFlags;				// BufferBindFlags
+	unsigned int StructureByteStride;	// Only for structured buffers
+};
+
+// --------------------------------------------------------
+// A 2D texture that shaders can sample.  Formats are DXGI
+// format values passed as plain unsigned ints.
+// --------------------------------------------------------
+struct TextureDesc
+{
+	unsigned int Width;
+	unsigned int Height;
+	unsigned int MipLevels;	// 0 for a full mip chain
+	unsigned int Format;
+};
+
+// --------------------------------------------------------
+// What a texture that's rendered into can be bound as.
+// These can be combined.
+// --------------------------------------------------------
+enum TextureBindFlags
+{
+	TEXTURE_BIND_SHADER_RESOURCE = 1,
+	TEXTURE_BIND_RENDER_TARGET = 2,
+	TEXTURE_BIND_DEPTH_STENCIL = 4
+};
+
+// --------------------------------------------------------
+// A texture the GPU renders into, with no mips.  Depth
+// formats are given as the depth stencil view's format.
+// --------------------------------------------------------
+struct RenderTextureDesc
+{
+	unsigned int Width;
+	unsigned int Height;
+	unsigned int Format;
+	unsigned int BindFlags;	// TextureBindFlags
+};
+
+// --------------------------------------------------------
+// The views of a render texture.  Views it wasn't created
+// with are null.  Each view holds its own reference to the
+// texture, so there's no texture pointer to keep around.
+// --------------------------------------------------------
+struct RenderTexture
+{
+	ID3D11RenderTargetView* RenderTargetView;
+	ID3D11DepthStencilView* DepthStencilView;
+	ID3D11ShaderResourceView* ShaderResourceView;
+};
+
+enum SamplerFilter
+{
+	SAMPLER_FILTER_POINT,
+	SAMPLER_FILTER_LINEAR,		// Trilinear
+	SAMPLER_FILTER_ANISOTROPIC
+};
+
+enum SamplerAddressMode
+{
+	SAMPLER_ADDRESS_WRAP,
+	SAMPLER_ADDRESS_CLAMP
+};
+
+struct SamplerDesc
+{
+	SamplerFilter Filter;
+	SamplerAddressMode AddressMode;	// Used for U, V and W
+	unsigned int MaxAnisotropy;
+};
+
+enum RasterizerFillMode
+{
+	RASTERIZER_FILL_SOLID,
+	RASTERIZER_FILL_WIREFRAME
+};
+
+enum RasterizerCullMode
+{
+	RASTERIZER_CULL_BACK,
+	RASTERIZER_CULL_FRONT,
+	RASTERIZER_CULL_NONE
+};
+
+// --------------------------------------------------------
+// Rasterizer, blend and depth stencil settings.  Each one
+// zeroed out ( = {} ) is the DirectX default, which is why
+// some of the flags turn things off rather than on.
+// --------------------------------------------------------
+struct RasterizerDesc
+{
+	RasterizerFillMode FillMode;
+	RasterizerCullMode CullMode;
+	bool FrontCounterClockwise;
+	int DepthBias;
+	bool DepthClipDisable;
+	bool ScissorEnable;
+};
+
+enum BlendMode
+{
+	BLEND_OPAQUE,
+	BLEND_ALPHA,			// Source alpha over the destination
+	BLEND_PREMULTIPLIED,	// Same, with color already multiplied by alpha
+	BLEND_ADDITIVE
+};
+
+struct BlendDesc
+{
+	BlendMode Mode;
+	bool AlphaToCoverage;
+};
+
+enum DepthFunc
+{
+	DEPTH_FUNC_LESS,
+	DEPTH_FUNC_LESS_EQUAL,
+	DEPTH_FUNC_EQUAL,
+	DEPTH_FUNC_GREATER,
+	DEPTH_FUNC_GREATER_EQUAL,
+	DEPTH_FUNC_ALWAYS
+};
+
+struct DepthStencilDesc
+{
+	bool DepthDisable;		// No depth test or depth writes at all
+	bool DepthWriteDisable;	// Still tests, but leaves the depth buffer alone
+	DepthFunc Func;
+};
+
+// --------------------------------------------------------
+// One element of a vertex shader's input layout, mirroring
+// D3D11_INPUT_ELEMENT_DESC with the enums as unsigned ints
+// --------------------------------------------------------
+struct InputElementDesc
+{
+	const char* SemanticName;
+	unsigned int SemanticIndex;
+	unsigned int Format;
+	unsigned int InputSlot;
+	unsigned int AlignedByteOffset;
+	bool PerInstance;
+	unsigned int InstanceDataStepRate;
+};
+
+// --------------------------------------------------------
+// Abstract interface for creating and releasing the GPU
+// objects the engine uses.  Objects are handed out as the
+// same DirectX pointer types the render contexts bind, but
+// must always be released through the device that made them,
+// since a device may not hand out real DirectX objects at all.
+// --------------------------------------------------------
+class IRenderDevice
+{
+public:
+	virtual ~IRenderDevice() { }
+
+	// The context that draws straight away, owned by the device
+	virtual IRenderContext* GetImmediateContext() = 0;
+
+	// A command list that can be recorded on another thread
+	virtual ICommandList* CreateCommandList() = 0;
+
+	// Object creation.  Each returns null if creation failed.
+	//  - Texture data is the top mip, rowPitch bytes per row.  Any
+	//    further mips are generated from it.
+	virtual ID3D11Buffer* CreateBuffer(const BufferDesc& desc, const void* initialData) = 0;
+	virtual ID3D11ShaderResourceView* CreateTexture2D(const TextureDesc& desc, const void* initialData, unsigned int rowPitch) = 0;
+	virtual ID3D11ShaderResourceView* CreateBufferShaderResourceView(ID3D11Buffer* structuredBuffer, unsigned int elementCount) = 0;
+	virtual ID3D11SamplerState* CreateSamplerState(const SamplerDesc& desc) = 0;
+	virtual ID3D11RasterizerState* CreateRasterizerState(const RasterizerDesc& desc) = 0;
+	virtual ID3D11BlendState* CreateBlendState(const BlendDesc& desc) = 0;
+	virtual ID3D11DepthStencilState* CreateDepthStencilState(const DepthStencilDesc& desc) = 0;
+	virtual ID3D11VertexShader* CreateVertexShader(const void* byteCode, size_t byteCodeSize) = 0;
+	virtual ID3D11PixelShader* CreatePixelShader(const void* byteCode, size_t byteCodeSize) = 0;
+	virtual ID3D11InputLayout* CreateInputLayout(const InputElementDesc* elements, unsigned int elementCount, const void* byteCode, size_t byteCodeSize) = 0;
+
+	// A texture array holding a copy of each texture, every mip, in the
+	// slice with the same index.  Null unless they all have the same shape.
+	virtual ID3D11ShaderResourceView* CreateTexture2DArray(ID3D11ShaderResourceView* const* textures, unsigned int textureCount) = 0;
+
+	// The shape of a 2D texture (or of each slice of an array) made by
+	// this device, with its actual mip count.  False for anything else.
+	virtual bool GetTextureDesc(ID3D11ShaderResourceView* texture, TextureDesc& desc) = 0;
+
+	// Creates a texture to render into and whichever views its bind
+	// flags ask for.  Returns false (with every view null) if it failed.
+	virtual bool CreateRenderTexture(const RenderTextureDesc& desc, RenderTexture& texture) = 0;
+
+	// Buffers can be shared, so they're reference counted
+	virtual void AddRef(ID3D11Buffer* buffer) = 0;
+
+	// Releasing objects.  Passing null does nothing.
+	virtual void Release(ID3D11Buffer* buffer) = 0;
+	virtual void Release(ID3D11ShaderResourceView* shaderResourceView) = 0;
+	virtual void Release(ID3D11SamplerState* samplerState) = 0;
+	virtual void Release(ID3D11RasterizerState* rasterizerState) = 0;
+	virtual void Release(ID3D11BlendState* blendState) = 0;
+	virtual void Release(ID3D11DepthStencilState* depthStencilState) = 0;
+	virtual void Release(ID3D11VertexShader* shader) = 0;
+	virtual void Release(ID3D11PixelShader* shader) = 0;
+	virtual void Release(ID3D11InputLayout* inputLayout) = 0;
+	virtual void Release(ID3D11RenderTargetView* renderTargetView) = 0;
+	virtual void Release(ID3D11DepthStencilView* depthStencilView) = 0;
+
+	// Buffers and textures created (and the initial data uploaded
+	// with them) since the device was made.  Only counted in builds
+	// with ENGINE_RENDER_STATS defined.
+	virtual const RenderStatCounters& GetRenderStats() = 0;
+};
@@ -0,0 +1,239 @@
+#include "RenderQueue.h"
+
+#include <chrono>
+#include <thread>
+
+namespace
+{
+	// Every layout starts with the pass in the top bits so packets from
+	// different passes never interleave and the pass can always be read back
+	const unsigned int PassBits = 2;
+}
+
+RenderQueue::RenderQueue()
+{
+	// Opaque: group by state, then draw front to back to make the most of early depth rejection
+	SortKeyLayout opaque;
+	opaque.Order[0] = SORT_KEY_PASS;
+	opaque.Order[1] = SORT_KEY_SHADER;
+	opaque.Order[2] = SORT_KEY_MATERIAL;
+	opaque.Order[3] = SORT_KEY_MESH;
+	opaque.Order[4] = SORT_KEY_DEPTH;
+	opaque.Bits[SORT_KEY_PASS] = PassBits;
+	opaque.Bits[SORT_KEY_SHADER] = 10;
+	opaque.Bits[SORT_KEY_MATERIAL] = 16;
+	opaque.Bits[SORT_KEY_MESH] = 16;
+	opaque.Bits[SORT_KEY_DEPTH] = 20;
+	opaque.BackToFront = false;
+	SetLayout(RENDER_PASS_OPAQUE, opaque);
+
+	// Transparent: blending needs back to front order, state grouping comes second
+	SortKeyLayout transparent;
+	transparent.Order[0] = SORT_KEY_PASS;
+	transparent.Order[1] = SORT_KEY_DEPTH;
+	transparent.Order[2] = SORT_KEY_SHADER;
+	transparent.Order[3] = SORT_KEY_MATERIAL;
+	transparent.Order[4] = SORT_KEY_MESH;
+	transparent.Bits[SORT_KEY_PASS] = PassBits;
+	transparent.Bits[SORT_KEY_DEPTH] = 24;
+	transparent.Bits[SORT_KEY_SHADER] = 10;
+	transparent.Bits[SORT_KEY_MATERIAL] = 14;
+	transparent.Bits[SORT_KEY_MESH] = 14;
+	transparent.BackToFront = true;
+	SetLayout(RENDER_PASS_TRANSPARENT, transparent);
+
+	nearDepth = 0.1f;
+	farDepth = 100.0f;
+	threadCount = std::thread::hardware_concurrency();
+	if (threadCount == 0) threadCount = 1;
+
+	stateChangesUnsorted = 0;
+	stateChangesSorted = 0;
+	lastSortMilliseconds = 0;
+}
+
+RenderQueue::~RenderQueue()
+{
+}
+
+// --------------------------------------------------------
+// Sets the key layout for a pass
+//
+// Returns false (and leaves the old layout) if the pass isn't
+// the most significant field or the fields don't fit in 64 bits
+// --------------------------------------------------------
+bool RenderQueue::SetLayout(RenderPass pass, const SortKeyLayout& layout)
+{
+	if (layout.Order[0] != SORT_KEY_PASS || layout.Bits[SORT_KEY_PASS] != PassBits)
+		return false;
+
+	// Every field must appear exactly once
+	unsigned int totalBits = 0;
+	bool seen[SORT_KEY_FIELD_COUNT] = {};
+	for (int i = 0; i < SORT_KEY_FIELD_COUNT; i++)
+	{
+		if (layout.Order[i] >= SORT_KEY_FIELD_COUNT || seen[layout.Order[i]])
+			return false;
+		seen[layout.Order[i]] = true;
+		totalBits += layout.Bits[layout.Order[i]];
+	}
+
+	if (totalBits > 64)
+		return false;
+
+	BuildPassLayout(pass, layout);
+	return true;
+}
+
+SortKeyLayout RenderQueue::GetLayout(RenderPass pass)
+{
+	return passLayouts[pass].Layout;
+}
+
+void RenderQueue::SetDepthRange(float nearDepth, float farDepth)
+{
+	this->nearDepth = nearDepth;
+	this->farDepth = farDepth;
+}
+
+void RenderQueue::SetThreadCount(unsigned int threadCount)
+{
+	this->threadCount = threadCount > 0 ? threadCount : 1;
+}
+
+void RenderQueue::Clear()
+{
+	packets.clear();
+}
+
+// --------------------------------------------------------
+// Builds a key for a draw and adds it to the queue
+//
+// IDs wider than their field are truncated, which only
+// costs some grouping - never correctness
+// --------------------------------------------------------
+void RenderQueue::Submit(RenderPass pass, unsigned int shaderID, unsigned int materialID, unsigned int meshID, float depth, unsigned int entityIndex)
+{
+	PassLayout& passLayout = passLayouts[pass];
+
+	// Quantize depth into the number of bits the layout gives it
+	float normalizedDepth = (depth - nearDepth) / (farDepth - nearDepth);
+	if (normalizedDepth < 0) normalizedDepth = 0;
+	if (normalizedDepth > 1) normalizedDepth = 1;
+	if (passLayout.Layout.BackToFront)
+		normalizedDepth = 1.0f - normalizedDepth;
+	unsigned long long depthBits = (unsigned long long)(normalizedDepth * (double)passLayout.Mask[SORT_KEY_DEPTH]);
+
+	unsigned long long values[SORT_KEY_FIELD_COUNT];
+	values[SORT_KEY_PASS] = pass;
+	values[SORT_KEY_SHADER] = shaderID;
+	values[SORT_KEY_MATERIAL] = materialID;
+	values[SORT_KEY_MESH] = meshID;
+	values[SORT_KEY_DEPTH] = depthBits;
+
+	DrawPacket packet;
+	packet.Key = 0;
+	packet.EntityIndex = entityIndex;
+	for (int i = 0; i < SORT_KEY_FIELD_COUNT; i++)
+		packet.Key |= (values[i] & passLayout.Mask[i]) << passLayout.Shift[i];
+
+	packets.push_back(packet);
+}
+
+// --------------------------------------------------------
+// Sorts all submitted packets by key, recording how many
+// state changes there were before and after
+// --------------------------------------------------------
+void RenderQueue::Sort()
+{
+	stateChangesUnsorted = CountStateChanges();
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	RadixSortPackets(packets, scratch, threadCount);
+	std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+	lastSortMilliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+
+	stateChangesSorted = CountStateChanges();
+}
+
+unsigned int RenderQueue::GetField(unsigned long long key, SortKeyField field)
+{
+	PassLayout& passLayout = passLayouts[GetPass(key)];
+	return (unsigned int)((key >> passLayout.Shift[field]) & passLayout.Mask[field]);
+}
+
+// --------------------------------------------------------
+// Gets the bits a field occupies in a pass's keys, which is
+// handy for checking if two packets share some state
+// --------------------------------------------------------
+unsigned long long RenderQueue::GetFieldMask(RenderPass pass, SortKeyField field)
+{
+	return passLayouts[pass].Mask[field] << passLayouts[pass].Shift[field];
+}
+
+const std::vector<DrawPacket>& RenderQueue::GetPackets()
+{
+	return packets;
+}
+
+unsigned int RenderQueue::GetStateChangesUnsorted()
+{
+	return stateChangesUnsorted;
+}
+
+unsigned int RenderQueue::GetStateChangesSorted()
+{
+	return stateChangesSorted;
+}
+
+double RenderQueue::GetLastSortMilliseconds()
+{
+	return lastSortMilliseconds;
+}
+
+void RenderQueue::BuildPassLayout(RenderPass pass, const SortKeyLayout& layout)
+{
+	PassLayout& passLayout = passLayouts[pass];
+	passLayout.Layout = layout;
+
+	// Hand out bits from the top of the key down
+	unsigned int nextBit = 64;
+	for (int i = 0; i < SORT_KEY_FIELD_COUNT; i++)
+	{
+		SortKeyField field = layout.Order[i];
+		unsigned int bits = layout.Bits[field];
+		nextBit -= bits;
+		passLayout.Shift[field] = nextBit;
+		passLayout.Mask[field] = bits >= 64 ? ~0ull : ((1ull << bits) - 1);
+	}
+}
+
+// --------------------------------------------------------
+// Counts how often the shader, material or mesh changes
+// between neighbouring packets in the current order
+// --------------------------------------------------------
+unsigned int RenderQueue::CountStateChanges()
+{
+	unsigned int changes = 0;
+	for (size_t i = 0; i < packets.size(); i++)
+	{
+		if (i == 0)
+		{
+			changes++;
+			continue;
+		}
+
+		unsigned long long previous = packets[i - 1].Key;
+		unsigned long long current = packets[i].Key;
+		if (GetField(previous, SORT_KEY_SHADER) != GetField(current, SORT_KEY_SHADER) ||
+			GetField(previous, SORT_KEY_MATERIAL) != GetField(current, SORT_KEY_MATERIAL) ||
+			GetField(previous, SORT_KEY_MESH) != GetField(current, SORT_KEY_MESH))
+			changes++;
+	}
+	return changes;
+}
+
+RenderPass RenderQueue::GetPass(unsigned long long key)
+{
+	return (RenderPass)(key >> (64 - PassBits));
+}
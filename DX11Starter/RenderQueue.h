@@ -0,0 +1,104 @@
+#pragma once
+
+#include <vector>
+#include "RadixSort.h"
+
+// --------------------------------------------------------
+// Passes a draw can belong to, in the order they're drawn
+// --------------------------------------------------------
+enum RenderPass
+{
+	RENDER_PASS_OPAQUE,
+	RENDER_PASS_TRANSPARENT,
+	RENDER_PASS_COUNT
+};
+
+// --------------------------------------------------------
+// The pieces of state that make up a sort key
+// --------------------------------------------------------
+enum SortKeyField
+{
+	SORT_KEY_PASS,
+	SORT_KEY_SHADER,
+	SORT_KEY_MATERIAL,
+	SORT_KEY_MESH,
+	SORT_KEY_DEPTH,
+	SORT_KEY_FIELD_COUNT
+};
+
+// --------------------------------------------------------
+// Describes how the fields are packed into a 64-bit key
+// for one pass.  Fields listed first are the most
+// significant, so they're what the draws get grouped by.
+// --------------------------------------------------------
+struct SortKeyLayout
+{
+	SortKeyField Order[SORT_KEY_FIELD_COUNT];	// Fields from most to least significant
+	unsigned int Bits[SORT_KEY_FIELD_COUNT];	// Number of bits for each field (indexed by SortKeyField)
+	bool BackToFront;							// Invert depth so far things draw first
+};
+
+// --------------------------------------------------------
+// Collects draw packets for a frame, sorts them by key and
+// keeps track of how many state changes sorting saved
+// --------------------------------------------------------
+class RenderQueue
+{
+public:
+	RenderQueue(); // Constructor
+	~RenderQueue(); // Destructor
+
+	// Per-pass key layout (must total no more than 64 bits)
+	bool SetLayout(RenderPass pass, const SortKeyLayout& layout);
+	SortKeyLayout GetLayout(RenderPass pass);
+
+	// Depth range used to quantize view space depth into the key
+	void SetDepthRange(float nearDepth, float farDepth);
+
+	// Number of threads used by the radix sort
+	void SetThreadCount(unsigned int threadCount);
+
+	// Frame methods
+	void Clear();
+	void Submit(RenderPass pass, unsigned int shaderID, unsigned int materialID, unsigned int meshID, float depth, unsigned int entityIndex);
+	void Sort();
+
+	// Reading fields back out of a key
+	unsigned int GetField(unsigned long long key, SortKeyField field);
+	unsigned long long GetFieldMask(RenderPass pass, SortKeyField field);
+
+	// GET methods
+	const std::vector<DrawPacket>& GetPackets();
+	unsigned int GetStateChangesUnsorted();
+	unsigned int GetStateChangesSorted();
+	double GetLastSortMilliseconds();
+
+private:
+	// Precomputed placement of every field for one pass
+	struct PassLayout
+	{
+		SortKeyLayout Layout;
+		unsigned int Shift[SORT_KEY_FIELD_COUNT];
+		unsigned long long Mask[SORT_KEY_FIELD_COUNT];
+	};
+
+	// Helper methods
+	void BuildPassLayout(RenderPass pass, const SortKeyLayout& layout);
+	unsigned int CountStateChanges();
+	RenderPass GetPass(unsigned long long key);
+
+	PassLayout passLayouts[RENDER_PASS_COUNT];
+
+	// Packets for this frame, plus scratch space for the sort
+	std::vector<DrawPacket> packets;
+	std::vector<DrawPacket> scratch;
+
+	float nearDepth;
+	float farDepth;
+	unsigned int threadCount;
+
+	// Stats for the last sort
+	unsigned int stateChangesUnsorted;
+	unsigned int stateChangesSorted;
+	double lastSortMilliseconds;
+};
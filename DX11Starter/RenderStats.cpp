@@ -0,0 +1,151 @@
+#include "RenderStats.h"
+
+#include <fstream>
+#include <sstream>
+
+// Every counter, with the name it's saved under
+#define RENDER_STAT_COUNTERS(X) \
+	X(Draws) \
+	X(Indices) \
+	X(Instances) \
+	X(ShaderBinds) \
+	X(ConstantBufferBinds) \
+	X(ShaderResourceBinds) \
+	X(SamplerBinds) \
+	X(OtherStateChanges) \
+	X(BytesUploaded) \
+	X(BuffersCreated) \
+	X(TexturesCreated)
+
+void RenderStatCounters::Reset()
+{
+#define RESET_COUNTER(name) name = 0;
+	RENDER_STAT_COUNTERS(RESET_COUNTER)
+#undef RESET_COUNTER
+}
+
+void RenderStatCounters::Add(const RenderStatCounters& other)
+{
+#define ADD_COUNTER(name) name += other.name;
+	RENDER_STAT_COUNTERS(ADD_COUNTER)
+#undef ADD_COUNTER
+}
+
+void RenderStatCounters::Subtract(const RenderStatCounters& other)
+{
+#define SUBTRACT_COUNTER(name) name -= other.name;
+	RENDER_STAT_COUNTERS(SUBTRACT_COUNTER)
+#undef SUBTRACT_COUNTER
+}
+
+RenderStats::RenderStats(unsigned int maxFrames)
+{
+	this->maxFrames = maxFrames > 0 ? maxFrames : 1;
+	oldestFrame = 0;
+	frameIndex = 0;
+	currentFrame.Reset();
+	lastFrame.Reset();
+}
+
+RenderStats::~RenderStats()
+{
+}
+
+void RenderStats::BeginFrame()
+{
+	currentFrame.Reset();
+}
+
+void RenderStats::AddToFrame(const RenderStatCounters& counters)
+{
+	currentFrame.Add(counters);
+}
+
+// --------------------------------------------------------
+// Once the history is full the oldest frame is overwritten
+// --------------------------------------------------------
+void RenderStats::EndFrame(float frameMilliseconds)
+{
+	FrameStats frame;
+	frame.FrameIndex = frameIndex++;
+	frame.Milliseconds = frameMilliseconds;
+	frame.Counters = currentFrame;
+
+	if (frames.size() < maxFrames)
+	{
+		frames.push_back(frame);
+	}
+	else
+	{
+		frames[oldestFrame] = frame;
+		oldestFrame = (oldestFrame + 1) % maxFrames;
+	}
+
+	lastFrame = currentFrame;
+}
+
+std::string RenderStats::ToCSV()
+{
+	std::ostringstream output;
+	output << "Frame,Milliseconds";
+#define CSV_HEADER(name) output << "," #name;
+	RENDER_STAT_COUNTERS(CSV_HEADER)
+#undef CSV_HEADER
+	output << "\n";
+
+	for (unsigned int i = 0; i < frames.size(); i++)
+	{
+		const FrameStats& frame = GetFrame(i);
+		output << frame.FrameIndex << "," << frame.Milliseconds;
+#define CSV_VALUE(name) output << "," << frame.Counters.name;
+		RENDER_STAT_COUNTERS(CSV_VALUE)
+#undef CSV_VALUE
+		output << "\n";
+	}
+	return output.str();
+}
+
+bool RenderStats::WriteCSV(const char* path)
+{
+	return WriteFile(path, ToCSV());
+}
+
+std::string RenderStats::ToJSON()
+{
+	std::ostringstream output;
+	output << "[\n";
+	for (unsigned int i = 0; i < frames.size(); i++)
+	{
+		const FrameStats& frame = GetFrame(i);
+		output << "\t{ \"Frame\": " << frame.FrameIndex << ", \"Milliseconds\": " << frame.Milliseconds;
+#define JSON_VALUE(name) output << ", \"" #name "\": " << frame.Counters.name;
+		RENDER_STAT_COUNTERS(JSON_VALUE)
+#undef JSON_VALUE
+		output << (i + 1 < frames.size() ? " },\n" : " }\n");
+	}
+	output << "]\n";
+	return output.str();
+}
+
+bool RenderStats::WriteJSON(const char* path)
+{
+	return WriteFile(path, ToJSON());
+}
+
+// --------------------------------------------------------
+// Frames in the order they happened, oldest first
+// --------------------------------------------------------
+const RenderStats::FrameStats& RenderStats::GetFrame(unsigned int i)
+{
+	return frames[(oldestFrame + i) % frames.size()];
+}
+
+bool RenderStats::WriteFile(const char* path, const std::string& text)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	file.write(text.data(), text.size());
+	return file.good();
+}
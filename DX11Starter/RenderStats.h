@@ -0,0 +1,91 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// Render statistics are only counted when ENGINE_RENDER_STATS
+// is defined (the Debug configurations define it).  Without
+// it RENDER_STATS() expands to nothing, so the counting costs
+// nothing at all in release builds.
+// --------------------------------------------------------
+#ifdef ENGINE_RENDER_STATS
+#define RENDER_STATS(statement) statement
+#else
+#define RENDER_STATS(statement)
+#endif
+
+// --------------------------------------------------------
+// Counts of the work sent to the GPU.  Binds only count calls
+// that actually went through, not ones a state cache dropped.
+// --------------------------------------------------------
+struct RenderStatCounters
+{
+	unsigned long long Draws;
+	unsigned long long Indices;
+	unsigned long long Instances;
+	unsigned long long ShaderBinds;
+	unsigned long long ConstantBufferBinds;
+	unsigned long long ShaderResourceBinds;
+	unsigned long long SamplerBinds;
+	unsigned long long OtherStateChanges;	// Input assembler, fixed function states, render targets and viewports
+	unsigned long long BytesUploaded;		// UpdateSubresource and staging copies, not mapped buffers
+	unsigned long long BuffersCreated;
+	unsigned long long TexturesCreated;
+
+	void Reset();
+	void Add(const RenderStatCounters& other);
+	void Subtract(const RenderStatCounters& other);
+};
+
+// --------------------------------------------------------
+// Keeps the counters of the most recent frames, oldest first,
+// so they can be saved as a CSV or JSON time series.
+//
+// Each frame, call BeginFrame(), add everything counted during
+// the frame with AddToFrame(), then call EndFrame().
+// --------------------------------------------------------
+class RenderStats
+{
+public:
+	RenderStats(unsigned int maxFrames); // Constructor
+	~RenderStats(); // Destructor
+
+	void BeginFrame();
+	void AddToFrame(const RenderStatCounters& counters);
+	void EndFrame(float frameMilliseconds);
+
+	// The last frame that was ended, all zeros before the first one
+	const RenderStatCounters& GetLastFrame() { return lastFrame; }
+
+	// Frames kept, up to maxFrames
+	unsigned int GetFrameCount() { return (unsigned int)frames.size(); }
+
+	// One row per frame, with a header row
+	std::string ToCSV();
+	bool WriteCSV(const char* path);
+
+	// An array with one object per frame
+	std::string ToJSON();
+	bool WriteJSON(const char* path);
+
+private:
+	struct FrameStats
+	{
+		unsigned long long FrameIndex;
+		float Milliseconds;
+		RenderStatCounters Counters;
+	};
+
+	// Helper methods
+	const FrameStats& GetFrame(unsigned int i);
+	static bool WriteFile(const char* path, const std::string& text);
+
+	unsigned int maxFrames;
+	std::vector<FrameStats> frames;		// Used as a ring once it's full
+	unsigned int oldestFrame;
+	unsigned long long frameIndex;
+
+	RenderStatCounters currentFrame;
+	RenderStatCounters lastFrame;
+};
@@ -0,0 +1,101 @@
+#include "RingAllocator.h"
+
+RingAllocator::RingAllocator(unsigned int size)
+{
+	this->size = size;
+	Reset();
+}
+
+RingAllocator::~RingAllocator()
+{
+}
+
+// --------------------------------------------------------
+// The free space is either one run [head, tail) or, when the
+// used part doesn't wrap, two runs [head, size) and [0, tail).
+// An allocation never straddles the end - if it won't fit
+// before the end, the rest of the ring is skipped and it goes
+// at the start instead.  Skipped bytes count as used until the
+// allocation after them is retired.
+// --------------------------------------------------------
+bool RingAllocator::Allocate(unsigned int byteSize, unsigned int alignment, unsigned int& offset)
+{
+	unsigned int used = GetUsed();
+	if (byteSize > size || used == size)
+		return false;
+
+	// With nothing in use, start over at the beginning so the
+	// whole ring is one contiguous run again.  Any fences still
+	// waiting to retire cover no bytes, so they move too.
+	if (used == 0)
+	{
+		head = 0;
+		tail = 0;
+		for (std::deque<FenceMark>::size_type i = 0; i != fences.size(); i++)
+			fences[i].Head = 0;
+	}
+
+	unsigned long long alignedHead = ((unsigned long long)head + alignment - 1) & ~(unsigned long long)(alignment - 1);
+	unsigned int start;
+	if (head >= tail)
+	{
+		if (alignedHead + byteSize <= size)
+			start = (unsigned int)alignedHead;
+		else if (byteSize <= tail)
+			start = 0;
+		else
+			return false;
+	}
+	else
+	{
+		if (alignedHead + byteSize > tail)
+			return false;
+		start = (unsigned int)alignedHead;
+	}
+
+	// Wrapping skips everything from the head to the end
+	unsigned int consumed = start >= head
+		? start - head + byteSize
+		: size - head + byteSize;
+
+	offset = start;
+	head = start + byteSize;
+	allocatedBytes += consumed;
+	return true;
+}
+
+void RingAllocator::Fence(unsigned long long value)
+{
+	// Two fences in a row without allocations between them are
+	// the same point in the ring, so the newer one adds nothing.
+	// The older value has to stay, since everything before it is
+	// free once it retires - keeping the newer one instead would
+	// hold on to it for as long as nothing else gets allocated.
+	if (!fences.empty() && fences.back().Allocated == allocatedBytes)
+		return;
+
+	FenceMark mark;
+	mark.Value = value;
+	mark.Head = head;
+	mark.Allocated = allocatedBytes;
+	fences.push_back(mark);
+}
+
+void RingAllocator::Retire(unsigned long long completedValue)
+{
+	while (!fences.empty() && fences.front().Value <= completedValue)
+	{
+		tail = fences.front().Head;
+		retiredBytes = fences.front().Allocated;
+		fences.pop_front();
+	}
+}
+
+void RingAllocator::Reset()
+{
+	head = 0;
+	tail = 0;
+	allocatedBytes = 0;
+	retiredBytes = 0;
+	fences.clear();
+}
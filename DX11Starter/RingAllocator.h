@@ -0,0 +1,61 @@
+#pragma once
+
+#include <deque>
+
+// --------------------------------------------------------
+// Hands out space from a fixed size ring by bumping a head
+// offset forward, wrapping back to the start when it runs
+// off the end.  Allocations are never freed one at a time -
+// instead everything allocated before a Fence() is given
+// back at once when that fence's value is retired.
+//
+// Only offsets are managed, so this knows nothing about
+// buffers or DirectX.  Nothing here is thread safe.
+// --------------------------------------------------------
+class RingAllocator
+{
+public:
+	RingAllocator(unsigned int size); // Constructor
+	~RingAllocator(); // Destructor
+
+	// Finds byteSize contiguous bytes starting at a multiple of
+	// alignment (a power of two).  Returns false, and leaves the
+	// ring untouched, if there isn't room until more is retired.
+	bool Allocate(unsigned int byteSize, unsigned int alignment, unsigned int& offset);
+
+	// Tags everything allocated since the last fence with a value.
+	// Values must only ever increase.
+	void Fence(unsigned long long value);
+
+	// Frees everything fenced with a value up to completedValue
+	void Retire(unsigned long long completedValue);
+
+	// Frees everything, fenced or not
+	void Reset();
+
+	// GET methods
+	unsigned int GetSize() { return size; }
+	unsigned int GetUsed() { return (unsigned int)(allocatedBytes - retiredBytes); }
+	unsigned int GetFenceCount() { return (unsigned int)fences.size(); }
+
+private:
+	// Where the head was when a fence went in.  Retiring it
+	// moves the tail up to that point.
+	struct FenceMark
+	{
+		unsigned long long Value;
+		unsigned int Head;
+		unsigned long long Allocated;	// Total allocated at the time
+	};
+
+	unsigned int size;
+	unsigned int head;	// Next free byte
+	unsigned int tail;	// Oldest byte still in use
+
+	// Running totals, including bytes skipped for alignment or
+	// wrapping.  The difference is how much is in use right now.
+	unsigned long long allocatedBytes;
+	unsigned long long retiredBytes;
+
+	std::deque<FenceMark> fences;
+};
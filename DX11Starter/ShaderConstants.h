@@ -0,0 +1,93 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include "ConstantBufferLayout.h"
+#include "DirectionalLight.h"
+
+// --------------------------------------------------------
+// The engine's constant buffers, member for member.  Each is
+// checked against HLSL packing here, and against the compiled
+// shader when a handle to its buffer is looked up, so a whole
+// buffer can be copied in at once.
+// --------------------------------------------------------
+
+// externalData in VertexShader.hlsl
+struct VertexShaderConstants
+{
+	DirectX::XMFLOAT4X4 World;	// Transposed, like every matrix here
+	DirectX::XMFLOAT4X4 View;
+	DirectX::XMFLOAT4X4 Projection;
+	unsigned int TextureSlice;	// Into the material's texture array
+	unsigned int Padding[3];	// Out to a whole register, which HLSL pads by itself
+};
+
+template<> struct HlslLayout<VertexShaderConstants>
+{
+	static constexpr HlslMemberList<4> Members()
+	{
+		return {{
+			HLSL_MEMBER(VertexShaderConstants, World),
+			HLSL_MEMBER(VertexShaderConstants, View),
+			HLSL_MEMBER(VertexShaderConstants, Projection),
+			HLSL_MEMBER(VertexShaderConstants, TextureSlice)
+		}};
+	}
+};
+static_assert(HlslLayoutMatches<VertexShaderConstants>(), "VertexShaderConstants doesn't match HLSL packing");
+
+// externalData in VertexShaderInstanced.hlsl
+struct InstancedVertexShaderConstants
+{
+	DirectX::XMFLOAT4X4 View;
+	DirectX::XMFLOAT4X4 Projection;
+};
+
+template<> struct HlslLayout<InstancedVertexShaderConstants>
+{
+	static constexpr HlslMemberList<2> Members()
+	{
+		return {{
+			HLSL_MEMBER(InstancedVertexShaderConstants, View),
+			HLSL_MEMBER(InstancedVertexShaderConstants, Projection)
+		}};
+	}
+};
+static_assert(HlslLayoutMatches<InstancedVertexShaderConstants>(), "InstancedVertexShaderConstants doesn't match HLSL packing");
+
+// lightData in PixelShader.hlsl
+struct LightConstants
+{
+	DirectionalLight Lights[4];
+};
+
+template<> struct HlslLayout<LightConstants>
+{
+	static constexpr HlslMemberList<1> Members()
+	{
+		return {{
+			HLSL_MEMBER(LightConstants, Lights)
+		}};
+	}
+};
+static_assert(HlslLayoutMatches<LightConstants>(), "LightConstants doesn't match HLSL packing");
+
+// materialData in PixelShader.hlsl
+struct MaterialParameters
+{
+	DirectX::XMFLOAT4 Tint;		// Multiplies the surface color
+	DirectX::XMFLOAT2 UVScale;	// Texture coordinates are scaled, then offset
+	DirectX::XMFLOAT2 UVOffset;
+};
+
+template<> struct HlslLayout<MaterialParameters>
+{
+	static constexpr HlslMemberList<3> Members()
+	{
+		return {{
+			HLSL_MEMBER(MaterialParameters, Tint),
+			HLSL_MEMBER(MaterialParameters, UVScale),
+			HLSL_MEMBER(MaterialParameters, UVOffset)
+		}};
+	}
+};
+static_assert(HlslLayoutMatches<MaterialParameters>(), "MaterialParameters doesn't match HLSL packing");
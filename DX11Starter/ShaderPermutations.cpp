@@ -0,0 +1,297 @@
+#include "ShaderPermutations.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ PERMUTATION SET -----------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+bool ShaderPermutationSet::AddFeature(const std::string& name, unsigned int maxValue, unsigned int defaultValue)
+{
+	if (name.empty() || FindFeature(name) || defaultValue > maxValue)
+		return false;
+
+	// Just enough bits for the largest value, and at least one
+	unsigned int bits = 1;
+	while (bits < 32 && (maxValue >> bits) != 0)
+		bits++;
+	if (bitsUsed + bits > 64)
+		return false;
+
+	Feature feature;
+	feature.Name = name;
+	feature.Shift = bitsUsed;
+	feature.Bits = bits;
+	feature.MaxValue = maxValue;
+	feature.DefaultValue = defaultValue;
+	features.push_back(feature);
+
+	bitsUsed += bits;
+	return true;
+}
+
+ShaderVariantKey ShaderPermutationSet::GetDefaultKey() const
+{
+	ShaderVariantKey key = 0;
+	for (size_t f = 0; f < features.size(); f++)
+		key |= (ShaderVariantKey)features[f].DefaultValue << features[f].Shift;
+	return key;
+}
+
+bool ShaderPermutationSet::SetFeature(ShaderVariantKey& key, const std::string& name, unsigned int value) const
+{
+	const Feature* feature = FindFeature(name);
+	if (!feature || value > feature->MaxValue)
+		return false;
+
+	ShaderVariantKey mask = (((ShaderVariantKey)1 << feature->Bits) - 1) << feature->Shift;
+	key = (key & ~mask) | ((ShaderVariantKey)value << feature->Shift);
+	return true;
+}
+
+unsigned int ShaderPermutationSet::GetFeature(ShaderVariantKey key, const std::string& name) const
+{
+	const Feature* feature = FindFeature(name);
+	return feature ? ReadField(key, *feature) : 0;
+}
+
+bool ShaderPermutationSet::IsValidKey(ShaderVariantKey key) const
+{
+	// No bits past the last feature
+	if (bitsUsed < 64 && (key >> bitsUsed) != 0)
+		return false;
+
+	for (size_t f = 0; f < features.size(); f++)
+	{
+		if (ReadField(key, features[f]) > features[f].MaxValue)
+			return false;
+	}
+	return true;
+}
+
+std::vector<ShaderDefine> ShaderPermutationSet::GetDefines(ShaderVariantKey key) const
+{
+	std::vector<ShaderDefine> defines(features.size());
+	for (size_t f = 0; f < features.size(); f++)
+	{
+		defines[f].Name = features[f].Name;
+		defines[f].Value = std::to_string(ReadField(key, features[f]));
+	}
+	return defines;
+}
+
+unsigned long long ShaderPermutationSet::GetVariantCount() const
+{
+	unsigned long long count = 1;
+	for (size_t f = 0; f < features.size(); f++)
+		count *= (unsigned long long)features[f].MaxValue + 1;
+	return count;
+}
+
+// --------------------------------------------------------
+// Counts through the variants like a number where each digit
+// is a feature, the first feature changing fastest
+// --------------------------------------------------------
+bool ShaderPermutationSet::GetVariantKey(unsigned long long index, ShaderVariantKey& key) const
+{
+	if (index >= GetVariantCount())
+		return false;
+
+	key = 0;
+	for (size_t f = 0; f < features.size(); f++)
+	{
+		unsigned long long values = (unsigned long long)features[f].MaxValue + 1;
+		key |= (index % values) << features[f].Shift;
+		index /= values;
+	}
+	return true;
+}
+
+unsigned long long ShaderPermutationSet::GetLayoutHash() const
+{
+	unsigned long long hash = 14695981039346656037ull;
+	for (size_t f = 0; f < features.size(); f++)
+	{
+		// Names end with their terminator so "AB","C" differs from "A","BC"
+		hash = ShaderVariantCacheIndex::HashSource(features[f].Name.c_str(), features[f].Name.size() + 1, hash);
+		unsigned char maxValue[4] =
+		{
+			(unsigned char)(features[f].MaxValue & 0xFF),
+			(unsigned char)((features[f].MaxValue >> 8) & 0xFF),
+			(unsigned char)((features[f].MaxValue >> 16) & 0xFF),
+			(unsigned char)((features[f].MaxValue >> 24) & 0xFF)
+		};
+		hash = ShaderVariantCacheIndex::HashSource(maxValue, sizeof(maxValue), hash);
+	}
+	return hash;
+}
+
+const ShaderPermutationSet::Feature* ShaderPermutationSet::FindFeature(const std::string& name) const
+{
+	for (size_t f = 0; f < features.size(); f++)
+	{
+		if (features[f].Name == name)
+			return &features[f];
+	}
+	return 0;
+}
+
+unsigned int ShaderPermutationSet::ReadField(ShaderVariantKey key, const Feature& feature)
+{
+	return (unsigned int)((key >> feature.Shift) & (((ShaderVariantKey)1 << feature.Bits) - 1));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ------ CACHE INDEX ---------------------------------------------------------
+///////////////////////////////////////////////////////////////////////////////
+
+const ShaderVariantCacheEntry* ShaderVariantCacheIndex::Find(ShaderVariantKey key) const
+{
+	std::unordered_map<ShaderVariantKey, ShaderVariantCacheEntry>::const_iterator it = entries.find(key);
+	return it == entries.end() ? 0 : &it->second;
+}
+
+const ShaderVariantCacheEntry* ShaderVariantCacheIndex::Find(ShaderVariantKey key, unsigned long long sourceHash) const
+{
+	const ShaderVariantCacheEntry* entry = Find(key);
+	return entry && entry->SourceHash == sourceHash ? entry : 0;
+}
+
+void ShaderVariantCacheIndex::Set(const ShaderVariantCacheEntry& entry)
+{
+	entries[entry.Key] = entry;
+}
+
+bool ShaderVariantCacheIndex::Remove(ShaderVariantKey key)
+{
+	return entries.erase(key) > 0;
+}
+
+// --------------------------------------------------------
+// Layout (every number little endian):
+//   u32 magic, u32 version, u32 entry count, then for each:
+//     u64 key, u64 source hash, u16 name length, name bytes
+// --------------------------------------------------------
+void ShaderVariantCacheIndex::Write(std::vector<unsigned char>& bytes) const
+{
+	// Sorted, so the same index always makes the same file
+	std::vector<const ShaderVariantCacheEntry*> sorted;
+	for (std::unordered_map<ShaderVariantKey, ShaderVariantCacheEntry>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+		sorted.push_back(&it->second);
+	std::sort(sorted.begin(), sorted.end(), [](const ShaderVariantCacheEntry* a, const ShaderVariantCacheEntry* b)
+	{
+		return a->Key < b->Key;
+	});
+
+	bytes.clear();
+	unsigned long long header[3] = { Magic, Version, sorted.size() };
+	for (int h = 0; h < 3; h++)
+	{
+		for (int i = 0; i < 4; i++)
+			bytes.push_back((unsigned char)((header[h] >> (i * 8)) & 0xFF));
+	}
+
+	for (size_t e = 0; e < sorted.size(); e++)
+	{
+		for (int i = 0; i < 8; i++)
+			bytes.push_back((unsigned char)((sorted[e]->Key >> (i * 8)) & 0xFF));
+		for (int i = 0; i < 8; i++)
+			bytes.push_back((unsigned char)((sorted[e]->SourceHash >> (i * 8)) & 0xFF));
+
+		size_t length = sorted[e]->FileName.size() < 0xFFFF ? sorted[e]->FileName.size() : 0xFFFF;
+		bytes.push_back((unsigned char)(length & 0xFF));
+		bytes.push_back((unsigned char)((length >> 8) & 0xFF));
+		bytes.insert(bytes.end(), sorted[e]->FileName.begin(), sorted[e]->FileName.begin() + length);
+	}
+}
+
+bool ShaderVariantCacheIndex::Read(const unsigned char* bytes, size_t byteCount)
+{
+	const unsigned char* next = bytes;
+	const unsigned char* end = bytes + byteCount;
+
+	// Reads a little endian number of the given size, failing at the end of the data
+	unsigned long long value = 0;
+	auto take = [&](int size) -> bool
+	{
+		if (!next || (size_t)(end - next) < (size_t)size)
+			return false;
+		value = 0;
+		for (int i = 0; i < size; i++)
+			value |= (unsigned long long)next[i] << (i * 8);
+		next += size;
+		return true;
+	};
+
+	if (!take(4) || value != Magic || !take(4) || value != Version || !take(4))
+		return false;
+
+	// Every entry is at least 18 bytes, so a count that can't fit is a bad file
+	unsigned long long count = value;
+	if ((size_t)(end - next) / 18 < count)
+		return false;
+
+	std::unordered_map<ShaderVariantKey, ShaderVariantCacheEntry> result;
+	for (unsigned long long e = 0; e < count; e++)
+	{
+		ShaderVariantCacheEntry entry;
+		if (!take(8)) return false;
+		entry.Key = value;
+		if (!take(8)) return false;
+		entry.SourceHash = value;
+		if (!take(2) || (size_t)(end - next) < value) return false;
+		entry.FileName.assign((const char*)next, (size_t)value);
+		next += value;
+		result[entry.Key] = entry;
+	}
+
+	// Anything left over means it isn't the file we think it is
+	if (next != end)
+		return false;
+
+	entries.swap(result);
+	return true;
+}
+
+bool ShaderVariantCacheIndex::Save(const std::string& path) const
+{
+	std::vector<unsigned char> bytes;
+	Write(bytes);
+
+	std::ofstream file(path.c_str(), std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	file.write((const char*)&bytes[0], bytes.size());
+	return file.good();
+}
+
+bool ShaderVariantCacheIndex::Load(const std::string& path)
+{
+	std::ifstream file(path.c_str(), std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	return Read(bytes.empty() ? 0 : &bytes[0], bytes.size());
+}
+
+unsigned long long ShaderVariantCacheIndex::HashSource(const void* source, size_t sourceSize, unsigned long long seed)
+{
+	const unsigned char* bytes = (const unsigned char*)source;
+	unsigned long long hash = seed;
+	for (size_t i = 0; i < sourceSize; i++)
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	return hash;
+}
+
+std::string ShaderVariantCacheIndex::MakeFileName(const std::string& baseName, ShaderVariantKey key)
+{
+	static const char digits[] = "0123456789abcdef";
+	std::string hex(16, '0');
+	for (int i = 15; i >= 0; i--, key >>= 4)
+		hex[i] = digits[key & 0xF];
+	return baseName + "_" + hex + ".cso";
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// Every feature value of one variant of a shader, packed into 64 bits
+typedef unsigned long long ShaderVariantKey;
+
+// A preprocessor define to compile a variant with
+struct ShaderDefine
+{
+	std::string Name;
+	std::string Value;
+};
+
+// --------------------------------------------------------
+// The features a shader can be compiled with, each a define
+// taking a value from 0 up to its maximum.  Each feature gets
+// just enough bits of the variant key for its largest value,
+// in the order the features were added.
+// --------------------------------------------------------
+class ShaderPermutationSet
+{
+public:
+	// False if the name is already used, or the key is out of bits
+	bool AddFeature(const std::string& name, unsigned int maxValue, unsigned int defaultValue);
+
+	// The variant with every feature at its default value
+	ShaderVariantKey GetDefaultKey() const;
+
+	// Changing and reading one feature of a key.  Setting fails if the
+	// feature doesn't exist or the value is too large for it.
+	bool SetFeature(ShaderVariantKey& key, const std::string& name, unsigned int value) const;
+	unsigned int GetFeature(ShaderVariantKey key, const std::string& name) const;
+
+	// Whether a key only uses known features, within their ranges
+	bool IsValidKey(ShaderVariantKey key) const;
+
+	// The defines a key's variant is compiled with, one per feature
+	std::vector<ShaderDefine> GetDefines(ShaderVariantKey key) const;
+
+	// Every variant in turn, for compiling them all ahead of time
+	unsigned long long GetVariantCount() const;
+	bool GetVariantKey(unsigned long long index, ShaderVariantKey& key) const;
+
+	// Changes whenever the features do, so cached variants built
+	// with a different set of features aren't used by mistake
+	unsigned long long GetLayoutHash() const;
+
+	size_t GetFeatureCount() const { return features.size(); }
+
+private:
+	struct Feature
+	{
+		std::string Name;
+		unsigned int Shift;
+		unsigned int Bits;
+		unsigned int MaxValue;
+		unsigned int DefaultValue;
+	};
+
+	std::vector<Feature> features;
+	unsigned int bitsUsed = 0;
+
+	const Feature* FindFeature(const std::string& name) const;
+	static unsigned int ReadField(ShaderVariantKey key, const Feature& feature);
+};
+
+// --------------------------------------------------------
+// Lookups into a variant cache and where they were answered
+// --------------------------------------------------------
+struct ShaderVariantStats
+{
+	unsigned int Lookups;
+	unsigned int MemoryHits;	// Already loaded
+	unsigned int DiskHits;		// Loaded from a compiled file
+	unsigned int Compiles;		// Compiled from source
+	unsigned int Failures;
+
+	void Reset() { Lookups = 0; MemoryHits = 0; DiskHits = 0; Compiles = 0; Failures = 0; }
+
+	// Share of lookups that didn't need a compile
+	float HitRate() const { return Lookups > 0 ? (float)(MemoryHits + DiskHits) / Lookups : 0.0f; }
+};
+
+// --------------------------------------------------------
+// Which compiled variant file goes with which key, and the
+// hash of the source it was compiled from.  Saved next to the
+// compiled variants in the same little endian style as the
+// shader reflection sidecars.
+// --------------------------------------------------------
+struct ShaderVariantCacheEntry
+{
+	ShaderVariantKey Key;
+	unsigned long long SourceHash;
+	std::string FileName;
+};
+
+class ShaderVariantCacheIndex
+{
+public:
+	// The entry for a key, or null if there isn't one
+	const ShaderVariantCacheEntry* Find(ShaderVariantKey key) const;
+
+	// The entry for a key, or null if there isn't one or it was
+	// compiled from a different source
+	const ShaderVariantCacheEntry* Find(ShaderVariantKey key, unsigned long long sourceHash) const;
+
+	void Set(const ShaderVariantCacheEntry& entry);
+	bool Remove(ShaderVariantKey key);
+	void Clear() { entries.clear(); }
+	size_t GetEntryCount() const { return entries.size(); }
+
+	// Converting to and from the file format in memory, in key order
+	void Write(std::vector<unsigned char>& bytes) const;
+	bool Read(const unsigned char* bytes, size_t byteCount);
+
+	// Saving and loading index files.  Both return false on failure.
+	bool Save(const std::string& path) const;
+	bool Load(const std::string& path);
+
+	// FNV-1a 64 of a shader's source, continuing from a seed so
+	// other things (like the permutation layout) can be mixed in
+	static unsigned long long HashSource(const void* source, size_t sourceSize, unsigned long long seed = 14695981039346656037ull);
+
+	// The compiled variant's file name, like "PixelShader_000000000000001c.cso"
+	static std::string MakeFileName(const std::string& baseName, ShaderVariantKey key);
+
+	// "SVIX" and the version of the layout
+	static const unsigned int Magic = 0x58495653;
+	static const unsigned int Version = 1;
+
+private:
+	std::unordered_map<ShaderVariantKey, ShaderVariantCacheEntry> entries;
+};
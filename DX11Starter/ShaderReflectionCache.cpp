@@ -0,0 +1,264 @@
+#include "ShaderReflectionCache.h"
+
+#include <fstream>
+#include <iterator>
+
+// --------------------------------------------------------
+// Little endian helpers for building and walking the file
+// --------------------------------------------------------
+namespace
+{
+	void WriteU8(std::vector<unsigned char>& bytes, unsigned int value)
+	{
+		bytes.push_back((unsigned char)value);
+	}
+
+	void WriteU16(std::vector<unsigned char>& bytes, unsigned int value)
+	{
+		bytes.push_back((unsigned char)(value & 0xFF));
+		bytes.push_back((unsigned char)((value >> 8) & 0xFF));
+	}
+
+	void WriteU32(std::vector<unsigned char>& bytes, unsigned int value)
+	{
+		for (int i = 0; i < 4; i++)
+			bytes.push_back((unsigned char)((value >> (i * 8)) & 0xFF));
+	}
+
+	void WriteU64(std::vector<unsigned char>& bytes, unsigned long long value)
+	{
+		for (int i = 0; i < 8; i++)
+			bytes.push_back((unsigned char)((value >> (i * 8)) & 0xFF));
+	}
+
+	// Names longer than 64KB would be cut short, but no shader has those
+	void WriteString(std::vector<unsigned char>& bytes, const std::string& value)
+	{
+		size_t length = value.size() < 0xFFFF ? value.size() : 0xFFFF;
+		WriteU16(bytes, (unsigned int)length);
+		bytes.insert(bytes.end(), value.begin(), value.begin() + length);
+	}
+
+	// Reads from the front of a byte range, remembering if it ever ran off the end
+	struct Reader
+	{
+		const unsigned char* Next;
+		const unsigned char* End;
+		bool Failed;
+
+		bool Take(size_t count)
+		{
+			if (Failed || (size_t)(End - Next) < count)
+			{
+				Failed = true;
+				return false;
+			}
+			return true;
+		}
+
+		unsigned int U8()
+		{
+			if (!Take(1)) return 0;
+			return *Next++;
+		}
+
+		unsigned int U16()
+		{
+			if (!Take(2)) return 0;
+			unsigned int value = Next[0] | (Next[1] << 8);
+			Next += 2;
+			return value;
+		}
+
+		unsigned int U32()
+		{
+			if (!Take(4)) return 0;
+			unsigned int value = 0;
+			for (int i = 0; i < 4; i++)
+				value |= (unsigned int)Next[i] << (i * 8);
+			Next += 4;
+			return value;
+		}
+
+		unsigned long long U64()
+		{
+			if (!Take(8)) return 0;
+			unsigned long long value = 0;
+			for (int i = 0; i < 8; i++)
+				value |= (unsigned long long)Next[i] << (i * 8);
+			Next += 8;
+			return value;
+		}
+
+		std::string String()
+		{
+			unsigned int length = U16();
+			if (!Take(length)) return std::string();
+			std::string value((const char*)Next, length);
+			Next += length;
+			return value;
+		}
+
+		// Counts come from the file, so don't trust them to size anything
+		// until they're known to fit in what's left of it
+		bool CountFits(unsigned int count, size_t minBytesEach)
+		{
+			if (Failed || (size_t)(End - Next) / minBytesEach < count)
+			{
+				Failed = true;
+				return false;
+			}
+			return true;
+		}
+	};
+}
+
+unsigned long long ShaderReflectionCache::HashByteCode(const void* byteCode, size_t byteCodeSize)
+{
+	const unsigned char* bytes = (const unsigned char*)byteCode;
+	unsigned long long hash = 14695981039346656037ull;
+	for (size_t i = 0; i < byteCodeSize; i++)
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	return hash;
+}
+
+// --------------------------------------------------------
+// Layout (every number little endian):
+//   u32 magic, u32 version, u64 byte code hash
+//   u32 constant buffer count, then for each:
+//     string name, u32 size, u32 bind index,
+//     u32 variable count, then for each: string name, u32 offset, u32 size
+//   u32 resource count, then for each:
+//     string name, u8 type, u32 bind index
+//   u32 input element count, then for each:
+//     string semantic, u32 semantic index, u32 format, u8 per instance
+// --------------------------------------------------------
+void ShaderReflectionCache::Write(const ShaderReflectionData& data, std::vector<unsigned char>& bytes)
+{
+	bytes.clear();
+	WriteU32(bytes, Magic);
+	WriteU32(bytes, Version);
+	WriteU64(bytes, data.ByteCodeHash);
+
+	WriteU32(bytes, (unsigned int)data.ConstantBuffers.size());
+	for (size_t b = 0; b < data.ConstantBuffers.size(); b++)
+	{
+		const ReflectedConstantBuffer& cb = data.ConstantBuffers[b];
+		WriteString(bytes, cb.Name);
+		WriteU32(bytes, cb.Size);
+		WriteU32(bytes, cb.BindIndex);
+		WriteU32(bytes, (unsigned int)cb.Variables.size());
+		for (size_t v = 0; v < cb.Variables.size(); v++)
+		{
+			WriteString(bytes, cb.Variables[v].Name);
+			WriteU32(bytes, cb.Variables[v].ByteOffset);
+			WriteU32(bytes, cb.Variables[v].Size);
+		}
+	}
+
+	WriteU32(bytes, (unsigned int)data.Resources.size());
+	for (size_t r = 0; r < data.Resources.size(); r++)
+	{
+		WriteString(bytes, data.Resources[r].Name);
+		WriteU8(bytes, data.Resources[r].Type);
+		WriteU32(bytes, data.Resources[r].BindIndex);
+	}
+
+	WriteU32(bytes, (unsigned int)data.InputElements.size());
+	for (size_t e = 0; e < data.InputElements.size(); e++)
+	{
+		WriteString(bytes, data.InputElements[e].SemanticName);
+		WriteU32(bytes, data.InputElements[e].SemanticIndex);
+		WriteU32(bytes, data.InputElements[e].Format);
+		WriteU8(bytes, data.InputElements[e].PerInstance ? 1 : 0);
+	}
+}
+
+bool ShaderReflectionCache::Read(const unsigned char* bytes, size_t byteCount, ShaderReflectionData& data)
+{
+	Reader reader = { bytes, bytes + byteCount, bytes == 0 };
+	if (reader.U32() != Magic || reader.U32() != Version)
+		return false;
+
+	ShaderReflectionData result;
+	result.ByteCodeHash = reader.U64();
+
+	unsigned int cbCount = reader.U32();
+	if (!reader.CountFits(cbCount, 14))
+		return false;
+	result.ConstantBuffers.resize(cbCount);
+	for (unsigned int b = 0; b < cbCount && !reader.Failed; b++)
+	{
+		ReflectedConstantBuffer& cb = result.ConstantBuffers[b];
+		cb.Name = reader.String();
+		cb.Size = reader.U32();
+		cb.BindIndex = reader.U32();
+
+		unsigned int variableCount = reader.U32();
+		if (!reader.CountFits(variableCount, 10))
+			return false;
+		cb.Variables.resize(variableCount);
+		for (unsigned int v = 0; v < variableCount; v++)
+		{
+			cb.Variables[v].Name = reader.String();
+			cb.Variables[v].ByteOffset = reader.U32();
+			cb.Variables[v].Size = reader.U32();
+		}
+	}
+
+	unsigned int resourceCount = reader.U32();
+	if (!reader.CountFits(resourceCount, 7))
+		return false;
+	result.Resources.resize(resourceCount);
+	for (unsigned int r = 0; r < resourceCount; r++)
+	{
+		result.Resources[r].Name = reader.String();
+		unsigned int type = reader.U8();
+		if (type > REFLECTED_SAMPLER)
+			return false;
+		result.Resources[r].Type = (ReflectedResourceType)type;
+		result.Resources[r].BindIndex = reader.U32();
+	}
+
+	unsigned int elementCount = reader.U32();
+	if (!reader.CountFits(elementCount, 11))
+		return false;
+	result.InputElements.resize(elementCount);
+	for (unsigned int e = 0; e < elementCount; e++)
+	{
+		result.InputElements[e].SemanticName = reader.String();
+		result.InputElements[e].SemanticIndex = reader.U32();
+		result.InputElements[e].Format = reader.U32();
+		result.InputElements[e].PerInstance = reader.U8() != 0;
+	}
+
+	// Anything left over means it isn't the file we think it is
+	if (reader.Failed || reader.Next != reader.End)
+		return false;
+
+	data = result;
+	return true;
+}
+
+bool ShaderReflectionCache::Save(const std::string& path, const ShaderReflectionData& data)
+{
+	std::vector<unsigned char> bytes;
+	Write(data, bytes);
+
+	std::ofstream file(path.c_str(), std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	file.write((const char*)&bytes[0], bytes.size());
+	return file.good();
+}
+
+bool ShaderReflectionCache::Load(const std::string& path, ShaderReflectionData& data)
+{
+	std::ifstream file(path.c_str(), std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	return Read(bytes.empty() ? 0 : &bytes[0], bytes.size(), data);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// What a shader's reflection says about it, in plain types so
+// it can be saved and loaded without the DirectX reflection
+// API.  This is everything SimpleShader needs to fill in its
+// tables and make an input layout.
+// --------------------------------------------------------
+struct ReflectedVariable
+{
+	std::string Name;
+	unsigned int ByteOffset;
+	unsigned int Size;
+};
+
+struct ReflectedConstantBuffer
+{
+	std::string Name;
+	unsigned int Size;
+	unsigned int BindIndex;
+	std::vector<ReflectedVariable> Variables;
+};
+
+enum ReflectedResourceType
+{
+	REFLECTED_SHADER_RESOURCE,	// Textures and structured buffers
+	REFLECTED_SAMPLER
+};
+
+struct ReflectedResource
+{
+	std::string Name;
+	ReflectedResourceType Type;
+	unsigned int BindIndex;
+};
+
+// Vertex shader inputs, in order.  Per instance elements come
+// from input slot 1, everything else from slot 0.
+struct ReflectedInputElement
+{
+	std::string SemanticName;
+	unsigned int SemanticIndex;
+	unsigned int Format;		// DXGI_FORMAT
+	bool PerInstance;
+};
+
+struct ShaderReflectionData
+{
+	unsigned long long ByteCodeHash;	// Of the compiled shader it describes
+	std::vector<ReflectedConstantBuffer> ConstantBuffers;
+	std::vector<ReflectedResource> Resources;
+	std::vector<ReflectedInputElement> InputElements;
+};
+
+// --------------------------------------------------------
+// Reads and writes reflection data as a small binary sidecar
+// file, saved next to the compiled shader it came from.
+//
+// The format is little endian whatever the machine, with
+// strings stored as a 16 bit length and their bytes, so a file
+// written on one platform reads the same on any other.  Files
+// with the wrong magic number or version, or that end early,
+// fail to load instead of producing half filled data.
+// --------------------------------------------------------
+class ShaderReflectionCache
+{
+public:
+	// FNV-1a 64 of a shader's byte code, to tell when a sidecar
+	// no longer matches the shader next to it
+	static unsigned long long HashByteCode(const void* byteCode, size_t byteCodeSize);
+
+	// Converting to and from the file format in memory
+	static void Write(const ShaderReflectionData& data, std::vector<unsigned char>& bytes);
+	static bool Read(const unsigned char* bytes, size_t byteCount, ShaderReflectionData& data);
+
+	// Saving and loading sidecar files.  Both return false on failure.
+	static bool Save(const std::string& path, const ShaderReflectionData& data);
+	static bool Load(const std::string& path, ShaderReflectionData& data);
+
+	// "SRFL" and the version of the layout below it
+	static const unsigned int Magic = 0x4C465253;
+	static const unsigned int Version = 1;
+};
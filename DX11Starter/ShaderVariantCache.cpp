@@ -0,0 +1,318 @@
+#include "ShaderVariantCache.h"
+
+#include <fstream>
+#include <iterator>
+
+ShaderVariantCache::ShaderVariantCache(IRenderDevice* renderDevice, const ShaderPermutationSet& permutations, LPCWSTR sourceFile, const char* target, LPCWSTR cacheDirectory)
+{
+	this->renderDevice = renderDevice;
+	this->permutations = permutations;
+	this->sourceFile = sourceFile;
+	this->target = target;
+	this->cacheDirectory = cacheDirectory;
+	if (!this->cacheDirectory.empty() && this->cacheDirectory.back() != L'/' && this->cacheDirectory.back() != L'\\')
+		this->cacheDirectory += L'/';
+
+	// Compiled variants are named after the source file, without its
+	// folder or extension.  Anything that isn't plain ASCII becomes _
+	size_t nameStart = this->sourceFile.find_last_of(L"/\\");
+	nameStart = nameStart == std::wstring::npos ? 0 : nameStart + 1;
+	size_t nameEnd = this->sourceFile.find_last_of(L'.');
+	if (nameEnd == std::wstring::npos || nameEnd < nameStart)
+		nameEnd = this->sourceFile.size();
+	for (size_t i = nameStart; i < nameEnd; i++)
+	{
+		wchar_t c = this->sourceFile[i];
+		baseName += c < 128 ? (char)c : '_';
+	}
+
+	sourceHash = 0;
+	sourceHashed = false;
+	indexLoaded = false;
+	indexChanged = false;
+	renderContext = 0;
+	uploadRing = 0;
+	stats.Reset();
+}
+
+ShaderVariantCache::~ShaderVariantCache()
+{
+	SaveIndex();
+
+	for (size_t i = 0; i < loadedVariants.size(); i++)
+		delete loadedVariants[i];
+}
+
+void ShaderVariantCache::AddPrecompiled(ShaderVariantKey key, LPCWSTR compiledFile)
+{
+	precompiledFiles[key] = compiledFile;
+}
+
+// --------------------------------------------------------
+// Finds or loads a variant.  Keys that failed once stay failed,
+// so a broken variant doesn't try to compile every frame.
+// --------------------------------------------------------
+ISimpleShader* ShaderVariantCache::GetVariant(ShaderVariantKey key)
+{
+	stats.Lookups++;
+
+	std::unordered_map<ShaderVariantKey, ISimpleShader*>::iterator it = variants.find(key);
+	if (it != variants.end())
+	{
+		if (it->second)
+			stats.MemoryHits++;
+		else
+			stats.Failures++;
+		return it->second;
+	}
+
+	if (!permutations.IsValidKey(key))
+	{
+		stats.Failures++;
+		return 0;
+	}
+
+	// A precompiled file for this key comes first
+	ISimpleShader* shader = 0;
+	std::unordered_map<ShaderVariantKey, std::wstring>::iterator precompiled = precompiledFiles.find(key);
+	if (precompiled != precompiledFiles.end())
+		shader = LoadVariant(precompiled->second);
+
+	// Then the disk cache, as long as the source hasn't changed
+	if (!shader)
+	{
+		LoadIndex();
+		unsigned long long hash = GetSourceHash();
+		const ShaderVariantCacheEntry* entry = hash ? index.Find(key, hash) : index.Find(key);
+		if (entry)
+			shader = LoadVariant(GetVariantFile(entry->FileName));
+	}
+
+	if (shader)
+	{
+		stats.DiskHits++;
+	}
+	else if (CompileVariant(key))
+	{
+		// Compiling puts it in the disk cache, so it loads like any other
+		shader = LoadVariant(GetVariantFile(index.Find(key)->FileName));
+		if (shader)
+			stats.Compiles++;
+	}
+
+	variants[key] = shader;
+	if (!shader)
+	{
+		stats.Failures++;
+		return 0;
+	}
+
+	loadedVariants.push_back(shader);
+	return shader;
+}
+
+SimpleVertexShader* ShaderVariantCache::GetVertexShader(ShaderVariantKey key)
+{
+	return target.compare(0, 3, "vs_") == 0 ? (SimpleVertexShader*)GetVariant(key) : 0;
+}
+
+SimplePixelShader* ShaderVariantCache::GetPixelShader(ShaderVariantKey key)
+{
+	return target.compare(0, 3, "ps_") == 0 ? (SimplePixelShader*)GetVariant(key) : 0;
+}
+
+unsigned int ShaderVariantCache::PrecompileAll()
+{
+	LoadIndex();
+	unsigned long long hash = GetSourceHash();
+
+	unsigned int failures = 0;
+	ShaderVariantKey key;
+	for (unsigned long long i = 0; permutations.GetVariantKey(i, key); i++)
+	{
+		if (precompiledFiles.count(key) || (hash && index.Find(key, hash)))
+			continue;
+		if (!CompileVariant(key))
+			failures++;
+	}
+
+	SaveIndex();
+	return failures;
+}
+
+bool ShaderVariantCache::SaveIndex()
+{
+	if (!indexChanged)
+		return true;
+
+	std::vector<unsigned char> bytes;
+	index.Write(bytes);
+
+	MakeDirectory(cacheDirectory);
+	std::ofstream file(GetFileStreamPath(GetIndexFile()).c_str(), std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	file.write((const char*)&bytes[0], bytes.size());
+	indexChanged = !file.good();
+	return !indexChanged;
+}
+
+void ShaderVariantCache::SetRenderContext(IRenderContext* renderContext)
+{
+	this->renderContext = renderContext;
+	for (size_t i = 0; i < loadedVariants.size(); i++)
+		loadedVariants[i]->SetRenderContext(renderContext);
+}
+
+void ShaderVariantCache::SetConstantUploadRing(ConstantUploadRing* uploadRing)
+{
+	this->uploadRing = uploadRing;
+	for (size_t i = 0; i < loadedVariants.size(); i++)
+		loadedVariants[i]->SetConstantUploadRing(uploadRing);
+}
+
+// --------------------------------------------------------
+// Hashes the source along with the target and the permutation
+// layout, since changing any of them changes what compiles.
+// Included files aren't followed, so changing only those needs
+// the cache directory cleared.
+// --------------------------------------------------------
+unsigned long long ShaderVariantCache::GetSourceHash()
+{
+	if (sourceHashed)
+		return sourceHash;
+	sourceHashed = true;
+
+	std::ifstream file(GetFileStreamPath(sourceFile).c_str(), std::ios::binary);
+	if (!file.is_open())
+		return sourceHash;
+
+	std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	unsigned long long hash = permutations.GetLayoutHash();
+	hash = ShaderVariantCacheIndex::HashSource(target.c_str(), target.size() + 1, hash);
+	hash = ShaderVariantCacheIndex::HashSource(bytes.empty() ? 0 : &bytes[0], bytes.size(), hash);
+
+	// Zero means there's no source
+	sourceHash = hash ? hash : 1;
+	return sourceHash;
+}
+
+void ShaderVariantCache::LoadIndex()
+{
+	if (indexLoaded)
+		return;
+	indexLoaded = true;
+
+	std::ifstream file(GetFileStreamPath(GetIndexFile()).c_str(), std::ios::binary);
+	if (!file.is_open())
+		return;
+
+	std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (!index.Read(bytes.empty() ? 0 : &bytes[0], bytes.size()))
+		index.Clear();
+}
+
+std::wstring ShaderVariantCache::GetIndexFile()
+{
+	return GetVariantFile(baseName + ".variants");
+}
+
+std::wstring ShaderVariantCache::GetVariantFile(const std::string& fileName)
+{
+	return cacheDirectory + std::wstring(fileName.begin(), fileName.end());
+}
+
+// --------------------------------------------------------
+// Only Windows has a shader compiler, so everywhere else only
+// variants that are already in the cache can be loaded
+// --------------------------------------------------------
+bool ShaderVariantCache::CompileVariant(ShaderVariantKey key)
+{
+#ifndef _WIN32
+	(void)key;
+	return false;
+#else
+	// Nothing to compile without the source
+	if (!GetSourceHash())
+		return false;
+
+	// The key's feature values, as defines ending with an empty one
+	std::vector<ShaderDefine> defines = permutations.GetDefines(key);
+	std::vector<D3D_SHADER_MACRO> macros;
+	for (size_t d = 0; d < defines.size(); d++)
+	{
+		D3D_SHADER_MACRO macro = { defines[d].Name.c_str(), defines[d].Value.c_str() };
+		macros.push_back(macro);
+	}
+	D3D_SHADER_MACRO end = { 0, 0 };
+	macros.push_back(end);
+
+	UINT flags = D3DCOMPILE_ENABLE_STRICTNESS;
+#if defined(DEBUG) || defined(_DEBUG)
+	flags |= D3DCOMPILE_DEBUG;
+#else
+	flags |= D3DCOMPILE_OPTIMIZATION_LEVEL3;
+#endif
+
+	ID3DBlob* blob = 0;
+	ID3DBlob* errors = 0;
+	HRESULT hr = D3DCompileFromFile(
+		sourceFile.c_str(),
+		&macros[0],
+		D3D_COMPILE_STANDARD_FILE_INCLUDE,
+		"main",
+		target.c_str(),
+		flags,
+		0,
+		&blob,
+		&errors);
+
+	if (errors)
+	{
+		OutputDebugStringA((const char*)errors->GetBufferPointer());
+		errors->Release();
+	}
+	if (FAILED(hr))
+		return false;
+
+	// Save it to the disk cache and remember which file it went in
+	ShaderVariantCacheEntry entry;
+	entry.Key = key;
+	entry.SourceHash = sourceHash;
+	entry.FileName = ShaderVariantCacheIndex::MakeFileName(baseName, key);
+
+	MakeDirectory(cacheDirectory);
+	hr = D3DWriteBlobToFile(blob, GetVariantFile(entry.FileName).c_str(), TRUE);
+	blob->Release();
+	if (FAILED(hr))
+		return false;
+
+	index.Set(entry);
+	indexChanged = true;
+	return true;
+#endif
+}
+
+ISimpleShader* ShaderVariantCache::LoadVariant(const std::wstring& compiledFile)
+{
+	ISimpleShader* shader = 0;
+	if (target.compare(0, 3, "vs_") == 0)
+		shader = new SimpleVertexShader(renderDevice);
+	else if (target.compare(0, 3, "ps_") == 0)
+		shader = new SimplePixelShader(renderDevice);
+	else
+		return 0;
+
+	if (!shader->LoadShaderFile(compiledFile.c_str()))
+	{
+		delete shader;
+		return 0;
+	}
+
+	if (renderContext)
+		shader->SetRenderContext(renderContext);
+	if (uploadRing)
+		shader->SetConstantUploadRing(uploadRing);
+	return shader;
+}
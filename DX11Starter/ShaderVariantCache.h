@@ -0,0 +1,90 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "SimpleShader.h"
+#include "ShaderPermutations.h"
+
+// --------------------------------------------------------
+// Every variant of one shader source file, found by key.
+//
+// Variants are loaded the first time they're asked for: from
+// a precompiled file given for that key, then from the disk
+// cache if it has one compiled from the same source, and only
+// compiled from source if neither works.  Compiled variants are
+// written to the cache directory with an index of which file
+// is which, so they only ever compile once.
+//
+// Only vertex and pixel shader targets ("vs_5_0", "ps_5_0")
+// are supported, since only those load through a render device.
+// --------------------------------------------------------
+class ShaderVariantCache
+{
+public:
+	ShaderVariantCache(IRenderDevice* renderDevice, const ShaderPermutationSet& permutations, LPCWSTR sourceFile, const char* target, LPCWSTR cacheDirectory); // Constructor
+	~ShaderVariantCache(); // Destructor
+
+	// A compiled file to use for a key instead of the disk cache,
+	// like the build's own .cso for the default variant
+	void AddPrecompiled(ShaderVariantKey key, LPCWSTR compiledFile);
+
+	// The variant for a key, or null if it couldn't be loaded or
+	// compiled.  The cache owns every variant it returns.
+	ISimpleShader* GetVariant(ShaderVariantKey key);
+	SimpleVertexShader* GetVertexShader(ShaderVariantKey key);
+	SimplePixelShader* GetPixelShader(ShaderVariantKey key);
+
+	// Compiles every variant the disk cache is missing, for running
+	// as an offline step.  Returns how many failed to compile.
+	unsigned int PrecompileAll();
+
+	// Writes the index of compiled variants, if it's changed
+	bool SaveIndex();
+
+	// Variants loaded so far, in the order they were loaded
+	size_t GetLoadedVariantCount() { return loadedVariants.size(); }
+	ISimpleShader* GetLoadedVariant(size_t index) { return loadedVariants[index]; }
+
+	const ShaderPermutationSet& GetPermutations() { return permutations; }
+	const ShaderVariantStats& GetStats() { return stats; }
+	void ResetStats() { stats.Reset(); }
+
+	// Applied to every variant as it's loaded
+	void SetRenderContext(IRenderContext* renderContext);
+	void SetConstantUploadRing(ConstantUploadRing* uploadRing);
+
+private:
+	IRenderDevice* renderDevice;
+	ShaderPermutationSet permutations;
+	std::wstring sourceFile;
+	std::string target;
+	std::wstring cacheDirectory;
+	std::string baseName;
+
+	// Hash of the source and the permutation layout, worked out the
+	// first time it's needed.  Zero if the source couldn't be read,
+	// in which case the disk cache is trusted as it is.
+	unsigned long long sourceHash;
+	bool sourceHashed;
+
+	ShaderVariantCacheIndex index;
+	bool indexLoaded;
+	bool indexChanged;
+
+	std::unordered_map<ShaderVariantKey, std::wstring> precompiledFiles;
+	std::unordered_map<ShaderVariantKey, ISimpleShader*> variants;
+	std::vector<ISimpleShader*> loadedVariants;
+
+	IRenderContext* renderContext;
+	ConstantUploadRing* uploadRing;
+	ShaderVariantStats stats;
+
+	// Helpers
+	unsigned long long GetSourceHash();
+	void LoadIndex();
+	std::wstring GetIndexFile();
+	std::wstring GetVariantFile(const std::string& fileName);
+	bool CompileVariant(ShaderVariantKey key);
+	ISimpleShader* LoadVariant(const std::wstring& compiledFile);
+};
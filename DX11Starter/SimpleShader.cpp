@@ -1,9 +1,22 @@
 #include "SimpleShader.h"
 
+#ifdef _WIN32
+#include "D3D11RenderDevice.h"
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+bool ISimpleShader::reflectionCacheEnabled = true;
+InputLayoutCache* SimpleVertexShader::inputLayoutCache = 0;
+
 ///////////////////////////////////////////////////////////////////////////////
 // ------ BASE SIMPLE SHADER --------------------------------------------------
 ///////////////////////////////////////////////////////////////////////////////
 
+#ifdef _WIN32
 // --------------------------------------------------------
 // Constructor accepts DirectX device & context
 // --------------------------------------------------------
@@ -13,10 +26,45 @@ ISimpleShader::ISimpleShader(ID3D11Device* device, ID3D11DeviceContext* context)
 	this->device = device;
 	this->deviceContext = context;
 
+	// Wrap them so everything can be created the same way
+	ownedRenderDevice = new D3D11RenderDevice(device, context);
+	renderDevice = ownedRenderDevice;
+	renderContext = renderDevice->GetImmediateContext();
+	uploadRing = 0;
+
 	// Set up fields
 	constantBufferCount = 0;
 	constantBuffers = 0;
-	shaderBlob = 0;
+	loadedFromReflectionCache = false;
+	ResetUploadStats();
+	ResetBindStats();
+}
+#endif
+
+// --------------------------------------------------------
+// Constructor overload that creates everything through a
+// render device, which may not be backed by DirectX at all.
+// Only vertex and pixel shaders support this.
+// --------------------------------------------------------
+ISimpleShader::ISimpleShader(IRenderDevice* renderDevice)
+{
+#ifdef _WIN32
+	// No DirectX device to save
+	this->device = 0;
+	this->deviceContext = 0;
+#endif
+
+	this->ownedRenderDevice = 0;
+	this->renderDevice = renderDevice;
+	this->renderContext = renderDevice->GetImmediateContext();
+	this->uploadRing = 0;
+
+	// Set up fields
+	constantBufferCount = 0;
+	constantBuffers = 0;
+	loadedFromReflectionCache = false;
+	ResetUploadStats();
+	ResetBindStats();
 }
 
 // --------------------------------------------------------
@@ -25,8 +73,7 @@ ISimpleShader::ISimpleShader(ID3D11Device* device, ID3D11DeviceContext* context)
 ISimpleShader::~ISimpleShader()
 {
 	// Derived class destructors will call this class's CleanUp method
-	if(shaderBlob)
-		shaderBlob->Release();
+	delete ownedRenderDevice;
 }
 
 // --------------------------------------------------------
@@ -38,7 +85,7 @@ void ISimpleShader::CleanUp()
 	// Handle constant buffers and local data buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		constantBuffers[i].ConstantBuffer->Release();
+		renderDevice->Release(constantBuffers[i].ConstantBuffer);
 		delete[] constantBuffers[i].LocalDataBuffer;
 	}
 
@@ -48,13 +95,10 @@ void ISimpleShader::CleanUp()
 		constantBufferCount = 0;
 	}
 
-	for (unsigned int i = 0; i < shaderResourceViews.size(); i++)
-		delete shaderResourceViews[i];
-	
-	for (unsigned int i = 0; i < samplerStates.size(); i++)
-		delete samplerStates[i];
-
-	// Clean up tables
+	// Clean up the arrays and tables
+	variables.clear();
+	shaderResourceViews.clear();
+	samplerStates.clear();
 	varTable.clear();
 	cbTable.clear();
 	samplerTable.clear();
@@ -66,83 +110,216 @@ void ISimpleShader::CleanUp()
 // reflection.  This must be a separate step from the constructor since
 // we can't invoke derived class overrides in the base class constructor.
 //
+// The reflection comes from a sidecar file next to the compiled shader
+// when there's one that matches it, otherwise from DirectX, and is then
+// saved as a sidecar so the next load can skip reflecting.
+//
 // shaderFile - A "wide string" specifying the compiled shader to load
 // 
 // Returns true if shader is loaded properly, false otherwise
 // --------------------------------------------------------
 bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 {
-	// Load the shader to a blob and ensure it worked
-	HRESULT hr = D3DReadFileToBlob(shaderFile, &shaderBlob);
-	if (hr != S_OK)
-	{
+	// Load the shader's byte code and ensure it worked
+	std::ifstream file(GetFileStreamPath(shaderFile).c_str(), std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	byteCode.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	if (byteCode.empty())
 		return false;
+
+	// Find out what's in the shader, from the sidecar if it's up to date
+	std::wstring sidecarFile = std::wstring(shaderFile) + L".refl";
+	unsigned long long byteCodeHash = ShaderReflectionCache::HashByteCode(&byteCode[0], byteCode.size());
+
+	loadedFromReflectionCache =
+		reflectionCacheEnabled &&
+		LoadReflectionSidecar(sidecarFile, reflection) &&
+		reflection.ByteCodeHash == byteCodeHash;
+
+	if (!loadedFromReflectionCache)
+	{
+		if (!ReflectShader(&byteCode[0], byteCode.size(), reflection))
+			return false;
+
+		reflection.ByteCodeHash = byteCodeHash;
+		if (reflectionCacheEnabled)
+			SaveReflectionSidecar(sidecarFile, reflection);
 	}
 
 	// Create the shader - Calls an overloaded version of this abstract
 	// method in the appropriate child class
-	shaderValid = CreateShader(shaderBlob);
+	shaderValid = CreateShader(&byteCode[0], byteCode.size());
 	if (!shaderValid)
 	{
 		return false;
 	}
 
+	// Handle bound resources (like shaders and samplers)
+	for (size_t r = 0; r < reflection.Resources.size(); r++)
+	{
+		const ReflectedResource& resource = reflection.Resources[r];
+		if (resource.Type == REFLECTED_SHADER_RESOURCE)
+		{
+			// Add the SRV's info to the array
+			SimpleSRV srv;
+			srv.BindIndex = resource.BindIndex;						// Shader bind point
+			srv.Index = (unsigned int)shaderResourceViews.size();	// Raw index
+
+			AddName(textureTable, resource.Name.c_str(), srv.Index);
+			shaderResourceViews.push_back(srv);
+		}
+		else
+		{
+			// Add the sampler's info to the array
+			SimpleSampler samp;
+			samp.BindIndex = resource.BindIndex;				// Shader bind point
+			samp.Index = (unsigned int)samplerStates.size();	// Raw index
+
+			AddName(samplerTable, resource.Name.c_str(), samp.Index);
+			samplerStates.push_back(samp);
+		}
+	}
+
+	// Room to stage everything up to the highest slot used
+	unsigned int srvSlots = 0;
+	unsigned int samplerSlots = 0;
+	for (size_t i = 0; i < shaderResourceViews.size(); i++)
+	{
+		if (shaderResourceViews[i].BindIndex >= srvSlots)
+			srvSlots = shaderResourceViews[i].BindIndex + 1;
+	}
+	for (size_t i = 0; i < samplerStates.size(); i++)
+	{
+		if (samplerStates[i].BindIndex >= samplerSlots)
+			samplerSlots = samplerStates[i].BindIndex + 1;
+	}
+	stagedShaderResourceViews.Resize(srvSlots);
+	stagedSamplers.Resize(samplerSlots);
+
+	// Create resource arrays
+	constantBufferCount = (unsigned int)reflection.ConstantBuffers.size();
+	constantBuffers = new SimpleConstantBuffer[constantBufferCount];
+
+	// Loop through all constant buffers
+	for (unsigned int b = 0; b < constantBufferCount; b++)
+	{
+		const ReflectedConstantBuffer& bufferDesc = reflection.ConstantBuffers[b];
+
+		// Set up the buffer and put its pointer in the table
+		constantBuffers[b].BindIndex = bufferDesc.BindIndex;
+		constantBuffers[b].Name = bufferDesc.Name;
+		AddName(cbTable, bufferDesc.Name.c_str(), b);
+
+		// Create this constant buffer
+		BufferDesc newBuffDesc = {};
+		newBuffDesc.Usage = BUFFER_USAGE_DEFAULT;
+		newBuffDesc.ByteWidth = bufferDesc.Size;
+		newBuffDesc.BindFlags = BUFFER_BIND_CONSTANT;
+		constantBuffers[b].ConstantBuffer = renderDevice->CreateBuffer(newBuffDesc, 0);
+		constantBuffers[b].Slice = {};
+		constantBuffers[b].SliceFrame = 0;
+
+		// Set up the data buffer for this constant buffer
+		constantBuffers[b].Size = bufferDesc.Size;
+		constantBuffers[b].LocalDataBuffer = new unsigned char[bufferDesc.Size];
+		memset(constantBuffers[b].LocalDataBuffer, 0, bufferDesc.Size);
+
+		// Nothing has been uploaded yet, so the whole buffer starts dirty
+		constantBuffers[b].Dirty = true;
+		constantBuffers[b].DirtyStart = 0;
+		constantBuffers[b].DirtyEnd = bufferDesc.Size;
+		constantBuffers[b].External = false;
+
+		// Loop through all variables in this buffer
+		for (size_t v = 0; v < bufferDesc.Variables.size(); v++)
+		{
+			const ReflectedVariable& varDesc = bufferDesc.Variables[v];
+
+			// Create the variable struct
+			SimpleShaderVariable varStruct;
+			varStruct.ConstantBufferIndex = b;
+			varStruct.ByteOffset = varDesc.ByteOffset;
+			varStruct.Size = varDesc.Size;
+			
+			// Add this variable to the table and the constant buffer
+			AddName(varTable, varDesc.Name.c_str(), (unsigned int)variables.size());
+			variables.push_back(varStruct);
+			constantBuffers[b].Variables.push_back(varStruct);
+		}
+	}
+
+	// Sort the names so they can be binary searched
+	SortNames(cbTable);
+	SortNames(varTable);
+	SortNames(textureTable);
+	SortNames(samplerTable);
+
+	// All set
+	return true;
+}
+
+// --------------------------------------------------------
+// Gets everything LoadShaderFile needs from the shader's byte
+// code through DirectX's shader reflection.  There's nothing
+// to reflect with off Windows, so that always fails there.
+// --------------------------------------------------------
+bool ISimpleShader::ReflectShader(const void* byteCode, size_t byteCodeSize, ShaderReflectionData& data)
+{
+#ifndef _WIN32
+	(void)byteCode;
+	(void)byteCodeSize;
+	(void)data;
+	return false;
+#else
 	// Set up shader reflection to get information about
 	// this shader and its variables,  buffers, etc.
 	ID3D11ShaderReflection* refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
+	HRESULT hr = D3DReflect(
+		byteCode,
+		byteCodeSize,
 		IID_ID3D11ShaderReflection,
 		(void**)&refl);
+	if (FAILED(hr))
+		return false;
 	
 	// Get the description of the shader
 	D3D11_SHADER_DESC shaderDesc;
 	refl->GetDesc(&shaderDesc);
 
-	// Create resource arrays
-	constantBufferCount = shaderDesc.ConstantBuffers;
-	constantBuffers = new SimpleConstantBuffer[constantBufferCount];
-	
+	data = ShaderReflectionData();
+
 	// Handle bound resources (like shaders and samplers)
-	unsigned int resourceCount = shaderDesc.BoundResources;
-	for (unsigned int r = 0; r < resourceCount; r++)
+	for (unsigned int r = 0; r < shaderDesc.BoundResources; r++)
 	{
 		// Get this resource's description
 		D3D11_SHADER_INPUT_BIND_DESC resourceDesc;
 		refl->GetResourceBindingDesc(r, &resourceDesc);
 
+		ReflectedResource resource;
+		resource.Name = resourceDesc.Name;
+		resource.BindIndex = resourceDesc.BindPoint;
+
 		// Check the type
 		switch (resourceDesc.Type)
 		{
 		case D3D_SIT_TEXTURE: // A texture resource
-		{
-			// Create the SRV wrapper
-			SimpleSRV* srv = new SimpleSRV();
-			srv->BindIndex = resourceDesc.BindPoint;				// Shader bind point
-			srv->Index = (unsigned int)shaderResourceViews.size();	// Raw index
-
-			textureTable.insert(std::pair<std::string, SimpleSRV*>(resourceDesc.Name, srv));
-			shaderResourceViews.push_back(srv);
-		}
+		case D3D_SIT_STRUCTURED: // A structured buffer, also bound as a shader resource view
+			resource.Type = REFLECTED_SHADER_RESOURCE;
+			data.Resources.push_back(resource);
 			break;
 
 		case D3D_SIT_SAMPLER: // A sampler resource
-		{
-			// Create the sampler wrapper
-			SimpleSampler* samp = new SimpleSampler();
-			samp->BindIndex = resourceDesc.BindPoint;			// Shader bind point
-			samp->Index = (unsigned int)samplerStates.size();	// Raw index
-
-			samplerTable.insert(std::pair<std::string, SimpleSampler*>(resourceDesc.Name, samp));
-			samplerStates.push_back(samp);
-		}
+			resource.Type = REFLECTED_SAMPLER;
+			data.Resources.push_back(resource);
 			break;
 		}
 	}
 
 	// Loop through all constant buffers
-	for (unsigned int b = 0; b < constantBufferCount; b++)
+	data.ConstantBuffers.resize(shaderDesc.ConstantBuffers);
+	for (unsigned int b = 0; b < shaderDesc.ConstantBuffers; b++)
 	{
 		// Get this buffer
 		ID3D11ShaderReflectionConstantBuffer* cb =
@@ -156,56 +333,162 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		// we know exactly how it's bound in the shader
 		D3D11_SHADER_INPUT_BIND_DESC bindDesc;
 		refl->GetResourceBindingDescByName(bufferDesc.Name, &bindDesc);
-		
-		// Set up the buffer and put its pointer in the table
-		constantBuffers[b].BindIndex = bindDesc.BindPoint;
-		constantBuffers[b].Name = bufferDesc.Name;
-		cbTable.insert(std::pair<std::string, SimpleConstantBuffer*>(bufferDesc.Name, &constantBuffers[b]));
 
-		// Create this constant buffer
-		D3D11_BUFFER_DESC newBuffDesc;
-		newBuffDesc.Usage = D3D11_USAGE_DEFAULT;
-		newBuffDesc.ByteWidth = bufferDesc.Size;
-		newBuffDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-		newBuffDesc.CPUAccessFlags = 0;
-		newBuffDesc.MiscFlags = 0;
-		newBuffDesc.StructureByteStride = 0;
-		device->CreateBuffer(&newBuffDesc, 0, &constantBuffers[b].ConstantBuffer);
-
-		// Set up the data buffer for this constant buffer
-		constantBuffers[b].Size = bufferDesc.Size;
-		constantBuffers[b].LocalDataBuffer = new unsigned char[bufferDesc.Size];
-		ZeroMemory(constantBuffers[b].LocalDataBuffer, bufferDesc.Size);
+		ReflectedConstantBuffer& buffer = data.ConstantBuffers[b];
+		buffer.Name = bufferDesc.Name;
+		buffer.Size = bufferDesc.Size;
+		buffer.BindIndex = bindDesc.BindPoint;
 
 		// Loop through all variables in this buffer
+		buffer.Variables.resize(bufferDesc.Variables);
 		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
 		{
-			// Get this variable
-			ID3D11ShaderReflectionVariable* var =
-				cb->GetVariableByIndex(v);
-			
-			// Get the description of the variable and its type
+			// Get the description of the variable
 			D3D11_SHADER_VARIABLE_DESC varDesc;
-			var->GetDesc(&varDesc);
+			cb->GetVariableByIndex(v)->GetDesc(&varDesc);
 
-			// Create the variable struct
-			SimpleShaderVariable varStruct;
-			varStruct.ConstantBufferIndex = b;
-			varStruct.ByteOffset = varDesc.StartOffset;
-			varStruct.Size = varDesc.Size;
-			
-			// Get a string version
-			std::string varName(varDesc.Name);
+			buffer.Variables[v].Name = varDesc.Name;
+			buffer.Variables[v].ByteOffset = varDesc.StartOffset;
+			buffer.Variables[v].Size = varDesc.Size;
+		}
+	}
 
-			// Add this variable to the table and the constant buffer
-			varTable.insert(std::pair<std::string, SimpleShaderVariable>(varName, varStruct));
-			constantBuffers[b].Variables.push_back(varStruct);
+	// Vertex shader inputs, for making an input layout.  Other
+	// stages have inputs too, but nothing needs them.
+	D3D11_SHADER_VERSION_TYPE shaderType = (D3D11_SHADER_VERSION_TYPE)D3D11_SHVER_GET_TYPE(shaderDesc.Version);
+	for (unsigned int i = 0; shaderType == D3D11_SHVER_VERTEX_SHADER && i < shaderDesc.InputParameters; i++)
+	{
+		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
+		refl->GetInputParameterDesc(i, &paramDesc);
+
+		// Check the semantic name for "_PER_INSTANCE"
+		std::string perInstanceStr = "_PER_INSTANCE";
+		std::string sem = paramDesc.SemanticName;
+		int lenDiff = (int)sem.size() - (int)perInstanceStr.size();
+
+		ReflectedInputElement element;
+		element.SemanticName = sem;
+		element.SemanticIndex = paramDesc.SemanticIndex;
+		element.Format = DXGI_FORMAT_UNKNOWN;
+		element.PerInstance =
+			lenDiff >= 0 &&
+			sem.compare(lenDiff, perInstanceStr.size(), perInstanceStr) == 0;
+
+		// Determine DXGI format
+		if (paramDesc.Mask == 1)
+		{
+			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) element.Format = DXGI_FORMAT_R32_UINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) element.Format = DXGI_FORMAT_R32_SINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) element.Format = DXGI_FORMAT_R32_FLOAT;
 		}
+		else if (paramDesc.Mask <= 3)
+		{
+			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) element.Format = DXGI_FORMAT_R32G32_UINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) element.Format = DXGI_FORMAT_R32G32_SINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) element.Format = DXGI_FORMAT_R32G32_FLOAT;
+		}
+		else if (paramDesc.Mask <= 7)
+		{
+			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) element.Format = DXGI_FORMAT_R32G32B32_UINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) element.Format = DXGI_FORMAT_R32G32B32_SINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) element.Format = DXGI_FORMAT_R32G32B32_FLOAT;
+		}
+		else if (paramDesc.Mask <= 15)
+		{
+			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) element.Format = DXGI_FORMAT_R32G32B32A32_UINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) element.Format = DXGI_FORMAT_R32G32B32A32_SINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) element.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+		}
+
+		data.InputElements.push_back(element);
 	}
 
-	// All set
+	// All done, clean up
 	refl->Release();
 	return true;
+#endif
+}
+
+// --------------------------------------------------------
+// Sidecar files are read and written here rather than by the
+// cache itself, since shader paths are wide strings
+// --------------------------------------------------------
+bool ISimpleShader::LoadReflectionSidecar(const std::wstring& path, ShaderReflectionData& data)
+{
+	std::ifstream file(GetFileStreamPath(path).c_str(), std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	return ShaderReflectionCache::Read(bytes.empty() ? 0 : &bytes[0], bytes.size(), data);
+}
+
+bool ISimpleShader::SaveReflectionSidecar(const std::wstring& path, const ShaderReflectionData& data)
+{
+	std::vector<unsigned char> bytes;
+	ShaderReflectionCache::Write(data, bytes);
+
+	std::ofstream file(GetFileStreamPath(path).c_str(), std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	file.write((const char*)&bytes[0], bytes.size());
+	return file.good();
+}
+
+// --------------------------------------------------------
+// Adds a name to one of the lookup tables.  Call SortNames()
+// once every name is in.
+// --------------------------------------------------------
+void ISimpleShader::AddName(std::vector<ShaderNameEntry>& table, const char* name, unsigned int index)
+{
+	ShaderNameEntry entry;
+	entry.Hash = HashShaderName(name);
+	entry.Index = index;
+	entry.Name = name;
+	table.push_back(entry);
+}
+
+void ISimpleShader::SortNames(std::vector<ShaderNameEntry>& table)
+{
+	std::stable_sort(table.begin(), table.end(), [](const ShaderNameEntry& a, const ShaderNameEntry& b)
+	{
+		return a.Hash < b.Hash;
+	});
+}
+
+// --------------------------------------------------------
+// Finds a name in a sorted table, comparing the strings too
+// in case another name has the same hash
+// --------------------------------------------------------
+int ISimpleShader::FindName(const std::vector<ShaderNameEntry>& table, const std::string& name)
+{
+	ShaderNameHash hash = HashShaderName(name.c_str());
+	std::vector<ShaderNameEntry>::const_iterator it = std::lower_bound(table.begin(), table.end(), hash,
+		[](const ShaderNameEntry& entry, ShaderNameHash hash) { return entry.Hash < hash; });
+
+	for (; it != table.end() && it->Hash == hash; ++it)
+	{
+		if (it->Name == name)
+			return (int)it->Index;
+	}
+	return -1;
+}
+
+// --------------------------------------------------------
+// Finds a name by its hash alone.  If two names share the
+// hash there's no telling which was meant, so it fails.
+// --------------------------------------------------------
+int ISimpleShader::FindNameHash(const std::vector<ShaderNameEntry>& table, ShaderNameHash nameHash)
+{
+	std::vector<ShaderNameEntry>::const_iterator it = std::lower_bound(table.begin(), table.end(), nameHash,
+		[](const ShaderNameEntry& entry, ShaderNameHash hash) { return entry.Hash < hash; });
+
+	if (it == table.end() || it->Hash != nameHash)
+		return -1;
+	if (it + 1 != table.end() && (it + 1)->Hash == nameHash)
+		return -1;
+	return (int)it->Index;
 }
 
 // --------------------------------------------------------
@@ -215,18 +498,15 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 // name - the name of the variable to look for
 // size - the size of the variable (for verification), or -1 to bypass
 // --------------------------------------------------------
-SimpleShaderVariable* ISimpleShader::FindVariable(std::string name, int size)
+SimpleShaderVariable* ISimpleShader::FindVariable(const std::string& name, int size)
 {
-	// Look for the key
-	std::unordered_map<std::string, SimpleShaderVariable>::iterator result =
-		varTable.find(name);
-
-	// Did we find the key?
-	if (result == varTable.end())
+	// Look for the name
+	int index = FindName(varTable, name);
+	if (index < 0)
 		return 0;
 
-	// Grab the result from the iterator
-	SimpleShaderVariable* var = &(result->second);
+	// Grab the variable it refers to
+	SimpleShaderVariable* var = &variables[index];
 
 	// Is the data size correct ?
 	if (size > 0 && var->Size != size)
@@ -239,18 +519,15 @@ SimpleShaderVariable* ISimpleShader::FindVariable(std::string name, int size)
 // --------------------------------------------------------
 // Helper for looking up a constant buffer by name
 // --------------------------------------------------------
-SimpleConstantBuffer* ISimpleShader::FindConstantBuffer(std::string name)
+SimpleConstantBuffer* ISimpleShader::FindConstantBuffer(const std::string& name)
 {
-	// Look for the key
-	std::unordered_map<std::string, SimpleConstantBuffer*>::iterator result =
-		cbTable.find(name);
-
-	// Did we find the key?
-	if (result == cbTable.end())
+	// Look for the name
+	int index = FindName(cbTable, name);
+	if (index < 0)
 		return 0;
 
 	// Success
-	return result->second;
+	return &constantBuffers[index];
 }
 
 // --------------------------------------------------------
@@ -266,6 +543,78 @@ void ISimpleShader::SetShader()
 	SetShaderAndCBs();
 }
 
+// --------------------------------------------------------
+// Sets the shader and associated constant buffers through
+// the given render context instead of this shader's own,
+// which lets several threads bind the same shader into
+// their own command lists
+// --------------------------------------------------------
+void ISimpleShader::SetShader(IRenderContext* context)
+{
+	// Ensure the shader is valid
+	if (!shaderValid) return;
+
+	BindShaderAndCBs(context);
+}
+
+// --------------------------------------------------------
+// Sets the render context used to bind this shader and
+// copy its constant buffers (only the vertex and pixel
+// shaders use it so far)
+//
+// renderContext - The context to use, or null for the default
+// --------------------------------------------------------
+void ISimpleShader::SetRenderContext(IRenderContext* renderContext)
+{
+	this->renderContext = renderContext ? renderContext : renderDevice->GetImmediateContext();
+}
+
+// --------------------------------------------------------
+// Sets the upload ring that constant buffer data is copied
+// into (only the vertex and pixel shaders bind from it)
+//
+// uploadRing - The ring to use, or null to always use this
+//              shader's own constant buffers
+// --------------------------------------------------------
+void ISimpleShader::SetConstantUploadRing(ConstantUploadRing* uploadRing)
+{
+	this->uploadRing = uploadRing;
+}
+
+// --------------------------------------------------------
+// Copies one constant buffer's local data to the GPU.  With
+// an upload ring each copy lands in a new slice of the ring,
+// so the draws already using earlier slices don't stall.  If
+// the ring is full it falls back to the buffer's own copy.
+//
+// Clean buffers are skipped.  The shader's own buffer keeps
+// its contents for good, but a ring slice is only reused in
+// the frame it was written, since the ring recycles it later.
+// --------------------------------------------------------
+void ISimpleShader::UploadConstantBuffer(SimpleConstantBuffer* cb)
+{
+	bool sliceStale = cb->Slice.Buffer && (!uploadRing || cb->SliceFrame != uploadRing->GetFrameIndex());
+	if (!cb->Dirty && !sliceStale)
+	{
+		skippedUploads++;
+		return;
+	}
+
+	uploads++;
+	cb->Dirty = false;
+	if (uploadRing && uploadRing->Upload(cb->LocalDataBuffer, cb->Size, cb->Slice))
+	{
+		cb->SliceFrame = uploadRing->GetFrameIndex();
+		return;
+	}
+
+	cb->Slice = {};
+	renderContext->UpdateSubresource(
+		cb->ConstantBuffer,
+		cb->LocalDataBuffer,
+		cb->Size);
+}
+
 // --------------------------------------------------------
 // Copies the relevant data to the all of this 
 // shader's constant buffers.  To just copy one
@@ -279,10 +628,11 @@ void ISimpleShader::CopyAllBufferData()
 	// Loop through the constant buffers and copy all data
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
+		if (constantBuffers[i].External)
+			continue;
+
 		// Copy the entire local data buffer
-		deviceContext->UpdateSubresource(
-			constantBuffers[i].ConstantBuffer, 0, 0,
-			constantBuffers[i].LocalDataBuffer, 0, 0);
+		UploadConstantBuffer(&constantBuffers[i]);
 	}
 }
 
@@ -311,9 +661,7 @@ void ISimpleShader::CopyBufferData(unsigned int index)
 	if (!cb) return;
 
 	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer, 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	UploadConstantBuffer(cb);
 }
 
 // --------------------------------------------------------
@@ -323,7 +671,7 @@ void ISimpleShader::CopyBufferData(unsigned int index)
 //              Useful for updating more frequently-changing
 //              variables without having to re-copy all buffers.
 // --------------------------------------------------------
-void ISimpleShader::CopyBufferData(std::string bufferName)
+void ISimpleShader::CopyBufferData(const std::string& bufferName)
 {
 	// Ensure the shader is valid
 	if (!shaderValid) return;
@@ -333,9 +681,21 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 	if (!cb) return;
 
 	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer, 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	UploadConstantBuffer(cb);
+}
+
+// --------------------------------------------------------
+// Marks a constant buffer as bound by someone else, so
+// CopyAllBufferData() and setting the shader leave its slot
+// alone
+// --------------------------------------------------------
+bool ISimpleShader::SetConstantBufferExternal(const std::string& bufferName, bool external)
+{
+	SimpleConstantBuffer* cb = this->FindConstantBuffer(bufferName);
+	if (!cb) return false;
+
+	cb->External = external;
+	return true;
 }
 
 
@@ -349,7 +709,7 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 // Returns true if data is copied, false if variable doesn't 
 // exist or sizes don't match
 // --------------------------------------------------------
-bool ISimpleShader::SetData(std::string name, const void* data, unsigned int size)
+bool ISimpleShader::SetData(const std::string& name, const void* data, unsigned int size)
 {
 	// Look for the variable and verify
 	SimpleShaderVariable* var = FindVariable(name, size);
@@ -357,8 +717,9 @@ bool ISimpleShader::SetData(std::string name, const void* data, unsigned int siz
 		return false;
 
 	// Set the data in the local data buffer
-	memcpy(
-		constantBuffers[var->ConstantBufferIndex].LocalDataBuffer + var->ByteOffset,
+	WriteConstantData(
+		constantBuffers[var->ConstantBufferIndex],
+		var->ByteOffset,
 		data,
 		size);
 
@@ -369,7 +730,7 @@ bool ISimpleShader::SetData(std::string name, const void* data, unsigned int siz
 // --------------------------------------------------------
 // Sets INTEGER data
 // --------------------------------------------------------
-bool ISimpleShader::SetInt(std::string name, int data)
+bool ISimpleShader::SetInt(const std::string& name, int data)
 {
 	return this->SetData(name, (void*)(&data), sizeof(int));
 }
@@ -377,7 +738,7 @@ bool ISimpleShader::SetInt(std::string name, int data)
 // --------------------------------------------------------
 // Sets a FLOAT variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat(std::string name, float data)
+bool ISimpleShader::SetFloat(const std::string& name, float data)
 {
 	return this->SetData(name, (void*)(&data), sizeof(float));
 }
@@ -385,7 +746,7 @@ bool ISimpleShader::SetFloat(std::string name, float data)
 // --------------------------------------------------------
 // Sets a FLOAT2 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat2(std::string name, const float data[2])
+bool ISimpleShader::SetFloat2(const std::string& name, const float data[2])
 {
 	return this->SetData(name, (void*)data, sizeof(float) * 2);
 }
@@ -393,7 +754,7 @@ bool ISimpleShader::SetFloat2(std::string name, const float data[2])
 // --------------------------------------------------------
 // Sets a FLOAT2 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat2(std::string name, const DirectX::XMFLOAT2 data)
+bool ISimpleShader::SetFloat2(const std::string& name, const DirectX::XMFLOAT2 data)
 {
 	return this->SetData(name, &data, sizeof(float) * 2);
 }
@@ -401,7 +762,7 @@ bool ISimpleShader::SetFloat2(std::string name, const DirectX::XMFLOAT2 data)
 // --------------------------------------------------------
 // Sets a FLOAT3 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat3(std::string name, const float data[3])
+bool ISimpleShader::SetFloat3(const std::string& name, const float data[3])
 {
 	return this->SetData(name, (void*)data, sizeof(float) * 3);
 }
@@ -409,7 +770,7 @@ bool ISimpleShader::SetFloat3(std::string name, const float data[3])
 // --------------------------------------------------------
 // Sets a FLOAT3 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat3(std::string name, const DirectX::XMFLOAT3 data)
+bool ISimpleShader::SetFloat3(const std::string& name, const DirectX::XMFLOAT3 data)
 {
 	return this->SetData(name, &data, sizeof(float) * 3);
 }
@@ -417,7 +778,7 @@ bool ISimpleShader::SetFloat3(std::string name, const DirectX::XMFLOAT3 data)
 // --------------------------------------------------------
 // Sets a FLOAT4 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat4(std::string name, const float data[4])
+bool ISimpleShader::SetFloat4(const std::string& name, const float data[4])
 {
 	return this->SetData(name, (void*)data, sizeof(float) * 4);
 }
@@ -425,7 +786,7 @@ bool ISimpleShader::SetFloat4(std::string name, const float data[4])
 // --------------------------------------------------------
 // Sets a FLOAT4 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat4(std::string name, const DirectX::XMFLOAT4 data)
+bool ISimpleShader::SetFloat4(const std::string& name, const DirectX::XMFLOAT4 data)
 {
 	return this->SetData(name, &data, sizeof(float) * 4);
 }
@@ -433,7 +794,7 @@ bool ISimpleShader::SetFloat4(std::string name, const DirectX::XMFLOAT4 data)
 // --------------------------------------------------------
 // Sets a MATRIX (4x4) variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetMatrix4x4(std::string name, const float data[16])
+bool ISimpleShader::SetMatrix4x4(const std::string& name, const float data[16])
 {
 	return this->SetData(name, (void*)data, sizeof(float) * 16);
 }
@@ -441,7 +802,7 @@ bool ISimpleShader::SetMatrix4x4(std::string name, const float data[16])
 // --------------------------------------------------------
 // Sets a MATRIX (4x4) variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 data)
+bool ISimpleShader::SetMatrix4x4(const std::string& name, const DirectX::XMFLOAT4X4 data)
 {
 	return this->SetData(name, &data, sizeof(float) * 16);
 }
@@ -449,7 +810,7 @@ bool ISimpleShader::SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 dat
 // --------------------------------------------------------
 // Gets info about a shader variable, if it exists
 // --------------------------------------------------------
-const SimpleShaderVariable* ISimpleShader::GetVariableInfo(std::string name)
+const SimpleShaderVariable* ISimpleShader::GetVariableInfo(const std::string& name)
 {
 	return FindVariable(name, -1);
 }
@@ -459,18 +820,15 @@ const SimpleShaderVariable* ISimpleShader::GetVariableInfo(std::string name)
 //
 // name - the name of the SRV
 // --------------------------------------------------------
-const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(std::string name)
+const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(const std::string& name)
 {
-	// Look for the key
-	std::unordered_map<std::string, SimpleSRV*>::iterator result =
-		textureTable.find(name);
-
-	// Did we find the key?
-	if (result == textureTable.end())
+	// Look for the name
+	int index = FindName(textureTable, name);
+	if (index < 0)
 		return 0;
 
 	// Success
-	return result->second;
+	return &shaderResourceViews[index];
 }
 
 
@@ -485,7 +843,7 @@ const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(unsigned int index)
 	if (index >= shaderResourceViews.size()) return 0;
 
 	// Grab the bind index
-	return shaderResourceViews[index];
+	return &shaderResourceViews[index];
 }
 
 
@@ -494,18 +852,15 @@ const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(unsigned int index)
 // 
 // name - the name of the sampler
 // --------------------------------------------------------
-const SimpleSampler* ISimpleShader::GetSamplerInfo(std::string name)
+const SimpleSampler* ISimpleShader::GetSamplerInfo(const std::string& name)
 {
-	// Look for the key
-	std::unordered_map<std::string, SimpleSampler*>::iterator result =
-		samplerTable.find(name);
-
-	// Did we find the key?
-	if (result == samplerTable.end())
+	// Look for the name
+	int index = FindName(samplerTable, name);
+	if (index < 0)
 		return 0;
 
 	// Success
-	return result->second;
+	return &samplerStates[index];
 }
 
 // --------------------------------------------------------
@@ -519,7 +874,92 @@ const SimpleSampler* ISimpleShader::GetSamplerInfo(unsigned int index)
 	if (index >= samplerStates.size()) return 0;
 
 	// Grab the bind index
-	return samplerStates[index];
+	return &samplerStates[index];
+}
+
+// --------------------------------------------------------
+// Looks up a variable once, so it can be set later without
+// looking up its name again.  The handle is invalid if
+// there's no such variable.
+// --------------------------------------------------------
+ShaderVariableHandle ISimpleShader::GetVariableHandle(const std::string& name)
+{
+	ShaderVariableHandle handle;
+	int index = FindName(varTable, name);
+	if (index >= 0)
+	{
+		handle.ConstantBufferIndex = variables[index].ConstantBufferIndex;
+		handle.ByteOffset = variables[index].ByteOffset;
+		handle.Size = variables[index].Size;
+	}
+	return handle;
+}
+
+ShaderVariableHandle ISimpleShader::GetVariableHandle(ShaderNameHash nameHash)
+{
+	ShaderVariableHandle handle;
+	int index = FindNameHash(varTable, nameHash);
+	if (index >= 0)
+	{
+		handle.ConstantBufferIndex = variables[index].ConstantBufferIndex;
+		handle.ByteOffset = variables[index].ByteOffset;
+		handle.Size = variables[index].Size;
+	}
+	return handle;
+}
+
+// --------------------------------------------------------
+// Looks up an SRV's register once, ahead of time
+// --------------------------------------------------------
+ShaderResourceHandle ISimpleShader::GetShaderResourceViewHandle(const std::string& name)
+{
+	ShaderResourceHandle handle;
+	int index = FindName(textureTable, name);
+	if (index >= 0)
+	{
+		handle.BindIndex = shaderResourceViews[index].BindIndex;
+		handle.Found = true;
+	}
+	return handle;
+}
+
+ShaderResourceHandle ISimpleShader::GetShaderResourceViewHandle(ShaderNameHash nameHash)
+{
+	ShaderResourceHandle handle;
+	int index = FindNameHash(textureTable, nameHash);
+	if (index >= 0)
+	{
+		handle.BindIndex = shaderResourceViews[index].BindIndex;
+		handle.Found = true;
+	}
+	return handle;
+}
+
+// --------------------------------------------------------
+// Looks up a sampler's register once, ahead of time
+// --------------------------------------------------------
+ShaderSamplerHandle ISimpleShader::GetSamplerHandle(const std::string& name)
+{
+	ShaderSamplerHandle handle;
+	int index = FindName(samplerTable, name);
+	if (index >= 0)
+	{
+		handle.BindIndex = samplerStates[index].BindIndex;
+		handle.Found = true;
+	}
+	return handle;
+}
+
+ShaderSamplerHandle ISimpleShader::GetSamplerHandle(ShaderNameHash nameHash)
+{
+	ShaderSamplerHandle handle;
+	int index = FindNameHash(samplerTable, nameHash);
+	if (index >= 0)
+	{
+		handle.BindIndex = samplerStates[index].BindIndex;
+		handle.Found = true;
+	}
+	return handle;
 }
 
 
@@ -547,7 +987,7 @@ unsigned int ISimpleShader::GetBufferSize(unsigned int index)
 // Gets info about a particular constant buffer 
 // by name, if it exists
 // --------------------------------------------------------
-const SimpleConstantBuffer * ISimpleShader::GetBufferInfo(std::string name)
+const SimpleConstantBuffer * ISimpleShader::GetBufferInfo(const std::string& name)
 {
 	return FindConstantBuffer(name);
 }
@@ -574,6 +1014,7 @@ const SimpleConstantBuffer * ISimpleShader::GetBufferInfo(unsigned int index)
 // ------ SIMPLE VERTEX SHADER ------------------------------------------------
 ///////////////////////////////////////////////////////////////////////////////
 
+#ifdef _WIN32
 // --------------------------------------------------------
 // Constructor just calls the base
 // --------------------------------------------------------
@@ -583,6 +1024,7 @@ SimpleVertexShader::SimpleVertexShader(ID3D11Device* device, ID3D11DeviceContext
 	// Ensure we set to zero to successfully trigger
 	// the Input Layout creation during LoadShader()
 	this->inputLayout = 0;
+	this->inputLayoutOwner = 0;
 	this->shader = 0;
 	this->perInstanceCompatible = false;
 }
@@ -598,11 +1040,26 @@ SimpleVertexShader::SimpleVertexShader(ID3D11Device * device, ID3D11DeviceContex
 {
 	// Save the custom input layout
 	this->inputLayout = inputLayout;
+	this->inputLayoutOwner = 0;
 	this->shader = 0;
 
 	// Unable to determine from an input layout, require user to tell us
 	this->perInstanceCompatible = perInstanceCompatible;
 }
+#endif
+
+// --------------------------------------------------------
+// Constructor overload which creates everything through
+// a render device instead of a DirectX device
+// --------------------------------------------------------
+SimpleVertexShader::SimpleVertexShader(IRenderDevice* renderDevice)
+	: ISimpleShader(renderDevice)
+{
+	this->inputLayout = 0;
+	this->inputLayoutOwner = 0;
+	this->shader = 0;
+	this->perInstanceCompatible = false;
+}
 
 // --------------------------------------------------------
 // Destructor - Clean up actual shader (base will be called automatically)
@@ -618,32 +1075,37 @@ SimpleVertexShader::~SimpleVertexShader()
 void SimpleVertexShader::CleanUp()
 {
 	ISimpleShader::CleanUp();
-	if (shader) { shader->Release(); shader = 0; }
-	if (inputLayout) { inputLayout->Release(); inputLayout = 0; }
+	if (shader) { renderDevice->Release(shader); shader = 0; }
+	if (inputLayout)
+	{
+		if (inputLayoutOwner)
+			inputLayoutOwner->Release(inputLayout);
+		else
+			renderDevice->Release(inputLayout);
+		inputLayout = 0;
+		inputLayoutOwner = 0;
+	}
 }
 
 // --------------------------------------------------------
 // Creates the DirectX vertex shader
 //
-// shaderBlob - The shader's compiled code
+// byteCode     - The shader's compiled code
+// byteCodeSize - How many bytes of it there are
 //
 // Returns true if shader is created correctly, false otherwise
 // --------------------------------------------------------
-bool SimpleVertexShader::CreateShader(ID3DBlob* shaderBlob)
+bool SimpleVertexShader::CreateShader(const void* byteCode, size_t byteCodeSize)
 {
 	// Clean up first, in the event this method is
 	// called more than once on the same object
 	this->CleanUp();
 
-	// Create the shader from the blob
-	HRESULT result = device->CreateVertexShader(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		0,
-		&shader);
+	// Create the shader from the byte code
+	shader = renderDevice->CreateVertexShader(byteCode, byteCodeSize);
 
 	// Did the creation work?
-	if (result != S_OK)
+	if (!shader)
 		return false;
 
 	// Do we already have an input layout?
@@ -652,120 +1114,118 @@ bool SimpleVertexShader::CreateShader(ID3DBlob* shaderBlob)
 		return true;
 
 	// Vertex shader was created successfully, so we now use the
-	// shader code to re-reflect and create an input layout that 
-	// matches what the vertex shader expects.  Code adapted from:
+	// reflected inputs to create an input layout that matches what
+	// the vertex shader expects.  Code adapted from:
 	// https://takinginitiative.wordpress.com/2011/12/11/directx-1011-basic-shader-reflection-automatic-input-layout-creation/
-
-	// Reflect shader info
-	ID3D11ShaderReflection* refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		IID_ID3D11ShaderReflection,
-		(void**)&refl);
-	
-	// Get shader info
-	D3D11_SHADER_DESC shaderDesc;
-	refl->GetDesc(&shaderDesc);
-
-	// Read input layout description from shader info
-	std::vector<D3D11_INPUT_ELEMENT_DESC> inputLayoutDesc;
-	for (unsigned int i = 0; i< shaderDesc.InputParameters; i++)
+	std::vector<InputElementDesc> inputLayoutDesc;
+	for (size_t i = 0; i < reflection.InputElements.size(); i++)
 	{
-		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
-		refl->GetInputParameterDesc(i, &paramDesc);
-
-		// Check the semantic name for "_PER_INSTANCE"
-		std::string perInstanceStr = "_PER_INSTANCE";
-		std::string sem = paramDesc.SemanticName;
-		int lenDiff = (int)sem.size() - (int)perInstanceStr.size();
-		bool isPerInstance = 
-			lenDiff >= 0 &&
-			sem.compare(lenDiff, perInstanceStr.size(), perInstanceStr) == 0;
+		const ReflectedInputElement& element = reflection.InputElements[i];
 
 		// Fill out input element desc
-		D3D11_INPUT_ELEMENT_DESC elementDesc;
-		elementDesc.SemanticName = paramDesc.SemanticName;
-		elementDesc.SemanticIndex = paramDesc.SemanticIndex;
+		InputElementDesc elementDesc;
+		elementDesc.SemanticName = element.SemanticName.c_str();
+		elementDesc.SemanticIndex = element.SemanticIndex;
+		elementDesc.Format = (DXGI_FORMAT)element.Format;
 		elementDesc.InputSlot = 0;
 		elementDesc.AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
-		elementDesc.InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
+		elementDesc.PerInstance = false;
 		elementDesc.InstanceDataStepRate = 0;
 
 		// Replace anything affected by "per instance" data
-		if (isPerInstance)
+		if (element.PerInstance)
 		{
 			elementDesc.InputSlot = 1; // Assume per instance data comes from another input slot!
-			elementDesc.InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+			elementDesc.PerInstance = true;
 			elementDesc.InstanceDataStepRate = 1;
 
 			perInstanceCompatible = true;
 		}
 
-		// Determine DXGI format
-		if (paramDesc.Mask == 1)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32_FLOAT;
-		}
-		else if (paramDesc.Mask <= 3)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32_FLOAT;
-		}
-		else if (paramDesc.Mask <= 7)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_FLOAT;
-		}
-		else if (paramDesc.Mask <= 15)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-		}
-
 		// Save element desc
 		inputLayoutDesc.push_back(elementDesc);
 	}
 
+	// Share a layout with any other vertex shader taking the same input
+	if (inputLayoutCache && inputLayoutCache->GetDevice() == renderDevice)
+	{
+		inputLayout = inputLayoutCache->Acquire(
+			inputLayoutDesc.empty() ? 0 : &inputLayoutDesc[0],
+			(unsigned int)inputLayoutDesc.size(),
+			byteCode,
+			byteCodeSize);
+		inputLayoutOwner = inputLayout ? inputLayoutCache : 0;
+		return true;
+	}
+
 	// Try to create Input Layout
-	HRESULT hr = device->CreateInputLayout(
-		&inputLayoutDesc[0], 
+	inputLayout = renderDevice->CreateInputLayout(
+		inputLayoutDesc.empty() ? 0 : &inputLayoutDesc[0],
 		(unsigned int)inputLayoutDesc.size(), 
-		shaderBlob->GetBufferPointer(), 
-		shaderBlob->GetBufferSize(),
-		&inputLayout);
+		byteCode, 
+		byteCodeSize);
 
-	// All done, clean up
-	refl->Release();
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets the shader through this shader's own render context
+// --------------------------------------------------------
+void SimpleVertexShader::SetShaderAndCBs()
+{
+	BindShaderAndCBs(renderContext);
+}
+
 // --------------------------------------------------------
 // Sets the vertex shader, input layout and constant buffers
 // for future DirectX drawing
 // --------------------------------------------------------
-void SimpleVertexShader::SetShaderAndCBs()
+void SimpleVertexShader::BindShaderAndCBs(IRenderContext* context)
 {
 	// Is shader valid?
 	if (!shaderValid) return;
 
 	// Set the shader and input layout
-	deviceContext->IASetInputLayout(inputLayout);
-	deviceContext->VSSetShader(shader, 0, 0);
+	context->IASetInputLayout(inputLayout);
+	context->VSSetShader(shader);
 
-	// Set the constant buffers
+	// Set the constant buffers, or the slices of the upload
+	// ring their data was last copied into
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		deviceContext->VSSetConstantBuffers(
+		if (constantBuffers[i].External)
+			continue;
+
+		const ConstantBufferSlice& slice = constantBuffers[i].Slice;
+		if (slice.Buffer)
+		{
+			context->VSSetConstantBuffers1(
+				constantBuffers[i].BindIndex,
+				1,
+				&slice.Buffer,
+				&slice.FirstConstant,
+				&slice.NumConstants);
+			continue;
+		}
+
+		context->VSSetConstantBuffers(
 			constantBuffers[i].BindIndex,
 			1,
 			&constantBuffers[i].ConstantBuffer);
 	}
+
+	// Bind whatever was staged for this context since the shader was last set
+	if (context == renderContext)
+	{
+		bindCalls += stagedShaderResourceViews.Flush([context](unsigned int startSlot, unsigned int count, ID3D11ShaderResourceView* const* views)
+		{
+			context->VSSetShaderResources(startSlot, count, views);
+		});
+		bindCalls += stagedSamplers.Flush([context](unsigned int startSlot, unsigned int count, ID3D11SamplerState* const* samplers)
+		{
+			context->VSSetSamplers(startSlot, count, samplers);
+		});
+	}
 }
 
 // --------------------------------------------------------
@@ -776,7 +1236,15 @@ void SimpleVertexShader::SetShaderAndCBs()
 //
 // Returns true if a texture of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleVertexShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
+bool SimpleVertexShader::SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv)
+{
+	return SetShaderResourceView(name, srv, renderContext);
+}
+
+// --------------------------------------------------------
+// Same as above, but sets it through the given render context
+// --------------------------------------------------------
+bool SimpleVertexShader::SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv, IRenderContext* context)
 {
 	// Look for the variable and verify
 	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
@@ -784,7 +1252,7 @@ bool SimpleVertexShader::SetShaderResourceView(std::string name, ID3D11ShaderRes
 		return false;
 
 	// Set the shader resource view
-	deviceContext->VSSetShaderResources(srvInfo->BindIndex, 1, &srv);
+	BindShaderResourceView(srvInfo->BindIndex, srv, context);
 
 	// Success
 	return true;
@@ -798,7 +1266,15 @@ bool SimpleVertexShader::SetShaderResourceView(std::string name, ID3D11ShaderRes
 //
 // Returns true if a sampler of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleVertexShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
+bool SimpleVertexShader::SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState)
+{
+	return SetSamplerState(name, samplerState, renderContext);
+}
+
+// --------------------------------------------------------
+// Same as above, but sets it through the given render context
+// --------------------------------------------------------
+bool SimpleVertexShader::SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState, IRenderContext* context)
 {
 	// Look for the variable and verify
 	const SimpleSampler* sampInfo = GetSamplerInfo(name);
@@ -806,17 +1282,72 @@ bool SimpleVertexShader::SetSamplerState(std::string name, ID3D11SamplerState* s
 		return false;
 
 	// Set the shader resource view
-	deviceContext->VSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
+	BindSamplerState(sampInfo->BindIndex, samplerState, context);
 
 	// Success
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets a shader resource view through a handle from
+// GetShaderResourceViewHandle(), without looking up its name
+// --------------------------------------------------------
+bool SimpleVertexShader::SetShaderResourceView(ShaderResourceHandle handle, ID3D11ShaderResourceView* srv, IRenderContext* context)
+{
+	if (!handle.IsValid())
+		return false;
+
+	BindShaderResourceView(handle.BindIndex, srv, context);
+	return true;
+}
+
+// --------------------------------------------------------
+// Sets a sampler state through a handle from GetSamplerHandle()
+// --------------------------------------------------------
+bool SimpleVertexShader::SetSamplerState(ShaderSamplerHandle handle, ID3D11SamplerState* samplerState, IRenderContext* context)
+{
+	if (!handle.IsValid())
+		return false;
+
+	BindSamplerState(handle.BindIndex, samplerState, context);
+	return true;
+}
+
+// --------------------------------------------------------
+// Stages a shader resource view for the next time the shader
+// is set, or binds it now if it's for some other context
+// --------------------------------------------------------
+void SimpleVertexShader::BindShaderResourceView(unsigned int bindIndex, ID3D11ShaderResourceView* srv, IRenderContext* context)
+{
+	if (context == renderContext && stagedShaderResourceViews.Stage(bindIndex, srv))
+	{
+		bindingsStaged++;
+		return;
+	}
+
+	context->VSSetShaderResources(bindIndex, 1, &srv);
+}
+
+// --------------------------------------------------------
+// Same as above, for a sampler state
+// --------------------------------------------------------
+void SimpleVertexShader::BindSamplerState(unsigned int bindIndex, ID3D11SamplerState* samplerState, IRenderContext* context)
+{
+	if (context == renderContext && stagedSamplers.Stage(bindIndex, samplerState))
+	{
+		bindingsStaged++;
+		return;
+	}
+
+	context->VSSetSamplers(bindIndex, 1, &samplerState);
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // ------ SIMPLE PIXEL SHADER -------------------------------------------------
 ///////////////////////////////////////////////////////////////////////////////
 
+#ifdef _WIN32
 // --------------------------------------------------------
 // Constructor just calls the base
 // --------------------------------------------------------
@@ -825,6 +1356,17 @@ SimplePixelShader::SimplePixelShader(ID3D11Device* device, ID3D11DeviceContext*
 { 
 	this->shader = 0;
 }
+#endif
+
+// --------------------------------------------------------
+// Constructor overload which creates everything through
+// a render device instead of a DirectX device
+// --------------------------------------------------------
+SimplePixelShader::SimplePixelShader(IRenderDevice* renderDevice)
+	: ISimpleShader(renderDevice)
+{
+	this->shader = 0;
+}
 
 // --------------------------------------------------------
 // Destructor - Clean up actual shader (base will be called automatically)
@@ -840,53 +1382,87 @@ SimplePixelShader::~SimplePixelShader()
 void SimplePixelShader::CleanUp()
 {
 	ISimpleShader::CleanUp();
-	if (shader) { shader->Release(); shader = 0; }
+	if (shader) { renderDevice->Release(shader); shader = 0; }
 }
 
 // --------------------------------------------------------
 // Creates the DirectX pixel shader
 //
-// shaderBlob - The shader's compiled code
+// byteCode     - The shader's compiled code
+// byteCodeSize - How many bytes of it there are
 //
 // Returns true if shader is created correctly, false otherwise
 // --------------------------------------------------------
-bool SimplePixelShader::CreateShader(ID3DBlob* shaderBlob)
+bool SimplePixelShader::CreateShader(const void* byteCode, size_t byteCodeSize)
 {
 	// Clean up first, in the event this method is
 	// called more than once on the same object
 	this->CleanUp();
 
-	// Create the shader from the blob
-	HRESULT result = device->CreatePixelShader(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		0,
-		&shader);
+	// Create the shader from the byte code
+	shader = renderDevice->CreatePixelShader(byteCode, byteCodeSize);
 
 	// Check the result
-	return (result == S_OK);
+	return (shader != 0);
+}
+
+// --------------------------------------------------------
+// Sets the shader through this shader's own render context
+// --------------------------------------------------------
+void SimplePixelShader::SetShaderAndCBs()
+{
+	BindShaderAndCBs(renderContext);
 }
 
 // --------------------------------------------------------
 // Sets the pixel shader and constant buffers for
 // future DirectX drawing
 // --------------------------------------------------------
-void SimplePixelShader::SetShaderAndCBs()
+void SimplePixelShader::BindShaderAndCBs(IRenderContext* context)
 {
 	// Is shader valid?
 	if (!shaderValid) return;
 	
 	// Set the shader
-	deviceContext->PSSetShader(shader, 0, 0);
+	context->PSSetShader(shader);
 
-	// Set the constant buffers
+	// Set the constant buffers, or the slices of the upload
+	// ring their data was last copied into
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		deviceContext->PSSetConstantBuffers(
+		if (constantBuffers[i].External)
+			continue;
+
+		const ConstantBufferSlice& slice = constantBuffers[i].Slice;
+		if (slice.Buffer)
+		{
+			context->PSSetConstantBuffers1(
+				constantBuffers[i].BindIndex,
+				1,
+				&slice.Buffer,
+				&slice.FirstConstant,
+				&slice.NumConstants);
+			continue;
+		}
+
+		context->PSSetConstantBuffers(
 			constantBuffers[i].BindIndex,
 			1,
 			&constantBuffers[i].ConstantBuffer);
 	}
+
+	// Bind whatever was staged for this context since the shader was last set
+	if (context == renderContext)
+	{
+		bindCalls += stagedShaderResourceViews.Flush([context](unsigned int startSlot, unsigned int count, ID3D11ShaderResourceView* const* views)
+		{
+			context->PSSetShaderResources(startSlot, count, views);
+		});
+		bindCalls += stagedSamplers.Flush([context](unsigned int startSlot, unsigned int count, ID3D11SamplerState* const* samplers)
+		{
+			context->PSSetSamplers(startSlot, count, samplers);
+		});
+	}
 }
 
 // --------------------------------------------------------
@@ -897,7 +1473,15 @@ void SimplePixelShader::SetShaderAndCBs()
 //
 // Returns true if a texture of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimplePixelShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
+bool SimplePixelShader::SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv)
+{
+	return SetShaderResourceView(name, srv, renderContext);
+}
+
+// --------------------------------------------------------
+// Same as above, but sets it through the given render context
+// --------------------------------------------------------
+bool SimplePixelShader::SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv, IRenderContext* context)
 {
 	// Look for the variable and verify
 	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
@@ -905,7 +1489,7 @@ bool SimplePixelShader::SetShaderResourceView(std::string name, ID3D11ShaderReso
 		return false;
 
 	// Set the shader resource view
-	deviceContext->PSSetShaderResources(srvInfo->BindIndex, 1, &srv);
+	BindShaderResourceView(srvInfo->BindIndex, srv, context);
 
 	// Success
 	return true;
@@ -919,7 +1503,15 @@ bool SimplePixelShader::SetShaderResourceView(std::string name, ID3D11ShaderReso
 //
 // Returns true if a sampler of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimplePixelShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
+bool SimplePixelShader::SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState)
+{
+	return SetSamplerState(name, samplerState, renderContext);
+}
+
+// --------------------------------------------------------
+// Same as above, but sets it through the given render context
+// --------------------------------------------------------
+bool SimplePixelShader::SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState, IRenderContext* context)
 {
 	// Look for the variable and verify
 	const SimpleSampler* sampInfo = GetSamplerInfo(name);
@@ -927,15 +1519,70 @@ bool SimplePixelShader::SetSamplerState(std::string name, ID3D11SamplerState* sa
 		return false;
 
 	// Set the shader resource view
-	deviceContext->PSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
+	BindSamplerState(sampInfo->BindIndex, samplerState, context);
 
 	// Success
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets a shader resource view through a handle from
+// GetShaderResourceViewHandle(), without looking up its name
+// --------------------------------------------------------
+bool SimplePixelShader::SetShaderResourceView(ShaderResourceHandle handle, ID3D11ShaderResourceView* srv, IRenderContext* context)
+{
+	if (!handle.IsValid())
+		return false;
 
+	BindShaderResourceView(handle.BindIndex, srv, context);
+	return true;
+}
 
+// --------------------------------------------------------
+// Sets a sampler state through a handle from GetSamplerHandle()
+// --------------------------------------------------------
+bool SimplePixelShader::SetSamplerState(ShaderSamplerHandle handle, ID3D11SamplerState* samplerState, IRenderContext* context)
+{
+	if (!handle.IsValid())
+		return false;
 
+	BindSamplerState(handle.BindIndex, samplerState, context);
+	return true;
+}
+
+// --------------------------------------------------------
+// Stages a shader resource view for the next time the shader
+// is set, or binds it now if it's for some other context
+// --------------------------------------------------------
+void SimplePixelShader::BindShaderResourceView(unsigned int bindIndex, ID3D11ShaderResourceView* srv, IRenderContext* context)
+{
+	if (context == renderContext && stagedShaderResourceViews.Stage(bindIndex, srv))
+	{
+		bindingsStaged++;
+		return;
+	}
+
+	context->PSSetShaderResources(bindIndex, 1, &srv);
+}
+
+// --------------------------------------------------------
+// Same as above, for a sampler state
+// --------------------------------------------------------
+void SimplePixelShader::BindSamplerState(unsigned int bindIndex, ID3D11SamplerState* samplerState, IRenderContext* context)
+{
+	if (context == renderContext && stagedSamplers.Stage(bindIndex, samplerState))
+	{
+		bindingsStaged++;
+		return;
+	}
+
+	context->PSSetSamplers(bindIndex, 1, &samplerState);
+}
+
+
+
+
+#ifdef _WIN32
 ///////////////////////////////////////////////////////////////////////////////
 // ------ SIMPLE DOMAIN SHADER ------------------------------------------------
 ///////////////////////////////////////////////////////////////////////////////
@@ -969,11 +1616,12 @@ void SimpleDomainShader::CleanUp()
 // --------------------------------------------------------
 // Creates the DirectX domain shader
 //
-// shaderBlob - The shader's compiled code
+// byteCode     - The shader's compiled code
+// byteCodeSize - How many bytes of it there are
 //
 // Returns true if shader is created correctly, false otherwise
 // --------------------------------------------------------
-bool SimpleDomainShader::CreateShader(ID3DBlob* shaderBlob)
+bool SimpleDomainShader::CreateShader(const void* byteCode, size_t byteCodeSize)
 {
 	// Clean up first, in the event this method is
 	// called more than once on the same object
@@ -981,8 +1629,8 @@ bool SimpleDomainShader::CreateShader(ID3DBlob* shaderBlob)
 
 	// Create the shader from the blob
 	HRESULT result = device->CreateDomainShader(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
+		byteCode,
+		byteCodeSize,
 		0,
 		&shader);
 
@@ -1005,6 +1653,9 @@ void SimpleDomainShader::SetShaderAndCBs()
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
+		if (constantBuffers[i].External)
+			continue;
+
 		deviceContext->DSSetConstantBuffers(
 			constantBuffers[i].BindIndex,
 			1,
@@ -1020,7 +1671,7 @@ void SimpleDomainShader::SetShaderAndCBs()
 //
 // Returns true if a texture of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleDomainShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
+bool SimpleDomainShader::SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv)
 {
 	// Look for the variable and verify
 	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
@@ -1042,7 +1693,7 @@ bool SimpleDomainShader::SetShaderResourceView(std::string name, ID3D11ShaderRes
 //
 // Returns true if a sampler of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleDomainShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
+bool SimpleDomainShader::SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState)
 {
 	// Look for the variable and verify
 	const SimpleSampler* sampInfo = GetSamplerInfo(name);
@@ -1091,11 +1742,12 @@ void SimpleHullShader::CleanUp()
 // --------------------------------------------------------
 // Creates the DirectX hull shader
 //
-// shaderBlob - The shader's compiled code
+// byteCode     - The shader's compiled code
+// byteCodeSize - How many bytes of it there are
 //
 // Returns true if shader is created correctly, false otherwise
 // --------------------------------------------------------
-bool SimpleHullShader::CreateShader(ID3DBlob* shaderBlob)
+bool SimpleHullShader::CreateShader(const void* byteCode, size_t byteCodeSize)
 {
 	// Clean up first, in the event this method is
 	// called more than once on the same object
@@ -1103,8 +1755,8 @@ bool SimpleHullShader::CreateShader(ID3DBlob* shaderBlob)
 
 	// Create the shader from the blob
 	HRESULT result = device->CreateHullShader(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
+		byteCode,
+		byteCodeSize,
 		0,
 		&shader);
 
@@ -1127,6 +1779,9 @@ void SimpleHullShader::SetShaderAndCBs()
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
+		if (constantBuffers[i].External)
+			continue;
+
 		deviceContext->HSSetConstantBuffers(
 			constantBuffers[i].BindIndex,
 			1,
@@ -1142,7 +1797,7 @@ void SimpleHullShader::SetShaderAndCBs()
 //
 // Returns true if a texture of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleHullShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
+bool SimpleHullShader::SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv)
 {
 	// Look for the variable and verify
 	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
@@ -1164,7 +1819,7 @@ bool SimpleHullShader::SetShaderResourceView(std::string name, ID3D11ShaderResou
 //
 // Returns true if a sampler of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleHullShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
+bool SimpleHullShader::SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState)
 {
 	// Look for the variable and verify
 	const SimpleSampler* sampInfo = GetSamplerInfo(name);
@@ -1216,11 +1871,12 @@ void SimpleGeometryShader::CleanUp()
 // --------------------------------------------------------
 // Creates the DirectX Geometry shader
 //
-// shaderBlob - The shader's compiled code
+// byteCode     - The shader's compiled code
+// byteCodeSize - How many bytes of it there are
 //
 // Returns true if shader is created correctly, false otherwise
 // --------------------------------------------------------
-bool SimpleGeometryShader::CreateShader(ID3DBlob* shaderBlob)
+bool SimpleGeometryShader::CreateShader(const void* byteCode, size_t byteCodeSize)
 {
 	// Clean up first, in the event this method is
 	// called more than once on the same object
@@ -1228,12 +1884,12 @@ bool SimpleGeometryShader::CreateShader(ID3DBlob* shaderBlob)
 
 	// Using stream out?
 	if (useStreamOut)
-		return this->CreateShaderWithStreamOut(shaderBlob);
+		return this->CreateShaderWithStreamOut(byteCode, byteCodeSize);
 
 	// Create the shader from the blob
 	HRESULT result = device->CreateGeometryShader(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
+		byteCode,
+		byteCodeSize,
 		0,
 		&shader);
 
@@ -1245,11 +1901,12 @@ bool SimpleGeometryShader::CreateShader(ID3DBlob* shaderBlob)
 // Creates the DirectX Geometry shader and sets it up for
 // stream output, if possible.
 //
-// shaderBlob - The shader's compiled code
+// byteCode     - The shader's compiled code
+// byteCodeSize - How many bytes of it there are
 //
 // Returns true if shader is created correctly, false otherwise
 // --------------------------------------------------------
-bool SimpleGeometryShader::CreateShaderWithStreamOut(ID3DBlob* shaderBlob)
+bool SimpleGeometryShader::CreateShaderWithStreamOut(const void* byteCode, size_t byteCodeSize)
 {
 	// Clean up first, in the event this method is
 	// called more than once on the same object
@@ -1258,8 +1915,8 @@ bool SimpleGeometryShader::CreateShaderWithStreamOut(ID3DBlob* shaderBlob)
 	// Reflect shader info
 	ID3D11ShaderReflection* refl;
 	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
+		byteCode,
+		byteCodeSize,
 		IID_ID3D11ShaderReflection,
 		(void**)&refl);
 
@@ -1299,8 +1956,8 @@ bool SimpleGeometryShader::CreateShaderWithStreamOut(ID3DBlob* shaderBlob)
 
 	// Create the shader
 	HRESULT result = device->CreateGeometryShaderWithStreamOutput(
-		shaderBlob->GetBufferPointer(), // Shader blob pointer
-		shaderBlob->GetBufferSize(),    // Shader blob size
+		byteCode,     // Shader byte code pointer
+		byteCodeSize, // Shader byte code size
 		&soDecl[0],                     // Stream out declaration
 		(unsigned int)soDecl.size(),    // Number of declaration entries
 		NULL,                           // Buffer strides (not used - assume tightly packed?)
@@ -1371,6 +2028,9 @@ void SimpleGeometryShader::SetShaderAndCBs()
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
+		if (constantBuffers[i].External)
+			continue;
+
 		deviceContext->GSSetConstantBuffers(
 			constantBuffers[i].BindIndex,
 			1,
@@ -1386,7 +2046,7 @@ void SimpleGeometryShader::SetShaderAndCBs()
 //
 // Returns true if a texture of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleGeometryShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
+bool SimpleGeometryShader::SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv)
 {
 	// Look for the variable and verify
 	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
@@ -1408,7 +2068,7 @@ bool SimpleGeometryShader::SetShaderResourceView(std::string name, ID3D11ShaderR
 //
 // Returns true if a sampler of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleGeometryShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
+bool SimpleGeometryShader::SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState)
 {
 	// Look for the variable and verify
 	const SimpleSampler* sampInfo = GetSamplerInfo(name);
@@ -1476,11 +2136,12 @@ void SimpleComputeShader::CleanUp()
 // --------------------------------------------------------
 // Creates the DirectX Compute shader
 //
-// shaderBlob - The shader's compiled code
+// byteCode     - The shader's compiled code
+// byteCodeSize - How many bytes of it there are
 //
 // Returns true if shader is created correctly, false otherwise
 // --------------------------------------------------------
-bool SimpleComputeShader::CreateShader(ID3DBlob* shaderBlob)
+bool SimpleComputeShader::CreateShader(const void* byteCode, size_t byteCodeSize)
 {
 	// Clean up first, in the event this method is
 	// called more than once on the same object
@@ -1488,8 +2149,8 @@ bool SimpleComputeShader::CreateShader(ID3DBlob* shaderBlob)
 
 	// Create the shader from the blob
 	HRESULT result = device->CreateComputeShader(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
+		byteCode,
+		byteCodeSize,
 		0,
 		&shader);
 
@@ -1500,8 +2161,8 @@ bool SimpleComputeShader::CreateShader(ID3DBlob* shaderBlob)
 	// Set up shader reflection to get information about UAV's
 	ID3D11ShaderReflection* refl;
 	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
+		byteCode,
+		byteCodeSize,
 		IID_ID3D11ShaderReflection,
 		(void**)&refl);
 
@@ -1556,6 +2217,9 @@ void SimpleComputeShader::SetShaderAndCBs()
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
+		if (constantBuffers[i].External)
+			continue;
+
 		deviceContext->CSSetConstantBuffers(
 			constantBuffers[i].BindIndex,
 			1,
@@ -1624,7 +2288,7 @@ void SimpleComputeShader::DispatchByThreads(unsigned int threadsX, unsigned int
 //
 // Returns true if a texture of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleComputeShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
+bool SimpleComputeShader::SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv)
 {
 	// Look for the variable and verify
 	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
@@ -1646,7 +2310,7 @@ bool SimpleComputeShader::SetShaderResourceView(std::string name, ID3D11ShaderRe
 //
 // Returns true if a sampler of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleComputeShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
+bool SimpleComputeShader::SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState)
 {
 	// Look for the variable and verify
 	const SimpleSampler* sampInfo = GetSamplerInfo(name);
@@ -1669,7 +2333,7 @@ bool SimpleComputeShader::SetSamplerState(std::string name, ID3D11SamplerState*
 //
 // Returns true if a UAV of the given name was found, false otherwise
 // --------------------------------------------------------
-bool SimpleComputeShader::SetUnorderedAccessView(std::string name, ID3D11UnorderedAccessView * uav, unsigned int appendConsumeOffset)
+bool SimpleComputeShader::SetUnorderedAccessView(const std::string& name, ID3D11UnorderedAccessView * uav, unsigned int appendConsumeOffset)
 {
 	// Look for the variable and verify
 	unsigned int bindIndex = GetUnorderedAccessViewIndex(name);
@@ -1686,7 +2350,7 @@ bool SimpleComputeShader::SetUnorderedAccessView(std::string name, ID3D11Unorder
 // --------------------------------------------------------
 // Gets the index of the specified UAV (or -1)
 // --------------------------------------------------------
-int SimpleComputeShader::GetUnorderedAccessViewIndex(std::string name)
+int SimpleComputeShader::GetUnorderedAccessViewIndex(const std::string& name)
 {
 	// Look for the key
 	std::unordered_map<std::string, unsigned int>::iterator result =
@@ -1698,4 +2362,5 @@ int SimpleComputeShader::GetUnorderedAccessViewIndex(std::string name)
 
 	// Success
 	return result->second;
-}
\ No newline at end of file
+}
+#endif
@@ -1,14 +1,89 @@
 #pragma once
+
+// Only the DirectX backed shader stages (and reflecting shaders
+// that have no sidecar) need the Windows SDK
+#ifdef _WIN32
 #pragma comment(lib, "dxguid.lib")
 #pragma comment(lib, "d3dcompiler.lib")
 
 #include <d3d11.h>
 #include <d3dcompiler.h>
+#endif
 #include <DirectXMath.h>
 
 #include <unordered_map>
 #include <vector>
 #include <string>
+#include <cstring>
+
+#include "RenderDevice.h"
+#include "D3D11Types.h"
+#include "Platform.h"
+#include "ConstantUploadRing.h"
+#include "ShaderReflectionCache.h"
+#include "ConstantBufferLayout.h"
+#include "InputLayoutCache.h"
+
+// --------------------------------------------------------
+// 32 bit FNV-1a hash of a variable or resource name.  It's
+// constexpr, so names known up front can be hashed while
+// compiling and looked up without touching a string:
+//
+//   static constexpr ShaderNameHash World = HashShaderName("world");
+//   ShaderVariableHandle world = shader->GetVariableHandle(World);
+// --------------------------------------------------------
+typedef unsigned int ShaderNameHash;
+
+constexpr ShaderNameHash HashShaderName(const char* name)
+{
+	ShaderNameHash hash = 2166136261u;
+	for (; *name; name++)
+		hash = (hash ^ (unsigned char)*name) * 16777619u;
+	return hash;
+}
+
+// --------------------------------------------------------
+// Names looked up ahead of time, so setting a value is just
+// a copy into the right place.  A handle only works with the
+// shader that gave it out, and only until that shader is
+// loaded again.  Default constructed handles are invalid.
+// --------------------------------------------------------
+struct ShaderVariableHandle
+{
+	unsigned int ConstantBufferIndex = 0;
+	unsigned int ByteOffset = 0;
+	unsigned int Size = 0;			// Zero if the variable wasn't found
+
+	bool IsValid() const { return Size > 0; }
+};
+
+// A constant buffer whose layout was checked against the struct
+// T mirroring it (see ConstantBufferLayout.h), so a whole T can
+// be copied in at once
+template<typename T>
+struct ConstantBufferHandle
+{
+	unsigned int Index = 0;
+	bool Found = false;
+
+	bool IsValid() const { return Found; }
+};
+
+struct ShaderResourceHandle
+{
+	unsigned int BindIndex = 0;
+	bool Found = false;
+
+	bool IsValid() const { return Found; }
+};
+
+struct ShaderSamplerHandle
+{
+	unsigned int BindIndex = 0;
+	bool Found = false;
+
+	bool IsValid() const { return Found; }
+};
 
 // --------------------------------------------------------
 // Used by simple shaders to store information about
@@ -32,8 +107,21 @@ struct SimpleConstantBuffer
 	unsigned int Size;
 	unsigned int BindIndex;
 	ID3D11Buffer* ConstantBuffer;
+	ConstantBufferSlice Slice;		// Where the data was last uploaded, if not ConstantBuffer
+	unsigned long long SliceFrame;	// The upload ring frame the slice is from
 	unsigned char* LocalDataBuffer;
 	std::vector<SimpleShaderVariable> Variables;
+
+	// Whether the local data changed since it was last uploaded, and
+	// the bytes [DirtyStart, DirtyEnd) that changed.  Constant buffers
+	// can only be uploaded whole, so the range is just for information.
+	bool Dirty;
+	unsigned int DirtyStart;
+	unsigned int DirtyEnd;
+
+	// Filled and bound by someone else, so the shader never uploads
+	// or binds it when copying all its data or being set
+	bool External;
 };
 
 // --------------------------------------------------------
@@ -54,13 +142,84 @@ struct SimpleSampler
 	unsigned int BindIndex; // The register of the Sampler
 };
 
+// --------------------------------------------------------
+// Shader resources or samplers waiting to be bound, by slot.
+// Staging a slot marks it dirty and grows the dirty range to
+// cover it.  Flushing walks the range and binds each run of
+// dirty slots with one call, skipping slots nobody staged.
+// --------------------------------------------------------
+template<typename T>
+class StagedBindings
+{
+public:
+	// Slots past the count can't be staged
+	void Resize(unsigned int slotCount)
+	{
+		slots.assign(slotCount, 0);
+		dirty.assign(slotCount, 0);
+		dirtyStart = slotCount;
+		dirtyEnd = 0;
+	}
+
+	bool Stage(unsigned int slot, T* value)
+	{
+		if (slot >= slots.size())
+			return false;
+
+		slots[slot] = value;
+		dirty[slot] = 1;
+		if (slot < dirtyStart) dirtyStart = slot;
+		if (slot + 1 > dirtyEnd) dirtyEnd = slot + 1;
+		return true;
+	}
+
+	bool IsDirty() const { return dirtyStart < dirtyEnd; }
+
+	// Calls bind(startSlot, count, values) for each run of dirty
+	// slots and returns how many calls that took
+	template<typename BindFunction>
+	unsigned int Flush(BindFunction bind)
+	{
+		unsigned int calls = 0;
+		unsigned int slot = dirtyStart;
+		while (slot < dirtyEnd)
+		{
+			if (!dirty[slot])
+			{
+				slot++;
+				continue;
+			}
+
+			unsigned int runStart = slot;
+			while (slot < dirtyEnd && dirty[slot])
+				dirty[slot++] = 0;
+
+			bind(runStart, slot - runStart, &slots[runStart]);
+			calls++;
+		}
+
+		dirtyStart = (unsigned int)slots.size();
+		dirtyEnd = 0;
+		return calls;
+	}
+
+private:
+	std::vector<T*> slots;
+	std::vector<unsigned char> dirty;
+	unsigned int dirtyStart = 0;
+	unsigned int dirtyEnd = 0;
+};
+
 // --------------------------------------------------------
 // Base abstract class for simplifying shader handling
 // --------------------------------------------------------
 class ISimpleShader
 {
 public:
+#ifdef _WIN32
 	ISimpleShader(ID3D11Device* device, ID3D11DeviceContext* context);
+#endif
+	ISimpleShader(IRenderDevice* renderDevice);
 	virtual ~ISimpleShader();
 
 	// Initialization method (since we can't invoke derived class
@@ -72,76 +231,258 @@ public:
 
 	// Activating the shader and copying data
 	void SetShader();
+	void SetShader(IRenderContext* context);
 	void CopyAllBufferData();
 	void CopyBufferData(unsigned int index);
-	void CopyBufferData(std::string bufferName);
+	void CopyBufferData(const std::string& bufferName);
+
+	// Leaves a constant buffer to whoever binds its data instead, like
+	// material parameters kept in each material's own buffer.  False
+	// if there's no buffer with that name.
+	bool SetConstantBufferExternal(const std::string& bufferName, bool external);
 
 	// Sets arbitrary shader data
-	bool SetData(std::string name, const void* data, unsigned int size);
-
-	bool SetInt(std::string name, int data);
-	bool SetFloat(std::string name, float data);
-	bool SetFloat2(std::string name, const float data[2]);
-	bool SetFloat2(std::string name, const DirectX::XMFLOAT2 data);
-	bool SetFloat3(std::string name, const float data[3]);
-	bool SetFloat3(std::string name, const DirectX::XMFLOAT3 data);
-	bool SetFloat4(std::string name, const float data[4]);
-	bool SetFloat4(std::string name, const DirectX::XMFLOAT4 data);
-	bool SetMatrix4x4(std::string name, const float data[16]);
-	bool SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 data);
+	bool SetData(const std::string& name, const void* data, unsigned int size);
+
+	bool SetInt(const std::string& name, int data);
+	bool SetFloat(const std::string& name, float data);
+	bool SetFloat2(const std::string& name, const float data[2]);
+	bool SetFloat2(const std::string& name, const DirectX::XMFLOAT2 data);
+	bool SetFloat3(const std::string& name, const float data[3]);
+	bool SetFloat3(const std::string& name, const DirectX::XMFLOAT3 data);
+	bool SetFloat4(const std::string& name, const float data[4]);
+	bool SetFloat4(const std::string& name, const DirectX::XMFLOAT4 data);
+	bool SetMatrix4x4(const std::string& name, const float data[16]);
+	bool SetMatrix4x4(const std::string& name, const DirectX::XMFLOAT4X4 data);
+
+	// Looking up names once, ahead of time.  Looking up just a hash
+	// fails if two of this shader's names share it.
+	ShaderVariableHandle GetVariableHandle(const std::string& name);
+	ShaderVariableHandle GetVariableHandle(ShaderNameHash nameHash);
+	ShaderResourceHandle GetShaderResourceViewHandle(const std::string& name);
+	ShaderResourceHandle GetShaderResourceViewHandle(ShaderNameHash nameHash);
+	ShaderSamplerHandle GetSamplerHandle(const std::string& name);
+	ShaderSamplerHandle GetSamplerHandle(ShaderNameHash nameHash);
+
+	// Sets data through a handle, which only has to check the size.
+	// Returns false if the handle is invalid or the size is wrong.
+	bool SetData(ShaderVariableHandle variable, const void* data, unsigned int size)
+	{
+		if (!variable.IsValid() || variable.Size != size)
+			return false;
+
+		WriteConstantData(constantBuffers[variable.ConstantBufferIndex], variable.ByteOffset, data, size);
+		return true;
+	}
+
+	bool SetFloat(ShaderVariableHandle variable, float data) { return SetData(variable, &data, sizeof(float)); }
+	bool SetFloat3(ShaderVariableHandle variable, const DirectX::XMFLOAT3& data) { return SetData(variable, &data, sizeof(float) * 3); }
+	bool SetFloat4(ShaderVariableHandle variable, const DirectX::XMFLOAT4& data) { return SetData(variable, &data, sizeof(float) * 4); }
+	bool SetMatrix4x4(ShaderVariableHandle variable, const DirectX::XMFLOAT4X4& data) { return SetData(variable, &data, sizeof(float) * 16); }
+
+	// Looks up a constant buffer by name for a struct mirroring it.  The
+	// struct is checked against HLSL packing when this compiles, and
+	// against the buffer in the compiled shader here.  The handle is
+	// invalid if the buffer isn't there or doesn't match.
+	template<typename T>
+	ConstantBufferHandle<T> GetConstantBufferHandle(const std::string& name)
+	{
+		static_assert(HlslLayoutMatches<T>(), "Struct doesn't match HLSL constant buffer packing");
+
+		ConstantBufferHandle<T> handle;
+		for (unsigned int i = 0; i < reflection.ConstantBuffers.size() && i < constantBufferCount; i++)
+		{
+			if (reflection.ConstantBuffers[i].Name != name)
+				continue;
+
+			handle.Index = i;
+			handle.Found = HlslLayoutMatchesReflection<T>(reflection.ConstantBuffers[i]);
+			break;
+		}
+		return handle;
+	}
+
+	// Copies a whole constant buffer's data in one go
+	template<typename T>
+	bool SetConstantBufferData(ConstantBufferHandle<T> handle, const T& data)
+	{
+		if (!handle.IsValid())
+			return false;
+
+		WriteConstantData(constantBuffers[handle.Index], 0, &data, sizeof(T));
+		return true;
+	}
 
 	// Setting shader resources
-	virtual bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv) = 0;
-	virtual bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState) = 0;
+	virtual bool SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv) = 0;
+	virtual bool SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState) = 0;
 
 	// Getting data about variables and resources
-	const SimpleShaderVariable* GetVariableInfo(std::string name);
+	const SimpleShaderVariable* GetVariableInfo(const std::string& name);
 	
-	const SimpleSRV* GetShaderResourceViewInfo(std::string name);
+	const SimpleSRV* GetShaderResourceViewInfo(const std::string& name);
 	const SimpleSRV* GetShaderResourceViewInfo(unsigned int index);
-	size_t GetShaderResourceViewCount() { return textureTable.size(); }
+	size_t GetShaderResourceViewCount() { return shaderResourceViews.size(); }
 	
-	const SimpleSampler* GetSamplerInfo(std::string name);
+	const SimpleSampler* GetSamplerInfo(const std::string& name);
 	const SimpleSampler* GetSamplerInfo(unsigned int index);
-	size_t GetSamplerCount() { return samplerTable.size(); }
+	size_t GetSamplerCount() { return samplerStates.size(); }
 
 	// Get data about constant buffers
 	unsigned int GetBufferCount();
 	unsigned int GetBufferSize(unsigned int index);
-	const SimpleConstantBuffer* GetBufferInfo(std::string name);
+	const SimpleConstantBuffer* GetBufferInfo(const std::string& name);
 	const SimpleConstantBuffer* GetBufferInfo(unsigned int index);
 	
 	// Misc getters
-	ID3DBlob* GetShaderBlob() { return shaderBlob; }
+	const std::vector<unsigned char>& GetByteCode() { return byteCode; }
+	const ShaderReflectionData& GetReflection() { return reflection; }
+
+	// Reflection is read from a ".refl" sidecar next to each compiled
+	// shader when one matches it, and saved there when it doesn't.
+	// Turning this off always reflects and leaves the sidecars alone.
+	static void SetReflectionCacheEnabled(bool enabled) { reflectionCacheEnabled = enabled; }
+	static bool GetReflectionCacheEnabled() { return reflectionCacheEnabled; }
+	bool LoadedFromReflectionCache() { return loadedFromReflectionCache; }
+
+	// Constant buffer stats since the last reset.  Buffers whose data
+	// hasn't changed since their last upload are skipped, and writes
+	// of the same bytes that are already there don't dirty anything.
+	void ResetUploadStats() { uploads = 0; skippedUploads = 0; unchangedWrites = 0; }
+	unsigned int GetUploads() { return uploads; }
+	unsigned int GetSkippedUploads() { return skippedUploads; }
+	unsigned int GetUnchangedWrites() { return unchangedWrites; }
+
+	// Shader resource and sampler stats since the last reset.  Vertex and
+	// pixel shaders stage them for their own render context and bind
+	// them when the shader is set, each run of slots in one call.
+	void ResetBindStats() { bindingsStaged = 0; bindCalls = 0; }
+	unsigned int GetBindingsStaged() { return bindingsStaged; }
+	unsigned int GetBindCalls() { return bindCalls; }
+
+	// Vertex and pixel shaders bind and copy data through a render
+	// context, which defaults to the render device's immediate context.
+	// Passing null goes back to the default.
+	void SetRenderContext(IRenderContext* renderContext);
+	IRenderContext* GetRenderContext() { return renderContext; }
+
+	// Vertex and pixel shaders can copy their constants into a shared
+	// upload ring and bind just that slice.  Anything that doesn't fit
+	// goes to the shader's own buffers as usual.  Null turns it off.
+	void SetConstantUploadRing(ConstantUploadRing* uploadRing);
 
 protected:
 	
 	bool shaderValid;
-	ID3DBlob* shaderBlob;
+	std::vector<unsigned char> byteCode;
+#ifdef _WIN32
 	ID3D11Device* device;
 	ID3D11DeviceContext* deviceContext;
+#endif
+	IRenderContext* renderContext;
+
+	// Vertex and pixel shaders, and every constant buffer, are created
+	// through the render device.  Shaders given a DirectX device and
+	// context wrap them in a render device of their own.
+	IRenderDevice* renderDevice;
+	IRenderDevice* ownedRenderDevice;
+	ConstantUploadRing* uploadRing;
+
+	// What's in the shader, from the sidecar or from reflecting it
+	ShaderReflectionData reflection;
+	bool loadedFromReflectionCache;
+	static bool reflectionCacheEnabled;
 
 	// Resource counts
 	unsigned int constantBufferCount;
 	
-	// Maps for variables and buffers
+	// A name and what it refers to, in tables sorted by hash
+	struct ShaderNameEntry
+	{
+		ShaderNameHash Hash;
+		unsigned int Index;		// Into the matching array below
+		std::string Name;
+	};
+
+	// Reflection data, in flat arrays
 	SimpleConstantBuffer*		constantBuffers; // For index-based lookup
-	std::vector<SimpleSRV*>		shaderResourceViews;
-	std::vector<SimpleSampler*>	samplerStates;
-	std::unordered_map<std::string, SimpleConstantBuffer*> cbTable;
-	std::unordered_map<std::string, SimpleShaderVariable> varTable;
-	std::unordered_map<std::string, SimpleSRV*> textureTable;
-	std::unordered_map<std::string, SimpleSampler*> samplerTable;
+	std::vector<SimpleShaderVariable>	variables;
+	std::vector<SimpleSRV>		shaderResourceViews;
+	std::vector<SimpleSampler>	samplerStates;
+
+	// Name lookups into the arrays above
+	std::vector<ShaderNameEntry> cbTable;
+	std::vector<ShaderNameEntry> varTable;
+	std::vector<ShaderNameEntry> textureTable;
+	std::vector<ShaderNameEntry> samplerTable;
 
 	// Pure virtual functions for dealing with shader types
-	virtual bool CreateShader(ID3DBlob* shaderBlob) = 0;
+	virtual bool CreateShader(const void* byteCode, size_t byteCodeSize) = 0;
 	virtual void SetShaderAndCBs() = 0;
 
+	// Binds through a specific render context - only reads the shader, so
+	// it's safe to call from several threads at once with different contexts.
+	// Stages without render context support ignore the context.
+	virtual void BindShaderAndCBs(IRenderContext* context) { SetShaderAndCBs(); }
+
 	virtual void CleanUp();
 
+	// Copies a buffer's local data to the GPU, through the ring if possible,
+	// unless what's on the GPU is already up to date
+	void UploadConstantBuffer(SimpleConstantBuffer* cb);
+
+	// Copies data into a buffer's local data, only marking it dirty
+	// if the bytes are actually different
+	void WriteConstantData(SimpleConstantBuffer& cb, unsigned int byteOffset, const void* data, unsigned int size)
+	{
+		unsigned char* destination = cb.LocalDataBuffer + byteOffset;
+		if (memcmp(destination, data, size) == 0)
+		{
+			unchangedWrites++;
+			return;
+		}
+
+		memcpy(destination, data, size);
+		if (!cb.Dirty)
+		{
+			cb.Dirty = true;
+			cb.DirtyStart = byteOffset;
+			cb.DirtyEnd = byteOffset + size;
+			return;
+		}
+		if (byteOffset < cb.DirtyStart) cb.DirtyStart = byteOffset;
+		if (byteOffset + size > cb.DirtyEnd) cb.DirtyEnd = byteOffset + size;
+	}
+
+	// Shader resources and samplers set through the shader's own render
+	// context, waiting for the shader to be set.  Ones set through any
+	// other context are bound straight away, since several threads can
+	// do that at once.
+	StagedBindings<ID3D11ShaderResourceView> stagedShaderResourceViews;
+	StagedBindings<ID3D11SamplerState> stagedSamplers;
+
+	// Stats
+	unsigned int uploads;
+	unsigned int skippedUploads;
+	unsigned int unchangedWrites;
+	unsigned int bindingsStaged;
+	unsigned int bindCalls;
+
+	// Reflection helpers.  Reflecting needs DirectX, so off Windows
+	// shaders can only be loaded with their sidecars.
+	static bool ReflectShader(const void* byteCode, size_t byteCodeSize, ShaderReflectionData& data);
+	static bool LoadReflectionSidecar(const std::wstring& path, ShaderReflectionData& data);
+	static bool SaveReflectionSidecar(const std::wstring& path, const ShaderReflectionData& data);
+
 	// Helpers for finding data by name
-	SimpleShaderVariable* FindVariable(std::string name, int size);
-	SimpleConstantBuffer* FindConstantBuffer(std::string name);
+	SimpleShaderVariable* FindVariable(const std::string& name, int size);
+	SimpleConstantBuffer* FindConstantBuffer(const std::string& name);
+
+	// Name table helpers, returning an index into the table's array or -1
+	static void AddName(std::vector<ShaderNameEntry>& table, const char* name, unsigned int index);
+	static void SortNames(std::vector<ShaderNameEntry>& table);
+	static int FindName(const std::vector<ShaderNameEntry>& table, const std::string& name);
+	static int FindNameHash(const std::vector<ShaderNameEntry>& table, ShaderNameHash nameHash);
 };
 
 // --------------------------------------------------------
@@ -150,22 +491,45 @@ protected:
 class SimpleVertexShader : public ISimpleShader
 {
 public:
+#ifdef _WIN32
 	SimpleVertexShader(ID3D11Device* device, ID3D11DeviceContext* context);
 	SimpleVertexShader(ID3D11Device* device, ID3D11DeviceContext* context, ID3D11InputLayout* inputLayout, bool perInstanceCompatible);
+#endif
+	SimpleVertexShader(IRenderDevice* renderDevice);
 	~SimpleVertexShader();
 	ID3D11VertexShader* GetDirectXShader() { return shader; }
 	ID3D11InputLayout* GetInputLayout() { return inputLayout; }
 	bool GetPerInstanceCompatible() { return perInstanceCompatible; }
 
-	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
-	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	// Vertex shaders loaded after this share input layouts through the
+	// cache, if it's for the same render device.  Null stops sharing.
+	// Shaders using the cache have to be deleted before it is.
+	static void SetInputLayoutCache(InputLayoutCache* cache) { inputLayoutCache = cache; }
+
+	bool SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState);
+
+	// Setting shader resources through a specific render context (thread safe)
+	bool SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv, IRenderContext* context);
+	bool SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState, IRenderContext* context);
+
+	// Setting shader resources through handles, which skips the name lookup
+	bool SetShaderResourceView(ShaderResourceHandle handle, ID3D11ShaderResourceView* srv) { return SetShaderResourceView(handle, srv, renderContext); }
+	bool SetSamplerState(ShaderSamplerHandle handle, ID3D11SamplerState* samplerState) { return SetSamplerState(handle, samplerState, renderContext); }
+	bool SetShaderResourceView(ShaderResourceHandle handle, ID3D11ShaderResourceView* srv, IRenderContext* context);
+	bool SetSamplerState(ShaderSamplerHandle handle, ID3D11SamplerState* samplerState, IRenderContext* context);
 
 protected:
+	void BindShaderResourceView(unsigned int bindIndex, ID3D11ShaderResourceView* srv, IRenderContext* context);
+	void BindSamplerState(unsigned int bindIndex, ID3D11SamplerState* samplerState, IRenderContext* context);
 	bool perInstanceCompatible;
 	ID3D11InputLayout* inputLayout;
+	InputLayoutCache* inputLayoutOwner;	// The cache the layout came from, if any
+	static InputLayoutCache* inputLayoutCache;
 	ID3D11VertexShader* shader;
-	bool CreateShader(ID3DBlob* shaderBlob);
+	bool CreateShader(const void* byteCode, size_t byteCodeSize);
 	void SetShaderAndCBs();
+	void BindShaderAndCBs(IRenderContext* context);
 	void CleanUp();
 };
 
@@ -176,20 +540,37 @@ protected:
 class SimplePixelShader : public ISimpleShader
 {
 public:
+#ifdef _WIN32
 	SimplePixelShader(ID3D11Device* device, ID3D11DeviceContext* context);
+#endif
+	SimplePixelShader(IRenderDevice* renderDevice);
 	~SimplePixelShader();
 	ID3D11PixelShader* GetDirectXShader() { return shader; }
 
-	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
-	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	bool SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState);
+
+	// Setting shader resources through a specific render context (thread safe)
+	bool SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv, IRenderContext* context);
+	bool SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState, IRenderContext* context);
+
+	// Setting shader resources through handles, which skips the name lookup
+	bool SetShaderResourceView(ShaderResourceHandle handle, ID3D11ShaderResourceView* srv) { return SetShaderResourceView(handle, srv, renderContext); }
+	bool SetSamplerState(ShaderSamplerHandle handle, ID3D11SamplerState* samplerState) { return SetSamplerState(handle, samplerState, renderContext); }
+	bool SetShaderResourceView(ShaderResourceHandle handle, ID3D11ShaderResourceView* srv, IRenderContext* context);
+	bool SetSamplerState(ShaderSamplerHandle handle, ID3D11SamplerState* samplerState, IRenderContext* context);
 
 protected:
+	void BindShaderResourceView(unsigned int bindIndex, ID3D11ShaderResourceView* srv, IRenderContext* context);
+	void BindSamplerState(unsigned int bindIndex, ID3D11SamplerState* samplerState, IRenderContext* context);
 	ID3D11PixelShader* shader;
-	bool CreateShader(ID3DBlob* shaderBlob);
+	bool CreateShader(const void* byteCode, size_t byteCodeSize);
 	void SetShaderAndCBs();
+	void BindShaderAndCBs(IRenderContext* context);
 	void CleanUp();
 };
 
+#ifdef _WIN32
 // --------------------------------------------------------
 // Derived class for DOMAIN shaders ///////////////////////
 // --------------------------------------------------------
@@ -200,12 +581,12 @@ public:
 	~SimpleDomainShader();
 	ID3D11DomainShader* GetDirectXShader() { return shader; }
 
-	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
-	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	bool SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState);
 
 protected:
 	ID3D11DomainShader* shader;
-	bool CreateShader(ID3DBlob* shaderBlob);
+	bool CreateShader(const void* byteCode, size_t byteCodeSize);
 	void SetShaderAndCBs();
 	void CleanUp();
 };
@@ -220,12 +601,12 @@ public:
 	~SimpleHullShader();
 	ID3D11HullShader* GetDirectXShader() { return shader; }
 
-	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
-	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	bool SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState);
 
 protected:
 	ID3D11HullShader* shader;
-	bool CreateShader(ID3DBlob* shaderBlob);
+	bool CreateShader(const void* byteCode, size_t byteCodeSize);
 	void SetShaderAndCBs();
 	void CleanUp();
 };
@@ -240,8 +621,8 @@ public:
 	~SimpleGeometryShader();
 	ID3D11GeometryShader* GetDirectXShader() { return shader; }
 
-	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
-	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	bool SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState);
 
 	bool CreateCompatibleStreamOutBuffer(ID3D11Buffer** buffer, int vertexCount);
 
@@ -256,8 +637,8 @@ protected:
 	bool allowStreamOutRasterization;
 	unsigned int streamOutVertexSize;
 
-	bool CreateShader(ID3DBlob* shaderBlob);
-	bool CreateShaderWithStreamOut(ID3DBlob* shaderBlob);
+	bool CreateShader(const void* byteCode, size_t byteCodeSize);
+	bool CreateShaderWithStreamOut(const void* byteCode, size_t byteCodeSize);
 	void SetShaderAndCBs();
 	void CleanUp();
 
@@ -279,11 +660,11 @@ public:
 	void DispatchByGroups(unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ);
 	void DispatchByThreads(unsigned int threadsX, unsigned int threadsY, unsigned int threadsZ);
 
-	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
-	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
-	bool SetUnorderedAccessView(std::string name, ID3D11UnorderedAccessView* uav, unsigned int appendConsumeOffset = -1);
+	bool SetShaderResourceView(const std::string& name, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(const std::string& name, ID3D11SamplerState* samplerState);
+	bool SetUnorderedAccessView(const std::string& name, ID3D11UnorderedAccessView* uav, unsigned int appendConsumeOffset = -1);
 
-	int GetUnorderedAccessViewIndex(std::string name);
+	int GetUnorderedAccessViewIndex(const std::string& name);
 
 protected:
 	ID3D11ComputeShader* shader;
@@ -294,7 +675,8 @@ protected:
 	unsigned int threadsZ;
 	unsigned int threadsTotal;
 
-	bool CreateShader(ID3DBlob* shaderBlob);
+	bool CreateShader(const void* byteCode, size_t byteCodeSize);
 	void SetShaderAndCBs();
 	void CleanUp();
-};
\ No newline at end of file
+};
+#endif
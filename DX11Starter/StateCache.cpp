@@ -0,0 +1,551 @@
+#include "StateCache.h"
+
+StateCache::StateCache(IRenderContext* target)
+{
+	this->target = target;
+	Invalidate();
+	ResetStats();
+	ResetRenderStats();
+}
+
+StateCache::~StateCache()
+{
+}
+
+// --------------------------------------------------------
+// Marks every slot as unknown.  Nothing is unbound - the
+// next call to each slot is simply passed on unfiltered.
+// --------------------------------------------------------
+void StateCache::Invalidate()
+{
+	inputLayoutKnown = false;
+	inputLayout = 0;
+	topologyKnown = false;
+	topology = 0;
+	for (unsigned int i = 0; i < VertexBufferSlots; i++)
+	{
+		vertexBuffersKnown[i] = false;
+		vertexBuffers[i] = 0;
+		vertexStrides[i] = 0;
+		vertexOffsets[i] = 0;
+	}
+	indexBufferKnown = false;
+	indexBuffer = 0;
+	indexFormat = 0;
+	indexOffset = 0;
+
+	rasterizerStateKnown = false;
+	rasterizerState = 0;
+	blendStateKnown = false;
+	blendState = 0;
+	depthStencilStateKnown = false;
+	depthStencilState = 0;
+	stencilRef = 0;
+
+	InvalidateStage(vertexStage);
+	InvalidateStage(pixelStage);
+}
+
+void StateCache::ResetStats()
+{
+	issuedCalls = 0;
+	filteredCalls = 0;
+}
+
+void StateCache::ResetRenderStats()
+{
+	renderStats.Reset();
+}
+
+void StateCache::IASetInputLayout(ID3D11InputLayout* inputLayout)
+{
+	if (inputLayoutKnown && this->inputLayout == inputLayout)
+	{
+		filteredCalls++;
+		return;
+	}
+
+	inputLayoutKnown = true;
+	this->inputLayout = inputLayout;
+	issuedCalls++;
+	RENDER_STATS(renderStats.OtherStateChanges++);
+	target->IASetInputLayout(inputLayout);
+}
+
+void StateCache::IASetPrimitiveTopology(unsigned int topology)
+{
+	if (topologyKnown && this->topology == topology)
+	{
+		filteredCalls++;
+		return;
+	}
+
+	topologyKnown = true;
+	this->topology = topology;
+	issuedCalls++;
+	RENDER_STATS(renderStats.OtherStateChanges++);
+	target->IASetPrimitiveTopology(topology);
+}
+
+// --------------------------------------------------------
+// Vertex buffers are only the same if the buffer, stride
+// and offset all match, so these can't use ChangedRange()
+// --------------------------------------------------------
+void StateCache::IASetVertexBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* strides, const unsigned int* offsets)
+{
+	// Let DirectX deal with out of range slots, and forget the ones in
+	// range, since there's no telling which of them it went on to set
+	if (startSlot + numBuffers > VertexBufferSlots)
+	{
+		for (unsigned int slot = startSlot; slot < VertexBufferSlots; slot++)
+			vertexBuffersKnown[slot] = false;
+		issuedCalls++;
+		RENDER_STATS(renderStats.OtherStateChanges++);
+		target->IASetVertexBuffers(startSlot, numBuffers, buffers, strides, offsets);
+		return;
+	}
+
+	unsigned int first = numBuffers;
+	unsigned int last = 0;
+	for (unsigned int i = 0; i < numBuffers; i++)
+	{
+		unsigned int slot = startSlot + i;
+		if (vertexBuffersKnown[slot] &&
+			vertexBuffers[slot] == buffers[i] &&
+			vertexStrides[slot] == strides[i] &&
+			vertexOffsets[slot] == offsets[i])
+			continue;
+
+		vertexBuffersKnown[slot] = true;
+		vertexBuffers[slot] = buffers[i];
+		vertexStrides[slot] = strides[i];
+		vertexOffsets[slot] = offsets[i];
+		if (first == numBuffers) first = i;
+		last = i;
+	}
+
+	if (first == numBuffers)
+	{
+		filteredCalls++;
+		return;
+	}
+
+	issuedCalls++;
+	RENDER_STATS(renderStats.OtherStateChanges++);
+	target->IASetVertexBuffers(startSlot + first, last - first + 1, buffers + first, strides + first, offsets + first);
+}
+
+void StateCache::IASetIndexBuffer(ID3D11Buffer* indexBuffer, unsigned int format, unsigned int offset)
+{
+	if (indexBufferKnown &&
+		this->indexBuffer == indexBuffer &&
+		indexFormat == format &&
+		indexOffset == offset)
+	{
+		filteredCalls++;
+		return;
+	}
+
+	indexBufferKnown = true;
+	this->indexBuffer = indexBuffer;
+	indexFormat = format;
+	indexOffset = offset;
+	issuedCalls++;
+	RENDER_STATS(renderStats.OtherStateChanges++);
+	target->IASetIndexBuffer(indexBuffer, format, offset);
+}
+
+void StateCache::VSSetShader(ID3D11VertexShader* shader)
+{
+	if (ShaderChanged(vertexStage, shader))
+	{
+		RENDER_STATS(renderStats.ShaderBinds++);
+		target->VSSetShader(shader);
+	}
+}
+
+void StateCache::VSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers)
+{
+	unsigned int first, last;
+	ForgetConstantBufferRanges(vertexStage, startSlot, numBuffers);
+	if (ChangedRange(vertexStage.ConstantBuffersKnown, vertexStage.ConstantBuffers, ConstantBufferSlots, startSlot, numBuffers, buffers, first, last))
+	{
+		RENDER_STATS(renderStats.ConstantBufferBinds++);
+		target->VSSetConstantBuffers(startSlot + first, last - first + 1, buffers + first);
+	}
+}
+
+void StateCache::VSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views)
+{
+	unsigned int first, last;
+	if (ChangedRange(vertexStage.ShaderResourcesKnown, vertexStage.ShaderResources, ShaderResourceSlots, startSlot, numViews, views, first, last))
+	{
+		RENDER_STATS(renderStats.ShaderResourceBinds++);
+		target->VSSetShaderResources(startSlot + first, last - first + 1, views + first);
+	}
+}
+
+void StateCache::VSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers)
+{
+	unsigned int first, last;
+	if (ChangedRange(vertexStage.SamplersKnown, vertexStage.Samplers, SamplerSlots, startSlot, numSamplers, samplers, first, last))
+	{
+		RENDER_STATS(renderStats.SamplerBinds++);
+		target->VSSetSamplers(startSlot + first, last - first + 1, samplers + first);
+	}
+}
+
+void StateCache::PSSetShader(ID3D11PixelShader* shader)
+{
+	if (ShaderChanged(pixelStage, shader))
+	{
+		RENDER_STATS(renderStats.ShaderBinds++);
+		target->PSSetShader(shader);
+	}
+}
+
+void StateCache::PSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers)
+{
+	unsigned int first, last;
+	ForgetConstantBufferRanges(pixelStage, startSlot, numBuffers);
+	if (ChangedRange(pixelStage.ConstantBuffersKnown, pixelStage.ConstantBuffers, ConstantBufferSlots, startSlot, numBuffers, buffers, first, last))
+	{
+		RENDER_STATS(renderStats.ConstantBufferBinds++);
+		target->PSSetConstantBuffers(startSlot + first, last - first + 1, buffers + first);
+	}
+}
+
+void StateCache::PSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views)
+{
+	unsigned int first, last;
+	if (ChangedRange(pixelStage.ShaderResourcesKnown, pixelStage.ShaderResources, ShaderResourceSlots, startSlot, numViews, views, first, last))
+	{
+		RENDER_STATS(renderStats.ShaderResourceBinds++);
+		target->PSSetShaderResources(startSlot + first, last - first + 1, views + first);
+	}
+}
+
+void StateCache::PSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers)
+{
+	unsigned int first, last;
+	if (ChangedRange(pixelStage.SamplersKnown, pixelStage.Samplers, SamplerSlots, startSlot, numSamplers, samplers, first, last))
+	{
+		RENDER_STATS(renderStats.SamplerBinds++);
+		target->PSSetSamplers(startSlot + first, last - first + 1, samplers + first);
+	}
+}
+
+void StateCache::RSSetState(ID3D11RasterizerState* rasterizerState)
+{
+	if (rasterizerStateKnown && this->rasterizerState == rasterizerState)
+	{
+		filteredCalls++;
+		return;
+	}
+
+	rasterizerStateKnown = true;
+	this->rasterizerState = rasterizerState;
+	issuedCalls++;
+	RENDER_STATS(renderStats.OtherStateChanges++);
+	target->RSSetState(rasterizerState);
+}
+
+void StateCache::OMSetBlendState(ID3D11BlendState* blendState)
+{
+	if (blendStateKnown && this->blendState == blendState)
+	{
+		filteredCalls++;
+		return;
+	}
+
+	blendStateKnown = true;
+	this->blendState = blendState;
+	issuedCalls++;
+	RENDER_STATS(renderStats.OtherStateChanges++);
+	target->OMSetBlendState(blendState);
+}
+
+void StateCache::OMSetDepthStencilState(ID3D11DepthStencilState* depthStencilState, unsigned int stencilRef)
+{
+	if (depthStencilStateKnown && this->depthStencilState == depthStencilState && this->stencilRef == stencilRef)
+	{
+		filteredCalls++;
+		return;
+	}
+
+	depthStencilStateKnown = true;
+	this->depthStencilState = depthStencilState;
+	this->stencilRef = stencilRef;
+	issuedCalls++;
+	RENDER_STATS(renderStats.OtherStateChanges++);
+	target->OMSetDepthStencilState(depthStencilState, stencilRef);
+}
+
+void StateCache::OMSetRenderTargets(unsigned int numViews, ID3D11RenderTargetView* const* renderTargetViews, ID3D11DepthStencilView* depthStencilView)
+{
+	issuedCalls++;
+	RENDER_STATS(renderStats.OtherStateChanges++);
+	target->OMSetRenderTargets(numViews, renderTargetViews, depthStencilView);
+}
+
+void StateCache::RSSetViewport(float topLeftX, float topLeftY, float width, float height, float minDepth, float maxDepth)
+{
+	issuedCalls++;
+	RENDER_STATS(renderStats.OtherStateChanges++);
+	target->RSSetViewport(topLeftX, topLeftY, width, height, minDepth, maxDepth);
+}
+
+void StateCache::ClearRenderTargetView(ID3D11RenderTargetView* renderTargetView, const float color[4])
+{
+	target->ClearRenderTargetView(renderTargetView, color);
+}
+
+void StateCache::ClearDepthStencilView(ID3D11DepthStencilView* depthStencilView, float depth, unsigned char stencil)
+{
+	target->ClearDepthStencilView(depthStencilView, depth, stencil);
+}
+
+void StateCache::UpdateSubresource(ID3D11Buffer* buffer, const void* data, unsigned int byteSize)
+{
+	RENDER_STATS(renderStats.BytesUploaded += byteSize);
+	target->UpdateSubresource(buffer, data, byteSize);
+}
+
+void StateCache::UpdateSubresourceRange(ID3D11Buffer* buffer, unsigned int byteOffset, const void* data, unsigned int byteSize)
+{
+	RENDER_STATS(renderStats.BytesUploaded += byteSize);
+	target->UpdateSubresourceRange(buffer, byteOffset, data, byteSize);
+}
+
+void StateCache::UpdateTextureRegion(ID3D11ShaderResourceView* texture, unsigned int mipLevel, unsigned int left, unsigned int top, unsigned int width, unsigned int height, const void* data, unsigned int rowPitch)
+{
+	RENDER_STATS(renderStats.BytesUploaded += (unsigned long long)rowPitch * height);
+	target->UpdateTextureRegion(texture, mipLevel, left, top, width, height, data, rowPitch);
+}
+
+// Not tracked, it's a property of the texture rather than the pipeline
+void StateCache::SetResourceMinLOD(ID3D11ShaderResourceView* texture, float minLOD)
+{
+	target->SetResourceMinLOD(texture, minLOD);
+}
+
+void StateCache::CopyBufferRegion(ID3D11Buffer* destination, unsigned int destinationOffset, ID3D11Buffer* source, unsigned int sourceOffset, unsigned int byteSize)
+{
+	RENDER_STATS(renderStats.BytesUploaded += byteSize);
+	target->CopyBufferRegion(destination, destinationOffset, source, sourceOffset, byteSize);
+}
+
+void* StateCache::MapDiscard(ID3D11Buffer* buffer)
+{
+	return target->MapDiscard(buffer);
+}
+
+void* StateCache::MapNoOverwrite(ID3D11Buffer* buffer)
+{
+	return target->MapNoOverwrite(buffer);
+}
+
+void* StateCache::MapStaging(ID3D11Buffer* buffer)
+{
+	return target->MapStaging(buffer);
+}
+
+void StateCache::Unmap(ID3D11Buffer* buffer)
+{
+	target->Unmap(buffer);
+}
+
+bool StateCache::SupportsConstantBufferOffsets()
+{
+	return target->SupportsConstantBufferOffsets();
+}
+
+void StateCache::VSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants)
+{
+	unsigned int first, last;
+	if (ConstantBufferRangesChanged(vertexStage, startSlot, numBuffers, buffers, firstConstants, numConstants, first, last))
+	{
+		RENDER_STATS(renderStats.ConstantBufferBinds++);
+		target->VSSetConstantBuffers1(startSlot + first, last - first + 1, buffers + first, firstConstants + first, numConstants + first);
+	}
+}
+
+void StateCache::PSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants)
+{
+	unsigned int first, last;
+	if (ConstantBufferRangesChanged(pixelStage, startSlot, numBuffers, buffers, firstConstants, numConstants, first, last))
+	{
+		RENDER_STATS(renderStats.ConstantBufferBinds++);
+		target->PSSetConstantBuffers1(startSlot + first, last - first + 1, buffers + first, firstConstants + first, numConstants + first);
+	}
+}
+
+void StateCache::DrawIndexed(unsigned int indexCount, unsigned int startIndexLocation, int baseVertexLocation)
+{
+	RENDER_STATS(renderStats.Draws++);
+	RENDER_STATS(renderStats.Indices += indexCount);
+	RENDER_STATS(renderStats.Instances++);
+	target->DrawIndexed(indexCount, startIndexLocation, baseVertexLocation);
+}
+
+void StateCache::DrawIndexedInstanced(unsigned int indexCountPerInstance, unsigned int instanceCount, unsigned int startIndexLocation, int baseVertexLocation, unsigned int startInstanceLocation)
+{
+	RENDER_STATS(renderStats.Draws++);
+	RENDER_STATS(renderStats.Indices += (unsigned long long)indexCountPerInstance * instanceCount);
+	RENDER_STATS(renderStats.Instances += instanceCount);
+	target->DrawIndexedInstanced(indexCountPerInstance, instanceCount, startIndexLocation, baseVertexLocation, startInstanceLocation);
+}
+
+void StateCache::ExecuteCommandList(ID3D11CommandList* commandList)
+{
+	target->ExecuteCommandList(commandList);
+	Invalidate();
+}
+
+void StateCache::InvalidateStage(StageState& stage)
+{
+	stage.ShaderKnown = false;
+	stage.Shader = 0;
+	for (unsigned int i = 0; i < ConstantBufferSlots; i++)
+	{
+		stage.ConstantBuffersKnown[i] = false;
+		stage.ConstantBuffers[i] = 0;
+		stage.ConstantBufferFirst[i] = 0;
+		stage.ConstantBufferCount[i] = 0;
+	}
+	for (unsigned int i = 0; i < ShaderResourceSlots; i++)
+	{
+		stage.ShaderResourcesKnown[i] = false;
+		stage.ShaderResources[i] = 0;
+	}
+	for (unsigned int i = 0; i < SamplerSlots; i++)
+	{
+		stage.SamplersKnown[i] = false;
+		stage.Samplers[i] = 0;
+	}
+}
+
+// --------------------------------------------------------
+// Checks (and records) a stage's shader, returning true if
+// the call needs to go through
+// --------------------------------------------------------
+bool StateCache::ShaderChanged(StageState& stage, void* shader)
+{
+	if (stage.ShaderKnown && stage.Shader == shader)
+	{
+		filteredCalls++;
+		return false;
+	}
+
+	stage.ShaderKnown = true;
+	stage.Shader = shader;
+	issuedCalls++;
+	return true;
+}
+
+// --------------------------------------------------------
+// A plain bind covers the whole buffer, so any slot last bound
+// with a range has to be sent again even if the buffer matches
+// --------------------------------------------------------
+void StateCache::ForgetConstantBufferRanges(StageState& stage, unsigned int startSlot, unsigned int numBuffers)
+{
+	for (unsigned int slot = startSlot; slot < startSlot + numBuffers && slot < ConstantBufferSlots; slot++)
+	{
+		if (stage.ConstantBufferFirst[slot] == 0 && stage.ConstantBufferCount[slot] == 0)
+			continue;
+
+		stage.ConstantBuffersKnown[slot] = false;
+		stage.ConstantBufferFirst[slot] = 0;
+		stage.ConstantBufferCount[slot] = 0;
+	}
+}
+
+// --------------------------------------------------------
+// Like ChangedRange(), but a slot only matches if its buffer,
+// first constant and constant count are all the same
+// --------------------------------------------------------
+bool StateCache::ConstantBufferRangesChanged(StageState& stage, unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants, unsigned int& first, unsigned int& last)
+{
+	first = 0;
+	last = numBuffers - 1;
+	if (startSlot + numBuffers > ConstantBufferSlots)
+	{
+		for (unsigned int slot = startSlot; slot < ConstantBufferSlots; slot++)
+			stage.ConstantBuffersKnown[slot] = false;
+		issuedCalls++;
+		return true;
+	}
+
+	first = numBuffers;
+	for (unsigned int i = 0; i < numBuffers; i++)
+	{
+		unsigned int slot = startSlot + i;
+		if (stage.ConstantBuffersKnown[slot] &&
+			stage.ConstantBuffers[slot] == buffers[i] &&
+			stage.ConstantBufferFirst[slot] == firstConstants[i] &&
+			stage.ConstantBufferCount[slot] == numConstants[i])
+			continue;
+
+		stage.ConstantBuffersKnown[slot] = true;
+		stage.ConstantBuffers[slot] = buffers[i];
+		stage.ConstantBufferFirst[slot] = firstConstants[i];
+		stage.ConstantBufferCount[slot] = numConstants[i];
+		if (first == numBuffers) first = i;
+		last = i;
+	}
+
+	if (first == numBuffers)
+	{
+		filteredCalls++;
+		return false;
+	}
+
+	issuedCalls++;
+	return true;
+}
+
+// --------------------------------------------------------
+// Compares a run of slots against the shadow copy.  Only the
+// span from the first to the last changed slot needs to be
+// sent on - unchanged slots inside it are harmless to rebind.
+//
+// Ranges past the end of the table are always sent on, so
+// DirectX can report the error.  Whatever part of them is in
+// the table is forgotten rather than recorded, since the
+// call may not have set those slots either.
+// --------------------------------------------------------
+template<typename T>
+bool StateCache::ChangedRange(bool* known, T** shadow, unsigned int slotCount, unsigned int startSlot, unsigned int count, T* const* values, unsigned int& first, unsigned int& last)
+{
+	first = 0;
+	last = count - 1;
+	if (startSlot + count > slotCount)
+	{
+		for (unsigned int slot = startSlot; slot < slotCount; slot++)
+			known[slot] = false;
+		issuedCalls++;
+		return true;
+	}
+
+	first = count;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned int slot = startSlot + i;
+		if (known[slot] && shadow[slot] == values[i])
+			continue;
+
+		known[slot] = true;
+		shadow[slot] = values[i];
+		if (first == count) first = i;
+		last = i;
+	}
+
+	if (first == count)
+	{
+		filteredCalls++;
+		return false;
+	}
+
+	issuedCalls++;
+	return true;
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "RenderContext.h"
+#include "RenderStats.h"
+
+// --------------------------------------------------------
+// Sits between the engine and another render context,
+// remembering what's bound to every slot and dropping calls
+// that wouldn't change anything.
+//
+// The cache only sees calls made through it, so call
+// Invalidate() whenever state may have changed behind its
+// back (other code using the raw context, resources being
+// released and their addresses reused, and so on).
+// --------------------------------------------------------
+class StateCache : public IRenderContext
+{
+public:
+	StateCache(IRenderContext* target); // Constructor
+	~StateCache(); // Destructor
+
+	// Forgets everything, so the next call to each slot goes through
+	void Invalidate();
+
+	// Stats for state setting calls - a multi-slot call counts
+	// once, and is only filtered if none of its slots changed
+	void ResetStats();
+	unsigned int GetIssuedCalls() { return issuedCalls; }
+	unsigned int GetFilteredCalls() { return filteredCalls; }
+
+	// What was actually sent on to the target since the last reset.
+	// Only counted in builds with ENGINE_RENDER_STATS defined.
+	void ResetRenderStats();
+	const RenderStatCounters& GetRenderStats() { return renderStats; }
+
+	// Input assembler
+	void IASetInputLayout(ID3D11InputLayout* inputLayout);
+	void IASetPrimitiveTopology(unsigned int topology);
+	void IASetVertexBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* strides, const unsigned int* offsets);
+	void IASetIndexBuffer(ID3D11Buffer* indexBuffer, unsigned int format, unsigned int offset);
+
+	// Vertex shader stage
+	void VSSetShader(ID3D11VertexShader* shader);
+	void VSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers);
+	void VSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views);
+	void VSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers);
+
+	// Pixel shader stage
+	void PSSetShader(ID3D11PixelShader* shader);
+	void PSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers);
+	void PSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views);
+	void PSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers);
+
+	// Rasterizer, blend and depth stencil states
+	void RSSetState(ID3D11RasterizerState* rasterizerState);
+	void OMSetBlendState(ID3D11BlendState* blendState);
+	void OMSetDepthStencilState(ID3D11DepthStencilState* depthStencilState, unsigned int stencilRef);
+
+	// Render targets, viewports and clears aren't tracked, so these always go through
+	void OMSetRenderTargets(unsigned int numViews, ID3D11RenderTargetView* const* renderTargetViews, ID3D11DepthStencilView* depthStencilView);
+	void RSSetViewport(float topLeftX, float topLeftY, float width, float height, float minDepth, float maxDepth);
+	void ClearRenderTargetView(ID3D11RenderTargetView* renderTargetView, const float color[4]);
+	void ClearDepthStencilView(ID3D11DepthStencilView* depthStencilView, float depth, unsigned char stencil);
+
+	// Never filtered - the contents may have changed even if the buffer hasn't
+	void UpdateSubresource(ID3D11Buffer* buffer, const void* data, unsigned int byteSize);
+	void UpdateSubresourceRange(ID3D11Buffer* buffer, unsigned int byteOffset, const void* data, unsigned int byteSize);
+	void UpdateTextureRegion(ID3D11ShaderResourceView* texture, unsigned int mipLevel, unsigned int left, unsigned int top, unsigned int width, unsigned int height, const void* data, unsigned int rowPitch);
+	void SetResourceMinLOD(ID3D11ShaderResourceView* texture, float minLOD);
+	void CopyBufferRegion(ID3D11Buffer* destination, unsigned int destinationOffset, ID3D11Buffer* source, unsigned int sourceOffset, unsigned int byteSize);
+
+	void* MapDiscard(ID3D11Buffer* buffer);
+	void* MapNoOverwrite(ID3D11Buffer* buffer);
+	void* MapStaging(ID3D11Buffer* buffer);
+	void Unmap(ID3D11Buffer* buffer);
+
+	// A constant buffer slot only matches if the buffer and the bound
+	// range are both the same.  Whole buffer binds count as range 0/0.
+	bool SupportsConstantBufferOffsets();
+	void VSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants);
+	void PSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants);
+
+	void DrawIndexed(unsigned int indexCount, unsigned int startIndexLocation, int baseVertexLocation);
+	void DrawIndexedInstanced(unsigned int indexCountPerInstance, unsigned int instanceCount, unsigned int startIndexLocation, int baseVertexLocation, unsigned int startInstanceLocation);
+
+	// Executing a command list resets the context, so this invalidates the cache
+	void ExecuteCommandList(ID3D11CommandList* commandList);
+
+	// Slot counts, matching the DirectX 11 limits
+	static const unsigned int VertexBufferSlots = 32;
+	static const unsigned int ConstantBufferSlots = 14;
+	static const unsigned int ShaderResourceSlots = 128;
+	static const unsigned int SamplerSlots = 16;
+
+private:
+	// Shadowed state for one shader stage
+	struct StageState
+	{
+		bool ShaderKnown;
+		void* Shader;
+		bool ConstantBuffersKnown[ConstantBufferSlots];
+		ID3D11Buffer* ConstantBuffers[ConstantBufferSlots];
+		unsigned int ConstantBufferFirst[ConstantBufferSlots];	// In 16 byte constants,
+		unsigned int ConstantBufferCount[ConstantBufferSlots];	// 0 for the whole buffer
+		bool ShaderResourcesKnown[ShaderResourceSlots];
+		ID3D11ShaderResourceView* ShaderResources[ShaderResourceSlots];
+		bool SamplersKnown[SamplerSlots];
+		ID3D11SamplerState* Samplers[SamplerSlots];
+	};
+
+	// Helper methods
+	void InvalidateStage(StageState& stage);
+	bool ShaderChanged(StageState& stage, void* shader);
+	void ForgetConstantBufferRanges(StageState& stage, unsigned int startSlot, unsigned int numBuffers);
+	bool ConstantBufferRangesChanged(StageState& stage, unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants, unsigned int& first, unsigned int& last);
+
+	// Finds the first and last of the given slots whose value differs
+	// from the shadow copy, updating the shadow as it goes.
+	// Returns false if nothing changed.
+	template<typename T>
+	bool ChangedRange(bool* known, T** shadow, unsigned int slotCount, unsigned int startSlot, unsigned int count, T* const* values, unsigned int& first, unsigned int& last);
+
+	IRenderContext* target;
+
+	// Input assembler state
+	bool inputLayoutKnown;
+	ID3D11InputLayout* inputLayout;
+	bool topologyKnown;
+	unsigned int topology;
+	bool vertexBuffersKnown[VertexBufferSlots];
+	ID3D11Buffer* vertexBuffers[VertexBufferSlots];
+	unsigned int vertexStrides[VertexBufferSlots];
+	unsigned int vertexOffsets[VertexBufferSlots];
+	bool indexBufferKnown;
+	ID3D11Buffer* indexBuffer;
+	unsigned int indexFormat;
+	unsigned int indexOffset;
+
+	// Rasterizer and output merger state
+	bool rasterizerStateKnown;
+	ID3D11RasterizerState* rasterizerState;
+	bool blendStateKnown;
+	ID3D11BlendState* blendState;
+	bool depthStencilStateKnown;
+	ID3D11DepthStencilState* depthStencilState;
+	unsigned int stencilRef;
+
+	// Shader stage state
+	StageState vertexStage;
+	StageState pixelStage;
+
+	// Stats
+	unsigned int issuedCalls;
+	unsigned int filteredCalls;
+	RenderStatCounters renderStats;
+};
@@ -0,0 +1,332 @@
+#include "StaticBatcher.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <functional>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+StaticBatcher::StaticBatcher(IRenderDevice* device)
+{
+	this->device = device;
+	cellSize = 32.0f;
+	maxVertices = 65536;
+	batchedVertices = 0;
+	buildCount = 0;
+	dirty = true;
+}
+
+StaticBatcher::~StaticBatcher()
+{
+	ReleaseBatches();
+}
+
+void StaticBatcher::SetCellSize(float cellSize)
+{
+	this->cellSize = cellSize;
+	dirty = true;
+}
+
+void StaticBatcher::SetMaxVerticesPerBatch(unsigned int maxVertices)
+{
+	this->maxVertices = maxVertices;
+	dirty = true;
+}
+
+// --------------------------------------------------------
+// Sorts the static entities by material and cell, then walks
+// them in that order, cutting a new batch whenever either one
+// changes or the current batch would get too big
+// --------------------------------------------------------
+void StaticBatcher::Build(std::vector<Entity>& entities)
+{
+	ReleaseBatches();
+	ranges.clear();
+	entityRanges.assign(entities.size(), -1);
+	batchedVertices = 0;
+	buildCount++;
+	dirty = false;
+
+	builtEntities.resize(entities.size());
+	for (std::vector<Entity>::size_type i = 0; i != entities.size(); i++)
+	{
+		builtEntities[i].Static = entities[i].IsStatic();
+		builtEntities[i].TransformVersion = entities[i].GetTransformVersion();
+		builtEntities[i].SourceMesh = entities[i].GetMesh();
+		builtEntities[i].SourceMaterial = entities[i].GetMaterial();
+	}
+
+	// Where each static entity goes.  Batches are split by the material
+	// itself, since materials that were never registered all have ID 0.
+	// The ID only keeps registered materials in a stable order.
+	struct Candidate
+	{
+		unsigned int MaterialID;
+		Material* SourceMaterial;
+		int CellX, CellY, CellZ;
+		unsigned int EntityIndex;
+	};
+	std::vector<Candidate> candidates;
+	for (unsigned int i = 0; i < (unsigned int)entities.size(); i++)
+	{
+		// Transparent entities need sorting every frame, so they're never merged
+		Entity& entity = entities[i];
+		if (!entity.IsStatic() || entity.GetMaterial()->IsTransparent() || entity.GetMesh()->GetIndices().empty())
+			continue;
+
+		XMFLOAT3 center = entity.GetBoundsCenter();
+		Candidate candidate;
+		candidate.MaterialID = entity.GetMaterial()->GetID();
+		candidate.SourceMaterial = entity.GetMaterial();
+		candidate.CellX = (int)floorf(center.x / cellSize);
+		candidate.CellY = (int)floorf(center.y / cellSize);
+		candidate.CellZ = (int)floorf(center.z / cellSize);
+		candidate.EntityIndex = i;
+		candidates.push_back(candidate);
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b)
+	{
+		if (a.MaterialID != b.MaterialID) return a.MaterialID < b.MaterialID;
+		if (a.SourceMaterial != b.SourceMaterial) return std::less<Material*>()(a.SourceMaterial, b.SourceMaterial);
+		if (a.CellX != b.CellX) return a.CellX < b.CellX;
+		if (a.CellY != b.CellY) return a.CellY < b.CellY;
+		if (a.CellZ != b.CellZ) return a.CellZ < b.CellZ;
+		return a.EntityIndex < b.EntityIndex;
+	});
+
+	std::vector<unsigned int> members(candidates.size());
+	for (std::vector<Candidate>::size_type i = 0; i != candidates.size(); i++)
+		members[i] = candidates[i].EntityIndex;
+
+	unsigned int first = 0;
+	unsigned int vertexCount = 0;
+	for (unsigned int i = 0; i < (unsigned int)candidates.size(); i++)
+	{
+		const Candidate& current = candidates[i];
+		unsigned int meshVertices = (unsigned int)entities[current.EntityIndex].GetMesh()->GetVertices().size();
+
+		if (i > first)
+		{
+			const Candidate& start = candidates[first];
+			bool sameGroup =
+				current.SourceMaterial == start.SourceMaterial &&
+				current.CellX == start.CellX &&
+				current.CellY == start.CellY &&
+				current.CellZ == start.CellZ;
+			if (!sameGroup || vertexCount + meshVertices > maxVertices)
+			{
+				AddBatch(entities, members, first, i - first);
+				first = i;
+				vertexCount = 0;
+			}
+		}
+
+		vertexCount += meshVertices;
+	}
+
+	if (first < (unsigned int)candidates.size())
+		AddBatch(entities, members, first, (unsigned int)candidates.size() - first);
+}
+
+// --------------------------------------------------------
+// Whether the batches need building again.  Movable entities
+// can do what they like, as long as they stay movable.
+// --------------------------------------------------------
+bool StaticBatcher::IsOutOfDate(std::vector<Entity>& entities)
+{
+	if (dirty || entities.size() != builtEntities.size())
+		return true;
+
+	for (std::vector<Entity>::size_type i = 0; i != entities.size(); i++)
+	{
+		const BuiltEntity& built = builtEntities[i];
+		Entity& entity = entities[i];
+		if (entity.IsStatic() != built.Static)
+			return true;
+
+		if (built.Static && (
+			entity.GetTransformVersion() != built.TransformVersion ||
+			entity.GetMesh() != built.SourceMesh ||
+			entity.GetMaterial() != built.SourceMaterial))
+			return true;
+	}
+	return false;
+}
+
+bool StaticBatcher::IsBatched(unsigned int entityIndex)
+{
+	return entityIndex < entityRanges.size() && entityRanges[entityIndex] >= 0;
+}
+
+void StaticBatcher::SetHidden(unsigned int entityIndex, bool hidden)
+{
+	if (!IsBatched(entityIndex))
+		return;
+
+	StaticBatchRange& range = ranges[entityRanges[entityIndex]];
+	if (range.Hidden == hidden)
+		return;
+
+	// Ranges are stored batch by batch, so find the one this belongs to
+	for (std::vector<StaticBatch>::size_type i = 0; i != batches.size(); i++)
+	{
+		StaticBatch& batch = batches[i];
+		if ((unsigned int)entityRanges[entityIndex] < batch.FirstRange + batch.RangeCount)
+		{
+			if (hidden)
+				batch.HiddenCount++;
+			else
+				batch.HiddenCount--;
+			break;
+		}
+	}
+	range.Hidden = hidden;
+}
+
+// --------------------------------------------------------
+// With nothing hidden the whole batch is one draw.  Otherwise
+// neighbouring visible entities are still drawn together,
+// since their indices follow on from each other.
+// --------------------------------------------------------
+unsigned int StaticBatcher::DrawBatch(IRenderContext* context, unsigned int batchIndex)
+{
+	const StaticBatch& batch = batches[batchIndex];
+	if (batch.HiddenCount == batch.RangeCount)
+		return 0;
+
+	unsigned int stride = sizeof(Vertex);
+	unsigned int offset = 0;
+	context->IASetVertexBuffers(0, 1, &batch.VertexBuffer, &stride, &offset);
+	context->IASetIndexBuffer(batch.IndexBuffer, DXGI_FORMAT_R32_UINT, 0);
+
+	if (batch.HiddenCount == 0)
+	{
+		context->DrawIndexed(batch.IndexCount, 0, 0);
+		return 1;
+	}
+
+	unsigned int drawCalls = 0;
+	unsigned int runStart = 0;
+	unsigned int runCount = 0;
+	for (unsigned int i = batch.FirstRange; i < batch.FirstRange + batch.RangeCount; i++)
+	{
+		const StaticBatchRange& range = ranges[i];
+		if (!range.Hidden)
+		{
+			if (runCount == 0)
+				runStart = range.StartIndex;
+			runCount += range.IndexCount;
+			continue;
+		}
+
+		if (runCount > 0)
+		{
+			context->DrawIndexed(runCount, runStart, 0);
+			drawCalls++;
+			runCount = 0;
+		}
+	}
+
+	if (runCount > 0)
+	{
+		context->DrawIndexed(runCount, runStart, 0);
+		drawCalls++;
+	}
+	return drawCalls;
+}
+
+void StaticBatcher::ReleaseBatches()
+{
+	for (std::vector<StaticBatch>::size_type i = 0; i != batches.size(); i++)
+	{
+		device->Release(batches[i].VertexBuffer);
+		device->Release(batches[i].IndexBuffer);
+	}
+	batches.clear();
+}
+
+// --------------------------------------------------------
+// Transforms the given entities' meshes into world space the
+// same way the vertex shader would, and appends them into
+// one new vertex and index buffer
+// --------------------------------------------------------
+void StaticBatcher::AddBatch(std::vector<Entity>& entities, const std::vector<unsigned int>& members, unsigned int first, unsigned int count)
+{
+	StaticBatch batch = {};
+	batch.SourceMaterial = entities[members[first]].GetMaterial();
+	batch.FirstRange = (unsigned int)ranges.size();
+	batch.RangeCount = count;
+
+	vertices.clear();
+	indices.clear();
+	XMVECTOR minCorner = XMVectorReplicate(FLT_MAX);
+	XMVECTOR maxCorner = XMVectorReplicate(-FLT_MAX);
+	for (unsigned int m = first; m < first + count; m++)
+	{
+		unsigned int entityIndex = members[m];
+		Entity& entity = entities[entityIndex];
+		const std::vector<Vertex>& meshVertices = entity.GetMesh()->GetVertices();
+		const std::vector<unsigned int>& meshIndices = entity.GetMesh()->GetIndices();
+
+		StaticBatchRange range;
+		range.EntityIndex = entityIndex;
+		range.StartIndex = (unsigned int)indices.size();
+		range.IndexCount = (unsigned int)meshIndices.size();
+		range.Hidden = false;
+		entityRanges[entityIndex] = (int)ranges.size();
+		ranges.push_back(range);
+
+		// Normals only get the upper 3x3 of the world matrix, like in VertexShader.hlsl
+		XMFLOAT4X4 worldMatrix = entity.GetWorldMatrix();
+		XMMATRIX world = XMLoadFloat4x4(&worldMatrix);
+		unsigned int baseVertex = (unsigned int)vertices.size();
+		for (std::vector<Vertex>::size_type v = 0; v != meshVertices.size(); v++)
+		{
+			Vertex vertex = meshVertices[v];
+			XMStoreFloat3(&vertex.Position, XMVector3TransformCoord(XMLoadFloat3(&vertex.Position), world));
+			XMStoreFloat3(&vertex.Normal, XMVector3TransformNormal(XMLoadFloat3(&vertex.Normal), world));
+			vertices.push_back(vertex);
+		}
+		for (std::vector<unsigned int>::size_type i = 0; i != meshIndices.size(); i++)
+			indices.push_back(baseVertex + meshIndices[i]);
+
+		XMFLOAT3 center = entity.GetBoundsCenter();
+		XMVECTOR radius = XMVectorReplicate(entity.GetBoundsRadius());
+		minCorner = XMVectorMin(minCorner, XMLoadFloat3(&center) - radius);
+		maxCorner = XMVectorMax(maxCorner, XMLoadFloat3(&center) + radius);
+	}
+
+	// A sphere around every entity's sphere
+	XMVECTOR center = (minCorner + maxCorner) * 0.5f;
+	float radius = 0;
+	for (unsigned int m = first; m < first + count; m++)
+	{
+		Entity& entity = entities[members[m]];
+		XMFLOAT3 entityCenter = entity.GetBoundsCenter();
+		float distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&entityCenter) - center));
+		if (distance + entity.GetBoundsRadius() > radius)
+			radius = distance + entity.GetBoundsRadius();
+	}
+	XMStoreFloat3(&batch.BoundsCenter, center);
+	batch.BoundsRadius = radius;
+
+	// The batch never changes once it's built
+	BufferDesc vbd = {};
+	vbd.Usage = BUFFER_USAGE_IMMUTABLE;
+	vbd.ByteWidth = sizeof(Vertex) * (unsigned int)vertices.size();
+	vbd.BindFlags = BUFFER_BIND_VERTEX;
+	batch.VertexBuffer = device->CreateBuffer(vbd, &vertices[0]);
+
+	BufferDesc ibd = {};
+	ibd.Usage = BUFFER_USAGE_IMMUTABLE;
+	ibd.ByteWidth = sizeof(unsigned int) * (unsigned int)indices.size();
+	ibd.BindFlags = BUFFER_BIND_INDEX;
+	batch.IndexBuffer = device->CreateBuffer(ibd, &indices[0]);
+	batch.IndexCount = (unsigned int)indices.size();
+
+	batchedVertices += (unsigned int)vertices.size();
+	batches.push_back(batch);
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "Entity.h"
+#include "RenderDevice.h"
+
+// --------------------------------------------------------
+// The indices one source entity ended up as inside a
+// static batch's index buffer
+// --------------------------------------------------------
+struct StaticBatchRange
+{
+	unsigned int EntityIndex;
+	unsigned int StartIndex;
+	unsigned int IndexCount;
+	bool Hidden;
+};
+
+// --------------------------------------------------------
+// Merged, pre-transformed geometry for static entities that
+// share a material and sit in the same cell of the world
+// --------------------------------------------------------
+struct StaticBatch
+{
+	Material* SourceMaterial;
+	ID3D11Buffer* VertexBuffer;
+	ID3D11Buffer* IndexBuffer;
+	unsigned int IndexCount;
+	unsigned int FirstRange;	// This batch's entities in the range list
+	unsigned int RangeCount;
+	unsigned int HiddenCount;	// How many of those are hidden
+	DirectX::XMFLOAT3 BoundsCenter;	// World space sphere around every entity in the batch
+	float BoundsRadius;
+};
+
+// --------------------------------------------------------
+// Merges static, opaque entities into a few big vertex and
+// index buffers, already in world space, so each batch is
+// one draw with an identity world matrix.
+//
+// Entities are grouped by material and then by the grid cell
+// their bounds center falls in, and a batch never grows past
+// a vertex limit, so batches stay small enough to cull well.
+// Each entity's index range is kept, so single entities can
+// still be hidden without rebuilding anything.
+//
+// Batches are only built when asked to.  IsOutOfDate()
+// notices entities being added or removed, made static or
+// not, moved, or given another mesh or material, by keeping
+// what each one was like at the last build.  Anything else
+// that changes a batch (a material becoming transparent, say)
+// needs MarkDirty().
+// --------------------------------------------------------
+class StaticBatcher
+{
+public:
+	StaticBatcher(IRenderDevice* device); // Constructor
+	~StaticBatcher(); // Destructor
+
+	// SET methods for how batches are split up
+	void SetCellSize(float cellSize);
+	void SetMaxVerticesPerBatch(unsigned int maxVertices);
+
+	// Throws away the old batches and merges every static,
+	// opaque entity again
+	void Build(std::vector<Entity>& entities);
+
+	// Rebuild tracking.  IsOutOfDate() looks at every entity, so it's
+	// meant to be called once per frame, before any drawing.
+	void MarkDirty() { dirty = true; }
+	bool IsDirty() { return dirty; }
+	bool IsOutOfDate(std::vector<Entity>& entities);
+
+	// Whether an entity is drawn by a batch (and shouldn't be drawn on its own)
+	bool IsBatched(unsigned int entityIndex);
+
+	// Hides or shows one entity inside its batch
+	void SetHidden(unsigned int entityIndex, bool hidden);
+
+	// Binds a batch's buffers and draws every entity in it that isn't
+	// hidden.  The material has to be set up first.  Returns the number
+	// of draw calls it took.
+	unsigned int DrawBatch(IRenderContext* context, unsigned int batchIndex);
+
+	// GET methods
+	const std::vector<StaticBatch>& GetBatches() { return batches; }
+	unsigned int GetBatchedEntityCount() { return (unsigned int)ranges.size(); }
+	unsigned int GetBatchedVertexCount() { return batchedVertices; }
+	unsigned int GetBuildCount() { return buildCount; }
+
+private:
+	// Helper methods
+	void ReleaseBatches();
+	void AddBatch(std::vector<Entity>& entities, const std::vector<unsigned int>& members, unsigned int first, unsigned int count);
+
+	IRenderDevice* device;
+	std::vector<StaticBatch> batches;
+	std::vector<StaticBatchRange> ranges;
+
+	// Index into ranges for every entity, or -1 if it isn't batched
+	std::vector<int> entityRanges;
+
+	// What each entity was like when the batches were built
+	struct BuiltEntity
+	{
+		bool Static;
+		unsigned int TransformVersion;
+		Mesh* SourceMesh;
+		Material* SourceMaterial;
+	};
+	std::vector<BuiltEntity> builtEntities;
+
+	float cellSize;
+	unsigned int maxVertices;
+	unsigned int batchedVertices;
+	unsigned int buildCount;
+	bool dirty;
+
+	// Reused while building
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+};
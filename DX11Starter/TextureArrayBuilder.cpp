@@ -0,0 +1,72 @@
+#include "TextureArrayBuilder.h"
+
+TextureArrayBuilder::TextureArrayBuilder(IRenderDevice* device)
+{
+	this->device = device;
+}
+
+TextureArrayBuilder::~TextureArrayBuilder()
+{
+	ReleaseArrays();
+}
+
+unsigned int TextureArrayBuilder::Add(ID3D11ShaderResourceView* texture)
+{
+	textures.push_back(texture);
+	return (unsigned int)textures.size() - 1;
+}
+
+bool TextureArrayBuilder::Build(unsigned int maxSlices)
+{
+	ReleaseArrays();
+
+	// Plan from the shapes the device says the textures have
+	std::vector<TextureDesc> descs(textures.size());
+	for (std::vector<ID3D11ShaderResourceView*>::size_type i = 0; i != textures.size(); i++)
+	{
+		if (!device->GetTextureDesc(textures[i], descs[i]))
+			return false;
+	}
+	if (!planner.Plan(descs.empty() ? 0 : &descs[0], (unsigned int)descs.size(), maxSlices))
+		return false;
+
+	// Then copy each group's textures into its array, in slice order
+	const std::vector<TextureArrayGroup>& groups = planner.GetArrays();
+	std::vector<ID3D11ShaderResourceView*> slices;
+	for (std::vector<TextureArrayGroup>::size_type i = 0; i != groups.size(); i++)
+	{
+		slices.clear();
+		for (std::vector<unsigned int>::size_type j = 0; j != groups[i].Sources.size(); j++)
+			slices.push_back(textures[groups[i].Sources[j]]);
+
+		ID3D11ShaderResourceView* array = device->CreateTexture2DArray(&slices[0], (unsigned int)slices.size());
+		if (!array)
+		{
+			ReleaseArrays();
+			return false;
+		}
+		arrays.push_back(array);
+	}
+	return true;
+}
+
+ID3D11ShaderResourceView* TextureArrayBuilder::GetArray(unsigned int texture)
+{
+	if (texture >= planner.GetTextureCount() || arrays.empty())
+		return 0;
+	return arrays[planner.GetSlot(texture).Array];
+}
+
+unsigned int TextureArrayBuilder::GetSlice(unsigned int texture)
+{
+	if (texture >= planner.GetTextureCount() || arrays.empty())
+		return 0;
+	return planner.GetSlot(texture).Slice;
+}
+
+void TextureArrayBuilder::ReleaseArrays()
+{
+	for (std::vector<ID3D11ShaderResourceView*>::size_type i = 0; i != arrays.size(); i++)
+		device->Release(arrays[i]);
+	arrays.clear();
+}
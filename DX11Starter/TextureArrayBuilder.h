@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+#include "RenderDevice.h"
+#include "TextureArrayPlanner.h"
+
+// --------------------------------------------------------
+// Packs textures into texture arrays the way a planner lays
+// them out.  Textures are added, then all built in one go,
+// after which each is found by the index Add() gave it.
+//
+// The arrays belong to the builder.  The textures added are
+// still the caller's, and can be released once it's built.
+// --------------------------------------------------------
+class TextureArrayBuilder
+{
+public:
+	TextureArrayBuilder(IRenderDevice* device); // Constructor
+	~TextureArrayBuilder(); // Destructor
+
+	// Queues a texture for the next build, returning its index
+	unsigned int Add(ID3D11ShaderResourceView* texture);
+
+	// Plans and makes the arrays, replacing any built before.  False
+	// (with no arrays) if a texture wasn't made by the device or an
+	// array couldn't be made.
+	bool Build(unsigned int maxSlices = TextureArrayPlanner::MaxSlices);
+
+	// Where an added texture ended up, once built
+	ID3D11ShaderResourceView* GetArray(unsigned int texture);
+	unsigned int GetSlice(unsigned int texture);
+
+	// GET methods
+	size_t GetArrayCount() { return arrays.size(); }
+	const TextureArrayPlanner& GetPlan() { return planner; }
+
+private:
+	void ReleaseArrays();
+
+	IRenderDevice* device;
+	TextureArrayPlanner planner;
+	std::vector<ID3D11ShaderResourceView*> textures;
+	std::vector<ID3D11ShaderResourceView*> arrays;
+};
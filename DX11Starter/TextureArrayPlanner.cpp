@@ -0,0 +1,54 @@
+#include "TextureArrayPlanner.h"
+
+TextureArrayPlanner::TextureArrayPlanner()
+{
+}
+
+bool TextureArrayPlanner::Plan(const TextureDesc* textures, unsigned int textureCount, unsigned int maxSlices)
+{
+	arrays.clear();
+	slots.clear();
+	if (maxSlices == 0)
+		return false;
+
+	// Each texture goes in the last array planned for its shape, or
+	// starts a new one if there isn't one or it's full.  A plan only
+	// ever has a handful of shapes, so they're searched in order.
+	std::vector<unsigned int> openArrays;
+	slots.resize(textureCount);
+	for (unsigned int i = 0; i < textureCount; i++)
+	{
+		const TextureDesc& texture = textures[i];
+		if (texture.Width == 0 || texture.Height == 0)
+		{
+			arrays.clear();
+			slots.clear();
+			return false;
+		}
+
+		unsigned int shape = 0;
+		while (shape < openArrays.size() && !SameShape(arrays[openArrays[shape]].Shape, texture))
+			shape++;
+
+		if (shape == openArrays.size())
+			openArrays.push_back((unsigned int)arrays.size());
+		if (openArrays[shape] == arrays.size() || arrays[openArrays[shape]].Sources.size() == maxSlices)
+		{
+			openArrays[shape] = (unsigned int)arrays.size();
+			TextureArrayGroup group;
+			group.Shape = texture;
+			arrays.push_back(group);
+		}
+
+		TextureArrayGroup& group = arrays[openArrays[shape]];
+		slots[i].Array = openArrays[shape];
+		slots[i].Slice = (unsigned int)group.Sources.size();
+		group.Sources.push_back(i);
+	}
+	return true;
+}
+
+bool TextureArrayPlanner::SameShape(const TextureDesc& a, const TextureDesc& b)
+{
+	return a.Width == b.Width && a.Height == b.Height && a.MipLevels == b.MipLevels && a.Format == b.Format;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+#include "RenderDevice.h"
+
+// --------------------------------------------------------
+// One texture array in a plan: the shape every slice has,
+// and which of the planned textures go in it, in slice order
+// --------------------------------------------------------
+struct TextureArrayGroup
+{
+	TextureDesc Shape;
+	std::vector<unsigned int> Sources;
+};
+
+// Where one planned texture ended up
+struct TextureArraySlot
+{
+	unsigned int Array;
+	unsigned int Slice;
+};
+
+// --------------------------------------------------------
+// Works out how to pack textures into texture arrays, so
+// draws using different textures of the same shape can share
+// one binding and pick their texture with a slice index.
+//
+// Textures with the same width, height, mip count and format
+// go in the same array, in the order they were given.  Arrays
+// come out in the order their first texture was given, and any
+// that would have too many slices are split.  Only looks at
+// descriptions, so it's free of any device.
+// --------------------------------------------------------
+class TextureArrayPlanner
+{
+public:
+	// The most slices a Direct3D 11 texture array can have
+	static const unsigned int MaxSlices = 2048;
+
+	TextureArrayPlanner(); // Constructor
+
+	// Plans arrays for the given textures, replacing any earlier plan.
+	// False (with an empty plan) if maxSlices is 0 or any texture has
+	// no size.
+	bool Plan(const TextureDesc* textures, unsigned int textureCount, unsigned int maxSlices = MaxSlices);
+
+	// GET methods
+	const std::vector<TextureArrayGroup>& GetArrays() const { return arrays; }
+	const TextureArraySlot& GetSlot(unsigned int texture) const { return slots[texture]; }
+	unsigned int GetTextureCount() const { return (unsigned int)slots.size(); }
+
+	// Whether two textures can share an array
+	static bool SameShape(const TextureDesc& a, const TextureDesc& b);
+
+private:
+	std::vector<TextureArrayGroup> arrays;
+	std::vector<TextureArraySlot> slots;
+};
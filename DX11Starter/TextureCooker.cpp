@@ -0,0 +1,462 @@
+#include "TextureCooker.h"
+#include "DdsFile.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <sstream>
+
+int PackedTextureInfo::FindChannel(const std::string& semantic) const
+{
+	for (size_t i = 0; i < Channels.size(); i++)
+	{
+		if (Channels[i].Semantic == semantic)
+			return (int)Channels[i].Channel;
+	}
+	return -1;
+}
+
+// Red to alpha as 0 to 3, or -1 for anything else
+static int ChannelIndex(const std::string& name)
+{
+	static const char names[] = "rgba";
+	if (name.size() != 1)
+		return -1;
+	for (int i = 0; i < 4; i++)
+	{
+		if (name[0] == names[i])
+			return i;
+	}
+	return -1;
+}
+
+// Relative paths in a manifest are relative to its directory
+static std::string ResolvePath(const std::string& directory, const std::string& path)
+{
+	bool absolute = (!path.empty() && (path[0] == '/' || path[0] == '\\')) || (path.size() > 1 && path[1] == ':');
+	if (absolute || directory.empty())
+		return path;
+	return directory + "/" + path;
+}
+
+// --------------------------------------------------------
+// Finishes the texture being read: it needs at least one
+// channel, and gets as many as its last one needs (with no
+// 3 channel formats, 3 becomes 4 with alpha at full).  Only
+// 8 bit textures with color channels can be sRGB.
+// --------------------------------------------------------
+static bool FinishTexture(PackedTextureDesc& texture, unsigned int channelsUsed)
+{
+	if (channelsUsed == 0)
+		return false;
+
+	texture.ChannelCount = channelsUsed & 8 ? 4 : channelsUsed & 4 ? 3 : channelsUsed & 2 ? 2 : 1;
+	if (texture.ChannelCount == 3)
+	{
+		texture.ChannelCount = 4;
+		texture.Channels[3].Constant = 1.0f;
+	}
+	return !texture.SRGB || DdsFile::GetFormat(texture.ChannelCount, texture.BitDepth, true) != 0;
+}
+
+bool TextureCooker::ParseManifest(const std::string& text, const std::string& directory, std::vector<PackedTextureDesc>& textures, unsigned int& errorLine)
+{
+	std::vector<PackedTextureDesc> result;
+	unsigned int channelsUsed = 0;
+	unsigned int textureLine = 0;
+
+	std::istringstream lines(text);
+	std::string line;
+	for (errorLine = 1; std::getline(lines, line); errorLine++)
+	{
+		// Comments run to the end of the line
+		size_t comment = line.find('#');
+		if (comment != std::string::npos)
+			line.erase(comment);
+
+		std::istringstream words(line);
+		std::vector<std::string> tokens;
+		std::string token;
+		while (words >> token)
+			tokens.push_back(token);
+		if (tokens.empty())
+			continue;
+
+		if (tokens[0] == "texture")
+		{
+			if (tokens.size() != 2)
+				return false;
+			if (!result.empty() && !FinishTexture(result.back(), channelsUsed))
+			{
+				errorLine = textureLine;
+				return false;
+			}
+
+			PackedTextureDesc texture = {};
+			texture.Output = ResolvePath(directory, tokens[1]);
+			texture.BitDepth = 8;
+			texture.GenerateMips = true;
+			texture.Filter = MIP_FILTER_BOX;
+			result.push_back(texture);
+			channelsUsed = 0;
+			textureLine = errorLine;
+			continue;
+		}
+
+		// Everything else belongs to a texture
+		if (result.empty())
+			return false;
+		PackedTextureDesc& texture = result.back();
+
+		if (tokens[0] == "bits")
+		{
+			if (tokens.size() != 2 || (tokens[1] != "8" && tokens[1] != "16"))
+				return false;
+			texture.BitDepth = tokens[1] == "8" ? 8 : 16;
+			continue;
+		}
+
+		if (tokens[0] == "mips")
+		{
+			if (tokens.size() != 2)
+				return false;
+			texture.GenerateMips = tokens[1] != "none";
+			if (texture.GenerateMips && !MipGenerator::ParseFilter(tokens[1], texture.Filter))
+				return false;
+			continue;
+		}
+
+		if (tokens[0] == "srgb")
+		{
+			if (tokens.size() != 1)
+				return false;
+			texture.SRGB = true;
+			continue;
+		}
+
+		// A channel, packed at most once, with a semantic used once
+		int channel = ChannelIndex(tokens[0]);
+		if (channel < 0 || tokens.size() < 3 || (channelsUsed & (1u << channel)))
+			return false;
+		PackedChannelDesc& desc = texture.Channels[channel];
+		desc.Semantic = tokens[1] == "-" ? "" : tokens[1];
+		for (int c = 0; c < 4 && !desc.Semantic.empty(); c++)
+		{
+			if (c != channel && texture.Channels[c].Semantic == desc.Semantic)
+				return false;
+		}
+
+		if (tokens[2] == "constant")
+		{
+			char* end = 0;
+			desc.Constant = tokens.size() == 4 ? strtof(tokens[3].c_str(), &end) : -1.0f;
+			if (!end || *end != 0 || !(desc.Constant >= 0.0f && desc.Constant <= 1.0f))
+				return false;
+		}
+		else
+		{
+			desc.Source = ResolvePath(directory, tokens[2]);
+			for (size_t i = 3; i < tokens.size(); i++)
+			{
+				if (tokens[i] == "invert")
+					desc.Invert = true;
+				else if (ChannelIndex(tokens[i]) >= 0)
+					desc.SourceChannel = (unsigned int)ChannelIndex(tokens[i]);
+				else
+					return false;
+			}
+		}
+		channelsUsed |= 1u << channel;
+	}
+
+	if (result.empty())
+	{
+		errorLine = 0;
+		return false;
+	}
+	if (!FinishTexture(result.back(), channelsUsed))
+	{
+		errorLine = textureLine;
+		return false;
+	}
+
+	errorLine = 0;
+	textures.swap(result);
+	return true;
+}
+
+bool TextureCooker::LoadManifest(const std::string& path, std::vector<PackedTextureDesc>& textures, unsigned int& errorLine)
+{
+	errorLine = 0;
+	std::ifstream file(path.c_str(), std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	size_t slash = path.find_last_of("/\\");
+	std::string directory = slash == std::string::npos ? "" : path.substr(0, slash);
+	return ParseManifest(text, directory, textures, errorLine);
+}
+
+bool TextureCooker::Pack(const PackedTextureDesc& desc, const TextureImage* const* sources, TextureImage& packed, PackedTextureInfo& info)
+{
+	if ((desc.BitDepth != 8 && desc.BitDepth != 16) || desc.ChannelCount == 0 || desc.ChannelCount > 4)
+		return false;
+
+	// Sources all have to line up texel for texel
+	const TextureImage* first = 0;
+	for (unsigned int c = 0; c < desc.ChannelCount; c++)
+	{
+		if (desc.Channels[c].Source.empty())
+			continue;
+
+		const TextureImage* source = sources[c];
+		if (!source || desc.Channels[c].SourceChannel >= source->Channels ||
+			source->Values.size() != (size_t)source->Width * source->Height * source->Channels)
+			return false;
+		if (!first)
+			first = source;
+		else if (source->Width != first->Width || source->Height != first->Height)
+			return false;
+	}
+	if (!first)
+		return false;
+
+	packed.Width = first->Width;
+	packed.Height = first->Height;
+	packed.Channels = desc.ChannelCount;
+	packed.BitDepth = desc.BitDepth;
+	packed.Values.resize((size_t)packed.Width * packed.Height * packed.Channels);
+
+	size_t texelCount = (size_t)packed.Width * packed.Height;
+	unsigned int maxValue = packed.MaxValue();
+	for (unsigned int c = 0; c < desc.ChannelCount; c++)
+	{
+		const PackedChannelDesc& channel = desc.Channels[c];
+		const TextureImage* source = sources[c];
+		if (channel.Source.empty())
+		{
+			unsigned short value = (unsigned short)(channel.Constant * maxValue + 0.5f);
+			for (size_t i = 0; i < texelCount; i++)
+				packed.Values[i * packed.Channels + c] = value;
+			continue;
+		}
+
+		// Changing depth keeps 0 at 0 and full at full, rounding to nearest
+		for (size_t i = 0; i < texelCount; i++)
+		{
+			unsigned int value = source->Values[i * source->Channels + channel.SourceChannel];
+			if (source->BitDepth == 8 && packed.BitDepth == 16)
+				value *= 257;
+			else if (source->BitDepth == 16 && packed.BitDepth == 8)
+				value = (value * 255 + 32767) / 65535;
+			if (channel.Invert)
+				value = maxValue - value;
+			packed.Values[i * packed.Channels + c] = (unsigned short)value;
+		}
+	}
+
+	info.DataHash = HashImage(packed);
+	info.Width = packed.Width;
+	info.Height = packed.Height;
+	info.BitDepth = packed.BitDepth;
+	info.ChannelCount = packed.Channels;
+	info.Format = DdsFile::GetFormat(packed.Channels, packed.BitDepth, desc.SRGB);
+	info.MipLevels = desc.GenerateMips ? MipGenerator::GetMipCount(packed.Width, packed.Height) : 1;
+	info.Channels.clear();
+	for (unsigned int c = 0; c < desc.ChannelCount; c++)
+	{
+		if (desc.Channels[c].Semantic.empty())
+			continue;
+		PackedTextureChannel channel;
+		channel.Semantic = desc.Channels[c].Semantic;
+		channel.Channel = c;
+		info.Channels.push_back(channel);
+	}
+	return true;
+}
+
+bool TextureCooker::Cook(const PackedTextureDesc& desc, TextureImage& packed, PackedTextureInfo& info)
+{
+	// Maps often come from the same file, so each is only read once
+	std::map<std::string, TextureImage> images;
+	const TextureImage* sources[4] = {};
+	for (unsigned int c = 0; c < desc.ChannelCount && c < 4; c++)
+	{
+		const std::string& path = desc.Channels[c].Source;
+		if (path.empty())
+			continue;
+
+		std::map<std::string, TextureImage>::iterator it = images.find(path);
+		if (it == images.end())
+		{
+			TextureImage image = {};
+			if (!TiffReader::Load(path, image))
+				return false;
+			it = images.insert(std::make_pair(path, image)).first;
+		}
+		sources[c] = &it->second;
+	}
+
+	return Pack(desc, sources, packed, info);
+}
+
+bool TextureCooker::CookMips(const PackedTextureDesc& desc, const MipChainDesc& mipChain, std::vector<TextureImage>& mips, PackedTextureInfo& info)
+{
+	TextureImage packed = {};
+	if (!Cook(desc, packed, info))
+		return false;
+
+	if (desc.GenerateMips)
+		return MipGenerator::Generate(packed, mipChain, mips);
+
+	mips.resize(1);
+	mips[0] = std::move(packed);
+	return true;
+}
+
+MipChainDesc TextureCooker::GetMipChainDesc(const PackedTextureDesc& desc)
+{
+	MipChainDesc mipChain = {};
+	mipChain.Filter = desc.Filter;
+	mipChain.SRGB = desc.SRGB;
+	mipChain.ThreadCount = 0;
+	mipChain.InstructionSet = MipGenerator::GetSupportedInstructionSet();
+	return mipChain;
+}
+
+bool TextureCooker::SaveCooked(const PackedTextureDesc& desc, const std::vector<TextureImage>& mips, const PackedTextureInfo& info)
+{
+	return
+		DdsFile::Save(desc.Output, mips, desc.SRGB) &&
+		SaveInfo(GetInfoPath(desc.Output), info);
+}
+
+bool TextureCooker::CookToFile(const PackedTextureDesc& desc, PackedTextureInfo& info)
+{
+	std::vector<TextureImage> mips;
+	return
+		CookMips(desc, GetMipChainDesc(desc), mips, info) &&
+		SaveCooked(desc, mips, info);
+}
+
+void TextureCooker::WriteInfo(const PackedTextureInfo& info, std::vector<unsigned char>& bytes)
+{
+	bytes.clear();
+	auto put = [&](unsigned long long value, int size)
+	{
+		for (int i = 0; i < size; i++)
+			bytes.push_back((unsigned char)((value >> (i * 8)) & 0xFF));
+	};
+
+	put(Magic, 4);
+	put(Version, 4);
+	put(info.DataHash, 8);
+	put(info.Width, 4);
+	put(info.Height, 4);
+	put(info.BitDepth, 4);
+	put(info.ChannelCount, 4);
+	put(info.Format, 4);
+	put(info.MipLevels, 4);
+	put(info.Channels.size(), 4);
+	for (size_t c = 0; c < info.Channels.size(); c++)
+	{
+		put(info.Channels[c].Channel, 4);
+		size_t length = info.Channels[c].Semantic.size() < 0xFFFF ? info.Channels[c].Semantic.size() : 0xFFFF;
+		put(length, 2);
+		bytes.insert(bytes.end(), info.Channels[c].Semantic.begin(), info.Channels[c].Semantic.begin() + length);
+	}
+}
+
+bool TextureCooker::ReadInfo(const unsigned char* bytes, size_t byteCount, PackedTextureInfo& info)
+{
+	const unsigned char* next = bytes;
+	const unsigned char* end = bytes + byteCount;
+
+	// Reads a little endian number of the given size, failing at the end of the data
+	unsigned long long value = 0;
+	auto take = [&](int size) -> bool
+	{
+		if (!next || (size_t)(end - next) < (size_t)size)
+			return false;
+		value = 0;
+		for (int i = 0; i < size; i++)
+			value |= (unsigned long long)next[i] << (i * 8);
+		next += size;
+		return true;
+	};
+
+	if (!take(4) || value != Magic || !take(4) || value != Version)
+		return false;
+
+	PackedTextureInfo result;
+	if (!take(8)) return false;
+	result.DataHash = value;
+	if (!take(4)) return false;
+	result.Width = (unsigned int)value;
+	if (!take(4)) return false;
+	result.Height = (unsigned int)value;
+	if (!take(4)) return false;
+	result.BitDepth = (unsigned int)value;
+	if (!take(4)) return false;
+	result.ChannelCount = (unsigned int)value;
+	if (!take(4)) return false;
+	result.Format = (unsigned int)value;
+	if (!take(4)) return false;
+	result.MipLevels = (unsigned int)value;
+
+	// There are only ever 4 channels
+	if (!take(4) || value > 4)
+		return false;
+	result.Channels.resize((size_t)value);
+	for (size_t c = 0; c < result.Channels.size(); c++)
+	{
+		if (!take(4) || value > 3) return false;
+		result.Channels[c].Channel = (unsigned int)value;
+		if (!take(2) || (size_t)(end - next) < value) return false;
+		result.Channels[c].Semantic.assign((const char*)next, (size_t)value);
+		next += value;
+	}
+
+	// Anything left over means it isn't the file we think it is
+	if (next != end)
+		return false;
+
+	info = result;
+	return true;
+}
+
+bool TextureCooker::SaveInfo(const std::string& path, const PackedTextureInfo& info)
+{
+	std::vector<unsigned char> bytes;
+	WriteInfo(info, bytes);
+
+	std::ofstream file(path.c_str(), std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	file.write((const char*)&bytes[0], bytes.size());
+	return file.good();
+}
+
+bool TextureCooker::LoadInfo(const std::string& path, PackedTextureInfo& info)
+{
+	std::ifstream file(path.c_str(), std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	return ReadInfo(bytes.empty() ? 0 : &bytes[0], bytes.size(), info);
+}
+
+unsigned long long TextureCooker::HashImage(const TextureImage& image)
+{
+	unsigned long long hash = 14695981039346656037ull;
+	for (size_t i = 0; i < image.Values.size(); i++)
+	{
+		hash = (hash ^ (image.Values[i] & 0xFF)) * 1099511628211ull;
+		hash = (hash ^ (image.Values[i] >> 8)) * 1099511628211ull;
+	}
+	return hash;
+}
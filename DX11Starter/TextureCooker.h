@@ -0,0 +1,134 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "MipGenerator.h"
+
+// --------------------------------------------------------
+// Where one channel of a packed texture gets its values:
+// a channel of a source image, or a constant.  Channels with
+// a semantic (like "ao") are listed in the packed texture's
+// info, so materials can find them.
+// --------------------------------------------------------
+struct PackedChannelDesc
+{
+	std::string Semantic;		// Empty if nothing samples it
+	std::string Source;			// Image file, or empty for Constant
+	unsigned int SourceChannel;	// 0 to 3
+	bool Invert;				// Stored as one minus the source value
+	float Constant;				// 0 to 1
+};
+
+// One texture in a manifest
+struct PackedTextureDesc
+{
+	std::string Output;			// DDS file to write
+	unsigned int BitDepth;		// 8 or 16 bits per channel
+	unsigned int ChannelCount;	// 1, 2 or 4
+	bool GenerateMips;			// Whether the file gets a full mip chain
+	MipFilter Filter;			// What the mips are filtered with
+	bool SRGB;					// Red, green and blue are sRGB encoded
+	PackedChannelDesc Channels[4];
+};
+
+// --------------------------------------------------------
+// What a packed texture holds, saved next to it so the
+// material system can sample the right channel for each map
+// without knowing how it was packed.
+// --------------------------------------------------------
+struct PackedTextureChannel
+{
+	std::string Semantic;
+	unsigned int Channel;		// 0 to 3, red to alpha
+};
+
+struct PackedTextureInfo
+{
+	unsigned long long DataHash;	// Of the packed values, to tell when the texture has changed
+	unsigned int Width;
+	unsigned int Height;
+	unsigned int BitDepth;
+	unsigned int ChannelCount;
+	unsigned int Format;			// DXGI_FORMAT
+	unsigned int MipLevels;			// In the cooked file
+	std::vector<PackedTextureChannel> Channels;
+
+	// The channel holding a semantic, or -1 if it isn't packed
+	int FindChannel(const std::string& semantic) const;
+};
+
+// --------------------------------------------------------
+// Packs single channel maps into the channels of one texture,
+// as a manifest describes, so a material samples them all with
+// one fetch from one binding.  Reads TIFFs, and writes DDS
+// files with a ".channels" info sidecar next to each.
+//
+// A manifest is plain text, one statement per line, with
+// anything after a # ignored:
+//
+//   texture CliffLayered_packed.dds   Starts a texture
+//   bits 16                           8 (the default) or 16
+//   mips kaiser                       box (the default), kaiser, lanczos or none
+//   srgb                              Red, green and blue are sRGB colors
+//   r ao CliffLayered_ao.tif          Red from the file's first channel
+//   g gloss Rough.tif r invert        Green from red, as one minus it
+//   a - constant 1                    Alpha at full, not listed
+//
+// Paths are relative to the manifest.  Channels left out between
+// packed ones are 0, and alpha is 1 if 3 channels are packed.
+// Every source has to be the same size.  sRGB textures have to
+// be 8 bit with 3 or 4 channels, and their mips are filtered
+// in linear space.
+//
+// Only needs the standard library, so it runs as an offline
+// tool on any platform as well as inside the engine.
+// --------------------------------------------------------
+class TextureCooker
+{
+public:
+	// Reading a manifest.  False on a bad line, which errorLine
+	// says (counting from 1), or an empty manifest.
+	static bool ParseManifest(const std::string& text, const std::string& directory, std::vector<PackedTextureDesc>& textures, unsigned int& errorLine);
+	static bool LoadManifest(const std::string& path, std::vector<PackedTextureDesc>& textures, unsigned int& errorLine);
+
+	// Packs already loaded images, one for each channel of the
+	// description (null for constant channels).  False if a source
+	// is missing a channel or isn't the same size as the others.
+	static bool Pack(const PackedTextureDesc& desc, const TextureImage* const* sources, TextureImage& packed, PackedTextureInfo& info);
+
+	// Loads the sources and packs them.  Each file is only read once.
+	static bool Cook(const PackedTextureDesc& desc, TextureImage& packed, PackedTextureInfo& info);
+
+	// Cooks a texture and makes its mips, if it has any, with the given
+	// filter settings.  mips[0] is the packed texture.
+	static bool CookMips(const PackedTextureDesc& desc, const MipChainDesc& mipChain, std::vector<TextureImage>& mips, PackedTextureInfo& info);
+
+	// The mip filter settings a texture's description asks for, on every
+	// core with the best instructions this CPU has
+	static MipChainDesc GetMipChainDesc(const PackedTextureDesc& desc);
+
+	// Saves a cooked texture and its info to its output
+	static bool SaveCooked(const PackedTextureDesc& desc, const std::vector<TextureImage>& mips, const PackedTextureInfo& info);
+
+	// Cooks a texture and saves it and its info to its output
+	static bool CookToFile(const PackedTextureDesc& desc, PackedTextureInfo& info);
+
+	// The info sidecar's file name for a texture
+	static std::string GetInfoPath(const std::string& texturePath) { return texturePath + ".channels"; }
+
+	// Converting info to and from the sidecar format in memory, in the
+	// same little endian layout as the shader reflection sidecars
+	static void WriteInfo(const PackedTextureInfo& info, std::vector<unsigned char>& bytes);
+	static bool ReadInfo(const unsigned char* bytes, size_t byteCount, PackedTextureInfo& info);
+
+	// Saving and loading info sidecars.  Both return false on failure.
+	static bool SaveInfo(const std::string& path, const PackedTextureInfo& info);
+	static bool LoadInfo(const std::string& path, PackedTextureInfo& info);
+
+	// FNV-1a 64 of an image's values
+	static unsigned long long HashImage(const TextureImage& image);
+
+	// "PKTX" and the version of the sidecar layout
+	static const unsigned int Magic = 0x58544B50;
+	static const unsigned int Version = 2;
+};
@@ -0,0 +1,284 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+
+TextureStreamer::TextureStreamer(IRenderDevice* device, IRenderContext* context, UploadManager* uploads, bool backgroundThread)
+{
+	this->device = device;
+	this->context = context;
+	this->uploads = uploads;
+	maxReads = 2;
+	readsInFlight = 0;
+	stopping = false;
+	threaded = backgroundThread;
+
+	mipsStreamed = 0;
+	failedReads = 0;
+	bytesStreamed = 0;
+
+	if (threaded)
+		thread = std::thread(&TextureStreamer::StreamThread, this);
+}
+
+// --------------------------------------------------------
+// Stops the streaming thread before anything it could be
+// reading from goes away.  Reads it hadn't got to are dropped.
+// --------------------------------------------------------
+TextureStreamer::~TextureStreamer()
+{
+	if (threaded)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		thread.join();
+	}
+
+	for (std::vector<StreamedTexture>::size_type i = 0; i != textures.size(); i++)
+	{
+		delete textures[i].Source;
+		device->Release(textures[i].Texture);
+	}
+}
+
+// --------------------------------------------------------
+// The texture is made with every mip, and only the smallest
+// (which is always 1x1) is filled in before sampling is
+// clamped to it.  That's only the placeholder, so nothing
+// counts as resident yet, and the source's own 1x1 mip is
+// the first one streamed.
+// --------------------------------------------------------
+StreamedTextureID TextureStreamer::Add(ITextureStreamSource* source)
+{
+	TextureDesc desc = {};
+	std::vector<unsigned char> placeholder;
+	if (!source || !source->Open(desc, placeholder) || desc.Width == 0 || desc.Height == 0)
+	{
+		delete source;
+		return 0;
+	}
+
+	desc.MipLevels = 1;
+	unsigned int size = desc.Width > desc.Height ? desc.Width : desc.Height;
+	while (size >>= 1)
+		desc.MipLevels++;
+
+	ID3D11ShaderResourceView* texture = device->CreateTexture2D(desc, 0, 0);
+	if (!texture)
+	{
+		delete source;
+		return 0;
+	}
+
+	unsigned int smallestMip = desc.MipLevels - 1;
+	if (!placeholder.empty())
+		context->UpdateTextureRegion(texture, smallestMip, 0, 0, 1, 1, &placeholder[0], (unsigned int)placeholder.size());
+	context->SetResourceMinLOD(texture, (float)smallestMip);
+
+	StreamedTexture streamed = {};
+	streamed.Source = source;
+	streamed.Texture = texture;
+	streamed.Desc = desc;
+	streamed.State = STREAM_IDLE;
+	streamed.ResidentMip = desc.MipLevels;
+	streamed.WantedMip = smallestMip;
+	textures.push_back(streamed);
+	return (StreamedTextureID)textures.size();
+}
+
+ID3D11ShaderResourceView* TextureStreamer::GetTexture(StreamedTextureID id)
+{
+	StreamedTexture* texture = Find(id);
+	return texture ? texture->Texture : 0;
+}
+
+void TextureStreamer::ReportScreenSize(StreamedTextureID id, float pixels)
+{
+	StreamedTexture* texture = Find(id);
+	if (!texture)
+		return;
+
+	if (pixels > texture->ScreenSize)
+		texture->ScreenSize = pixels;
+
+	unsigned int wanted = GetWantedMip(texture->Desc.Width, texture->Desc.Height, texture->Desc.MipLevels, pixels);
+	if (wanted < texture->WantedMip)
+		texture->WantedMip = wanted;
+}
+
+// --------------------------------------------------------
+// Finished uploads are checked before the new ones are
+// queued, since those can't have gone up yet.  Textures that
+// need more mips are then ordered by how big they were on
+// screen last frame, and read in that order until there are
+// as many reads going as are allowed.
+// --------------------------------------------------------
+void TextureStreamer::Update()
+{
+	for (std::vector<StreamedTexture>::size_type i = 0; i != textures.size(); i++)
+	{
+		StreamedTexture& texture = textures[i];
+		if (texture.State == STREAM_UPLOADING && uploads->IsComplete(texture.Ticket))
+		{
+			texture.ResidentMip--;
+			texture.State = STREAM_IDLE;
+			context->SetResourceMinLOD(texture.Texture, (float)texture.ResidentMip);
+			mipsStreamed++;
+		}
+	}
+
+	std::vector<ReadRequest> finished;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		finished.swap(finishedReads);
+	}
+	for (std::vector<ReadRequest>::size_type i = 0; i != finished.size(); i++)
+		FinishRead(finished[i]);
+
+	std::vector<unsigned int> candidates;
+	for (std::vector<StreamedTexture>::size_type i = 0; i != textures.size(); i++)
+	{
+		StreamedTexture& texture = textures[i];
+		texture.Urgency = texture.ScreenSize;
+		texture.ScreenSize = 0;
+		if (texture.State == STREAM_IDLE && texture.ResidentMip > texture.WantedMip)
+			candidates.push_back((unsigned int)i);
+	}
+
+	// Most urgent first, then in the order they were added
+	std::stable_sort(candidates.begin(), candidates.end(),
+		[this](unsigned int a, unsigned int b) { return textures[a].Urgency > textures[b].Urgency; });
+
+	for (std::vector<unsigned int>::size_type i = 0; i != candidates.size() && readsInFlight < maxReads; i++)
+	{
+		StreamedTexture& texture = textures[candidates[i]];
+		texture.State = STREAM_READING;
+		readsInFlight++;
+
+		ReadRequest request;
+		request.Index = candidates[i];
+		request.Mip = texture.ResidentMip - 1;
+		request.Source = texture.Source;
+		request.Succeeded = false;
+		request.RowPitch = 0;
+
+		// Without a thread the read is done now, and picked up next Update()
+		// just as it would be from the thread
+		if (!threaded)
+		{
+			Read(request);
+			finishedReads.push_back(std::move(request));
+			continue;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			queuedReads.push_back(std::move(request));
+		}
+		wake.notify_one();
+	}
+}
+
+unsigned int TextureStreamer::GetWantedMip(unsigned int width, unsigned int height, unsigned int mipLevels, float pixels)
+{
+	if (mipLevels == 0)
+		return 0;
+
+	// The finest mip that's still no smaller than the screen size
+	unsigned int size = width > height ? width : height;
+	unsigned int mip = 0;
+	while (mip + 1 < mipLevels && (float)(size >> (mip + 1)) >= pixels)
+		mip++;
+	return mip;
+}
+
+unsigned int TextureStreamer::GetMipLevels(StreamedTextureID id)
+{
+	StreamedTexture* texture = Find(id);
+	return texture ? texture->Desc.MipLevels : 0;
+}
+
+unsigned int TextureStreamer::GetResidentMip(StreamedTextureID id)
+{
+	StreamedTexture* texture = Find(id);
+	return texture ? texture->ResidentMip : 0;
+}
+
+unsigned int TextureStreamer::GetWantedMip(StreamedTextureID id)
+{
+	StreamedTexture* texture = Find(id);
+	return texture ? texture->WantedMip : 0;
+}
+
+bool TextureStreamer::IsFullyStreamed(StreamedTextureID id)
+{
+	StreamedTexture* texture = Find(id);
+	return texture && texture->ResidentMip <= texture->WantedMip;
+}
+
+TextureStreamer::StreamedTexture* TextureStreamer::Find(StreamedTextureID id)
+{
+	if (id == 0 || id > textures.size())
+		return 0;
+	return &textures[id - 1];
+}
+
+void TextureStreamer::Read(ReadRequest& request)
+{
+	request.Succeeded = request.Source->ReadMip(request.Mip, request.Texels, request.RowPitch);
+}
+
+// --------------------------------------------------------
+// Hands a read mip to the upload manager.  A texture whose
+// source fails, or gives back too little data, stops
+// streaming at the mips it already has.
+// --------------------------------------------------------
+void TextureStreamer::FinishRead(ReadRequest& request)
+{
+	StreamedTexture& texture = textures[request.Index];
+	readsInFlight--;
+
+	unsigned int width = texture.Desc.Width >> request.Mip;
+	unsigned int height = texture.Desc.Height >> request.Mip;
+	if (width == 0) width = 1;
+	if (height == 0) height = 1;
+
+	if (!request.Succeeded || request.RowPitch == 0 || request.Texels.size() < (size_t)request.RowPitch * height)
+	{
+		texture.State = STREAM_FAILED;
+		failedReads++;
+		return;
+	}
+
+	texture.Ticket = uploads->UploadTexture(texture.Texture, request.Mip, width, height, &request.Texels[0], request.RowPitch,
+		texture.Urgency > 0 ? UPLOAD_PRIORITY_NORMAL : UPLOAD_PRIORITY_LOW);
+	texture.State = STREAM_UPLOADING;
+	bytesStreamed += (unsigned long long)request.RowPitch * height;
+}
+
+// --------------------------------------------------------
+// Reads queued mips one at a time until the streamer is
+// destroyed.  Sources are only read here once they've been
+// added, so they need no locking of their own.
+// --------------------------------------------------------
+void TextureStreamer::StreamThread()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		wake.wait(lock, [this] { return stopping || !queuedReads.empty(); });
+		if (stopping)
+			return;
+
+		ReadRequest request = std::move(queuedReads.front());
+		queuedReads.pop_front();
+
+		lock.unlock();
+		Read(request);
+		lock.lock();
+
+		finishedReads.push_back(std::move(request));
+	}
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "RenderDevice.h"
+#include "UploadManager.h"
+
+// Identifies a streamed texture.  0 is never handed out.
+typedef unsigned int StreamedTextureID;
+
+// --------------------------------------------------------
+// Where a streamed texture's mips come from
+// --------------------------------------------------------
+class ITextureStreamSource
+{
+public:
+	virtual ~ITextureStreamSource() { }
+
+	// Called once, when the texture is added, on the thread adding it.
+	// Should only read what it takes to know the texture's width,
+	// height and format (the mip count is ignored - every streamed
+	// texture gets a full chain), plus one texel in that format to
+	// show until the real mips arrive.
+	virtual bool Open(TextureDesc& desc, std::vector<unsigned char>& placeholder) = 0;
+
+	// One mip's texels, with rows rowPitch bytes apart.  Called on the
+	// streaming thread, smallest mip first, each mip once at most.
+	virtual bool ReadMip(unsigned int mip, std::vector<unsigned char>& texels, unsigned int& rowPitch) = 0;
+};
+
+// --------------------------------------------------------
+// Streams textures in a mip at a time, smallest first, so
+// they can be bound as soon as they're added and sharpen as
+// their finer mips arrive.
+//
+// Each texture is made with its full mip chain empty, apart
+// from the smallest mip which gets the source's placeholder,
+// and sampling is clamped to the finest mip that's been filled
+// in with the resource's min LOD.  Mips are read on a
+// background thread, sent through the upload manager (so they
+// come out of its frame budget), and the min LOD is lowered
+// once each one has gone up.
+//
+// How far a texture streams, and which textures go first, comes
+// from how big the things using it are on screen: the larger,
+// the finer the mip it needs and the sooner it gets it.  Each
+// texture only has one mip being read or uploaded at a time,
+// so mips always arrive in order.
+//
+// Only talks to the render device, context and upload manager,
+// and the background thread can be turned off to do the reads
+// in Update() instead, so it runs the same headless.
+// --------------------------------------------------------
+class TextureStreamer
+{
+public:
+	TextureStreamer(IRenderDevice* device, IRenderContext* context, UploadManager* uploads, bool backgroundThread = true); // Constructor
+	~TextureStreamer(); // Destructor
+
+	// Makes a texture to stream from the source, which the streamer then
+	// owns.  The texture can be bound straight away.  0 (and the source
+	// deleted) if the source can't be opened or the texture can't be made.
+	StreamedTextureID Add(ITextureStreamSource* source);
+
+	// Null for 0 and IDs this streamer didn't hand out
+	ID3D11ShaderResourceView* GetTexture(StreamedTextureID id);
+
+	// Call every frame for each thing drawn with a texture, with about how
+	// many pixels across it is on screen.  The largest report sets how
+	// urgent the texture is for the next Update(), and the finest mip it
+	// has ever needed is streamed to.
+	void ReportScreenSize(StreamedTextureID id, float pixels);
+
+	// Call once per frame, before the upload manager's ProcessFrame().
+	// Lowers the min LOD of textures whose next mip has finished
+	// uploading, queues the mips that have been read for upload, and
+	// starts reading more, most urgent texture first.
+	void Update();
+
+	// The finest mip worth having for a texture covering this many pixels
+	static unsigned int GetWantedMip(unsigned int width, unsigned int height, unsigned int mipLevels, float pixels);
+
+	// Most mips being read at once, across every texture
+	void SetMaxReads(unsigned int maxReads) { this->maxReads = maxReads > 0 ? maxReads : 1; }
+
+	// Per texture state, or 0 for IDs this streamer didn't hand out
+	unsigned int GetMipLevels(StreamedTextureID id);
+	unsigned int GetResidentMip(StreamedTextureID id);	// Finest mip streamed in, or the mip count if none are yet
+	unsigned int GetWantedMip(StreamedTextureID id);	// Finest mip it's streaming to
+	bool IsFullyStreamed(StreamedTextureID id);			// Whether it's got every mip it wants
+
+	// Stats
+	unsigned int GetTextureCount() { return (unsigned int)textures.size(); }
+	unsigned int GetReadsInFlight() { return readsInFlight; }
+	unsigned int GetMipsStreamed() { return mipsStreamed; }
+	unsigned int GetFailedReads() { return failedReads; }
+	unsigned long long GetBytesStreamed() { return bytesStreamed; }
+
+private:
+	enum StreamState
+	{
+		STREAM_IDLE,
+		STREAM_READING,
+		STREAM_UPLOADING,
+		STREAM_FAILED
+	};
+
+	struct StreamedTexture
+	{
+		ITextureStreamSource* Source;
+		ID3D11ShaderResourceView* Texture;
+		TextureDesc Desc;				// With the mip count it was made with
+		StreamState State;
+		unsigned int ResidentMip;		// MipLevels until the smallest mip has streamed in
+		unsigned int WantedMip;
+		float ScreenSize;				// Largest reported since the last Update()
+		float Urgency;					// What ScreenSize was at the last Update()
+		UploadTicket Ticket;			// The mip being uploaded, if there is one
+	};
+
+	// A mip for the streaming thread to read, and what came of it
+	struct ReadRequest
+	{
+		unsigned int Index;
+		unsigned int Mip;
+		ITextureStreamSource* Source;
+		bool Succeeded;
+		unsigned int RowPitch;
+		std::vector<unsigned char> Texels;
+	};
+
+	// Helper methods
+	StreamedTexture* Find(StreamedTextureID id);
+	void Read(ReadRequest& request);
+	void FinishRead(ReadRequest& request);
+	void StreamThread();
+
+	IRenderDevice* device;
+	IRenderContext* context;
+	UploadManager* uploads;
+	std::vector<StreamedTexture> textures;
+	unsigned int maxReads;
+	unsigned int readsInFlight;
+
+	// Shared with the streaming thread, under the mutex
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<ReadRequest> queuedReads;
+	std::vector<ReadRequest> finishedReads;
+	bool stopping;
+	bool threaded;
+
+	// Stats
+	unsigned int mipsStreamed;
+	unsigned int failedReads;
+	unsigned long long bytesStreamed;
+};
@@ -0,0 +1,362 @@
+#include "TiffReader.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <map>
+
+// TIFF tags read here
+enum TiffTag
+{
+	TIFF_TAG_WIDTH = 256,
+	TIFF_TAG_HEIGHT = 257,
+	TIFF_TAG_BITS_PER_SAMPLE = 258,
+	TIFF_TAG_COMPRESSION = 259,
+	TIFF_TAG_PHOTOMETRIC = 262,
+	TIFF_TAG_STRIP_OFFSETS = 273,
+	TIFF_TAG_SAMPLES_PER_PIXEL = 277,
+	TIFF_TAG_ROWS_PER_STRIP = 278,
+	TIFF_TAG_STRIP_BYTE_COUNTS = 279,
+	TIFF_TAG_PLANAR_CONFIG = 284,
+	TIFF_TAG_PREDICTOR = 317,
+	TIFF_TAG_TILE_WIDTH = 322,
+	TIFF_TAG_SAMPLE_FORMAT = 339
+};
+
+enum TiffCompression
+{
+	TIFF_COMPRESSION_NONE = 1,
+	TIFF_COMPRESSION_LZW = 5,
+	TIFF_COMPRESSION_PACKBITS = 32773
+};
+
+// --------------------------------------------------------
+// Reads numbers in the file's byte order, failing (with 0)
+// past the end of the data instead of reading off it
+// --------------------------------------------------------
+struct TiffBytes
+{
+	const unsigned char* Bytes;
+	size_t Size;
+	bool BigEndian;
+
+	bool Has(size_t offset, size_t count) const { return offset <= Size && count <= Size - offset; }
+
+	unsigned int Read16(size_t offset) const
+	{
+		if (!Has(offset, 2))
+			return 0;
+		const unsigned char* p = Bytes + offset;
+		return BigEndian ? (p[0] << 8) | p[1] : p[0] | (p[1] << 8);
+	}
+
+	unsigned int Read32(size_t offset) const
+	{
+		if (!Has(offset, 4))
+			return 0;
+		const unsigned char* p = Bytes + offset;
+		return BigEndian ?
+			((unsigned int)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3] :
+			p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+	}
+};
+
+bool TiffReader::Read(const unsigned char* bytes, size_t byteCount, TextureImage& image)
+{
+	if (!bytes || byteCount < 8)
+		return false;
+
+	TiffBytes file = { bytes, byteCount, false };
+	if (bytes[0] == 'M' && bytes[1] == 'M')
+		file.BigEndian = true;
+	else if (bytes[0] != 'I' || bytes[1] != 'I')
+		return false;
+	if (file.Read16(2) != 42)
+		return false;
+
+	// Only the first image is read.  Every unsigned integer tag is kept,
+	// the rest (like resolutions) aren't needed.
+	size_t directory = file.Read32(4);
+	unsigned int entryCount = file.Read16(directory);
+	if (!file.Has(directory + 2, (size_t)entryCount * 12))
+		return false;
+
+	std::map<unsigned int, std::vector<unsigned int>> tags;
+	for (unsigned int e = 0; e < entryCount; e++)
+	{
+		size_t entry = directory + 2 + (size_t)e * 12;
+		unsigned int tag = file.Read16(entry);
+		unsigned int type = file.Read16(entry + 2);
+		unsigned int count = file.Read32(entry + 4);
+
+		// BYTE, SHORT and LONG
+		unsigned int size = type == 1 ? 1 : type == 3 ? 2 : type == 4 ? 4 : 0;
+		if (size == 0 || count == 0)
+			continue;
+
+		// Values that fit in 4 bytes are stored in the entry itself
+		size_t offset = (size_t)count * size <= 4 ? entry + 8 : file.Read32(entry + 8);
+		if (!file.Has(offset, (size_t)count * size))
+			return false;
+
+		std::vector<unsigned int>& values = tags[tag];
+		values.resize(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			size_t at = offset + (size_t)i * size;
+			values[i] = size == 1 ? bytes[at] : size == 2 ? file.Read16(at) : file.Read32(at);
+		}
+	}
+
+	// The first value of a tag, or a fallback if it isn't there
+	auto tagValue = [&](unsigned int tag, unsigned int fallback) -> unsigned int
+	{
+		std::map<unsigned int, std::vector<unsigned int>>::const_iterator it = tags.find(tag);
+		return it != tags.end() ? it->second[0] : fallback;
+	};
+
+	unsigned int width = tagValue(TIFF_TAG_WIDTH, 0);
+	unsigned int height = tagValue(TIFF_TAG_HEIGHT, 0);
+	unsigned int channels = tagValue(TIFF_TAG_SAMPLES_PER_PIXEL, 1);
+	unsigned int bits = tagValue(TIFF_TAG_BITS_PER_SAMPLE, 1);
+	unsigned int compression = tagValue(TIFF_TAG_COMPRESSION, TIFF_COMPRESSION_NONE);
+	unsigned int photometric = tagValue(TIFF_TAG_PHOTOMETRIC, 1);
+	unsigned int rowsPerStrip = tagValue(TIFF_TAG_ROWS_PER_STRIP, height);
+	unsigned int predictor = tagValue(TIFF_TAG_PREDICTOR, 1);
+	// Nothing bigger than a Direct3D 11 texture can be
+	if (width == 0 || height == 0 || width > 16384 || height > 16384 || channels == 0 || channels > 4)
+		return false;
+	if ((bits != 8 && bits != 16) || photometric > 2 || (predictor != 1 && predictor != 2))
+		return false;
+	if (compression != TIFF_COMPRESSION_NONE && compression != TIFF_COMPRESSION_LZW && compression != TIFF_COMPRESSION_PACKBITS)
+		return false;
+	if (tags.count(TIFF_TAG_TILE_WIDTH) || (channels > 1 && tagValue(TIFF_TAG_PLANAR_CONFIG, 1) != 1))
+		return false;
+
+	// Every channel has to be the same depth, and an unsigned integer
+	if (tags.count(TIFF_TAG_BITS_PER_SAMPLE))
+	{
+		const std::vector<unsigned int>& depths = tags[TIFF_TAG_BITS_PER_SAMPLE];
+		for (size_t i = 0; i < depths.size(); i++)
+		{
+			if (depths[i] != bits)
+				return false;
+		}
+	}
+	if (tags.count(TIFF_TAG_SAMPLE_FORMAT))
+	{
+		const std::vector<unsigned int>& formats = tags[TIFF_TAG_SAMPLE_FORMAT];
+		for (size_t i = 0; i < formats.size(); i++)
+		{
+			if (formats[i] != 1)
+				return false;
+		}
+	}
+
+	// Every strip but the last holds rowsPerStrip rows
+	if (rowsPerStrip == 0 || rowsPerStrip > height)
+		rowsPerStrip = height;
+	unsigned int stripCount = (height + rowsPerStrip - 1) / rowsPerStrip;
+	if (!tags.count(TIFF_TAG_STRIP_OFFSETS) || !tags.count(TIFF_TAG_STRIP_BYTE_COUNTS))
+		return false;
+	const std::vector<unsigned int>& stripOffsets = tags[TIFF_TAG_STRIP_OFFSETS];
+	const std::vector<unsigned int>& stripByteCounts = tags[TIFF_TAG_STRIP_BYTE_COUNTS];
+	if (stripOffsets.size() < stripCount || stripByteCounts.size() < stripCount)
+		return false;
+
+	size_t bytesPerValue = bits / 8;
+	size_t rowSize = (size_t)width * channels * bytesPerValue;
+	std::vector<unsigned char> raw(rowSize * height);
+	for (unsigned int s = 0; s < stripCount; s++)
+	{
+		unsigned int rows = height - s * rowsPerStrip < rowsPerStrip ? height - s * rowsPerStrip : rowsPerStrip;
+		size_t stripSize = rowSize * rows;
+		unsigned char* output = &raw[rowSize * s * rowsPerStrip];
+		if (!file.Has(stripOffsets[s], stripByteCounts[s]))
+			return false;
+		const unsigned char* input = bytes + stripOffsets[s];
+
+		bool decoded = false;
+		switch (compression)
+		{
+		case TIFF_COMPRESSION_NONE:
+			decoded = stripByteCounts[s] >= stripSize;
+			if (decoded)
+				std::copy(input, input + stripSize, output);
+			break;
+		case TIFF_COMPRESSION_LZW:
+			decoded = DecodeLZW(input, stripByteCounts[s], output, stripSize);
+			break;
+		case TIFF_COMPRESSION_PACKBITS:
+			decoded = DecodePackBits(input, stripByteCounts[s], output, stripSize);
+			break;
+		}
+		if (!decoded)
+			return false;
+	}
+
+	image.Width = width;
+	image.Height = height;
+	image.Channels = channels;
+	image.BitDepth = bits;
+	image.Values.resize((size_t)width * height * channels);
+	for (size_t i = 0; i < image.Values.size(); i++)
+	{
+		const unsigned char* p = &raw[i * bytesPerValue];
+		if (bits == 8)
+			image.Values[i] = p[0];
+		else
+			image.Values[i] = (unsigned short)(file.BigEndian ? (p[0] << 8) | p[1] : p[0] | (p[1] << 8));
+	}
+
+	// The horizontal predictor stores each value as the difference from
+	// the same channel of the texel to its left
+	if (predictor == 2)
+	{
+		unsigned short mask = image.MaxValue();
+		size_t rowValues = (size_t)width * channels;
+		for (unsigned int y = 0; y < height; y++)
+		{
+			unsigned short* row = &image.Values[rowValues * y];
+			for (size_t i = channels; i < rowValues; i++)
+				row[i] = (unsigned short)((row[i] + row[i - channels]) & mask);
+		}
+	}
+
+	// White is zero
+	if (photometric == 0)
+	{
+		for (size_t i = 0; i < image.Values.size(); i++)
+			image.Values[i] = (unsigned short)(image.MaxValue() - image.Values[i]);
+	}
+	return true;
+}
+
+bool TiffReader::Load(const std::string& path, TextureImage& image)
+{
+	std::ifstream file(path.c_str(), std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	return Read(bytes.empty() ? 0 : &bytes[0], bytes.size(), image);
+}
+
+// --------------------------------------------------------
+// TIFF's LZW: codes are read most significant bit first,
+// starting at 9 bits and growing one code earlier than plain
+// LZW would, up to 12 bits.  256 clears the table and 257
+// ends the strip.
+// --------------------------------------------------------
+bool TiffReader::DecodeLZW(const unsigned char* input, size_t inputSize, unsigned char* output, size_t outputSize)
+{
+	const unsigned int clearCode = 256;
+	const unsigned int endCode = 257;
+	const unsigned int maxCodes = 4096;
+
+	// Each code is the code before it plus one byte, so a string is
+	// written back to front by following its prefixes
+	std::vector<unsigned short> prefix(maxCodes);
+	std::vector<unsigned char> suffix(maxCodes);
+	std::vector<unsigned short> length(maxCodes);
+	for (unsigned int i = 0; i < 256; i++)
+	{
+		suffix[i] = (unsigned char)i;
+		length[i] = 1;
+	}
+
+	unsigned int codeWidth = 9;
+	unsigned int nextCode = 258;
+	unsigned int previous = maxCodes;
+	size_t written = 0;
+	size_t bitPosition = 0;
+	while (bitPosition + codeWidth <= inputSize * 8)
+	{
+		unsigned int code = 0;
+		for (unsigned int b = 0; b < codeWidth; b++, bitPosition++)
+			code = (code << 1) | ((input[bitPosition >> 3] >> (7 - (bitPosition & 7))) & 1);
+
+		if (code == endCode)
+			break;
+		if (code == clearCode)
+		{
+			codeWidth = 9;
+			nextCode = 258;
+			previous = maxCodes;
+			continue;
+		}
+
+		// A code that isn't in the table yet can only be the one about
+		// to be added: the previous string plus its own first byte
+		unsigned int emitted = code;
+		if (previous == maxCodes)
+		{
+			if (code > 255)
+				return false;
+		}
+		else if (code > nextCode || (code == nextCode && nextCode == maxCodes))
+			return false;
+		else if (code == nextCode)
+			emitted = previous;
+
+		size_t stringLength = length[emitted];
+		if (written + stringLength + (code == nextCode ? 1 : 0) > outputSize)
+			return false;
+		unsigned int walk = emitted;
+		for (size_t i = stringLength; i > 0; i--)
+		{
+			output[written + i - 1] = suffix[walk];
+			walk = prefix[walk];
+		}
+		unsigned char first = output[written];
+		written += stringLength;
+		if (code == nextCode)
+			output[written++] = first;
+
+		if (previous != maxCodes && nextCode < maxCodes)
+		{
+			prefix[nextCode] = (unsigned short)previous;
+			suffix[nextCode] = first;
+			length[nextCode] = (unsigned short)(length[previous] + 1);
+			nextCode++;
+			if (nextCode == (1u << codeWidth) - 1 && codeWidth < 12)
+				codeWidth++;
+		}
+		previous = code;
+	}
+
+	return written == outputSize;
+}
+
+// --------------------------------------------------------
+// Runs of up to 128 repeated bytes, or of up to 128 bytes
+// copied as they are, each after a signed count byte
+// --------------------------------------------------------
+bool TiffReader::DecodePackBits(const unsigned char* input, size_t inputSize, unsigned char* output, size_t outputSize)
+{
+	size_t read = 0;
+	size_t written = 0;
+	while (read < inputSize && written < outputSize)
+	{
+		int count = (signed char)input[read++];
+		if (count >= 0)
+		{
+			size_t run = (size_t)count + 1;
+			if (read + run > inputSize || written + run > outputSize)
+				return false;
+			std::copy(input + read, input + read + run, output + written);
+			read += run;
+			written += run;
+		}
+		else if (count != -128)
+		{
+			size_t run = (size_t)(1 - count);
+			if (read >= inputSize || written + run > outputSize)
+				return false;
+			std::fill(output + written, output + written + run, input[read++]);
+			written += run;
+		}
+	}
+
+	return written == outputSize;
+}
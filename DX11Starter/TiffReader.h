@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// An uncompressed image in plain memory, one value per
+// channel per texel, rows top to bottom.  Values are kept in
+// 16 bits whatever the depth they came in, but stay in that
+// depth's range (0-255 for 8 bits, 0-65535 for 16).
+// --------------------------------------------------------
+struct TextureImage
+{
+	unsigned int Width;
+	unsigned int Height;
+	unsigned int Channels;	// 1 to 4
+	unsigned int BitDepth;	// 8 or 16
+	std::vector<unsigned short> Values;
+
+	unsigned short Get(unsigned int x, unsigned int y, unsigned int channel) const { return Values[((size_t)y * Width + x) * Channels + channel]; }
+	unsigned short MaxValue() const { return BitDepth == 16 ? 0xFFFF : 0xFF; }
+};
+
+// --------------------------------------------------------
+// Reads the TIFF files texture tools usually save: one image,
+// in strips, 8 or 16 bits per channel with up to 4 channels,
+// either uncompressed, LZW or PackBits, with or without the
+// horizontal predictor.  Tiled, planar, floating point and
+// JPEG compressed files fail to load instead.
+//
+// Only needs the standard library, so tools can read source
+// textures on any platform.
+// --------------------------------------------------------
+class TiffReader
+{
+public:
+	// Decoding a file already in memory.  False if it isn't a TIFF
+	// this can read, or it's cut short.
+	static bool Read(const unsigned char* bytes, size_t byteCount, TextureImage& image);
+
+	// Loading a file.  False on failure.
+	static bool Load(const std::string& path, TextureImage& image);
+
+private:
+	// Decompressing one strip into exactly outputSize bytes
+	static bool DecodeLZW(const unsigned char* input, size_t inputSize, unsigned char* output, size_t outputSize);
+	static bool DecodePackBits(const unsigned char* input, size_t inputSize, unsigned char* output, size_t outputSize);
+};
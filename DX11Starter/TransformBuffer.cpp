@@ -0,0 +1,109 @@
+#include "TransformBuffer.h"
+
+// For the DirectX Math library
+using namespace DirectX;
+
+TransformBuffer::TransformBuffer(IRenderDevice* device)
+{
+	this->device = device;
+	buffer = 0;
+	shaderResourceView = 0;
+	capacity = 0;
+	bytesUploadedLastFrame = 0;
+	copiesLastFrame = 0;
+	fullUploadLastFrame = false;
+}
+
+TransformBuffer::~TransformBuffer()
+{
+	device->Release(shaderResourceView);
+	device->Release(buffer);
+}
+
+// --------------------------------------------------------
+// An entity's transform version changes every time its world
+// matrix does, so comparing versions finds the ones that moved
+// --------------------------------------------------------
+void TransformBuffer::Sync(std::vector<Entity>& entities)
+{
+	unsigned int count = (unsigned int)entities.size();
+	if (count != transforms.size())
+	{
+		transforms.resize(count);
+		versions.resize(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			transforms[i] = entities[i].GetWorldMatrix();
+			versions[i] = entities[i].GetTransformVersion();
+		}
+		dirtyRanges.Resize(count);
+		return;
+	}
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned int version = entities[i].GetTransformVersion();
+		if (version == versions[i])
+			continue;
+
+		transforms[i] = entities[i].GetWorldMatrix();
+		versions[i] = version;
+		dirtyRanges.MarkDirty(i);
+	}
+}
+
+void TransformBuffer::Upload(IRenderContext* context)
+{
+	bytesUploadedLastFrame = 0;
+	copiesLastFrame = 0;
+	fullUploadLastFrame = false;
+	if (transforms.empty())
+		return;
+
+	// A new buffer starts out empty, so everything goes up
+	if (transforms.size() > capacity)
+	{
+		Reserve((unsigned int)transforms.size());
+		dirtyRanges.MarkAllDirty();
+	}
+	if (!buffer)
+		return;
+
+	fullUploadLastFrame = dirtyRanges.BuildRanges(ranges);
+	for (std::vector<DirtyRange>::size_type i = 0; i != ranges.size(); i++)
+	{
+		unsigned int byteOffset = ranges[i].First * sizeof(XMFLOAT4X4);
+		unsigned int byteSize = ranges[i].Count * sizeof(XMFLOAT4X4);
+		context->UpdateSubresourceRange(buffer, byteOffset, &transforms[ranges[i].First], byteSize);
+		bytesUploadedLastFrame += byteSize;
+		copiesLastFrame++;
+	}
+}
+
+// --------------------------------------------------------
+// Grows the buffer (to the next power of two) and its view
+// --------------------------------------------------------
+void TransformBuffer::Reserve(unsigned int count)
+{
+	unsigned int newCapacity = capacity > 0 ? capacity : 64;
+	while (newCapacity < count)
+		newCapacity *= 2;
+
+	device->Release(shaderResourceView);
+	device->Release(buffer);
+	shaderResourceView = 0;
+	capacity = 0;
+
+	// Default usage, since only small parts of it change each frame
+	BufferDesc desc = {};
+	desc.Usage = BUFFER_USAGE_DEFAULT;
+	desc.ByteWidth = sizeof(XMFLOAT4X4) * newCapacity;
+	desc.BindFlags = BUFFER_BIND_SHADER_RESOURCE;
+	desc.StructureByteStride = sizeof(XMFLOAT4X4);
+	buffer = device->CreateBuffer(desc, 0);
+	if (!buffer)
+		return;
+
+	shaderResourceView = device->CreateBufferShaderResourceView(buffer, newCapacity);
+	capacity = newCapacity;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "DirtyRangeTracker.h"
+#include "Entity.h"
+#include "RenderDevice.h"
+
+// --------------------------------------------------------
+// A structured buffer on the GPU holding every entity's world
+// matrix, indexed by entity.  It stays around between frames,
+// and only the matrices of entities that moved are copied up,
+// so instanced draws just need each instance's entity index.
+// --------------------------------------------------------
+class TransformBuffer
+{
+public:
+	TransformBuffer(IRenderDevice* device); // Constructor
+	~TransformBuffer(); // Destructor
+
+	// Copies the world matrices of entities that changed since the
+	// last call into the CPU copy, and marks them for uploading.
+	// Adding or removing entities reuploads everything.
+	void Sync(std::vector<Entity>& entities);
+
+	// Uploads the changed ranges of matrices
+	void Upload(IRenderContext* context);
+
+	// Call if entities were reordered, since that isn't noticed
+	void MarkAllDirty() { dirtyRanges.MarkAllDirty(); }
+
+	// What the instanced vertex shader reads the matrices from
+	ID3D11ShaderResourceView* GetShaderResourceView() { return shaderResourceView; }
+
+	// Stats for the last upload
+	unsigned int GetBytesUploadedLastFrame() { return bytesUploadedLastFrame; }
+	unsigned int GetCopiesLastFrame() { return copiesLastFrame; }
+	bool WasFullUploadLastFrame() { return fullUploadLastFrame; }
+
+private:
+	// Helper methods
+	void Reserve(unsigned int count);
+
+	IRenderDevice* device;
+	ID3D11Buffer* buffer;
+	ID3D11ShaderResourceView* shaderResourceView;
+	unsigned int capacity;
+
+	// The matrices as last synced, and the entity transform versions they came from
+	std::vector<DirectX::XMFLOAT4X4> transforms;
+	std::vector<unsigned int> versions;
+
+	DirtyRangeTracker dirtyRanges;
+	std::vector<DirtyRange> ranges;
+
+	// Stats
+	unsigned int bytesUploadedLastFrame;
+	unsigned int copiesLastFrame;
+	bool fullUploadLastFrame;
+};
@@ -0,0 +1,231 @@
+#include "UploadManager.h"
+
+#include <algorithm>
+#include <cstring>
+
+UploadManager::UploadManager(IRenderDevice* device, IRenderContext* context, unsigned int stagingBufferSize, unsigned int stagingBufferCount)
+{
+	this->device = device;
+	this->context = context;
+	this->stagingBufferSize = stagingBufferSize;
+	nextTicket = 0;
+	frameIndex = 0;
+	frameBudget = 0;
+	bytesLastFrame = 0;
+	copiesLastFrame = 0;
+
+	// Staging buffers can't be bound to anything, they're only copied from
+	BufferDesc desc = {};
+	desc.ByteWidth = stagingBufferSize;
+	desc.Usage = BUFFER_USAGE_STAGING;
+	for (unsigned int i = 0; i < stagingBufferCount; i++)
+	{
+		StagingBuffer staging = {};
+		staging.Buffer = device->CreateBuffer(desc, 0);
+		if (staging.Buffer)
+			stagingBuffers.push_back(staging);
+	}
+}
+
+UploadManager::~UploadManager()
+{
+	for (std::vector<StagingBuffer>::size_type i = 0; i != stagingBuffers.size(); i++)
+		device->Release(stagingBuffers[i].Buffer);
+}
+
+UploadTicket UploadManager::UploadBuffer(ID3D11Buffer* destination, unsigned int destinationOffset, const void* data, unsigned int byteSize, UploadPriority priority)
+{
+	UploadRequest request;
+	request.Ticket = nextTicket++;
+	request.Type = UPLOAD_BUFFER;
+	request.Priority = priority;
+	request.Destination = destination;
+	request.DestinationOffset = destinationOffset;
+	request.MipLevel = 0;
+	request.Width = byteSize;
+	request.Height = 1;
+	request.RowPitch = byteSize;
+	request.Done = 0;
+	request.Data.assign((const unsigned char*)data, (const unsigned char*)data + byteSize);
+
+	if (destination && byteSize > 0)
+		pending.push_back(request);
+	return request.Ticket;
+}
+
+UploadTicket UploadManager::UploadTexture(ID3D11ShaderResourceView* texture, unsigned int mipLevel, unsigned int width, unsigned int height, const void* data, unsigned int rowPitch, UploadPriority priority)
+{
+	UploadRequest request;
+	request.Ticket = nextTicket++;
+	request.Type = UPLOAD_TEXTURE;
+	request.Priority = priority;
+	request.Destination = texture;
+	request.DestinationOffset = 0;
+	request.MipLevel = mipLevel;
+	request.Width = width;
+	request.Height = height;
+	request.RowPitch = rowPitch;
+	request.Done = 0;
+	request.Data.assign((const unsigned char*)data, (const unsigned char*)data + (size_t)rowPitch * height);
+
+	if (texture && width > 0 && height > 0)
+		pending.push_back(request);
+	return request.Ticket;
+}
+
+// --------------------------------------------------------
+// Spends the frame's budget on the queue in priority order.
+// Buffer data is gathered into this frame's staging buffer
+// first, and only copied out once it's unmapped again.
+// --------------------------------------------------------
+void UploadManager::ProcessFrame()
+{
+	bytesLastFrame = 0;
+	copiesLastFrame = 0;
+
+	if (!pending.empty())
+	{
+		// Stable, so uploads of the same priority keep their order
+		std::stable_sort(pending.begin(), pending.end(), [](const UploadRequest& a, const UploadRequest& b)
+		{
+			return a.Priority > b.Priority;
+		});
+
+		StagingBuffer* staging = stagingBuffers.empty() ? 0 : &stagingBuffers[frameIndex % stagingBuffers.size()];
+		bool stagingFree = staging && IsStagingBufferFree(*staging);
+		unsigned char* mapped = 0;
+		unsigned int stagingUsed = 0;
+		unsigned int budgetLeft = frameBudget > 0 ? frameBudget : 0xFFFFFFFF;
+		stagedCopies.clear();
+
+		for (std::vector<UploadRequest>::size_type i = 0; i != pending.size() && budgetLeft > 0; i++)
+		{
+			UploadRequest& request = pending[i];
+			if (request.Type == UPLOAD_BUFFER)
+			{
+				if (!stagingFree)
+					continue;
+
+				unsigned int chunk = (unsigned int)request.Data.size() - request.Done;
+				if (chunk > budgetLeft)
+					chunk = budgetLeft;
+				if (chunk > stagingBufferSize - stagingUsed)
+					chunk = stagingBufferSize - stagingUsed;
+				if (chunk == 0)
+					continue;
+
+				if (!mapped)
+				{
+					mapped = (unsigned char*)context->MapStaging(staging->Buffer);
+					if (!mapped)
+					{
+						stagingFree = false;
+						continue;
+					}
+				}
+
+				memcpy(mapped + stagingUsed, &request.Data[request.Done], chunk);
+				StagedCopy copy = { (ID3D11Buffer*)request.Destination, request.DestinationOffset + request.Done, stagingUsed, chunk };
+				stagedCopies.push_back(copy);
+
+				request.Done += chunk;
+				budgetLeft -= chunk;
+				bytesLastFrame += chunk;
+
+				// Keep each copy's source 16 byte aligned
+				stagingUsed = (stagingUsed + chunk + 15) & ~15u;
+				if (stagingUsed > stagingBufferSize)
+					stagingUsed = stagingBufferSize;
+			}
+			else
+			{
+				// At least one row goes up each frame, even if it's over budget
+				unsigned int rows = request.Height - request.Done;
+				unsigned int rowsInBudget = budgetLeft / request.RowPitch;
+				if (rowsInBudget == 0 && bytesLastFrame == 0)
+					rowsInBudget = 1;
+				if (rows > rowsInBudget)
+					rows = rowsInBudget;
+				if (rows == 0)
+					continue;
+
+				context->UpdateTextureRegion(
+					(ID3D11ShaderResourceView*)request.Destination,
+					request.MipLevel,
+					0,
+					request.Done,
+					request.Width,
+					rows,
+					&request.Data[(size_t)request.Done * request.RowPitch],
+					request.RowPitch);
+
+				unsigned int bytes = rows * request.RowPitch;
+				request.Done += rows;
+				budgetLeft = bytes < budgetLeft ? budgetLeft - bytes : 0;
+				bytesLastFrame += bytes;
+				copiesLastFrame++;
+			}
+		}
+
+		if (mapped)
+		{
+			context->Unmap(staging->Buffer);
+			for (std::vector<StagedCopy>::size_type i = 0; i != stagedCopies.size(); i++)
+			{
+				const StagedCopy& copy = stagedCopies[i];
+				context->CopyBufferRegion(copy.Destination, copy.DestinationOffset, staging->Buffer, copy.StagingOffset, copy.ByteSize);
+			}
+			copiesLastFrame += (unsigned int)stagedCopies.size();
+
+			staging->Fence = frameIndex;
+			staging->Used = true;
+		}
+
+		pending.erase(std::remove_if(pending.begin(), pending.end(), IsFinished), pending.end());
+	}
+
+	frameIndex++;
+}
+
+bool UploadManager::IsComplete(UploadTicket ticket)
+{
+	if (ticket >= nextTicket)
+		return false;
+
+	for (std::vector<UploadRequest>::size_type i = 0; i != pending.size(); i++)
+	{
+		if (pending[i].Ticket == ticket)
+			return false;
+	}
+	return true;
+}
+
+unsigned long long UploadManager::GetPendingBytes()
+{
+	unsigned long long bytes = 0;
+	for (std::vector<UploadRequest>::size_type i = 0; i != pending.size(); i++)
+	{
+		const UploadRequest& request = pending[i];
+		if (request.Type == UPLOAD_BUFFER)
+			bytes += request.Data.size() - request.Done;
+		else
+			bytes += (unsigned long long)(request.Height - request.Done) * request.RowPitch;
+	}
+	return bytes;
+}
+
+// --------------------------------------------------------
+// At most MaxFrameLatency frames can be queued behind this
+// one, so anything fenced before those is done on the GPU
+// --------------------------------------------------------
+bool UploadManager::IsStagingBufferFree(const StagingBuffer& staging)
+{
+	return !staging.Used || staging.Fence + MaxFrameLatency < frameIndex;
+}
+
+bool UploadManager::IsFinished(const UploadRequest& request)
+{
+	return request.Type == UPLOAD_BUFFER
+		? request.Done == request.Data.size()
+		: request.Done == request.Height;
+}
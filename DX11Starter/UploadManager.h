@@ -0,0 +1,129 @@
+#pragma once
+
+#include <vector>
+#include "RenderDevice.h"
+
+// Which queued uploads go first when there isn't room for all of them
+enum UploadPriority
+{
+	UPLOAD_PRIORITY_LOW,
+	UPLOAD_PRIORITY_NORMAL,
+	UPLOAD_PRIORITY_HIGH
+};
+
+// Identifies a queued upload, to check whether it's finished
+typedef unsigned long long UploadTicket;
+
+// --------------------------------------------------------
+// Feeds data to GPU buffers and textures a frame at a time,
+// instead of everything going up the moment it's created.
+//
+// Uploads are queued with a priority and copied out of the
+// caller's memory straight away.  Once a frame, ProcessFrame()
+// works through the queue (highest priority first, then in
+// the order they were queued) until the frame's byte budget
+// is used up.  Big uploads are split across frames.
+//
+// Buffer data is written into one of a ring of staging
+// buffers and copied from there on the GPU.  Each staging
+// buffer is fenced with the frame that used it, and is only
+// written again once that frame can't still be in flight, so
+// the CPU never waits on the GPU to map it.  DirectX 11 can't
+// copy from a buffer into a texture, so texture rows go up
+// with UpdateTextureRegion() instead, but they still come out
+// of the same budget.
+//
+// Only talks to the render device and context, so it runs the
+// same headless.  Destinations must stay alive until their
+// uploads are complete.
+// --------------------------------------------------------
+class UploadManager
+{
+public:
+	UploadManager(IRenderDevice* device, IRenderContext* context, unsigned int stagingBufferSize, unsigned int stagingBufferCount); // Constructor
+	~UploadManager(); // Destructor
+
+	// Queue a copy into part of a buffer.  The destination can't be
+	// immutable, since it's written after it was created.
+	UploadTicket UploadBuffer(ID3D11Buffer* destination, unsigned int destinationOffset, const void* data, unsigned int byteSize, UploadPriority priority);
+
+	// Queue a whole mip of a texture, rowPitch bytes per row of data.
+	// Uncompressed formats only, since it's split up by rows.
+	UploadTicket UploadTexture(ID3D11ShaderResourceView* texture, unsigned int mipLevel, unsigned int width, unsigned int height, const void* data, unsigned int rowPitch, UploadPriority priority);
+
+	// Call once per frame, before anything is drawn
+	void ProcessFrame();
+
+	// Whether every byte of an upload has been sent to the GPU
+	bool IsComplete(UploadTicket ticket);
+
+	// Most bytes sent per frame.  Zero means no limit, other than
+	// the size of a staging buffer for buffer uploads.
+	void SetFrameBudget(unsigned int budget) { frameBudget = budget; }
+
+	// Stats
+	unsigned int GetBytesLastFrame() { return bytesLastFrame; }
+	unsigned int GetCopiesLastFrame() { return copiesLastFrame; }
+	unsigned int GetPendingCount() { return (unsigned int)pending.size(); }
+	unsigned long long GetPendingBytes();
+
+	// Frames the GPU can be behind the CPU, as with the constant ring
+	static const unsigned int MaxFrameLatency = 3;
+
+private:
+	enum UploadType
+	{
+		UPLOAD_BUFFER,
+		UPLOAD_TEXTURE
+	};
+
+	struct UploadRequest
+	{
+		UploadTicket Ticket;
+		UploadType Type;
+		UploadPriority Priority;
+		void* Destination;				// ID3D11Buffer or ID3D11ShaderResourceView
+		unsigned int DestinationOffset;	// Buffers only
+		unsigned int MipLevel;			// Textures only
+		unsigned int Width;
+		unsigned int Height;
+		unsigned int RowPitch;
+		unsigned int Done;				// Bytes for buffers, rows for textures
+		std::vector<unsigned char> Data;
+	};
+
+	struct StagingBuffer
+	{
+		ID3D11Buffer* Buffer;
+		unsigned long long Fence;		// Frame that last copied out of it
+		bool Used;
+	};
+
+	// A buffer copy waiting for the staging buffer to be unmapped
+	struct StagedCopy
+	{
+		ID3D11Buffer* Destination;
+		unsigned int DestinationOffset;
+		unsigned int StagingOffset;
+		unsigned int ByteSize;
+	};
+
+	// Helper methods
+	bool IsStagingBufferFree(const StagingBuffer& staging);
+	static bool IsFinished(const UploadRequest& request);
+
+	IRenderDevice* device;
+	IRenderContext* context;
+	std::vector<StagingBuffer> stagingBuffers;
+	unsigned int stagingBufferSize;
+
+	std::vector<UploadRequest> pending;
+	std::vector<StagedCopy> stagedCopies;
+	UploadTicket nextTicket;
+	unsigned long long frameIndex;
+	unsigned int frameBudget;
+
+	// Stats
+	unsigned int bytesLastFrame;
+	unsigned int copiesLastFrame;
+};
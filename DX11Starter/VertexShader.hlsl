@@ -10,6 +10,7 @@ cbuffer externalData : register(b0)
 	matrix world;
 	matrix view;
 	matrix projection;
+	uint textureSlice;	// Which slice of the material's texture array to sample
 };
 
 // Struct representing a single vertex worth of data
@@ -44,6 +45,7 @@ struct VertexToPixel
 	float4 position		: SV_POSITION;	// XYZW position (System Value Position)
 	float3 normal		: NORMAL;
 	float2 uv			: TEXCOORD;
+	nointerpolation uint textureSlice : TEXTURE_SLICE;
 };
 
 // --------------------------------------------------------
@@ -80,6 +82,7 @@ VertexToPixel main( VertexShaderInput input )
 
 	// Pass the vertex UV cordinates through to the pixel shader
 	output.uv = input.uv;
+	output.textureSlice = textureSlice;
 
 	// Whatever we return will make its way through the pipeline to the
 	// next programmable stage we're using (the pixel shader for now)
@@ -0,0 +1,68 @@
+
+// Constant Buffer
+// - Only the camera matrices are shared by every instance,
+//    each instance brings the index of its own world matrix
+cbuffer externalData : register(b0)
+{
+	matrix view;
+	matrix projection;
+};
+
+// Every entity's world matrix, kept on the GPU between frames
+// - Untransposed, one row per 16 bytes
+struct Transform
+{
+	row_major matrix world;
+};
+StructuredBuffer<Transform> transforms : register(t0);
+
+// Struct representing a single vertex worth of data
+// - The first three members come from the mesh's vertex buffer (slot 0)
+// - Anything with a semantic ending in _PER_INSTANCE comes from the
+//    instance buffer (slot 1) and advances once per instance.
+//    SimpleShader sets up the input layout for this automatically.
+struct VertexShaderInput
+{
+	float3 position		: POSITION;     // XYZ position
+	float3 normal		: NORMAL;
+	float2 uv			: TEXCOORD;
+	uint transformIndex	: TRANSFORM_PER_INSTANCE; // Which world matrix to use
+	uint textureSlice	: SLICE_PER_INSTANCE;	// Which slice of the material's texture array
+};
+
+// Struct representing the data we're sending down the pipeline
+// - Must match VertexShader.hlsl so the same pixel shader works with both
+struct VertexToPixel
+{
+	float4 position		: SV_POSITION;	// XYZW position (System Value Position)
+	float3 normal		: NORMAL;
+	float2 uv			: TEXCOORD;
+	nointerpolation uint textureSlice : TEXTURE_SLICE;
+};
+
+// --------------------------------------------------------
+// The entry point (main method) for our instanced vertex shader
+//
+// - Identical to VertexShader.hlsl apart from where the world
+//   matrix comes from
+// --------------------------------------------------------
+VertexToPixel main( VertexShaderInput input )
+{
+	// Set up output struct
+	VertexToPixel output;
+
+	// Combine the world, view and projection matrices and
+	// use them to get the vertex into screen space
+	matrix world = transforms[input.transformIndex].world;
+	matrix worldViewProj = mul(mul(world, view), projection);
+	output.position = mul(float4(input.position, 1.0f), worldViewProj);
+
+	// Convert the passed in normal to world space
+	output.normal = mul(input.normal, (float3x3)world);
+
+	// Pass the vertex UV cordinates through to the pixel shader
+	output.uv = input.uv;
+	output.textureSlice = input.textureSlice;
+
+	return output;
+}
@@ -0,0 +1,91 @@
+#include "Test.h"
+#include "RecordingContext.h"
+#include "CommandRecorder.h"
+#include "NullRenderContext.h"
+#include "RecordingCommandList.h"
+
+#include <mutex>
+#include <set>
+#include <thread>
+
+static ICommandList* CreateRecordingList()
+{
+	return new RecordingCommandList();
+}
+
+// Each item is one draw, told apart by its start index
+static void RecordDraws(IRenderContext* context, unsigned int first, unsigned int count)
+{
+	for (unsigned int i = first; i < first + count; i++)
+		context->DrawIndexed(3, i, 0);
+}
+
+static bool DrawsInOrder(RecordingContext& recorder, unsigned int itemCount)
+{
+	unsigned int next = 0;
+	for (size_t i = 0; i < recorder.Calls.size(); i++)
+	{
+		if (strcmp(recorder.Calls[i].Name, "DrawIndexed") != 0)
+			continue;
+		if (recorder.Calls[i].StartSlot != next)
+			return false;
+		next++;
+	}
+	return next == itemCount;
+}
+
+TEST(CommandRecorderKeepsItemOrder)
+{
+	NullRenderContext null;
+	RecordingContext recorder(&null);
+	CommandRecorder commandRecorder(CreateRecordingList);
+	commandRecorder.SetThreadCount(4);
+	commandRecorder.SetMinItemsPerThread(16);
+
+	// Different thread counts from frame to frame, including going back
+	// down to one and up again, with the same recorder
+	unsigned int itemCounts[] = { 1000, 17, 64, 1000, 5, 333, 1000 };
+	unsigned int expectedThreads[] = { 4, 1, 4, 4, 1, 4, 4 };
+	for (unsigned int frame = 0; frame < sizeof(itemCounts) / sizeof(itemCounts[0]); frame++)
+	{
+		recorder.Clear();
+		commandRecorder.Record(&recorder, itemCounts[frame], RecordDraws);
+		CHECK(commandRecorder.GetThreadsUsed() == expectedThreads[frame]);
+		CHECK(DrawsInOrder(recorder, itemCounts[frame]));
+	}
+
+	// Two threads' worth
+	recorder.Clear();
+	commandRecorder.Record(&recorder, 40, RecordDraws);
+	CHECK(commandRecorder.GetThreadsUsed() == 2);
+	CHECK(DrawsInOrder(recorder, 40));
+}
+
+TEST(CommandRecorderReusesWorkerThreads)
+{
+	NullRenderContext null;
+	RecordingContext recorder(&null);
+	CommandRecorder commandRecorder(CreateRecordingList);
+	commandRecorder.SetThreadCount(3);
+	commandRecorder.SetMinItemsPerThread(1);
+
+	// Every thread that records anything, across many frames
+	std::mutex mutex;
+	std::set<std::thread::id> recordingThreads;
+	for (unsigned int frame = 0; frame < 50; frame++)
+	{
+		commandRecorder.Record(&recorder, 30, [&](IRenderContext* context, unsigned int first, unsigned int count)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				recordingThreads.insert(std::this_thread::get_id());
+			}
+			RecordDraws(context, first, count);
+		});
+	}
+
+	// The calling thread and the same two workers every time
+	CHECK(recordingThreads.size() == 3);
+	CHECK(recordingThreads.count(std::this_thread::get_id()) == 1);
+	CHECK(null.GetDrawCalls() == 50 * 30);
+}
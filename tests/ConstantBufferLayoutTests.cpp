@@ -0,0 +1,184 @@
+#include "Test.h"
+#include "ConstantBufferLayout.h"
+#include "ShaderConstants.h"
+
+// --------------------------------------------------------
+// Most of the layout checks happen while compiling, so this
+// file builds the engine's buffers (whose static_asserts run
+// when ShaderConstants.h is included) and a few structs of
+// its own that HLSL would pack differently to C++
+// --------------------------------------------------------
+
+// A float3 fits in what's left of a register after one float...
+struct FitsAfterFloat
+{
+	float A;
+	DirectX::XMFLOAT3 B;
+};
+
+template<> struct HlslLayout<FitsAfterFloat>
+{
+	static constexpr HlslMemberList<2> Members()
+	{
+		return {{ HLSL_MEMBER(FitsAfterFloat, A), HLSL_MEMBER(FitsAfterFloat, B) }};
+	}
+};
+
+// ...but not after two, where HLSL moves it on to the next register
+struct CrossesRegister
+{
+	float A;
+	float B;
+	DirectX::XMFLOAT3 C;
+	float D;
+};
+
+template<> struct HlslLayout<CrossesRegister>
+{
+	static constexpr HlslMemberList<4> Members()
+	{
+		return {{
+			HLSL_MEMBER(CrossesRegister, A),
+			HLSL_MEMBER(CrossesRegister, B),
+			HLSL_MEMBER(CrossesRegister, C),
+			HLSL_MEMBER(CrossesRegister, D)
+		}};
+	}
+};
+
+// The same, padded by hand the way HLSL does it
+struct PaddedCrossesRegister
+{
+	float A;
+	float B;
+	float Padding[2];
+	DirectX::XMFLOAT3 C;
+	float D;
+};
+
+template<> struct HlslLayout<PaddedCrossesRegister>
+{
+	static constexpr HlslMemberList<4> Members()
+	{
+		return {{
+			HLSL_MEMBER(PaddedCrossesRegister, A),
+			HLSL_MEMBER(PaddedCrossesRegister, B),
+			HLSL_MEMBER(PaddedCrossesRegister, C),
+			HLSL_MEMBER(PaddedCrossesRegister, D)
+		}};
+	}
+};
+
+// Members in the right places, but not a whole register long
+struct ShortOfRegister
+{
+	DirectX::XMFLOAT3 A;
+};
+
+template<> struct HlslLayout<ShortOfRegister>
+{
+	static constexpr HlslMemberList<1> Members()
+	{
+		return {{ HLSL_MEMBER(ShortOfRegister, A) }};
+	}
+};
+
+// A struct always starts a new register, even after a lone float
+struct NestedAfterFloat
+{
+	float A;
+	float Padding[3];
+	FitsAfterFloat B;
+};
+
+template<> struct HlslLayout<NestedAfterFloat>
+{
+	static constexpr HlslMemberList<2> Members()
+	{
+		return {{ HLSL_MEMBER(NestedAfterFloat, A), HLSL_MEMBER(NestedAfterFloat, B) }};
+	}
+};
+
+static_assert(HlslRoundToRegister(0) == 0 && HlslRoundToRegister(1) == 16 && HlslRoundToRegister(16) == 16, "Rounding to registers");
+static_assert(HlslLayoutMatches<FitsAfterFloat>(), "A float3 fits after a float");
+static_assert(!HlslLayoutMatches<CrossesRegister>(), "A float3 after two floats has to move");
+static_assert(HlslLayoutMatches<PaddedCrossesRegister>(), "Padding it by hand matches");
+static_assert(HlslPackedSize(HlslLayout<PaddedCrossesRegister>::Members()) == 32, "Packed size of the padded struct");
+static_assert(!HlslLayoutMatches<ShortOfRegister>(), "Structs are a whole number of registers");
+static_assert(HlslLayoutMatches<NestedAfterFloat>(), "Structs start a new register");
+
+// Array elements are padded to a register, except the last
+static_assert(HlslTraits<DirectionalLight>::HlslSize == 48, "DirectionalLight packs into three registers");
+static_assert(HlslTraits<DirectionalLight[4]>::HlslSize == 192, "Four lights back to back");
+static_assert(HlslTraits<DirectX::XMFLOAT4[3]>::HlslSize == 48, "float4 arrays have no padding");
+
+TEST(ConstantBufferLayoutPacksLikeHlsl)
+{
+	// The same walk at run time, member by member
+	const auto crosses = HlslLayout<CrossesRegister>::Members();
+	CHECK(crosses.Members[2].Offset == 8);
+	CHECK(HlslPackedSize(crosses) == 0);
+
+	const auto padded = HlslLayout<PaddedCrossesRegister>::Members();
+	CHECK(padded.Members[2].Offset == 16 && padded.Members[2].Size == 12);
+	CHECK(padded.Members[3].Offset == 28);
+	CHECK(HlslPackedSize(padded) == 32);
+
+	const auto nested = HlslLayout<NestedAfterFloat>::Members();
+	CHECK(nested.Members[1].StartsRegister && nested.Members[1].Size == 16);
+	CHECK(!nested.Members[0].StartsRegister);
+
+	CHECK(HlslPackedSize(HlslLayout<ShortOfRegister>::Members()) == 12);
+	CHECK(sizeof(VertexShaderConstants) == 208);
+	CHECK(sizeof(LightConstants) == 192);
+}
+
+static ReflectedConstantBuffer MaterialBuffer()
+{
+	ReflectedConstantBuffer buffer;
+	buffer.Name = "materialData";
+	buffer.Size = 32;
+	buffer.BindIndex = 1;
+	ReflectedVariable tint = { "tint", 0, 16 };
+	ReflectedVariable uvScale = { "uvScale", 16, 8 };
+	ReflectedVariable uvOffset = { "uvOffset", 24, 8 };
+	buffer.Variables.push_back(tint);
+	buffer.Variables.push_back(uvScale);
+	buffer.Variables.push_back(uvOffset);
+	return buffer;
+}
+
+TEST(ConstantBufferLayoutMatchesReflection)
+{
+	CHECK(HlslLayoutMatchesReflection<MaterialParameters>(MaterialBuffer()));
+
+	// The shader's buffer changing size, shape or order is caught
+	ReflectedConstantBuffer changed = MaterialBuffer();
+	changed.Size = 48;
+	CHECK(!HlslLayoutMatchesReflection<MaterialParameters>(changed));
+
+	changed = MaterialBuffer();
+	changed.Variables.pop_back();
+	CHECK(!HlslLayoutMatchesReflection<MaterialParameters>(changed));
+
+	changed = MaterialBuffer();
+	ReflectedVariable extra = { "extra", 32, 4 };
+	changed.Variables.push_back(extra);
+	CHECK(!HlslLayoutMatchesReflection<MaterialParameters>(changed));
+
+	changed = MaterialBuffer();
+	changed.Variables[1].ByteOffset = 24;
+	changed.Variables[2].ByteOffset = 16;
+	CHECK(!HlslLayoutMatchesReflection<MaterialParameters>(changed));
+
+	changed = MaterialBuffer();
+	changed.Variables[2].Size = 4;
+	CHECK(!HlslLayoutMatchesReflection<MaterialParameters>(changed));
+
+	// A struct that doesn't match HLSL never matches a shader
+	ReflectedConstantBuffer short3 = {};
+	short3.Size = sizeof(ShortOfRegister);
+	ReflectedVariable a = { "a", 0, 12 };
+	short3.Variables.push_back(a);
+	CHECK(!HlslLayoutMatchesReflection<ShortOfRegister>(short3));
+}
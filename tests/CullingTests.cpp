@@ -0,0 +1,172 @@
+#include "Test.h"
+#include "CullingSystem.h"
+#include "NullRenderDevice.h"
+
+#include <cmath>
+#include <random>
+
+using namespace DirectX;
+
+// A unit cube centered on the origin, so its bounds have a radius of sqrt(3)
+static Mesh* MakeCube(IRenderDevice* device)
+{
+	Vertex vertices[8] = {};
+	unsigned int indices[8];
+	for (int i = 0; i < 8; i++)
+	{
+		vertices[i].Position = XMFLOAT3(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f);
+		indices[i] = i;
+	}
+	return new Mesh(device, vertices, 8, indices, 8, 0);
+}
+
+// Both stored transposed, like the camera's
+static void MakeCamera(XMFLOAT3 position, float yaw, float pitch, XMFLOAT4X4& view, XMFLOAT4X4& projection)
+{
+	XMVECTOR direction = XMVector3Rotate(XMVectorSet(0, 0, 1, 0), XMQuaternionRotationRollPitchYaw(pitch, yaw, 0));
+	XMStoreFloat4x4(&view, XMMatrixTranspose(XMMatrixLookToLH(XMLoadFloat3(&position), direction, XMVectorSet(0, 1, 0, 0))));
+	XMStoreFloat4x4(&projection, XMMatrixTranspose(XMMatrixPerspectiveFovLH(0.25f * 3.1415926535f, 16.0f / 9.0f, 0.1f, 100.0f)));
+}
+
+// --------------------------------------------------------
+// The reference the culling system is checked against: every
+// sphere tested against the six clip space planes, worked out
+// from scratch each time
+// --------------------------------------------------------
+static bool BruteForceVisible(XMFLOAT3 center, float radius, const XMFLOAT4X4& view, const XMFLOAT4X4& projection)
+{
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(
+		XMMatrixTranspose(XMLoadFloat4x4(&view)),
+		XMMatrixTranspose(XMLoadFloat4x4(&projection))));
+
+	for (int plane = 0; plane < 6; plane++)
+	{
+		// Columns of view * projection make the planes
+		int axis = plane / 2;
+		float sign = plane % 2 ? -1.0f : 1.0f;
+		float p[4];
+		for (int i = 0; i < 4; i++)
+		{
+			p[i] = axis == 2
+				? (plane == 4 ? viewProjection.m[i][2] : viewProjection.m[i][3] - viewProjection.m[i][2])
+				: viewProjection.m[i][3] + sign * viewProjection.m[i][axis];
+		}
+
+		float length = sqrtf(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+		float distance = (p[0] * center.x + p[1] * center.y + p[2] * center.z + p[3]) / length;
+		if (distance < -radius)
+			return false;
+	}
+	return true;
+}
+
+TEST(EntityBoundsContainRotatedNonUniformScale)
+{
+	NullRenderDevice device;
+	Mesh* cube = MakeCube(&device);
+
+	// Stretched along one axis, then turned so that axis isn't lined up with
+	// any other.  The matrix's rows come out shorter than the stretch.
+	Entity entity(cube, 0);
+	entity.SetScale(XMFLOAT3(1, 1, 4));
+	entity.SetRotation(XMFLOAT3(0.7f, 0.4f, 0.2f));
+	entity.SetPosition(XMFLOAT3(3, -2, 5));
+	entity.Update(0, 0);
+
+	CHECK(fabsf(entity.GetBoundsRadius() - 4.0f * cube->GetBoundsRadius()) < 0.001f);
+
+	// Every corner, moved into world space, is inside the sphere
+	XMFLOAT4X4 worldMatrix = entity.GetWorldMatrix();
+	XMMATRIX world = XMLoadFloat4x4(&worldMatrix);
+	XMFLOAT3 center = entity.GetBoundsCenter();
+	for (int i = 0; i < 8; i++)
+	{
+		XMVECTOR corner = XMVector3TransformCoord(XMVectorSet(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f, 1), world);
+		float distance = XMVectorGetX(XMVector3Length(corner - XMLoadFloat3(&center)));
+		CHECK(distance <= entity.GetBoundsRadius() + 0.001f);
+	}
+
+	delete cube;
+}
+
+// --------------------------------------------------------
+// Flies the camera around a field of entities, some of them
+// moving, and checks every frame that nothing the brute force
+// test can see is missing from what the culling system kept.
+// The culling system may keep a few extra for a while, but a
+// forced full pass has to match exactly.
+// --------------------------------------------------------
+TEST(CullingSystemMatchesBruteForce)
+{
+	NullRenderDevice device;
+	Mesh* cube = MakeCube(&device);
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> spread(-60.0f, 60.0f);
+	std::uniform_real_distribution<float> scales(0.2f, 3.0f);
+	std::uniform_real_distribution<float> angles(0.0f, 6.28f);
+
+	std::vector<Entity> entities;
+	for (int i = 0; i < 400; i++)
+	{
+		Entity entity(cube, 0);
+		entity.SetPosition(XMFLOAT3(spread(random), spread(random) * 0.25f, spread(random)));
+		entity.SetScale(XMFLOAT3(scales(random), scales(random), scales(random)));
+		entity.SetRotation(XMFLOAT3(angles(random), angles(random), angles(random)));
+		entity.Update(0, 0);
+		entities.push_back(entity);
+	}
+
+	CullingSystem culling;
+	std::vector<unsigned int> visible;
+	unsigned int missed = 0;
+	unsigned int skipped = 0;
+	unsigned int fullPassMismatches = 0;
+	for (int frame = 0; frame < 600; frame++)
+	{
+		// A slow orbit with some bobbing, and every now and then a jump
+		float t = frame * 0.01f;
+		XMFLOAT3 position(cosf(t) * 30.0f, sinf(t * 3.0f) * 5.0f, sinf(t) * 30.0f);
+		if (frame % 150 == 149)
+			position.x += 20.0f;
+		XMFLOAT4X4 view, projection;
+		MakeCamera(position, t * 2.0f, sinf(t * 5.0f) * 0.3f, view, projection);
+
+		// A few entities move every frame
+		for (int i = 0; i < 10; i++)
+		{
+			Entity& entity = entities[(frame * 7 + i * 37) % entities.size()];
+			XMFLOAT3 p = entity.GetPosition();
+			entity.SetPosition(XMFLOAT3(p.x + 0.5f, p.y, p.z - 0.5f));
+			entity.Update(0, 0);
+		}
+
+		bool forced = frame % 100 == 99;
+		if (forced)
+			culling.ForceFullPass();
+		culling.Cull(entities, view, projection, visible);
+		skipped += culling.GetSkippedLastFrame();
+
+		std::vector<bool> kept(entities.size(), false);
+		for (size_t i = 0; i < visible.size(); i++)
+			kept[visible[i]] = true;
+
+		for (size_t i = 0; i < entities.size(); i++)
+		{
+			bool expected = BruteForceVisible(entities[i].GetBoundsCenter(), entities[i].GetBoundsRadius(), view, projection);
+			if (expected && !kept[i])
+				missed++;
+			if (forced && expected != kept[i])
+				fullPassMismatches++;
+		}
+	}
+
+	CHECK(missed == 0);
+	CHECK(fullPassMismatches == 0);
+
+	// And it actually reused earlier results along the way
+	CHECK(skipped > 0);
+
+	delete cube;
+}
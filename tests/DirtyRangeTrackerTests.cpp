@@ -0,0 +1,144 @@
+#include "Test.h"
+#include "DirtyRangeTracker.h"
+
+static bool IsRange(const DirtyRange& range, unsigned int first, unsigned int count)
+{
+	return range.First == first && range.Count == count;
+}
+
+// A tracker with nothing dirty, as it is after its first upload
+static void StartClean(DirtyRangeTracker& tracker, unsigned int elementCount)
+{
+	std::vector<DirtyRange> ranges;
+	tracker.Resize(elementCount);
+	tracker.BuildRanges(ranges);
+}
+
+TEST(DirtyRangeTrackerMergesSmallGaps)
+{
+	DirtyRangeTracker tracker;
+	StartClean(tracker, 1000);
+	std::vector<DirtyRange> ranges;
+
+	// Up to maxGap clean elements between two dirty ones are uploaded with them
+	tracker.MarkDirty(10);
+	tracker.MarkDirty(19);
+	CHECK(!tracker.BuildRanges(ranges));
+	CHECK(ranges.size() == 1);
+	CHECK(IsRange(ranges[0], 10, 10));
+
+	// One more and they're kept apart
+	tracker.MarkDirty(10);
+	tracker.MarkDirty(20);
+	CHECK(!tracker.BuildRanges(ranges));
+	CHECK(ranges.size() == 2);
+	CHECK(IsRange(ranges[0], 10, 1));
+	CHECK(IsRange(ranges[1], 20, 1));
+
+	// Runs merge across the 64 element words too
+	tracker.MarkDirty(60, 3);
+	tracker.MarkDirty(66, 2);
+	tracker.MarkDirty(130);
+	CHECK(!tracker.BuildRanges(ranges));
+	CHECK(ranges.size() == 2);
+	CHECK(IsRange(ranges[0], 60, 8));
+	CHECK(IsRange(ranges[1], 130, 1));
+
+	// Building cleared everything
+	CHECK(tracker.GetDirtyCount() == 0);
+	CHECK(!tracker.BuildRanges(ranges));
+	CHECK(ranges.empty());
+}
+
+TEST(DirtyRangeTrackerFillsSmallestGapsPastMaxRanges)
+{
+	DirtyRangeTracker tracker;
+	tracker.SetMaxGap(0);
+	tracker.SetMaxRanges(3);
+	StartClean(tracker, 1000);
+	std::vector<DirtyRange> ranges;
+
+	// Gaps of 2, 1, 1 and 12: the two 1s go, though the 2 comes first
+	unsigned int spread[] = { 0, 3, 5, 7, 20 };
+	for (unsigned int i = 0; i < 5; i++)
+		tracker.MarkDirty(spread[i]);
+	CHECK(!tracker.BuildRanges(ranges));
+	CHECK(ranges.size() == 3);
+	CHECK(IsRange(ranges[0], 0, 1));
+	CHECK(IsRange(ranges[1], 3, 5));
+	CHECK(IsRange(ranges[2], 20, 1));
+
+	// Gaps of 1, 1, 1 and 9, with two merges needed: only the first two
+	// of the tied gaps are filled in, and there are exactly maxRanges left
+	unsigned int ties[] = { 0, 2, 4, 6, 16 };
+	for (unsigned int i = 0; i < 5; i++)
+		tracker.MarkDirty(ties[i]);
+	CHECK(!tracker.BuildRanges(ranges));
+	CHECK(ranges.size() == 3);
+	CHECK(IsRange(ranges[0], 0, 5));
+	CHECK(IsRange(ranges[1], 6, 1));
+	CHECK(IsRange(ranges[2], 16, 1));
+
+	// Gaps of 1, 1, 2, 2, 2 and 20, with four merges needed: the gaps
+	// under the cutoff all go, then the first two at it make up the rest
+	unsigned int mixed[] = { 0, 2, 4, 7, 10, 13, 34 };
+	for (unsigned int i = 0; i < 7; i++)
+		tracker.MarkDirty(mixed[i]);
+	CHECK(!tracker.BuildRanges(ranges));
+	CHECK(ranges.size() == 3);
+	CHECK(IsRange(ranges[0], 0, 11));
+	CHECK(IsRange(ranges[1], 13, 1));
+	CHECK(IsRange(ranges[2], 34, 1));
+
+	// No limit
+	tracker.SetMaxRanges(0);
+	for (unsigned int i = 0; i < 7; i++)
+		tracker.MarkDirty(mixed[i]);
+	CHECK(!tracker.BuildRanges(ranges));
+	CHECK(ranges.size() == 7);
+}
+
+TEST(DirtyRangeTrackerSwitchesToFullUpload)
+{
+	DirtyRangeTracker tracker;
+	std::vector<DirtyRange> ranges;
+
+	// Everything starts out dirty
+	tracker.Resize(100);
+	CHECK(tracker.GetDirtyCount() == 100);
+	CHECK(tracker.BuildRanges(ranges));
+	CHECK(ranges.size() == 1);
+	CHECK(IsRange(ranges[0], 0, 100));
+
+	// Just under half dirty
+	tracker.MarkDirty(0, 49);
+	CHECK(!tracker.BuildRanges(ranges));
+	CHECK(ranges.size() == 1);
+	CHECK(IsRange(ranges[0], 0, 49));
+
+	// Half
+	tracker.MarkDirty(0, 50);
+	CHECK(tracker.BuildRanges(ranges));
+	CHECK(IsRange(ranges[0], 0, 100));
+
+	// Only 13 dirty, but with the gaps filled in they'd cover 97
+	for (unsigned int i = 0; i < 100; i += 8)
+		tracker.MarkDirty(i);
+	CHECK(tracker.GetDirtyCount() == 13);
+	CHECK(tracker.BuildRanges(ranges));
+	CHECK(ranges.size() == 1);
+	CHECK(IsRange(ranges[0], 0, 100));
+
+	// And the fraction can be changed
+	tracker.SetFullUploadFraction(0.25f);
+	tracker.MarkDirty(50, 25);
+	CHECK(tracker.BuildRanges(ranges));
+	tracker.MarkDirty(50, 24);
+	CHECK(!tracker.BuildRanges(ranges));
+	CHECK(IsRange(ranges[0], 50, 24));
+
+	// Out of range marks are ignored, and not counted
+	tracker.MarkDirty(100);
+	tracker.MarkDirty(98, 10);
+	CHECK(tracker.GetDirtyCount() == 2);
+}
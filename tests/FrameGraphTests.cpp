@@ -0,0 +1,271 @@
+#include "Test.h"
+#include "FrameGraph.h"
+#include "NullRenderDevice.h"
+#include "D3D11Types.h"
+
+#include <string>
+
+static const RenderTextureDesc ColorDesc = { 64, 32, DXGI_FORMAT_R8G8B8A8_UNORM, TEXTURE_BIND_RENDER_TARGET | TEXTURE_BIND_SHADER_RESOURCE };
+static const RenderTextureDesc DepthDesc = { 64, 32, DXGI_FORMAT_D24_UNORM_S8_UINT, TEXTURE_BIND_DEPTH_STENCIL };
+static const unsigned long long ColorBytes = 64 * 32 * 4;
+
+// A pass that adds its name to a log when it runs
+static unsigned int AddLoggedPass(FrameGraph& graph, const char* name, std::string& log)
+{
+	return graph.AddPass(name, [name, &log](IRenderContext*, const FrameGraph&) { log += name; });
+}
+
+static bool IsBarrier(const FrameGraphBarrier& barrier, FrameGraphResource resource, FrameGraphAccess before, FrameGraphAccess after)
+{
+	return barrier.Resource == resource && barrier.Before == before && barrier.After == after;
+}
+
+TEST(FrameGraphCullsUnusedPasses)
+{
+	NullRenderDevice device;
+	FrameGraph graph(&device);
+	std::string log;
+
+	RenderTexture views = {};
+	FrameGraphResource backBuffer = graph.ImportTexture("BackBuffer", ColorDesc, views);
+	FrameGraphResource unread = graph.CreateTexture("Unread", ColorDesc);
+	FrameGraphResource chained = graph.CreateTexture("Chained", ColorDesc);
+	FrameGraphResource chainedOutput = graph.CreateTexture("ChainedOutput", ColorDesc);
+	FrameGraphResource used = graph.CreateTexture("Used", ColorDesc);
+
+	unsigned int nothing = AddLoggedPass(graph, "a", log);			// Writes nothing
+	unsigned int unreadPass = AddLoggedPass(graph, "b", log);		// Writes what nothing reads
+	graph.Write(unreadPass, unread);
+	unsigned int chainStart = AddLoggedPass(graph, "c", log);		// Only read by a pass that's culled
+	graph.Write(chainStart, chained);
+	unsigned int chainEnd = AddLoggedPass(graph, "d", log);
+	graph.Read(chainEnd, chained);
+	graph.Write(chainEnd, chainedOutput);
+	unsigned int producer = AddLoggedPass(graph, "e", log);
+	graph.Write(producer, used);
+	unsigned int present = AddLoggedPass(graph, "f", log);			// Writes the imported back buffer
+	graph.Read(present, used);
+	graph.Write(present, backBuffer);
+	graph.Read(nothing, backBuffer);
+
+	CHECK(graph.Compile());
+	CHECK(graph.GetPassCount() == 6);
+	CHECK(graph.IsPassCulled(nothing));
+	CHECK(graph.IsPassCulled(unreadPass));
+	CHECK(graph.IsPassCulled(chainStart));
+	CHECK(graph.IsPassCulled(chainEnd));
+	CHECK(!graph.IsPassCulled(producer));
+	CHECK(!graph.IsPassCulled(present));
+
+	// Culled passes have no lifetimes, barriers or allocations
+	unsigned int first, last;
+	CHECK(!graph.GetLifetime(unread, first, last));
+	CHECK(!graph.GetLifetime(chained, first, last));
+	CHECK(graph.GetBarriers(chainEnd).empty());
+	CHECK(graph.GetAllocation(chainedOutput) == FrameGraph::NoAllocation);
+	CHECK(graph.GetAllocationCount() == 1);
+
+	graph.Execute(device.GetImmediateContext());
+	CHECK(log == "ef");
+}
+
+TEST(FrameGraphRejectsReadsWithoutWriters)
+{
+	NullRenderDevice device;
+	FrameGraph graph(&device);
+	std::string log;
+
+	// Read before it's written
+	FrameGraphResource texture = graph.CreateTexture("Texture", ColorDesc);
+	unsigned int reader = AddLoggedPass(graph, "a", log);
+	graph.Read(reader, texture);
+	unsigned int writer = AddLoggedPass(graph, "b", log);
+	graph.Write(writer, texture);
+	CHECK(!graph.Compile());
+
+	// Never written at all
+	graph.Reset();
+	texture = graph.CreateTexture("Texture", ColorDesc);
+	reader = AddLoggedPass(graph, "a", log);
+	graph.Read(reader, texture);
+	CHECK(!graph.Compile());
+
+	// Imported textures need no writer
+	graph.Reset();
+	RenderTexture views = {};
+	FrameGraphResource imported = graph.ImportTexture("Imported", ColorDesc, views);
+	FrameGraphResource backBuffer = graph.ImportTexture("BackBuffer", ColorDesc, views);
+	reader = AddLoggedPass(graph, "a", log);
+	graph.Read(reader, imported);
+	graph.Write(reader, backBuffer);
+	CHECK(graph.Compile());
+}
+
+TEST(FrameGraphOrdersBarriers)
+{
+	NullRenderDevice device;
+	FrameGraph graph(&device);
+	std::string log;
+
+	RenderTexture views = {};
+	FrameGraphResource backBuffer = graph.ImportTexture("BackBuffer", ColorDesc, views);
+	FrameGraphResource color = graph.CreateTexture("Color", ColorDesc);
+	FrameGraphResource depth = graph.CreateTexture("Depth", DepthDesc);
+
+	unsigned int scene = AddLoggedPass(graph, "scene", log);
+	graph.Write(scene, color);
+	graph.Write(scene, depth);
+	unsigned int post = AddLoggedPass(graph, "post", log);
+	graph.Read(post, depth);
+	graph.Read(post, color);
+	graph.Write(post, backBuffer);
+	unsigned int overlay = AddLoggedPass(graph, "overlay", log);
+	graph.Read(overlay, color);
+	graph.Write(overlay, backBuffer);
+	CHECK(graph.Compile());
+
+	// Writes in the order declared, depth textures as depth writes
+	const std::vector<FrameGraphBarrier>& sceneBarriers = graph.GetBarriers(scene);
+	CHECK(sceneBarriers.size() == 2);
+	CHECK(IsBarrier(sceneBarriers[0], color, FRAME_GRAPH_ACCESS_NONE, FRAME_GRAPH_ACCESS_RENDER_TARGET));
+	CHECK(IsBarrier(sceneBarriers[1], depth, FRAME_GRAPH_ACCESS_NONE, FRAME_GRAPH_ACCESS_DEPTH_WRITE));
+
+	// Reads, in the order declared, come before writes
+	const std::vector<FrameGraphBarrier>& postBarriers = graph.GetBarriers(post);
+	CHECK(postBarriers.size() == 3);
+	CHECK(IsBarrier(postBarriers[0], depth, FRAME_GRAPH_ACCESS_DEPTH_WRITE, FRAME_GRAPH_ACCESS_SHADER_READ));
+	CHECK(IsBarrier(postBarriers[1], color, FRAME_GRAPH_ACCESS_RENDER_TARGET, FRAME_GRAPH_ACCESS_SHADER_READ));
+	CHECK(IsBarrier(postBarriers[2], backBuffer, FRAME_GRAPH_ACCESS_NONE, FRAME_GRAPH_ACCESS_RENDER_TARGET));
+
+	// Nothing changed use, so nothing's needed
+	CHECK(graph.GetBarriers(overlay).empty());
+
+	unsigned int first, last;
+	CHECK(graph.GetLifetime(color, first, last) && first == scene && last == overlay);
+	CHECK(graph.GetLifetime(depth, first, last) && first == scene && last == post);
+}
+
+// --------------------------------------------------------
+// A chain where each pass reads what the one before wrote:
+// the first and third textures are never alive together, so
+// they share, while the second overlaps both
+// --------------------------------------------------------
+TEST(FrameGraphAliasesTransients)
+{
+	NullRenderDevice device;
+	FrameGraph graph(&device);
+	std::string log;
+
+	RenderTexture views = {};
+	FrameGraphResource backBuffer = graph.ImportTexture("BackBuffer", ColorDesc, views);
+	FrameGraphResource a = graph.CreateTexture("A", ColorDesc);
+	FrameGraphResource b = graph.CreateTexture("B", ColorDesc);
+	FrameGraphResource c = graph.CreateTexture("C", ColorDesc);
+
+	unsigned int passA = AddLoggedPass(graph, "a", log);
+	graph.Write(passA, a);
+	unsigned int passB = AddLoggedPass(graph, "b", log);
+	graph.Read(passB, a);
+	graph.Write(passB, b);
+	unsigned int passC = AddLoggedPass(graph, "c", log);
+	graph.Read(passC, b);
+	graph.Write(passC, c);
+	unsigned int passD = AddLoggedPass(graph, "d", log);
+	graph.Read(passD, c);
+	graph.Write(passD, backBuffer);
+	CHECK(graph.Compile());
+
+	CHECK(graph.GetAllocationCount() == 2);
+	CHECK(graph.GetAllocation(a) == graph.GetAllocation(c));
+	CHECK(graph.GetAllocation(a) != graph.GetAllocation(b));
+	CHECK(graph.GetAllocation(backBuffer) == FrameGraph::NoAllocation);
+
+	// Two textures are alive during passes b and c, never three
+	CHECK(FrameGraph::GetTextureBytes(ColorDesc) == ColorBytes);
+	CHECK(graph.GetUnaliasedTransientBytes() == 3 * ColorBytes);
+	CHECK(graph.GetTransientBytes() == 2 * ColorBytes);
+	CHECK(graph.GetPeakLiveTransientBytes() == 2 * ColorBytes);
+
+	// Executing makes one real texture per allocation, with aliased
+	// resources seeing the same views
+	graph.Execute(device.GetImmediateContext());
+	CHECK(log == "abcd");
+	CHECK(graph.GetPooledTextureCount() == 2);
+	CHECK(graph.GetRenderTargetView(a) != 0);
+	CHECK(graph.GetRenderTargetView(a) == graph.GetRenderTargetView(c));
+	CHECK(graph.GetRenderTargetView(a) != graph.GetRenderTargetView(b));
+	CHECK(graph.GetShaderResourceView(b) != 0);
+}
+
+TEST(FrameGraphKeepsOverlappingTransientsApart)
+{
+	NullRenderDevice device;
+	FrameGraph graph(&device);
+	std::string log;
+
+	// Both read by the last pass, so alive at once.  A texture of a
+	// different shape never shares, even once the others are done.
+	RenderTexture views = {};
+	RenderTextureDesc halfDesc = ColorDesc;
+	halfDesc.Width /= 2;
+	FrameGraphResource backBuffer = graph.ImportTexture("BackBuffer", ColorDesc, views);
+	FrameGraphResource a = graph.CreateTexture("A", ColorDesc);
+	FrameGraphResource b = graph.CreateTexture("B", ColorDesc);
+	FrameGraphResource half = graph.CreateTexture("Half", halfDesc);
+
+	unsigned int passA = AddLoggedPass(graph, "a", log);
+	graph.Write(passA, a);
+	unsigned int passB = AddLoggedPass(graph, "b", log);
+	graph.Write(passB, b);
+	unsigned int combine = AddLoggedPass(graph, "combine", log);
+	graph.Read(combine, a);
+	graph.Read(combine, b);
+	graph.Write(combine, half);
+	unsigned int present = AddLoggedPass(graph, "present", log);
+	graph.Read(present, half);
+	graph.Write(present, backBuffer);
+	CHECK(graph.Compile());
+
+	CHECK(graph.GetAllocationCount() == 3);
+	CHECK(graph.GetAllocation(a) != graph.GetAllocation(b));
+	CHECK(graph.GetAllocation(half) != graph.GetAllocation(a));
+	CHECK(graph.GetTransientBytes() == graph.GetUnaliasedTransientBytes());
+	CHECK(graph.GetTransientBytes() == 2 * ColorBytes + ColorBytes / 2);
+
+	// a, b and half are all alive during the combine pass
+	CHECK(graph.GetPeakLiveTransientBytes() == 2 * ColorBytes + ColorBytes / 2);
+}
+
+TEST(FrameGraphPoolsTexturesAcrossFrames)
+{
+	NullRenderDevice device;
+	{
+		FrameGraph graph(&device);
+		std::string log;
+		RenderTexture views = {};
+		for (unsigned int frame = 0; frame < 3; frame++)
+		{
+			graph.Reset();
+			FrameGraphResource backBuffer = graph.ImportTexture("BackBuffer", ColorDesc, views);
+			FrameGraphResource depth = graph.CreateTexture("Depth", DepthDesc);
+			unsigned int scene = AddLoggedPass(graph, "scene", log);
+			graph.Write(scene, backBuffer);
+			graph.Write(scene, depth);
+			CHECK(graph.Compile());
+			graph.Execute(device.GetImmediateContext());
+			CHECK(graph.GetDepthStencilView(depth) != 0);
+		}
+		CHECK(graph.GetPooledTextureCount() == 1);
+		CHECK(device.GetObjectsCreated(NullRenderDevice::OBJECT_DEPTH_STENCIL_VIEW) == 1);
+
+		// Once nothing uses it for long enough, it's released
+		for (unsigned int frame = 0; frame <= FrameGraph::MaxIdleFrames; frame++)
+		{
+			graph.Reset();
+			CHECK(graph.Compile());
+			graph.Execute(device.GetImmediateContext());
+		}
+		CHECK(graph.GetPooledTextureCount() == 0);
+		CHECK(device.GetObjectsAlive(NullRenderDevice::OBJECT_DEPTH_STENCIL_VIEW) == 0);
+	}
+}
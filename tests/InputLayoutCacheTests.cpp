@@ -0,0 +1,145 @@
+#include "Test.h"
+#include "TestShaders.h"
+#include "InputLayoutCache.h"
+#include "SimpleShader.h"
+#include "NullRenderDevice.h"
+#include "D3D11Types.h"
+
+// The game's vertex format, and the same with the instanced extras
+static const InputElementDesc VertexElements[] =
+{
+	{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, false, 0 },
+	{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, false, 0 },
+	{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, false, 0 }
+};
+
+static const InputElementDesc InstancedElements[] =
+{
+	{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, false, 0 },
+	{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, false, 0 },
+	{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, false, 0 },
+	{ "TRANSFORM_PER_INSTANCE", 0, DXGI_FORMAT_R32_UINT, 1, 0, true, 1 }
+};
+
+TEST(InputLayoutCacheHashesEveryField)
+{
+	unsigned long long hash = InputLayoutCache::HashElements(VertexElements, 3);
+	CHECK(hash == InputLayoutCache::HashElements(VertexElements, 3));
+	CHECK(hash != InputLayoutCache::HashElements(VertexElements, 2));
+	CHECK(hash != InputLayoutCache::HashElements(InstancedElements, 4));
+
+	// The same hash from a copy with its own name strings
+	std::string names[3] = { "POSITION", "NORMAL", "TEXCOORD" };
+	InputElementDesc copy[3];
+	for (int i = 0; i < 3; i++)
+	{
+		copy[i] = VertexElements[i];
+		copy[i].SemanticName = names[i].c_str();
+	}
+	CHECK(InputLayoutCache::HashElements(copy, 3) == hash);
+
+	// Changing any one field changes it
+	InputElementDesc changed[3];
+	for (int field = 0; field < 7; field++)
+	{
+		for (int i = 0; i < 3; i++)
+			changed[i] = VertexElements[i];
+		switch (field)
+		{
+		case 0: changed[1].SemanticName = "BINORMAL"; break;
+		case 1: changed[1].SemanticIndex = 1; break;
+		case 2: changed[1].Format = DXGI_FORMAT_R32G32B32A32_FLOAT; break;
+		case 3: changed[1].InputSlot = 1; break;
+		case 4: changed[1].AlignedByteOffset = 16; break;
+		case 5: changed[1].PerInstance = true; break;
+		case 6: changed[1].InstanceDataStepRate = 1; break;
+		}
+		CHECK(InputLayoutCache::HashElements(changed, 3) != hash);
+	}
+
+	// Where one name ends and the next starts matters
+	InputElementDesc ab[2] = { VertexElements[0], VertexElements[0] };
+	InputElementDesc bc[2] = { VertexElements[0], VertexElements[0] };
+	ab[0].SemanticName = "AB";
+	ab[1].SemanticName = "C";
+	bc[0].SemanticName = "A";
+	bc[1].SemanticName = "BC";
+	CHECK(InputLayoutCache::HashElements(ab, 2) != InputLayoutCache::HashElements(bc, 2));
+
+	// And the order of the elements
+	InputElementDesc swapped[3] = { VertexElements[1], VertexElements[0], VertexElements[2] };
+	CHECK(InputLayoutCache::HashElements(swapped, 3) != hash);
+}
+
+TEST(InputLayoutCacheSharesMatchingLayouts)
+{
+	NullRenderDevice device;
+	InputLayoutCache cache(&device);
+	const char byteCode[] = "byte code";
+
+	ID3D11InputLayout* first = cache.Acquire(VertexElements, 3, byteCode, sizeof(byteCode));
+	ID3D11InputLayout* second = cache.Acquire(VertexElements, 3, byteCode, sizeof(byteCode));
+	ID3D11InputLayout* instanced = cache.Acquire(InstancedElements, 4, byteCode, sizeof(byteCode));
+	CHECK(first != 0 && first == second);
+	CHECK(instanced != 0 && instanced != first);
+	CHECK(cache.GetLayoutCount() == 2);
+	CHECK(device.GetObjectsCreated(NullRenderDevice::OBJECT_INPUT_LAYOUT) == 2);
+	CHECK(cache.GetLookups() == 3 && cache.GetHits() == 1);
+	CHECK(cache.GetHash(first) == InputLayoutCache::HashElements(VertexElements, 3));
+
+	// Released when the last user lets it go, and made again if asked for after
+	CHECK(cache.Release(first));
+	CHECK(device.GetObjectsAlive(NullRenderDevice::OBJECT_INPUT_LAYOUT) == 2);
+	CHECK(cache.Release(second));
+	CHECK(device.GetObjectsAlive(NullRenderDevice::OBJECT_INPUT_LAYOUT) == 1);
+	CHECK(cache.GetLayoutCount() == 1);
+	CHECK(cache.GetHash(first) == 0);
+	CHECK(!cache.Release(first));
+	ID3D11InputLayout* again = cache.Acquire(VertexElements, 3, byteCode, sizeof(byteCode));
+	CHECK(again != 0);
+	CHECK(device.GetObjectsCreated(NullRenderDevice::OBJECT_INPUT_LAYOUT) == 3);
+
+	cache.ResetStats();
+	CHECK(cache.GetLookups() == 0 && cache.GetHitRate() == 0.0f);
+}
+
+// --------------------------------------------------------
+// Vertex shaders with the same inputs end up with the same
+// layout, and give it back to the cache when they're deleted
+// --------------------------------------------------------
+TEST(InputLayoutCacheSharedBetweenShaders)
+{
+	CHECK(WriteTestShaders());
+	NullRenderDevice device;
+	{
+		InputLayoutCache cache(&device);
+		SimpleVertexShader::SetInputLayoutCache(&cache);
+
+		SimpleVertexShader* a = new SimpleVertexShader(&device);
+		SimpleVertexShader* b = new SimpleVertexShader(&device);
+		SimpleVertexShader* instanced = new SimpleVertexShader(&device);
+		CHECK(a->LoadShaderFile(TEST_VERTEX_SHADER));
+		CHECK(b->LoadShaderFile(TEST_VERTEX_SHADER));
+		CHECK(instanced->LoadShaderFile(TEST_INSTANCED_VERTEX_SHADER));
+		CHECK(a->GetInputLayout() != 0);
+		CHECK(a->GetInputLayout() == b->GetInputLayout());
+		CHECK(instanced->GetInputLayout() != a->GetInputLayout());
+		CHECK(cache.GetLayoutCount() == 2);
+
+		delete a;
+		CHECK(cache.GetLayoutCount() == 2);
+		delete b;
+		delete instanced;
+		CHECK(cache.GetLayoutCount() == 0);
+		CHECK(device.GetObjectsAlive(NullRenderDevice::OBJECT_INPUT_LAYOUT) == 0);
+
+		SimpleVertexShader::SetInputLayoutCache(0);
+	}
+
+	// Without a cache, each shader makes its own
+	SimpleVertexShader a(&device);
+	SimpleVertexShader b(&device);
+	CHECK(a.LoadShaderFile(TEST_VERTEX_SHADER));
+	CHECK(b.LoadShaderFile(TEST_VERTEX_SHADER));
+	CHECK(a.GetInputLayout() != b.GetInputLayout());
+}
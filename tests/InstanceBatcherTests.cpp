@@ -0,0 +1,159 @@
+#include "Test.h"
+#include "InstanceBatcher.h"
+#include "RenderQueue.h"
+
+#include <cstddef>
+
+// The group key the game uses: material batch above mesh
+static unsigned long long GroupKey(unsigned int material, unsigned int mesh)
+{
+	return ((unsigned long long)material << 32) | mesh;
+}
+
+static bool IsBatch(const InstanceBatch& batch, unsigned int firstPacket, unsigned int count)
+{
+	return batch.FirstPacket == firstPacket && batch.Count == count;
+}
+
+TEST(InstanceBatcherGroupsByMeshAndMaterial)
+{
+	// Entities 0-5: two meshes with material 1, and mesh 1 with material 2
+	std::vector<unsigned long long> groupKeys =
+	{
+		GroupKey(1, 1), GroupKey(1, 2), GroupKey(1, 1), GroupKey(2, 1), GroupKey(1, 2), GroupKey(1, 1)
+	};
+
+	RenderQueue queue;
+	for (unsigned int i = 0; i < 6; i++)
+		queue.Submit(RENDER_PASS_OPAQUE, 1, (unsigned int)(groupKeys[i] >> 32), (unsigned int)groupKeys[i], 1.0f + i, i);
+	queue.Sort();
+	const std::vector<DrawPacket>& packets = queue.GetPackets();
+
+	// Sorting brings each mesh and material together, so each is one batch
+	InstanceBatcher batcher;
+	batcher.Build(packets, groupKeys);
+	const std::vector<InstanceBatch>& batches = batcher.GetBatches();
+	CHECK(batches.size() == 3);
+	if (batches.size() == 3)
+	{
+		CHECK(IsBatch(batches[0], 0, 3));
+		CHECK(IsBatch(batches[1], 3, 2));
+		CHECK(IsBatch(batches[2], 5, 1));
+	}
+	CHECK(batcher.GetLargestBatch() == 3);
+
+	// Every packet in a batch has the batch's key
+	for (size_t b = 0; b < batches.size(); b++)
+	{
+		unsigned long long key = groupKeys[packets[batches[b].FirstPacket].EntityIndex];
+		for (unsigned int p = batches[b].FirstPacket; p < batches[b].FirstPacket + batches[b].Count; p++)
+			CHECK(groupKeys[packets[p].EntityIndex] == key);
+	}
+
+	// Nothing to draw is no batches
+	batcher.Build(std::vector<DrawPacket>(), groupKeys);
+	CHECK(batcher.GetBatches().empty() && batcher.GetLargestBatch() == 0);
+}
+
+TEST(InstanceBatcherSplitsAtMaxInstances)
+{
+	std::vector<unsigned long long> groupKeys(7, GroupKey(1, 1));
+	std::vector<DrawPacket> packets(7);
+	for (unsigned int i = 0; i < 7; i++)
+	{
+		packets[i].Key = 0;
+		packets[i].EntityIndex = i;
+	}
+
+	InstanceBatcher batcher;
+	batcher.SetMaxInstances(3);
+	batcher.Build(packets, groupKeys);
+	const std::vector<InstanceBatch>& batches = batcher.GetBatches();
+	CHECK(batches.size() == 3);
+	if (batches.size() == 3)
+	{
+		CHECK(IsBatch(batches[0], 0, 3));
+		CHECK(IsBatch(batches[1], 3, 3));
+		CHECK(IsBatch(batches[2], 6, 1));
+	}
+	CHECK(batcher.GetLargestBatch() == 3);
+
+	// Exactly full is still one batch, and 0 is no limit
+	batcher.SetMaxInstances(7);
+	batcher.Build(packets, groupKeys);
+	CHECK(batches.size() == 1 && IsBatch(batches[0], 0, 7));
+	batcher.SetMaxInstances(0);
+	batcher.Build(packets, groupKeys);
+	CHECK(batches.size() == 1);
+}
+
+// --------------------------------------------------------
+// Transparent draws sort back to front, and only neighbours
+// are merged, so two draws of one mesh with a different one
+// between them stay apart rather than being drawn together
+// --------------------------------------------------------
+TEST(InstanceBatcherKeepsTransparentOrder)
+{
+	// Entities 0 and 2 share a mesh, entity 1 is in front of 2 and behind 0
+	std::vector<unsigned long long> groupKeys = { GroupKey(1, 1), GroupKey(1, 2), GroupKey(1, 1), GroupKey(1, 1) };
+	float depths[] = { 50.0f, 30.0f, 10.0f, 9.0f };
+
+	RenderQueue queue;
+	for (unsigned int i = 0; i < 4; i++)
+		queue.Submit(RENDER_PASS_TRANSPARENT, 1, 1, (unsigned int)groupKeys[i], depths[i], i);
+	queue.Sort();
+	const std::vector<DrawPacket>& packets = queue.GetPackets();
+	CHECK(packets.size() == 4);
+	for (unsigned int i = 0; i < packets.size(); i++)
+		CHECK(packets[i].EntityIndex == i);
+
+	InstanceBatcher batcher;
+	batcher.Build(packets, groupKeys);
+	const std::vector<InstanceBatch>& batches = batcher.GetBatches();
+	CHECK(batches.size() == 3);
+	if (batches.size() == 3)
+	{
+		CHECK(IsBatch(batches[0], 0, 1));
+		CHECK(IsBatch(batches[1], 1, 1));
+		CHECK(IsBatch(batches[2], 2, 2));
+	}
+}
+
+TEST(InstanceBatcherWritesInstancesInPacketOrder)
+{
+	// Entities 0-4, each with its own texture slice
+	std::vector<unsigned long long> groupKeys = { GroupKey(1, 1), GroupKey(1, 2), GroupKey(1, 1), GroupKey(1, 2), GroupKey(1, 1) };
+	std::vector<unsigned int> textureSlices = { 10, 11, 12, 13, 14 };
+
+	RenderQueue queue;
+	for (unsigned int i = 0; i < 5; i++)
+		queue.Submit(RENDER_PASS_OPAQUE, 1, 1, (unsigned int)groupKeys[i], 1.0f + i, i);
+	queue.Sort();
+	const std::vector<DrawPacket>& packets = queue.GetPackets();
+
+	InstanceBatcher batcher;
+	batcher.Build(packets, groupKeys);
+	std::vector<InstanceData> instances(packets.size());
+	InstanceBatcher::WriteInstances(packets, textureSlices, &instances[0]);
+
+	// Each batch's instances start at its first packet: mesh 1's
+	// entities (0, 2, 4) then mesh 2's (1, 3)
+	const std::vector<InstanceBatch>& batches = batcher.GetBatches();
+	CHECK(batches.size() == 2);
+	unsigned int expected[] = { 0, 2, 4, 1, 3 };
+	for (unsigned int i = 0; i < 5; i++)
+	{
+		CHECK(instances[i].TransformIndex == expected[i]);
+		CHECK(instances[i].TextureSlice == 10 + expected[i]);
+	}
+	if (batches.size() == 2)
+	{
+		CHECK(IsBatch(batches[0], 0, 3));
+		CHECK(IsBatch(batches[1], 3, 2));
+		for (size_t b = 0; b < batches.size(); b++)
+		{
+			for (unsigned int p = batches[b].FirstPacket; p < batches[b].FirstPacket + batches[b].Count; p++)
+				CHECK(groupKeys[instances[p].TransformIndex] == groupKeys[instances[batches[b].FirstPacket].TransformIndex]);
+		}
+	}
+}
@@ -0,0 +1,48 @@
+#include "Test.h"
+#include "TestShaders.h"
+#include "MaterialRegistry.h"
+#include "NullRenderDevice.h"
+
+static MaterialDesc Desc(SimpleVertexShader* vertexShader, SimplePixelShader* pixelShader, unsigned int textureSlice)
+{
+	MaterialDesc desc = {};
+	desc.VertexShader = vertexShader;
+	desc.PixelShader = pixelShader;
+	desc.TextureSlice = textureSlice;
+	return desc;
+}
+
+// --------------------------------------------------------
+// Shader IDs belong to the registry, so each one numbers its
+// own shader pairs from 0 no matter what others have seen
+// --------------------------------------------------------
+TEST(MaterialRegistryGivesSharedShaderIDs)
+{
+	CHECK(WriteTestShaders());
+	NullRenderDevice device;
+	SimpleVertexShader vertexShader(&device);
+	SimplePixelShader pixelShader(&device);
+	SimplePixelShader otherPixelShader(&device);
+	CHECK(vertexShader.LoadShaderFile(TEST_VERTEX_SHADER));
+	CHECK(pixelShader.LoadShaderFile(TEST_PIXEL_SHADER));
+	CHECK(otherPixelShader.LoadShaderFile(TEST_PIXEL_SHADER));
+	PipelineStateCache pipelineStates(&device);
+
+	{
+		MaterialRegistry registry(&device, &pipelineStates);
+		MaterialID first = registry.Register(Desc(&vertexShader, &pixelShader, 0));
+		MaterialID slice = registry.Register(Desc(&vertexShader, &pixelShader, 1));
+		MaterialID other = registry.Register(Desc(&vertexShader, &otherPixelShader, 0));
+		CHECK(first != 0 && slice != 0 && other != 0);
+		CHECK(registry.Register(Desc(&vertexShader, &pixelShader, 1)) == slice);
+
+		CHECK(registry.GetMaterial(first)->GetShaderID() == 0);
+		CHECK(registry.GetMaterial(slice)->GetShaderID() == 0);
+		CHECK(registry.GetMaterial(other)->GetShaderID() == 1);
+		CHECK(registry.GetMaterial(slice)->GetBatchID() == first);
+	}
+
+	MaterialRegistry registry(&device, &pipelineStates);
+	MaterialID other = registry.Register(Desc(&vertexShader, &otherPixelShader, 0));
+	CHECK(other != 0 && registry.GetMaterial(other)->GetShaderID() == 0);
+}
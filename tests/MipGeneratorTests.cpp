@@ -0,0 +1,185 @@
+#include "Test.h"
+#include "MipGenerator.h"
+#include "TextureCooker.h"
+
+// --------------------------------------------------------
+// A noisy image, so every filter tap matters and any path
+// that rounds or orders its sums differently shows up
+// --------------------------------------------------------
+static TextureImage NoiseImage(unsigned int width, unsigned int height, unsigned int channels, unsigned int bitDepth)
+{
+	TextureImage image;
+	image.Width = width;
+	image.Height = height;
+	image.Channels = channels;
+	image.BitDepth = bitDepth;
+	image.Values.resize((size_t)width * height * channels);
+
+	unsigned int state = 12345;
+	for (size_t i = 0; i < image.Values.size(); i++)
+	{
+		state = state * 1664525u + 1013904223u;
+		image.Values[i] = (unsigned short)((state >> 8) % (image.MaxValue() + 1u));
+	}
+	return image;
+}
+
+static TextureImage SolidImage(unsigned int width, unsigned int height, unsigned short value)
+{
+	TextureImage image;
+	image.Width = width;
+	image.Height = height;
+	image.Channels = 4;
+	image.BitDepth = 8;
+	image.Values.assign((size_t)width * height * 4, value);
+	return image;
+}
+
+TEST(MipGeneratorMakesFullChains)
+{
+	CHECK(MipGenerator::GetMipCount(1, 1) == 1);
+	CHECK(MipGenerator::GetMipCount(256, 256) == 9);
+	CHECK(MipGenerator::GetMipCount(5, 3) == 3);
+	CHECK(MipGenerator::GetMipCount(1, 1000) == 10);
+
+	// Sizes that aren't powers of two halve rounding down, to 1x1
+	MipChainDesc desc = { MIP_FILTER_BOX, false, 1, MIP_INSTRUCTIONS_SCALAR };
+	std::vector<TextureImage> mips;
+	CHECK(MipGenerator::Generate(NoiseImage(37, 10, 2, 16), desc, mips));
+	CHECK(mips.size() == 6);
+	unsigned int widths[] = { 37, 18, 9, 4, 2, 1 };
+	unsigned int heights[] = { 10, 5, 2, 1, 1, 1 };
+	for (size_t m = 0; m < mips.size() && m < 6; m++)
+	{
+		CHECK(mips[m].Width == widths[m] && mips[m].Height == heights[m]);
+		CHECK(mips[m].Channels == 2 && mips[m].BitDepth == 16);
+		CHECK(mips[m].Values.size() == (size_t)widths[m] * heights[m] * 2);
+	}
+
+	// A flat color stays that color with every filter, sRGB or not
+	for (int filter = MIP_FILTER_BOX; filter <= MIP_FILTER_LANCZOS; filter++)
+	{
+		for (int srgb = 0; srgb < 2; srgb++)
+		{
+			MipChainDesc flat = { (MipFilter)filter, srgb != 0, 0, MIP_INSTRUCTIONS_AVX2 };
+			CHECK(MipGenerator::Generate(SolidImage(13, 7, 200), flat, mips));
+			for (size_t m = 0; m < mips.size(); m++)
+				CHECK(MipGenerator::Compare(std::vector<TextureImage>(1, mips[m]), std::vector<TextureImage>(1, SolidImage(mips[m].Width, mips[m].Height, 200))) == 0);
+		}
+	}
+}
+
+TEST(MipGeneratorFiltersSRGBInLinearSpace)
+{
+	// Black and white columns average to mid grey in linear light,
+	// which is 188 in sRGB, not 128.  Alpha is never sRGB.
+	TextureImage stripes = SolidImage(2, 1, 0);
+	for (unsigned int c = 0; c < 4; c++)
+		stripes.Values[4 + c] = 255;
+
+	std::vector<TextureImage> mips;
+	MipChainDesc desc = { MIP_FILTER_BOX, true, 1, MIP_INSTRUCTIONS_SCALAR };
+	CHECK(MipGenerator::Generate(stripes, desc, mips));
+	CHECK(mips.size() == 2);
+	CHECK(mips[1].Get(0, 0, 0) == 188 && mips[1].Get(0, 0, 2) == 188);
+	CHECK(mips[1].Get(0, 0, 3) == 128);
+
+	desc.SRGB = false;
+	CHECK(MipGenerator::Generate(stripes, desc, mips));
+	CHECK(mips[1].Get(0, 0, 0) == 128);
+}
+
+TEST(MipGeneratorRejectsBadImages)
+{
+	MipChainDesc desc = { MIP_FILTER_BOX, false, 1, MIP_INSTRUCTIONS_SCALAR };
+	std::vector<TextureImage> mips;
+	TextureImage image = NoiseImage(4, 4, 4, 8);
+	CHECK(MipGenerator::Generate(image, desc, mips));
+
+	TextureImage bad = image;
+	bad.Width = 0;
+	CHECK(!MipGenerator::Generate(bad, desc, mips));
+	bad = image;
+	bad.Channels = 5;
+	CHECK(!MipGenerator::Generate(bad, desc, mips));
+	bad = image;
+	bad.BitDepth = 12;
+	CHECK(!MipGenerator::Generate(bad, desc, mips));
+	bad = image;
+	bad.Values.pop_back();
+	CHECK(!MipGenerator::Generate(bad, desc, mips));
+
+	// Chains of different shapes can't be compared
+	std::vector<TextureImage> other;
+	CHECK(MipGenerator::Generate(NoiseImage(4, 2, 4, 8), desc, other));
+	CHECK(MipGenerator::Compare(mips, other) == -1);
+	other.pop_back();
+	CHECK(MipGenerator::Compare(mips, other) == -1);
+
+	MipFilter filter = MIP_FILTER_BOX;
+	CHECK(MipGenerator::ParseFilter("lanczos", filter) && filter == MIP_FILTER_LANCZOS);
+	CHECK(!MipGenerator::ParseFilter("bicubic", filter) && filter == MIP_FILTER_LANCZOS);
+}
+
+// --------------------------------------------------------
+// Every instruction set this CPU has, with any number of
+// threads, comes out the same as the scalar reference
+// --------------------------------------------------------
+TEST(MipGeneratorMatchesScalarReference)
+{
+	struct Case { unsigned int Width, Height, Channels, BitDepth; bool SRGB; };
+	Case cases[] =
+	{
+		{ 64, 64, 4, 8, true },		// Fits whole vectors
+		{ 67, 29, 3, 8, true },		// Rows that don't
+		{ 33, 70, 1, 16, false },	// Taller than wide
+		{ 1, 19, 2, 16, false }		// Only ever one column
+	};
+
+	std::vector<TextureImage> reference;
+	std::vector<TextureImage> mips;
+	for (unsigned int c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+	{
+		const Case& test = cases[c];
+		TextureImage image = NoiseImage(test.Width, test.Height, test.Channels, test.BitDepth);
+		for (int filter = MIP_FILTER_BOX; filter <= MIP_FILTER_LANCZOS; filter++)
+		{
+			MipChainDesc desc = { (MipFilter)filter, test.SRGB, 1, MIP_INSTRUCTIONS_SCALAR };
+			CHECK(MipGenerator::Generate(image, desc, reference));
+
+			for (int instructionSet = MIP_INSTRUCTIONS_SCALAR; instructionSet <= MipGenerator::GetSupportedInstructionSet(); instructionSet++)
+			{
+				for (unsigned int threads = 1; threads <= 5; threads += 2)
+				{
+					desc.InstructionSet = (MipInstructionSet)instructionSet;
+					desc.ThreadCount = threads;
+					CHECK(MipGenerator::Generate(image, desc, mips));
+					CHECK(MipGenerator::Compare(mips, reference) == 0);
+				}
+			}
+		}
+	}
+}
+
+// The same for the textures the game actually cooks
+TEST(MipGeneratorMatchesScalarReferenceOnCookedTextures)
+{
+	std::vector<PackedTextureDesc> textures;
+	unsigned int errorLine = 0;
+	CHECK(TextureCooker::LoadManifest(GetRepositoryPath("DX11Starter/resources/textures/CliffLayered.manifest"), textures, errorLine));
+
+	for (size_t t = 0; t < textures.size(); t++)
+	{
+		MipChainDesc desc = TextureCooker::GetMipChainDesc(textures[t]);
+		desc.InstructionSet = MipGenerator::GetSupportedInstructionSet();
+		PackedTextureInfo info;
+		std::vector<TextureImage> mips;
+		CHECK(TextureCooker::CookMips(textures[t], desc, mips, info));
+		CHECK(mips.size() > 1);
+
+		std::vector<TextureImage> reference;
+		desc.InstructionSet = MIP_INSTRUCTIONS_SCALAR;
+		CHECK(!mips.empty() && MipGenerator::Generate(mips[0], desc, reference));
+		CHECK(MipGenerator::Compare(mips, reference) == 0);
+	}
+}
@@ -0,0 +1,206 @@
+#include "Test.h"
+#include "RecordingContext.h"
+#include "PipelineState.h"
+#include "NullRenderDevice.h"
+
+// Stand-ins for the shaders and layouts, which the cache only refers to
+template<typename T>
+static T* Fake(unsigned int n)
+{
+	return (T*)(size_t)(0x1000 + n * 0x10);
+}
+
+static const unsigned int AllSubStates = (1 << PipelineState::SUB_STATE_COUNT) - 1;
+
+static unsigned int Bit(PipelineState::SubState subState)
+{
+	return 1u << subState;
+}
+
+// Opaque, back face culled, depth tested triangles
+static PipelineStateDesc OpaqueDesc()
+{
+	PipelineStateDesc desc = {};
+	desc.VertexShader = Fake<ID3D11VertexShader>(1);
+	desc.PixelShader = Fake<ID3D11PixelShader>(1);
+	desc.InputLayout = Fake<ID3D11InputLayout>(1);
+	desc.Topology = 4;
+	return desc;
+}
+
+TEST(PipelineStateCacheSharesEqualStates)
+{
+	NullRenderDevice device;
+	PipelineStateCache cache(&device);
+
+	// Asked for twice, made once, and the same object both times
+	const PipelineState* opaque = cache.GetPipelineState(OpaqueDesc());
+	CHECK(opaque != 0);
+	CHECK(cache.GetPipelineState(OpaqueDesc()) == opaque);
+	CHECK(cache.GetPipelineStateCount() == 1);
+	CHECK(cache.GetStateObjectCount() == 3);
+	CHECK(opaque->GetHash() == PipelineStateCache::Hash(OpaqueDesc()));
+
+	// A different blend is a different state, with the other parts shared
+	PipelineStateDesc transparentDesc = OpaqueDesc();
+	transparentDesc.Blend.Mode = BLEND_ALPHA;
+	transparentDesc.DepthStencil.DepthWriteDisable = true;
+	const PipelineState* transparent = cache.GetPipelineState(transparentDesc);
+	CHECK(transparent != opaque);
+	CHECK(transparent->GetRasterizerState() == opaque->GetRasterizerState());
+	CHECK(transparent->GetBlendState() != opaque->GetBlendState());
+	CHECK(transparent->GetDepthStencilState() != opaque->GetDepthStencilState());
+	CHECK(cache.GetPipelineStateCount() == 2);
+	CHECK(cache.GetStateObjectCount() == 5);
+	CHECK(device.GetObjectsCreated(NullRenderDevice::OBJECT_RASTERIZER_STATE) == 1);
+	CHECK(device.GetObjectsCreated(NullRenderDevice::OBJECT_BLEND_STATE) == 2);
+
+	// State objects asked for on their own are the same ones too
+	CHECK(cache.GetBlendState(transparentDesc.Blend) == transparent->GetBlendState());
+	CHECK(cache.GetRasterizerState(RasterizerDesc()) == opaque->GetRasterizerState());
+	SamplerDesc sampler = { SAMPLER_FILTER_ANISOTROPIC, SAMPLER_ADDRESS_WRAP, 16 };
+	ID3D11SamplerState* anisotropic = cache.GetSamplerState(sampler);
+	CHECK(anisotropic != 0 && cache.GetSamplerState(sampler) == anisotropic);
+	sampler.MaxAnisotropy = 8;
+	CHECK(cache.GetSamplerState(sampler) != anisotropic);
+	CHECK(cache.GetStateObjectCount() == 7);
+
+	// Lookups include the parts each new pipeline state asked for
+	CHECK(cache.GetHits() > 0 && cache.GetLookups() > cache.GetHits());
+
+	// Nothing is released while the cache is alive
+	CHECK(device.GetObjectsAlive(NullRenderDevice::OBJECT_BLEND_STATE) == 2);
+}
+
+TEST(PipelineStateCacheReleasesEverything)
+{
+	NullRenderDevice device;
+	{
+		PipelineStateCache cache(&device);
+		PipelineStateDesc desc = OpaqueDesc();
+		cache.GetPipelineState(desc);
+		desc.Rasterizer.CullMode = RASTERIZER_CULL_NONE;
+		cache.GetPipelineState(desc);
+		SamplerDesc sampler = { SAMPLER_FILTER_LINEAR, SAMPLER_ADDRESS_CLAMP, 1 };
+		cache.GetSamplerState(sampler);
+	}
+	CHECK(device.GetObjectsAlive(NullRenderDevice::OBJECT_RASTERIZER_STATE) == 0);
+	CHECK(device.GetObjectsAlive(NullRenderDevice::OBJECT_BLEND_STATE) == 0);
+	CHECK(device.GetObjectsAlive(NullRenderDevice::OBJECT_DEPTH_STENCIL_STATE) == 0);
+	CHECK(device.GetObjectsAlive(NullRenderDevice::OBJECT_SAMPLER_STATE) == 0);
+}
+
+TEST(PipelineStateHashesEveryField)
+{
+	PipelineStateDesc base = OpaqueDesc();
+	unsigned long long hash = PipelineStateCache::Hash(base);
+	CHECK(PipelineStateCache::Equal(base, OpaqueDesc()));
+
+	for (int field = 0; field < 14; field++)
+	{
+		PipelineStateDesc changed = base;
+		switch (field)
+		{
+		case 0: changed.VertexShader = Fake<ID3D11VertexShader>(2); break;
+		case 1: changed.PixelShader = Fake<ID3D11PixelShader>(2); break;
+		case 2: changed.InputLayout = Fake<ID3D11InputLayout>(2); break;
+		case 3: changed.Topology = 5; break;
+		case 4: changed.Rasterizer.FillMode = RASTERIZER_FILL_WIREFRAME; break;
+		case 5: changed.Rasterizer.CullMode = RASTERIZER_CULL_FRONT; break;
+		case 6: changed.Rasterizer.FrontCounterClockwise = true; break;
+		case 7: changed.Rasterizer.DepthBias = -1; break;
+		case 8: changed.Rasterizer.DepthClipDisable = true; break;
+		case 9: changed.Rasterizer.ScissorEnable = true; break;
+		case 10: changed.Blend.Mode = BLEND_ADDITIVE; break;
+		case 11: changed.Blend.AlphaToCoverage = true; break;
+		case 12: changed.DepthStencil.DepthDisable = true; break;
+		case 13: changed.DepthStencil.Func = DEPTH_FUNC_LESS_EQUAL; break;
+		}
+		CHECK(PipelineStateCache::Hash(changed) != hash);
+		CHECK(!PipelineStateCache::Equal(changed, base));
+	}
+
+	SamplerDesc point = { SAMPLER_FILTER_POINT, SAMPLER_ADDRESS_WRAP, 1 };
+	SamplerDesc clamped = { SAMPLER_FILTER_POINT, SAMPLER_ADDRESS_CLAMP, 1 };
+	CHECK(PipelineStateCache::Hash(point) != PipelineStateCache::Hash(clamped));
+	CHECK(!PipelineStateCache::Equal(point, clamped));
+}
+
+TEST(PipelineStateDiffsSubStates)
+{
+	NullRenderDevice device;
+	PipelineStateCache cache(&device);
+	const PipelineState* opaque = cache.GetPipelineState(OpaqueDesc());
+
+	// Everything against nothing, nothing against itself
+	CHECK(opaque->Diff(0) == AllSubStates);
+	CHECK(opaque->Diff(opaque) == 0);
+
+	// Each part on its own gives its own bit
+	PipelineStateDesc desc = OpaqueDesc();
+	desc.PixelShader = Fake<ID3D11PixelShader>(2);
+	CHECK(cache.GetPipelineState(desc)->Diff(opaque) == Bit(PipelineState::SUB_STATE_PIXEL_SHADER));
+
+	desc = OpaqueDesc();
+	desc.Topology = 5;
+	CHECK(cache.GetPipelineState(desc)->Diff(opaque) == Bit(PipelineState::SUB_STATE_TOPOLOGY));
+
+	desc = OpaqueDesc();
+	desc.Rasterizer.CullMode = RASTERIZER_CULL_NONE;
+	CHECK(cache.GetPipelineState(desc)->Diff(opaque) == Bit(PipelineState::SUB_STATE_RASTERIZER));
+
+	// Shaders and blend together, the same both ways round
+	desc = OpaqueDesc();
+	desc.VertexShader = Fake<ID3D11VertexShader>(2);
+	desc.InputLayout = Fake<ID3D11InputLayout>(2);
+	desc.Blend.Mode = BLEND_PREMULTIPLIED;
+	const PipelineState* other = cache.GetPipelineState(desc);
+	unsigned int expected =
+		Bit(PipelineState::SUB_STATE_VERTEX_SHADER) |
+		Bit(PipelineState::SUB_STATE_INPUT_LAYOUT) |
+		Bit(PipelineState::SUB_STATE_BLEND);
+	CHECK(other->Diff(opaque) == expected);
+	CHECK(opaque->Diff(other) == expected);
+
+	// Two states that differ but share a state object don't set it again
+	PipelineStateDesc a = OpaqueDesc();
+	PipelineStateDesc b = OpaqueDesc();
+	a.DepthStencil.Func = DEPTH_FUNC_GREATER;
+	b.DepthStencil.Func = DEPTH_FUNC_GREATER;
+	b.PixelShader = Fake<ID3D11PixelShader>(3);
+	CHECK(cache.GetPipelineState(b)->Diff(cache.GetPipelineState(a)) == Bit(PipelineState::SUB_STATE_PIXEL_SHADER));
+}
+
+TEST(PipelineStateBindsOnlyWhatChanged)
+{
+	NullRenderDevice device;
+	NullRenderContext null;
+	RecordingContext recorder(&null);
+	PipelineStateCache cache(&device);
+	const PipelineState* opaque = cache.GetPipelineState(OpaqueDesc());
+
+	// From nothing, everything is set, in order
+	CHECK(opaque->Bind(&recorder, 0) == AllSubStates);
+	const char* order[] = { "VSSetShader", "PSSetShader", "IASetInputLayout", "IASetPrimitiveTopology", "RSSetState", "OMSetBlendState", "OMSetDepthStencilState" };
+	CHECK(recorder.Calls.size() == 7);
+	for (size_t i = 0; i < recorder.Calls.size() && i < 7; i++)
+		CHECK(strcmp(recorder.Calls[i].Name, order[i]) == 0);
+	CHECK(recorder.Last("RSSetState")->Objects[0] == opaque->GetRasterizerState());
+	CHECK(recorder.Last("IASetPrimitiveTopology")->StartSlot == 4);
+
+	// Again, nothing
+	recorder.Clear();
+	CHECK(opaque->Bind(&recorder, opaque) == 0);
+	CHECK(recorder.Calls.empty());
+
+	// Only the blend and depth stencil states
+	PipelineStateDesc transparentDesc = OpaqueDesc();
+	transparentDesc.Blend.Mode = BLEND_ALPHA;
+	transparentDesc.DepthStencil.DepthWriteDisable = true;
+	const PipelineState* transparent = cache.GetPipelineState(transparentDesc);
+	recorder.Clear();
+	CHECK(transparent->Bind(&recorder, opaque) == (Bit(PipelineState::SUB_STATE_BLEND) | Bit(PipelineState::SUB_STATE_DEPTH_STENCIL)));
+	CHECK(recorder.Calls.size() == 2);
+	CHECK(recorder.Last("OMSetBlendState")->Objects[0] == transparent->GetBlendState());
+	CHECK(recorder.Last("OMSetDepthStencilState")->Objects[0] == transparent->GetDepthStencilState());
+}
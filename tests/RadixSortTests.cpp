@@ -0,0 +1,137 @@
+#include "Test.h"
+#include "RadixSort.h"
+#include "RenderQueue.h"
+
+#include <algorithm>
+
+// Packets with the given keys, each indexed by where it started
+static std::vector<DrawPacket> Packets(const std::vector<unsigned long long>& keys)
+{
+	std::vector<DrawPacket> packets(keys.size());
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		packets[i].Key = keys[i];
+		packets[i].EntityIndex = (unsigned int)i;
+	}
+	return packets;
+}
+
+// Few distinct values, so there are plenty of ties to keep in order
+static std::vector<unsigned long long> RandomKeys(size_t count, unsigned long long mask)
+{
+	std::vector<unsigned long long> keys(count);
+	unsigned long long state = 88172645463325252ull;
+	for (size_t i = 0; i < count; i++)
+	{
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		keys[i] = state & mask;
+	}
+	return keys;
+}
+
+static bool SortedLikeStableSort(std::vector<DrawPacket> packets, unsigned int threadCount)
+{
+	std::vector<DrawPacket> expected = packets;
+	std::stable_sort(expected.begin(), expected.end(),
+		[](const DrawPacket& a, const DrawPacket& b) { return a.Key < b.Key; });
+
+	std::vector<DrawPacket> scratch;
+	RadixSortPackets(packets, scratch, threadCount);
+	if (packets.size() != expected.size())
+		return false;
+	for (size_t i = 0; i < packets.size(); i++)
+	{
+		if (packets[i].Key != expected[i].Key || packets[i].EntityIndex != expected[i].EntityIndex)
+			return false;
+	}
+	return true;
+}
+
+TEST(RadixSortHandlesTinyInputs)
+{
+	std::vector<DrawPacket> packets;
+	std::vector<DrawPacket> scratch;
+	RadixSortPackets(packets, scratch, 4);
+	CHECK(packets.empty());
+
+	packets = Packets(std::vector<unsigned long long>(1, 0xDEADBEEFull));
+	RadixSortPackets(packets, scratch, 4);
+	CHECK(packets.size() == 1 && packets[0].Key == 0xDEADBEEFull && packets[0].EntityIndex == 0);
+
+	packets = Packets({ 2, 1 });
+	RadixSortPackets(packets, scratch, 4);
+	CHECK(packets[0].EntityIndex == 1 && packets[1].EntityIndex == 0);
+}
+
+TEST(RadixSortOrdersByHighByte)
+{
+	// Only the top byte differs, so every other pass is skipped and
+	// one pass leaves the result in the scratch buffer first
+	std::vector<unsigned long long> keys;
+	for (unsigned long long top = 0; top < 256; top++)
+		keys.push_back(((top * 167) % 256) << 56 | 0x123456);
+	std::vector<DrawPacket> packets = Packets(keys);
+	std::vector<DrawPacket> scratch;
+	RadixSortPackets(packets, scratch, 1);
+	CHECK(packets.size() == 256);
+	for (size_t i = 0; i < packets.size(); i++)
+		CHECK(packets[i].Key == ((unsigned long long)i << 56 | 0x123456));
+
+	// The top and bottom bytes together
+	CHECK(SortedLikeStableSort(Packets(RandomKeys(5000, 0xFF000000000000FFull)), 1));
+}
+
+TEST(RadixSortKeepsEqualKeysInOrder)
+{
+	std::vector<DrawPacket> packets = Packets(std::vector<unsigned long long>(1000, 0x8000000000000001ull));
+	std::vector<DrawPacket> scratch;
+	RadixSortPackets(packets, scratch, 4);
+	for (size_t i = 0; i < packets.size(); i++)
+		CHECK(packets[i].EntityIndex == i);
+}
+
+// --------------------------------------------------------
+// Each thread needs 16384 packets, so these sizes go either
+// side of one, two and four threads' worth.  Every one has
+// to come out exactly as std::stable_sort would.
+// --------------------------------------------------------
+TEST(RadixSortMatchesStableSortAroundParallelThreshold)
+{
+	size_t sizes[] = { 16383, 16384, 16385, 32767, 32768, 32769, 65535, 65536, 65537 };
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+	{
+		std::vector<DrawPacket> packets = Packets(RandomKeys(sizes[s], 0xFF00F000000F00FFull));
+		CHECK(SortedLikeStableSort(packets, 1));
+		CHECK(SortedLikeStableSort(packets, 4));
+	}
+
+	// Keys using every bit
+	CHECK(SortedLikeStableSort(Packets(RandomKeys(70000, ~0ull)), 4));
+}
+
+TEST(RenderQueueSortsPassesAndDepth)
+{
+	RenderQueue queue;
+	queue.SetThreadCount(2);
+	queue.SetDepthRange(0.0f, 100.0f);
+
+	// Transparent first, far to near, and opaque interleaved
+	queue.Submit(RENDER_PASS_TRANSPARENT, 1, 1, 1, 10.0f, 0);
+	queue.Submit(RENDER_PASS_OPAQUE, 2, 1, 1, 50.0f, 1);
+	queue.Submit(RENDER_PASS_TRANSPARENT, 1, 1, 1, 90.0f, 2);
+	queue.Submit(RENDER_PASS_OPAQUE, 1, 1, 1, 80.0f, 3);
+	queue.Submit(RENDER_PASS_OPAQUE, 1, 1, 1, 20.0f, 4);
+	queue.Sort();
+
+	// Opaque grouped by shader then near to far, transparent far to near
+	const std::vector<DrawPacket>& packets = queue.GetPackets();
+	unsigned int expected[] = { 4, 3, 1, 2, 0 };
+	CHECK(packets.size() == 5);
+	for (size_t i = 0; i < packets.size() && i < 5; i++)
+		CHECK(packets[i].EntityIndex == expected[i]);
+	CHECK(queue.GetField(packets[2].Key, SORT_KEY_SHADER) == 2);
+	CHECK(queue.GetField(packets[3].Key, SORT_KEY_PASS) == RENDER_PASS_TRANSPARENT);
+	CHECK(queue.GetStateChangesSorted() == 3);
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <cstring>
+#include <vector>
+#include "RenderContext.h"
+
+// --------------------------------------------------------
+// A render context for tests that logs every call, with its
+// slots and the objects it set, then passes it on to another
+// context (normally the null device's), so buffers still get
+// written and mapped as they would be.
+// --------------------------------------------------------
+struct RecordedCall
+{
+	const char* Name;
+	unsigned int StartSlot;
+	unsigned int Count;
+	std::vector<const void*> Objects;
+	std::vector<unsigned int> FirstConstants;	// Only for the *SetConstantBuffers1 calls
+	std::vector<unsigned int> NumConstants;
+};
+
+class RecordingContext : public IRenderContext
+{
+public:
+	RecordingContext(IRenderContext* target) : target(target), offsets(true) { }
+
+	std::vector<RecordedCall> Calls;
+
+	// Whether to claim constant buffer offsets are supported
+	void SetSupportsOffsets(bool supported) { offsets = supported; }
+
+	void Clear() { Calls.clear(); }
+
+	unsigned int Count(const char* name)
+	{
+		unsigned int count = 0;
+		for (size_t i = 0; i < Calls.size(); i++)
+			count += strcmp(Calls[i].Name, name) == 0;
+		return count;
+	}
+
+	// The last call with this name, or null if there wasn't one
+	const RecordedCall* Last(const char* name)
+	{
+		for (size_t i = Calls.size(); i > 0; i--)
+		{
+			if (strcmp(Calls[i - 1].Name, name) == 0)
+				return &Calls[i - 1];
+		}
+		return 0;
+	}
+
+	void IASetInputLayout(ID3D11InputLayout* inputLayout) { Log("IASetInputLayout", 0, 1, inputLayout); target->IASetInputLayout(inputLayout); }
+	void IASetPrimitiveTopology(unsigned int topology) { Log("IASetPrimitiveTopology", topology, 0, 0); target->IASetPrimitiveTopology(topology); }
+	void IASetVertexBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* strides, const unsigned int* offsets)
+	{
+		LogArray("IASetVertexBuffers", startSlot, numBuffers, buffers);
+		target->IASetVertexBuffers(startSlot, numBuffers, buffers, strides, offsets);
+	}
+	void IASetIndexBuffer(ID3D11Buffer* indexBuffer, unsigned int format, unsigned int offset) { Log("IASetIndexBuffer", 0, 1, indexBuffer); target->IASetIndexBuffer(indexBuffer, format, offset); }
+
+	void VSSetShader(ID3D11VertexShader* shader) { Log("VSSetShader", 0, 1, shader); target->VSSetShader(shader); }
+	void VSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers) { LogArray("VSSetConstantBuffers", startSlot, numBuffers, buffers); target->VSSetConstantBuffers(startSlot, numBuffers, buffers); }
+	void VSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views) { LogArray("VSSetShaderResources", startSlot, numViews, views); target->VSSetShaderResources(startSlot, numViews, views); }
+	void VSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers) { LogArray("VSSetSamplers", startSlot, numSamplers, samplers); target->VSSetSamplers(startSlot, numSamplers, samplers); }
+
+	void PSSetShader(ID3D11PixelShader* shader) { Log("PSSetShader", 0, 1, shader); target->PSSetShader(shader); }
+	void PSSetConstantBuffers(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers) { LogArray("PSSetConstantBuffers", startSlot, numBuffers, buffers); target->PSSetConstantBuffers(startSlot, numBuffers, buffers); }
+	void PSSetShaderResources(unsigned int startSlot, unsigned int numViews, ID3D11ShaderResourceView* const* views) { LogArray("PSSetShaderResources", startSlot, numViews, views); target->PSSetShaderResources(startSlot, numViews, views); }
+	void PSSetSamplers(unsigned int startSlot, unsigned int numSamplers, ID3D11SamplerState* const* samplers) { LogArray("PSSetSamplers", startSlot, numSamplers, samplers); target->PSSetSamplers(startSlot, numSamplers, samplers); }
+
+	void OMSetRenderTargets(unsigned int numViews, ID3D11RenderTargetView* const* renderTargetViews, ID3D11DepthStencilView* depthStencilView)
+	{
+		LogArray("OMSetRenderTargets", 0, numViews, renderTargetViews);
+		target->OMSetRenderTargets(numViews, renderTargetViews, depthStencilView);
+	}
+	void RSSetViewport(float topLeftX, float topLeftY, float width, float height, float minDepth, float maxDepth)
+	{
+		Log("RSSetViewport", 0, 0, 0);
+		target->RSSetViewport(topLeftX, topLeftY, width, height, minDepth, maxDepth);
+	}
+	void RSSetState(ID3D11RasterizerState* rasterizerState) { Log("RSSetState", 0, 1, rasterizerState); target->RSSetState(rasterizerState); }
+	void OMSetBlendState(ID3D11BlendState* blendState) { Log("OMSetBlendState", 0, 1, blendState); target->OMSetBlendState(blendState); }
+	void OMSetDepthStencilState(ID3D11DepthStencilState* depthStencilState, unsigned int stencilRef) { Log("OMSetDepthStencilState", stencilRef, 1, depthStencilState); target->OMSetDepthStencilState(depthStencilState, stencilRef); }
+
+	void ClearRenderTargetView(ID3D11RenderTargetView* renderTargetView, const float color[4]) { Log("ClearRenderTargetView", 0, 1, renderTargetView); target->ClearRenderTargetView(renderTargetView, color); }
+	void ClearDepthStencilView(ID3D11DepthStencilView* depthStencilView, float depth, unsigned char stencil) { Log("ClearDepthStencilView", 0, 1, depthStencilView); target->ClearDepthStencilView(depthStencilView, depth, stencil); }
+
+	void UpdateSubresource(ID3D11Buffer* buffer, const void* data, unsigned int byteSize) { Log("UpdateSubresource", 0, byteSize, buffer); target->UpdateSubresource(buffer, data, byteSize); }
+	void UpdateSubresourceRange(ID3D11Buffer* buffer, unsigned int byteOffset, const void* data, unsigned int byteSize)
+	{
+		Log("UpdateSubresourceRange", byteOffset, byteSize, buffer);
+		target->UpdateSubresourceRange(buffer, byteOffset, data, byteSize);
+	}
+	void UpdateTextureRegion(ID3D11ShaderResourceView* texture, unsigned int mipLevel, unsigned int left, unsigned int top, unsigned int width, unsigned int height, const void* data, unsigned int rowPitch)
+	{
+		Log("UpdateTextureRegion", mipLevel, height, texture);
+		target->UpdateTextureRegion(texture, mipLevel, left, top, width, height, data, rowPitch);
+	}
+	void SetResourceMinLOD(ID3D11ShaderResourceView* texture, float minLOD) { Log("SetResourceMinLOD", (unsigned int)minLOD, 1, texture); target->SetResourceMinLOD(texture, minLOD); }
+	void CopyBufferRegion(ID3D11Buffer* destination, unsigned int destinationOffset, ID3D11Buffer* source, unsigned int sourceOffset, unsigned int byteSize)
+	{
+		Log("CopyBufferRegion", destinationOffset, byteSize, destination);
+		target->CopyBufferRegion(destination, destinationOffset, source, sourceOffset, byteSize);
+	}
+
+	void* MapDiscard(ID3D11Buffer* buffer) { Log("MapDiscard", 0, 1, buffer); return target->MapDiscard(buffer); }
+	void* MapNoOverwrite(ID3D11Buffer* buffer) { Log("MapNoOverwrite", 0, 1, buffer); return target->MapNoOverwrite(buffer); }
+	void* MapStaging(ID3D11Buffer* buffer) { Log("MapStaging", 0, 1, buffer); return target->MapStaging(buffer); }
+	void Unmap(ID3D11Buffer* buffer) { Log("Unmap", 0, 1, buffer); target->Unmap(buffer); }
+
+	bool SupportsConstantBufferOffsets() { return offsets; }
+	void VSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants)
+	{
+		LogRanges("VSSetConstantBuffers1", startSlot, numBuffers, buffers, firstConstants, numConstants);
+		target->VSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstants, numConstants);
+	}
+	void PSSetConstantBuffers1(unsigned int startSlot, unsigned int numBuffers, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants)
+	{
+		LogRanges("PSSetConstantBuffers1", startSlot, numBuffers, buffers, firstConstants, numConstants);
+		target->PSSetConstantBuffers1(startSlot, numBuffers, buffers, firstConstants, numConstants);
+	}
+
+	void DrawIndexed(unsigned int indexCount, unsigned int startIndexLocation, int baseVertexLocation)
+	{
+		Log("DrawIndexed", startIndexLocation, indexCount, 0);
+		target->DrawIndexed(indexCount, startIndexLocation, baseVertexLocation);
+	}
+	void DrawIndexedInstanced(unsigned int indexCountPerInstance, unsigned int instanceCount, unsigned int startIndexLocation, int baseVertexLocation, unsigned int startInstanceLocation)
+	{
+		Log("DrawIndexedInstanced", startInstanceLocation, instanceCount, 0);
+		target->DrawIndexedInstanced(indexCountPerInstance, instanceCount, startIndexLocation, baseVertexLocation, startInstanceLocation);
+	}
+
+	void ExecuteCommandList(ID3D11CommandList* commandList) { Log("ExecuteCommandList", 0, 1, commandList); target->ExecuteCommandList(commandList); }
+
+private:
+	void Log(const char* name, unsigned int startSlot, unsigned int count, const void* object)
+	{
+		RecordedCall call;
+		call.Name = name;
+		call.StartSlot = startSlot;
+		call.Count = count;
+		if (object)
+			call.Objects.push_back(object);
+		Calls.push_back(call);
+	}
+
+	template<typename T>
+	void LogArray(const char* name, unsigned int startSlot, unsigned int count, T* const* objects)
+	{
+		RecordedCall call;
+		call.Name = name;
+		call.StartSlot = startSlot;
+		call.Count = count;
+		for (unsigned int i = 0; i < count && objects; i++)
+			call.Objects.push_back(objects[i]);
+		Calls.push_back(call);
+	}
+
+	void LogRanges(const char* name, unsigned int startSlot, unsigned int count, ID3D11Buffer* const* buffers, const unsigned int* firstConstants, const unsigned int* numConstants)
+	{
+		LogArray(name, startSlot, count, buffers);
+		Calls.back().FirstConstants.assign(firstConstants, firstConstants + count);
+		Calls.back().NumConstants.assign(numConstants, numConstants + count);
+	}
+
+	IRenderContext* target;
+	bool offsets;
+};
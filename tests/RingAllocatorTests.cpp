@@ -0,0 +1,236 @@
+#include "Test.h"
+#include "RingAllocator.h"
+#include "ConstantUploadRing.h"
+#include "NullRenderDevice.h"
+
+#include <cstring>
+
+// --------------------------------------------------------
+// RingAllocator
+// --------------------------------------------------------
+TEST(RingAllocatorAlignsOffsets)
+{
+	RingAllocator ring(1024);
+	unsigned int offset = 1;
+
+	CHECK(ring.Allocate(10, 1, offset));
+	CHECK(offset == 0);
+
+	// Skips up to the next multiple of 256, and the skipped bytes count as used
+	CHECK(ring.Allocate(16, 256, offset));
+	CHECK(offset == 256);
+	CHECK(ring.GetUsed() == 272);
+
+	CHECK(ring.Allocate(4, 16, offset));
+	CHECK(offset == 272);
+}
+
+TEST(RingAllocatorWrapsToStart)
+{
+	RingAllocator ring(1024);
+	unsigned int offset;
+
+	CHECK(ring.Allocate(400, 16, offset) && offset == 0);
+	ring.Fence(1);
+	CHECK(ring.Allocate(400, 16, offset) && offset == 400);
+	ring.Fence(2);
+	ring.Retire(1);
+
+	// 224 bytes are left at the end, so this wraps to the freed start
+	CHECK(ring.Allocate(400, 16, offset));
+	CHECK(offset == 0);
+
+	// What was skipped at the end stays in use until it's retired,
+	// so the ring is now completely full
+	CHECK(ring.GetUsed() == 1024);
+	CHECK(!ring.Allocate(1, 1, offset));
+}
+
+TEST(RingAllocatorRejectsWhenFull)
+{
+	RingAllocator ring(1024);
+	unsigned int offset = 123;
+
+	CHECK(!ring.Allocate(1025, 1, offset));
+	CHECK(ring.Allocate(1024, 1, offset) && offset == 0);
+
+	// Failing leaves everything as it was
+	offset = 123;
+	CHECK(!ring.Allocate(1, 1, offset));
+	CHECK(offset == 123);
+	CHECK(ring.GetUsed() == 1024);
+
+	// Nothing's fenced, so retiring can't free it
+	ring.Retire(100);
+	CHECK(!ring.Allocate(1, 1, offset));
+
+	ring.Reset();
+	CHECK(ring.GetUsed() == 0);
+	CHECK(ring.Allocate(1024, 1, offset) && offset == 0);
+}
+
+TEST(RingAllocatorRejectsWhatWontFitBeforeTail)
+{
+	RingAllocator ring(1024);
+	unsigned int offset;
+
+	CHECK(ring.Allocate(512, 1, offset));
+	ring.Fence(1);
+	CHECK(ring.Allocate(256, 1, offset));
+	ring.Fence(2);
+	ring.Retire(1);
+
+	// 256 free at the end and 512 at the start, but not 600 in one run
+	CHECK(!ring.Allocate(600, 1, offset));
+	CHECK(ring.Allocate(512, 1, offset) && offset == 0);
+
+	// Head is now right up against the tail
+	CHECK(!ring.Allocate(1, 1, offset));
+}
+
+TEST(RingAllocatorRetiresInFenceOrder)
+{
+	RingAllocator ring(1024);
+	unsigned int offset;
+
+	CHECK(ring.Allocate(100, 1, offset));
+	ring.Fence(1);
+	CHECK(ring.Allocate(200, 1, offset));
+	ring.Fence(2);
+	CHECK(ring.Allocate(300, 1, offset));
+	ring.Fence(3);
+	CHECK(ring.GetFenceCount() == 3);
+	CHECK(ring.GetUsed() == 600);
+
+	ring.Retire(0);
+	CHECK(ring.GetUsed() == 600);
+
+	ring.Retire(2);
+	CHECK(ring.GetFenceCount() == 1);
+	CHECK(ring.GetUsed() == 300);
+
+	ring.Retire(3);
+	CHECK(ring.GetFenceCount() == 0);
+	CHECK(ring.GetUsed() == 0);
+
+	// With nothing in use it starts over at the beginning
+	CHECK(ring.Allocate(1024, 1, offset) && offset == 0);
+}
+
+TEST(RingAllocatorMergesEmptyFences)
+{
+	RingAllocator ring(1024);
+	unsigned int offset;
+
+	CHECK(ring.Allocate(100, 1, offset));
+	ring.Fence(1);
+	ring.Fence(2);
+	ring.Fence(3);
+	CHECK(ring.GetFenceCount() == 1);
+
+	// The first fence is the one that frees it
+	ring.Retire(1);
+	CHECK(ring.GetUsed() == 0);
+	CHECK(ring.GetFenceCount() == 0);
+}
+
+// --------------------------------------------------------
+// ConstantUploadRing
+// --------------------------------------------------------
+TEST(ConstantUploadRingAlignsSlices)
+{
+	NullRenderDevice device;
+	ConstantUploadRing ring(&device, device.GetImmediateContext(), 1024);
+	CHECK(ring.IsEnabled());
+
+	float data[80];
+	for (int i = 0; i < 80; i++)
+		data[i] = (float)i;
+
+	// Every slice is rounded up to 256 bytes, 16 constants
+	ConstantBufferSlice slice = {};
+	CHECK(ring.Upload(data, 64, slice));
+	CHECK(slice.Buffer != 0);
+	CHECK(slice.FirstConstant == 0);
+	CHECK(slice.NumConstants == 16);
+
+	CHECK(ring.Upload(data, 260, slice));
+	CHECK(slice.FirstConstant == 16);
+	CHECK(slice.NumConstants == 32);
+
+	// The data went where the slice says
+	const unsigned char* contents = (const unsigned char*)slice.Buffer;
+	CHECK(memcmp(contents, data, 64) == 0);
+	CHECK(memcmp(contents + 256, data, 260) == 0);
+}
+
+TEST(ConstantUploadRingRejectsWhenFull)
+{
+	NullRenderDevice device;
+	ConstantUploadRing ring(&device, device.GetImmediateContext(), 1024);
+
+	float data[4] = {};
+	ConstantBufferSlice slice = {};
+	for (int i = 0; i < 4; i++)
+		CHECK(ring.Upload(data, sizeof(data), slice));
+
+	// A failed upload leaves the slice alone, so the caller can fall back
+	slice.FirstConstant = 999;
+	CHECK(!ring.Upload(data, sizeof(data), slice));
+	CHECK(slice.FirstConstant == 999);
+
+	ring.EndFrame();
+	CHECK(ring.GetUploadsLastFrame() == 4);
+	CHECK(ring.GetFallbacksLastFrame() == 1);
+	CHECK(ring.GetBytesLastFrame() == 1024);
+}
+
+TEST(ConstantUploadRingRetiresAfterFrameLatency)
+{
+	NullRenderDevice device;
+	ConstantUploadRing ring(&device, device.GetImmediateContext(), 1024);
+
+	float data[4] = {};
+	ConstantBufferSlice slice = {};
+
+	// Fill the whole ring in the first frame
+	ring.BeginFrame();
+	for (int i = 0; i < 4; i++)
+		CHECK(ring.Upload(data, sizeof(data), slice));
+	ring.EndFrame();
+
+	// The GPU could still be reading it for MaxFrameLatency frames
+	for (unsigned int frame = 0; frame < ConstantUploadRing::MaxFrameLatency; frame++)
+	{
+		ring.BeginFrame();
+		CHECK(!ring.Upload(data, sizeof(data), slice));
+		ring.EndFrame();
+	}
+
+	// Then it's all free again, and wraps back to the start
+	ring.BeginFrame();
+	CHECK(ring.Upload(data, sizeof(data), slice));
+	CHECK(slice.FirstConstant == 0);
+	ring.EndFrame();
+}
+
+TEST(ConstantUploadRingWrapsAroundRetiredFrames)
+{
+	NullRenderDevice device;
+	ConstantUploadRing ring(&device, device.GetImmediateContext(), 1024);
+
+	float data[4] = {};
+	ConstantBufferSlice slice = {};
+
+	// One slice a frame, so once the first few frames retire, each
+	// new frame's slice follows the last and wraps around the end
+	unsigned int expected = 0;
+	for (unsigned int frame = 0; frame < 12; frame++)
+	{
+		ring.BeginFrame();
+		CHECK(ring.Upload(data, sizeof(data), slice));
+		CHECK(slice.FirstConstant == expected);
+		expected = (expected + 16) % 64;
+		ring.EndFrame();
+	}
+}
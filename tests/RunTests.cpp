@@ -0,0 +1,207 @@
+// --------------------------------------------------------
+// Runs the engine's tests, all of them or only the ones whose
+// names contain the text given:
+//
+//   RunTests [name]
+//
+// Prints every failed check and returns 1 if there were any.
+//
+// The tests run everything on the null render device, so they
+// build anywhere, with DirectXMath (and a sal.h, which it
+// needs off Windows) from the repository root:
+//
+//   g++ -std=c++14 -O2 -pthread -I DX11Starter -I <DirectXMath>/Inc
+//       -I <sal.h folder> -DTEST_REPOSITORY_ROOT=\"$PWD\"
+//       -o RunTests tests/*.cpp $(ls DX11Starter/*.cpp | grep -v Main.cpp)
+//
+// Each test runs in a directory of its own under the system's
+// temporary directory, which is deleted when the test is done,
+// so files tests write never end up in the repository.
+//
+// Tests that read the repository's own files find them through
+// TEST_REPOSITORY_ROOT, so RunTests can be run from anywhere.
+// Without it they're found from the path this file was compiled
+// as, which compilers that give full paths (like MSVC) make
+// work from anywhere too.
+// --------------------------------------------------------
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "Test.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <direct.h>
+#define getcwd _getcwd
+#define chdir _chdir
+#else
+#include <cstdlib>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+struct RegisteredTest
+{
+	const char* Name;
+	TestFunction Function;
+};
+
+// Made on first use, since tests register from other files'
+// static initializers, which run in no particular order
+static std::vector<RegisteredTest>& GetTests()
+{
+	static std::vector<RegisteredTest> tests;
+	return tests;
+}
+
+static unsigned int failures = 0;
+
+// Where RunTests was started, which relative source paths are from
+static std::string startDirectory;
+
+bool RegisterTest(const char* name, TestFunction function)
+{
+	RegisteredTest test = { name, function };
+	GetTests().push_back(test);
+	return true;
+}
+
+void ReportFailure(const char* file, int line, const char* expression)
+{
+	printf("  %s(%d): CHECK(%s) failed\n", file, line, expression);
+	failures++;
+}
+
+static bool IsAbsolutePath(const std::string& path)
+{
+	return
+		(!path.empty() && (path[0] == '/' || path[0] == '\\')) ||
+		(path.size() > 1 && path[1] == ':');
+}
+
+std::string GetRepositoryPath(const std::string& relativePath)
+{
+#ifdef TEST_REPOSITORY_ROOT
+	std::string root = TEST_REPOSITORY_ROOT;
+#else
+	// This file is tests/RunTests.cpp, so the root is two levels up
+	std::string root = __FILE__;
+	for (int level = 0; level < 2; level++)
+	{
+		std::string::size_type slash = root.find_last_of("/\\");
+		root = slash == std::string::npos ? "" : root.substr(0, slash);
+	}
+#endif
+	if (!IsAbsolutePath(root) && !startDirectory.empty())
+		root = root.empty() ? startDirectory : startDirectory + "/" + root;
+	return root.empty() ? relativePath : root + "/" + relativePath;
+}
+
+// --------------------------------------------------------
+// Makes an empty directory for one test to write into, and
+// deletes it (with everything in it) afterwards.  Returns an
+// empty path if it couldn't be made.
+// --------------------------------------------------------
+static std::string MakeScratchDirectory()
+{
+#ifdef _WIN32
+	static unsigned int made = 0;
+	char temp[MAX_PATH];
+	if (!GetTempPathA(MAX_PATH, temp))
+		return "";
+	std::string path = std::string(temp) + "RunTests." + std::to_string(GetCurrentProcessId()) + "." + std::to_string(made++);
+	return CreateDirectoryA(path.c_str(), 0) ? path : "";
+#else
+	const char* temp = getenv("TMPDIR");
+	std::string path = std::string(temp && *temp ? temp : "/tmp") + "/RunTests.XXXXXX";
+	std::vector<char> name(path.begin(), path.end());
+	name.push_back(0);
+	return mkdtemp(&name[0]) ? std::string(&name[0]) : "";
+#endif
+}
+
+static void DeleteScratchDirectory(const std::string& path)
+{
+#ifdef _WIN32
+	WIN32_FIND_DATAA found;
+	HANDLE search = FindFirstFileA((path + "\\*").c_str(), &found);
+	if (search != INVALID_HANDLE_VALUE)
+	{
+		do
+		{
+			std::string name = found.cFileName;
+			if (name == "." || name == "..")
+				continue;
+			if (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+				DeleteScratchDirectory(path + "\\" + name);
+			else
+				DeleteFileA((path + "\\" + name).c_str());
+		} while (FindNextFileA(search, &found));
+		FindClose(search);
+	}
+	RemoveDirectoryA(path.c_str());
+#else
+	DIR* directory = opendir(path.c_str());
+	if (directory)
+	{
+		while (dirent* entry = readdir(directory))
+		{
+			std::string name = entry->d_name;
+			if (name == "." || name == "..")
+				continue;
+			std::string child = path + "/" + name;
+			struct stat info;
+			if (lstat(child.c_str(), &info) == 0 && S_ISDIR(info.st_mode))
+				DeleteScratchDirectory(child);
+			else
+				unlink(child.c_str());
+		}
+		closedir(directory);
+	}
+	rmdir(path.c_str());
+#endif
+}
+
+int main(int argc, char* argv[])
+{
+	const char* filter = argc > 1 ? argv[1] : "";
+
+	char directory[4096];
+	if (getcwd(directory, sizeof(directory)))
+		startDirectory = directory;
+
+	unsigned int run = 0;
+	unsigned int failed = 0;
+	std::vector<RegisteredTest>& tests = GetTests();
+	for (size_t i = 0; i < tests.size(); i++)
+	{
+		if (!strstr(tests[i].Name, filter))
+			continue;
+
+		unsigned int failuresBefore = failures;
+		printf("%s\n", tests[i].Name);
+		std::string scratch = MakeScratchDirectory();
+		if (scratch.empty() || chdir(scratch.c_str()) != 0)
+		{
+			printf("  Couldn't make a directory to run in\n");
+			failures++;
+		}
+		else
+		{
+			tests[i].Function();
+			if (chdir(startDirectory.c_str()) != 0)
+				printf("  Couldn't return to %s\n", startDirectory.c_str());
+		}
+		if (!scratch.empty())
+			DeleteScratchDirectory(scratch);
+
+		run++;
+		if (failures != failuresBefore)
+			failed++;
+	}
+
+	printf("%u tests, %u failed\n", run, failed);
+	return failed ? 1 : 0;
+}
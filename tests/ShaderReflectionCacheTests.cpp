@@ -0,0 +1,212 @@
+#include "Test.h"
+#include "TestShaders.h"
+#include "ShaderReflectionCache.h"
+#include "SimpleShader.h"
+#include "NullRenderDevice.h"
+
+#include <cstdio>
+#include <fstream>
+
+static ShaderReflectionData MakeReflection()
+{
+	ShaderReflectionData data;
+	data.ByteCodeHash = 0x0123456789ABCDEFull;
+
+	ReflectedConstantBuffer cb;
+	cb.Name = "perObject";
+	cb.Size = 80;
+	cb.BindIndex = 2;
+	ReflectedVariable world = { "world", 0, 64 };
+	ReflectedVariable tint = { "tint", 64, 16 };
+	cb.Variables.push_back(world);
+	cb.Variables.push_back(tint);
+	data.ConstantBuffers.push_back(cb);
+
+	// Names of any length, including none at all
+	ReflectedConstantBuffer unnamed;
+	unnamed.Size = 16;
+	unnamed.BindIndex = 0;
+	unnamed.Variables.push_back(ReflectedVariable());
+	unnamed.Variables[0].Name = std::string(300, 'x');
+	unnamed.Variables[0].ByteOffset = 0;
+	unnamed.Variables[0].Size = 4;
+	data.ConstantBuffers.push_back(unnamed);
+
+	ReflectedResource texture = { "diffuse", REFLECTED_SHADER_RESOURCE, 3 };
+	ReflectedResource sampler = { "linear", REFLECTED_SAMPLER, 1 };
+	data.Resources.push_back(texture);
+	data.Resources.push_back(sampler);
+
+	ReflectedInputElement position = { "POSITION", 0, 6, false };
+	ReflectedInputElement uv = { "TEXCOORD", 1, 16, false };
+	ReflectedInputElement instance = { "TRANSFORM_PER_INSTANCE", 0, 42, true };
+	data.InputElements.push_back(position);
+	data.InputElements.push_back(uv);
+	data.InputElements.push_back(instance);
+	return data;
+}
+
+static bool SameReflection(const ShaderReflectionData& a, const ShaderReflectionData& b)
+{
+	if (a.ByteCodeHash != b.ByteCodeHash ||
+		a.ConstantBuffers.size() != b.ConstantBuffers.size() ||
+		a.Resources.size() != b.Resources.size() ||
+		a.InputElements.size() != b.InputElements.size())
+		return false;
+
+	for (size_t i = 0; i < a.ConstantBuffers.size(); i++)
+	{
+		const ReflectedConstantBuffer& x = a.ConstantBuffers[i];
+		const ReflectedConstantBuffer& y = b.ConstantBuffers[i];
+		if (x.Name != y.Name || x.Size != y.Size || x.BindIndex != y.BindIndex || x.Variables.size() != y.Variables.size())
+			return false;
+		for (size_t v = 0; v < x.Variables.size(); v++)
+		{
+			if (x.Variables[v].Name != y.Variables[v].Name ||
+				x.Variables[v].ByteOffset != y.Variables[v].ByteOffset ||
+				x.Variables[v].Size != y.Variables[v].Size)
+				return false;
+		}
+	}
+	for (size_t i = 0; i < a.Resources.size(); i++)
+	{
+		if (a.Resources[i].Name != b.Resources[i].Name ||
+			a.Resources[i].Type != b.Resources[i].Type ||
+			a.Resources[i].BindIndex != b.Resources[i].BindIndex)
+			return false;
+	}
+	for (size_t i = 0; i < a.InputElements.size(); i++)
+	{
+		if (a.InputElements[i].SemanticName != b.InputElements[i].SemanticName ||
+			a.InputElements[i].SemanticIndex != b.InputElements[i].SemanticIndex ||
+			a.InputElements[i].Format != b.InputElements[i].Format ||
+			a.InputElements[i].PerInstance != b.InputElements[i].PerInstance)
+			return false;
+	}
+	return true;
+}
+
+TEST(ShaderReflectionCacheRoundTrips)
+{
+	ShaderReflectionData original = MakeReflection();
+	std::vector<unsigned char> bytes;
+	ShaderReflectionCache::Write(original, bytes);
+
+	// Little endian whatever the machine, so the magic reads as "SRFL"
+	CHECK(bytes.size() > 8);
+	CHECK(bytes[0] == 'S' && bytes[1] == 'R' && bytes[2] == 'F' && bytes[3] == 'L');
+	CHECK(bytes[4] == ShaderReflectionCache::Version && bytes[5] == 0);
+	CHECK(bytes[8] == 0xEF && bytes[15] == 0x01);
+
+	ShaderReflectionData loaded;
+	CHECK(ShaderReflectionCache::Read(&bytes[0], bytes.size(), loaded));
+	CHECK(SameReflection(original, loaded));
+
+	// Nothing at all is fine too
+	ShaderReflectionData empty = {};
+	ShaderReflectionCache::Write(empty, bytes);
+	CHECK(ShaderReflectionCache::Read(&bytes[0], bytes.size(), loaded));
+	CHECK(SameReflection(empty, loaded));
+
+	// And through a file
+	CHECK(ShaderReflectionCache::Save("ReflectionRoundTrip.refl", original));
+	CHECK(ShaderReflectionCache::Load("ReflectionRoundTrip.refl", loaded));
+	CHECK(SameReflection(original, loaded));
+	remove("ReflectionRoundTrip.refl");
+}
+
+TEST(ShaderReflectionCacheRejectsBadFiles)
+{
+	ShaderReflectionData original = MakeReflection();
+	std::vector<unsigned char> bytes;
+	ShaderReflectionCache::Write(original, bytes);
+
+	// A failed read leaves what was there alone
+	ShaderReflectionData loaded = MakeReflection();
+	loaded.ByteCodeHash = 7;
+
+	// Every way of ending early
+	for (size_t length = 0; length < bytes.size(); length++)
+		CHECK(!ShaderReflectionCache::Read(&bytes[0], length, loaded));
+	CHECK(!ShaderReflectionCache::Read(0, 0, loaded));
+
+	// Anything after the end
+	std::vector<unsigned char> longer = bytes;
+	longer.push_back(0);
+	CHECK(!ShaderReflectionCache::Read(&longer[0], longer.size(), loaded));
+
+	// Wrong magic or version
+	std::vector<unsigned char> wrong = bytes;
+	wrong[0] = 'X';
+	CHECK(!ShaderReflectionCache::Read(&wrong[0], wrong.size(), loaded));
+	wrong = bytes;
+	wrong[4] = ShaderReflectionCache::Version + 1;
+	CHECK(!ShaderReflectionCache::Read(&wrong[0], wrong.size(), loaded));
+
+	// A count far bigger than the file could hold, which mustn't be
+	// used to size anything before it's found not to fit
+	wrong = bytes;
+	wrong[16] = 0xFF;
+	wrong[17] = 0xFF;
+	wrong[18] = 0xFF;
+	wrong[19] = 0x7F;
+	CHECK(!ShaderReflectionCache::Read(&wrong[0], wrong.size(), loaded));
+
+	// A resource type that doesn't exist
+	ShaderReflectionData oneResource = {};
+	ReflectedResource resource = { "r", REFLECTED_SAMPLER, 0 };
+	oneResource.Resources.push_back(resource);
+	ShaderReflectionCache::Write(oneResource, wrong);
+	CHECK(ShaderReflectionCache::Read(&wrong[0], wrong.size(), loaded));
+	wrong[8 + 8 + 4 + 4 + 2 + 1] = REFLECTED_SAMPLER + 1;
+	loaded.ByteCodeHash = 7;
+	CHECK(!ShaderReflectionCache::Read(&wrong[0], wrong.size(), loaded));
+
+	CHECK(loaded.ByteCodeHash == 7);
+	CHECK(!ShaderReflectionCache::Load("NoSuchFile.refl", loaded));
+}
+
+static bool CopyTestFile(const char* from, const char* to, const char* append)
+{
+	std::ifstream in(from, std::ios::binary);
+	std::ofstream out(to, std::ios::binary);
+	out << in.rdbuf() << append;
+	return in.good() && out.good();
+}
+
+// --------------------------------------------------------
+// A sidecar is only used while its hash matches the byte code
+// next to it.  Off Windows there's nothing to reflect with, so
+// a shader with a stale sidecar fails to load at all.
+// --------------------------------------------------------
+TEST(ShaderReflectionCacheIgnoresStaleSidecars)
+{
+	CHECK(WriteTestShaders());
+	NullRenderDevice device;
+
+	SimplePixelShader current(&device);
+	CHECK(current.LoadShaderFile(TEST_PIXEL_SHADER));
+	CHECK(current.LoadedFromReflectionCache());
+	CHECK(current.GetSamplerInfo("samplerState") != 0);
+
+	// Same sidecar, byte code that's changed since
+	CHECK(CopyTestFile("TestShaders/PixelShader.cso", "TestShaders/Stale.cso", "changed"));
+	CHECK(CopyTestFile("TestShaders/PixelShader.cso.refl", "TestShaders/Stale.cso.refl", ""));
+	SimplePixelShader stale(&device);
+	bool loaded = stale.LoadShaderFile(L"TestShaders/Stale.cso");
+	CHECK(!stale.LoadedFromReflectionCache());
+#ifndef _WIN32
+	CHECK(!loaded);
+#endif
+
+	// A sidecar that isn't one
+	CHECK(CopyTestFile("TestShaders/PixelShader.cso", "TestShaders/Broken.cso", ""));
+	CHECK(CopyTestFile("TestShaders/PixelShader.cso", "TestShaders/Broken.cso.refl", ""));
+	SimplePixelShader broken(&device);
+	loaded = broken.LoadShaderFile(L"TestShaders/Broken.cso");
+	CHECK(!broken.LoadedFromReflectionCache());
+#ifndef _WIN32
+	CHECK(!loaded);
+#endif
+	(void)loaded;
+}
@@ -0,0 +1,288 @@
+#include "Test.h"
+#include "TestShaders.h"
+#include "ShaderVariantCache.h"
+#include "NullRenderDevice.h"
+#include "Platform.h"
+
+#include <cstdio>
+#include <fstream>
+#include <set>
+
+// One feature of each size: a switch, a count and one with a default
+static ShaderPermutationSet MakePermutations()
+{
+	ShaderPermutationSet permutations;
+	permutations.AddFeature("USE_NORMAL_MAP", 1, 0);
+	permutations.AddFeature("LIGHT_COUNT", 5, 0);
+	permutations.AddFeature("FOG_MODE", 2, 1);
+	return permutations;
+}
+
+TEST(ShaderPermutationsPackKeys)
+{
+	ShaderPermutationSet permutations = MakePermutations();
+	CHECK(permutations.GetFeatureCount() == 3);
+
+	// Names are unique, defaults fit, and there's no feature without a name
+	CHECK(!permutations.AddFeature("LIGHT_COUNT", 1, 0));
+	CHECK(!permutations.AddFeature("", 1, 0));
+	CHECK(!permutations.AddFeature("BAD_DEFAULT", 3, 4));
+	CHECK(permutations.GetFeatureCount() == 3);
+
+	// 1, 3 and 2 bits, in the order they were added
+	CHECK(permutations.GetDefaultKey() == (1ull << 4));
+	ShaderVariantKey key = permutations.GetDefaultKey();
+	CHECK(permutations.SetFeature(key, "LIGHT_COUNT", 5));
+	CHECK(permutations.SetFeature(key, "USE_NORMAL_MAP", 1));
+	CHECK(key == (1ull | (5ull << 1) | (1ull << 4)));
+	CHECK(permutations.GetFeature(key, "LIGHT_COUNT") == 5);
+	CHECK(permutations.GetFeature(key, "FOG_MODE") == 1);
+	CHECK(permutations.GetFeature(key, "NO_SUCH_FEATURE") == 0);
+
+	// Setting a value overwrites only that feature
+	CHECK(permutations.SetFeature(key, "LIGHT_COUNT", 2));
+	CHECK(key == (1ull | (2ull << 1) | (1ull << 4)));
+
+	// Values past a feature's maximum, even if its bits could hold them
+	CHECK(!permutations.SetFeature(key, "LIGHT_COUNT", 6));
+	CHECK(!permutations.SetFeature(key, "NO_SUCH_FEATURE", 0));
+	CHECK(permutations.IsValidKey(key));
+	CHECK(!permutations.IsValidKey(7ull << 1));
+	CHECK(!permutations.IsValidKey(3ull << 4));
+	CHECK(!permutations.IsValidKey(1ull << 6));
+
+	std::vector<ShaderDefine> defines = permutations.GetDefines(key);
+	CHECK(defines.size() == 3);
+	CHECK(defines[0].Name == "USE_NORMAL_MAP" && defines[0].Value == "1");
+	CHECK(defines[1].Name == "LIGHT_COUNT" && defines[1].Value == "2");
+	CHECK(defines[2].Name == "FOG_MODE" && defines[2].Value == "1");
+
+	// Up to 64 bits and no more
+	ShaderPermutationSet wide;
+	CHECK(wide.AddFeature("A", 0xFFFFFFFF, 0));
+	CHECK(wide.AddFeature("B", 0x7FFFFFFF, 0));
+	CHECK(wide.AddFeature("C", 1, 0));
+	CHECK(!wide.AddFeature("D", 1, 0));
+	CHECK(wide.IsValidKey(~0ull));
+}
+
+TEST(ShaderPermutationsListEveryVariant)
+{
+	ShaderPermutationSet permutations = MakePermutations();
+	CHECK(permutations.GetVariantCount() == 2 * 6 * 3);
+
+	// Every key is valid and different, the first feature changing fastest
+	std::set<ShaderVariantKey> keys;
+	ShaderVariantKey key;
+	for (unsigned long long i = 0; permutations.GetVariantKey(i, key); i++)
+	{
+		CHECK(permutations.IsValidKey(key));
+		keys.insert(key);
+	}
+	CHECK(keys.size() == 36);
+	CHECK(!permutations.GetVariantKey(36, key));
+	CHECK(permutations.GetVariantKey(1, key) && key == 1);
+	CHECK(permutations.GetVariantKey(2, key) && key == (1ull << 1));
+	CHECK(permutations.GetVariantKey(12, key) && key == (1ull << 4));
+
+	// No features is one variant, the empty key
+	ShaderPermutationSet none;
+	CHECK(none.GetVariantCount() == 1);
+	CHECK(none.GetVariantKey(0, key) && key == 0);
+	CHECK(none.IsValidKey(0) && !none.IsValidKey(1));
+}
+
+TEST(ShaderPermutationsLayoutHash)
+{
+	ShaderPermutationSet a = MakePermutations();
+	ShaderPermutationSet b = MakePermutations();
+	CHECK(a.GetLayoutHash() == b.GetLayoutHash());
+
+	// A new feature, or a feature's range changing
+	b.AddFeature("SHADOWS", 1, 0);
+	CHECK(a.GetLayoutHash() != b.GetLayoutHash());
+	ShaderPermutationSet c;
+	c.AddFeature("USE_NORMAL_MAP", 1, 0);
+	c.AddFeature("LIGHT_COUNT", 4, 0);
+	c.AddFeature("FOG_MODE", 2, 1);
+	CHECK(a.GetLayoutHash() != c.GetLayoutHash());
+
+	// Defaults don't change what compiles, so they don't count
+	ShaderPermutationSet d;
+	d.AddFeature("USE_NORMAL_MAP", 1, 1);
+	d.AddFeature("LIGHT_COUNT", 5, 3);
+	d.AddFeature("FOG_MODE", 2, 0);
+	CHECK(a.GetLayoutHash() == d.GetLayoutHash());
+
+	// Where one name ends and the next starts matters
+	ShaderPermutationSet ab, bc;
+	ab.AddFeature("AB", 1, 0);
+	ab.AddFeature("C", 1, 0);
+	bc.AddFeature("A", 1, 0);
+	bc.AddFeature("BC", 1, 0);
+	CHECK(ab.GetLayoutHash() != bc.GetLayoutHash());
+
+	// Hashing in pieces is the same as all at once
+	unsigned long long pieces = ShaderVariantCacheIndex::HashSource("abc", 3);
+	pieces = ShaderVariantCacheIndex::HashSource("def", 3, pieces);
+	CHECK(pieces == ShaderVariantCacheIndex::HashSource("abcdef", 6));
+	CHECK(ShaderVariantCacheIndex::HashSource("", 0) == 14695981039346656037ull);
+}
+
+static ShaderVariantCacheEntry Entry(ShaderVariantKey key, unsigned long long sourceHash)
+{
+	ShaderVariantCacheEntry entry;
+	entry.Key = key;
+	entry.SourceHash = sourceHash;
+	entry.FileName = ShaderVariantCacheIndex::MakeFileName("Shader", key);
+	return entry;
+}
+
+TEST(ShaderVariantCacheIndexFindsAndSaves)
+{
+	CHECK(ShaderVariantCacheIndex::MakeFileName("PixelShader", 0x1c) == "PixelShader_000000000000001c.cso");
+
+	ShaderVariantCacheIndex index;
+	index.Set(Entry(5, 100));
+	index.Set(Entry(1, 100));
+	index.Set(Entry(3, 200));
+	CHECK(index.GetEntryCount() == 3);
+	CHECK(index.Find(3) && index.Find(3)->SourceHash == 200);
+	CHECK(!index.Find(4));
+
+	// Only entries compiled from the source asked for
+	CHECK(index.Find(3, 200));
+	CHECK(!index.Find(3, 100));
+
+	// Setting a key again replaces it
+	index.Set(Entry(3, 100));
+	CHECK(index.GetEntryCount() == 3);
+	CHECK(index.Find(3, 100));
+	CHECK(index.Remove(3));
+	CHECK(!index.Remove(3));
+	index.Set(Entry(3, 100));
+
+	// Same entries, same file, whatever order they went in
+	std::vector<unsigned char> bytes;
+	index.Write(bytes);
+	ShaderVariantCacheIndex reordered;
+	reordered.Set(Entry(3, 100));
+	reordered.Set(Entry(1, 100));
+	reordered.Set(Entry(5, 100));
+	std::vector<unsigned char> reorderedBytes;
+	reordered.Write(reorderedBytes);
+	CHECK(bytes == reorderedBytes);
+	CHECK(bytes[0] == 'S' && bytes[1] == 'V' && bytes[2] == 'I' && bytes[3] == 'X');
+
+	ShaderVariantCacheIndex loaded;
+	CHECK(loaded.Read(&bytes[0], bytes.size()));
+	CHECK(loaded.GetEntryCount() == 3);
+	CHECK(loaded.Find(5, 100) && loaded.Find(5)->FileName == "Shader_0000000000000005.cso");
+
+	// Bad files are rejected, leaving what was there alone
+	for (size_t length = 0; length < bytes.size(); length++)
+		CHECK(!loaded.Read(&bytes[0], length));
+	std::vector<unsigned char> wrong = bytes;
+	wrong.push_back(0);
+	CHECK(!loaded.Read(&wrong[0], wrong.size()));
+	wrong = bytes;
+	wrong[4] = ShaderVariantCacheIndex::Version + 1;
+	CHECK(!loaded.Read(&wrong[0], wrong.size()));
+	wrong = bytes;
+	wrong[11] = 0x7F;
+	CHECK(!loaded.Read(&wrong[0], wrong.size()));
+	CHECK(!loaded.Read(0, 0));
+	CHECK(loaded.GetEntryCount() == 3);
+
+	CHECK(index.Save("TestIndex.variants"));
+	loaded.Clear();
+	CHECK(loaded.Load("TestIndex.variants"));
+	CHECK(loaded.GetEntryCount() == 3);
+	remove("TestIndex.variants");
+}
+
+static bool CopyTestFile(const std::string& from, const std::string& to)
+{
+	std::ifstream in(from.c_str(), std::ios::binary);
+	std::ofstream out(to.c_str(), std::ios::binary);
+	out << in.rdbuf();
+	return in.good() && out.good();
+}
+
+// A stand-in variant in the disk cache: a copy of a test shader and its sidecar
+static bool CacheVariant(const std::string& fileName)
+{
+	return
+		CopyTestFile("TestShaders/PixelShader.cso", "TestVariants/" + fileName) &&
+		CopyTestFile("TestShaders/PixelShader.cso.refl", "TestVariants/" + fileName + ".refl");
+}
+
+// --------------------------------------------------------
+// Precompiled files first, then the disk cache while its
+// source hash matches.  There's no compiler off Windows, so
+// anything else fails, and stays failed.
+// --------------------------------------------------------
+TEST(ShaderVariantCacheLooksUpVariants)
+{
+	CHECK(WriteTestShaders());
+	MakeDirectory(L"TestVariants");
+	const char source[] = "float4 main() : SV_TARGET { return FOG_MODE; }";
+	{
+		std::ofstream file("TestVariants/Source.hlsl", std::ios::binary);
+		file << source;
+	}
+
+	// The hash the cache works out: layout, then target, then source
+	ShaderPermutationSet permutations = MakePermutations();
+	unsigned long long sourceHash = permutations.GetLayoutHash();
+	sourceHash = ShaderVariantCacheIndex::HashSource("ps_5_0", 7, sourceHash);
+	sourceHash = ShaderVariantCacheIndex::HashSource(source, sizeof(source) - 1, sourceHash);
+
+	ShaderVariantKey cached = permutations.GetDefaultKey();
+	permutations.SetFeature(cached, "LIGHT_COUNT", 3);
+	ShaderVariantKey stale = permutations.GetDefaultKey();
+	permutations.SetFeature(stale, "USE_NORMAL_MAP", 1);
+
+	ShaderVariantCacheIndex index;
+	index.Set(Entry(cached, sourceHash));
+	index.Set(Entry(stale, sourceHash + 1));
+	CHECK(CacheVariant(Entry(cached, 0).FileName));
+	CHECK(CacheVariant(Entry(stale, 0).FileName));
+	CHECK(index.Save("TestVariants/Source.variants"));
+
+	NullRenderDevice device;
+	ShaderVariantCache variants(&device, permutations, L"TestVariants/Source.hlsl", "ps_5_0", L"TestVariants");
+	variants.AddPrecompiled(permutations.GetDefaultKey(), TEST_PIXEL_SHADER);
+
+	// Precompiled, then the same one from memory
+	SimplePixelShader* defaultVariant = variants.GetPixelShader(permutations.GetDefaultKey());
+	CHECK(defaultVariant != 0);
+	CHECK(variants.GetPixelShader(permutations.GetDefaultKey()) == defaultVariant);
+	CHECK(variants.GetStats().DiskHits == 1 && variants.GetStats().MemoryHits == 1);
+
+	// A pixel shader cache has no vertex shaders
+	CHECK(variants.GetVertexShader(permutations.GetDefaultKey()) == 0);
+
+	// From the disk cache
+	SimplePixelShader* cachedVariant = variants.GetPixelShader(cached);
+	CHECK(cachedVariant != 0 && cachedVariant != defaultVariant);
+	CHECK(cachedVariant->GetSamplerInfo("samplerState") != 0);
+	CHECK(variants.GetStats().DiskHits == 2);
+
+	// Compiled from another source, and keys that can't exist
+	CHECK(variants.GetPixelShader(stale) == 0);
+	CHECK(variants.GetPixelShader(stale) == 0);
+	CHECK(variants.GetPixelShader(7ull << 1) == 0);
+	CHECK(variants.GetStats().Failures == 3);
+	CHECK(variants.GetStats().Compiles == 0);
+
+	CHECK(variants.GetStats().Lookups == 6);
+	CHECK(variants.GetLoadedVariantCount() == 2);
+	CHECK(variants.GetLoadedVariant(0) == defaultVariant);
+
+	// Without the source there's nothing to compare with, so the cache is trusted
+	ShaderVariantCache noSource(&device, permutations, L"TestVariants/Source.missing", "ps_5_0", L"TestVariants/");
+	CHECK(noSource.GetPixelShader(stale) != 0);
+	CHECK(noSource.GetPixelShader(cached) != 0);
+	CHECK(noSource.GetStats().HitRate() == 1.0f);
+}
@@ -0,0 +1,198 @@
+#include "Test.h"
+#include "TestShaders.h"
+#include "RecordingContext.h"
+#include "SimpleShader.h"
+#include "NullRenderDevice.h"
+
+#include <fstream>
+
+// Stand-ins for DirectX objects, which are only passed along
+template<typename T>
+static T* Fake(unsigned int n)
+{
+	return (T*)(size_t)(0x1000 + n * 0x10);
+}
+
+static ReflectedResource Resource(const char* name, ReflectedResourceType type, unsigned int bindIndex)
+{
+	ReflectedResource resource;
+	resource.Name = name;
+	resource.Type = type;
+	resource.BindIndex = bindIndex;
+	return resource;
+}
+
+// --------------------------------------------------------
+// A pixel shader with a gap in its texture slots (t0, t1 and
+// t3) and in its sampler slots (s0 and s2), so runs of slots
+// can be told apart
+// --------------------------------------------------------
+static bool WriteGappedShader()
+{
+	const char byteCode[] = "Stand-in byte code with gaps";
+	{
+		std::ofstream file("TestShaders/Gapped.cso", std::ios::binary);
+		file.write(byteCode, sizeof(byteCode));
+		if (!file)
+			return false;
+	}
+
+	ShaderReflectionData data;
+	data.ByteCodeHash = ShaderReflectionCache::HashByteCode(byteCode, sizeof(byteCode));
+	data.Resources.push_back(Resource("albedo", REFLECTED_SHADER_RESOURCE, 0));
+	data.Resources.push_back(Resource("normals", REFLECTED_SHADER_RESOURCE, 1));
+	data.Resources.push_back(Resource("shadows", REFLECTED_SHADER_RESOURCE, 3));
+	data.Resources.push_back(Resource("linear", REFLECTED_SAMPLER, 0));
+	data.Resources.push_back(Resource("comparison", REFLECTED_SAMPLER, 2));
+	return ShaderReflectionCache::Save("TestShaders/Gapped.cso.refl", data);
+}
+
+TEST(SimpleShaderBindsStagedRunsOnSet)
+{
+	CHECK(WriteTestShaders());
+	CHECK(WriteGappedShader());
+	NullRenderDevice device;
+	RecordingContext recorder(device.GetImmediateContext());
+	SimplePixelShader shader(&device);
+	CHECK(shader.LoadShaderFile(L"TestShaders/Gapped.cso"));
+	shader.SetRenderContext(&recorder);
+
+	// Nothing reaches the context until the shader is set
+	CHECK(shader.SetShaderResourceView("albedo", Fake<ID3D11ShaderResourceView>(1)));
+	CHECK(shader.SetShaderResourceView("normals", Fake<ID3D11ShaderResourceView>(2)));
+	CHECK(shader.SetShaderResourceView("shadows", Fake<ID3D11ShaderResourceView>(3)));
+	CHECK(shader.SetSamplerState("linear", Fake<ID3D11SamplerState>(1)));
+	CHECK(shader.SetSamplerState("comparison", Fake<ID3D11SamplerState>(2)));
+	CHECK(!shader.SetShaderResourceView("missing", Fake<ID3D11ShaderResourceView>(4)));
+	CHECK(!shader.SetSamplerState("missing", Fake<ID3D11SamplerState>(4)));
+	CHECK(recorder.Calls.empty());
+	CHECK(shader.GetBindingsStaged() == 5);
+	CHECK(shader.GetBindCalls() == 0);
+
+	// t0-t1 in one call, t3 in another, and each sampler on its own
+	shader.SetShader();
+	CHECK(recorder.Count("PSSetShader") == 1);
+	CHECK(recorder.Count("PSSetShaderResources") == 2);
+	CHECK(recorder.Count("PSSetSamplers") == 2);
+	CHECK(shader.GetBindCalls() == 4);
+	const RecordedCall& first = recorder.Calls[recorder.Calls.size() - 4];
+	CHECK(strcmp(first.Name, "PSSetShaderResources") == 0 && first.StartSlot == 0 && first.Count == 2);
+	CHECK(first.Objects[0] == Fake<ID3D11ShaderResourceView>(1) && first.Objects[1] == Fake<ID3D11ShaderResourceView>(2));
+	const RecordedCall* views = recorder.Last("PSSetShaderResources");
+	CHECK(views->StartSlot == 3 && views->Count == 1 && views->Objects[0] == Fake<ID3D11ShaderResourceView>(3));
+	const RecordedCall* samplers = recorder.Last("PSSetSamplers");
+	CHECK(samplers->StartSlot == 2 && samplers->Count == 1);
+
+	// Setting it again binds nothing more
+	recorder.Clear();
+	shader.SetShader();
+	CHECK(recorder.Count("PSSetShader") == 1);
+	CHECK(recorder.Count("PSSetShaderResources") == 0);
+	CHECK(recorder.Count("PSSetSamplers") == 0);
+	CHECK(shader.GetBindCalls() == 4);
+
+	// Only what changed, with the last value staged for a slot winning,
+	// whether it was set by name or by handle
+	recorder.Clear();
+	shader.SetShaderResourceView("normals", Fake<ID3D11ShaderResourceView>(5));
+	shader.SetShaderResourceView(shader.GetShaderResourceViewHandle("normals"), Fake<ID3D11ShaderResourceView>(6));
+	shader.SetSamplerState(shader.GetSamplerHandle(HashShaderName("comparison")), Fake<ID3D11SamplerState>(3));
+	shader.SetShader();
+	CHECK(recorder.Count("PSSetShaderResources") == 1);
+	views = recorder.Last("PSSetShaderResources");
+	CHECK(views->StartSlot == 1 && views->Count == 1 && views->Objects[0] == Fake<ID3D11ShaderResourceView>(6));
+	samplers = recorder.Last("PSSetSamplers");
+	CHECK(samplers && samplers->StartSlot == 2 && samplers->Objects[0] == Fake<ID3D11SamplerState>(3));
+	CHECK(shader.GetBindingsStaged() == 8);
+	CHECK(shader.GetBindCalls() == 6);
+
+	// Slots staged either side of one that wasn't go in separate
+	// calls, so the slot in between isn't sent again
+	recorder.Clear();
+	shader.ResetBindStats();
+	shader.SetShaderResourceView("albedo", Fake<ID3D11ShaderResourceView>(7));
+	shader.SetShaderResourceView("shadows", Fake<ID3D11ShaderResourceView>(8));
+	shader.SetShader();
+	CHECK(recorder.Count("PSSetShaderResources") == 2);
+	CHECK(shader.GetBindingsStaged() == 2 && shader.GetBindCalls() == 2);
+}
+
+TEST(SimpleShaderBindsOtherContextsRightAway)
+{
+	CHECK(WriteTestShaders());
+	CHECK(WriteGappedShader());
+	NullRenderDevice device;
+	RecordingContext recorder(device.GetImmediateContext());
+	RecordingContext other(device.GetImmediateContext());
+	SimplePixelShader shader(&device);
+	CHECK(shader.LoadShaderFile(L"TestShaders/Gapped.cso"));
+	shader.SetRenderContext(&recorder);
+
+	// A deferred context, say, gets its bindings straight away
+	CHECK(shader.SetShaderResourceView("shadows", Fake<ID3D11ShaderResourceView>(1), &other));
+	CHECK(shader.SetSamplerState("linear", Fake<ID3D11SamplerState>(1), &other));
+	CHECK(other.Count("PSSetShaderResources") == 1 && other.Count("PSSetSamplers") == 1);
+	CHECK(shader.GetBindingsStaged() == 0);
+
+	// And setting the shader on it leaves what's staged for the shader's own context
+	shader.SetShaderResourceView("albedo", Fake<ID3D11ShaderResourceView>(2));
+	shader.SetShader(&other);
+	CHECK(other.Count("PSSetShader") == 1);
+	CHECK(other.Count("PSSetShaderResources") == 1);
+	CHECK(recorder.Calls.empty());
+	shader.SetShader();
+	CHECK(recorder.Count("PSSetShaderResources") == 1);
+	CHECK(shader.GetBindCalls() == 1);
+}
+
+TEST(SimpleShaderStagesVertexShaderResources)
+{
+	CHECK(WriteTestShaders());
+	NullRenderDevice device;
+	RecordingContext recorder(device.GetImmediateContext());
+	SimpleVertexShader shader(&device);
+	CHECK(shader.LoadShaderFile(TEST_INSTANCED_VERTEX_SHADER));
+	shader.SetRenderContext(&recorder);
+
+	CHECK(shader.SetShaderResourceView("transforms", Fake<ID3D11ShaderResourceView>(1)));
+	CHECK(recorder.Count("VSSetShaderResources") == 0);
+	shader.SetShader();
+	shader.SetShader();
+	CHECK(recorder.Count("VSSetShader") == 2);
+	CHECK(recorder.Count("VSSetShaderResources") == 1);
+	CHECK(recorder.Count("PSSetShaderResources") == 0);
+	CHECK(shader.GetBindCalls() == 1);
+}
+
+TEST(StagedBindingsFlushesDirtyRuns)
+{
+	StagedBindings<ID3D11SamplerState> staged;
+	staged.Resize(8);
+	CHECK(!staged.IsDirty());
+	CHECK(!staged.Stage(8, Fake<ID3D11SamplerState>(1)));
+	CHECK(!staged.IsDirty());
+
+	unsigned int slots[] = { 6, 1, 2, 4, 2 };
+	for (unsigned int i = 0; i < 5; i++)
+		CHECK(staged.Stage(slots[i], Fake<ID3D11SamplerState>(slots[i])));
+	CHECK(staged.IsDirty());
+
+	std::vector<unsigned int> starts;
+	std::vector<unsigned int> counts;
+	unsigned int calls = staged.Flush([&](unsigned int startSlot, unsigned int count, ID3D11SamplerState* const* values)
+	{
+		starts.push_back(startSlot);
+		counts.push_back(count);
+		CHECK(values[0] == Fake<ID3D11SamplerState>(startSlot));
+	});
+	CHECK(calls == 3);
+	CHECK(starts.size() == 3);
+	CHECK(starts[0] == 1 && counts[0] == 2);
+	CHECK(starts[1] == 4 && counts[1] == 1);
+	CHECK(starts[2] == 6 && counts[2] == 1);
+
+	// Flushed means clean
+	CHECK(!staged.IsDirty());
+	calls = staged.Flush([&](unsigned int, unsigned int, ID3D11SamplerState* const*) { CHECK(false); });
+	CHECK(calls == 0);
+}
@@ -0,0 +1,233 @@
+#include "Test.h"
+#include "RecordingContext.h"
+#include "StateCache.h"
+#include "NullRenderContext.h"
+#include "NullRenderDevice.h"
+
+// Stand-ins for DirectX objects, which the cache only compares
+template<typename T>
+static T* Fake(unsigned int n)
+{
+	return (T*)(size_t)(0x1000 + n * 0x10);
+}
+
+TEST(StateCacheFiltersRepeatedBinds)
+{
+	NullRenderContext null;
+	RecordingContext recorder(&null);
+	StateCache cache(&recorder);
+
+	cache.PSSetShader(Fake<ID3D11PixelShader>(1));
+	cache.PSSetShader(Fake<ID3D11PixelShader>(1));
+	cache.PSSetShader(Fake<ID3D11PixelShader>(2));
+	cache.RSSetState(Fake<ID3D11RasterizerState>(1));
+	cache.RSSetState(Fake<ID3D11RasterizerState>(1));
+	cache.OMSetDepthStencilState(Fake<ID3D11DepthStencilState>(1), 0);
+	cache.OMSetDepthStencilState(Fake<ID3D11DepthStencilState>(1), 1);
+
+	CHECK(recorder.Count("PSSetShader") == 2);
+	CHECK(recorder.Count("RSSetState") == 1);
+	CHECK(recorder.Count("OMSetDepthStencilState") == 2);
+	CHECK(cache.GetIssuedCalls() == 5);
+	CHECK(cache.GetFilteredCalls() == 2);
+
+	// Null is a value like any other once it's known
+	cache.VSSetShader(0);
+	cache.VSSetShader(0);
+	CHECK(recorder.Count("VSSetShader") == 1);
+}
+
+TEST(StateCacheSendsOnlyChangedSpan)
+{
+	NullRenderContext null;
+	RecordingContext recorder(&null);
+	StateCache cache(&recorder);
+
+	ID3D11SamplerState* samplers[4] = { Fake<ID3D11SamplerState>(0), Fake<ID3D11SamplerState>(1), Fake<ID3D11SamplerState>(2), Fake<ID3D11SamplerState>(3) };
+	cache.PSSetSamplers(0, 4, samplers);
+	CHECK(recorder.Count("PSSetSamplers") == 1);
+
+	// Only slot 2 changed
+	samplers[2] = Fake<ID3D11SamplerState>(9);
+	cache.PSSetSamplers(0, 4, samplers);
+	const RecordedCall* call = recorder.Last("PSSetSamplers");
+	CHECK(call->StartSlot == 2 && call->Count == 1);
+	CHECK(call->Objects[0] == samplers[2]);
+
+	// Slots 1 and 3 changed, so 1 to 3 go, the unchanged 2 included
+	samplers[1] = Fake<ID3D11SamplerState>(10);
+	samplers[3] = Fake<ID3D11SamplerState>(11);
+	cache.PSSetSamplers(0, 4, samplers);
+	call = recorder.Last("PSSetSamplers");
+	CHECK(call->StartSlot == 1 && call->Count == 3);
+
+	// Nothing changed
+	cache.PSSetSamplers(0, 4, samplers);
+	CHECK(recorder.Count("PSSetSamplers") == 3);
+
+	// Stages are tracked apart
+	cache.VSSetSamplers(0, 4, samplers);
+	CHECK(recorder.Count("VSSetSamplers") == 1);
+}
+
+TEST(StateCacheMatchesVertexBufferStrideAndOffset)
+{
+	NullRenderContext null;
+	RecordingContext recorder(&null);
+	StateCache cache(&recorder);
+
+	ID3D11Buffer* buffer = Fake<ID3D11Buffer>(1);
+	unsigned int stride = 32;
+	unsigned int offset = 0;
+	cache.IASetVertexBuffers(0, 1, &buffer, &stride, &offset);
+	cache.IASetVertexBuffers(0, 1, &buffer, &stride, &offset);
+	CHECK(recorder.Count("IASetVertexBuffers") == 1);
+
+	offset = 64;
+	cache.IASetVertexBuffers(0, 1, &buffer, &stride, &offset);
+	stride = 16;
+	cache.IASetVertexBuffers(0, 1, &buffer, &stride, &offset);
+	CHECK(recorder.Count("IASetVertexBuffers") == 3);
+}
+
+TEST(StateCacheMatchesConstantBufferRanges)
+{
+	NullRenderContext null;
+	RecordingContext recorder(&null);
+	StateCache cache(&recorder);
+
+	ID3D11Buffer* buffer = Fake<ID3D11Buffer>(1);
+	unsigned int first = 16;
+	unsigned int count = 16;
+	cache.VSSetConstantBuffers1(0, 1, &buffer, &first, &count);
+	cache.VSSetConstantBuffers1(0, 1, &buffer, &first, &count);
+	CHECK(recorder.Count("VSSetConstantBuffers1") == 1);
+
+	// Same buffer, different range
+	first = 32;
+	cache.VSSetConstantBuffers1(0, 1, &buffer, &first, &count);
+	CHECK(recorder.Count("VSSetConstantBuffers1") == 2);
+
+	// A plain bind of the same buffer covers all of it, so it has to go
+	cache.VSSetConstantBuffers(0, 1, &buffer);
+	CHECK(recorder.Count("VSSetConstantBuffers") == 1);
+	cache.VSSetConstantBuffers(0, 1, &buffer);
+	CHECK(recorder.Count("VSSetConstantBuffers") == 1);
+
+	// And a whole buffer bind matches a range of 0/0
+	first = 0;
+	count = 0;
+	cache.VSSetConstantBuffers1(0, 1, &buffer, &first, &count);
+	CHECK(recorder.Count("VSSetConstantBuffers1") == 2);
+}
+
+// --------------------------------------------------------
+// A call that runs past the end of a slot table goes on to
+// DirectX as it is.  What it did to the slots that are in the
+// table isn't known, so they can't be filtered afterwards.
+// --------------------------------------------------------
+TEST(StateCacheForgetsSlotsOfOutOfRangeCalls)
+{
+	NullRenderContext null;
+	RecordingContext recorder(&null);
+	StateCache cache(&recorder);
+
+	ID3D11ShaderResourceView* view = Fake<ID3D11ShaderResourceView>(1);
+	ID3D11ShaderResourceView* others[4] = { Fake<ID3D11ShaderResourceView>(2), Fake<ID3D11ShaderResourceView>(2), Fake<ID3D11ShaderResourceView>(2), Fake<ID3D11ShaderResourceView>(2) };
+	unsigned int lastSlot = StateCache::ShaderResourceSlots - 1;
+	cache.PSSetShaderResources(lastSlot, 1, &view);
+	cache.PSSetShaderResources(lastSlot - 1, 4, others);
+	CHECK(recorder.Count("PSSetShaderResources") == 2);
+	cache.PSSetShaderResources(lastSlot, 1, &view);
+	CHECK(recorder.Count("PSSetShaderResources") == 3);
+
+	ID3D11Buffer* buffer = Fake<ID3D11Buffer>(1);
+	ID3D11Buffer* buffers[2] = { Fake<ID3D11Buffer>(2), Fake<ID3D11Buffer>(2) };
+	unsigned int strides[2] = { 16, 16 };
+	unsigned int offsets[2] = { 0, 0 };
+	unsigned int lastVertexSlot = StateCache::VertexBufferSlots - 1;
+	cache.IASetVertexBuffers(lastVertexSlot, 1, &buffer, strides, offsets);
+	cache.IASetVertexBuffers(lastVertexSlot, 2, buffers, strides, offsets);
+	cache.IASetVertexBuffers(lastVertexSlot, 1, &buffer, strides, offsets);
+	CHECK(recorder.Count("IASetVertexBuffers") == 3);
+
+	unsigned int firsts[2] = { 0, 0 };
+	unsigned int counts[2] = { 16, 16 };
+	unsigned int lastConstantSlot = StateCache::ConstantBufferSlots - 1;
+	cache.PSSetConstantBuffers1(lastConstantSlot, 1, &buffer, firsts, counts);
+	cache.PSSetConstantBuffers1(lastConstantSlot, 2, buffers, firsts, counts);
+	cache.PSSetConstantBuffers1(lastConstantSlot, 1, &buffer, firsts, counts);
+	CHECK(recorder.Count("PSSetConstantBuffers1") == 3);
+
+	cache.PSSetConstantBuffers(lastConstantSlot, 1, &buffer);
+	cache.PSSetConstantBuffers(lastConstantSlot, 2, buffers);
+	cache.PSSetConstantBuffers(lastConstantSlot, 1, &buffer);
+	CHECK(recorder.Count("PSSetConstantBuffers") == 3);
+
+	// Slots before the bad call's start are still known
+	cache.PSSetShaderResources(lastSlot - 2, 1, &view);
+	cache.PSSetShaderResources(lastSlot - 1, 4, others);
+	cache.PSSetShaderResources(lastSlot - 2, 1, &view);
+	CHECK(recorder.Count("PSSetShaderResources") == 5);
+}
+
+TEST(StateCacheInvalidatesOnCommandListExecute)
+{
+	NullRenderContext null;
+	RecordingContext recorder(&null);
+	StateCache cache(&recorder);
+
+	ID3D11InputLayout* layout = Fake<ID3D11InputLayout>(1);
+	cache.IASetInputLayout(layout);
+	cache.IASetPrimitiveTopology(4);
+	cache.ExecuteCommandList(Fake<ID3D11CommandList>(1));
+	cache.IASetInputLayout(layout);
+	cache.IASetPrimitiveTopology(4);
+	CHECK(recorder.Count("IASetInputLayout") == 2);
+	CHECK(recorder.Count("IASetPrimitiveTopology") == 2);
+
+	cache.Invalidate();
+	cache.IASetInputLayout(layout);
+	CHECK(recorder.Count("IASetInputLayout") == 3);
+
+	// Draws and uploads are never filtered
+	cache.DrawIndexed(3, 0, 0);
+	cache.DrawIndexed(3, 0, 0);
+	CHECK(recorder.Count("DrawIndexed") == 2);
+}
+
+// --------------------------------------------------------
+// The null context's uploaded bytes are the same writes that
+// RenderStats counts, with whole mapped buffers kept apart
+// --------------------------------------------------------
+TEST(NullRenderContextCountsMapsApartFromUploads)
+{
+	NullRenderDevice device;
+	BufferDesc desc = {};
+	desc.ByteWidth = 256;
+	desc.Usage = BUFFER_USAGE_DEFAULT;
+	ID3D11Buffer* source = device.CreateBuffer(desc, 0);
+	ID3D11Buffer* destination = device.CreateBuffer(desc, 0);
+
+	NullRenderContext null;
+	unsigned char data[64] = {};
+	null.UpdateSubresource(destination, data, 64);
+	null.UpdateSubresourceRange(destination, 32, data, 16);
+	null.CopyBufferRegion(destination, 0, source, 0, 100);
+	CHECK(null.GetBytesUploaded() == 64 + 16 + 100);
+	CHECK(null.GetBytesMapped() == 0);
+
+	// A discard maps the whole buffer, however little is written
+	null.MapDiscard(destination);
+	null.Unmap(destination);
+	null.MapNoOverwrite(destination);
+	null.Unmap(destination);
+	CHECK(null.GetBytesUploaded() == 64 + 16 + 100);
+	CHECK(null.GetBytesMapped() == 256);
+
+	null.ResetStats();
+	CHECK(null.GetBytesUploaded() == 0 && null.GetBytesMapped() == 0);
+
+	device.Release(source);
+	device.Release(destination);
+}
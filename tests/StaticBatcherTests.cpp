@@ -0,0 +1,283 @@
+#include "Test.h"
+#include "TestShaders.h"
+#include "StaticBatcher.h"
+#include "NullRenderDevice.h"
+#include "RecordingContext.h"
+
+using namespace DirectX;
+
+static Mesh* MakeTriangle(IRenderDevice* device)
+{
+	Vertex vertices[3] = {};
+	vertices[1].Position = XMFLOAT3(1, 0, 0);
+	vertices[2].Position = XMFLOAT3(0, 1, 0);
+	unsigned int indices[3] = { 0, 1, 2 };
+	return new Mesh(device, vertices, 3, indices, 3, 0);
+}
+
+// Static entities with the given mesh and material, one at each x
+static void AddStaticEntities(std::vector<Entity>& entities, Mesh* mesh, Material* material, const float* xs, unsigned int count)
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		Entity entity(mesh, material);
+		entity.SetPosition(XMFLOAT3(xs[i], 0, 0));
+		entity.SetStatic(true);
+		entity.Update(0, 0);
+		entities.push_back(entity);
+	}
+}
+
+static bool IsRange(const RecordedCall* call, unsigned int startIndex, unsigned int indexCount)
+{
+	return call && strcmp(call->Name, "DrawIndexed") == 0 && call->StartSlot == startIndex && call->Count == indexCount;
+}
+
+// --------------------------------------------------------
+// The batcher notices for itself when the static entities it
+// merged have changed, without anyone calling MarkDirty()
+// --------------------------------------------------------
+TEST(StaticBatcherNoticesChangedEntities)
+{
+	CHECK(WriteTestShaders());
+	NullRenderDevice device;
+	SimpleVertexShader vertexShader(&device);
+	SimplePixelShader pixelShader(&device);
+	CHECK(vertexShader.LoadShaderFile(TEST_VERTEX_SHADER));
+	CHECK(pixelShader.LoadShaderFile(TEST_PIXEL_SHADER));
+	Material material(&vertexShader, &pixelShader, 0, 0);
+	Material otherMaterial(&vertexShader, &pixelShader, 0, 0);
+	Mesh* triangle = MakeTriangle(&device);
+	Mesh* otherTriangle = MakeTriangle(&device);
+
+	std::vector<Entity> entities;
+	for (int i = 0; i < 4; i++)
+	{
+		Entity entity(triangle, &material);
+		entity.SetPosition(XMFLOAT3((float)i, 0, 0));
+		entity.SetStatic(i < 3);
+		entity.Update(0, 0);
+		entities.push_back(entity);
+	}
+
+	StaticBatcher batcher(&device);
+	CHECK(batcher.IsOutOfDate(entities));
+	batcher.Build(entities);
+	CHECK(batcher.GetBatchedEntityCount() == 3);
+	CHECK(batcher.GetBatches().size() == 1);
+	CHECK(!batcher.IsOutOfDate(entities));
+
+	// Movable entities can move all they like
+	entities[3].Move(XMFLOAT3(0, 0, 0), XMFLOAT3(0, 1, 0));
+	entities[3].Update(0, 0);
+	CHECK(!batcher.IsOutOfDate(entities));
+
+	// A static one moving (once its world matrix has changed) can't be missed
+	entities[0].Move(XMFLOAT3(0, 0, 0), XMFLOAT3(0, 1, 0));
+	CHECK(!batcher.IsOutOfDate(entities));
+	entities[0].Update(0, 0);
+	CHECK(batcher.IsOutOfDate(entities));
+	batcher.Build(entities);
+	CHECK(!batcher.IsOutOfDate(entities));
+
+	// Nor can one becoming static, or stopping being static
+	entities[3].SetStatic(true);
+	CHECK(batcher.IsOutOfDate(entities));
+	batcher.Build(entities);
+	CHECK(batcher.GetBatchedEntityCount() == 4);
+	entities[1].SetStatic(false);
+	CHECK(batcher.IsOutOfDate(entities));
+	batcher.Build(entities);
+	CHECK(batcher.GetBatchedEntityCount() == 3);
+	CHECK(!batcher.IsBatched(1));
+
+	// Another mesh or material
+	entities[2].SetMesh(otherTriangle);
+	CHECK(batcher.IsOutOfDate(entities));
+	batcher.Build(entities);
+	entities[2] = Entity(otherTriangle, &otherMaterial);
+	entities[2].SetStatic(true);
+	CHECK(batcher.IsOutOfDate(entities));
+	batcher.Build(entities);
+	CHECK(batcher.GetBatchedEntityCount() == 3);
+
+	// Entities added or removed
+	entities.push_back(entities[0]);
+	CHECK(batcher.IsOutOfDate(entities));
+	batcher.Build(entities);
+	entities.pop_back();
+	CHECK(batcher.IsOutOfDate(entities));
+	batcher.Build(entities);
+
+	// And anything else still needs telling
+	CHECK(!batcher.IsOutOfDate(entities));
+	batcher.MarkDirty();
+	CHECK(batcher.IsOutOfDate(entities));
+	CHECK(batcher.GetBuildCount() == 8);
+
+	delete triangle;
+	delete otherTriangle;
+}
+
+// --------------------------------------------------------
+// Different materials are never merged, even ones that were
+// never registered and so share material ID 0
+// --------------------------------------------------------
+TEST(StaticBatcherSplitsByMaterial)
+{
+	CHECK(WriteTestShaders());
+	NullRenderDevice device;
+	SimpleVertexShader vertexShader(&device);
+	SimplePixelShader pixelShader(&device);
+	CHECK(vertexShader.LoadShaderFile(TEST_VERTEX_SHADER));
+	CHECK(pixelShader.LoadShaderFile(TEST_PIXEL_SHADER));
+	Material first(&vertexShader, &pixelShader, 0, 0);
+	Material second(&vertexShader, &pixelShader, 0, 0);
+	CHECK(first.GetID() == second.GetID());
+	Mesh* triangle = MakeTriangle(&device);
+
+	std::vector<Entity> entities;
+	const float xs[] = { 0, 1, 2 };
+	AddStaticEntities(entities, triangle, &first, xs, 3);
+	AddStaticEntities(entities, triangle, &second, xs, 3);
+	entities[1] = Entity(triangle, &second);
+	entities[1].SetStatic(true);
+	entities[1].Update(0, 0);
+
+	StaticBatcher batcher(&device);
+	batcher.Build(entities);
+	const std::vector<StaticBatch>& batches = batcher.GetBatches();
+	CHECK(batches.size() == 2);
+	CHECK(batcher.GetBatchedEntityCount() == 6);
+	for (size_t b = 0; b < batches.size(); b++)
+		CHECK(batches[b].RangeCount == (batches[b].SourceMaterial == &first ? 2u : 4u));
+	CHECK(batches[0].SourceMaterial != batches[1].SourceMaterial);
+
+	delete triangle;
+}
+
+TEST(StaticBatcherSplitsByCellAndVertexLimit)
+{
+	CHECK(WriteTestShaders());
+	NullRenderDevice device;
+	SimpleVertexShader vertexShader(&device);
+	SimplePixelShader pixelShader(&device);
+	CHECK(vertexShader.LoadShaderFile(TEST_VERTEX_SHADER));
+	CHECK(pixelShader.LoadShaderFile(TEST_PIXEL_SHADER));
+	Material material(&vertexShader, &pixelShader, 0, 0);
+	Mesh* triangle = MakeTriangle(&device);
+
+	// Cells 10 units across: two entities in the first, then one in
+	// each of the next two, given out of order
+	std::vector<Entity> entities;
+	const float xs[] = { 25, 0, 12, 2 };
+	AddStaticEntities(entities, triangle, &material, xs, 4);
+
+	StaticBatcher batcher(&device);
+	batcher.SetCellSize(10.0f);
+	batcher.Build(entities);
+	const std::vector<StaticBatch>& batches = batcher.GetBatches();
+	CHECK(batches.size() == 3);
+	if (batches.size() == 3)
+	{
+		CHECK(batches[0].FirstRange == 0 && batches[0].RangeCount == 2 && batches[0].IndexCount == 6);
+		CHECK(batches[1].FirstRange == 2 && batches[1].RangeCount == 1 && batches[1].IndexCount == 3);
+		CHECK(batches[2].FirstRange == 3 && batches[2].RangeCount == 1 && batches[2].IndexCount == 3);
+
+		// A batch's bounds hold all of its entities
+		CHECK(batches[0].BoundsCenter.x > 0.0f && batches[0].BoundsCenter.x < 3.0f);
+		CHECK(batches[0].BoundsRadius >= entities[1].GetBoundsRadius() + 1.0f);
+	}
+	CHECK(batcher.GetBatchedVertexCount() == 12);
+
+	// Seven vertices per batch fit two triangles: the five in one cell
+	// become batches of two, two and one
+	entities.clear();
+	const float near[] = { 0, 1, 2, 3, 4 };
+	AddStaticEntities(entities, triangle, &material, near, 5);
+	batcher.SetCellSize(32.0f);
+	batcher.SetMaxVerticesPerBatch(7);
+	batcher.Build(entities);
+	CHECK(batches.size() == 3);
+	if (batches.size() == 3)
+	{
+		CHECK(batches[0].RangeCount == 2 && batches[0].IndexCount == 6);
+		CHECK(batches[1].RangeCount == 2 && batches[1].IndexCount == 6);
+		CHECK(batches[2].RangeCount == 1 && batches[2].IndexCount == 3);
+	}
+
+	// Every entity drawn once, whichever batch it's in
+	for (unsigned int i = 0; i < 5; i++)
+		CHECK(batcher.IsBatched(i));
+	CHECK(batcher.GetBatchedVertexCount() == 15);
+
+	delete triangle;
+}
+
+// --------------------------------------------------------
+// Hidden entities leave gaps in a batch's index buffer, and
+// the visible runs either side are drawn separately
+// --------------------------------------------------------
+TEST(StaticBatcherDrawsAroundHiddenEntities)
+{
+	CHECK(WriteTestShaders());
+	NullRenderDevice device;
+	RecordingContext recorder(device.GetImmediateContext());
+	SimpleVertexShader vertexShader(&device);
+	SimplePixelShader pixelShader(&device);
+	CHECK(vertexShader.LoadShaderFile(TEST_VERTEX_SHADER));
+	CHECK(pixelShader.LoadShaderFile(TEST_PIXEL_SHADER));
+	Material material(&vertexShader, &pixelShader, 0, 0);
+	Mesh* triangle = MakeTriangle(&device);
+
+	std::vector<Entity> entities;
+	const float xs[] = { 0, 1, 2, 3, 4 };
+	AddStaticEntities(entities, triangle, &material, xs, 5);
+	StaticBatcher batcher(&device);
+	batcher.Build(entities);
+	CHECK(batcher.GetBatches().size() == 1);
+
+	// Nothing hidden is one draw of everything
+	CHECK(batcher.DrawBatch(&recorder, 0) == 1);
+	CHECK(IsRange(recorder.Last("DrawIndexed"), 0, 15));
+	CHECK(recorder.Count("IASetVertexBuffers") == 1 && recorder.Count("IASetIndexBuffer") == 1);
+
+	// Hiding the second and fourth leaves three runs of one
+	recorder.Clear();
+	batcher.SetHidden(1, true);
+	batcher.SetHidden(3, true);
+	batcher.SetHidden(3, true);
+	CHECK(batcher.GetBatches()[0].HiddenCount == 2);
+	CHECK(batcher.DrawBatch(&recorder, 0) == 3);
+	CHECK(recorder.Count("DrawIndexed") == 3);
+	if (recorder.Calls.size() == 5)
+	{
+		CHECK(IsRange(&recorder.Calls[2], 0, 3));
+		CHECK(IsRange(&recorder.Calls[3], 6, 3));
+		CHECK(IsRange(&recorder.Calls[4], 12, 3));
+	}
+
+	// Neighbours are still drawn together
+	recorder.Clear();
+	batcher.SetHidden(1, false);
+	CHECK(batcher.DrawBatch(&recorder, 0) == 2);
+	CHECK(recorder.Count("DrawIndexed") == 2);
+	if (recorder.Calls.size() == 4)
+	{
+		CHECK(IsRange(&recorder.Calls[2], 0, 9));
+		CHECK(IsRange(&recorder.Calls[3], 12, 3));
+	}
+
+	// With everything hidden nothing is bound or drawn
+	recorder.Clear();
+	for (unsigned int i = 0; i < 5; i++)
+		batcher.SetHidden(i, true);
+	CHECK(batcher.DrawBatch(&recorder, 0) == 0);
+	CHECK(recorder.Calls.empty());
+
+	// Entities that aren't batched are left alone
+	batcher.SetHidden(7, true);
+	CHECK(batcher.GetBatches()[0].HiddenCount == 5);
+
+	delete triangle;
+}
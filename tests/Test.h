@@ -0,0 +1,31 @@
+#pragma once
+
+// --------------------------------------------------------
+// Just enough of a test framework for RunTests.  Each TEST
+// registers itself before main() runs, and a failed CHECK
+// prints where it was and carries on with the rest of the
+// test, so one run shows every failure.
+//
+//   TEST(RingAllocatorWrapsToStart)
+//   {
+//       CHECK(ring.Allocate(16, 16, offset));
+//   }
+// --------------------------------------------------------
+#include <string>
+
+typedef void (*TestFunction)();
+
+bool RegisterTest(const char* name, TestFunction function);
+void ReportFailure(const char* file, int line, const char* expression);
+
+// A file in the repository (like "DX11Starter/resources"), from
+// whichever directory the tests are run in
+std::string GetRepositoryPath(const std::string& relativePath);
+
+#define TEST(name) \
+	static void name(); \
+	static bool name##Registered = RegisterTest(#name, name); \
+	static void name()
+
+#define CHECK(expression) \
+	do { if (!(expression)) ReportFailure(__FILE__, __LINE__, #expression); } while (0)
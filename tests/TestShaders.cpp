@@ -0,0 +1,109 @@
+#include "TestShaders.h"
+#include "ShaderReflectionCache.h"
+#include "D3D11Types.h"
+#include "Platform.h"
+
+#include <fstream>
+
+static ReflectedVariable Variable(const char* name, unsigned int byteOffset, unsigned int size)
+{
+	ReflectedVariable variable;
+	variable.Name = name;
+	variable.ByteOffset = byteOffset;
+	variable.Size = size;
+	return variable;
+}
+
+static ReflectedResource Resource(const char* name, ReflectedResourceType type, unsigned int bindIndex)
+{
+	ReflectedResource resource;
+	resource.Name = name;
+	resource.Type = type;
+	resource.BindIndex = bindIndex;
+	return resource;
+}
+
+static ReflectedInputElement Input(const char* semanticName, unsigned int format, bool perInstance)
+{
+	ReflectedInputElement element;
+	element.SemanticName = semanticName;
+	element.SemanticIndex = 0;
+	element.Format = format;
+	element.PerInstance = perInstance;
+	return element;
+}
+
+// The byte code is just the shader's name, which is enough to hash
+static bool WriteShader(const std::wstring& file, ShaderReflectionData data)
+{
+	std::string path(file.begin(), file.end());
+	std::string byteCode = "Stand-in byte code for " + path;
+	{
+		std::ofstream stream(path.c_str(), std::ios::binary);
+		stream << byteCode;
+		if (!stream)
+			return false;
+	}
+
+	data.ByteCodeHash = ShaderReflectionCache::HashByteCode(byteCode.data(), byteCode.size());
+	return ShaderReflectionCache::Save(path + ".refl", data);
+}
+
+bool WriteTestShaders()
+{
+	MakeDirectory(L"TestShaders");
+
+	// VertexShader.hlsl
+	ShaderReflectionData vertexShader;
+	ReflectedConstantBuffer externalData;
+	externalData.Name = "externalData";
+	externalData.BindIndex = 0;
+	externalData.Size = 208;
+	externalData.Variables.push_back(Variable("world", 0, 64));
+	externalData.Variables.push_back(Variable("view", 64, 64));
+	externalData.Variables.push_back(Variable("projection", 128, 64));
+	externalData.Variables.push_back(Variable("textureSlice", 192, 4));
+	vertexShader.ConstantBuffers.push_back(externalData);
+	vertexShader.InputElements.push_back(Input("POSITION", DXGI_FORMAT_R32G32B32_FLOAT, false));
+	vertexShader.InputElements.push_back(Input("NORMAL", DXGI_FORMAT_R32G32B32_FLOAT, false));
+	vertexShader.InputElements.push_back(Input("TEXCOORD", DXGI_FORMAT_R32G32_FLOAT, false));
+
+	// VertexShaderInstanced.hlsl
+	ShaderReflectionData instancedVertexShader;
+	ReflectedConstantBuffer instancedData;
+	instancedData.Name = "externalData";
+	instancedData.BindIndex = 0;
+	instancedData.Size = 128;
+	instancedData.Variables.push_back(Variable("view", 0, 64));
+	instancedData.Variables.push_back(Variable("projection", 64, 64));
+	instancedVertexShader.ConstantBuffers.push_back(instancedData);
+	instancedVertexShader.Resources.push_back(Resource("transforms", REFLECTED_SHADER_RESOURCE, 0));
+	instancedVertexShader.InputElements = vertexShader.InputElements;
+	instancedVertexShader.InputElements.push_back(Input("TRANSFORM_PER_INSTANCE", DXGI_FORMAT_R32_UINT, true));
+	instancedVertexShader.InputElements.push_back(Input("SLICE_PER_INSTANCE", DXGI_FORMAT_R32_UINT, true));
+
+	// PixelShader.hlsl
+	ShaderReflectionData pixelShader;
+	ReflectedConstantBuffer lightData;
+	lightData.Name = "lightData";
+	lightData.BindIndex = 0;
+	lightData.Size = 192;
+	lightData.Variables.push_back(Variable("lights", 0, 192));
+	ReflectedConstantBuffer materialData;
+	materialData.Name = "materialData";
+	materialData.BindIndex = 1;
+	materialData.Size = 32;
+	materialData.Variables.push_back(Variable("tint", 0, 16));
+	materialData.Variables.push_back(Variable("uvScale", 16, 8));
+	materialData.Variables.push_back(Variable("uvOffset", 24, 8));
+	pixelShader.ConstantBuffers.push_back(lightData);
+	pixelShader.ConstantBuffers.push_back(materialData);
+	pixelShader.Resources.push_back(Resource("textureBaseColor", REFLECTED_SHADER_RESOURCE, 0));
+	pixelShader.Resources.push_back(Resource("textureMaterialMaps", REFLECTED_SHADER_RESOURCE, 1));
+	pixelShader.Resources.push_back(Resource("samplerState", REFLECTED_SAMPLER, 0));
+
+	return
+		WriteShader(TEST_VERTEX_SHADER, vertexShader) &&
+		WriteShader(TEST_INSTANCED_VERTEX_SHADER, instancedVertexShader) &&
+		WriteShader(TEST_PIXEL_SHADER, pixelShader);
+}
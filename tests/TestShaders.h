@@ -0,0 +1,20 @@
+#pragma once
+
+// --------------------------------------------------------
+// Stand-ins for the game's compiled shaders, for tests that
+// need SimpleShaders (and materials) without a shader
+// compiler.  Each .cso holds a few bytes of made up byte code,
+// next to a reflection sidecar describing the real shader's
+// constant buffers, resources and inputs.  SimpleShader loads
+// the sidecar instead of reflecting, so these load anywhere,
+// and the null render device takes any byte code.
+//
+// WriteTestShaders() writes them into a TestShaders folder in
+// the working directory, which is the test's own scratch
+// directory, so each test that needs them writes them again.
+// --------------------------------------------------------
+bool WriteTestShaders();
+
+#define TEST_VERTEX_SHADER				L"TestShaders/VertexShader.cso"
+#define TEST_INSTANCED_VERTEX_SHADER	L"TestShaders/VertexShaderInstanced.cso"
+#define TEST_PIXEL_SHADER				L"TestShaders/PixelShader.cso"
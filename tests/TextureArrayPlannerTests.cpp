@@ -0,0 +1,141 @@
+#include "Test.h"
+#include "TextureArrayPlanner.h"
+#include "TextureArrayBuilder.h"
+#include "NullRenderDevice.h"
+
+static TextureDesc Shape(unsigned int width, unsigned int height, unsigned int mipLevels = 0, unsigned int format = 28)
+{
+	TextureDesc desc = { width, height, mipLevels, format };
+	return desc;
+}
+
+TEST(TextureArrayPlannerGroupsByShape)
+{
+	// Two shapes interleaved, plus ones differing only in mips or format
+	TextureDesc textures[] =
+	{
+		Shape(512, 512), Shape(256, 256), Shape(512, 512), Shape(256, 256),
+		Shape(512, 512, 1), Shape(512, 512, 0, 29), Shape(512, 512)
+	};
+	TextureArrayPlanner planner;
+	CHECK(planner.Plan(textures, 7));
+	CHECK(planner.GetTextureCount() == 7);
+
+	// Arrays in the order their first texture came, slices in the order given
+	const std::vector<TextureArrayGroup>& arrays = planner.GetArrays();
+	CHECK(arrays.size() == 4);
+	CHECK(arrays[0].Sources.size() == 3);
+	CHECK(arrays[0].Sources[0] == 0 && arrays[0].Sources[1] == 2 && arrays[0].Sources[2] == 6);
+	CHECK(arrays[1].Sources.size() == 2 && arrays[1].Sources[1] == 3);
+	CHECK(arrays[1].Shape.Width == 256);
+	CHECK(arrays[2].Sources.size() == 1 && arrays[2].Sources[0] == 4);
+	CHECK(arrays[3].Sources.size() == 1 && arrays[3].Sources[0] == 5);
+
+	CHECK(planner.GetSlot(6).Array == 0 && planner.GetSlot(6).Slice == 2);
+	CHECK(planner.GetSlot(3).Array == 1 && planner.GetSlot(3).Slice == 1);
+	CHECK(planner.GetSlot(5).Array == 3 && planner.GetSlot(5).Slice == 0);
+
+	CHECK(TextureArrayPlanner::SameShape(textures[0], textures[6]));
+	CHECK(!TextureArrayPlanner::SameShape(textures[0], textures[4]));
+	CHECK(!TextureArrayPlanner::SameShape(textures[0], textures[5]));
+}
+
+TEST(TextureArrayPlannerSplitsFullArrays)
+{
+	// Five of one shape around two of another, at most two slices each
+	TextureDesc textures[] =
+	{
+		Shape(64, 64), Shape(64, 64), Shape(32, 32), Shape(64, 64),
+		Shape(64, 64), Shape(32, 32), Shape(64, 64)
+	};
+	TextureArrayPlanner planner;
+	CHECK(planner.Plan(textures, 7, 2));
+
+	// The second 64x64 array starts after the 32x32 one
+	const std::vector<TextureArrayGroup>& arrays = planner.GetArrays();
+	CHECK(arrays.size() == 4);
+	CHECK(arrays[0].Sources.size() == 2);
+	CHECK(arrays[1].Sources.size() == 2 && arrays[1].Shape.Width == 32);
+	CHECK(arrays[2].Sources.size() == 2 && arrays[2].Sources[0] == 3);
+	CHECK(arrays[3].Sources.size() == 1 && arrays[3].Sources[0] == 6);
+	CHECK(planner.GetSlot(4).Array == 2 && planner.GetSlot(4).Slice == 1);
+	CHECK(planner.GetSlot(6).Array == 3 && planner.GetSlot(6).Slice == 0);
+
+	// Every texture in a slot of its own
+	for (unsigned int i = 0; i < 7; i++)
+	{
+		const TextureArraySlot& slot = planner.GetSlot(i);
+		CHECK(arrays[slot.Array].Sources[slot.Slice] == i);
+	}
+
+	// One slice each is an array per texture
+	CHECK(planner.Plan(textures, 7, 1));
+	CHECK(planner.GetArrays().size() == 7);
+}
+
+TEST(TextureArrayPlannerRejectsBadInput)
+{
+	TextureDesc textures[] = { Shape(64, 64), Shape(64, 0), Shape(64, 64) };
+	TextureArrayPlanner planner;
+
+	// Failures leave nothing of an earlier plan behind
+	CHECK(planner.Plan(textures, 1));
+	CHECK(!planner.Plan(textures, 3));
+	CHECK(planner.GetArrays().empty() && planner.GetTextureCount() == 0);
+
+	CHECK(planner.Plan(textures, 1));
+	CHECK(!planner.Plan(textures, 1, 0));
+	CHECK(planner.GetArrays().empty() && planner.GetTextureCount() == 0);
+
+	// Nothing to plan is a plan of nothing
+	CHECK(planner.Plan(0, 0));
+	CHECK(planner.GetArrays().empty());
+}
+
+TEST(TextureArrayBuilderMakesPlannedArrays)
+{
+	NullRenderDevice device;
+	ID3D11ShaderResourceView* textures[] =
+	{
+		device.CreateTexture2D(Shape(64, 64), 0, 0),
+		device.CreateTexture2D(Shape(32, 32), 0, 0),
+		device.CreateTexture2D(Shape(64, 64), 0, 0)
+	};
+	{
+		TextureArrayBuilder builder(&device);
+		for (unsigned int i = 0; i < 3; i++)
+			CHECK(builder.Add(textures[i]) == i);
+
+		// Not built yet
+		CHECK(builder.GetArray(0) == 0);
+
+		CHECK(builder.Build());
+		CHECK(builder.GetArrayCount() == 2);
+		CHECK(builder.GetArray(0) != 0 && builder.GetArray(0) == builder.GetArray(2));
+		CHECK(builder.GetArray(1) != builder.GetArray(0));
+		CHECK(builder.GetSlice(2) == 1 && builder.GetSlice(1) == 0);
+		CHECK(builder.GetArray(3) == 0);
+
+		TextureDesc desc;
+		CHECK(device.GetTextureDesc(builder.GetArray(1), desc) && desc.Width == 32);
+		CHECK(device.GetObjectsAlive(NullRenderDevice::OBJECT_TEXTURE) == 5);
+
+		// Building again replaces the arrays rather than adding to them
+		CHECK(builder.Build(1));
+		CHECK(builder.GetArrayCount() == 3);
+		CHECK(device.GetObjectsAlive(NullRenderDevice::OBJECT_TEXTURE) == 6);
+
+		// Something the device didn't make fails the whole build
+		builder.Add((ID3D11ShaderResourceView*)0);
+		CHECK(!builder.Build());
+		CHECK(builder.GetArrayCount() == 0);
+		CHECK(device.GetObjectsAlive(NullRenderDevice::OBJECT_TEXTURE) == 3);
+		CHECK(builder.GetArray(0) == 0);
+	}
+
+	// The arrays go with the builder, the textures added stay
+	CHECK(device.GetObjectsAlive(NullRenderDevice::OBJECT_TEXTURE) == 3);
+	for (unsigned int i = 0; i < 3; i++)
+		device.Release(textures[i]);
+	CHECK(device.GetObjectsAlive(NullRenderDevice::OBJECT_TEXTURE) == 0);
+}
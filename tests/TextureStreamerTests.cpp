@@ -0,0 +1,169 @@
+#include "Test.h"
+#include "TextureStreamer.h"
+#include "NullRenderDevice.h"
+#include "D3D11Types.h"
+
+#include <utility>
+
+// --------------------------------------------------------
+// A source that makes up its texels, and logs every mip read
+// from it as (tag, mip) so the tests can see the order
+// --------------------------------------------------------
+class FakeStreamSource : public ITextureStreamSource
+{
+public:
+	FakeStreamSource(int tag, unsigned int width, unsigned int height, std::vector<std::pair<int, unsigned int> >* log, bool fail = false)
+		: tag(tag), width(width), height(height), log(log), fail(fail) { }
+
+	bool Open(TextureDesc& desc, std::vector<unsigned char>& placeholder)
+	{
+		desc.Width = width;
+		desc.Height = height;
+		desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		placeholder.assign(4, 128);
+		return true;
+	}
+
+	bool ReadMip(unsigned int mip, std::vector<unsigned char>& texels, unsigned int& rowPitch)
+	{
+		log->push_back(std::make_pair(tag, mip));
+		if (fail)
+			return false;
+
+		unsigned int w = width >> mip;
+		unsigned int h = height >> mip;
+		if (w == 0) w = 1;
+		if (h == 0) h = 1;
+		rowPitch = w * 4;
+		texels.assign((size_t)rowPitch * h, (unsigned char)mip);
+		return true;
+	}
+
+private:
+	int tag;
+	unsigned int width;
+	unsigned int height;
+	std::vector<std::pair<int, unsigned int> >* log;
+	bool fail;
+};
+
+// One frame, in the order the game does it
+static void StreamFrame(TextureStreamer& streamer, UploadManager& uploads)
+{
+	streamer.Update();
+	uploads.ProcessFrame();
+}
+
+TEST(TextureStreamerReadsSmallestMipFirst)
+{
+	NullRenderDevice device;
+	UploadManager uploads(&device, device.GetImmediateContext(), 4096, 4);
+	TextureStreamer streamer(&device, device.GetImmediateContext(), &uploads, false);
+
+	std::vector<std::pair<int, unsigned int> > log;
+	StreamedTextureID id = streamer.Add(new FakeStreamSource(1, 16, 8, &log));
+	CHECK(id != 0);
+	CHECK(streamer.GetMipLevels(id) == 5);
+
+	// Only the placeholder is there, so nothing real is resident
+	CHECK(streamer.GetResidentMip(id) == 5);
+	CHECK(!streamer.IsFullyStreamed(id));
+	CHECK(log.empty());
+
+	// The first read is the source's own 1x1 mip
+	streamer.ReportScreenSize(id, 1000.0f);
+	StreamFrame(streamer, uploads);
+	CHECK(log.size() == 1);
+	CHECK(log[0].second == 4);
+
+	for (int frame = 0; frame < 40 && !streamer.IsFullyStreamed(id); frame++)
+	{
+		streamer.ReportScreenSize(id, 1000.0f);
+		StreamFrame(streamer, uploads);
+
+		// Resident only moves once a mip's upload has completed
+		CHECK(streamer.GetResidentMip(id) >= 5 - log.size());
+	}
+
+	// Every mip, smallest to largest, each read once
+	CHECK(streamer.IsFullyStreamed(id));
+	CHECK(streamer.GetResidentMip(id) == 0);
+	CHECK(log.size() == 5);
+	for (size_t i = 0; i < log.size(); i++)
+		CHECK(log[i].second == 4 - i);
+	CHECK(streamer.GetMipsStreamed() == 5);
+	CHECK(streamer.GetFailedReads() == 0);
+}
+
+TEST(TextureStreamerStreamsSmallestMipUnseen)
+{
+	NullRenderDevice device;
+	UploadManager uploads(&device, device.GetImmediateContext(), 4096, 4);
+	TextureStreamer streamer(&device, device.GetImmediateContext(), &uploads, false);
+
+	// Never reported on screen, so it only wants its smallest mip, but
+	// that still has to come from the source rather than the placeholder
+	std::vector<std::pair<int, unsigned int> > log;
+	StreamedTextureID id = streamer.Add(new FakeStreamSource(1, 32, 32, &log));
+	for (int frame = 0; frame < 10; frame++)
+		StreamFrame(streamer, uploads);
+
+	CHECK(log.size() == 1);
+	CHECK(log[0].second == 5);
+	CHECK(streamer.GetResidentMip(id) == 5);
+	CHECK(streamer.IsFullyStreamed(id));
+}
+
+TEST(TextureStreamerReadsLargestOnScreenFirst)
+{
+	NullRenderDevice device;
+	UploadManager uploads(&device, device.GetImmediateContext(), 4096, 4);
+	TextureStreamer streamer(&device, device.GetImmediateContext(), &uploads, false);
+	streamer.SetMaxReads(1);
+
+	std::vector<std::pair<int, unsigned int> > log;
+	StreamedTextureID small = streamer.Add(new FakeStreamSource(1, 64, 64, &log));
+	StreamedTextureID large = streamer.Add(new FakeStreamSource(2, 64, 64, &log));
+	StreamedTextureID unseen = streamer.Add(new FakeStreamSource(3, 64, 64, &log));
+
+	// Biggest on screen goes first even though it was added later, and
+	// the one that isn't on screen waits while the others still want mips
+	for (int frame = 0; frame < 6; frame++)
+	{
+		streamer.ReportScreenSize(small, 4.0f);
+		streamer.ReportScreenSize(large, 50.0f);
+		StreamFrame(streamer, uploads);
+
+		// Only one read at a time, even with three textures waiting
+		CHECK(log.size() == (size_t)frame + 1);
+	}
+
+	CHECK(log[0].first == 2);
+	CHECK(log[1].first == 1);
+	for (size_t i = 0; i < log.size(); i++)
+		CHECK(log[i].first != 3);
+	CHECK(streamer.GetWantedMip(large) < streamer.GetWantedMip(small));
+	CHECK(streamer.GetWantedMip(unseen) == 6);
+}
+
+TEST(TextureStreamerStopsOnFailedRead)
+{
+	NullRenderDevice device;
+	UploadManager uploads(&device, device.GetImmediateContext(), 4096, 4);
+	TextureStreamer streamer(&device, device.GetImmediateContext(), &uploads, false);
+
+	std::vector<std::pair<int, unsigned int> > log;
+	StreamedTextureID id = streamer.Add(new FakeStreamSource(1, 16, 16, &log, true));
+	for (int frame = 0; frame < 10; frame++)
+	{
+		streamer.ReportScreenSize(id, 1000.0f);
+		StreamFrame(streamer, uploads);
+	}
+
+	// Tried once, then left on the placeholder
+	CHECK(log.size() == 1);
+	CHECK(streamer.GetFailedReads() == 1);
+	CHECK(streamer.GetResidentMip(id) == 5);
+	CHECK(!streamer.IsFullyStreamed(id));
+	CHECK(streamer.GetReadsInFlight() == 0);
+}
@@ -0,0 +1,202 @@
+#include "Test.h"
+#include "RecordingContext.h"
+#include "UploadManager.h"
+#include "NullRenderDevice.h"
+#include "D3D11Types.h"
+
+#include <cstring>
+
+static ID3D11Buffer* CreateDestination(NullRenderDevice& device, unsigned int byteSize)
+{
+	BufferDesc desc = {};
+	desc.ByteWidth = byteSize;
+	desc.Usage = BUFFER_USAGE_DEFAULT;
+	return device.CreateBuffer(desc, 0);
+}
+
+static ID3D11ShaderResourceView* CreateTexture(NullRenderDevice& device, unsigned int width, unsigned int height)
+{
+	TextureDesc desc = {};
+	desc.Width = width;
+	desc.Height = height;
+	desc.MipLevels = 1;
+	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	return device.CreateTexture2D(desc, 0, 0);
+}
+
+TEST(UploadManagerSendsHighestPriorityFirst)
+{
+	NullRenderDevice device;
+	RecordingContext recorder(device.GetImmediateContext());
+	UploadManager uploads(&device, &recorder, 1024, 4);
+	uploads.SetFrameBudget(16);
+
+	ID3D11Buffer* low = CreateDestination(device, 16);
+	ID3D11Buffer* normal = CreateDestination(device, 16);
+	ID3D11Buffer* high = CreateDestination(device, 16);
+	ID3D11Buffer* laterNormal = CreateDestination(device, 16);
+	unsigned char data[16] = {};
+	uploads.UploadBuffer(low, 0, data, 16, UPLOAD_PRIORITY_LOW);
+	uploads.UploadBuffer(normal, 0, data, 16, UPLOAD_PRIORITY_NORMAL);
+	uploads.UploadBuffer(high, 0, data, 16, UPLOAD_PRIORITY_HIGH);
+	uploads.UploadBuffer(laterNormal, 0, data, 16, UPLOAD_PRIORITY_NORMAL);
+
+	// One a frame, highest priority first, then in the order they were queued
+	ID3D11Buffer* expected[] = { high, normal, laterNormal, low };
+	for (int frame = 0; frame < 4; frame++)
+	{
+		uploads.ProcessFrame();
+		CHECK(uploads.GetCopiesLastFrame() == 1);
+		const RecordedCall* copy = recorder.Last("CopyBufferRegion");
+		CHECK(copy && copy->Objects[0] == expected[frame]);
+		CHECK(uploads.GetPendingCount() == (unsigned int)(3 - frame));
+	}
+	CHECK(recorder.Count("CopyBufferRegion") == 4);
+
+	device.Release(low);
+	device.Release(normal);
+	device.Release(high);
+	device.Release(laterNormal);
+}
+
+TEST(UploadManagerSplitsBigUploadsAcrossFrames)
+{
+	NullRenderDevice device;
+	RecordingContext recorder(device.GetImmediateContext());
+	UploadManager uploads(&device, &recorder, 1024, 4);
+	uploads.SetFrameBudget(256);
+
+	unsigned char data[1000];
+	for (int i = 0; i < 1000; i++)
+		data[i] = (unsigned char)(i * 7);
+	ID3D11Buffer* destination = CreateDestination(device, 1000);
+	UploadTicket ticket = uploads.UploadBuffer(destination, 0, data, 1000, UPLOAD_PRIORITY_NORMAL);
+	CHECK(uploads.GetPendingBytes() == 1000);
+
+	// 256 bytes a frame, each going on where the last left off
+	unsigned int offsets[] = { 0, 256, 512, 768 };
+	unsigned int sizes[] = { 256, 256, 256, 232 };
+	for (int frame = 0; frame < 4; frame++)
+	{
+		CHECK(!uploads.IsComplete(ticket));
+		uploads.ProcessFrame();
+		const RecordedCall* copy = recorder.Last("CopyBufferRegion");
+		CHECK(copy && copy->StartSlot == offsets[frame] && copy->Count == sizes[frame]);
+		CHECK(uploads.GetBytesLastFrame() == sizes[frame]);
+	}
+	CHECK(uploads.IsComplete(ticket));
+	CHECK(uploads.GetPendingBytes() == 0);
+	CHECK(memcmp(destination, data, 1000) == 0);
+
+	// Without a budget, a staging buffer's worth still goes at most
+	uploads.SetFrameBudget(0);
+	unsigned char big[3000] = {};
+	ID3D11Buffer* bigDestination = CreateDestination(device, 3000);
+	ticket = uploads.UploadBuffer(bigDestination, 0, big, 3000, UPLOAD_PRIORITY_NORMAL);
+	uploads.ProcessFrame();
+	CHECK(uploads.GetBytesLastFrame() == 1024);
+	CHECK(!uploads.IsComplete(ticket));
+
+	device.Release(destination);
+	device.Release(bigDestination);
+}
+
+// --------------------------------------------------------
+// A staging buffer is only mapped again once the frame that
+// last copied out of it is MaxFrameLatency frames behind
+// --------------------------------------------------------
+TEST(UploadManagerWaitsOutStagingBufferFences)
+{
+	NullRenderDevice device;
+	RecordingContext recorder(device.GetImmediateContext());
+	UploadManager uploads(&device, &recorder, 1024, 2);
+	uploads.SetFrameBudget(16);
+
+	unsigned char data[160] = {};
+	ID3D11Buffer* destination = CreateDestination(device, 160);
+	uploads.UploadBuffer(destination, 0, data, 160, UPLOAD_PRIORITY_NORMAL);
+
+	// Two staging buffers, each used by frames 0 and 1, so both wait
+	// until frames 4 and 5, then every fourth frame after that
+	bool expected[] = { true, true, false, false, true, true, false, false, true, true };
+	const void* previousStaging = 0;
+	for (int frame = 0; frame < 10; frame++)
+	{
+		recorder.Clear();
+		uploads.ProcessFrame();
+		CHECK((recorder.Count("MapStaging") == 1) == expected[frame]);
+		CHECK((uploads.GetBytesLastFrame() == 16) == expected[frame]);
+
+		// Back and forth between the two
+		const RecordedCall* map = recorder.Last("MapStaging");
+		if (map)
+		{
+			CHECK(map->Objects[0] != previousStaging);
+			previousStaging = map->Objects[0];
+		}
+	}
+	CHECK(UploadManager::MaxFrameLatency == 3);
+
+	// Texture rows don't need a staging buffer, so they carry on meanwhile
+	uploads.SetFrameBudget(0);
+	ID3D11ShaderResourceView* texture = CreateTexture(device, 4, 4);
+	unsigned char texels[64] = {};
+	UploadTicket textureTicket = uploads.UploadTexture(texture, 0, 4, 4, texels, 16, UPLOAD_PRIORITY_NORMAL);
+	recorder.Clear();
+	uploads.ProcessFrame();
+	CHECK(recorder.Count("MapStaging") == 0);
+	CHECK(recorder.Count("UpdateTextureRegion") == 1);
+	CHECK(uploads.IsComplete(textureTicket));
+
+	device.Release(destination);
+	device.Release(texture);
+}
+
+TEST(UploadManagerSendsAtLeastOneTextureRow)
+{
+	NullRenderDevice device;
+	RecordingContext recorder(device.GetImmediateContext());
+	UploadManager uploads(&device, &recorder, 1024, 4);
+
+	// Rows of 64 bytes against a budget of 16
+	uploads.SetFrameBudget(16);
+	ID3D11ShaderResourceView* texture = CreateTexture(device, 16, 4);
+	unsigned char texels[256] = {};
+	UploadTicket ticket = uploads.UploadTexture(texture, 0, 16, 4, texels, 64, UPLOAD_PRIORITY_NORMAL);
+	for (unsigned int frame = 0; frame < 4; frame++)
+	{
+		CHECK(!uploads.IsComplete(ticket));
+		uploads.ProcessFrame();
+		const RecordedCall* update = recorder.Last("UpdateTextureRegion");
+		CHECK(update && update->Count == 1);
+		CHECK(uploads.GetBytesLastFrame() == 64);
+	}
+	CHECK(uploads.IsComplete(ticket));
+	CHECK(recorder.Count("UpdateTextureRegion") == 4);
+
+	// But not once something else has gone this frame
+	ID3D11Buffer* buffer = CreateDestination(device, 16);
+	unsigned char data[16] = {};
+	uploads.UploadBuffer(buffer, 0, data, 8, UPLOAD_PRIORITY_HIGH);
+	ticket = uploads.UploadTexture(texture, 0, 16, 4, texels, 64, UPLOAD_PRIORITY_NORMAL);
+	recorder.Clear();
+	uploads.ProcessFrame();
+	CHECK(recorder.Count("CopyBufferRegion") == 1);
+	CHECK(recorder.Count("UpdateTextureRegion") == 0);
+	uploads.ProcessFrame();
+	CHECK(recorder.Count("UpdateTextureRegion") == 1);
+
+	// And as many whole rows as fit when the budget allows
+	uploads.SetFrameBudget(150);
+	uploads.ProcessFrame();
+	const RecordedCall* update = recorder.Last("UpdateTextureRegion");
+	CHECK(update && update->Count == 2);
+	CHECK(uploads.GetBytesLastFrame() == 128);
+	CHECK(!uploads.IsComplete(ticket));
+	uploads.ProcessFrame();
+	CHECK(uploads.GetBytesLastFrame() == 64);
+	CHECK(uploads.IsComplete(ticket));
+
+	device.Release(buffer);
+	device.Release(texture);
+}
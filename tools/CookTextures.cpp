@@ -0,0 +1,183 @@
+// --------------------------------------------------------
+// Command line texture cooker: packs the maps each manifest
+// lists into DDS files with their mips, each with a ".channels"
+// sidecar saying which channel holds which map.  See
+// TextureCooker.h for the manifest format.
+//
+//   CookTextures [-list] [-bench] [-threads n] manifest...
+//
+// -list prints what each manifest would make without cooking.
+// -bench times making each texture's mips with every filter,
+//   instruction set and thread count, without saving anything.
+// -threads limits how many threads make mips (0, the default,
+//   is one per core).
+//
+// The tests (MipGeneratorTests.cpp) check the fast filters give
+// the same mips as the scalar reference, on these textures too.
+//
+// Only needs the standard library, so it builds anywhere, like:
+//
+//   g++ -std=c++14 -O2 -pthread -I DX11Starter -o CookTextures tools/CookTextures.cpp
+//       DX11Starter/TextureCooker.cpp DX11Starter/MipGenerator.cpp
+//       DX11Starter/TiffReader.cpp DX11Starter/DdsFile.cpp
+// --------------------------------------------------------
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "TextureCooker.h"
+
+static void PrintTexture(const PackedTextureDesc& texture)
+{
+	static const char channelNames[] = "rgba";
+	printf("%s: %u channels, %u bits%s, mips %s\n", texture.Output.c_str(), texture.ChannelCount, texture.BitDepth,
+		texture.SRGB ? " sRGB" : "", texture.GenerateMips ? MipGenerator::GetFilterName(texture.Filter) : "none");
+	for (unsigned int c = 0; c < texture.ChannelCount; c++)
+	{
+		const PackedChannelDesc& channel = texture.Channels[c];
+		const char* semantic = channel.Semantic.empty() ? "-" : channel.Semantic.c_str();
+		if (channel.Source.empty())
+			printf("  %c %-12s constant %g\n", channelNames[c], semantic, channel.Constant);
+		else
+			printf("  %c %-12s %s (%c)%s\n", channelNames[c], semantic, channel.Source.c_str(), channelNames[channel.SourceChannel], channel.Invert ? " inverted" : "");
+	}
+}
+
+static const char* GetInstructionSetName(MipInstructionSet instructionSet)
+{
+	switch (instructionSet)
+	{
+	case MIP_INSTRUCTIONS_SCALAR: return "scalar";
+	case MIP_INSTRUCTIONS_SSE2: return "sse2";
+	case MIP_INSTRUCTIONS_AVX2: return "avx2";
+	}
+	return "";
+}
+
+// --------------------------------------------------------
+// Makes the mips of an already packed texture every way the
+// CPU can, best of 3 runs each, in linear and sRGB space
+// --------------------------------------------------------
+static void Benchmark(const TextureImage& packed, unsigned int threadCount)
+{
+	unsigned int cores = threadCount > 0 ? threadCount : std::thread::hardware_concurrency();
+	if (cores == 0)
+		cores = 1;
+	double texels = (double)packed.Width * packed.Height * 4.0 / 3.0;
+
+	std::vector<TextureImage> mips;
+	for (int srgb = 0; srgb < 2; srgb++)
+	{
+		for (int filter = MIP_FILTER_BOX; filter <= MIP_FILTER_LANCZOS; filter++)
+		{
+			for (int instructionSet = MIP_INSTRUCTIONS_SCALAR; instructionSet <= MipGenerator::GetSupportedInstructionSet(); instructionSet++)
+			{
+				for (unsigned int threads = 1; threads <= cores; threads = threads == cores ? cores + 1 : cores)
+				{
+					MipChainDesc mipChain = {};
+					mipChain.Filter = (MipFilter)filter;
+					mipChain.SRGB = srgb != 0;
+					mipChain.ThreadCount = threads;
+					mipChain.InstructionSet = (MipInstructionSet)instructionSet;
+
+					double best = 0.0;
+					for (int run = 0; run < 3; run++)
+					{
+						std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+						MipGenerator::Generate(packed, mipChain, mips);
+						double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+						if (run == 0 || seconds < best)
+							best = seconds;
+					}
+					printf("  %-7s %-6s %-7s %2u thread%s %9.2f ms %8.1f Mtexels/s\n",
+						MipGenerator::GetFilterName((MipFilter)filter), srgb ? "srgb" : "linear",
+						GetInstructionSetName((MipInstructionSet)instructionSet), threads, threads == 1 ? " " : "s",
+						best * 1000.0, texels / best / 1000000.0);
+				}
+			}
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	bool listOnly = false;
+	bool bench = false;
+	unsigned int threadCount = 0;
+	int manifestCount = 0;
+	int failures = 0;
+	for (int a = 1; a < argc; a++)
+	{
+		if (strcmp(argv[a], "-list") == 0)
+		{
+			listOnly = true;
+			continue;
+		}
+		if (strcmp(argv[a], "-bench") == 0)
+		{
+			bench = true;
+			continue;
+		}
+		if (strcmp(argv[a], "-threads") == 0 && a + 1 < argc)
+		{
+			threadCount = (unsigned int)strtoul(argv[++a], 0, 10);
+			continue;
+		}
+		manifestCount++;
+
+		std::vector<PackedTextureDesc> textures;
+		unsigned int errorLine = 0;
+		if (!TextureCooker::LoadManifest(argv[a], textures, errorLine))
+		{
+			if (errorLine > 0)
+				fprintf(stderr, "%s(%u): can't read this line\n", argv[a], errorLine);
+			else
+				fprintf(stderr, "%s: can't read the manifest\n", argv[a]);
+			failures++;
+			continue;
+		}
+
+		for (size_t t = 0; t < textures.size(); t++)
+		{
+			PrintTexture(textures[t]);
+			if (listOnly)
+				continue;
+
+			MipChainDesc mipChain = TextureCooker::GetMipChainDesc(textures[t]);
+			mipChain.ThreadCount = threadCount;
+
+			PackedTextureInfo info;
+			std::vector<TextureImage> mips;
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			if (!TextureCooker::CookMips(textures[t], mipChain, mips, info))
+			{
+				fprintf(stderr, "%s: failed - a source is missing, unreadable or a different size\n", textures[t].Output.c_str());
+				failures++;
+				continue;
+			}
+			double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+			if (bench)
+			{
+				Benchmark(mips[0], threadCount);
+				continue;
+			}
+
+			if (!TextureCooker::SaveCooked(textures[t], mips, info))
+			{
+				fprintf(stderr, "%s: failed - the output can't be written\n", textures[t].Output.c_str());
+				failures++;
+				continue;
+			}
+			printf("  cooked %ux%u with %u mips in %.0f ms, hash %016llx\n", info.Width, info.Height, info.MipLevels, seconds * 1000.0, info.DataHash);
+		}
+	}
+
+	if (manifestCount == 0)
+	{
+		fprintf(stderr, "usage: CookTextures [-list] [-bench] [-threads n] manifest...\n");
+		return 2;
+	}
+	return failures > 0 ? 1 : 0;
+}